@@ -39,6 +39,12 @@
  * requests for all files (which the passthrough filesystem cannot
  * satisfy if it can't read the file in the underlying filesystem).
  *
+ * With --io-uring-data, reads and writes of the backing files are
+ * submitted to an io_uring owned by the FUSE worker thread, and the
+ * FUSE request is completed from that ring's completion thread. The
+ * worker is free to take the next request right away, so a few
+ * threads can keep many I/Os outstanding.
+ *
  * ## Source code ##
  * \include passthrough_hp.cc
  */
@@ -71,6 +77,12 @@
 #include <unistd.h>
 #include <pthread.h>
 #include <limits.h>
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_DATA_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
 
 // C++ includes
 #include <cstddef>
@@ -79,6 +91,8 @@
 #include <list>
 #include "cxxopts.hpp"
 #include <mutex>
+#include <atomic>
+#include <memory>
 #include <fstream>
 #include <thread>
 #include <iomanip>
@@ -126,7 +140,9 @@ struct Inode {
     int fd {-1};
     dev_t src_dev {0};
     ino_t src_ino {0};
-    uint64_t nlookup {0};
+    // Only allowed to drop to zero while holding the lock of the
+    // inode's shard (see forget_one()).
+    std::atomic<uint64_t> nlookup {0};
     std::mutex m;
 
     // Delete copy constructor and assignments. We could implement
@@ -143,10 +159,22 @@ struct Inode {
     }
 };
 
-struct Fs {
+// The inode map is split into shards, each with its own lock, so
+// that lookups and forgets of unrelated files do not serialize on a
+// single mutex. The maps are node based, so an inode keeps its
+// address (which doubles as the FUSE inode number) until it is
+// erased.
+#define INODE_SHARD_BITS 6
+#define INODE_SHARDS (1 << INODE_SHARD_BITS)
+
+struct alignas(64) InodeShard {
     // Must be acquired *after* any Inode.m locks.
     std::mutex mutex;
     InodeMap inodes; // protected by mutex
+};
+
+struct Fs {
+    InodeShard shards[INODE_SHARDS];
     Inode root;
     double timeout;
     bool debug;
@@ -155,6 +183,8 @@ struct Fs {
     dev_t src_dev;
     bool nosplice;
     bool nocache;
+    bool data_uring;
+    unsigned data_uring_depth;
 };
 static Fs fs{};
 
@@ -165,6 +195,14 @@ static Fs fs{};
             static_cast<fuse_buf_copy_flags>(0))
 
 
+static InodeShard& get_shard(const SrcId& id) {
+    // std::hash is the identity for integers, so mix the bits before
+    // picking a shard (Fibonacci hashing).
+    uint64_t h = std::hash<SrcId>{}(id) * 0x9E3779B97F4A7C15ull;
+    return fs.shards[h >> (64 - INODE_SHARD_BITS)];
+}
+
+
 static Inode& get_inode(fuse_ino_t ino) {
     if (ino == FUSE_ROOT_ID)
         return fs.root;
@@ -334,35 +372,33 @@ static int do_lookup(fuse_ino_t parent, const char *name,
     }
 
     SrcId id {e->attr.st_ino, e->attr.st_dev};
-    unique_lock<mutex> fs_lock {fs.mutex};
+    InodeShard& shard = get_shard(id);
+    unique_lock<mutex> shard_lock {shard.mutex};
     Inode* inode_p;
     try {
-        inode_p = &fs.inodes[id];
+        inode_p = &shard.inodes[id];
     } catch (std::bad_alloc&) {
+        close(newfd);
         return ENOMEM;
     }
     e->ino = reinterpret_cast<fuse_ino_t>(inode_p);
     Inode& inode {*inode_p};
 
+    // The lookup count is raised under the shard lock, so a concurrent
+    // forget_one() cannot erase the inode in between.
     if(inode.fd != -1) { // found existing inode
-        fs_lock.unlock();
+        inode.nlookup.fetch_add(1, memory_order_relaxed);
+        shard_lock.unlock();
         if (fs.debug)
             cerr << "DEBUG: lookup(): inode " << e->attr.st_ino
                  << " (userspace) already known." << endl;
-        lock_guard<mutex> g {inode.m};
-        inode.nlookup++;
         close(newfd);
     } else { // no existing inode
-        /* This is just here to make Helgrind happy. It violates the
-           lock ordering requirement (inode.m must be acquired before
-           fs.mutex), but this is of no consequence because at this
-           point no other thread has access to the inode mutex */
-        lock_guard<mutex> g {inode.m};
         inode.src_ino = e->attr.st_ino;
         inode.src_dev = e->attr.st_dev;
-        inode.nlookup = 1;
+        inode.nlookup.store(1, memory_order_relaxed);
         inode.fd = newfd;
-        fs_lock.unlock();
+        shard_lock.unlock();
 
         if (fs.debug)
             cerr << "DEBUG: lookup(): created userspace inode " << e->attr.st_ino
@@ -469,10 +505,8 @@ static void sfs_link(fuse_req_t req, fuse_ino_t ino, fuse_ino_t parent,
         return;
     }
     e.ino = reinterpret_cast<fuse_ino_t>(&inode);
-    {
-        lock_guard<mutex> g {inode.m};
-        inode.nlookup++;
-    }
+    // The kernel holds a reference, so the count cannot be zero here
+    inode.nlookup.fetch_add(1, memory_order_relaxed);
 
     fuse_reply_entry(req, &e);
     return;
@@ -511,25 +545,37 @@ static void sfs_unlink(fuse_req_t req, fuse_ino_t parent, const char *name) {
 
 static void forget_one(fuse_ino_t ino, uint64_t n) {
     Inode& inode = get_inode(ino);
-    unique_lock<mutex> l {inode.m};
+    SrcId id {inode.src_ino, inode.src_dev};
+
+    // As long as some lookups remain the count is decremented without
+    // any lock. Only the decrement that may reach zero is done under
+    // the shard lock, which do_lookup() holds while raising the count.
+    auto nlookup = inode.nlookup.load(memory_order_relaxed);
+    while (nlookup > n) {
+        if (inode.nlookup.compare_exchange_weak(nlookup, nlookup - n,
+                                                memory_order_relaxed)) {
+            if (fs.debug)
+                cerr << "DEBUG: forget: inode " << id.first
+                     << " lookup count now " << nlookup - n << endl;
+            return;
+        }
+    }
 
-    if(n > inode.nlookup) {
+    InodeShard& shard = get_shard(id);
+    lock_guard<mutex> g_shard {shard.mutex};
+    nlookup = inode.nlookup.fetch_sub(n, memory_order_relaxed);
+    if(n > nlookup) {
         cerr << "INTERNAL ERROR: Negative lookup count for inode "
-             << inode.src_ino << endl;
+             << id.first << endl;
         abort();
     }
-    inode.nlookup -= n;
-    if (!inode.nlookup) {
+    if (nlookup == n) {
         if (fs.debug)
-            cerr << "DEBUG: forget: cleaning up inode " << inode.src_ino << endl;
-        {
-            lock_guard<mutex> g_fs {fs.mutex};
-            l.unlock();
-            fs.inodes.erase({inode.src_ino, inode.src_dev});
-        }
+            cerr << "DEBUG: forget: cleaning up inode " << id.first << endl;
+        shard.inodes.erase(id);
     } else if (fs.debug)
-            cerr << "DEBUG: forget: inode " << inode.src_ino
-                 << " lookup count now " << inode.nlookup << endl;
+            cerr << "DEBUG: forget: inode " << id.first
+                 << " lookup count now " << nlookup - n << endl;
 }
 
 static void sfs_forget(fuse_req_t req, fuse_ino_t ino, uint64_t nlookup) {
@@ -854,7 +900,350 @@ static void sfs_fsync(fuse_req_t req, fuse_ino_t ino, int datasync,
 }
 
 
+#ifdef HAVE_DATA_URING
+// A backing file read or write submitted to a DataRing. The data
+// buffer is page aligned, so that backing files opened with O_DIRECT
+// work.
+struct DataOp {
+    fuse_req_t req;
+    bool write;
+    int fd;
+    off_t off;
+    size_t size;
+    char* data;
+
+    static DataOp* create(size_t size) {
+        auto op = static_cast<DataOp*>(malloc(sizeof(DataOp)));
+        if (op && posix_memalign(reinterpret_cast<void**>(&op->data),
+                                 4096, max(size, size_t(1)))) {
+            free(op);
+            return nullptr;
+        }
+        return op;
+    }
+
+    static void destroy(DataOp* op) {
+        free(op->data);
+        free(op);
+    }
+};
+
+
+// An io_uring owned by one FUSE worker thread. Only the owner submits;
+// a completion thread waits for completions and replies to the FUSE
+// requests, so the owner never blocks on backing file I/O.
+class DataRing {
+public:
+    // Returns the calling thread's ring, or nullptr if io_uring cannot
+    // be used (in which case the caller does the I/O synchronously).
+    static DataRing* get();
+
+    ~DataRing();
+
+    // Reserves room for one operation, to be followed by submit() or
+    // unreserve().
+    bool reserve();
+    void unreserve();
+    void submit(DataOp* op);
+
+private:
+    DataRing() = default;
+    DataRing(const DataRing&) = delete;
+    DataRing& operator=(const DataRing&) = delete;
+
+    bool setup(unsigned depth);
+    bool push(uint8_t opcode, int fd, void* addr, unsigned len,
+              off_t off, uint64_t user_data);
+    void reap();
+    static void complete(DataOp* op, int res);
+
+    int ring_fd {-1};
+    unsigned depth {0};
+    std::atomic<unsigned> inflight {0};
+    std::thread reaper;
+
+    void* sq_map {MAP_FAILED};
+    size_t sq_map_size {0};
+    void* cq_map {MAP_FAILED};
+    size_t cq_map_size {0};
+    io_uring_sqe* sqes {static_cast<io_uring_sqe*>(MAP_FAILED)};
+    size_t sqes_size {0};
+
+    unsigned* sq_tail {nullptr};
+    unsigned sq_mask {0};
+    unsigned* sq_array {nullptr};
+    unsigned* cq_head {nullptr};
+    unsigned* cq_tail {nullptr};
+    unsigned cq_mask {0};
+    io_uring_cqe* cqes {nullptr};
+};
+
+// Set once io_uring turned out not to work, so that other threads do
+// not try again.
+static std::atomic<bool> data_uring_broken {false};
+
+
+static int sys_io_uring_setup(unsigned entries, io_uring_params* p) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, p));
+}
+
+
+static int sys_io_uring_enter(int fd, unsigned to_submit,
+                              unsigned min_complete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit,
+                                    min_complete, flags, nullptr, 0));
+}
+
+
+DataRing* DataRing::get() {
+    static thread_local std::unique_ptr<DataRing> ring;
+    static thread_local bool failed {false};
+
+    if (ring || failed || data_uring_broken.load(memory_order_relaxed))
+        return ring.get();
+
+    std::unique_ptr<DataRing> r {new (std::nothrow) DataRing};
+    if (!r || !r->setup(fs.data_uring_depth)) {
+        failed = true;
+        if (!data_uring_broken.exchange(true))
+            cerr << "WARNING: io_uring unavailable, backing file I/O "
+                 << "will be synchronous" << endl;
+        return nullptr;
+    }
+    ring = std::move(r);
+    return ring.get();
+}
+
+
+bool DataRing::setup(unsigned depth) {
+    io_uring_params p {};
+
+    // Room for every operation plus the wake-up at shutdown
+    ring_fd = sys_io_uring_setup(depth + 1, &p);
+    if (ring_fd < 0)
+        return false;
+    this->depth = depth;
+
+    // IORING_OP_READ and IORING_OP_WRITE need 5.6, which is also when
+    // IORING_FEAT_NODROP, IORING_FEAT_SUBMIT_STABLE and IORING_FEAT_FAST_POLL
+    // appeared; use the latter as a cheap version check.
+    if (!(p.features & IORING_FEAT_FAST_POLL))
+        return false;
+
+    sq_map_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq_map_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        sq_map_size = max(sq_map_size, cq_map_size);
+        cq_map_size = sq_map_size;
+    }
+    sq_map = mmap(nullptr, sq_map_size, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (sq_map == MAP_FAILED)
+        return false;
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        cq_map = sq_map;
+    else {
+        cq_map = mmap(nullptr, cq_map_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        if (cq_map == MAP_FAILED)
+            return false;
+    }
+    sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+    sqes = static_cast<io_uring_sqe*>(
+        mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES));
+    if (sqes == MAP_FAILED)
+        return false;
+
+    auto sq = static_cast<char*>(sq_map);
+    auto cq = static_cast<char*>(cq_map);
+    sq_tail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+    sq_mask = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+    cq_head = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+    cq_mask = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+
+    try {
+        reaper = std::thread(&DataRing::reap, this);
+    } catch (std::system_error&) {
+        return false;
+    }
+    return true;
+}
+
+
+DataRing::~DataRing() {
+    if (reaper.joinable()) {
+        // The owner is exiting, so nothing is submitted any more. The
+        // NOP tells the completion thread to stop once all operations
+        // have completed.
+        inflight.fetch_add(1, memory_order_relaxed);
+        if (!push(IORING_OP_NOP, -1, nullptr, 0, 0, 0)) {
+            // Without the NOP the completion thread never returns, and
+            // it still uses the ring, so leave both behind.
+            reaper.detach();
+            return;
+        }
+        reaper.join();
+    }
+    if (sqes != MAP_FAILED)
+        munmap(sqes, sqes_size);
+    if (cq_map != MAP_FAILED && cq_map != sq_map)
+        munmap(cq_map, cq_map_size);
+    if (sq_map != MAP_FAILED)
+        munmap(sq_map, sq_map_size);
+    if (ring_fd >= 0)
+        close(ring_fd);
+}
+
+
+bool DataRing::reserve() {
+    // Only the owner raises the count, so this cannot overshoot
+    if (inflight.load(memory_order_relaxed) >= depth)
+        return false;
+    inflight.fetch_add(1, memory_order_relaxed);
+    return true;
+}
+
+
+void DataRing::unreserve() {
+    inflight.fetch_sub(1, memory_order_relaxed);
+}
+
+
+// Returns false if the kernel did not take the entry.
+bool DataRing::push(uint8_t opcode, int fd, void* addr, unsigned len,
+                    off_t off, uint64_t user_data) {
+    // Every reserved operation has its entry, and each entry is handed
+    // to the kernel right away (or taken back), so the submission queue
+    // never fills up.
+    auto tail = *sq_tail;
+    auto index = tail & sq_mask;
+    io_uring_sqe* sqe = &sqes[index];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uintptr_t>(addr);
+    sqe->len = len;
+    sqe->off = off;
+    sqe->user_data = user_data;
+    sq_array[index] = index;
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    int res;
+    while ((res = sys_io_uring_enter(ring_fd, 1, 0, 0)) < 0 &&
+           (errno == EINTR || errno == EAGAIN || errno == EBUSY))
+        ;
+    if (res > 0)
+        return true;
+
+    // A failed io_uring_enter() consumed nothing, so the entry can be
+    // withdrawn before a later call submits it after all.
+    __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+    return false;
+}
+
+
+void DataRing::submit(DataOp* op) {
+    if (push(op->write ? IORING_OP_WRITE : IORING_OP_READ, op->fd, op->data,
+             static_cast<unsigned>(op->size), op->off,
+             reinterpret_cast<uintptr_t>(op)))
+        return;
+
+    // The ring refused the operation; do it here instead
+    auto res = op->write ? pwrite(op->fd, op->data, op->size, op->off)
+                         : pread(op->fd, op->data, op->size, op->off);
+    complete(op, res < 0 ? -errno : static_cast<int>(res));
+    inflight.fetch_sub(1, memory_order_relaxed);
+}
+
+
+void DataRing::complete(DataOp* op, int res) {
+    if (op->write) {
+        // Finish short writes synchronously; the kernel does not
+        // expect them from a passthrough file system.
+        size_t done = res < 0 ? 0 : res;
+        while (res >= 0 && done < op->size) {
+            auto n = pwrite(op->fd, op->data + done, op->size - done,
+                            op->off + done);
+            if (n <= 0)
+                break;
+            done += n;
+        }
+        if (res < 0)
+            fuse_reply_err(op->req, -res);
+        else
+            fuse_reply_write(op->req, done);
+    } else if (res < 0)
+        fuse_reply_err(op->req, -res);
+    else
+        fuse_reply_buf(op->req, op->data, res);
+    DataOp::destroy(op);
+}
+
+
+void DataRing::reap() {
+    bool stopping {false};
+
+    while (!stopping || inflight.load(memory_order_relaxed)) {
+        auto head = *cq_head;
+        auto tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            sys_io_uring_enter(ring_fd, 0, 1, IORING_ENTER_GETEVENTS);
+            continue;
+        }
+        for (; head != tail; head++) {
+            io_uring_cqe* cqe = &cqes[head & cq_mask];
+            if (cqe->user_data)
+                complete(reinterpret_cast<DataOp*>(cqe->user_data), cqe->res);
+            else
+                stopping = true;
+            inflight.fetch_sub(1, memory_order_relaxed);
+        }
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+    }
+}
+
+
+// Starts an asynchronous read or write. Returns the DataOp to fill in
+// (for writes) and submit, or nullptr if the I/O has to be done
+// synchronously.
+static DataOp* data_uring_start(DataRing*& ring, fuse_req_t req, bool write,
+                                size_t size, off_t off, fuse_file_info *fi) {
+    if (!fs.data_uring || size > UINT_MAX)
+        return nullptr;
+    ring = DataRing::get();
+    if (!ring || !ring->reserve())
+        return nullptr;
+
+    auto op = DataOp::create(size);
+    if (!op) {
+        ring->unreserve();
+        return nullptr;
+    }
+    op->req = req;
+    op->write = write;
+    op->fd = fi->fh;
+    op->off = off;
+    op->size = size;
+    return op;
+}
+#endif
+
+
 static void do_read(fuse_req_t req, size_t size, off_t off, fuse_file_info *fi) {
+#ifdef HAVE_DATA_URING
+    DataRing* ring;
+    auto op = data_uring_start(ring, req, false, size, off, fi);
+    if (op) {
+        ring->submit(op);
+        return;
+    }
+#endif
+
     // This is not ISO C++:
     // fuse_bufvec buf = FUSE_BUFVEC_INIT(size);
     fuse_bufvec buf;
@@ -894,6 +1283,27 @@ static void do_write_buf(fuse_req_t req, size_t size, off_t off,
     out_buf.buf[0].fd = fi->fh;
     out_buf.buf[0].pos = off;
 
+#ifdef HAVE_DATA_URING
+    // The request buffer is reused as soon as we return, so the data
+    // is copied into the operation before it is submitted.
+    DataRing* ring;
+    auto op = data_uring_start(ring, req, true, size, off, fi);
+    if (op) {
+        out_buf.buf[0].flags = static_cast<fuse_buf_flags>(0);
+        out_buf.buf[0].mem = op->data;
+        auto copied = fuse_buf_copy(&out_buf, in_buf, FUSE_BUF_COPY_FLAGS);
+        if (copied < 0) {
+            DataOp::destroy(op);
+            ring->unreserve();
+            fuse_reply_err(req, -copied);
+            return;
+        }
+        op->size = copied;
+        ring->submit(op);
+        return;
+    }
+#endif
+
     auto res = fuse_buf_copy(&out_buf, in_buf, FUSE_BUF_COPY_FLAGS);
     if (res < 0)
         fuse_reply_err(req, -res);
@@ -1123,8 +1533,14 @@ static cxxopts::ParseResult parse_options(int argc, char **argv) {
         ("debug", "Enable filesystem debug messages")
         ("debug-fuse", "Enable libfuse debug messages")
         ("help", "Print help")
+        ("io-uring", "Use io_uring to receive requests and send replies")
         ("nocache", "Disable all caching")
+        ("io-uring-data", "Submit backing file reads and writes to a per-thread io_uring")
+        ("io-uring-data-depth", "Operations each thread may have outstanding",
+         cxxopts::value<unsigned>()->default_value("64"))
         ("nosplice", "Do not use splice(2) to transfer data")
+        ("per-cpu-workers", "Run one worker thread pinned to each CPU")
+        ("work-stealing", "With --per-cpu-workers, add standby threads when all are busy")
         ("single", "Run single-threaded");
 
     // FIXME: Find a better way to limit the try clause to just
@@ -1148,6 +1564,8 @@ static cxxopts::ParseResult parse_options(int argc, char **argv) {
 
     fs.debug = options.count("debug") != 0;
     fs.nosplice = options.count("nosplice") != 0;
+    fs.data_uring = options.count("io-uring-data") != 0;
+    fs.data_uring_depth = max(options["io-uring-data-depth"].as<unsigned>(), 1u);
     fs.source = std::string {realpath(argv[1], NULL)};
 
     return options;
@@ -1217,8 +1635,13 @@ int main(int argc, char *argv[]) {
 
     // Mount and run main loop
     struct fuse_loop_config loop_config;
+    memset(&loop_config, 0, sizeof(loop_config));
     loop_config.clone_fd = 0;
     loop_config.max_idle_threads = 10;
+    loop_config.io_uring = options.count("io-uring") != 0;
+    loop_config.io_uring_depth = 0;
+    loop_config.per_cpu_workers = options.count("per-cpu-workers") != 0;
+    loop_config.work_stealing = options.count("work-stealing") != 0;
     if (fuse_session_mount(se, argv[2]) != 0)
         goto err_out3;
     if (options.count("single"))
@@ -25,11 +25,16 @@ static int fin_access(const char *pathname, int mode)
     return orig_access(pathname, mode);
 }
 
+//
+// The server answers for names it can resolve and hands everything else (a symlink on the way,
+// "..", a file system that wants the kernel to decide) back to the C library.
+//
 static int internal_access(const char *pathname, int mode)
 {
     fincomm_message         message;
     finesse_client_handle_t finesse_client_handle = NULL;
     int                     result;
+    uint64_t                since = 0;
     struct timespec         start, stop, elapsed;
     int                     status, tstatus;
 
@@ -43,36 +48,50 @@ static int internal_access(const char *pathname, int mode)
     timespec_diff(&start, &stop, &elapsed);
     FinesseApiRecordOverhead(FINESSE_API_CALL_ACCESS, &elapsed);
 
-    if (NULL == finesse_client_handle) {
-        // not of interest - fallback
+    if (NULL != finesse_client_handle) {
         tstatus = clock_gettime(CLOCK_MONOTONIC_RAW, &start);
         assert(0 == tstatus);
 
-        status = fin_access(pathname, mode);
+        result = ENOTSUP;
+        if (finesse_negative_lookup(finesse_client_handle, pathname, &since)) {
+            result = ENOENT;
+        }
+        else if (0 == FinesseSendAccessRequest(finesse_client_handle, NULL, pathname, mode, &message)) {
+            status = FinesseGetAccessResponse(finesse_client_handle, message, &result);
+            assert(0 == status);
+            FinesseFreeAccessResponse(finesse_client_handle, message);
+
+            if (ENOENT == result) {
+                finesse_negative_add(finesse_client_handle, pathname, since);
+            }
+        }
 
         tstatus = clock_gettime(CLOCK_MONOTONIC_RAW, &stop);
         assert(0 == tstatus);
         timespec_diff(&start, &stop, &elapsed);
-        FinesseApiRecordNative(FINESSE_API_CALL_ACCESS, &elapsed);
-
-        return status;
+        FinesseApiRecordOverhead(FINESSE_API_CALL_ACCESS, &elapsed);
+
+        if (!finesse_use_native(result)) {
+            if (0 != result) {
+                errno = result;
+                return -1;
+            }
+            return 0;
+        }
     }
 
+    // not of interest, or the server can't do it - fallback
     tstatus = clock_gettime(CLOCK_MONOTONIC_RAW, &start);
     assert(0 == tstatus);
 
-    status = FinesseSendAccessRequest(finesse_client_handle, NULL, pathname, mode, &message);
-    assert(0 == status);
-    status = FinesseGetAccessResponse(finesse_client_handle, message, &result);
-    assert(0 == status);
-    FinesseFreeAccessResponse(finesse_client_handle, message);
+    status = fin_access(pathname, mode);
 
     tstatus = clock_gettime(CLOCK_MONOTONIC_RAW, &stop);
     assert(0 == tstatus);
     timespec_diff(&start, &stop, &elapsed);
-    FinesseApiRecordOverhead(FINESSE_API_CALL_ACCESS, &elapsed);
+    FinesseApiRecordNative(FINESSE_API_CALL_ACCESS, &elapsed);
 
-    return result;
+    return status;
 }
 
 int finesse_access(const char *pathname, int mode)
@@ -168,7 +187,11 @@ static int internal_faccessat(int dirfd, const char *pathname, int mode, int fla
     assert(0 == tstatus);
 
     status = FinesseSendAccessRequest(finesse_client_handle, &file_state->key, pathname, mode, &message);
-    assert(0 == status);
+    if (0 != status) {
+        // longer than even a multi-slot message (and thus than any valid path)
+        errno = status;
+        return -1;
+    }
     status = FinesseGetAccessResponse(finesse_client_handle, message, &result);
     assert(0 == status);
     FinesseFreeAccessResponse(finesse_client_handle, message);
@@ -178,7 +201,16 @@ static int internal_faccessat(int dirfd, const char *pathname, int mode, int fla
     timespec_diff(&start, &stop, &elapsed);
     FinesseApiRecordOverhead(FINESSE_API_CALL_ACCESS, &elapsed);
 
-    return result;
+    if (finesse_use_native(result)) {
+        return fin_faccessat(dirfd, pathname, mode, flags);
+    }
+
+    if (0 != result) {
+        errno = result;
+        return -1;
+    }
+
+    return 0;
 }
 
 int finesse_faccessat(int dirfd, const char *pathname, int mode, int flags)
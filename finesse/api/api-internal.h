@@ -32,4 +32,24 @@ extern int finesse_api_init_in_progress;
 
 fuse_ino_t LookupInodeForKey(uuid_t *Key);
 
+// The C library's versions, bypassing Finesse
+int fin_stat(const char *file_name, struct stat *buf);
+int fin_fstat(int filedes, struct stat *buf);
+int fin_fstatat(int dirfd, const char *pathname, struct stat *statbuf, int flags);
+int fin_open(const char *pathname, int flags, ...);
+int fin_close(int fd);
+
+// The server says ENOTSUP (or, for a call it doesn't know, ENOSYS) when the C library should do it
+static inline int finesse_use_native(int result)
+{
+    return (ENOTSUP == result) || (ENOSYS == result);
+}
+
+// What the kernel would apply to a new file's mode (see umask.c)
+mode_t finesse_get_umask(void);
+
+// Paths the server recently said don't exist (see negative.c)
+int  finesse_negative_lookup(finesse_client_handle_t client, const char *path, uint64_t *since);
+void finesse_negative_add(finesse_client_handle_t client, const char *path, uint64_t since);
+
 #endif  // __API_INTERNAL_H__
@@ -14,15 +14,24 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "callshard.h"
 #include "callstats.h"
 #include "timestamp.h"
 
+// The counters live in per-thread shards (see callshard.h); this array only
+// holds the names and is the template for the aggregated copy.
 static finesse_api_call_statistics_t FinesseApiCallStatistics[FINESSE_API_CALLS_COUNT];
 
-static const char *FinesseCallDataNames[] = {"Access", "Faccessat", "Chdir",  "Chmod",   "Chown",  "Close",    "Creat",   "Dir",
-                                             "Dup",    "Fopen",     "Fdopen", "Freopen", "Fstat",  "Fstatat",  "Fstatfs", "Lstat",
-                                             "Link",   "Lseek",     "Mkdir",  "Mkdirat", "Open",   "Openat",   "Read",    "Rename",
-                                             "Rmdir",  "Stat",      "Statx",  "Statfs",  "Unlink", "Unlinkat", "Utime",   "Write"};
+#define FINESSE_API_TIMER_LIBRARY (0)
+#define FINESSE_API_TIMER_NATIVE (1)
+static finesse_callshard_set_t FinesseApiCallShards = FINESSE_CALLSHARD_SET_INITIALIZER(FINESSE_API_CALLS_COUNT, 2);
+static const double            FinesseApiPercentiles[3] = {50.0, 99.0, 99.9};
+
+static const char *FinesseCallDataNames[] = {"Access",  "Faccessat", "Chdir",   "Chmod",    "Chown",  "Close",    "Creat",   "Dir",
+                                             "Dup",     "Fopen",     "Fdopen",  "Freopen",  "Fstat",  "Fstatat",  "Fstatfs", "Lstat",
+                                             "Link",    "Lseek",     "Mkdir",   "Mkdirat",  "Open",   "Openat",   "Read",    "Rename",
+                                             "Rmdir",   "Stat",      "Statx",   "Statfs",   "Unlink", "Unlinkat", "Utime",   "Write",
+                                             "Symlink", "Readlink",  "Truncate"};
 
 static const char *FinesseCallDataNames[FINESSE_API_CALLS_COUNT];
 
@@ -37,12 +46,32 @@ void FinesseApiInitializeCallStatistics(void)
     }
 }
 
+static void FinesseApiAggregateTimer(unsigned Index, unsigned Timer, struct timespec *Elapsed, uint64_t *Latency)
+{
+    uint64_t histogram[FINESSE_CALLSHARD_BUCKETS];
+    uint64_t nsec = FinesseCallShardElapsed(&FinesseApiCallShards, Index, Timer);
+
+    Elapsed->tv_sec  = nsec / 1000000000;
+    Elapsed->tv_nsec = nsec % 1000000000;
+    FinesseCallShardHistogram(&FinesseApiCallShards, Index, Timer, histogram);
+    for (unsigned index = 0; index < sizeof(FinesseApiPercentiles) / sizeof(double); index++) {
+        Latency[index] = FinesseCallShardPercentile(histogram, FinesseApiPercentiles[index]);
+    }
+}
+
+// Returns a snapshot of the call statistics, aggregated across all threads.
 finesse_api_call_statistics_t *FinesseApiGetCallStatistics(void)
 {
     finesse_api_call_statistics_t *copy = (finesse_api_call_statistics_t *)malloc(sizeof(FinesseApiCallStatistics));
 
     if (NULL != copy) {
         memcpy(copy, FinesseApiCallStatistics, sizeof(FinesseApiCallStatistics));
+
+        for (unsigned index = 0; index < FINESSE_API_CALLS_COUNT; index++) {
+            FinesseCallShardSum(&FinesseApiCallShards, index, &copy[index].Calls, &copy[index].Success, &copy[index].Failure);
+            FinesseApiAggregateTimer(index, FINESSE_API_TIMER_LIBRARY, &copy[index].LibraryElapsedTime, copy[index].LibraryLatency);
+            FinesseApiAggregateTimer(index, FINESSE_API_TIMER_NATIVE, &copy[index].NativeElapsedTime, copy[index].NativeLatency);
+        }
     }
     return copy;
 }
@@ -58,27 +87,19 @@ void FinesseApiCountCall(uint8_t Call, uint8_t Success)
 {
     assert((Call > FINESSE_API_CALL_BASE) && (Call < FINESSE_API_CALLS_MAX));
     assert((0 == Success) || (1 == Success));
-    FinesseApiCallStatistics[Call - (FINESSE_API_CALL_BASE + 1)].Calls++;
-    if (Success) {
-        FinesseApiCallStatistics[Call - (FINESSE_API_CALL_BASE + 1)].Success++;
-    }
-    else {
-        FinesseApiCallStatistics[Call - (FINESSE_API_CALL_BASE + 1)].Failure++;
-    }
+    FinesseCallShardCount(&FinesseApiCallShards, Call - (FINESSE_API_CALL_BASE + 1), Success);
 }
 
 void FinesseApiRecordNative(uint8_t Call, struct timespec *Elapsed)
 {
     assert((Call > FINESSE_API_CALL_BASE) && (Call < FINESSE_API_CALLS_MAX));
-    timespec_add(&FinesseApiCallStatistics[Call - (FINESSE_API_CALL_BASE + 1)].NativeElapsedTime, Elapsed,
-                 &FinesseApiCallStatistics[Call - (FINESSE_API_CALL_BASE + 1)].NativeElapsedTime);
+    FinesseCallShardRecord(&FinesseApiCallShards, Call - (FINESSE_API_CALL_BASE + 1), FINESSE_API_TIMER_NATIVE, Elapsed);
 }
 
 void FinesseApiRecordOverhead(uint8_t Call, struct timespec *Elapsed)
 {
     assert((Call > FINESSE_API_CALL_BASE) && (Call < FINESSE_API_CALLS_MAX));
-    timespec_add(&FinesseApiCallStatistics[Call - (FINESSE_API_CALL_BASE + 1)].LibraryElapsedTime, Elapsed,
-                 &FinesseApiCallStatistics[Call - (FINESSE_API_CALL_BASE + 1)].LibraryElapsedTime);
+    FinesseCallShardRecord(&FinesseApiCallShards, Call - (FINESSE_API_CALL_BASE + 1), FINESSE_API_TIMER_LIBRARY, Elapsed);
 }
 
 // Given a copy of the call data, this routine will create a single string suitable for printing
@@ -133,6 +154,64 @@ const char *FinesseApiFormatCallData(finesse_api_call_statistics_t *CallData, in
     return formatted_data;
 }
 
+// Native and library latency percentiles for each call that has been invoked.  This is
+// released with FinesseApiFreeFormattedCallData.
+const char *FinesseApiFormatCallLatency(finesse_api_call_statistics_t *CallData, int CsvFormat)
+{
+    finesse_api_call_statistics_t *cd              = CallData;
+    int                            allocated       = 0;
+    size_t                         required_space  = 0;
+    size_t                         space_used      = 0;
+    char *                         formatted_data  = NULL;
+    static const char *            CsvHeaderString = "Routine, Invocations, Native:p50, Native:p99, Native:p999, Library:p50, Library:p99, Library:p999\n";
+    static const char *            FormatString =
+        "%16s: %10lu Calls, Native p50/p99/p999 = %10lu/%10lu/%10lu (ns), Library p50/p99/p999 = %10lu/%10lu/%10lu (ns)\n";
+    static const char *CsvFormatString = " %s, %lu, %lu, %lu, %lu, %lu, %lu, %lu\n";
+
+    if (NULL == CallData) {
+        cd        = FinesseApiGetCallStatistics();
+        allocated = 1;
+    }
+
+    if (NULL == cd) {
+        return NULL;
+    }
+
+    required_space = strlen(CsvHeaderString) + 1;
+    for (unsigned index = 0; index < FINESSE_API_CALLS_COUNT; index++) {
+        required_space += snprintf(NULL, 0, CsvFormat ? CsvFormatString : FormatString, cd[index].Name, cd[index].Calls,
+                                   cd[index].NativeLatency[0], cd[index].NativeLatency[1], cd[index].NativeLatency[2],
+                                   cd[index].LibraryLatency[0], cd[index].LibraryLatency[1], cd[index].LibraryLatency[2]);
+    }
+
+    formatted_data = (char *)malloc(required_space);
+
+    if (NULL != formatted_data) {
+        formatted_data[0] = '\0';
+        if (CsvFormat) {
+            space_used += snprintf(formatted_data, required_space, "%s", CsvHeaderString);
+        }
+
+        for (unsigned index = 0; index < FINESSE_API_CALLS_COUNT; index++) {
+            if ((0 == cd[index].Calls) && (!CsvFormat)) {
+                continue;
+            }
+            space_used += snprintf(&formatted_data[space_used], required_space - space_used,
+                                   CsvFormat ? CsvFormatString : FormatString, cd[index].Name, cd[index].Calls,
+                                   cd[index].NativeLatency[0], cd[index].NativeLatency[1], cd[index].NativeLatency[2],
+                                   cd[index].LibraryLatency[0], cd[index].LibraryLatency[1], cd[index].LibraryLatency[2]);
+            assert(space_used < required_space);
+        }
+    }
+
+    if (allocated) {
+        FinesseApiReleaseCallStatistics(cd);
+        cd = NULL;
+    }
+
+    return formatted_data;
+}
+
 void FinesseApiFreeFormattedCallData(const char *FormattedData)
 {
     if (NULL != FormattedData) {
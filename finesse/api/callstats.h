@@ -42,7 +42,10 @@
 #define FINESSE_API_CALL_UNLINKAT (FINESSE_API_CALL_UNLINK + 1)
 #define FINESSE_API_CALL_UTIME (FINESSE_API_CALL_UNLINKAT + 1)
 #define FINESSE_API_CALL_WRITE (FINESSE_API_CALL_UTIME + 1)
-#define FINESSE_API_CALLS_MAX (FINESSE_API_CALL_WRITE + 1)
+#define FINESSE_API_CALL_SYMLINK (FINESSE_API_CALL_WRITE + 1)
+#define FINESSE_API_CALL_READLINK (FINESSE_API_CALL_SYMLINK + 1)
+#define FINESSE_API_CALL_TRUNCATE (FINESSE_API_CALL_READLINK + 1)
+#define FINESSE_API_CALLS_MAX (FINESSE_API_CALL_TRUNCATE + 1)
 #define FINESSE_API_CALLS_COUNT (FINESSE_API_CALLS_MAX - (FINESSE_API_CALL_BASE + 1))
 
 typedef struct _finessse_api_call_statistics {
@@ -52,6 +55,8 @@ typedef struct _finessse_api_call_statistics {
     struct timespec LibraryElapsedTime;
     struct timespec NativeElapsedTime;
     char const *    Name;
+    uint64_t        LibraryLatency[3];  // p50, p99, p999 (ns) from the latency histograms
+    uint64_t        NativeLatency[3];
 } finesse_api_call_statistics_t;
 
 void                           FinesseApiInitializeCallStatistics(void);
@@ -60,6 +65,7 @@ void                           FinesseApiReleaseCallStatistics(finesse_api_call_
 const char *                   FinesseApiFormatCallData(finesse_api_call_statistics_t *CallData, int CsvFormat);
 void                           FinesseApiFreeFormattedCallData(const char *FormattedData);
 void FinesseApiFormatCallDataEntry(finesse_api_call_statistics_t *CallDataEntry, int CsvFormat, char *Buffer, size_t *BufferSize);
+const char *FinesseApiFormatCallLatency(finesse_api_call_statistics_t *CallData, int CsvFormat);
 
 static inline void timespec_diff(struct timespec *begin, struct timespec *end, struct timespec *diff)
 {
@@ -70,6 +76,9 @@ static inline void timespec_diff(struct timespec *begin, struct timespec *end, s
         result.tv_sec--;
         result.tv_nsec = (long)1000000000 + end->tv_nsec - begin->tv_nsec;
     }
+    else {
+        result.tv_nsec = end->tv_nsec - begin->tv_nsec;
+    }
     *diff = result;
 }
 
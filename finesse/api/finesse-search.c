@@ -1,257 +1,384 @@
-/*
-  FINESSE: Low Energy effcient extension to FUSE
-  Copyright (C) 2017  Tony Mason <fsgeek@cs.ubc.ca>
-
-*/
-
-#define _GNU_SOURCE
-
-#include "config.h"
-#include "fuse_i.h"
-#include "fuse_kernel.h"
-#include "fuse_opt.h"
-#include "fuse_misc.h"
-#include <fuse_lowlevel.h>
-#include "finesse-search.h"
-
-#include <stdio.h>
-#include <stdlib.h>
-#include <stddef.h>
-#include <string.h>
-#include <unistd.h>
-#include <limits.h>
-#include <errno.h>
-#include <assert.h>
-#include <sys/file.h>
-#include <time.h>
-#include <mqueue.h>
-#include <uuid/uuid.h>
-
-//
-// given a list of files and paths, find the first occurrence of the file in the path
-//
-static int finesse_find_file_in_path(char **files, char **paths, char *prefix, char **file_found, char **path_found)
-{
-    unsigned file_index, path_index;
-    struct stat stat_buf;
-    char scratch[4096]; // TODO: make this handle arbitrary long paths
-
-    for (file_index = 0; NULL != files[file_index]; file_index++)
-    {
-        for (path_index = 0; NULL != paths[path_index]; path_index++)
-        {
-            /* this is done using the stat call */
-            if (NULL != prefix)
-            {
-                sprintf(scratch, "%s/%s/%s", prefix, paths[path_index], files[file_index]);
-            }
-            else
-            {
-                sprintf(scratch, "%s/%s", paths[path_index], files[file_index]);
-            }
-
-            if (0 == stat(scratch, &stat_buf))
-            {
-                // found it
-                // TODO: may want to make this more resilient against "wrong kind of content" errors
-                *file_found = files[file_index];
-                *path_found = paths[path_index];
-                return 0;
-            }
-        }
-    }
-
-    return -1;
-}
-
-#if 0
-typedef struct finesse_path_search_request {
-	//
-	// The search data consists of two lists:
-	//
-	// <string><null><string><null><string><null><null>
-	// <string><null><string><null><null><null>
-	//
-	// TODO: we may need to have some way of specifying
-	//       this is sent in shared memory.
-	//
-	u_int16_t SearchDataFlags;
-	u_int16_t SearchDataLength;
-	char SearchData[1];
-} finesse_path_search_request_t;
-
-int finesse_process_search_request(finesse_path_search_request_t *search_request, finesse_path_search_response_t **search_response)
-{
-    (void)search_request;
-    (void)search_response;
-
-    return -ENOSYS;
-}
-
-/////
-//
-// given a list of files and paths, find the first occurrence of the file in the path
-//
-static int find_file_in_path(char **files, char **paths, char *prefix, char **file_found, char **path_found)
-{
-    unsigned file_index, path_index;
-    struct stat stat_buf;
-    char scratch[4096]; // TODO: make this handle arbitrary long paths
-
-    for (file_index = 0; NULL != files[file_index]; file_index++)
-    {
-        for (path_index = 0; NULL != paths[path_index]; path_index++)
-        {
-            /* this is done using the stat call */
-            if (NULL != prefix)
-            {
-                sprintf(scratch, "%s/%s/%s", prefix, paths[path_index], files[file_index]);
-            }
-            else
-            {
-                sprintf(scratch, "%s/%s", paths[path_index], files[file_index]);
-            }
-
-                // TODO: need to wire this up
-			{
-				// ugly hack - simulate a call to getattr
-				struct lo_inode {
-					struct lo_inode *next;
-					struct lo_inode *prev;
-					int fd;
-					ino_t ino;
-					dev_t dev;
-					uint64_t nlookup;
-				};
-
-			}
-			finesse_original_ops.getattr();
-            if (0 == stat(scratch, &stat_buf))
-            {
-                // found it
-                // TODO: may want to make this more resilient against "wrong kind of content" errors
-                *file_found = files[file_index];
-                *path_found = paths[path_index];
-                return 0;
-            }
-        }
-    }
-
-    return -1;
-}
-
-static char **get_env_path(void)
-{
-    const char *path = getenv("PATH");
-    size_t path_len;
-    char *path_copy = NULL;
-    unsigned index;
-    unsigned index2;
-    unsigned count;
-    char **paths = NULL;
-    char *cwd = NULL;
-
-    assert(NULL != path);
-
-    path_len = strlen(path);
-    path_copy = malloc(path_len + pathconf(".", _PC_PATH_MAX) + 2);
-    assert(NULL != path_copy);
-    strcpy(path_copy, path);
-    assert(':' != path_copy[0]); // don't handle this case now
-    cwd = getcwd(&path_copy[path_len + 2], pathconf(".", _PC_PATH_MAX + 1));
-    assert(NULL != cwd);
-
-    count = 0;
-    // skip char 0 because if it is a colon then there's nothing in front of it anyway
-    for (index = 0; index < path_len; index++)
-    {
-        if (':' == path_copy[index])
-        {
-            count++;
-        }
-    }
-
-    index2 = 0;
-    paths = (char **)malloc(sizeof(char *) * (count + 1));
-    assert(NULL != paths);
-    paths[0] = path_copy;
-    for (index = 0; index < path_len; index++)
-    {
-        if (':' == path_copy[index])
-        {
-            path_copy[index] = '\0';
-            assert(':' != path_copy[index + 1]); // don't handle this case
-            if (0 == strcmp(paths[index2], "."))
-            {
-                paths[++index2] = cwd;
-            }
-            else
-            {
-                paths[++index2] = &path_copy[index + 1];
-            }
-        }
-    }
-    assert(index2 == count);
-    paths[index2] = NULL;
-
-    return paths;
-}
-
-static void
-lib_search_internal(char *prefix)
-{
-    char *file_found, *path_found;
-    char *files_to_find[2];
-    static unsigned file_to_use = 0;
-    if (NULL == files_in_path[file_to_use])
-    {
-        file_to_use = 0;
-    }
-
-    assert(NULL != ld_library_path);
-
-    /* now let's search it for a list of things */
-
-    files_to_find[0] = libs_in_path[file_to_use];
-    files_to_find[1] = NULL;
-
-    (void)find_file_in_path(files_to_find, ld_library_path, prefix, &file_found, &path_found);
-
-    file_to_use++;
-}
-
-static void
-path_search_internal(char *prefix)
-{
-    static char **paths;
-    char *file_found, *path_found;
-    char *files_to_find[2];
-    unsigned found, not_found;
-    // unsigned index;
-    static unsigned file_to_use = 0;
-
-    if (NULL == paths)
-    {
-        paths = get_env_path();
-    }
-
-    if (NULL == files_in_path[file_to_use])
-    {
-        file_to_use = 0;
-    }
-
-    files_to_find[0] = files_in_path[file_to_use];
-    files_to_find[1] = NULL;
-
-    (void)find_file_in_path(files_to_find, paths, prefix, &file_found, &path_found);
-
-    file_to_use++;
-}
-
-// this is a search test to simulate until I get the marshalling/unmarshalling code done
-void finesse_test_search(void)
-{
-    lib_search_internal(NULL);
-    // path_search_internal(NULL);
-}
-#endif // 0
+/*
+ * (C) Copyright 2017-2020 Tony Mason
+ * All Rights Reserved
+ */
+
+#include "api-internal.h"
+
+#include <limits.h>
+
+//
+// Given a list of names and a list of directories, find where the names are.  The search
+// goes directory by directory and, within a directory, name by name - the order a compiler
+// walks its include path or the loader its library path.  Directories on a Finesse file
+// system are searched by the server (one message for as many directories as will fit);
+// anything else, and anything the server can't decide (symlinks, ".."), is probed here.
+//
+
+static int search_probe(const char *path, const char *file, struct stat *statbuf)
+{
+    char   scratch[PATH_MAX];
+    size_t length;
+
+    if ('\0' == path[0]) {
+        // empty entry means the current directory
+        length = (size_t)snprintf(scratch, sizeof(scratch), "%s", file);
+    }
+    else {
+        length = (size_t)snprintf(scratch, sizeof(scratch), "%s/%s", path, file);
+    }
+
+    if (length >= sizeof(scratch)) {
+        return ENAMETOOLONG;
+    }
+
+    if (0 != fin_stat(scratch, statbuf)) {
+        return errno;
+    }
+
+    if (S_ISDIR(statbuf->st_mode)) {
+        return EISDIR;
+    }
+
+    return 0;
+}
+
+typedef struct {
+    finesse_path_search_match_t *matches;
+    unsigned                     match_count;
+    unsigned                     match_max;
+    int                          first_only;
+    int                          truncated;
+} search_state_t;
+
+// returns non-zero when the search is done
+static int search_add(search_state_t *State, unsigned FileIndex, unsigned PathIndex, uint32_t Mode)
+{
+    if (State->match_count == State->match_max) {
+        State->truncated = 1;
+        return 1;
+    }
+
+    State->matches[State->match_count].FileIndex = (uint16_t)FileIndex;
+    State->matches[State->match_count].PathIndex = (uint16_t)PathIndex;
+    State->matches[State->match_count].Mode      = Mode;
+    State->match_count++;
+
+    return State->first_only;
+}
+
+static int search_native(search_state_t *State, const char **Files, const char *Path, unsigned PathIndex)
+{
+    struct stat statbuf;
+
+    for (unsigned file_index = 0; NULL != Files[file_index]; file_index++) {
+        if ((0 == search_probe(Path, Files[file_index], &statbuf)) &&
+            search_add(State, file_index, PathIndex, statbuf.st_mode)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+//
+// Ask the server to search Paths[First..Last) for Files, as few messages as it takes.
+//
+static int search_remote(search_state_t *State, finesse_client_handle_t Client, const char **Files, unsigned FileCount,
+                         const char **Paths, unsigned First, unsigned Last)
+{
+    const size_t                limit      = FINESSE_MAX_MESSAGE_DATA_LENGTH;
+    const char *                no_paths[] = {NULL};
+    const char *                chunk[FINESSE_PATH_SEARCH_MAX_MATCHES + 1];
+    finesse_path_search_match_t matches[FINESSE_PATH_SEARCH_MAX_MATCHES];
+    fincomm_message             message;
+    struct stat                 statbuf;
+    size_t                      files_size;
+    size_t                      size;
+    unsigned                    chunk_count;
+    unsigned                    match_count;
+    unsigned                    path_index;
+    int                         status;
+    int                         result;
+    int                         done = 0;
+
+    files_size = FinesseGetPathSearchRequestSize(Files, no_paths);
+
+    while ((First < Last) && !done) {
+        // Take as many directories as fit in one request
+        size = files_size;
+        for (chunk_count = 0; First + chunk_count < Last; chunk_count++) {
+            size += strlen(Paths[First + chunk_count]) + 1;
+            if ((size > limit) || ((chunk_count + 1) * FileCount > FINESSE_PATH_SEARCH_MAX_MATCHES)) {
+                break;
+            }
+            chunk[chunk_count] = Paths[First + chunk_count];
+        }
+
+        if (0 == chunk_count) {
+            // Too many (or too long) names for even one directory; do it here
+            done = search_native(State, Files, Paths[First], First);
+            First++;
+            continue;
+        }
+        chunk[chunk_count] = NULL;
+
+        status = FinesseSendPathSearchRequest(Client, Files, chunk, State->first_only ? 0 : FINESSE_PATH_SEARCH_ALL, &message);
+        assert(0 == status);
+        match_count = FINESSE_PATH_SEARCH_MAX_MATCHES;
+        status      = FinesseGetPathSearchResponse(Client, message, matches, &match_count, &result);
+        assert(0 == status);
+        FinesseFreePathSearchResponse(Client, message);
+
+        if (0 != result) {
+            // e.g. an older server; search these directories ourselves
+            for (unsigned index = 0; (index < chunk_count) && !done; index++) {
+                done = search_native(State, Files, chunk[index], First + index);
+            }
+            First += chunk_count;
+            continue;
+        }
+
+        for (unsigned index = 0; (index < match_count) && !done; index++) {
+            assert(matches[index].PathIndex < chunk_count);
+            path_index = First + matches[index].PathIndex;
+
+            if (FINESSE_PATH_SEARCH_UNRESOLVED == matches[index].FileIndex) {
+                done = search_native(State, Files, Paths[path_index], path_index);
+                continue;
+            }
+
+            assert(matches[index].FileIndex < FileCount);
+            if (S_ISLNK(matches[index].Mode)) {
+                // a link out of the mount, which the server leaves to us
+                if (0 == search_probe(Paths[path_index], Files[matches[index].FileIndex], &statbuf)) {
+                    done = search_add(State, matches[index].FileIndex, path_index, statbuf.st_mode);
+                }
+                continue;
+            }
+
+            done = search_add(State, matches[index].FileIndex, path_index, matches[index].Mode);
+        }
+
+        First += chunk_count;
+    }
+
+    return done;
+}
+
+static void search_path(search_state_t *State, const char **Files, const char **Paths)
+{
+    finesse_client_handle_t client, next;
+    unsigned                file_count, path_count;
+    unsigned                first;
+    int                     done = 0;
+
+    for (file_count = 0; NULL != Files[file_count]; file_count++) {
+        ;
+    }
+
+    for (path_count = 0; NULL != Paths[path_count]; path_count++) {
+        ;
+    }
+
+    assert(file_count < FINESSE_PATH_SEARCH_UNRESOLVED);
+    assert(path_count < FINESSE_PATH_SEARCH_UNRESOLVED);
+
+    if (0 == file_count) {
+        return;  // nothing to find (and the server won't take an empty list)
+    }
+
+    for (unsigned path_index = 0; (path_index < path_count) && !done;) {
+        client = NULL;
+        if ('/' == Paths[path_index][0]) {
+            client = finesse_check_prefix(Paths[path_index]);
+        }
+
+        if (NULL == client) {
+            done = search_native(State, Files, Paths[path_index], path_index);
+            path_index++;
+            continue;
+        }
+
+        // Hand the server the whole run of directories it is responsible for
+        first = path_index;
+        for (path_index++; path_index < path_count; path_index++) {
+            next = NULL;
+            if ('/' == Paths[path_index][0]) {
+                next = finesse_check_prefix(Paths[path_index]);
+            }
+            if (next != client) {
+                break;
+            }
+        }
+
+        done = search_remote(State, client, Files, file_count, Paths, first, path_index);
+    }
+}
+
+//
+// Find the first of Files in Paths (both NULL terminated).  Returns 0 and the indices of the
+// match, or -1 with errno set to ENOENT.
+//
+int finesse_search_path(const char **Files, const char **Paths, unsigned *FileIndex, unsigned *PathIndex)
+{
+    finesse_path_search_match_t match;
+    search_state_t              state = {
+        .matches     = &match,
+        .match_count = 0,
+        .match_max   = 1,
+        .first_only  = 1,
+        .truncated   = 0,
+    };
+
+    search_path(&state, Files, Paths);
+
+    if (0 == state.match_count) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    *FileIndex = match.FileIndex;
+    *PathIndex = match.PathIndex;
+    return 0;
+}
+
+//
+// Find every occurrence of Files in Paths, in search order.  On entry *MatchCount is the size
+// of Matches; on return it is the number found.  Returns -1 with errno set to E2BIG if there
+// were more matches than room for them.
+//
+int finesse_search_path_all(const char **Files, const char **Paths, finesse_path_search_match_t *Matches, unsigned *MatchCount)
+{
+    search_state_t state = {
+        .matches     = Matches,
+        .match_count = 0,
+        .match_max   = *MatchCount,
+        .first_only  = 0,
+        .truncated   = 0,
+    };
+
+    search_path(&state, Files, Paths);
+
+    *MatchCount = state.match_count;
+    if (state.truncated) {
+        errno = E2BIG;
+        return -1;
+    }
+
+    return 0;
+}
+
+//
+// execvp/execvpe: do the PATH search with one request per Finesse file system, then exec the
+// full path name.  This is opt-in (set FINESSE_PATH_SEARCH in the environment) because the
+// search can't see exec permission; a match we can't run just moves us on to the next one,
+// as the C library does.
+//
+static const char *finesse_path_search_env = "FINESSE_PATH_SEARCH";
+
+int finesse_execvpe(const char *file, char *const argv[], char *const envp[])
+{
+    typedef int (*orig_execvpe_t)(const char *file, char *const argv[], char *const envp[]);
+    static orig_execvpe_t       orig_execvpe = NULL;
+    const char *                enabled      = getenv(finesse_path_search_env);
+    const char *                path         = NULL;
+    char *                      path_copy    = NULL;
+    const char **               paths        = NULL;
+    const char *                files[2]     = {file, NULL};
+    finesse_path_search_match_t matches[64];
+    unsigned                    match_count = sizeof(matches) / sizeof(matches[0]);
+    unsigned                    path_count;
+    char                        scratch[PATH_MAX];
+    int                         saw_eacces = 0;
+    int                         status     = 0;
+
+    if (NULL == orig_execvpe) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+        orig_execvpe = (orig_execvpe_t)dlsym(RTLD_NEXT, "execvpe");
+#pragma GCC diagnostic pop
+        assert(NULL != orig_execvpe);
+    }
+
+    if ((NULL == enabled) || ('\0' == enabled[0]) || (0 == strcmp(enabled, "0")) || ('\0' == file[0]) ||
+        (NULL != index(file, '/'))) {
+        return orig_execvpe(file, argv, envp);
+    }
+
+    path = getenv("PATH");
+    if (NULL == path) {
+        path = "/bin:/usr/bin";  // the C library's default
+    }
+
+    path_copy = strdup(path);
+    if (NULL == path_copy) {
+        return orig_execvpe(file, argv, envp);
+    }
+
+    path_count = 1;
+    for (const char *cursor = path_copy; '\0' != *cursor; cursor++) {
+        if (':' == *cursor) {
+            path_count++;
+        }
+    }
+
+    paths = malloc((path_count + 1) * sizeof(const char *));
+    if (NULL == paths) {
+        free(path_copy);
+        return orig_execvpe(file, argv, envp);
+    }
+
+    paths[0] = path_copy;
+    for (unsigned path_index = 1; path_index < path_count; path_index++) {
+        char *sep = strchr(paths[path_index - 1], ':');
+
+        assert(NULL != sep);
+        *sep              = '\0';
+        paths[path_index] = sep + 1;
+    }
+    paths[path_count] = NULL;
+
+    status = finesse_search_path_all(files, paths, matches, &match_count);
+    if (0 != status) {
+        // More candidates than we have room for: let the C library do it
+        free(path_copy);
+        free(paths);
+        return orig_execvpe(file, argv, envp);
+    }
+
+    status = ENOENT;
+    for (unsigned match_index = 0; match_index < match_count; match_index++) {
+        const char *dir = paths[matches[match_index].PathIndex];
+
+        if ((size_t)snprintf(scratch, sizeof(scratch), "%s%s%s", dir, '\0' == dir[0] ? "" : "/", file) >= sizeof(scratch)) {
+            continue;
+        }
+
+        // The name has a '/' in it, so this is a plain exec (including the /bin/sh fallback)
+        (void)orig_execvpe(scratch, argv, envp);
+        status = errno;
+
+        if (EACCES == status) {
+            saw_eacces = 1;
+            continue;
+        }
+
+        if ((ENOENT != status) && (ENOTDIR != status) && (ESTALE != status) && (ENODEV != status) && (ETIMEDOUT != status)) {
+            // a real failure; report it
+            saw_eacces = 0;
+            break;
+        }
+    }
+
+    free(path_copy);
+    free(paths);
+
+    errno = saw_eacces ? EACCES : status;
+    return -1;
+}
+
+int finesse_execvp(const char *file, char *const argv[])
+{
+    return finesse_execvpe(file, argv, environ);
+}
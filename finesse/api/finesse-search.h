@@ -1,11 +0,0 @@
-/*
- * (C) Copyright 2017 Tony Mason
- * All Rights Reserved
-*/
-
-#if !defined(__FINESSE_SEARCH_H__)
-#define __FINESSE_SEARCH_H__ (1)
-
-// extern int finesse_process_search_request(finesse_path_search_request_t *search_request, finesse_path_search_response_t **search_response);
-
-#endif // __FINESSE_SEARCH_H__
@@ -148,6 +148,7 @@ static void finesse_real_shutdown(void)
         FILE *                         log       = NULL;
         finesse_api_call_statistics_t *callstats = FinesseApiGetCallStatistics();
         const char *                   calldata  = FinesseApiFormatCallData(callstats, 0);
+        const char *                   latency   = FinesseApiFormatCallLatency(callstats, 0);
         const char *                   log_name  = getenv(call_stat_log_env);
         const char *                   log_dir   = getenv(call_stat_log_dir_env);
         int                            retval;
@@ -180,8 +181,12 @@ static void finesse_real_shutdown(void)
 
         assert(NULL != log);
         fprintf(log, "%s\n", calldata);
+        if (NULL != latency) {
+            fprintf(log, "%s\n", latency);
+        }
         fclose(log);
         FinesseApiFreeFormattedCallData(calldata);
+        FinesseApiFreeFormattedCallData(latency);
         FinesseApiReleaseCallStatistics(callstats);
     }
 }
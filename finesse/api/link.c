@@ -0,0 +1,237 @@
+/*
+ * (C) Copyright 2020 Tony Mason
+ * All Rights Reserved
+ */
+
+#include "api-internal.h"
+#include "callstats.h"
+
+static int fin_link(const char *oldpath, const char *newpath)
+{
+    typedef int (*orig_link_t)(const char *oldpath, const char *newpath);
+    static orig_link_t orig_link = NULL;
+
+    if (NULL == orig_link) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+        orig_link = (orig_link_t)dlsym(RTLD_NEXT, "link");
+#pragma GCC diagnostic pop
+
+        assert(NULL != orig_link);
+        if (NULL == orig_link) {
+            return EACCES;
+        }
+    }
+
+    return orig_link(oldpath, newpath);
+}
+
+static int fin_symlink(const char *target, const char *linkpath)
+{
+    typedef int (*orig_symlink_t)(const char *target, const char *linkpath);
+    static orig_symlink_t orig_symlink = NULL;
+
+    if (NULL == orig_symlink) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+        orig_symlink = (orig_symlink_t)dlsym(RTLD_NEXT, "symlink");
+#pragma GCC diagnostic pop
+
+        assert(NULL != orig_symlink);
+        if (NULL == orig_symlink) {
+            return EACCES;
+        }
+    }
+
+    return orig_symlink(target, linkpath);
+}
+
+static ssize_t fin_readlink(const char *pathname, char *buf, size_t bufsiz)
+{
+    typedef ssize_t (*orig_readlink_t)(const char *pathname, char *buf, size_t bufsiz);
+    static orig_readlink_t orig_readlink = NULL;
+
+    if (NULL == orig_readlink) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+        orig_readlink = (orig_readlink_t)dlsym(RTLD_NEXT, "readlink");
+#pragma GCC diagnostic pop
+
+        assert(NULL != orig_readlink);
+        if (NULL == orig_readlink) {
+            return EACCES;
+        }
+    }
+
+    return orig_readlink(pathname, buf, bufsiz);
+}
+
+static int internal_link(const char *oldpath, const char *newpath)
+{
+    fincomm_message         message;
+    finesse_client_handle_t finesse_client_handle = NULL;
+    int                     result;
+    int                     status;
+    DECLARE_TIME(FINESSE_API_CALL_LINK)
+
+    START_TIME
+
+    finesse_client_handle = finesse_check_prefix(oldpath);
+    if (finesse_client_handle != finesse_check_prefix(newpath)) {
+        // Across file systems (EXDEV) is the C library's business
+        finesse_client_handle = NULL;
+    }
+
+    STOP_FINESSE_TIME
+
+    if (NULL != finesse_client_handle) {
+        START_TIME
+
+        status = FinesseSendLinkRequest(finesse_client_handle, NULL, oldpath, NULL, newpath, &message);
+        if (0 == status) {
+            status = FinesseGetNamespaceResponse(finesse_client_handle, message, &result);
+            assert(0 == status);
+            FinesseFreeNamespaceResponse(finesse_client_handle, message);
+
+            STOP_FINESSE_TIME
+
+            if (!finesse_use_native(result)) {
+                if (0 != result) {
+                    errno = result;
+                    return -1;
+                }
+                return 0;
+            }
+        }
+    }
+
+    // not of interest, or the server can't do it - fallback
+    START_TIME
+
+    status = fin_link(oldpath, newpath);
+
+    STOP_NATIVE_TIME
+
+    return status;
+}
+
+int finesse_link(const char *oldpath, const char *newpath)
+{
+    int status = internal_link(oldpath, newpath);
+
+    FinesseApiCountCall(FINESSE_API_CALL_LINK, 0 == status);
+
+    return status;
+}
+
+//
+// Only where the link goes matters; what it points to is just a string.
+//
+static int internal_symlink(const char *target, const char *linkpath)
+{
+    fincomm_message         message;
+    finesse_client_handle_t finesse_client_handle = NULL;
+    int                     result;
+    int                     status;
+    DECLARE_TIME(FINESSE_API_CALL_SYMLINK)
+
+    START_TIME
+
+    finesse_client_handle = finesse_check_prefix(linkpath);
+
+    STOP_FINESSE_TIME
+
+    if (NULL != finesse_client_handle) {
+        START_TIME
+
+        status = FinesseSendSymlinkRequest(finesse_client_handle, target, NULL, linkpath, &message);
+        if (0 == status) {
+            status = FinesseGetNamespaceResponse(finesse_client_handle, message, &result);
+            assert(0 == status);
+            FinesseFreeNamespaceResponse(finesse_client_handle, message);
+
+            STOP_FINESSE_TIME
+
+            if (!finesse_use_native(result)) {
+                if (0 != result) {
+                    errno = result;
+                    return -1;
+                }
+                return 0;
+            }
+        }
+    }
+
+    // not of interest, or the server can't do it - fallback
+    START_TIME
+
+    status = fin_symlink(target, linkpath);
+
+    STOP_NATIVE_TIME
+
+    return status;
+}
+
+int finesse_symlink(const char *target, const char *linkpath)
+{
+    int status = internal_symlink(target, linkpath);
+
+    FinesseApiCountCall(FINESSE_API_CALL_SYMLINK, 0 == status);
+
+    return status;
+}
+
+static ssize_t internal_readlink(const char *pathname, char *buf, size_t bufsiz)
+{
+    fincomm_message         message;
+    finesse_client_handle_t finesse_client_handle = NULL;
+    ssize_t                 length;
+    int                     result;
+    int                     status;
+    DECLARE_TIME(FINESSE_API_CALL_READLINK)
+
+    START_TIME
+
+    finesse_client_handle = finesse_check_prefix(pathname);
+
+    STOP_FINESSE_TIME
+
+    if (NULL != finesse_client_handle) {
+        START_TIME
+
+        status = FinesseSendReadlinkRequest(finesse_client_handle, NULL, pathname, &message);
+        if (0 == status) {
+            status = FinesseGetReadlinkResponse(finesse_client_handle, message, buf, bufsiz, &length, &result);
+            assert(0 == status);
+            FinesseFreeReadlinkResponse(finesse_client_handle, message);
+
+            STOP_FINESSE_TIME
+
+            if (!finesse_use_native(result)) {
+                if (0 != result) {
+                    errno = result;
+                    return -1;
+                }
+                return length;
+            }
+        }
+    }
+
+    // not of interest, or the server can't do it - fallback
+    START_TIME
+
+    length = fin_readlink(pathname, buf, bufsiz);
+
+    STOP_NATIVE_TIME
+
+    return length;
+}
+
+ssize_t finesse_readlink(const char *pathname, char *buf, size_t bufsiz)
+{
+    ssize_t length = internal_readlink(pathname, buf, bufsiz);
+
+    FinesseApiCountCall(FINESSE_API_CALL_READLINK, length >= 0);
+
+    return length;
+}
@@ -48,8 +48,47 @@ static int fin_mkdirat(int fd, const char *path, mode_t mode)
 
 static int internal_mkdir(const char *path, mode_t mode)
 {
-    // TODO: implement this as a Finesse call
-    return fin_mkdir(path, mode);
+    fincomm_message         message;
+    finesse_client_handle_t finesse_client_handle = NULL;
+    int                     result;
+    int                     status;
+    DECLARE_TIME(FINESSE_API_CALL_MKDIR)
+
+    START_TIME
+
+    finesse_client_handle = finesse_check_prefix(path);
+
+    STOP_FINESSE_TIME
+
+    if (NULL != finesse_client_handle) {
+        START_TIME
+
+        status = FinesseSendMkdirRequest(finesse_client_handle, NULL, path, mode & ~finesse_get_umask(), &message);
+        if (0 == status) {
+            status = FinesseGetNamespaceResponse(finesse_client_handle, message, &result);
+            assert(0 == status);
+            FinesseFreeNamespaceResponse(finesse_client_handle, message);
+
+            STOP_FINESSE_TIME
+
+            if (!finesse_use_native(result)) {
+                if (0 != result) {
+                    errno = result;
+                    return -1;
+                }
+                return 0;
+            }
+        }
+    }
+
+    // not of interest, or the server can't do it - fallback
+    START_TIME
+
+    status = fin_mkdir(path, mode);
+
+    STOP_NATIVE_TIME
+
+    return status;
 }
 
 int finesse_mkdir(const char *path, mode_t mode)
@@ -64,7 +103,12 @@ int finesse_mkdir(const char *path, mode_t mode)
 
 static int internal_mkdirat(int fd, const char *path, mode_t mode)
 {
-    // TODO: implement this as a Finesse call
+    if ((AT_FDCWD == fd) || ('/' == *path)) {
+        // Absolute path name (or one relative to the cwd, which the prefix check will decide)
+        return internal_mkdir(path, mode);
+    }
+
+    // TODO: names relative to a directory we know about
     return fin_mkdirat(fd, path, mode);
 }
 
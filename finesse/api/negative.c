@@ -0,0 +1,256 @@
+/*
+ * (C) Copyright 2020 Tony Mason
+ * All Rights Reserved
+ */
+
+#include "api-internal.h"
+
+//
+// A short lived cache of the paths the server told us don't exist, so that a program probing
+// for the same missing file over and over (a build checking for a file it hasn't written yet,
+// a loader trying each directory) doesn't send a message each time.
+//
+// An entry is dropped when it expires or when the server's invalidation ring (see fincomm.h)
+// reports a change to a name that is one of the entry's path components: we can't map the
+// event's parent back to a path, so the name has to do.  Anything we can't match exactly (a
+// name too long for the event, or a ring that overflowed) drops everything for that server.
+//
+// A path the server resolved through a symbolic link is the one case the names can't cover:
+// creating something the link points at (say the missing directory a dangling link names) reports
+// a name that need not be in our path.  We aren't told which answers went through a link, so such
+// an entry is only as fresh as its lifetime; set FINESSE_NEGATIVE_CACHE to 0 where that matters.
+//
+// The lifetime (in milliseconds) is set with FINESSE_NEGATIVE_CACHE, 0 disables the cache.
+//
+static const char *finesse_negative_cache_env = "FINESSE_NEGATIVE_CACHE";
+
+#define FINESSE_NEGATIVE_CACHE_DEFAULT_MS (1000)
+#define FINESSE_NEGATIVE_CACHE_ENTRIES (256)
+#define FINESSE_NEGATIVE_CACHE_CLIENTS (16)
+#define FINESSE_NEGATIVE_CACHE_PATH (256)
+
+typedef struct {
+    finesse_client_handle_t client;  // NULL = unused
+    uint64_t                expires;
+    char                    path[FINESSE_NEGATIVE_CACHE_PATH];
+} negative_entry_t;
+
+typedef struct {
+    finesse_client_handle_t client;
+    uint64_t                cursor;  // the next invalidation to look at
+} negative_client_t;
+
+static pthread_mutex_t   negative_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t    negative_once = PTHREAD_ONCE_INIT;
+static uint64_t          negative_timeout;  // in ns, 0 = disabled
+static negative_client_t negative_clients[FINESSE_NEGATIVE_CACHE_CLIENTS];
+static negative_entry_t  negative_entries[FINESSE_NEGATIVE_CACHE_ENTRIES];
+
+static void negative_init(void)
+{
+    const char *timeout = getenv(finesse_negative_cache_env);
+
+    negative_timeout = (uint64_t)FINESSE_NEGATIVE_CACHE_DEFAULT_MS * 1000000;
+    if (NULL != timeout) {
+        negative_timeout = (uint64_t)strtoul(timeout, NULL, 0) * 1000000;
+    }
+}
+
+static uint64_t negative_now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+static unsigned negative_slot(finesse_client_handle_t client, const char *path)
+{
+    uint64_t hash = (uint64_t)(uintptr_t)client;
+
+    // FNV-1a
+    hash ^= 0xcbf29ce484222325ull;
+    while ('\0' != *path) {
+        hash ^= (unsigned char)*path++;
+        hash *= 0x100000001b3ull;
+    }
+
+    return (unsigned)(hash % FINESSE_NEGATIVE_CACHE_ENTRIES);
+}
+
+// Is name one of path's components?
+static int negative_path_uses(const char *path, const char *name, size_t length)
+{
+    const char *cursor = path;
+
+    while (NULL != (cursor = index(cursor, '/'))) {
+        cursor++;
+        if ((0 == strncmp(cursor, name, length)) && (('/' == cursor[length]) || ('\0' == cursor[length]))) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// Does this invalidation (possibly) change what path refers to?
+static int negative_event_matches(const finesse_invalidation_t *event, const char *path)
+{
+    if (FINESSE_INVALIDATE_INODE == event->Type) {
+        return 0;  // attributes only; names are unchanged
+    }
+
+    if (event->NameLength > FINESSE_INVALIDATION_NAME_LENGTH) {
+        return 1;  // could be any name
+    }
+
+    return negative_path_uses(path, event->Name, event->NameLength);
+}
+
+// These are called with the lock held
+static void negative_flush(finesse_client_handle_t client)
+{
+    for (unsigned index = 0; index < FINESSE_NEGATIVE_CACHE_ENTRIES; index++) {
+        if (client == negative_entries[index].client) {
+            negative_entries[index].client = NULL;
+        }
+    }
+}
+
+static negative_client_t *negative_get_client(finesse_client_handle_t client)
+{
+    negative_client_t *free_slot = NULL;
+
+    for (unsigned index = 0; index < FINESSE_NEGATIVE_CACHE_CLIENTS; index++) {
+        if (client == negative_clients[index].client) {
+            return &negative_clients[index];
+        }
+
+        if ((NULL == free_slot) && (NULL == negative_clients[index].client)) {
+            free_slot = &negative_clients[index];
+        }
+    }
+
+    if (NULL != free_slot) {
+        free_slot->client = client;
+        free_slot->cursor = FinesseGetInvalidationCursor(client);
+    }
+
+    return free_slot;  // NULL if there are too many servers; we just don't cache for this one
+}
+
+// Apply whatever the server has posted since we last looked
+static negative_client_t *negative_drain(finesse_client_handle_t client)
+{
+    negative_client_t *    record = negative_get_client(client);
+    finesse_invalidation_t events[8];
+    unsigned               count = 0;
+
+    while (NULL != record) {
+        if (EOVERFLOW == FinesseGetInvalidations(client, &record->cursor, events, 8, &count)) {
+            negative_flush(client);
+            break;
+        }
+
+        for (unsigned event = 0; event < count; event++) {
+            for (unsigned index = 0; index < FINESSE_NEGATIVE_CACHE_ENTRIES; index++) {
+                if ((client == negative_entries[index].client) &&
+                    negative_event_matches(&events[event], negative_entries[index].path)) {
+                    negative_entries[index].client = NULL;
+                }
+            }
+        }
+
+        if (count < 8) {
+            break;
+        }
+    }
+
+    return record;
+}
+
+//
+// Returns 1 if path is known not to exist.  Otherwise *since is set to pass to
+// finesse_negative_add if the server says it doesn't.
+//
+int finesse_negative_lookup(finesse_client_handle_t client, const char *path, uint64_t *since)
+{
+    negative_client_t *record;
+    negative_entry_t * entry;
+    int                hit = 0;
+
+    pthread_once(&negative_once, negative_init);
+
+    *since = UINT64_MAX;
+    if ((0 == negative_timeout) || (strlen(path) >= FINESSE_NEGATIVE_CACHE_PATH)) {
+        return 0;
+    }
+
+    entry = &negative_entries[negative_slot(client, path)];
+
+    pthread_mutex_lock(&negative_lock);
+    record = negative_drain(client);
+    if (NULL != record) {
+        *since = record->cursor;
+
+        if ((client == entry->client) && (0 == strcmp(path, entry->path))) {
+            if (negative_now() < entry->expires) {
+                hit = 1;
+            }
+            else {
+                entry->client = NULL;
+            }
+        }
+    }
+    pthread_mutex_unlock(&negative_lock);
+
+    return hit;
+}
+
+//
+// The server said path doesn't exist.  If anything that could have changed that was posted
+// since the request went out (since, from finesse_negative_lookup), the answer may already be
+// stale, so it isn't kept.
+//
+void finesse_negative_add(finesse_client_handle_t client, const char *path, uint64_t since)
+{
+    negative_entry_t *     entry;
+    finesse_invalidation_t events[8];
+    unsigned               count = 0;
+    int                    stale = 0;
+
+    pthread_once(&negative_once, negative_init);
+
+    if ((0 == negative_timeout) || (UINT64_MAX == since) || (strlen(path) >= FINESSE_NEGATIVE_CACHE_PATH)) {
+        return;
+    }
+
+    entry = &negative_entries[negative_slot(client, path)];
+
+    pthread_mutex_lock(&negative_lock);
+    while (!stale) {
+        // since is our own copy, so this doesn't consume anything
+        if (EOVERFLOW == FinesseGetInvalidations(client, &since, events, 8, &count)) {
+            stale = 1;
+            break;
+        }
+
+        for (unsigned event = 0; event < count; event++) {
+            if (negative_event_matches(&events[event], path)) {
+                stale = 1;
+                break;
+            }
+        }
+
+        if (count < 8) {
+            break;
+        }
+    }
+
+    if (!stale && (NULL != negative_drain(client))) {
+        entry->client  = client;
+        entry->expires = negative_now() + negative_timeout;
+        strcpy(entry->path, path);
+    }
+    pthread_mutex_unlock(&negative_lock);
+}
@@ -22,7 +22,7 @@ struct map_name_args {
     int *       status;
 };
 
-static int fin_open(const char *pathname, int flags, ...)
+int fin_open(const char *pathname, int flags, ...)
 {
     typedef int (*orig_open_t)(const char *pathname, int flags, ...);
     static orig_open_t orig_open = NULL;
@@ -76,7 +76,7 @@ static int fin_openat(int dirfd, const char *pathname, int flags, ...)
     return orig_openat(dirfd, pathname, flags, mode);
 }
 
-static int fin_close(int fd)
+int fin_close(int fd)
 {
     typedef int (*orig_close_t)(int fd);
     static orig_close_t orig_close = NULL;
@@ -99,6 +99,53 @@ static int fin_close(int fd)
     return orig_close(fd);
 }
 
+//
+// Returns -1 (with errno set) or 0 if the file is there (made by the server or, without O_EXCL,
+// already there), and 1 if the C library has to do the whole open.
+//
+static int internal_create(finesse_client_handle_t client_handle, const char *pathname, int flags, mode_t mode)
+{
+    int             status;
+    int             result;
+    fincomm_message message = NULL;
+    struct stat     attr;
+    uuid_t          key;
+    uint64_t        generation;
+    double          timeout;
+    DECLARE_TIME(FINESSE_API_CALL_CREAT)
+
+    if (0 != (flags & (O_TMPFILE | O_DIRECTORY))) {
+        return 1;
+    }
+
+    START_TIME
+
+    memset(&attr, 0, sizeof(attr));
+    attr.st_mode = S_IFREG | (mode & ~finesse_get_umask() & 07777);
+
+    status = FinesseSendCreateRequest(client_handle, NULL, pathname, &attr, flags & O_EXCL, &message);
+    if (0 != status) {
+        return 1;
+    }
+
+    status = FinesseGetCreateResponse(client_handle, message, &key, &generation, &attr, &timeout, &result);
+    assert(0 == status);
+    FinesseFreeCreateResponse(client_handle, message);
+
+    STOP_FINESSE_TIME
+
+    if (finesse_use_native(result)) {
+        return 1;
+    }
+
+    if (0 != result) {
+        errno = result;
+        return -1;
+    }
+
+    return 0;
+}
+
 static int internal_open(const char *pathname, int flags, mode_t mode)
 {
     int                     fd;
@@ -109,21 +156,6 @@ static int internal_open(const char *pathname, int flags, mode_t mode)
     finesse_file_state_t *  ffs           = NULL;
     DECLARE_TIME(FINESSE_API_CALL_OPEN)
 
-    // Note: for now, we shunt create operations (though we should deal with them when we can)
-    if (O_CREAT & flags) {
-        START_TIME
-
-        status = fin_open(pathname, flags, mode);
-
-        STOP_NATIVE_TIME
-
-        // TODO: if the create is successful, we should name map it here and add it to our tracking
-        // database.
-        fprintf(stderr, "%s: open(%s) with O_CREAT (skipped)\n", __func__, pathname);
-
-        return status;
-    }
-
     //
     // Let's see if it makes sense for us to try opening this
     //
@@ -133,6 +165,24 @@ static int internal_open(const char *pathname, int flags, mode_t mode)
 
     STOP_FINESSE_TIME
 
+    if ((NULL != client_handle) && (O_CREAT & flags)) {
+        // The server creates the file; then it is just an open of an existing file
+        status = internal_create(client_handle, pathname, flags, mode);
+        if (0 > status) {
+            return status;
+        }
+
+        if (0 == status) {
+            fd = internal_open(pathname, flags & ~(O_CREAT | O_EXCL), mode);
+            if ((0 <= fd) || (ENOENT != errno)) {
+                return fd;
+            }
+            // Removed again before we could open it: let the C library sort it out
+        }
+
+        client_handle = NULL;
+    }
+
     if (NULL == client_handle) {
         // not of interest
         START_TIME
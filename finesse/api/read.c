@@ -49,3 +49,122 @@ int finesse_read(int fd, void *buffer, size_t length)
     FinesseApiCountCall(FINESSE_API_CALL_READ, !(status < 0));  // number of bytes, -1 on error
     return status;
 }
+
+// Read the file (from offset on) with the C library; the attributes are only fetched if offset is 0
+static ssize_t read_small_file_native(const char *pathname, void *buf, size_t count, size_t offset, struct stat *statbuf)
+{
+    int     fd;
+    ssize_t length;
+    size_t  total = offset;
+    int     saved_errno;
+
+    fd = fin_open(pathname, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    if ((0 == offset) && (0 != fin_fstat(fd, statbuf))) {
+        saved_errno = errno;
+        fin_close(fd);
+        errno = saved_errno;
+        return -1;
+    }
+
+    while (total < count) {
+        length = pread(fd, (char *)buf + total, count - total, (off_t)total);
+        if (length < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            saved_errno = errno;
+            fin_close(fd);
+            errno = saved_errno;
+            return -1;
+        }
+
+        if (0 == length) {
+            break;
+        }
+        total += (size_t)length;
+    }
+
+    fin_close(fd);
+
+    return (ssize_t)total;
+}
+
+//
+// Read (up to count bytes of) a file and return its attributes, the open+fstat+read+close
+// sequence of a configuration file read or a web server sending a small asset.  On a Finesse
+// file system this is a single compound request; only a file too large for one response
+// goes back to the C library for the rest.  Returns the number of bytes read, or -1 with
+// errno set.
+//
+ssize_t finesse_read_small_file(const char *pathname, void *buf, size_t count, struct stat *statbuf)
+{
+    finesse_client_handle_t   client = NULL;
+    fincomm_message           message;
+    finesse_compound_op_t     ops[6];
+    const char *              names[6];
+    finesse_compound_result_t results[6];
+    unsigned                  op_count = 0;
+    size_t                    length;
+    int                       status;
+    int                       result;
+
+    if (!finesse_api_init_in_progress) {
+        client = finesse_check_prefix(pathname);
+    }
+
+    if ((NULL == client) || (0 == count) || (strlen(pathname) >= FINESSE_COMPOUND_MAX_DATA)) {
+        // Not ours, or nothing to gain (and a zero length READ means "as much as fits")
+        return read_small_file_native(pathname, buf, count, 0, statbuf);
+    }
+
+    memset(ops, 0, sizeof(ops));
+    memset(names, 0, sizeof(names));
+
+    ops[0].Op     = FINESSE_COMPOUND_OP_MAP;
+    ops[0].Flags  = O_RDONLY;
+    names[0]      = pathname;
+    ops[1].Op     = FINESSE_COMPOUND_OP_GETATTR;
+    ops[2].Op     = FINESSE_COMPOUND_OP_OPEN;
+    ops[2].Flags  = O_RDONLY;
+    ops[3].Op     = FINESSE_COMPOUND_OP_READ;
+    ops[3].Offset = 0;
+    ops[3].Length = (uint32_t)(count < FINESSE_COMPOUND_MAX_DATA ? count : FINESSE_COMPOUND_MAX_DATA);
+    ops[4].Op     = FINESSE_COMPOUND_OP_CLOSE;
+    ops[5].Op     = FINESSE_COMPOUND_OP_MAP_RELEASE;
+    op_count      = 6;
+
+    status = FinesseSendCompoundRequest(client, ops, names, op_count, &message);
+    if (0 != status) {
+        return read_small_file_native(pathname, buf, count, 0, statbuf);
+    }
+
+    length = count;
+    status = FinesseGetCompoundResponse(client, message, results, &op_count, NULL, statbuf, buf, &length, &result);
+    assert(0 == status);
+    FinesseFreeCompoundResponse(client, message);
+
+    if ((0 != result) && (1 == op_count) && ((ENOENT == result) || (ENOTDIR == result))) {
+        // The name doesn't exist (the server would have said ENOTSUP if it wasn't sure)
+        errno = result;
+        return -1;
+    }
+
+    if (0 != result) {
+        // The C library will give the right answer (e.g. for a symbolic link the server didn't follow)
+        return read_small_file_native(pathname, buf, count, 0, statbuf);
+    }
+
+    assert(6 == op_count);
+    assert(results[3].Length == length);
+
+    if ((length < count) && ((off_t)length < statbuf->st_size)) {
+        // More than fits in one response
+        return read_small_file_native(pathname, buf, count, length, statbuf);
+    }
+
+    return (ssize_t)length;
+}
@@ -0,0 +1,128 @@
+/*
+ * (C) Copyright 2020 Tony Mason
+ * All Rights Reserved
+ */
+
+#include "api-internal.h"
+#include "callstats.h"
+
+static int fin_rename(const char *oldpath, const char *newpath)
+{
+    typedef int (*orig_rename_t)(const char *oldpath, const char *newpath);
+    static orig_rename_t orig_rename = NULL;
+
+    if (NULL == orig_rename) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+        orig_rename = (orig_rename_t)dlsym(RTLD_NEXT, "rename");
+#pragma GCC diagnostic pop
+
+        assert(NULL != orig_rename);
+        if (NULL == orig_rename) {
+            return EACCES;
+        }
+    }
+
+    return orig_rename(oldpath, newpath);
+}
+
+static int fin_renameat(int olddirfd, const char *oldpath, int newdirfd, const char *newpath)
+{
+    typedef int (*orig_renameat_t)(int olddirfd, const char *oldpath, int newdirfd, const char *newpath);
+    static orig_renameat_t orig_renameat = NULL;
+
+    if (NULL == orig_renameat) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+        orig_renameat = (orig_renameat_t)dlsym(RTLD_NEXT, "renameat");
+#pragma GCC diagnostic pop
+
+        assert(NULL != orig_renameat);
+        if (NULL == orig_renameat) {
+            return EACCES;
+        }
+    }
+
+    return orig_renameat(olddirfd, oldpath, newdirfd, newpath);
+}
+
+//
+// Returns -1 (with errno set) or 0 if the server did it, and 1 if the C library has to.
+//
+static int finesse_rename_request(const char *oldpath, const char *newpath)
+{
+    fincomm_message         message;
+    finesse_client_handle_t finesse_client_handle = NULL;
+    int                     result;
+    int                     status;
+    DECLARE_TIME(FINESSE_API_CALL_RENAME)
+
+    START_TIME
+
+    finesse_client_handle = finesse_check_prefix(oldpath);
+    if (finesse_client_handle != finesse_check_prefix(newpath)) {
+        // Across file systems (EXDEV) is the C library's business
+        finesse_client_handle = NULL;
+    }
+
+    STOP_FINESSE_TIME
+
+    if (NULL == finesse_client_handle) {
+        return 1;
+    }
+
+    START_TIME
+
+    status = FinesseSendRenameRequest(finesse_client_handle, NULL, oldpath, NULL, newpath, 0, &message);
+    if (0 != status) {
+        return 1;
+    }
+
+    status = FinesseGetNamespaceResponse(finesse_client_handle, message, &result);
+    assert(0 == status);
+    FinesseFreeNamespaceResponse(finesse_client_handle, message);
+
+    STOP_FINESSE_TIME
+
+    if (finesse_use_native(result)) {
+        return 1;
+    }
+
+    if (0 != result) {
+        errno = result;
+        return -1;
+    }
+
+    return 0;
+}
+
+int finesse_rename(const char *oldpath, const char *newpath)
+{
+    int status = finesse_rename_request(oldpath, newpath);
+
+    if (status > 0) {
+        status = fin_rename(oldpath, newpath);
+    }
+
+    FinesseApiCountCall(FINESSE_API_CALL_RENAME, 0 == status);
+
+    return status;
+}
+
+int finesse_renameat(int olddirfd, const char *oldpath, int newdirfd, const char *newpath)
+{
+    int status = 1;
+
+    if (((AT_FDCWD == olddirfd) || ('/' == *oldpath)) && ((AT_FDCWD == newdirfd) || ('/' == *newpath))) {
+        // Relative names don't pass the prefix check, so these are either absolute or not ours
+        status = finesse_rename_request(oldpath, newpath);
+    }
+
+    if (status > 0) {
+        status = fin_renameat(olddirfd, oldpath, newdirfd, newpath);
+    }
+
+    FinesseApiCountCall(FINESSE_API_CALL_RENAME, 0 == status);
+
+    return status;
+}
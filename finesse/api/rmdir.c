@@ -0,0 +1,81 @@
+/*
+ * (C) Copyright 2020 Tony Mason
+ * All Rights Reserved
+ */
+
+#include "api-internal.h"
+#include "callstats.h"
+
+static int fin_rmdir(const char *path)
+{
+    typedef int (*orig_rmdir_t)(const char *path);
+    static orig_rmdir_t orig_rmdir = NULL;
+
+    if (NULL == orig_rmdir) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+        orig_rmdir = (orig_rmdir_t)dlsym(RTLD_NEXT, "rmdir");
+#pragma GCC diagnostic pop
+
+        assert(NULL != orig_rmdir);
+        if (NULL == orig_rmdir) {
+            return EACCES;
+        }
+    }
+
+    return orig_rmdir(path);
+}
+
+static int internal_rmdir(const char *path)
+{
+    fincomm_message         message;
+    finesse_client_handle_t finesse_client_handle = NULL;
+    int                     result;
+    int                     status;
+    DECLARE_TIME(FINESSE_API_CALL_RMDIR)
+
+    START_TIME
+
+    finesse_client_handle = finesse_check_prefix(path);
+
+    STOP_FINESSE_TIME
+
+    if (NULL != finesse_client_handle) {
+        START_TIME
+
+        status = FinesseSendRmdirRequest(finesse_client_handle, NULL, path, &message);
+        if (0 == status) {
+            status = FinesseGetNamespaceResponse(finesse_client_handle, message, &result);
+            assert(0 == status);
+            FinesseFreeNamespaceResponse(finesse_client_handle, message);
+
+            STOP_FINESSE_TIME
+
+            if (!finesse_use_native(result)) {
+                if (0 != result) {
+                    errno = result;
+                    return -1;
+                }
+                return 0;
+            }
+        }
+    }
+
+    // not of interest, or the server can't do it - fallback
+    START_TIME
+
+    status = fin_rmdir(path);
+
+    STOP_NATIVE_TIME
+
+    return status;
+}
+
+int finesse_rmdir(const char *path)
+{
+    int status = internal_rmdir(path);
+
+    FinesseApiCountCall(FINESSE_API_CALL_RMDIR, 0 == status);
+
+    return status;
+}
@@ -0,0 +1,253 @@
+/*
+ * (C) Copyright 2020 Tony Mason
+ * All Rights Reserved
+ */
+
+#include "api-internal.h"
+#include "callstats.h"
+
+//
+// chmod, chown, truncate and utimensat all change attributes, so they are all one setattr
+// request to the server.  A symlink at the end of the path is something the server won't
+// follow, so those (like anything else it can't do) come back to the C library.
+//
+
+static int fin_chmod(const char *pathname, mode_t mode)
+{
+    typedef int (*orig_chmod_t)(const char *pathname, mode_t mode);
+    static orig_chmod_t orig_chmod = NULL;
+
+    if (NULL == orig_chmod) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+        orig_chmod = (orig_chmod_t)dlsym(RTLD_NEXT, "chmod");
+#pragma GCC diagnostic pop
+
+        assert(NULL != orig_chmod);
+        if (NULL == orig_chmod) {
+            return EACCES;
+        }
+    }
+
+    return orig_chmod(pathname, mode);
+}
+
+static int fin_chown(const char *pathname, uid_t owner, gid_t group)
+{
+    typedef int (*orig_chown_t)(const char *pathname, uid_t owner, gid_t group);
+    static orig_chown_t orig_chown = NULL;
+
+    if (NULL == orig_chown) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+        orig_chown = (orig_chown_t)dlsym(RTLD_NEXT, "chown");
+#pragma GCC diagnostic pop
+
+        assert(NULL != orig_chown);
+        if (NULL == orig_chown) {
+            return EACCES;
+        }
+    }
+
+    return orig_chown(pathname, owner, group);
+}
+
+static int fin_truncate(const char *path, off_t length)
+{
+    typedef int (*orig_truncate_t)(const char *path, off_t length);
+    static orig_truncate_t orig_truncate = NULL;
+
+    if (NULL == orig_truncate) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+        orig_truncate = (orig_truncate_t)dlsym(RTLD_NEXT, "truncate");
+#pragma GCC diagnostic pop
+
+        assert(NULL != orig_truncate);
+        if (NULL == orig_truncate) {
+            return EACCES;
+        }
+    }
+
+    return orig_truncate(path, length);
+}
+
+static int fin_utimensat(int dirfd, const char *pathname, const struct timespec times[2], int flags)
+{
+    typedef int (*orig_utimensat_t)(int dirfd, const char *pathname, const struct timespec times[2], int flags);
+    static orig_utimensat_t orig_utimensat = NULL;
+
+    if (NULL == orig_utimensat) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+        orig_utimensat = (orig_utimensat_t)dlsym(RTLD_NEXT, "utimensat");
+#pragma GCC diagnostic pop
+
+        assert(NULL != orig_utimensat);
+        if (NULL == orig_utimensat) {
+            return EACCES;
+        }
+    }
+
+    return orig_utimensat(dirfd, pathname, times, flags);
+}
+
+//
+// Returns -1 (with errno set) or 0 if the server did it, and 1 if the C library has to.
+//
+static int internal_setattr(uint8_t Call, const char *pathname, struct stat *attr, int to_set)
+{
+    fincomm_message         message;
+    finesse_client_handle_t finesse_client_handle = NULL;
+    int                     result;
+    int                     status;
+    DECLARE_TIME(Call)
+
+    START_TIME
+
+    finesse_client_handle = finesse_check_prefix(pathname);
+
+    STOP_FINESSE_TIME
+
+    if (NULL == finesse_client_handle) {
+        return 1;
+    }
+
+    START_TIME
+
+    status = FinesseSendSetattrRequest(finesse_client_handle, NULL, pathname, attr, to_set, &message);
+    if (0 != status) {
+        return 1;
+    }
+
+    status = FinesseGetSetattrResponse(finesse_client_handle, message, NULL, &result);
+    assert(0 == status);
+    FinesseFreeSetattrResponse(finesse_client_handle, message);
+
+    STOP_FINESSE_TIME
+
+    if (finesse_use_native(result)) {
+        return 1;
+    }
+
+    if (0 != result) {
+        errno = result;
+        return -1;
+    }
+
+    return 0;
+}
+
+int finesse_chmod(const char *pathname, mode_t mode)
+{
+    struct stat attr;
+    int         status;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.st_mode = mode & 07777;
+
+    status = internal_setattr(FINESSE_API_CALL_CHMOD, pathname, &attr, FUSE_SET_ATTR_MODE);
+    if (status > 0) {
+        status = fin_chmod(pathname, mode);
+    }
+
+    FinesseApiCountCall(FINESSE_API_CALL_CHMOD, 0 == status);
+
+    return status;
+}
+
+int finesse_chown(const char *pathname, uid_t owner, gid_t group)
+{
+    struct stat attr;
+    int         to_set = 0;
+    int         status = 0;
+
+    memset(&attr, 0, sizeof(attr));
+
+    // -1 leaves that one alone
+    if ((uid_t)-1 != owner) {
+        attr.st_uid = owner;
+        to_set |= FUSE_SET_ATTR_UID;
+    }
+
+    if ((gid_t)-1 != group) {
+        attr.st_gid = group;
+        to_set |= FUSE_SET_ATTR_GID;
+    }
+
+    status = internal_setattr(FINESSE_API_CALL_CHOWN, pathname, &attr, to_set);
+    if (status > 0) {
+        status = fin_chown(pathname, owner, group);
+    }
+
+    FinesseApiCountCall(FINESSE_API_CALL_CHOWN, 0 == status);
+
+    return status;
+}
+
+int finesse_truncate(const char *path, off_t length)
+{
+    struct stat attr;
+    int         status;
+
+    if (length < 0) {
+        errno = EINVAL;
+        status = -1;
+    }
+    else {
+        memset(&attr, 0, sizeof(attr));
+        attr.st_size = length;
+
+        status = internal_setattr(FINESSE_API_CALL_TRUNCATE, path, &attr, FUSE_SET_ATTR_SIZE);
+        if (status > 0) {
+            status = fin_truncate(path, length);
+        }
+    }
+
+    FinesseApiCountCall(FINESSE_API_CALL_TRUNCATE, 0 == status);
+
+    return status;
+}
+
+int finesse_utimensat(int dirfd, const char *pathname, const struct timespec times[2], int flags)
+{
+    struct stat attr;
+    int         to_set = 0;
+    int         status = 1;
+
+    memset(&attr, 0, sizeof(attr));
+
+    if (NULL == times) {
+        to_set = FUSE_SET_ATTR_ATIME | FUSE_SET_ATTR_ATIME_NOW | FUSE_SET_ATTR_MTIME | FUSE_SET_ATTR_MTIME_NOW;
+    }
+    else {
+        if (UTIME_NOW == times[0].tv_nsec) {
+            to_set |= FUSE_SET_ATTR_ATIME | FUSE_SET_ATTR_ATIME_NOW;
+        }
+        else if (UTIME_OMIT != times[0].tv_nsec) {
+            attr.st_atim = times[0];
+            to_set |= FUSE_SET_ATTR_ATIME;
+        }
+
+        if (UTIME_NOW == times[1].tv_nsec) {
+            to_set |= FUSE_SET_ATTR_MTIME | FUSE_SET_ATTR_MTIME_NOW;
+        }
+        else if (UTIME_OMIT != times[1].tv_nsec) {
+            attr.st_mtim = times[1];
+            to_set |= FUSE_SET_ATTR_MTIME;
+        }
+    }
+
+    if ((0 == flags) && (NULL != pathname) && ((AT_FDCWD == dirfd) || ('/' == *pathname))) {
+        // AT_SYMLINK_NOFOLLOW and names relative to a directory are left to the C library
+        status = internal_setattr(FINESSE_API_CALL_UTIME, pathname, &attr, to_set);
+    }
+
+    if (status > 0) {
+        status = fin_utimensat(dirfd, pathname, times, flags);
+    }
+
+    FinesseApiCountCall(FINESSE_API_CALL_UTIME, 0 == status);
+
+    return status;
+}
@@ -8,7 +8,7 @@
 
 // int stat(const char *file_name, struct stat *buf);
 
-static int fin_stat(const char *file_name, struct stat *buf)
+int fin_stat(const char *file_name, struct stat *buf)
 {
     typedef int (*orig_stat_t)(const char *file_name, struct stat *buf);
     static orig_stat_t orig_stat = NULL;
@@ -44,6 +44,7 @@ static int internal_stat(const char *file_name, struct stat *buf)
     finesse_client_handle_t finesse_client_handle = NULL;
     int                     result;
     double                  timeout = 0;
+    uint64_t                since   = 0;
     struct timespec         start, stop, elapsed;
     int                     status, tstatus;
 
@@ -75,8 +76,22 @@ static int internal_stat(const char *file_name, struct stat *buf)
     tstatus = clock_gettime(CLOCK_MONOTONIC_RAW, &start);
     assert(0 == tstatus);
 
+    if (finesse_negative_lookup(finesse_client_handle, file_name, &since)) {
+        tstatus = clock_gettime(CLOCK_MONOTONIC_RAW, &stop);
+        assert(0 == tstatus);
+        timespec_diff(&start, &stop, &elapsed);
+        FinesseApiRecordOverhead(FINESSE_API_CALL_STAT, &elapsed);
+
+        errno = ENOENT;
+        return -1;
+    }
+
     status = FinesseSendStatRequest(finesse_client_handle, file_name, &message);
-    assert(0 == status);
+    if (0 != status) {
+        // longer than even a multi-slot message (and thus than any valid path)
+        errno = status;
+        return -1;
+    }
     status = FinesseGetStatResponse(finesse_client_handle, message, buf, &timeout, &result);
     assert(0 == status);
     FinesseFreeStatResponse(finesse_client_handle, message);
@@ -91,6 +106,15 @@ static int internal_stat(const char *file_name, struct stat *buf)
         fprintf(stderr, "%s:%d failed with result %d for file %s\n", __func__, __LINE__, result, file_name);
     }
 #endif  // 0
+    if ((ENOENT == result) || (-ENOENT == result)) {
+        finesse_negative_add(finesse_client_handle, file_name, since);
+    }
+
+    if ((ENOTSUP == result) || (-ENOTSUP == result)) {
+        // The server can't resolve this one (a symlink out of the mount); the kernel can
+        return fin_stat(file_name, buf);
+    }
+
     errno = 0;
     if (result < 0) {
         errno  = -result;
@@ -112,7 +136,7 @@ int finesse_stat(const char *file_name, struct stat *buf)
     return result;
 }
 
-static int fin_fstat(int filedes, struct stat *buf)
+int fin_fstat(int filedes, struct stat *buf)
 {
     typedef int (*orig_fstat_t)(int filedes, struct stat *buf);
     static orig_fstat_t orig_fstat = NULL;
@@ -261,7 +285,11 @@ static int internal_lstat(const char *pathname, struct stat *statbuf)
     assert(0 == tstatus);
 
     status = FinesseSendLstatRequest(finesse_client_handle, pathname, &message);
-    assert(0 == status);
+    if (0 != status) {
+        // longer than even a multi-slot message (and thus than any valid path)
+        errno = status;
+        return -1;
+    }
     status = FinesseGetStatResponse(finesse_client_handle, message, statbuf, &timeout, &result);
     assert(0 == status);
     FinesseFreeStatResponse(finesse_client_handle, message);
@@ -271,6 +299,20 @@ static int internal_lstat(const char *pathname, struct stat *statbuf)
     timespec_diff(&start, &stop, &elapsed);
     FinesseApiRecordOverhead(FINESSE_API_CALL_LSTAT, &elapsed);
 
+    if ((ENOTSUP == result) || (-ENOTSUP == result)) {
+        return fin_lstat(pathname, statbuf);
+    }
+
+    errno = 0;
+    if (result < 0) {
+        errno  = -result;
+        result = -1;
+    }
+    if (result > 0) {
+        errno  = result;
+        result = -1;
+    }
+
     return result;
 }
 
@@ -283,7 +325,7 @@ int finesse_lstat(const char *pathname, struct stat *statbuf)
     return result;
 }
 
-static int fin_fstatat(int dirfd, const char *pathname, struct stat *statbuf, int flags)
+int fin_fstatat(int dirfd, const char *pathname, struct stat *statbuf, int flags)
 {
     typedef int (*orig_fstatat_t)(int dirfd, const char *pathname, struct stat *statbuf, int flags);
     static orig_fstatat_t orig_fstatat = NULL;
@@ -313,6 +355,11 @@ static int internal_fstatat(int dirfd, const char *pathname, struct stat *statbu
     double                  timeout = 0;
     finesse_file_state_t *  ffs     = NULL;
 
+    if ((NULL != pathname) && ('/' == pathname[0])) {
+        // dirfd doesn't matter
+        return (flags & AT_SYMLINK_NOFOLLOW) ? internal_lstat(pathname, statbuf) : internal_stat(pathname, statbuf);
+    }
+
     tstatus = clock_gettime(CLOCK_MONOTONIC_RAW, &start);
     assert(0 == tstatus);
 
@@ -324,7 +371,8 @@ static int internal_fstatat(int dirfd, const char *pathname, struct stat *statbu
     timespec_diff(&start, &stop, &elapsed);
     FinesseApiRecordOverhead(FINESSE_API_CALL_FSTATAT, &elapsed);
 
-    if (NULL == ffs) {
+    // The server would take an empty name to be an fstat of the key it is relative to
+    if ((NULL == ffs) || (NULL == pathname) || ('\0' == pathname[0]) || (flags & AT_EMPTY_PATH)) {
         tstatus = clock_gettime(CLOCK_MONOTONIC_RAW, &start);
         assert(0 == tstatus);
 
@@ -343,8 +391,12 @@ static int internal_fstatat(int dirfd, const char *pathname, struct stat *statbu
     assert(0 == tstatus);
 
     // We ARE tracking the file, so we can use the key to query.
-    status = FinesseSendFstatAtRquest(finesse_client_handle, &ffs->key, pathname, flags, &message);
-    assert(0 == status);
+    finesse_client_handle = ffs->client;
+    status                = FinesseSendFstatAtRquest(finesse_client_handle, &ffs->key, pathname, flags, &message);
+    if (0 != status) {
+        errno = status;
+        return -1;
+    }
     status = FinesseGetStatResponse(finesse_client_handle, message, statbuf, &timeout, &result);
     assert(0 == status);
     FinesseFreeStatResponse(finesse_client_handle, message);
@@ -354,6 +406,20 @@ static int internal_fstatat(int dirfd, const char *pathname, struct stat *statbu
     timespec_diff(&start, &stop, &elapsed);
     FinesseApiRecordOverhead(FINESSE_API_CALL_FSTATAT, &elapsed);
 
+    if ((ENOTSUP == result) || (-ENOTSUP == result)) {
+        return fin_fstatat(dirfd, pathname, statbuf, flags);
+    }
+
+    errno = 0;
+    if (result < 0) {
+        errno  = -result;
+        result = -1;
+    }
+    if (result > 0) {
+        errno  = result;
+        result = -1;
+    }
+
     return result;
 }
 
@@ -0,0 +1,131 @@
+/*
+ * (C) Copyright 2020 Tony Mason
+ * All Rights Reserved
+ */
+
+#include "api-internal.h"
+
+#include <fnmatch.h>
+
+//
+// Call back with the name and (lstat) attributes of each entry in a directory - what "ls -l"
+// and "du" do with a readdir and a stat per name.  For a directory on a Finesse file system
+// the server does the whole directory in as few messages as it can (usually one).
+//
+
+static int statdir_native(const char *path, const char *pattern, finesse_statdir_callback_t callback, void *context)
+{
+    DIR *          dir;
+    struct dirent *entry;
+    struct stat    statbuf;
+    int            status = 0;
+    int            saved_errno;
+
+    dir = opendir(path);
+    if (NULL == dir) {
+        return -1;
+    }
+
+    while (0 == status) {
+        errno = 0;
+        entry = readdir(dir);
+        if (NULL == entry) {
+            status = (0 == errno) ? 0 : -1;
+            break;
+        }
+
+        if ((0 == strcmp(entry->d_name, ".")) || (0 == strcmp(entry->d_name, ".."))) {
+            continue;
+        }
+
+        if ((NULL != pattern) && ('\0' != pattern[0]) && (0 != fnmatch(pattern, entry->d_name, FNM_PERIOD))) {
+            continue;
+        }
+
+        if (0 != fin_fstatat(dirfd(dir), entry->d_name, &statbuf, AT_SYMLINK_NOFOLLOW)) {
+            if (ENOENT == errno) {
+                // gone since we read it
+                continue;
+            }
+            status = -1;
+            break;
+        }
+
+        status = callback(entry->d_name, &statbuf, context);
+    }
+
+    saved_errno = errno;
+    closedir(dir);
+    errno = saved_errno;
+
+    return status;
+}
+
+//
+// Returns 0 once every entry has been passed to callback, the callback's (non-zero) return
+// if it ended the walk, or -1 with errno set.  path must be absolute for the server to do
+// the work; pattern (NULL or "" for everything) is an fnmatch(3) pattern.
+//
+int finesse_statdir(const char *path, const char *pattern, finesse_statdir_callback_t callback, void *context)
+{
+    finesse_client_handle_t        client = NULL;
+    fincomm_message                message;
+    const void *                   entries;
+    const finesse_statdir_entry_t *entry;
+    size_t                         length;
+    size_t                         position;
+    uint32_t                       entry_count;
+    uint64_t                       offset   = 0;
+    uint64_t                       next     = 0;
+    int                            complete = 0;
+    int                            result   = 0;
+    int                            status   = 0;
+
+    if ((!finesse_api_init_in_progress) && ('/' == path[0])) {
+        client = finesse_check_prefix(path);
+    }
+
+    if (NULL == client) {
+        return statdir_native(path, pattern, callback, context);
+    }
+
+    while (!complete) {
+        status = FinesseSendStatDirRequest(client, path, pattern, offset, &message);
+        if (0 != status) {
+            // too long to send
+            assert(0 == offset);
+            return statdir_native(path, pattern, callback, context);
+        }
+
+        status = FinesseGetStatDirResponse(client, message, &entries, &length, &entry_count, &next, &complete, &result);
+        assert(0 == status);
+
+        if (0 != result) {
+            FinesseFreeStatDirResponse(client, message, entries, length);
+
+            if ((0 == offset) && (ENOENT != result) && (ENOTDIR != result)) {
+                // Nothing has been returned yet, so let the C library do it (e.g. a symlink in the path)
+                return statdir_native(path, pattern, callback, context);
+            }
+
+            errno = result;
+            return -1;
+        }
+
+        for (position = 0; (position < length) && (0 == status); position += entry->RecordLength) {
+            entry = (const finesse_statdir_entry_t *)((const char *)entries + position);
+            assert(entry->RecordLength >= FINESSE_STATDIR_ENTRY_SIZE(0));
+            status = callback(entry->Name, &entry->Attr, context);
+        }
+
+        FinesseFreeStatDirResponse(client, message, entries, length);
+
+        if (0 != status) {
+            return status;
+        }
+
+        offset = next;
+    }
+
+    return 0;
+}
@@ -81,7 +81,11 @@ int finesse_statvfs(const char *path, struct statvfs *buf)
     }
 
     status = FinesseSendStatfsRequest(finesse_client_handle, path, &message);
-    assert(0 == status);
+    if (0 != status) {
+        // longer than even a multi-slot message (and thus than any valid path)
+        errno = status;
+        return -1;
+    }
     status = FinesseGetStatfsResponse(finesse_client_handle, message, buf);
     assert(0 == status);
     FinesseFreeStatfsResponse(finesse_client_handle, message);
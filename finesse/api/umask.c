@@ -0,0 +1,85 @@
+/*
+ * (C) Copyright 2020 Tony Mason
+ * All Rights Reserved
+ */
+
+#include "api-internal.h"
+
+//
+// A mkdir or create that goes to the server skips the kernel, so we have to apply the umask
+// ourselves.  Asking for it with umask(2) means setting it, which would race with other threads
+// creating files, so we read it once from /proc and then keep track of any changes through
+// finesse_umask.
+//
+
+static mode_t finesse_current_umask;
+static int    finesse_umask_known;
+
+static mode_t fin_umask(mode_t mask)
+{
+    typedef mode_t (*orig_umask_t)(mode_t mask);
+    static orig_umask_t orig_umask = NULL;
+
+    if (NULL == orig_umask) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+        orig_umask = (orig_umask_t)dlsym(RTLD_NEXT, "umask");
+#pragma GCC diagnostic pop
+
+        assert(NULL != orig_umask);
+    }
+
+    return orig_umask(mask);
+}
+
+static int read_umask(mode_t *Mask)
+{
+    FILE *       status_file;
+    char         line[128];
+    unsigned int mask  = 0;
+    int          found = 0;
+
+    status_file = fopen("/proc/self/status", "r");
+    if (NULL == status_file) {
+        return 0;
+    }
+
+    while (NULL != fgets(line, sizeof(line), status_file)) {
+        if (1 == sscanf(line, "Umask: %o", &mask)) {
+            found = 1;
+            break;
+        }
+    }
+
+    fclose(status_file);
+
+    *Mask = (mode_t)mask;
+    return found;
+}
+
+mode_t finesse_get_umask(void)
+{
+    mode_t mask;
+
+    if (!finesse_umask_known) {
+        if (!read_umask(&mask)) {
+            // Older kernels don't report it; this is the best we can do
+            mask = fin_umask(022);
+            fin_umask(mask);
+        }
+        finesse_current_umask = mask;
+        finesse_umask_known   = 1;
+    }
+
+    return finesse_current_umask;
+}
+
+mode_t finesse_umask(mode_t mask)
+{
+    mode_t old = fin_umask(mask);
+
+    finesse_current_umask = mask & 0777;
+    finesse_umask_known   = 1;
+
+    return old;
+}
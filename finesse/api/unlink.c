@@ -78,7 +78,11 @@ static int internal_unlink(const char *file_name)
     memset(&null_uuid, 0, sizeof(uuid_t));
 
     status = FinesseSendUnlinkRequest(finesse_client_handle, &null_uuid, file_name, &message);
-    assert(0 == status);
+    if (0 != status) {
+        // longer than even a multi-slot message (and thus than any valid path)
+        errno = status;
+        return -1;
+    }
     status = FinesseGetUnlinkResponse(finesse_client_handle, message);
     assert(0 == status);
     result = message->Result;
@@ -152,7 +156,11 @@ static int internal_unlinkat(int dirfd, const char *pathname, int flags)
         START_TIME
         // At this point we do know about the directory, so we can construct the unlink request
         status = FinesseSendUnlinkRequest(ffs->client, &ffs->key, pathname, &message);
-        assert(0 == status);
+        if (0 != status) {
+            // longer than even a multi-slot message (and thus than any valid path)
+            errno = status;
+            return -1;
+        }
         status = FinesseGetUnlinkResponse(ffs->client, message);
         assert(0 == status);
         status = message->Result;
@@ -148,19 +148,26 @@ static const struct fuse_lowlevel_ops bitbucket_ll_oper = {
 static const char *DefaultStorageDir = "/tmp/bitbucket";
 
 static bitbucket_userdata_t BBud = {
-    .Magic             = BITBUCKET_USER_DATA_MAGIC,
-    .Debug             = 0,
-    .RootDirectory     = NULL,
-    .InodeTable        = NULL,
-    .AttrTimeout       = 3600.0,  // pretty arbitrary value
-    .Writeback         = 1,
-    .CachePolicy       = 1,
-    .FsyncDisable      = 1,
-    .NoXattr           = 1,
-    .BackgroundForget  = 0,
-    .FlushEnable       = 0,
-    .VerifyDirectories = 0,
-    .InodeTableSize    = BITBUCKET_DEFAULT_INODE_TABLE_SIZE,
+    .Magic                   = BITBUCKET_USER_DATA_MAGIC,
+    .Debug                   = 0,
+    .RootDirectory           = NULL,
+    .InodeTable              = NULL,
+    .AttrTimeout             = 3600.0,  // pretty arbitrary value
+    .Writeback               = 1,
+    .CachePolicy             = 1,
+    .FsyncDisable            = 1,
+    .NoXattr                 = 1,
+    .BackgroundForget        = 0,
+    .BackgroundForgetThreads = 1,
+    .FlushEnable             = 0,
+    .VerifyDirectories       = 0,
+    .SpliceWrite             = 0,
+    .DiscardWrites           = 0,
+    .DevNullFd               = -1,
+    .LoadImage               = NULL,
+    .SaveImage               = NULL,
+    .ImageData               = 0,
+    .InodeTableSize          = BITBUCKET_DEFAULT_INODE_TABLE_SIZE,
 };
 
 static void bitbucket_help(void)
@@ -179,10 +186,24 @@ static void bitbucket_help(void)
     printf(
         "    --bgforget - enable background forget handling "
         "(default=disabled)\n");
+    printf(
+        "    --bgforgetthreads=<numeric> - number of background forget "
+        "reclaim threads (default=1)\n");
     printf("    --flush - enable flush handling (default=disabled)\n");
     printf(
         "    --verifydirectories - enable directory consistency checks "
         "(default=disabled)\n");
+    printf(
+        "    --splice - splice pipe backed write payloads into storage "
+        "(default=disabled)\n");
+    printf(
+        "    --discard - discard write payloads (splice to /dev/null) "
+        "(default=disabled)\n");
+    printf("    --loadimage=<path> - populate the file system from a saved namespace image\n");
+    printf("    --saveimage=<path> - save the namespace to an image on dismount\n");
+    printf(
+        "    --imagedata - include file contents in the saved image "
+        "(default=disabled)\n");
     printf("    --logfile=<path> - location to write log output (default stderr)\n");
     printf(
         "    --loglevel=<level> - logging level (least = %d to most = %d, "
@@ -203,8 +224,14 @@ static const struct fuse_opt bitbucket_opts[] = {
     {"--fsync", offsetof(bitbucket_userdata_t, FsyncDisable), 0},
     {"--enable_xattr", offsetof(bitbucket_userdata_t, NoXattr), 0},
     {"--bgforget", offsetof(bitbucket_userdata_t, BackgroundForget), 1},
+    {"--bgforgetthreads=%d", offsetof(bitbucket_userdata_t, BackgroundForgetThreads), 1},
     {"--flush", offsetof(bitbucket_userdata_t, FlushEnable), 1},
     {"--verifydirectories", offsetof(bitbucket_userdata_t, VerifyDirectories), 1},
+    {"--splice", offsetof(bitbucket_userdata_t, SpliceWrite), 1},
+    {"--discard", offsetof(bitbucket_userdata_t, DiscardWrites), 1},
+    {"--loadimage=%s", offsetof(bitbucket_userdata_t, LoadImage), 0},
+    {"--saveimage=%s", offsetof(bitbucket_userdata_t, SaveImage), 0},
+    {"--imagedata", offsetof(bitbucket_userdata_t, ImageData), 1},
     {"--logfile=%s", offsetof(bitbucket_userdata_t, LogFile), 0},
     {"--loglevel=%d", offsetof(bitbucket_userdata_t, LogLevel), BITBUCKET_DEFAULT_LOG_LEVEL},
     {"--inodetablesize=%d", offsetof(bitbucket_userdata_t, InodeTableSize), BITBUCKET_DEFAULT_INODE_TABLE_SIZE},
@@ -307,6 +334,14 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (BBud.DiscardWrites) {
+        BBud.DevNullFd = open("/dev/null", O_WRONLY);
+        if (BBud.DevNullFd < 0) {
+            fuse_log(FUSE_LOG_ERR, "Unable to open /dev/null (errno = %d - %s), write payloads will be copied\n", errno,
+                     strerror(errno));
+        }
+    }
+
     se = fuse_session_new(&args, &bitbucket_ll_oper, sizeof(bitbucket_ll_oper), &BBud);
     if (se == NULL)
         goto err_out1;
@@ -326,6 +361,10 @@ int main(int argc, char *argv[])
     else {
         config.clone_fd         = opts.clone_fd;
         config.max_idle_threads = opts.max_idle_threads;
+        config.io_uring         = opts.io_uring;
+        config.io_uring_depth   = opts.io_uring_depth;
+        config.per_cpu_workers  = opts.per_cpu_workers;
+        config.work_stealing    = opts.work_stealing;
 
         ret = fuse_session_loop_mt(se, &config);
     }
@@ -336,6 +375,10 @@ err_out3:
 err_out2:
     fuse_session_destroy(se);
 err_out1:
+    if (BBud.DevNullFd >= 0) {
+        close(BBud.DevNullFd);
+        BBud.DevNullFd = -1;
+    }
     free(opts.mountpoint);
     fuse_opt_free_args(&args);
 
@@ -67,4 +67,11 @@ int                BitbucketDeleteDirectory(bitbucket_inode_t *Inode);
 bitbucket_inode_t *BitbucketCreateRootDirectory(bitbucket_inode_table_t *Table);
 void               BitbucketDeleteRootDirectory(bitbucket_inode_t *RootDirectory);
 
+void        BitbucketStartBackgroundForget(bitbucket_userdata_t *BBud);
+void        BitbucketStopBackgroundForget(void);
+const char *BitbucketFormatForgetStatistics(int CsvFormat);
+void        BitbucketFreeFormattedForgetStatistics(const char *ForgetStatistics);
+int         BitbucketLoadImage(bitbucket_userdata_t *BBud, const char *ImageFile);
+int         BitbucketSaveImage(bitbucket_userdata_t *BBud, const char *ImageFile, int IncludeData);
+
 #endif  // __BITBUCKET_H__
@@ -62,6 +62,10 @@ typedef struct _bitbucket_call_statistics {
     uint64_t        Failure;
     struct timespec ElapsedTime;
     char const *    Name;
+    uint64_t        Latency50;  // percentiles (ns) from the latency histogram
+    uint64_t        Latency99;
+    uint64_t        Latency999;
+    uint64_t        LatencyMax;  // (bucket midpoint) of the slowest call
 } bitbucket_call_statistics_t;
 
 void                         BitbucketInitializeCallStatistics(void);
@@ -70,6 +74,7 @@ void                         BitbucketReleaseCallStatistics(bitbucket_call_stati
 const char *                 BitbucketFormatCallData(bitbucket_call_statistics_t *CallData, int CsvFormat);
 void                         BitbucketFreeFormattedCallData(const char *FormattedData);
 void BitbucketFormatCallDataEntry(bitbucket_call_statistics_t *CallDataEntry, int CsvFormat, char *Buffer, size_t *BufferSize);
+const char *BitbucketFormatCallLatency(bitbucket_call_statistics_t *CallData, int CsvFormat);
 
 static inline void timespec_diff(struct timespec *begin, struct timespec *end, struct timespec *diff)
 {
@@ -80,6 +85,9 @@ static inline void timespec_diff(struct timespec *begin, struct timespec *end, s
         result.tv_sec--;
         result.tv_nsec = (long)1000000000 + end->tv_nsec - begin->tv_nsec;
     }
+    else {
+        result.tv_nsec = end->tv_nsec - begin->tv_nsec;
+    }
     *diff = result;
 }
 
@@ -45,6 +45,7 @@ typedef struct _bitbucket_file {
     char *   MapName;
     void *   Map;  // non-zero if we have a mapped file we're using for storage;
                    // length is in st_size
+    int      StorageFd;  // lazily opened descriptor for MapName (splice target); -1 if not open
     uint64_t     Readers;
     uint64_t     Writers;
     uint64_t     WaitingReaders;
@@ -73,6 +74,7 @@ typedef struct _bitbucket_dir {
     bitbucket_inode_t *Parent;
     list_entry_t       Entries;
     struct Trie *      Children;
+    const void *       Image;  // if not null, entries still need to be materialized from a namespace image
 } bitbucket_dir_t;
 
 #define BITBUCKET_DIR_MAGIC (0x895fe26d657f24bd)
@@ -97,9 +99,16 @@ struct _bitbucket_userdata {
     int                 FsyncDisable;
     int                 NoXattr;
     int                 BackgroundForget;
+    int                 BackgroundForgetThreads;
     int                 FlushEnable;
     int                 FsyncEnable;
     int                 VerifyDirectories;
+    int                 SpliceWrite;    // move write payloads with splice when they arrive in a pipe
+    int                 DiscardWrites;  // throw write payloads away (true bit bucket)
+    int                 DevNullFd;      // splice sink used when discarding pipe backed payloads
+    const char *        LoadImage;      // namespace image to populate the file system from
+    const char *        SaveImage;      // namespace image to write on dismount
+    int                 ImageData;      // include file contents in the saved image
     size_t              InodeTableSize;
     const char *        LogFile;
     enum fuse_log_level LogLevel;
@@ -137,6 +146,7 @@ bitbucket_inode_t *BitbucketLookupInodeInTable(void *Table, ino_t Inode);
 void *             BitbucketCreateInodeTable(uint32_t BucketCount, uint64_t HashSeed);
 void               BitbucketDestroyInodeTable(void *Table);
 uint64_t           BitbucketGetInodeTableCount(void *Table);
+void               BitbucketGetInodeTableLookupStatistics(void *Table, uint64_t *Lookups, uint64_t *CacheHits);
 const char *       BitbucketFormattedInodeTableStatistics(void *Table, int CsvFormat);
 void               BitbucketFreeFormattedInodeTableStatistics(const char *InodeTableStatistics);
 
@@ -319,6 +329,9 @@ int  BitbucketLookupExtendedAttribute(bitbucket_inode_t *Inode, const char *Name
 int  BitbucketRemoveExtendedAttribute(bitbucket_inode_t *Inode, const char *Name);
 void BitbucketDestroyExtendedAttributes(bitbucket_inode_t *Inode);
 
+typedef int (*bitbucket_xattr_callback_t)(void *Context, const char *Name, size_t DataLength, const void *Data);
+int BitbucketEnumerateExtendedAttributes(bitbucket_inode_t *Inode, bitbucket_xattr_callback_t Callback, void *Context);
+
 // Given an inode, insert it into the directory with the specified name.
 int BitbucketInsertDirectoryEntry(bitbucket_inode_t *DirInode, bitbucket_inode_t *Inode, const char *Name);
 
@@ -334,6 +347,8 @@ uint64_t BitbucketDirectoryEntryCount(bitbucket_inode_t *Inode);
 int      BitbucketExchangeObjectsInDirectory(bitbucket_inode_t *old_parent, bitbucket_inode_t *new_parent, const char *name,
                                              const char *newname);
 void     BitbucketEnableDirectoryVerification(void);
+void     BitbucketRegisterDirectoryMaterializer(void (*Materializer)(bitbucket_inode_t *Directory));
+void     BitbucketMaterializeDirectory(bitbucket_inode_t *Directory);
 
 void        BitbucketReferenceInode(bitbucket_inode_t *Inode, uint8_t Reason);
 void        BitbucketDereferenceInode(bitbucket_inode_t *Inode, uint8_t Reason, uint64_t Bias);
@@ -343,6 +358,7 @@ const char *BitbucketGetObjectReasonName(void *Object, uint8_t Reason);
 uint64_t    BitbucketGetInodeReasonReferenceCount(bitbucket_inode_t *Inode, uint8_t Reason);
 
 int BitbucketAdjustFileStorage(bitbucket_inode_t *Inode, size_t NewLength);
+int BitbucketGetFileStorageFd(bitbucket_inode_t *Inode);
 
 // More random numbers
 //
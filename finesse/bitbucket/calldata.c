@@ -6,10 +6,18 @@
 //
 
 #include <malloc.h>
+#include <stdio.h>
 #include <string.h>
 #include "bitbucketcalls.h"
+#include "callshard.h"
 
-static bitbucket_call_statistics_t BitbucketCallStatistics[BITBUCKET_CALLS_MAX - BITBUCKET_CALL_INIT];
+#define BITBUCKET_CALL_COUNT (BITBUCKET_CALLS_MAX - BITBUCKET_CALL_INIT)
+
+// Counters and latency histograms are kept per thread (see callshard.h) so
+// that the FUSE worker threads don't share cache lines on every call; this
+// array only holds the names and is the template for the aggregated copy.
+static bitbucket_call_statistics_t BitbucketCallStatistics[BITBUCKET_CALL_COUNT];
+static finesse_callshard_set_t     BitbucketCallShards = FINESSE_CALLSHARD_SET_INITIALIZER(BITBUCKET_CALL_COUNT, 1);
 
 static const char *BitbucketCallDataNames[] = {
     "Init",      "Destroy",     "Lookup",          "Forget",    "Getattr",     "Setattr",        "Readlink",     "Mknod",
@@ -31,12 +39,27 @@ void BitbucketInitializeCallStatistics(void)
     }
 }
 
+// Returns a snapshot of the call statistics, aggregated across all threads.
 bitbucket_call_statistics_t *BitbucketGetCallStatistics(void)
 {
     bitbucket_call_statistics_t *copy = (bitbucket_call_statistics_t *)malloc(sizeof(BitbucketCallStatistics));
+    uint64_t                     histogram[FINESSE_CALLSHARD_BUCKETS];
+    uint64_t                     nsec;
 
     if (NULL != copy) {
         memcpy(copy, BitbucketCallStatistics, sizeof(BitbucketCallStatistics));
+
+        for (unsigned index = 0; index < BITBUCKET_CALL_COUNT; index++) {
+            FinesseCallShardSum(&BitbucketCallShards, index, &copy[index].Calls, &copy[index].Success, &copy[index].Failure);
+            nsec                            = FinesseCallShardElapsed(&BitbucketCallShards, index, 0);
+            copy[index].ElapsedTime.tv_sec  = nsec / 1000000000;
+            copy[index].ElapsedTime.tv_nsec = nsec % 1000000000;
+            FinesseCallShardHistogram(&BitbucketCallShards, index, 0, histogram);
+            copy[index].Latency50  = FinesseCallShardPercentile(histogram, 50.0);
+            copy[index].Latency99  = FinesseCallShardPercentile(histogram, 99.0);
+            copy[index].Latency999 = FinesseCallShardPercentile(histogram, 99.9);
+            copy[index].LatencyMax = FinesseCallShardPercentile(histogram, 100.0);
+        }
     }
     return copy;
 }
@@ -52,15 +75,8 @@ void BitbucketCountCall(uint8_t Call, uint8_t Success, struct timespec *Elapsed)
 {
     assert((Call > BITBUCKET_CALL_BASE) && (Call < BITBUCKET_CALLS_MAX));
     assert((0 == Success) || (1 == Success));
-    BitbucketCallStatistics[Call - BITBUCKET_CALL_INIT].Calls++;
-    if (Success) {
-        BitbucketCallStatistics[Call - BITBUCKET_CALL_INIT].Success++;
-    }
-    else {
-        BitbucketCallStatistics[Call - BITBUCKET_CALL_INIT].Failure++;
-    }
-    timespec_add(&BitbucketCallStatistics[Call - BITBUCKET_CALL_INIT].ElapsedTime, Elapsed,
-                 &BitbucketCallStatistics[Call - BITBUCKET_CALL_INIT].ElapsedTime);
+    FinesseCallShardCount(&BitbucketCallShards, Call - BITBUCKET_CALL_INIT, Success);
+    FinesseCallShardRecord(&BitbucketCallShards, Call - BITBUCKET_CALL_INIT, 0, Elapsed);
 }
 
 // Given a copy of the call data, this routine will create a single string suitable for printing
@@ -115,6 +131,61 @@ const char *BitbucketFormatCallData(bitbucket_call_statistics_t *CallData, int C
     return formatted_data;
 }
 
+// Latency percentiles for each call that has been invoked (one line per call).  This is
+// released with BitbucketFreeFormattedCallData.
+const char *BitbucketFormatCallLatency(bitbucket_call_statistics_t *CallData, int CsvFormat)
+{
+    bitbucket_call_statistics_t *cd              = CallData;
+    int                          allocated       = 0;
+    size_t                       required_space  = 0;
+    size_t                       space_used      = 0;
+    char *                       formatted_data  = NULL;
+    static const char *          CsvHeaderString = " Routine, Invocations, p50, p99, p999, Max\n";
+    static const char *          FormatString    = "%16s: %10lu Calls, p50 = %12lu, p99 = %12lu, p999 = %12lu, Max = %12lu (ns)\n";
+    static const char *          CsvFormatString = " %s, %lu, %lu, %lu, %lu, %lu\n";
+
+    if (NULL == CallData) {
+        cd        = BitbucketGetCallStatistics();
+        allocated = 1;
+    }
+
+    if (NULL == cd) {
+        return NULL;
+    }
+
+    required_space = strlen(CsvHeaderString) + 1;
+    for (unsigned index = 0; index < BITBUCKET_CALL_COUNT; index++) {
+        required_space += snprintf(NULL, 0, CsvFormat ? CsvFormatString : FormatString, cd[index].Name, cd[index].Calls,
+                                   cd[index].Latency50, cd[index].Latency99, cd[index].Latency999, cd[index].LatencyMax);
+    }
+
+    formatted_data = (char *)malloc(required_space);
+
+    if (NULL != formatted_data) {
+        formatted_data[0] = '\0';
+        if (CsvFormat) {
+            space_used += snprintf(formatted_data, required_space, "%s", CsvHeaderString);
+        }
+
+        for (unsigned index = 0; index < BITBUCKET_CALL_COUNT; index++) {
+            if ((0 == cd[index].Calls) && (!CsvFormat)) {
+                continue;
+            }
+            space_used += snprintf(&formatted_data[space_used], required_space - space_used,
+                                   CsvFormat ? CsvFormatString : FormatString, cd[index].Name, cd[index].Calls,
+                                   cd[index].Latency50, cd[index].Latency99, cd[index].Latency999, cd[index].LatencyMax);
+            assert(space_used < required_space);
+        }
+    }
+
+    if (allocated) {
+        BitbucketReleaseCallStatistics(cd);
+        cd = NULL;
+    }
+
+    return formatted_data;
+}
+
 void BitbucketFreeFormattedCallData(const char *FormattedData)
 {
     if (NULL != FormattedData) {
@@ -17,12 +17,38 @@
 #include "trie.h"
 
 static int VerifyDirectoriesEnabled = 0;
+static void (*DirectoryMaterializer)(bitbucket_inode_t *Directory);
 
 void BitbucketEnableDirectoryVerification()
 {
     VerifyDirectoriesEnabled = 1;
 }
 
+//
+// Directories loaded from a namespace image are populated on first use; the
+// materializer is responsible for that (see image.c).
+//
+void BitbucketRegisterDirectoryMaterializer(void (*Materializer)(bitbucket_inode_t *Directory))
+{
+    DirectoryMaterializer = Materializer;
+}
+
+static inline void MaterializeDirectory(bitbucket_inode_t *Directory)
+{
+    if ((NULL != DirectoryMaterializer) && (NULL != __atomic_load_n(&Directory->Instance.Directory.Image, __ATOMIC_ACQUIRE))) {
+        DirectoryMaterializer(Directory);
+    }
+}
+
+//
+// For callers that enumerate a directory with it locked: the materializer has
+// to insert the entries, so it must run before the lock is taken.
+//
+void BitbucketMaterializeDirectory(bitbucket_inode_t *Directory)
+{
+    MaterializeDirectory(Directory);
+}
+
 static void DirectoryInitialize(void *Inode, size_t Length)
 {
     bitbucket_inode_t *DirInode = (bitbucket_inode_t *)Inode;
@@ -35,6 +61,7 @@ static void DirectoryInitialize(void *Inode, size_t Length)
     DirInode->Instance.Directory.Magic = BITBUCKET_DIR_MAGIC;
     initialize_list_entry(&DirInode->Instance.Directory.Entries);
     DirInode->Instance.Directory.Children = NULL;  // allocated when needed
+    DirInode->Instance.Directory.Image    = NULL;
     DirInode->Attributes.st_mode |= S_IFDIR;       // mark as a directory
     DirInode->Attributes.st_nlink = 1;             // .
 }
@@ -110,6 +137,7 @@ int BitbucketInsertDirectoryEntry(bitbucket_inode_t *DirInode, bitbucket_inode_t
 
     assert(BITBUCKET_DIR_TYPE == DirInode->InodeType);
     CHECK_BITBUCKET_DIR_MAGIC(&DirInode->Instance.Directory);
+    MaterializeDirectory(DirInode);
 
     if (NULL != Name) {
         name_length = strlen(Name) + 1;
@@ -188,6 +216,7 @@ void BitbucketLookupObjectInDirectory(bitbucket_inode_t *Inode, const char *Name
     Directory = &Inode->Instance.Directory;
 
     CHECK_BITBUCKET_DIR_MAGIC(Directory);
+    MaterializeDirectory(Inode);
 
     if (NULL != Directory->Children) {
         BitbucketLockInode(Inode, 0);
@@ -468,6 +497,7 @@ uint64_t BitbucketDirectoryEntryCount(bitbucket_inode_t *Inode)
     list_entry_t *le    = NULL;
 
     assert(NULL != Inode);
+    MaterializeDirectory(Inode);
 
     // This really should be in dir.c...
     BitbucketLockInode(Inode, 0);
@@ -502,6 +532,7 @@ int BitbucketDeleteDirectory(bitbucket_inode_t *Inode)
     CHECK_BITBUCKET_INODE_MAGIC(Inode);
     assert(BITBUCKET_DIR_TYPE == Inode->InodeType);
     CHECK_BITBUCKET_DIR_MAGIC(&Inode->Instance.Directory);
+    MaterializeDirectory(Inode);
 
     while (NULL != Inode) {
         if (NULL != Inode->Instance.Directory.Parent) {
@@ -549,6 +580,8 @@ int BitbucketExchangeObjectsInDirectory(bitbucket_inode_t *old_parent, bitbucket
     assert(NULL != new_parent);
     assert(NULL != name);
     assert(NULL != newname);
+    MaterializeDirectory(old_parent);
+    MaterializeDirectory(new_parent);
 
     // We're just going to swap the inode references; this
     // should not break refcounts
@@ -587,6 +620,7 @@ void BitbucketInitalizeDirectoryEnumerationContext(bitbucket_dir_enum_context_t
     assert(NULL != Directory);
     CHECK_BITBUCKET_INODE_MAGIC(Directory);
     assert(BITBUCKET_DIR_TYPE == Directory->InodeType);
+    MaterializeDirectory(Directory);
 
     VerifyDirectoryEntries(Directory);
 
@@ -31,6 +31,7 @@ static void FileInitialize(void *Inode, size_t Length)
     FileInode->InodeType           = BITBUCKET_FILE_TYPE;  // Mark this as being a directory
     FileInode->Instance.File.Magic = BITBUCKET_FILE_MAGIC;
     FileInode->Instance.File.Map   = NULL;
+    FileInode->Instance.File.StorageFd = -1;
     initialize_list(&FileInode->Instance.File.LockOwnersList);
     initialize_list(&FileInode->Instance.File.LockWaitersList);
     FileInode->Instance.File.WaitingReaders = 0;
@@ -66,6 +67,11 @@ static void FileDeallocate(void *Inode, size_t Length)
         }
     }
 
+    if (bbi->Instance.File.StorageFd >= 0) {
+        close(bbi->Instance.File.StorageFd);
+        bbi->Instance.File.StorageFd = -1;
+    }
+
     if (NULL != bbi->Instance.File.MapName) {
         status = unlink(bbi->Instance.File.MapName);
         assert(0 == status);  // if not, probably a program bug.
@@ -290,15 +296,15 @@ int BitbucketAdjustFileStorage(bitbucket_inode_t *Inode, size_t NewLength)
             }
 
             // Make sure the file is big enough.
-            status = ftruncate(fd, NewLength);
-            if (0 != status) {
-                assert(0);  // debug this.
+            if (0 != ftruncate(fd, NewLength)) {
+                status = errno;
                 break;
             }
 
             Inode->Instance.File.Map = mmap(NULL, NewLength, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
             if (MAP_FAILED == Inode->Instance.File.Map) {
-                status = errno;
+                status                   = errno;
+                Inode->Instance.File.Map = NULL;
                 break;
             }
 
@@ -392,3 +398,44 @@ int BitbucketAdjustFileStorage(bitbucket_inode_t *Inode, size_t NewLength)
 
     return status;
 }
+
+//
+// Return a descriptor for the backing storage file of this inode (or -1 if
+// the file is memory backed).  The descriptor is opened on first use and
+// then cached in the inode until it is deallocated; it is used to splice
+// write payloads directly into the page cache pages that back our mapping.
+//
+// The caller must hold a reference to the inode.
+//
+int BitbucketGetFileStorageFd(bitbucket_inode_t *Inode)
+{
+    int fd = -1;
+
+    assert(NULL != Inode);
+    assert(BITBUCKET_FILE_TYPE == Inode->InodeType);
+    CHECK_BITBUCKET_FILE_MAGIC(&Inode->Instance.File);
+
+    if (NULL == Inode->Instance.File.MapName) {
+        return -1;
+    }
+
+    fd = __atomic_load_n(&Inode->Instance.File.StorageFd, __ATOMIC_ACQUIRE);
+
+    if (fd < 0) {
+        int expected = -1;
+
+        fd = open(Inode->Instance.File.MapName, O_RDWR);
+        if (fd < 0) {
+            return -1;
+        }
+
+        if (!__atomic_compare_exchange_n(&Inode->Instance.File.StorageFd, &expected, fd, 0, __ATOMIC_ACQ_REL,
+                                          __ATOMIC_ACQUIRE)) {
+            // someone else beat us to it
+            close(fd);
+            fd = expected;
+        }
+    }
+
+    return fd;
+}
@@ -6,29 +6,89 @@
 #include <errno.h>
 #include <malloc.h>
 #include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
 #include "bitbucket.h"
 #include "bitbucketcalls.h"
 
 static int bitbucket_internal_forget(fuse_req_t req, fuse_ino_t ino, uint64_t nlookup);
 
-static list_entry_t    background_cleanup_queue      = {.next = &background_cleanup_queue, .prev = &background_cleanup_queue};
-static pthread_mutex_t background_cleanup_queue_lock = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t  background_cleanup_queue_cond = PTHREAD_COND_INITIALIZER;
-pthread_t              background_thread;
-int                    background_thread_started  = 0;
-int                    background_thread_shutdown = 0;
-
+//
+// Background forget processing
+//
+// Each FUSE worker thread coalesces its forgets into a batch of up to
+// BACKGROUND_FORGET_COUNT_MAX entries.  Full batches are pushed onto a
+// per-thread (lock free) pending stack, which the reclaim threads drain.  A
+// drained batch is returned to the free stack of the thread that filled it,
+// so in steady state there is no allocation on the forget path.
+//
+// The batch a worker is filling lives in Current; the worker swaps it out
+// while it appends, which allows a reclaimer to steal a partially filled batch
+// (again with an atomic exchange) so forgets never linger indefinitely.  A
+// batch younger than BACKGROUND_FORGET_MIN_AGE_NS is put back rather than
+// processed, so that a steady trickle of forgets still coalesces.
+//
+// Both stacks are only ever emptied with an atomic exchange (take them all),
+// so the usual ABA problems of a lock free stack do not arise.
+//
 #define BACKGROUND_FORGET_COUNT_MAX (64)
-
-typedef struct _background_forget_work {
-    list_entry_t          ListEntry;
-    uint8_t               Count;
-    bitbucket_userdata_t *BBud;
+#define BACKGROUND_FORGET_MAX_THREADS (256)
+#define BACKGROUND_FORGET_MAX_RECLAIMERS (64)
+#define BACKGROUND_FORGET_IDLE_NS (10 * 1000 * 1000)     // how long an idle reclaimer sleeps
+#define BACKGROUND_FORGET_MIN_AGE_NS (10 * 1000 * 1000)  // before a partial batch may be stolen
+#define BACKGROUND_FORGET_FILL_BUCKETS (8)
+
+typedef struct _background_forget_thread background_forget_thread_t;
+typedef struct _background_forget_work   background_forget_work_t;
+
+struct _background_forget_work {
+    background_forget_work_t *  Next;   // pending/free stack linkage
+    background_forget_thread_t *Owner;  // where this batch returns when drained
+    uint8_t                     Count;
+    struct timespec             Queued;  // when the first entry was added
     struct {
         ino_t  InodeToForget;
         size_t Bias;  // how many times do we need to forget it?
     } ThingsToForget[BACKGROUND_FORGET_COUNT_MAX];
-} background_forget_work_t;
+};
+
+struct _background_forget_thread {
+    background_forget_work_t *Current;  // batch being filled by the owning thread
+    background_forget_work_t *Pending;  // full batches waiting for a reclaimer
+    background_forget_work_t *Free;     // drained batches handed back by reclaimers
+    background_forget_work_t *Spare;    // private free list (owning thread only)
+    unsigned                  Index;
+    int                       Orphaned;  // owning thread exited; may be adopted
+} __attribute__((aligned(64)));
+
+typedef struct _background_forget_reclaimer {
+    pthread_t       Thread;
+    unsigned        Index;
+    int             Signalled;
+    pthread_mutex_t Lock;
+    pthread_cond_t  Cond;
+} background_forget_reclaimer_t;
+
+static background_forget_thread_t    BackgroundForgetThreads[BACKGROUND_FORGET_MAX_THREADS];
+static unsigned                      BackgroundForgetThreadCount;
+static background_forget_reclaimer_t BackgroundForgetReclaimers[BACKGROUND_FORGET_MAX_RECLAIMERS];
+static unsigned                      BackgroundForgetReclaimerCount;
+static bitbucket_userdata_t *        BackgroundForgetBBud;
+static int                           BackgroundForgetRunning;
+static int                           BackgroundForgetShutdown;
+static pthread_key_t                 BackgroundForgetKey;
+static __thread background_forget_thread_t *BackgroundForgetThread;
+
+static struct {
+    uint64_t BatchesQueued;            // full batches handed off by worker threads
+    uint64_t BatchesReclaimed;         // batches drained by reclaimers (full or stolen)
+    uint64_t PartialBatchesReclaimed;  // batches stolen before they filled
+    uint64_t ForgetsReclaimed;
+    uint64_t SynchronousForgets;  // processed inline (background disabled or no resources)
+    uint64_t ReclaimLatency;      // ns, first entry queued to batch drained
+    uint64_t MaxReclaimLatency;
+    uint64_t BatchFill[BACKGROUND_FORGET_FILL_BUCKETS];  // in 1/8ths of a batch
+} BackgroundForgetStatistics;
 
 static void background_forget(bitbucket_userdata_t *BBud, fuse_ino_t ino, uint64_t nlookup)
 {
@@ -44,57 +104,442 @@ static void background_forget(bitbucket_userdata_t *BBud, fuse_ino_t ino, uint64
     }
 }
 
-static void *background_forget_worker(void *Context)
+static void background_forget_push(background_forget_work_t **Stack, background_forget_work_t *Work)
 {
-    list_entry_t *            le   = NULL;
-    background_forget_work_t *work = NULL;
+    background_forget_work_t *head = __atomic_load_n(Stack, __ATOMIC_RELAXED);
 
-    (void)Context;
+    do {
+        Work->Next = head;
+    } while (!__atomic_compare_exchange_n(Stack, &head, Work, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
 
-    pthread_mutex_lock(&background_cleanup_queue_lock);
-    while (0 == background_thread_shutdown) {
-        while (empty_list(&background_cleanup_queue)) {
-            pthread_cond_wait(&background_cleanup_queue_cond, &background_cleanup_queue_lock);
-            if (background_thread_shutdown) {
-                break;
-            }
-        }
+static void background_forget_thread_exit(void *Context)
+{
+    background_forget_thread_t *thread = (background_forget_thread_t *)Context;
+    background_forget_work_t *  work   = NULL;
+
+    assert(NULL != thread);
+
+    // Hand off whatever we were accumulating, then allow another thread to adopt this slot.
+    work = __atomic_exchange_n(&thread->Current, NULL, __ATOMIC_ACQ_REL);
+    if (NULL != work) {
+        background_forget_push(&thread->Pending, work);
+    }
+    __atomic_store_n(&thread->Orphaned, 1, __ATOMIC_RELEASE);
+}
+
+static background_forget_thread_t *background_forget_get_thread(void)
+{
+    background_forget_thread_t *thread = BackgroundForgetThread;
+    unsigned                    count  = 0;
+
+    if (NULL != thread) {
+        return thread;
+    }
+
+    // Adopt the state of a thread that has exited, if there is one.
+    count = __atomic_load_n(&BackgroundForgetThreadCount, __ATOMIC_ACQUIRE);
+    if (count > BACKGROUND_FORGET_MAX_THREADS) {
+        count = BACKGROUND_FORGET_MAX_THREADS;
+    }
+
+    for (unsigned index = 0; index < count; index++) {
+        int orphaned = 1;
 
-        if (background_thread_shutdown) {
+        if (__atomic_compare_exchange_n(&BackgroundForgetThreads[index].Orphaned, &orphaned, 0, 0, __ATOMIC_ACQ_REL,
+                                        __ATOMIC_RELAXED)) {
+            thread = &BackgroundForgetThreads[index];
             break;
         }
+    }
+
+    if (NULL == thread) {
+        unsigned index = __atomic_fetch_add(&BackgroundForgetThreadCount, 1, __ATOMIC_ACQ_REL);
+
+        if (index >= BACKGROUND_FORGET_MAX_THREADS) {
+            return NULL;  // caller processes the forget synchronously
+        }
+        thread        = &BackgroundForgetThreads[index];
+        thread->Index = index;
+    }
+
+    pthread_setspecific(BackgroundForgetKey, thread);
+    BackgroundForgetThread = thread;
+
+    return thread;
+}
+
+static background_forget_work_t *background_forget_allocate_work(background_forget_thread_t *Thread)
+{
+    background_forget_work_t *work = Thread->Spare;
+
+    if (NULL == work) {
+        Thread->Spare = __atomic_exchange_n(&Thread->Free, NULL, __ATOMIC_ACQUIRE);
+        work          = Thread->Spare;
+    }
+
+    if (NULL != work) {
+        Thread->Spare = work->Next;
+    }
+    else {
+        work = (background_forget_work_t *)malloc(sizeof(background_forget_work_t));
+        if (NULL == work) {
+            return NULL;
+        }
+        work->Owner = Thread;
+    }
+
+    assert(Thread == work->Owner);
+    work->Next  = NULL;
+    work->Count = 0;
+
+    return work;
+}
+
+static void background_forget_wake(background_forget_thread_t *Thread)
+{
+    background_forget_reclaimer_t *reclaimer =
+        &BackgroundForgetReclaimers[Thread->Index % BackgroundForgetReclaimerCount];
+
+    // No lock here: a lost wakeup only costs us BACKGROUND_FORGET_IDLE_NS
+    __atomic_store_n(&reclaimer->Signalled, 1, __ATOMIC_RELEASE);
+    pthread_cond_signal(&reclaimer->Cond);
+}
+
+//
+// Returns 0 if the forget was queued, otherwise the caller must process it.
+//
+static int background_forget_queue(fuse_ino_t ino, uint64_t nlookup)
+{
+    background_forget_thread_t *thread = NULL;
+    background_forget_work_t *  work   = NULL;
+    int                         status = 0;
+
+    if ((0 == __atomic_load_n(&BackgroundForgetRunning, __ATOMIC_ACQUIRE)) ||
+        (0 != __atomic_load_n(&BackgroundForgetShutdown, __ATOMIC_ACQUIRE))) {
+        return ENOTCONN;
+    }
+
+    thread = background_forget_get_thread();
+    if (NULL == thread) {
+        return ENOMEM;
+    }
+
+    work = __atomic_exchange_n(&thread->Current, NULL, __ATOMIC_ACQ_REL);
+    if (NULL == work) {
+        work = background_forget_allocate_work(thread);
+        if (NULL == work) {
+            return ENOMEM;
+        }
+        status = clock_gettime(CLOCK_MONOTONIC_RAW, &work->Queued);
+        assert(0 == status);
+    }
+
+    assert(work->Count < BACKGROUND_FORGET_COUNT_MAX);
+    work->ThingsToForget[work->Count].InodeToForget = ino;
+    work->ThingsToForget[work->Count].Bias          = nlookup;
+    work->Count++;
+
+    if (BACKGROUND_FORGET_COUNT_MAX == work->Count) {
+        background_forget_push(&thread->Pending, work);
+        __atomic_fetch_add(&BackgroundForgetStatistics.BatchesQueued, 1, __ATOMIC_RELAXED);
+        background_forget_wake(thread);
+    }
+    else {
+        __atomic_store_n(&thread->Current, work, __ATOMIC_RELEASE);
+    }
+
+    return 0;
+}
+
+static void background_forget_process(background_forget_work_t *Work)
+{
+    struct timespec now, elapsed;
+    uint64_t        latency = 0;
+    uint64_t        max     = 0;
+    int             status  = 0;
+
+    for (unsigned index = 0; index < Work->Count; index++) {
+        background_forget(BackgroundForgetBBud, Work->ThingsToForget[index].InodeToForget,
+                          Work->ThingsToForget[index].Bias);
+    }
+
+    status = clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+    assert(0 == status);
+    timespec_diff(&Work->Queued, &now, &elapsed);
+    latency = elapsed.tv_sec * (uint64_t)1000000000 + (uint64_t)elapsed.tv_nsec;
+
+    __atomic_fetch_add(&BackgroundForgetStatistics.BatchesReclaimed, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&BackgroundForgetStatistics.ForgetsReclaimed, Work->Count, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&BackgroundForgetStatistics.ReclaimLatency, latency, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&BackgroundForgetStatistics.BatchFill[((Work->Count - 1) * BACKGROUND_FORGET_FILL_BUCKETS) /
+                                                             BACKGROUND_FORGET_COUNT_MAX],
+                       1, __ATOMIC_RELAXED);
+    if (Work->Count < BACKGROUND_FORGET_COUNT_MAX) {
+        __atomic_fetch_add(&BackgroundForgetStatistics.PartialBatchesReclaimed, 1, __ATOMIC_RELAXED);
+    }
+    max = __atomic_load_n(&BackgroundForgetStatistics.MaxReclaimLatency, __ATOMIC_RELAXED);
+    while ((latency > max) && !__atomic_compare_exchange_n(&BackgroundForgetStatistics.MaxReclaimLatency, &max, latency, 1,
+                                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        // max is refreshed by the failed exchange
+    }
+
+    Work->Count = 0;
+    background_forget_push(&Work->Owner->Free, Work);
+}
+
+//
+// Steal the batch Thread is filling if it has been waiting at least
+// BACKGROUND_FORGET_MIN_AGE_NS (or at all, if All is set).  A batch that is
+// too young goes back, unless the owner has started another in the meantime.
+//
+static background_forget_work_t *background_forget_steal(background_forget_thread_t *Thread, int All)
+{
+    background_forget_work_t *work    = __atomic_exchange_n(&Thread->Current, NULL, __ATOMIC_ACQ_REL);
+    background_forget_work_t *current = NULL;
+    struct timespec           now, elapsed;
+    int                       status = 0;
+
+    if ((NULL == work) || All) {
+        return work;
+    }
+
+    status = clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+    assert(0 == status);
+    timespec_diff(&work->Queued, &now, &elapsed);
+    if ((elapsed.tv_sec > 0) || (elapsed.tv_nsec >= BACKGROUND_FORGET_MIN_AGE_NS)) {
+        return work;
+    }
+
+    if (__atomic_compare_exchange_n(&Thread->Current, &current, work, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+        return NULL;
+    }
+
+    return work;
+}
+
+//
+// Drain the threads assigned to this reclaimer.  Partially filled batches
+// are stolen once they are old enough, or regardless of age if StealAll is
+// set.  Returns the number of batches processed.
+//
+static unsigned background_forget_drain(background_forget_reclaimer_t *Reclaimer, int StealAll)
+{
+    unsigned                  count     = __atomic_load_n(&BackgroundForgetThreadCount, __ATOMIC_ACQUIRE);
+    unsigned                  processed = 0;
+    background_forget_work_t *work      = NULL;
+    background_forget_work_t *next      = NULL;
+
+    if (count > BACKGROUND_FORGET_MAX_THREADS) {
+        count = BACKGROUND_FORGET_MAX_THREADS;
+    }
+
+    for (unsigned index = Reclaimer->Index; index < count; index += BackgroundForgetReclaimerCount) {
+        background_forget_thread_t *thread = &BackgroundForgetThreads[index];
+
+        for (work = __atomic_exchange_n(&thread->Pending, NULL, __ATOMIC_ACQUIRE); NULL != work; work = next) {
+            next = work->Next;
+            background_forget_process(work);
+            processed++;
+        }
+
+        work = background_forget_steal(thread, StealAll);
+        if (NULL != work) {
+            background_forget_process(work);
+            processed++;
+        }
+    }
 
-        le   = remove_list_head(&background_cleanup_queue);
-        work = container_of(le, background_forget_work_t, ListEntry);
+    return processed;
+}
 
-        for (unsigned index = 0; index < work->Count; index++) {
-            background_forget(work->BBud, work->ThingsToForget[index].InodeToForget, work->ThingsToForget[index].Bias);
+static void *background_forget_worker(void *Context)
+{
+    background_forget_reclaimer_t *reclaimer = (background_forget_reclaimer_t *)Context;
+    unsigned                       processed = 0;
+    struct timespec                timeout;
+
+    while (1) {
+        int shutdown = __atomic_load_n(&BackgroundForgetShutdown, __ATOMIC_ACQUIRE);
+
+        processed = background_forget_drain(reclaimer, shutdown);
+        if (0 != processed) {
+            continue;
         }
 
-        free(work);
-        work = NULL;
-        le   = NULL;
+        if (shutdown) {
+            break;
+        }
+
+        pthread_mutex_lock(&reclaimer->Lock);
+        if (0 == __atomic_exchange_n(&reclaimer->Signalled, 0, __ATOMIC_ACQ_REL)) {
+            clock_gettime(CLOCK_MONOTONIC, &timeout);
+            timeout.tv_nsec += BACKGROUND_FORGET_IDLE_NS;
+            while (timeout.tv_nsec >= 1000000000) {
+                timeout.tv_sec++;
+                timeout.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&reclaimer->Cond, &reclaimer->Lock, &timeout);
+            __atomic_store_n(&reclaimer->Signalled, 0, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&reclaimer->Lock);
     }
-    pthread_mutex_unlock(&background_cleanup_queue_lock);
 
     pthread_exit(NULL);
 }
 
-static void background_forget_startup(void)
+void BitbucketStartBackgroundForget(bitbucket_userdata_t *BBud)
 {
-    pthread_mutex_lock(&background_cleanup_queue_lock);
-    if (0 == background_thread_started) {
-        int            status = 0;
-        pthread_attr_t attr;
+    pthread_condattr_t condattr;
+    unsigned           count  = 0;
+    int                status = 0;
+
+    assert(NULL != BBud);
+    CHECK_BITBUCKET_USER_DATA_MAGIC(BBud);
+    assert(0 == BackgroundForgetRunning);
 
-        pthread_attr_init(&attr);
-        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
-        status = pthread_create(&background_thread, &attr, background_forget_worker, NULL);
+    count = BBud->BackgroundForgetThreads;
+    if (0 == count) {
+        count = 1;
+    }
+    if (count > BACKGROUND_FORGET_MAX_RECLAIMERS) {
+        count = BACKGROUND_FORGET_MAX_RECLAIMERS;
+    }
+
+    BackgroundForgetBBud           = BBud;
+    BackgroundForgetShutdown       = 0;
+    BackgroundForgetReclaimerCount = count;
+    status                         = pthread_key_create(&BackgroundForgetKey, background_forget_thread_exit);
+    assert(0 == status);
+
+    pthread_condattr_init(&condattr);
+    pthread_condattr_setclock(&condattr, CLOCK_MONOTONIC);
+    for (unsigned index = 0; index < count; index++) {
+        background_forget_reclaimer_t *reclaimer = &BackgroundForgetReclaimers[index];
+
+        reclaimer->Index     = index;
+        reclaimer->Signalled = 0;
+        pthread_mutex_init(&reclaimer->Lock, NULL);
+        pthread_cond_init(&reclaimer->Cond, &condattr);
+        status = pthread_create(&reclaimer->Thread, NULL, background_forget_worker, reclaimer);
         assert(0 == status);
-        pthread_attr_destroy(&attr);
-        background_thread_started = 1;
     }
-    pthread_mutex_unlock(&background_cleanup_queue_lock);
+    pthread_condattr_destroy(&condattr);
+
+    __atomic_store_n(&BackgroundForgetRunning, 1, __ATOMIC_RELEASE);
+}
+
+static void background_forget_free(background_forget_work_t *Work)
+{
+    background_forget_work_t *next = NULL;
+
+    for (; NULL != Work; Work = next) {
+        next = Work->Next;
+        free(Work);
+    }
+}
+
+//
+// Stop accepting background work, drain everything that has been queued
+// (including partially filled batches), wait for the reclaimers to exit and
+// then release the batches the worker threads were keeping for reuse.
+//
+void BitbucketStopBackgroundForget(void)
+{
+    unsigned count = 0;
+
+    if (0 == BackgroundForgetRunning) {
+        return;
+    }
+
+    __atomic_store_n(&BackgroundForgetShutdown, 1, __ATOMIC_RELEASE);
+
+    for (unsigned index = 0; index < BackgroundForgetReclaimerCount; index++) {
+        background_forget_reclaimer_t *reclaimer = &BackgroundForgetReclaimers[index];
+
+        pthread_mutex_lock(&reclaimer->Lock);
+        reclaimer->Signalled = 1;
+        pthread_cond_signal(&reclaimer->Cond);
+        pthread_mutex_unlock(&reclaimer->Lock);
+        pthread_join(reclaimer->Thread, NULL);
+        pthread_cond_destroy(&reclaimer->Cond);
+        pthread_mutex_destroy(&reclaimer->Lock);
+    }
+
+    __atomic_store_n(&BackgroundForgetRunning, 0, __ATOMIC_RELEASE);
+
+    count = __atomic_load_n(&BackgroundForgetThreadCount, __ATOMIC_ACQUIRE);
+    if (count > BACKGROUND_FORGET_MAX_THREADS) {
+        count = BACKGROUND_FORGET_MAX_THREADS;
+    }
+
+    for (unsigned index = 0; index < count; index++) {
+        background_forget_thread_t *thread = &BackgroundForgetThreads[index];
+        background_forget_work_t *  work   = NULL;
+        background_forget_work_t *  next   = NULL;
+
+        // Anything queued after the reclaimers last looked
+        for (work = __atomic_exchange_n(&thread->Pending, NULL, __ATOMIC_ACQUIRE); NULL != work; work = next) {
+            next = work->Next;
+            background_forget_process(work);
+        }
+        work = __atomic_exchange_n(&thread->Current, NULL, __ATOMIC_ACQ_REL);
+        if (NULL != work) {
+            background_forget_process(work);
+        }
+
+        background_forget_free(__atomic_exchange_n(&thread->Free, NULL, __ATOMIC_ACQUIRE));
+        background_forget_free(thread->Spare);
+        thread->Spare = NULL;
+    }
+}
+
+const char *BitbucketFormatForgetStatistics(int CsvFormat)
+{
+    static const char *CsvFormatString =
+        " Batches, Reclaimed, Partial, Forgets, Synchronous, AverageFill, AverageLatency, MaxLatency\n"
+        " %lu, %lu, %lu, %lu, %lu, %.2f, %.2f, %lu\n";
+    static const char *FormatString =
+        "Background forget: %lu batches queued, %lu reclaimed (%lu partial), %lu forgets, %lu synchronous\n"
+        "                   average fill %.2f, average latency %.2f (ns), max latency %lu (ns)\n";
+    uint64_t batches   = __atomic_load_n(&BackgroundForgetStatistics.BatchesReclaimed, __ATOMIC_RELAXED);
+    uint64_t forgets   = __atomic_load_n(&BackgroundForgetStatistics.ForgetsReclaimed, __ATOMIC_RELAXED);
+    uint64_t latency   = __atomic_load_n(&BackgroundForgetStatistics.ReclaimLatency, __ATOMIC_RELAXED);
+    double   fill      = batches ? (double)forgets / (double)batches : 0.0;
+    double   average   = batches ? (double)latency / (double)batches : 0.0;
+    size_t   available = 512;
+    size_t   used      = 0;
+    char *   formatted = (char *)malloc(available);
+    int      retval    = 0;
+
+    if (NULL == formatted) {
+        return NULL;
+    }
+
+    retval = snprintf(formatted, available, CsvFormat ? CsvFormatString : FormatString,
+                      __atomic_load_n(&BackgroundForgetStatistics.BatchesQueued, __ATOMIC_RELAXED), batches,
+                      __atomic_load_n(&BackgroundForgetStatistics.PartialBatchesReclaimed, __ATOMIC_RELAXED), forgets,
+                      __atomic_load_n(&BackgroundForgetStatistics.SynchronousForgets, __ATOMIC_RELAXED), fill, average,
+                      __atomic_load_n(&BackgroundForgetStatistics.MaxReclaimLatency, __ATOMIC_RELAXED));
+    used = (retval > 0) && ((size_t)retval < available) ? (size_t)retval : 0;
+
+    for (unsigned index = 0; index < BACKGROUND_FORGET_FILL_BUCKETS; index++) {
+        retval = snprintf(&formatted[used], available - used, CsvFormat ? " Fill%u, %lu\n" : "    fill <= %2u/8: %lu\n",
+                          index + 1, __atomic_load_n(&BackgroundForgetStatistics.BatchFill[index], __ATOMIC_RELAXED));
+        if ((retval < 0) || ((size_t)retval >= available - used)) {
+            break;
+        }
+        used += retval;
+    }
+
+    return formatted;
+}
+
+void BitbucketFreeFormattedForgetStatistics(const char *ForgetStatistics)
+{
+    if (NULL != ForgetStatistics) {
+        free((void *)(uintptr_t)ForgetStatistics);
+    }
 }
 
 void bitbucket_forget(fuse_req_t req, fuse_ino_t ino, uint64_t nlookup)
@@ -113,38 +558,14 @@ void bitbucket_forget(fuse_req_t req, fuse_ino_t ino, uint64_t nlookup)
 
 static int bitbucket_internal_forget(fuse_req_t req, fuse_ino_t ino, uint64_t nlookup)
 {
-    void *                    userdata = fuse_req_userdata(req);
-    bitbucket_userdata_t *    BBud     = (bitbucket_userdata_t *)userdata;
-    background_forget_work_t *work     = NULL;
-
-    // TODO: replace this with the background startup stuff
-
-    while (1) {
-        if (0 == BBud->BackgroundForget) {
-            background_forget(BBud, ino, nlookup);
-            break;
-        }
+    void *                userdata = fuse_req_userdata(req);
+    bitbucket_userdata_t *BBud     = (bitbucket_userdata_t *)userdata;
 
-        if (0 == background_thread_started) {
-            background_forget_startup();
+    if ((0 == BBud->BackgroundForget) || (0 != background_forget_queue(ino, nlookup))) {
+        if (BBud->BackgroundForget) {
+            __atomic_fetch_add(&BackgroundForgetStatistics.SynchronousForgets, 1, __ATOMIC_RELAXED);
         }
-
-        work = (background_forget_work_t *)malloc(sizeof(background_forget_work_t));
-        if (NULL == work) {
-            background_forget(BBud, ino, nlookup);
-            break;
-        }
-
-        work->BBud                            = BBud;
-        work->Count                           = 1;
-        work->ThingsToForget[0].InodeToForget = ino;
-        work->ThingsToForget[0].Bias          = nlookup;
-
-        pthread_mutex_lock(&background_cleanup_queue_lock);
-        insert_list_tail(&background_cleanup_queue, &work->ListEntry);
-        pthread_cond_signal(&background_cleanup_queue_cond);
-        pthread_mutex_unlock(&background_cleanup_queue_lock);
-        break;
+        background_forget(BBud, ino, nlookup);
     }
 
     fuse_reply_none(req);
@@ -170,48 +591,20 @@ void bitbucket_forget_multi(fuse_req_t req, size_t count, struct fuse_forget_dat
 
 static int bitbucket_internal_forget_multi(fuse_req_t req, size_t count, struct fuse_forget_data *forgets)
 {
-    void *                    userdata     = fuse_req_userdata(req);
-    bitbucket_userdata_t *    BBud         = (bitbucket_userdata_t *)userdata;
-    struct fuse_forget_data * forget_array = forgets;
-    background_forget_work_t *work         = NULL;
-
-    while (1) {
-        if (1 == BBud->BackgroundForget) {
-            if (0 == background_thread_started) {
-                background_forget_startup();
-                assert(1 == background_thread_started);
-            }
-
-            if (count <= BACKGROUND_FORGET_COUNT_MAX) {
-                work = (background_forget_work_t *)malloc(sizeof(background_forget_work_t));
+    void *                   userdata     = fuse_req_userdata(req);
+    bitbucket_userdata_t *   BBud         = (bitbucket_userdata_t *)userdata;
+    struct fuse_forget_data *forget_array = forgets;
+
+    // Each entry goes straight into this thread's current batch; there is no
+    // limit on how many entries a single forget_multi may carry.
+    for (unsigned index = 0; index < count; index++) {
+        if ((0 == BBud->BackgroundForget) ||
+            (0 != background_forget_queue(forget_array[index].ino, forget_array[index].nlookup))) {
+            if (BBud->BackgroundForget) {
+                __atomic_fetch_add(&BackgroundForgetStatistics.SynchronousForgets, 1, __ATOMIC_RELAXED);
             }
+            background_forget(BBud, forget_array[index].ino, forget_array[index].nlookup);
         }
-
-        // This is the "no posting" path:
-        //  - If background forget is not enabled
-        //  - If the malloc failed
-        //  - If the number of forget items is larger than we've anticipated
-        //
-        if (NULL == work) {
-            for (unsigned index = 0; index < count; index++) {
-                background_forget(BBud, forget_array[index].ino, forget_array[index].nlookup);
-            }
-            break;
-        }
-
-        work->BBud  = BBud;
-        work->Count = count;
-        assert(count <= BACKGROUND_FORGET_COUNT_MAX);
-        for (unsigned index = 0; index < count; index++) {
-            work->ThingsToForget[index].InodeToForget = forget_array[index].ino;
-            work->ThingsToForget[index].Bias          = forget_array[index].nlookup;
-        }
-
-        pthread_mutex_lock(&background_cleanup_queue_lock);
-        insert_list_tail(&background_cleanup_queue, &work->ListEntry);
-        pthread_cond_signal(&background_cleanup_queue_cond);
-        pthread_mutex_unlock(&background_cleanup_queue_lock);
-        break;
     }
 
     fuse_reply_none(req);
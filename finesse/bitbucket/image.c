@@ -0,0 +1,855 @@
+//
+// (C) Copyright 2020
+// Tony Mason
+// All Rights Reserved
+
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /* See feature_test_macros(7) */
+#endif              // _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "bitbucket.h"
+#include "bitbucketdata.h"
+
+//
+// Namespace images
+//
+// An image is a snapshot of the bitbucket namespace (inodes, directory
+// entries, symlinks, extended attributes and optionally file contents) that
+// can be used to set up a benchmark tree without recreating it through FUSE.
+//
+// Layout (all offsets are relative to the start of the image):
+//
+//   header | blob (names, link contents, xattr values, file data) | inodes | entries | xattrs
+//
+// The blob is written first so that it can be streamed while walking the
+// tree; the fixed size record arrays follow once their sizes are known.
+// Inode record 0 is the root directory.  The entries of a directory are
+// contiguous (FirstEntry .. FirstEntry + EntryCount) and do not include "."
+// or "..".  Hard links are represented by multiple entries that refer to the
+// same inode record.
+//
+// Loading an image maps it and attaches the root record to the root
+// directory.  Each directory is only populated (materialized) the first time
+// something looks inside it, so mounting a large tree costs a single mmap.
+// For the same reason only the header is checked at load time; each record
+// is checked against the tables and the blob just before it is used, and one
+// that doesn't fit (a truncated or corrupt image) is skipped.
+//
+#define BITBUCKET_IMAGE_MAGIC (0x336253e063ce2fdf)
+#define BITBUCKET_IMAGE_VERSION (1)
+#define BITBUCKET_IMAGE_FLAG_DATA (0x1)  // file contents are included
+
+typedef struct _bitbucket_image_header {
+    uint64_t Magic;
+    uint32_t Version;
+    uint32_t Flags;
+    uint64_t Length;  // of the entire image
+    uint64_t BlobOffset;
+    uint64_t BlobLength;
+    uint64_t InodeOffset;
+    uint64_t InodeCount;
+    uint64_t EntryOffset;
+    uint64_t EntryCount;
+    uint64_t XattrOffset;
+    uint64_t XattrCount;
+} bitbucket_image_header_t;
+
+typedef struct _bitbucket_image_inode {
+    uint8_t         Type;  // BITBUCKET_*_TYPE
+    uint8_t         Unused[3];
+    uint32_t        Mode;
+    uint32_t        Uid;
+    uint32_t        Gid;
+    uint32_t        Nlink;
+    uint32_t        EntryCount;  // directories only
+    uint64_t        FirstEntry;  // directories only
+    uint64_t        Size;
+    uint64_t        FirstXattr;
+    uint64_t        XattrCount;
+    uint64_t        DataOffset;  // symlink contents or file data (blob relative)
+    uint64_t        DataLength;
+    struct timespec Atime;
+    struct timespec Mtime;
+    struct timespec Ctime;
+} bitbucket_image_inode_t;
+
+typedef struct _bitbucket_image_entry {
+    uint64_t Inode;       // index of the inode record
+    uint64_t NameOffset;  // blob relative, null terminated
+} bitbucket_image_entry_t;
+
+typedef struct _bitbucket_image_xattr {
+    uint64_t NameOffset;  // blob relative, null terminated
+    uint64_t DataOffset;
+    uint64_t DataLength;
+} bitbucket_image_xattr_t;
+
+_Static_assert(0 == sizeof(bitbucket_image_header_t) % 8, "image header must be 8 byte aligned");
+_Static_assert(0 == sizeof(bitbucket_image_inode_t) % 8, "image inode records must be 8 byte aligned");
+
+//
+// State of the loaded image
+//
+static const bitbucket_image_header_t *BitbucketImage;
+static size_t                          BitbucketImageLength;
+static bitbucket_userdata_t *          BitbucketImageBBud;
+static bitbucket_inode_t **            BitbucketImageLinks;  // materialized inodes with multiple links
+static pthread_mutex_t                 BitbucketImageLock = PTHREAD_MUTEX_INITIALIZER;
+static __thread bitbucket_inode_t *    BitbucketImageMaterializing;
+
+static inline const bitbucket_image_inode_t *ImageInodes(void)
+{
+    return (const bitbucket_image_inode_t *)(((uintptr_t)BitbucketImage) + BitbucketImage->InodeOffset);
+}
+
+static inline const bitbucket_image_entry_t *ImageEntries(void)
+{
+    return (const bitbucket_image_entry_t *)(((uintptr_t)BitbucketImage) + BitbucketImage->EntryOffset);
+}
+
+static inline const bitbucket_image_xattr_t *ImageXattrs(void)
+{
+    return (const bitbucket_image_xattr_t *)(((uintptr_t)BitbucketImage) + BitbucketImage->XattrOffset);
+}
+
+static inline const char *ImageBlob(uint64_t Offset)
+{
+    return (const char *)(((uintptr_t)BitbucketImage) + BitbucketImage->BlobOffset + Offset);
+}
+
+// Offset + Count * Size <= Limit, without overflowing
+static int ImageRangeFits(uint64_t Offset, uint64_t Count, uint64_t Size, uint64_t Limit)
+{
+    return (Offset <= Limit) && (Count <= (Limit - Offset) / Size);
+}
+
+// The null terminated string at Offset in the blob, or NULL if it runs off the end
+static const char *ImageBlobString(const bitbucket_image_header_t *Header, uint64_t Offset)
+{
+    const char *string = (const char *)(((uintptr_t)Header) + Header->BlobOffset + Offset);
+
+    if ((Offset >= Header->BlobLength) || (NULL == memchr(string, '\0', Header->BlobLength - Offset))) {
+        return NULL;
+    }
+
+    return string;
+}
+
+// A name we can insert: not empty, "." or "..", and without a "/"
+static int ImageNameValid(const char *Name)
+{
+    size_t length = strlen(Name);
+
+    return (length > 0) && (length < MAX_FILE_NAME_SIZE) && (0 != strcmp(".", Name)) && (0 != strcmp("..", Name)) &&
+           (NULL == strchr(Name, '/'));
+}
+
+//
+// Check that everything Record refers to (its entries, extended attributes
+// and data) is inside the image.
+//
+static int ImageRecordValid(const bitbucket_image_header_t *Header, const bitbucket_image_inode_t *Record)
+{
+    const bitbucket_image_xattr_t *xattrs =
+        (const bitbucket_image_xattr_t *)(((uintptr_t)Header) + Header->XattrOffset);
+
+    if (!ImageRangeFits(Record->FirstXattr, Record->XattrCount, 1, Header->XattrCount) ||
+        !ImageRangeFits(Record->DataOffset, Record->DataLength, 1, Header->BlobLength)) {
+        return 0;
+    }
+
+    for (uint64_t index = 0; index < Record->XattrCount; index++) {
+        const bitbucket_image_xattr_t *xattr = &xattrs[Record->FirstXattr + index];
+
+        if ((NULL == ImageBlobString(Header, xattr->NameOffset)) ||
+            !ImageRangeFits(xattr->DataOffset, xattr->DataLength, 1, Header->BlobLength)) {
+            return 0;
+        }
+    }
+
+    switch (Record->Type) {
+        case BITBUCKET_DIR_TYPE:
+            return ImageRangeFits(Record->FirstEntry, Record->EntryCount, 1, Header->EntryCount);
+
+        case BITBUCKET_FILE_TYPE:
+            return (Record->Size <= (uint64_t)INT64_MAX) && (Record->DataLength <= Record->Size);
+
+        case BITBUCKET_SYMLINK_TYPE:
+            // The contents are stored with their null
+            return (Record->DataLength > 0) &&
+                   ('\0' == ((const char *)Header)[Header->BlobOffset + Record->DataOffset + Record->DataLength - 1]);
+
+        default:
+            return 1;  // skipped when materialized
+    }
+}
+
+static void ImageApplyAttributes(bitbucket_inode_t *Inode, const bitbucket_image_inode_t *Record)
+{
+    const bitbucket_image_xattr_t *xattrs = ImageXattrs();
+    int                            status = 0;
+
+    BitbucketLockInode(Inode, 1);
+
+    Inode->Attributes.st_mode = (Inode->Attributes.st_mode & S_IFMT) | (Record->Mode & ~S_IFMT);
+    Inode->Attributes.st_uid  = Record->Uid;
+    Inode->Attributes.st_gid  = Record->Gid;
+    Inode->Attributes.st_atim = Record->Atime;
+    Inode->Attributes.st_mtim = Record->Mtime;
+    Inode->Attributes.st_ctim = Record->Ctime;
+
+    for (uint64_t index = 0; index < Record->XattrCount; index++) {
+        const bitbucket_image_xattr_t *xattr = &xattrs[Record->FirstXattr + index];
+
+        status = BitbucketInsertExtendedAttribute(Inode, ImageBlob(xattr->NameOffset), xattr->DataLength,
+                                                  ImageBlob(xattr->DataOffset));
+        if (0 != status) {
+            fuse_log(FUSE_LOG_ERR, "%s: skipping image xattr %lu (errno = %d)\n", __func__,
+                     (unsigned long)(Record->FirstXattr + index), status);
+        }
+    }
+
+    if ((BITBUCKET_FILE_TYPE == Inode->InodeType) && (Record->Size > 0)) {
+        status = BitbucketAdjustFileStorage(Inode, Record->Size);
+        if (0 != status) {
+            fuse_log(FUSE_LOG_ERR, "%s: unable to size file to %lu (errno = %d)\n", __func__, (unsigned long)Record->Size,
+                     status);
+            BitbucketUnlockInode(Inode);
+            return;
+        }
+        Inode->Attributes.st_size   = Record->Size;
+        Inode->Attributes.st_blocks = 1 + (Inode->Attributes.st_size / Inode->Attributes.st_blksize);
+
+        if (Record->DataLength > 0) {
+            memcpy(Inode->Instance.File.Map, ImageBlob(Record->DataOffset), Record->DataLength);
+        }
+    }
+
+    BitbucketUnlockInode(Inode);
+}
+
+static void ImageMaterializeDirectory(bitbucket_inode_t *Directory)
+{
+    const bitbucket_image_inode_t *inodes = NULL;
+    const bitbucket_image_entry_t *entries = NULL;
+    const bitbucket_image_inode_t *dir     = NULL;
+    int                            status  = 0;
+
+    if (BitbucketImageMaterializing == Directory) {
+        // We are the ones populating this directory.
+        return;
+    }
+
+    pthread_mutex_lock(&BitbucketImageLock);
+
+    dir = (const bitbucket_image_inode_t *)Directory->Instance.Directory.Image;
+
+    if (NULL != dir) {
+        assert(NULL != BitbucketImage);
+        assert(NULL == BitbucketImageMaterializing);
+        BitbucketImageMaterializing = Directory;
+        inodes                      = ImageInodes();
+        entries                     = ImageEntries();
+
+        for (uint32_t index = 0; index < dir->EntryCount; index++) {
+            const bitbucket_image_entry_t *entry  = &entries[dir->FirstEntry + index];
+            const bitbucket_image_inode_t *record = NULL;
+            const char *                   name   = ImageBlobString(BitbucketImage, entry->NameOffset);
+            bitbucket_inode_t *            child  = NULL;
+
+            if ((NULL != name) && ImageNameValid(name)) {
+                // A corrupt image could name the same thing twice
+                BitbucketLookupObjectInDirectory(Directory, name, &child);
+                if (NULL != child) {
+                    BitbucketDereferenceInode(child, INODE_LOOKUP_REFERENCE, 1);
+                    child = NULL;
+                    name  = NULL;
+                }
+            }
+            else {
+                name = NULL;
+            }
+
+            if ((NULL == name) || (entry->Inode >= BitbucketImage->InodeCount) ||
+                !ImageRecordValid(BitbucketImage, &inodes[entry->Inode])) {
+                fuse_log(FUSE_LOG_ERR, "%s: skipping invalid image entry %lu\n", __func__,
+                         (unsigned long)(dir->FirstEntry + index));
+                continue;
+            }
+            record = &inodes[entry->Inode];
+
+            switch (record->Type) {
+                case BITBUCKET_DIR_TYPE:
+                    child = BitbucketCreateDirectory(Directory, name);
+                    assert(NULL != child);
+                    ImageApplyAttributes(child, record);
+                    // The children of this directory are populated on first use
+                    __atomic_store_n(&child->Instance.Directory.Image, record, __ATOMIC_RELEASE);
+                    break;
+
+                case BITBUCKET_FILE_TYPE:
+                    if ((record->Nlink > 1) && (NULL != BitbucketImageLinks[entry->Inode])) {
+                        // We've already seen this file under another name
+                        child = BitbucketImageLinks[entry->Inode];
+                        status = BitbucketInsertDirectoryEntry(Directory, child, name);
+                        assert(0 == status);
+                        child = NULL;
+                        break;
+                    }
+                    child = BitbucketCreateFile(Directory, name, BitbucketImageBBud);
+                    assert(NULL != child);
+                    ImageApplyAttributes(child, record);
+                    if (record->Nlink > 1) {
+                        // The lookup reference is kept for the other links
+                        BitbucketImageLinks[entry->Inode] = child;
+                        child                             = NULL;
+                    }
+                    break;
+
+                case BITBUCKET_SYMLINK_TYPE:
+                    child = BitbucketCreateSymlink(Directory, name, ImageBlob(record->DataOffset));
+                    assert(NULL != child);
+                    ImageApplyAttributes(child, record);
+                    break;
+
+                default:
+                    fuse_log(FUSE_LOG_ERR, "%s: skipping %s (unsupported type 0x%x)\n", __func__, name, (unsigned)record->Type);
+                    break;
+            }
+
+            if (NULL != child) {
+                BitbucketDereferenceInode(child, INODE_LOOKUP_REFERENCE, 1);
+                child = NULL;
+            }
+        }
+
+        BitbucketImageMaterializing = NULL;
+        __atomic_store_n(&Directory->Instance.Directory.Image, NULL, __ATOMIC_RELEASE);
+    }
+
+    pthread_mutex_unlock(&BitbucketImageLock);
+}
+
+//
+// Map the given image and attach it to the root directory.  Nothing else is
+// done until the contents of a directory are needed.
+//
+int BitbucketLoadImage(bitbucket_userdata_t *BBud, const char *ImageFile)
+{
+    const bitbucket_image_header_t *header = NULL;
+    const bitbucket_image_inode_t * root   = NULL;
+    struct stat                     stbuf;
+    void *                          map    = MAP_FAILED;
+    int                             fd     = -1;
+    int                             status = 0;
+
+    assert(NULL != BBud);
+    CHECK_BITBUCKET_USER_DATA_MAGIC(BBud);
+    assert(NULL != ImageFile);
+    assert(NULL == BitbucketImage);
+
+    while (NULL == BitbucketImage) {
+        fd = open(ImageFile, O_RDONLY);
+        if (fd < 0) {
+            status = errno;
+            break;
+        }
+
+        if (0 != fstat(fd, &stbuf)) {
+            status = errno;
+            break;
+        }
+
+        if ((size_t)stbuf.st_size < sizeof(bitbucket_image_header_t)) {
+            status = EINVAL;
+            break;
+        }
+
+        map = mmap(NULL, stbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (MAP_FAILED == map) {
+            status = errno;
+            break;
+        }
+
+        header = (const bitbucket_image_header_t *)map;
+        if ((BITBUCKET_IMAGE_MAGIC != header->Magic) || (BITBUCKET_IMAGE_VERSION != header->Version) ||
+            (header->Length != (uint64_t)stbuf.st_size) || (0 == header->InodeCount) ||
+            (0 != ((header->InodeOffset | header->EntryOffset | header->XattrOffset) & 7)) ||
+            !ImageRangeFits(header->InodeOffset, header->InodeCount, sizeof(bitbucket_image_inode_t), header->Length) ||
+            !ImageRangeFits(header->EntryOffset, header->EntryCount, sizeof(bitbucket_image_entry_t), header->Length) ||
+            !ImageRangeFits(header->XattrOffset, header->XattrCount, sizeof(bitbucket_image_xattr_t), header->Length) ||
+            !ImageRangeFits(header->BlobOffset, header->BlobLength, 1, header->Length)) {
+            fuse_log(FUSE_LOG_ERR, "%s: %s is not a valid (version %u) bitbucket image\n", __func__, ImageFile,
+                     (unsigned)BITBUCKET_IMAGE_VERSION);
+            status = EINVAL;
+            break;
+        }
+
+        // Record 0 is the root directory
+        root = (const bitbucket_image_inode_t *)(((uintptr_t)header) + header->InodeOffset);
+        if ((BITBUCKET_DIR_TYPE != root->Type) || !ImageRecordValid(header, root)) {
+            fuse_log(FUSE_LOG_ERR, "%s: %s has an invalid root directory record\n", __func__, ImageFile);
+            status = EINVAL;
+            break;
+        }
+
+        BitbucketImageLinks = (bitbucket_inode_t **)calloc(header->InodeCount, sizeof(bitbucket_inode_t *));
+        if (NULL == BitbucketImageLinks) {
+            status = ENOMEM;
+            break;
+        }
+
+        BitbucketImage       = header;
+        BitbucketImageLength = stbuf.st_size;
+        BitbucketImageBBud   = BBud;
+        map                  = MAP_FAILED;  // owned by the image now
+
+        ImageApplyAttributes(BBud->RootDirectory, root);
+        BitbucketRegisterDirectoryMaterializer(ImageMaterializeDirectory);
+        __atomic_store_n(&BBud->RootDirectory->Instance.Directory.Image, root, __ATOMIC_RELEASE);
+        status = 0;
+        break;
+    }
+
+    if (MAP_FAILED != map) {
+        munmap(map, stbuf.st_size);
+        map = MAP_FAILED;
+    }
+
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+
+    return status;
+}
+
+//
+// Saving an image
+//
+typedef struct _bitbucket_image_writer {
+    bitbucket_userdata_t *   BBud;
+    int                      Fd;
+    int                      IncludeData;
+    int                      Status;
+    uint64_t                 BlobOffset;  // file offset of the blob
+    uint64_t                 BlobLength;
+    bitbucket_image_inode_t *Inodes;
+    uint64_t                 InodeCount;
+    uint64_t                 InodeSpace;
+    bitbucket_image_entry_t *Entries;
+    uint64_t                 EntryCount;
+    uint64_t                 EntrySpace;
+    bitbucket_image_xattr_t *Xattrs;
+    uint64_t                 XattrCount;
+    uint64_t                 XattrSpace;
+    uint64_t *               LinkKeys;  // st_ino of multiply linked files already written
+    uint64_t *               LinkValues;
+    uint64_t                 LinkSpace;  // power of 2
+    uint64_t                 LinkCount;
+} bitbucket_image_writer_t;
+
+static void *ImageGrow(void *Array, uint64_t *Space, size_t ElementSize)
+{
+    uint64_t space = *Space ? *Space * 2 : 1024;
+    void *   array = realloc(Array, space * ElementSize);
+
+    if (NULL != array) {
+        *Space = space;
+    }
+
+    return array;
+}
+
+static uint64_t ImageAppendBlob(bitbucket_image_writer_t *Writer, const void *Data, size_t Length)
+{
+    uint64_t offset  = Writer->BlobLength;
+    size_t   written = 0;
+    ssize_t  result  = 0;
+
+    while ((0 == Writer->Status) && (written < Length)) {
+        result = pwrite(Writer->Fd, ((const char *)Data) + written, Length - written,
+                        Writer->BlobOffset + Writer->BlobLength + written);
+        if (result <= 0) {
+            Writer->Status = result < 0 ? errno : EIO;
+            break;
+        }
+        written += result;
+    }
+
+    // keep everything 8 byte aligned
+    Writer->BlobLength += (Length + 7) & ~7;
+
+    return offset;
+}
+
+static uint64_t ImageAllocateInode(bitbucket_image_writer_t *Writer)
+{
+    if (Writer->InodeCount == Writer->InodeSpace) {
+        bitbucket_image_inode_t *inodes = ImageGrow(Writer->Inodes, &Writer->InodeSpace, sizeof(bitbucket_image_inode_t));
+
+        if (NULL == inodes) {
+            Writer->Status = ENOMEM;
+            return 0;
+        }
+        Writer->Inodes = inodes;
+    }
+
+    memset(&Writer->Inodes[Writer->InodeCount], 0, sizeof(bitbucket_image_inode_t));
+    return Writer->InodeCount++;
+}
+
+static uint64_t *ImageFindLink(bitbucket_image_writer_t *Writer, uint64_t Ino, int Insert)
+{
+    uint64_t mask  = Writer->LinkSpace - 1;
+    uint64_t index = 0;
+
+    if ((Insert) && (2 * (Writer->LinkCount + 1) > Writer->LinkSpace)) {
+        uint64_t *oldkeys   = Writer->LinkKeys;
+        uint64_t *oldvalues = Writer->LinkValues;
+        uint64_t  oldspace  = Writer->LinkSpace;
+
+        Writer->LinkSpace  = oldspace ? oldspace * 2 : 1024;
+        Writer->LinkKeys   = calloc(Writer->LinkSpace, sizeof(uint64_t));
+        Writer->LinkValues = calloc(Writer->LinkSpace, sizeof(uint64_t));
+        assert((NULL != Writer->LinkKeys) && (NULL != Writer->LinkValues));
+        Writer->LinkCount = 0;
+        for (index = 0; index < oldspace; index++) {
+            if (0 != oldkeys[index]) {
+                *ImageFindLink(Writer, oldkeys[index], 1) = oldvalues[index];
+            }
+        }
+        free(oldkeys);
+        free(oldvalues);
+        mask = Writer->LinkSpace - 1;
+    }
+
+    if (0 == Writer->LinkSpace) {
+        return NULL;
+    }
+
+    assert(0 != Ino);
+    for (index = Ino & mask; 0 != Writer->LinkKeys[index]; index = (index + 1) & mask) {
+        if (Ino == Writer->LinkKeys[index]) {
+            return &Writer->LinkValues[index];
+        }
+    }
+
+    if (!Insert) {
+        return NULL;
+    }
+
+    Writer->LinkKeys[index] = Ino;
+    Writer->LinkCount++;
+    return &Writer->LinkValues[index];
+}
+
+static int ImageSaveXattr(void *Context, const char *Name, size_t DataLength, const void *Data)
+{
+    bitbucket_image_writer_t *writer = (bitbucket_image_writer_t *)Context;
+    bitbucket_image_xattr_t * xattr  = NULL;
+
+    if (writer->XattrCount == writer->XattrSpace) {
+        bitbucket_image_xattr_t *xattrs = ImageGrow(writer->Xattrs, &writer->XattrSpace, sizeof(bitbucket_image_xattr_t));
+
+        if (NULL == xattrs) {
+            writer->Status = ENOMEM;
+            return ENOMEM;
+        }
+        writer->Xattrs = xattrs;
+    }
+
+    xattr             = &writer->Xattrs[writer->XattrCount++];
+    xattr->NameOffset = ImageAppendBlob(writer, Name, strlen(Name) + 1);
+    xattr->DataOffset = ImageAppendBlob(writer, Data, DataLength);
+    xattr->DataLength = DataLength;
+
+    return writer->Status;
+}
+
+//
+// Fill in the inode record at Index from the given inode.
+//
+static void ImageSaveInode(bitbucket_image_writer_t *Writer, bitbucket_inode_t *Inode, uint64_t Index)
+{
+    bitbucket_image_inode_t record;
+    const char *            link = NULL;
+
+    memset(&record, 0, sizeof(record));
+
+    BitbucketLockInode(Inode, 0);
+    record.Type       = Inode->InodeType;
+    record.Mode       = Inode->Attributes.st_mode;
+    record.Uid        = Inode->Attributes.st_uid;
+    record.Gid        = Inode->Attributes.st_gid;
+    record.Nlink      = Inode->Attributes.st_nlink;
+    record.Size       = Inode->Attributes.st_size;
+    record.Atime      = Inode->Attributes.st_atim;
+    record.Mtime      = Inode->Attributes.st_mtim;
+    record.Ctime      = Inode->Attributes.st_ctim;
+    record.FirstXattr = Writer->XattrCount;
+    BitbucketEnumerateExtendedAttributes(Inode, ImageSaveXattr, Writer);
+    record.XattrCount = Writer->XattrCount - record.FirstXattr;
+
+    if ((BITBUCKET_SYMLINK_TYPE == Inode->InodeType) && (0 == BitbucketReadSymlink(Inode, &link))) {
+        record.DataLength = strlen(link) + 1;
+        record.DataOffset = ImageAppendBlob(Writer, link, record.DataLength);
+    }
+
+    if ((BITBUCKET_FILE_TYPE == Inode->InodeType) && (Writer->IncludeData) && (NULL != Inode->Instance.File.Map) &&
+        (record.Size > 0)) {
+        record.DataLength = record.Size;
+        record.DataOffset = ImageAppendBlob(Writer, Inode->Instance.File.Map, record.DataLength);
+    }
+    BitbucketUnlockInode(Inode);
+
+    // Preserve the directory fields; they're filled in when the directory is walked.
+    record.FirstEntry     = Writer->Inodes[Index].FirstEntry;
+    record.EntryCount     = Writer->Inodes[Index].EntryCount;
+    Writer->Inodes[Index] = record;
+}
+
+//
+// Write out the entries of a single directory (whose record is at Index).
+// Subdirectories are appended to the work queue (with a lookup reference).
+//
+static void ImageSaveDirectory(bitbucket_image_writer_t *Writer, bitbucket_inode_t *Directory, uint64_t Index,
+                               bitbucket_inode_t ***Queue, uint64_t **QueueIndices, uint64_t *QueueCount, uint64_t *QueueSpace)
+{
+    bitbucket_dir_enum_context_t enumContext;
+    const bitbucket_dir_entry_t *dirEntry = NULL;
+    bitbucket_inode_t **         children = NULL;
+    char **                      names    = NULL;
+    uint64_t                     count    = 0;
+    uint64_t                     space    = 0;
+
+    // Capture the children first; we don't want to hold the directory locked while writing
+    BitbucketInitalizeDirectoryEnumerationContext(&enumContext, Directory);
+    BitbucketLockInode(Directory, 0);
+    while (NULL != (dirEntry = BitbucketEnumerateDirectory(&enumContext))) {
+        if ((0 == strcmp(".", dirEntry->Name)) || (0 == strcmp("..", dirEntry->Name))) {
+            continue;
+        }
+
+        if ((Directory == Writer->BBud->RootDirectory) &&
+            (dirEntry->Inode == Writer->BBud->BitbucketMagicDirectories[BITBUCKET_MAGIC_BITBUCKET].Inode)) {
+            continue;  // recreated at mount time
+        }
+
+        if (count == space) {
+            uint64_t cspace = space;
+
+            children = ImageGrow(children, &cspace, sizeof(bitbucket_inode_t *));
+            names    = ImageGrow(names, &space, sizeof(char *));
+            assert((NULL != children) && (NULL != names));
+        }
+
+        children[count] = dirEntry->Inode;
+        BitbucketReferenceInode(children[count], INODE_LOOKUP_REFERENCE);
+        names[count] = strdup(dirEntry->Name);
+        assert(NULL != names[count]);
+        count++;
+    }
+    BitbucketUnlockInode(Directory);
+    BitbucketCleanupDirectoryEnumerationContext(&enumContext);
+
+    if (Writer->EntryCount + count > Writer->EntrySpace) {
+        while (Writer->EntryCount + count > Writer->EntrySpace) {
+            bitbucket_image_entry_t *entries =
+                ImageGrow(Writer->Entries, &Writer->EntrySpace, sizeof(bitbucket_image_entry_t));
+
+            assert(NULL != entries);
+            Writer->Entries = entries;
+        }
+    }
+
+    Writer->Inodes[Index].FirstEntry = Writer->EntryCount;
+    Writer->Inodes[Index].EntryCount = count;
+
+    for (uint64_t index = 0; index < count; index++) {
+        bitbucket_inode_t *child = children[index];
+        uint64_t *         link  = NULL;
+        uint64_t           entry = Writer->EntryCount++;
+        uint64_t           record;
+
+        if ((BITBUCKET_FILE_TYPE == child->InodeType) && (child->Attributes.st_nlink > 1)) {
+            link = ImageFindLink(Writer, child->Attributes.st_ino, 0);
+        }
+
+        if (NULL != link) {
+            record = *link;  // hard link to a file we've already written
+        }
+        else {
+            record = ImageAllocateInode(Writer);
+            if (0 != Writer->Status) {
+                break;
+            }
+            ImageSaveInode(Writer, child, record);
+            if ((BITBUCKET_FILE_TYPE == child->InodeType) && (child->Attributes.st_nlink > 1)) {
+                *ImageFindLink(Writer, child->Attributes.st_ino, 1) = record;
+            }
+        }
+
+        Writer->Entries[entry].Inode      = record;
+        Writer->Entries[entry].NameOffset = ImageAppendBlob(Writer, names[index], strlen(names[index]) + 1);
+
+        if ((NULL == link) && (BITBUCKET_DIR_TYPE == child->InodeType)) {
+            if (*QueueCount == *QueueSpace) {
+                uint64_t qspace = *QueueSpace;
+
+                *Queue        = ImageGrow(*Queue, &qspace, sizeof(bitbucket_inode_t *));
+                *QueueIndices = ImageGrow(*QueueIndices, QueueSpace, sizeof(uint64_t));
+                assert((NULL != *Queue) && (NULL != *QueueIndices));
+            }
+            (*Queue)[*QueueCount]        = child;
+            (*QueueIndices)[*QueueCount] = record;
+            (*QueueCount)++;
+            children[index] = NULL;  // the queue owns the reference now
+        }
+    }
+
+    for (uint64_t index = 0; index < count; index++) {
+        if (NULL != children[index]) {
+            BitbucketDereferenceInode(children[index], INODE_LOOKUP_REFERENCE, 1);
+        }
+        free(names[index]);
+    }
+    free(children);
+    free(names);
+}
+
+static void ImageWriteArray(bitbucket_image_writer_t *Writer, const void *Array, size_t Length, uint64_t Offset)
+{
+    size_t  written = 0;
+    ssize_t result  = 0;
+
+    while ((0 == Writer->Status) && (written < Length)) {
+        result = pwrite(Writer->Fd, ((const char *)Array) + written, Length - written, Offset + written);
+        if (result <= 0) {
+            Writer->Status = result < 0 ? errno : EIO;
+            break;
+        }
+        written += result;
+    }
+}
+
+//
+// Serialize the current namespace to ImageFile.  The image is written to a
+// temporary file and renamed into place, so it is safe to save over the
+// image we loaded from (which may still be mapped).
+//
+int BitbucketSaveImage(bitbucket_userdata_t *BBud, const char *ImageFile, int IncludeData)
+{
+    bitbucket_image_writer_t writer;
+    bitbucket_image_header_t header;
+    bitbucket_inode_t **     queue        = NULL;
+    uint64_t *               queueIndices = NULL;
+    uint64_t                 queueCount   = 0;
+    uint64_t                 queueSpace   = 0;
+    uint64_t                 root         = 0;
+    char *                   tmpname      = NULL;
+
+    assert(NULL != BBud);
+    CHECK_BITBUCKET_USER_DATA_MAGIC(BBud);
+    assert(NULL != ImageFile);
+
+    memset(&writer, 0, sizeof(writer));
+    memset(&header, 0, sizeof(header));
+    writer.BBud        = BBud;
+    writer.IncludeData = IncludeData;
+    writer.BlobOffset  = (sizeof(bitbucket_image_header_t) + 63) & ~63;
+
+    if (asprintf(&tmpname, "%s.tmp", ImageFile) < 0) {
+        return ENOMEM;
+    }
+
+    writer.Fd = open(tmpname, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (writer.Fd < 0) {
+        writer.Status = errno;
+    }
+
+    if (0 == writer.Status) {
+        root = ImageAllocateInode(&writer);
+        assert(0 == root);
+    }
+
+    if (0 == writer.Status) {
+        ImageSaveInode(&writer, BBud->RootDirectory, root);
+        BitbucketReferenceInode(BBud->RootDirectory, INODE_LOOKUP_REFERENCE);
+        ImageSaveDirectory(&writer, BBud->RootDirectory, root, &queue, &queueIndices, &queueCount, &queueSpace);
+        BitbucketDereferenceInode(BBud->RootDirectory, INODE_LOOKUP_REFERENCE, 1);
+    }
+
+    // Breadth first; since we only append to the queue, walk it by index.
+    for (uint64_t index = 0; index < queueCount; index++) {
+        if (0 == writer.Status) {
+            ImageSaveDirectory(&writer, queue[index], queueIndices[index], &queue, &queueIndices, &queueCount, &queueSpace);
+        }
+        BitbucketDereferenceInode(queue[index], INODE_LOOKUP_REFERENCE, 1);
+        queue[index] = NULL;
+    }
+
+    if (0 == writer.Status) {
+        header.Magic       = BITBUCKET_IMAGE_MAGIC;
+        header.Version     = BITBUCKET_IMAGE_VERSION;
+        header.Flags       = IncludeData ? BITBUCKET_IMAGE_FLAG_DATA : 0;
+        header.BlobOffset  = writer.BlobOffset;
+        header.BlobLength  = writer.BlobLength;
+        header.InodeOffset = (writer.BlobOffset + writer.BlobLength + 63) & ~63;
+        header.InodeCount  = writer.InodeCount;
+        header.EntryOffset = header.InodeOffset + writer.InodeCount * sizeof(bitbucket_image_inode_t);
+        header.EntryCount  = writer.EntryCount;
+        header.XattrOffset = header.EntryOffset + writer.EntryCount * sizeof(bitbucket_image_entry_t);
+        header.XattrCount  = writer.XattrCount;
+        header.Length      = header.XattrOffset + writer.XattrCount * sizeof(bitbucket_image_xattr_t);
+
+        ImageWriteArray(&writer, writer.Inodes, writer.InodeCount * sizeof(bitbucket_image_inode_t), header.InodeOffset);
+        ImageWriteArray(&writer, writer.Entries, writer.EntryCount * sizeof(bitbucket_image_entry_t), header.EntryOffset);
+        ImageWriteArray(&writer, writer.Xattrs, writer.XattrCount * sizeof(bitbucket_image_xattr_t), header.XattrOffset);
+        if ((0 == writer.Status) && (0 != ftruncate(writer.Fd, header.Length))) {
+            writer.Status = errno;
+        }
+        ImageWriteArray(&writer, &header, sizeof(header), 0);
+    }
+
+    if (writer.Fd >= 0) {
+        close(writer.Fd);
+        writer.Fd = -1;
+    }
+
+    if (0 == writer.Status) {
+        if (0 != rename(tmpname, ImageFile)) {
+            writer.Status = errno;
+        }
+    }
+
+    if (0 != writer.Status) {
+        fuse_log(FUSE_LOG_ERR, "%s: unable to save image %s (errno = %d - %s)\n", __func__, ImageFile, writer.Status,
+                 strerror(writer.Status));
+        unlink(tmpname);
+    }
+    else {
+        fuse_log(FUSE_LOG_INFO, "%s: saved %lu inodes, %lu entries, %lu xattrs to %s\n", __func__, writer.InodeCount,
+                 writer.EntryCount, writer.XattrCount, ImageFile);
+    }
+
+    free(tmpname);
+    free(queue);
+    free(queueIndices);
+    free(writer.Inodes);
+    free(writer.Entries);
+    free(writer.Xattrs);
+    free(writer.LinkKeys);
+    free(writer.LinkValues);
+
+    return writer.Status;
+}
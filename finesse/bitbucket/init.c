@@ -22,6 +22,30 @@ static const char *BitbucketMagicNames[] = {
 static int bitbucket_internal_init(void *userdata, struct fuse_conn_info *conn);
 static int bitbucket_internal_destroy(void *userdata);
 
+//
+// Counters published on the Finesse live metrics page
+//
+static uint64_t bitbucket_metric_inodes(void *Context)
+{
+    return BitbucketGetInodeTableCount(Context);
+}
+
+static uint64_t bitbucket_metric_inode_lookups(void *Context)
+{
+    uint64_t lookups, hits;
+
+    BitbucketGetInodeTableLookupStatistics(Context, &lookups, &hits);
+    return lookups;
+}
+
+static uint64_t bitbucket_metric_inode_cache_hits(void *Context)
+{
+    uint64_t lookups, hits;
+
+    BitbucketGetInodeTableLookupStatistics(Context, &lookups, &hits);
+    return hits;
+}
+
 void bitbucket_init(void *userdata, struct fuse_conn_info *conn)
 {
     struct timespec start, stop, elapsed;
@@ -47,8 +71,9 @@ void bitbucket_init(void *userdata, struct fuse_conn_info *conn)
 
 static int bitbucket_internal_init(void *userdata, struct fuse_conn_info *conn)
 {
-    bitbucket_userdata_t *BBud  = (bitbucket_userdata_t *)userdata;
-    unsigned              index = 0;
+    bitbucket_userdata_t *BBud   = (bitbucket_userdata_t *)userdata;
+    unsigned              index  = 0;
+    int                   status = 0;
 
     assert(NULL != conn);
 
@@ -64,6 +89,17 @@ static int bitbucket_internal_init(void *userdata, struct fuse_conn_info *conn)
     conn->want |= FUSE_CAP_WRITEBACK_CACHE;
     conn->want |= FUSE_CAP_EXPORT_SUPPORT;
 
+    if (BBud->SpliceWrite || BBud->DiscardWrites) {
+        // Ask for write payloads to be delivered in a pipe so write_buf can
+        // splice them to their destination without copying.
+        if (conn->capable & FUSE_CAP_SPLICE_READ) {
+            conn->want |= FUSE_CAP_SPLICE_READ;
+        }
+        if (conn->capable & FUSE_CAP_SPLICE_MOVE) {
+            conn->want |= FUSE_CAP_SPLICE_MOVE;
+        }
+    }
+
     BBud->Magic = BITBUCKET_USER_DATA_MAGIC;
     CHECK_BITBUCKET_USER_DATA_MAGIC(BBud);
     BBud->InodeTable = BitbucketCreateInodeTable(BBud->InodeTableSize, 0);
@@ -71,6 +107,14 @@ static int bitbucket_internal_init(void *userdata, struct fuse_conn_info *conn)
     BBud->RootDirectory = BitbucketCreateRootDirectory(BBud->InodeTable);
     assert(NULL != BBud->RootDirectory);
 
+    if (NULL != BBud->LoadImage) {
+        status = BitbucketLoadImage(BBud, BBud->LoadImage);
+        if (0 != status) {
+            fuse_log(FUSE_LOG_ERR, "%s: unable to load image %s (errno = %d - %s)\n", __func__, BBud->LoadImage, status,
+                     strerror(status));
+        }
+    }
+
     BBud->BitbucketMagicDirectories[0].Name  = BitbucketMagicNames[0];
     BBud->BitbucketMagicDirectories[0].Inode = BitbucketCreateDirectory(BBud->RootDirectory, BitbucketMagicNames[0]);
     assert(NULL != BBud->BitbucketMagicDirectories[0].Inode);
@@ -93,6 +137,14 @@ static int bitbucket_internal_init(void *userdata, struct fuse_conn_info *conn)
         BitbucketEnableDirectoryVerification();
     }
 
+    if (BBud->BackgroundForget) {
+        BitbucketStartBackgroundForget(BBud);
+    }
+
+    finesse_register_metric("bitbucket inodes", bitbucket_metric_inodes, BBud->InodeTable);
+    finesse_register_metric("bitbucket inode lookups", bitbucket_metric_inode_lookups, BBud->InodeTable);
+    finesse_register_metric("bitbucket inode cache hits", bitbucket_metric_inode_cache_hits, BBud->InodeTable);
+
     // All of these inodes have a lookup reference on them.
     return 0;
 }
@@ -118,7 +170,25 @@ int bitbucket_internal_destroy(void *userdata)
     const char *          calldata_string  = BitbucketFormatCallData(NULL, 0);
     int                   fd               = -1;
     ssize_t               written          = 0;
-    const char *          tabledata_string = BitbucketFormattedInodeTableStatistics(BBud->InodeTable, 0);
+    const char *          tabledata_string = NULL;
+    const char *          forget_string    = NULL;
+    const char *          latency_string   = BitbucketFormatCallLatency(NULL, 0);
+
+    finesse_unregister_metric(bitbucket_metric_inodes, BBud->InodeTable);
+    finesse_unregister_metric(bitbucket_metric_inode_lookups, BBud->InodeTable);
+    finesse_unregister_metric(bitbucket_metric_inode_cache_hits, BBud->InodeTable);
+
+    // Flush any forgets still queued so the table statistics reflect them.
+    if (BBud->BackgroundForget) {
+        BitbucketStopBackgroundForget();
+        forget_string = BitbucketFormatForgetStatistics(0);
+    }
+
+    if (NULL != BBud->SaveImage) {
+        BitbucketSaveImage(BBud, BBud->SaveImage, BBud->ImageData);
+    }
+
+    tabledata_string = BitbucketFormattedInodeTableStatistics(BBud->InodeTable, 0);
 
     if (NULL != calldata_string) {
         if (NULL != BBud->CallStatFile) {
@@ -129,6 +199,10 @@ int bitbucket_internal_destroy(void *userdata)
                 if (written > 0) {
                     written += write(fd, "\n", 1);
                 }
+                if ((written > 0) && (NULL != latency_string)) {
+                    written += write(fd, latency_string, strlen(latency_string));
+                    written += write(fd, "\n", 1);
+                }
                 close(fd);
                 fd = -1;
             }
@@ -145,12 +219,24 @@ int bitbucket_internal_destroy(void *userdata)
         calldata_string = NULL;
     }
 
+    if (NULL != latency_string) {
+        fuse_log(FUSE_LOG_CRIT, "Bitbucket Call Latency:\n%s\n", latency_string);
+        BitbucketFreeFormattedCallData(latency_string);
+        latency_string = NULL;
+    }
+
     if (NULL != tabledata_string) {
         fuse_log(FUSE_LOG_CRIT, "Bitbucket Inode Table Data:\n%s\n", tabledata_string);
         BitbucketFreeFormattedInodeTableStatistics(tabledata_string);
         tabledata_string = NULL;
     }
 
+    if (NULL != forget_string) {
+        fuse_log(FUSE_LOG_CRIT, "Bitbucket Forget Data:\n%s\n", forget_string);
+        BitbucketFreeFormattedForgetStatistics(forget_string);
+        forget_string = NULL;
+    }
+
     // Let's undo the work that we did in init.
     // Note: this is going to crash if the volume isn't cleanly torn down, so
     // that's probabl not viable long term.  Good for testing, though.
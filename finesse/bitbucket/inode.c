@@ -355,6 +355,28 @@ uint64_t BitbucketGetInodeTableCount(void *Table)
     return __atomic_load_n(&table->InodeCount, __ATOMIC_RELAXED);
 }
 
+//
+// Return the lookup statistics for the table (summed across the buckets; the
+// values are approximate while lookups are in progress).
+//
+void BitbucketGetInodeTableLookupStatistics(void *Table, uint64_t *Lookups, uint64_t *CacheHits)
+{
+    bitbucket_inode_table_t *table     = (bitbucket_inode_table_t *)Table;
+    uint64_t                 lookups   = 0;
+    uint64_t                 cacheHits = 0;
+
+    assert(NULL != Table);
+    CHECK_BITBUCKET_INODE_TABLE_MAGIC(table);
+
+    for (unsigned index = 0; index < table->BucketCount; index++) {
+        lookups += __atomic_load_n(&table->Buckets[index].Lookups, __ATOMIC_RELAXED);
+        cacheHits += __atomic_load_n(&table->Buckets[index].LastInodeMatch, __ATOMIC_RELAXED);
+    }
+
+    *Lookups   = lookups;
+    *CacheHits = cacheHits;
+}
+
 // Find an inode from the inode number in the specified table
 // If found, a reference counted pointer to the inode is returned
 // If not found, NULL is returned.
@@ -69,6 +69,10 @@ static int bitbucket_internal_readdir(fuse_req_t req, fuse_ino_t ino, size_t siz
         status = ENOENT;
     }
 
+    if ((NULL != inode) && (BITBUCKET_DIR_TYPE == inode->InodeType)) {
+        BitbucketMaterializeDirectory(inode);  // it inserts entries, so not with the lock held
+    }
+
     BitbucketLockInode(inode, 0);  // lock the directory for enumeration (shared)
     while (NULL != inode) {
         const bitbucket_dir_entry_t *dirEntry = NULL;
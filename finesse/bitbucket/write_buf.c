@@ -12,6 +12,71 @@
 static int bitbucket_internal_write_buf(fuse_req_t req, fuse_ino_t ino, struct fuse_bufvec *bufv, off_t off,
                                         struct fuse_file_info *fi);
 
+//
+// Move the write payload described by bufv to wherever it belongs.  When the
+// payload arrives in a pipe (FUSE_BUF_IS_FD) we can avoid pulling it into user
+// memory entirely:
+//   * discard mode - splice the pipe contents to /dev/null
+//   * storage mode - splice the pipe contents into the backing file at the
+//     write offset; those are the same page cache pages that back our
+//     (MAP_SHARED) mapping, so reads see the new data.
+// Anything else (memory buffers, memory backed files, splice disabled) is
+// copied into the mapping.
+//
+// The inode must be locked and large enough to hold off + size bytes.
+//
+static int BitbucketConsumeWriteData(bitbucket_userdata_t *BBud, bitbucket_inode_t *Inode, struct fuse_bufvec *bufv,
+                                     off_t off, size_t size)
+{
+    struct fuse_bufvec dst        = FUSE_BUFVEC_INIT(size);
+    int                pipe_input = 0;
+    int                fd         = -1;
+    ssize_t            copied     = 0;
+
+    for (unsigned index = bufv->idx; index < bufv->count; index++) {
+        if (0 != (FUSE_BUF_IS_FD & bufv->buf[index].flags)) {
+            pipe_input = 1;
+        }
+    }
+
+    if (BBud->DiscardWrites) {
+        if (!pipe_input) {
+            // Nothing to do, the payload is already in memory and we drop it on the floor.
+            bufv->idx = bufv->count;
+            return 0;
+        }
+        fd = BBud->DevNullFd;
+    }
+    else if (BBud->SpliceWrite && pipe_input) {
+        fd = BitbucketGetFileStorageFd(Inode);
+    }
+
+    if (fd >= 0) {
+        dst.buf[0].flags = FUSE_BUF_IS_FD;
+        dst.buf[0].fd    = fd;
+        if (!BBud->DiscardWrites) {
+            dst.buf[0].flags |= FUSE_BUF_FD_SEEK | FUSE_BUF_FD_RETRY;
+            dst.buf[0].pos = off;
+        }
+        copied = fuse_buf_copy(&dst, bufv, FUSE_BUF_SPLICE_MOVE);
+    }
+    else {
+        assert(NULL != Inode->Instance.File.Map);
+        dst.buf[0].mem = (void *)(((uintptr_t)Inode->Instance.File.Map) + off);
+        copied         = fuse_buf_copy(&dst, bufv, 0);
+    }
+
+    if (copied < 0) {
+        return (int)-copied;
+    }
+
+    if ((size_t)copied != size) {
+        return EIO;
+    }
+
+    return 0;
+}
+
 void bitbucket_write_buf(fuse_req_t req, fuse_ino_t ino, struct fuse_bufvec *bufv, off_t off, struct fuse_file_info *fi)
 {
     struct timespec start, stop, elapsed;
@@ -33,7 +98,6 @@ static int bitbucket_internal_write_buf(fuse_req_t req, fuse_ino_t ino, struct f
     bitbucket_inode_t *   inode     = NULL;
     int                   status    = 0;
     size_t                size      = 0;
-    size_t                offset    = 0;
     int                   extending = 0;
 
     (void)fi;  // could probably just use fi here...
@@ -44,11 +108,7 @@ static int bitbucket_internal_write_buf(fuse_req_t req, fuse_ino_t ino, struct f
 
     // Compute the size
     if (NULL != bufv) {
-        for (unsigned index = 0; index < bufv->count; index++) {
-            if (bufv->idx >= index) {
-                size += bufv->buf[index].size;
-            }
-        }
+        size = fuse_buf_size(bufv);
     }
 
     if (0 == size) {
@@ -99,34 +159,9 @@ static int bitbucket_internal_write_buf(fuse_req_t req, fuse_ino_t ino, struct f
             inode->Attributes.st_blocks = inode->Attributes.st_size / inode->Attributes.st_blksize;
         }
 
-        // At this point it is safe for us to copy data
+        // At this point it is safe for us to move the data
         assert(NULL != bufv);
-        offset = off;
-        for (unsigned index = 0; index < bufv->count; index++) {
-            off_t foff = offset;
-
-            if (bufv->idx >= index) {
-                char *ptr = (char *)((uintptr_t)inode->Instance.File.Map);
-
-                if (0 != (FUSE_BUF_FD_SEEK & bufv->buf[index].flags)) {
-                    // While the _name_ suggests its only used with the FD,
-                    // the commentary in the header file doesn't indicate this.
-                    foff = bufv->buf[index].pos;
-                }
-
-                if (0 != (FUSE_BUF_IS_FD & bufv->buf[index].flags)) {
-                    ssize_t bytesread = 0;
-
-                    bytesread = pread(bufv->buf[index].fd, ptr + offset, bufv->buf[index].size, foff);
-                    offset += bytesread;
-                }
-                else {
-                    assert((uintptr_t)(offset + bufv->buf[index].size) <= (uintptr_t)inode->Attributes.st_size);
-                    memcpy(ptr + foff, bufv->buf[index].mem, bufv->buf[index].size);
-                    offset += bufv->buf[index].size;
-                }
-            }
-        }
+        status = BitbucketConsumeWriteData(BBud, inode, bufv, off, size);
         BitbucketUnlockInode(inode);
 
         BitbucketDereferenceInode(inode, INODE_LOOKUP_REFERENCE, 1);
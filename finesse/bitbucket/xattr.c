@@ -185,6 +185,38 @@ int BitbucketRemoveExtendedAttribute(bitbucket_inode_t *Inode, const char *Name)
     return 0;
 }
 
+//
+// Invoke the callback for each extended attribute of this inode.  If the
+// callback returns a non-zero value the enumeration stops and that value
+// is returned.
+//
+// The caller must hold the inode locked (shared is sufficient).
+//
+int BitbucketEnumerateExtendedAttributes(bitbucket_inode_t *Inode, bitbucket_xattr_callback_t Callback, void *Context)
+{
+    list_entry_t *     le     = NULL;
+    bitbucket_xattr_t *xattr  = NULL;
+    int                status = 0;
+
+    assert(NULL != Inode);
+    CHECK_BITBUCKET_INODE_MAGIC(Inode);
+    assert(NULL != Callback);
+
+    list_for_each(&Inode->ExtendedAttributes, le)
+    {
+        xattr = container_of(le, bitbucket_xattr_t, ListEntry);
+        CHECK_BITBUCKET_XATTR_MAGIC(xattr);
+
+        status = Callback(Context, (const char *)xattr->Data, xattr->DataLength,
+                          ((char *)xattr->Data) + xattr->NameLength + 1);
+        if (0 != status) {
+            break;
+        }
+    }
+
+    return status;
+}
+
 //
 // Call this when destroying an inode with extended attributes
 //
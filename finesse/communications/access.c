@@ -14,15 +14,20 @@ int FinesseSendAccessRequest(finesse_client_handle_t FinesseClientHandle, uuid_t
     fincomm_shared_memory_region *fsmr;
     fincomm_message               message = NULL;
     finesse_msg *                 fmsg    = NULL;
-    size_t                        nameLength, bufSize;
-
-    (void)Mode;
+    size_t                        nameLength;
 
     assert(NULL != ccs);
     fsmr = (fincomm_shared_memory_region *)ccs->server_shm;
     assert(NULL != fsmr);
-    message = FinesseGetRequestBuffer(fsmr, FINESSE_FUSE_MESSAGE, FINESSE_FUSE_REQ_ACCESS);
-    assert(NULL != message);
+    assert(NULL != Path);
+    nameLength = strlen(Path);
+
+    // A long name uses more than one message block
+    message = FinesseGetRequestBufferForLength(fsmr, FINESSE_FUSE_MESSAGE, FINESSE_FUSE_REQ_ACCESS,
+                                               offsetof(finesse_msg, Message.Fuse.Request.Parameters.Access.Name) + nameLength + 1);
+    if (NULL == message) {
+        return ENAMETOOLONG;
+    }
 #if 0
     // This is now done by FinesseGetRequestBuffer
     message->MessageType = FINESSE_REQUEST;
@@ -33,17 +38,14 @@ int FinesseSendAccessRequest(finesse_client_handle_t FinesseClientHandle, uuid_t
 #endif  // 0
     fmsg = (finesse_msg *)message->Data;
 
-    if ((NULL == 0) || uuid_is_null(*Parent)) {
+    if ((NULL == Parent) || uuid_is_null(*Parent)) {
         memset(fmsg->Message.Fuse.Request.Parameters.Access.ParentInode, 0, sizeof(uuid_t));
     }
     else {
         memcpy(fmsg->Message.Fuse.Request.Parameters.Access.ParentInode, Parent, sizeof(uuid_t));
     }
 
-    assert(NULL != Path);
-    nameLength = strlen(Path);
-    bufSize    = SHM_PAGE_SIZE - offsetof(finesse_msg, Message.Fuse.Request.Parameters.Access.Name);
-    assert(nameLength < bufSize);
+    fmsg->Message.Fuse.Request.Parameters.Access.Mask = (int)Mode;
     memcpy(fmsg->Message.Fuse.Request.Parameters.Access.Name, Path, nameLength + 1);
 
     status = FinesseRequestReady(fsmr, message);
@@ -73,6 +75,7 @@ int FinesseSendAccessResponse(finesse_server_handle_t FinesseServerHandle, void
     ffm                             = (finesse_msg *)Message->Data;
     ffm->Version                    = FINESSE_MESSAGE_VERSION;
     ffm->MessageClass               = FINESSE_FUSE_MESSAGE;
+    ffm->Result                     = Result;
     ffm->Message.Fuse.Response.Type = FINESSE_FUSE_RSP_ERR;  // No data returned here
     FinesseResponseReady(fsmr, Message, 0);
 
@@ -0,0 +1,190 @@
+/*
+ * (C) Copyright 2020 Tony Mason
+ * All Rights Reserved
+*/
+
+#include <fcinternal.h>
+
+//
+// Ops is an array of OpCount operations; Names[index] is the name for a MAP operation
+// (and ignored for anything else).  The names must fit in the request.
+//
+int FinesseSendCompoundRequest(finesse_client_handle_t FinesseClientHandle, const finesse_compound_op_t *Ops, const char **Names,
+                               unsigned OpCount, fincomm_message *Message)
+{
+    int                           status = 0;
+    client_connection_state_t *   ccs    = FinesseClientHandle;
+    fincomm_shared_memory_region *fsmr;
+    fincomm_message               message = NULL;
+    finesse_msg *                 fmsg    = NULL;
+    size_t                        limit;
+    size_t                        used = 0;
+    size_t                        length;
+
+    assert(NULL != ccs);
+    assert(NULL != Ops);
+    assert((0 < OpCount) && (OpCount <= FINESSE_COMPOUND_MAX_OPS));
+
+    fsmr = (fincomm_shared_memory_region *)ccs->server_shm;
+    assert(NULL != fsmr);
+    message = FinesseGetRequestBuffer(fsmr, FINESSE_NATIVE_MESSAGE, FINESSE_NATIVE_REQ_COMPOUND);
+    assert(NULL != message);
+    fmsg = (finesse_msg *)message->Data;
+
+    limit = SHM_PAGE_SIZE - offsetof(fincomm_message_block, Data) -
+            offsetof(finesse_msg, Message.Native.Request.Parameters.Compound.Data);
+
+    for (unsigned index = 0; index < OpCount; index++) {
+        fmsg->Message.Native.Request.Parameters.Compound.Ops[index] = Ops[index];
+
+        if (FINESSE_COMPOUND_OP_MAP != Ops[index].Op) {
+            continue;
+        }
+
+        assert((NULL != Names) && (NULL != Names[index]));
+        length = strlen(Names[index]) + 1;
+        assert(used + length <= limit);
+        memcpy(&fmsg->Message.Native.Request.Parameters.Compound.Data[used], Names[index], length);
+        fmsg->Message.Native.Request.Parameters.Compound.Ops[index].NameOffset = (uint16_t)used;
+        used += length;
+    }
+    fmsg->Message.Native.Request.Parameters.Compound.OpCount = (uint16_t)OpCount;
+
+    status = FinesseRequestReady(fsmr, message);
+    assert(0 != status);  // invalid request ID
+    *Message = message;
+    status   = 0;
+
+    return status;
+}
+
+int FinesseSendCompoundResponse(finesse_server_handle_t FinesseServerHandle, void *Client, fincomm_message Message,
+                                const finesse_compound_result_t *Results, unsigned OpCount, uuid_t *Key, const struct stat *Attr,
+                                const void *Data, size_t DataLength, int Result)
+{
+    int                           status = 0;
+    fincomm_shared_memory_region *fsmr   = NULL;
+    finesse_msg *                 ffm;
+    unsigned                      index = (unsigned)(uintptr_t)Client;
+
+    fsmr = FcGetSharedMemoryRegion(FinesseServerHandle, index);
+    assert(NULL != fsmr);
+    assert(index < SHM_MESSAGE_COUNT);
+    assert(0 != Message);
+    assert(FINESSE_REQUEST == Message->MessageType);
+    assert(OpCount <= FINESSE_COMPOUND_MAX_OPS);
+    assert((0 == OpCount) || (NULL != Results));
+    assert(DataLength <= FINESSE_COMPOUND_MAX_DATA);
+
+    Message->Result      = Result;
+    Message->MessageType = FINESSE_RESPONSE;
+
+    // Note: the results are not built in the message buffer (the request lives there)
+    ffm                                                         = (finesse_msg *)Message->Data;
+    ffm->Version                                                = FINESSE_MESSAGE_VERSION;
+    ffm->MessageClass                                           = FINESSE_NATIVE_MESSAGE;
+    ffm->Message.Native.Response.NativeResponseType             = FINESSE_NATIVE_RSP_COMPOUND;
+    ffm->Message.Native.Response.Parameters.Compound.OpCount    = (uint16_t)OpCount;
+    ffm->Message.Native.Response.Parameters.Compound.DataLength = (uint32_t)DataLength;
+
+    if (NULL != Key) {
+        uuid_copy(ffm->Message.Native.Response.Parameters.Compound.Key, *Key);
+    }
+    else {
+        uuid_clear(ffm->Message.Native.Response.Parameters.Compound.Key);
+    }
+
+    if (NULL != Attr) {
+        ffm->Message.Native.Response.Parameters.Compound.Attr = *Attr;
+    }
+    else {
+        memset(&ffm->Message.Native.Response.Parameters.Compound.Attr, 0, sizeof(struct stat));
+    }
+
+    if (OpCount > 0) {
+        memcpy(ffm->Message.Native.Response.Parameters.Compound.Results, Results, OpCount * sizeof(finesse_compound_result_t));
+    }
+
+    if (DataLength > 0) {
+        memcpy(ffm->Message.Native.Response.Parameters.Compound.Data, Data, DataLength);
+    }
+
+    FinesseResponseReady(fsmr, Message, 0);
+
+    return status;
+}
+
+//
+// Results must have room for as many operations as were sent.  On entry *DataLength is the size
+// of Data; on return it is the amount of READ data copied there (the result offsets refer to it).
+// Key and Attr may be NULL if the caller doesn't want them.
+//
+int FinesseGetCompoundResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Message,
+                               finesse_compound_result_t *Results, unsigned *OpCount, uuid_t *Key, struct stat *Attr, void *Data,
+                               size_t *DataLength, int *Result)
+{
+    int                           status = 0;
+    client_connection_state_t *   ccs    = FinesseClientHandle;
+    fincomm_shared_memory_region *fsmr   = NULL;
+    finesse_msg *                 fmsg   = NULL;
+    size_t                        length;
+
+    assert(NULL != ccs);
+    fsmr = (fincomm_shared_memory_region *)ccs->server_shm;
+    assert(NULL != fsmr);
+    assert(NULL != Message);
+    assert(NULL != Results);
+    assert(NULL != OpCount);
+    assert(NULL != DataLength);
+    assert(NULL != Result);
+
+    // This is a blocking get
+    status = FinesseGetResponse(fsmr, Message, 1);
+    assert(0 != status);
+    status = 0;  // FinesseGetResponse is a boolean return function
+
+    assert(FINESSE_RESPONSE == Message->MessageType);
+    fmsg = (finesse_msg *)Message->Data;
+    assert(FINESSE_MESSAGE_VERSION == fmsg->Version);
+    assert(FINESSE_NATIVE_MESSAGE == fmsg->MessageClass);
+
+    *Result = Message->Result;
+    if (FINESSE_NATIVE_RSP_COMPOUND != fmsg->Message.Native.Response.NativeResponseType) {
+        // e.g. a server that doesn't know this request
+        if (0 == *Result) {
+            *Result = ENOTSUP;
+        }
+        *OpCount    = 0;
+        *DataLength = 0;
+        return status;
+    }
+
+    *OpCount = fmsg->Message.Native.Response.Parameters.Compound.OpCount;
+    assert(*OpCount <= FINESSE_COMPOUND_MAX_OPS);
+    memcpy(Results, fmsg->Message.Native.Response.Parameters.Compound.Results, *OpCount * sizeof(finesse_compound_result_t));
+
+    if (NULL != Key) {
+        uuid_copy(*Key, fmsg->Message.Native.Response.Parameters.Compound.Key);
+    }
+
+    if (NULL != Attr) {
+        *Attr = fmsg->Message.Native.Response.Parameters.Compound.Attr;
+    }
+
+    length = fmsg->Message.Native.Response.Parameters.Compound.DataLength;
+    assert(length <= FINESSE_COMPOUND_MAX_DATA);
+    if (length > *DataLength) {
+        length = *DataLength;
+    }
+    if (length > 0) {
+        memcpy(Data, fmsg->Message.Native.Response.Parameters.Compound.Data, length);
+    }
+    *DataLength = length;
+
+    return status;
+}
+
+void FinesseFreeCompoundResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Response)
+{
+    FinesseFreeClientResponse(FinesseClientHandle, Response);
+}
@@ -6,30 +6,41 @@
 
 #include <fcinternal.h>
 
+//
+// Creates (but does not open) a regular file with Stat's st_mode; Flags may be O_EXCL.
+//
 int FinesseSendCreateRequest(finesse_client_handle_t FinesseClientHandle, uuid_t *Parent, const char *Path, struct stat *Stat,
-                             fincomm_message *Message)
+                             int Flags, fincomm_message *Message)
 {
     int                           status = 0;
     client_connection_state_t *   ccs    = FinesseClientHandle;
     fincomm_shared_memory_region *fsmr;
     fincomm_message               message = NULL;
     finesse_msg *                 fmsg    = NULL;
-    size_t                        nameLength, bufSize;
+    size_t                        nameLength;
 
     assert(NULL != ccs);
     fsmr = (fincomm_shared_memory_region *)ccs->server_shm;
     assert(NULL != fsmr);
-    message = FinesseGetRequestBuffer(fsmr, FINESSE_FUSE_MESSAGE, FINESSE_FUSE_REQ_CREATE);
-    assert(NULL != message);
-    fmsg = (finesse_msg *)message->Data;
-    memcpy(&fmsg->Message.Fuse.Request.Parameters.Create.Parent, Parent, sizeof(uuid_t));
-    fmsg->Message.Fuse.Request.Parameters.Create.Attr = *Stat;
-    memcpy(&fmsg->Message.Fuse.Request.Parameters.Create.Parent, Parent, sizeof(uuid_t));
-
     assert(NULL != Path);
     nameLength = strlen(Path);
-    bufSize    = SHM_PAGE_SIZE - offsetof(finesse_msg, Message.Fuse.Request.Parameters.Create.Name);
-    assert(nameLength < bufSize);
+
+    // A long name uses more than one message block
+    message = FinesseGetRequestBufferForLength(fsmr, FINESSE_FUSE_MESSAGE, FINESSE_FUSE_REQ_CREATE,
+                                               offsetof(finesse_msg, Message.Fuse.Request.Parameters.Create.Name) + nameLength + 1);
+    if (NULL == message) {
+        return ENAMETOOLONG;
+    }
+    fmsg = (finesse_msg *)message->Data;
+    if (NULL == Parent) {
+        uuid_clear(fmsg->Message.Fuse.Request.Parameters.Create.Parent);
+    }
+    else {
+        memcpy(&fmsg->Message.Fuse.Request.Parameters.Create.Parent, Parent, sizeof(uuid_t));
+    }
+    fmsg->Message.Fuse.Request.Parameters.Create.Attr  = *Stat;
+    fmsg->Message.Fuse.Request.Parameters.Create.Flags = Flags;
+
     memcpy(fmsg->Message.Fuse.Request.Parameters.Create.Name, Path, nameLength + 1);
 
     status = FinesseRequestReady(fsmr, message);
@@ -54,7 +65,7 @@ int FinesseSendCreateResponse(finesse_server_handle_t FinesseServerHandle, void
     assert(0 != Message);
     assert(FINESSE_REQUEST == Message->MessageType);
 
-    Message->Result      = 0;
+    Message->Result      = Result;
     Message->MessageType = FINESSE_RESPONSE;
 
     assert(NULL != Stat);
@@ -63,7 +74,13 @@ int FinesseSendCreateResponse(finesse_server_handle_t FinesseServerHandle, void
     ffm->MessageClass               = FINESSE_FUSE_MESSAGE;
     ffm->Result                     = Result;
     ffm->Message.Fuse.Response.Type = FINESSE_FUSE_RSP_CREATE;
-    memcpy(&ffm->Message.Fuse.Response.Parameters.Create.Key, Key, sizeof(uuid_t));
+    if (NULL == Key) {
+        // the server need not track the new file
+        uuid_clear(ffm->Message.Fuse.Response.Parameters.Create.Key);
+    }
+    else {
+        memcpy(&ffm->Message.Fuse.Response.Parameters.Create.Key, Key, sizeof(uuid_t));
+    }
     ffm->Message.Fuse.Response.Parameters.Create.Generation = Generation;
     ffm->Message.Fuse.Response.Parameters.Create.Attr       = *Stat;
     ffm->Message.Fuse.Response.Parameters.Create.Timeout    = Timeout;
@@ -95,12 +112,22 @@ int FinesseGetCreateResponse(finesse_client_handle_t FinesseClientHandle, fincom
     fmsg = (finesse_msg *)Message->Data;
     assert(FINESSE_MESSAGE_VERSION == fmsg->Version);
     assert(FINESSE_FUSE_MESSAGE == fmsg->MessageClass);
-    assert(FINESSE_FUSE_RSP_CREATE == fmsg->Message.Fuse.Response.Type);
+    *Result = fmsg->Result;
+
+    if (FINESSE_FUSE_RSP_CREATE != fmsg->Message.Fuse.Response.Type) {
+        // e.g. a server that doesn't do create
+        assert(FINESSE_FUSE_RSP_ERR == fmsg->Message.Fuse.Response.Type);
+        if (0 == *Result) {
+            *Result = ENOTSUP;
+        }
+        return status;
+    }
+
     memcpy(Key, &fmsg->Message.Fuse.Response.Parameters.Create.Key, sizeof(uuid_t));
     *Generation = fmsg->Message.Fuse.Response.Parameters.Create.Generation;
     *Stat       = fmsg->Message.Fuse.Response.Parameters.Create.Attr;
     *Timeout    = fmsg->Message.Fuse.Response.Parameters.Create.Timeout;
-    *Result     = fmsg->Result;
+
     return status;
 }
 
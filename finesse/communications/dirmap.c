@@ -12,21 +12,25 @@ int FinesseSendDirMapRequest(finesse_client_handle_t FinesseClientHandle, uuid_t
     fincomm_shared_memory_region *fsmr;
     fincomm_message               message = NULL;
     finesse_msg *                 fmsg    = NULL;
-    size_t                        nameLength, bufSize;
+    size_t                        nameLength;
 
     assert(NULL != ccs);
     fsmr = (fincomm_shared_memory_region *)ccs->server_shm;
     assert(NULL != fsmr);
-    message = FinesseGetRequestBuffer(fsmr, FINESSE_NATIVE_MESSAGE, FINESSE_NATIVE_REQ_DIRMAP);
-    assert(NULL != message);
+    assert(NULL != Path);
+    nameLength = strlen(Path);
+
+    // A long name uses more than one message block
+    message = FinesseGetRequestBufferForLength(
+        fsmr, FINESSE_NATIVE_MESSAGE, FINESSE_NATIVE_REQ_DIRMAP,
+        offsetof(finesse_msg, Message.Native.Request.Parameters.Dirmap.Name) + nameLength + 1);
+    if (NULL == message) {
+        return ENAMETOOLONG;
+    }
 
     fmsg = (finesse_msg *)message->Data;
     memcpy(&fmsg->Message.Native.Request.Parameters.Dirmap.Parent, &Key, sizeof(uuid_t));
 
-    assert(NULL != Path);
-    nameLength = strlen(Path);
-    bufSize    = SHM_PAGE_SIZE - offsetof(finesse_msg, Message.Native.Request.Parameters.Dirmap.Name);
-    assert(nameLength < bufSize);
     memcpy(fmsg->Message.Native.Request.Parameters.Dirmap.Name, Path, nameLength + 1);
 
     status = FinesseRequestReady(fsmr, message);
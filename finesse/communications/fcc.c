@@ -182,6 +182,8 @@ void FinesseReleaseRequestBuffer(fincomm_shared_memory_region *RequestRegion, fi
     unsigned  index = (unsigned)((((uintptr_t)Message - (uintptr_t)RequestRegion) / SHM_PAGE_SIZE) - 1);
     u_int64_t bitmap;  // = AllocationBitmap;
     u_int64_t new_bitmap;
+    u_int64_t mask;
+    unsigned  slots;
 
     assert(NULL != RequestRegion);
     assert(index < SHM_MESSAGE_COUNT);
@@ -189,9 +191,18 @@ void FinesseReleaseRequestBuffer(fincomm_shared_memory_region *RequestRegion, fi
 
     Message->RequestId = 0;  // invalid
 
+    // A multi-slot message frees its whole run
+    slots = RequestRegion->MessageSlots[index];
+    if (0 == slots) {
+        slots = 1;
+    }
+    assert(index + slots <= SHM_MESSAGE_COUNT);
+    RequestRegion->MessageSlots[index] = 0;
+    mask                               = (make_mask64(slots) - 1) << index;
+
     bitmap     = RequestRegion->AllocationBitmap;
-    new_bitmap = bitmap & ~make_mask64(index);
-    assert(bitmap != new_bitmap);  // freeing an unallocated message
+    new_bitmap = bitmap & ~mask;
+    assert(mask == (bitmap & mask));  // freeing an unallocated message
 
     assert(&RequestRegion->Messages[index] == Message);
 
@@ -203,7 +214,7 @@ void FinesseReleaseRequestBuffer(fincomm_shared_memory_region *RequestRegion, fi
 
     while (!__sync_bool_compare_and_swap(&RequestRegion->AllocationBitmap, bitmap, new_bitmap)) {
         bitmap     = RequestRegion->AllocationBitmap;
-        new_bitmap = (bitmap & ~make_mask64(index));
+        new_bitmap = (bitmap & ~mask);
     }
 
     // fprintf(stderr, "%s (%s:%d): thread %d released index %u\n", __func__, __FILE__, __LINE__, gettid(), index);
@@ -221,6 +232,45 @@ void FinesseFreeClientResponse(finesse_client_handle_t FinesseClientHandle, finc
     FinesseReleaseRequestBuffer(fsmr, Response);
 }
 
+//
+// Where a client that starts caching now should start reading invalidations from.
+//
+uint64_t FinesseGetInvalidationCursor(finesse_client_handle_t FinesseClientHandle)
+{
+    client_connection_state_t *   ccs = FinesseClientHandle;
+    fincomm_shared_memory_region *fsmr;
+
+    assert(NULL != ccs);
+    fsmr = (fincomm_shared_memory_region *)ccs->server_shm;
+    assert(NULL != fsmr);
+
+    return __atomic_load_n(&fsmr->InvalidationHead, __ATOMIC_ACQUIRE);
+}
+
+//
+// The invalidations the server has posted since *Cursor; see FinesseReadInvalidations (in
+// particular, EOVERFLOW means "drop everything").  This never blocks.
+//
+int FinesseGetInvalidations(finesse_client_handle_t FinesseClientHandle, uint64_t *Cursor, finesse_invalidation_t *Invalidations,
+                            unsigned MaxCount, unsigned *Count)
+{
+    client_connection_state_t *   ccs = FinesseClientHandle;
+    fincomm_shared_memory_region *fsmr;
+    u_int64_t                     cursor;
+    int                           status;
+
+    assert(NULL != ccs);
+    assert(NULL != Cursor);
+    fsmr = (fincomm_shared_memory_region *)ccs->server_shm;
+    assert(NULL != fsmr);
+
+    cursor  = *Cursor;
+    status  = FinesseReadInvalidations(fsmr, &cursor, Invalidations, MaxCount, Count);
+    *Cursor = cursor;
+
+    return status;
+}
+
 // This is a general function that can be called from any specialized function where
 // the only thing they want back is the result code from the operation.
 int FinesseGetReplyErrResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Message, int *Result)
@@ -249,3 +299,36 @@ int FinesseGetReplyErrResponse(finesse_client_handle_t FinesseClientHandle, finc
 
     return status;
 }
+
+//
+// A response too large for its message says where the rest is: the name of the server's aux
+// buffer for that message slot.  The mapping is read only and is good until the response is
+// freed (at which point the server may reuse the buffer).
+//
+void *FinesseMapMessageAuxBuffer(const char *Name, size_t Length)
+{
+    int   fd;
+    void *buffer;
+
+    assert(NULL != Name);
+    assert(Length > 0);
+
+    fd = shm_open(Name, O_RDONLY, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    buffer = mmap(NULL, Length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    return MAP_FAILED == buffer ? NULL : buffer;
+}
+
+void FinesseUnmapMessageAuxBuffer(void *Buffer, size_t Length)
+{
+    int status;
+
+    assert(NULL != Buffer);
+    status = munmap(Buffer, Length);
+    assert(0 == status);
+}
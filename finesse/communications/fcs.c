@@ -7,6 +7,7 @@
 #endif  // _GNU_SOURCE
 
 #include <dirent.h>
+#include <poll.h>
 #include <stdlib.h>
 #include <sys/mman.h>
 #include <sys/socket.h>
@@ -31,21 +32,26 @@ static pid_t FinesseGetTid(void);
 #endif
 
 typedef struct server_internal_connection_state {
-    int                        server_connection;
-    int                        shutdown;
-    pthread_t                  listener_thread;
-    pid_t                      listener_tid;
-    uuid_t                     server_uuid;
-    unsigned char              align0[24];
-    pthread_mutex_t            monitor_mutex;
-    uint64_t                   waiting_client_request_bitmap;
-    unsigned char              align1[64 - (sizeof(pthread_mutex_t) + sizeof(uint64_t))];
-    pthread_cond_t             monitor_cond;  // threads monitor for refresh needed
-    unsigned char              align2[64 - (sizeof(pthread_cond_t))];
-    pthread_cond_t             server_cond;  // server thread monitors for refresh
-    unsigned char              align3[64 - (sizeof(pthread_cond_t))];
-    char                       server_connection_name[MAX_SHM_PATH_NAME];
-    server_connection_state_t *client_server_connection_state_table[SHM_MESSAGE_COUNT];
+    int                            server_connection;
+    int                            shutdown;
+    pthread_t                      listener_thread;
+    pid_t                          listener_tid;
+    uuid_t                         server_uuid;
+    unsigned char                  align0[24];
+    pthread_mutex_t                monitor_mutex;
+    uint64_t                       waiting_client_request_bitmap;
+    unsigned char                  align1[64 - (sizeof(pthread_mutex_t) + sizeof(uint64_t))];
+    pthread_cond_t                 monitor_cond;  // threads monitor for refresh needed
+    unsigned char                  align2[64 - (sizeof(pthread_cond_t))];
+    pthread_cond_t                 server_cond;  // server thread monitors for refresh
+    unsigned char                  align3[64 - (sizeof(pthread_cond_t))];
+    char                           server_connection_name[MAX_SHM_PATH_NAME];
+    server_connection_state_t *    client_server_connection_state_table[SHM_MESSAGE_COUNT];
+    uint32_t                       client_queue_depth[SHM_MESSAGE_COUNT];  // last observed, for metrics
+    uint32_t                       client_in_flight[SHM_MESSAGE_COUNT];
+    uint64_t                       client_requests[SHM_MESSAGE_COUNT];
+    FinesseClientDisconnectHandler disconnect_handler;  // told when a client goes away
+    void *                         disconnect_context;
 } server_internal_connection_state_t;
 
 _Static_assert(0 == (offsetof(server_internal_connection_state_t, monitor_mutex) % 64), "Misaligned");
@@ -79,7 +85,7 @@ static void create_aux_shm(server_connection_state_t *ccs, unsigned Index)
     assert(0 == status);
 
     ccs->aux_shm_table[Index].AuxShmMap = mmap(NULL, ccs->aux_shm_table[Index].AuxShmSize, PROT_READ | PROT_WRITE, MAP_SHARED,
-                                               ccs->aux_shm_table[Index].AuxShmSize, 0);
+                                               ccs->aux_shm_table[Index].AuxShmFd, 0);
     assert(MAP_FAILED != ccs->aux_shm_table[Index].AuxShmMap);
 }
 
@@ -168,6 +174,79 @@ static void teardown_client_connection(server_connection_state_t *ccs)
     free(ccs);
 }
 
+// Let the server drop whatever it was holding for the client in this slot
+static void client_disconnected(server_internal_connection_state_t *scs, unsigned Index)
+{
+    FinesseClientDisconnectHandler handler = __atomic_load_n(&scs->disconnect_handler, __ATOMIC_ACQUIRE);
+
+    if (NULL != handler) {
+        handler((void *)(uintptr_t)Index, scs->disconnect_context);
+    }
+}
+
+// Is the server still looking at (or answering) anything from this client?
+static int client_busy(server_connection_state_t *ccs)
+{
+    fincomm_shared_memory_region *fsmr = (fincomm_shared_memory_region *)ccs->client_shm;
+
+    return (0 != __atomic_load_n(&ccs->requests_in_progress, __ATOMIC_SEQ_CST)) ||
+           (0 != __atomic_load_n(&fsmr->ServerBitmap, __ATOMIC_SEQ_CST));
+}
+
+//
+// A server thread that is going to look at a client's shared memory pins the connection first.
+// The slot is read and the pin taken under the monitor lock, which is also what reap_client
+// holds while it decides the client can go, so a pinned connection is never torn down.  Returns
+// NULL if the slot is empty or its client is being reaped.
+//
+static server_connection_state_t *pin_client(server_internal_connection_state_t *scs, unsigned Index)
+{
+    server_connection_state_t *ccs = NULL;
+
+    pthread_mutex_lock(&scs->monitor_mutex);
+    ccs = scs->client_server_connection_state_table[Index];
+    if ((NULL != ccs) && (0 == __atomic_load_n(&ccs->reaped, __ATOMIC_SEQ_CST))) {
+        __atomic_fetch_add(&ccs->requests_in_progress, 1, __ATOMIC_SEQ_CST);
+    }
+    else {
+        ccs = NULL;
+    }
+    pthread_mutex_unlock(&scs->monitor_mutex);
+
+    return ccs;
+}
+
+static void unpin_client(server_connection_state_t *ccs)
+{
+    __atomic_fetch_sub(&ccs->requests_in_progress, 1, __ATOMIC_SEQ_CST);
+}
+
+//
+// Once a client has gone and the server isn't working on any of its requests, its connection
+// is torn down and the slot freed.  Whoever gets here first after that does it; anyone else
+// just returns.  The decision is made under the monitor lock (see pin_client); once made, no
+// one can pin the connection again, but the slot stays until the disconnect handler has run.
+//
+static void reap_client(server_internal_connection_state_t *scs, unsigned Index, server_connection_state_t *ccs)
+{
+    pthread_mutex_lock(&scs->monitor_mutex);
+    if ((ccs != scs->client_server_connection_state_table[Index]) || (0 == __atomic_load_n(&ccs->client_gone, __ATOMIC_SEQ_CST)) ||
+        client_busy(ccs) || (0 != __atomic_exchange_n(&ccs->reaped, 1, __ATOMIC_ACQ_REL))) {
+        pthread_mutex_unlock(&scs->monitor_mutex);
+        return;
+    }
+    pthread_mutex_unlock(&scs->monitor_mutex);
+
+    client_disconnected(scs, Index);
+
+    pthread_mutex_lock(&scs->monitor_mutex);
+    scs->waiting_client_request_bitmap &= ~make_mask64(Index);
+    scs->client_server_connection_state_table[Index] = NULL;
+    pthread_mutex_unlock(&scs->monitor_mutex);
+
+    teardown_client_connection(ccs);
+}
+
 static void listener_cleanup(void *arg)
 {
     if (NULL != arg) {
@@ -180,6 +259,25 @@ typedef struct _inbound_request_worker_info {
     server_internal_connection_state_t *Scs;
 } inbound_request_worker_info;
 
+// How often (in ms) an idle monitor thread checks that its client is still there
+#define FINESSE_CLIENT_LIVENESS_MS (1000)
+
+// A client that exits (or crashes) closes its end of the registration connection
+static int client_hung_up(server_connection_state_t *ccs)
+{
+    struct pollfd pfd;
+
+    pfd.fd      = ccs->client_connection;
+    pfd.events  = POLLRDHUP;
+    pfd.revents = 0;
+
+    if (poll(&pfd, 1, 0) <= 0) {
+        return 0;
+    }
+
+    return 0 != (pfd.revents & (POLLHUP | POLLRDHUP | POLLERR));
+}
+
 // This worker thread monitors inbound requests from the client
 static void *inbound_request_worker(void *context)
 {
@@ -189,6 +287,7 @@ static void *inbound_request_worker(void *context)
     uint64_t                            pending_bit = make_mask64(irwi->index);
     int                                 status;
     unsigned                            locked_count = 0;
+    struct timespec                     deadline;
 
     assert(NULL != context);
     scs = irwi->Scs;
@@ -214,21 +313,42 @@ static void *inbound_request_worker(void *context)
     // way.
     pthread_cleanup_push(listener_cleanup, irwi);
     for (;;) {
-        // Block until something is available - do NOT hold the lock!
-        status = FinesseReadyRequestWait(ccs->client_shm);
+        // Block until something is available - do NOT hold the lock!  We wake up now and then to
+        // see if the client died without shutting down.
+        status = FinesseReadyRequestTimedWait(ccs->client_shm, FINESSE_CLIENT_LIVENESS_MS);
+        if ((ETIMEDOUT == status) && client_hung_up(ccs)) {
+            status = ENOTCONN;
+        }
+
         if (ENOTCONN == status) {
-            // shutdown;
+            // The client is gone.  Once the server has finished with whatever it took from the
+            // client, kick a server thread to tear the connection down; that thread also joins us.
+            __atomic_store_n(&ccs->client_gone, 1, __ATOMIC_SEQ_CST);
+            while (client_busy(ccs)) {
+                usleep(1000);
+            }
+            pthread_mutex_lock(&scs->monitor_mutex);
+            scs->waiting_client_request_bitmap |= pending_bit;
+            pthread_cond_signal(&scs->server_cond);
+            pthread_mutex_unlock(&scs->monitor_mutex);
             break;
         }
+
+        if (ETIMEDOUT == status) {
+            continue;
+        }
+
         locked_count++;  // debug
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += FINESSE_CLIENT_LIVENESS_MS / 1000;
         pthread_mutex_lock(&scs->monitor_mutex);
-        scs->waiting_client_request_bitmap |= pending_bit;           // turn on bit - something waiting
-        pthread_cond_signal(&scs->server_cond);                      // notify server we've turned on a bit
-        pthread_cond_wait(&scs->monitor_cond, &scs->monitor_mutex);  // wait for server to tell us to look again
-        scs->waiting_client_request_bitmap &= ~pending_bit;          // turn off bit (we need to check again)
+        scs->waiting_client_request_bitmap |= pending_bit;  // turn on bit - something waiting
+        pthread_cond_signal(&scs->server_cond);             // notify server we've turned on a bit
+        // wait for server to tell us to look again (or until it's time to check on the client)
+        (void)pthread_cond_timedwait(&scs->monitor_cond, &scs->monitor_mutex, &deadline);
+        scs->waiting_client_request_bitmap &= ~pending_bit;  // turn off bit (we need to check again)
         pthread_mutex_unlock(&scs->monitor_mutex);
     }
-    ccs->monitor_thread_active = 0;
     pthread_cleanup_pop(0);
 
     free(irwi);
@@ -324,6 +444,9 @@ static void *listener_worker(void *context)
                 assert(NULL != irwi);
                 irwi->index                                      = index;
                 irwi->Scs                                        = scs;
+                scs->client_queue_depth[index]                   = 0;
+                scs->client_in_flight[index]                     = 0;
+                scs->client_requests[index]                      = 0;
                 scs->client_server_connection_state_table[index] = new_client;
                 status = pthread_create(&new_client->monitor_thread, NULL, inbound_request_worker, irwi);
                 assert(0 == status);
@@ -498,6 +621,7 @@ int FinesseStopServerConnection(finesse_server_handle_t FinesseServerHandle)
 
     for (unsigned index = 0; index < SHM_MESSAGE_COUNT; index++) {
         if (NULL != scs->client_server_connection_state_table[index]) {
+            client_disconnected(scs, index);
             teardown_client_connection(scs->client_server_connection_state_table[index]);
             scs->client_server_connection_state_table[index] = NULL;
         }
@@ -554,27 +678,51 @@ static int scan_for_request(unsigned start, unsigned end, server_internal_connec
 
     // We need to scan across the connected clients to find a message
     for (unsigned i = start; i < end; i++) {
-        // ignore empty table entries
-        if (NULL == scs->client_server_connection_state_table[i]) {
-            assert(0 == ((*bitmap) & make_mask64(i)));  // shouldn't be set!
-            continue;                                   // no client
-        }
+        server_connection_state_t *ccs = NULL;
 
         // if the bit is set, let's see if we can get a message
         if ((*bitmap) & make_mask64(i)) {
-            status = FinesseGetReadyRequest(scs->client_server_connection_state_table[i]->client_shm, message);
+            fincomm_shared_memory_region *fsmr = NULL;
+
+            // Pinned while we look, so the connection can't be torn down under us; a request we
+            // take is then covered by the region's ServerBitmap until it is answered.
+            ccs = pin_client(scs, i);
+            if (NULL == ccs) {
+                // The bit can only be set if another thread just cleaned up after this client
+                (*bitmap) &= ~make_mask64(i);
+                continue;  // no client
+            }
+
+            fsmr = ccs->client_shm;
+            if (__atomic_load_n(&ccs->client_gone, __ATOMIC_SEQ_CST)) {
+                // The monitor thread saw the client go; don't take anything more from it
+                status = ENOTCONN;
+            }
+            else {
+                status = FinesseGetReadyRequest(fsmr, message);
+            }
+
             if (0 == status) {
                 // we found one - capture it and break
                 *index = i;
+
+                // Sample the queue for the metrics page; these are only read by the publisher
+                __atomic_store_n(&scs->client_queue_depth[i], __builtin_popcountll(fsmr->RequestBitmap), __ATOMIC_RELAXED);
+                __atomic_store_n(&scs->client_in_flight[i], __builtin_popcountll(fsmr->AllocationBitmap), __ATOMIC_RELAXED);
+                __atomic_store_n(&scs->client_requests[i], scs->client_requests[i] + 1, __ATOMIC_RELAXED);
+                unpin_client(ccs);
                 break;
             }
             if (ENOTCONN == status) {
                 // This client has disconnected
-                teardown_client_connection(scs->client_server_connection_state_table[i]);
-                scs->client_server_connection_state_table[i] = NULL;
-                status                                       = ENOENT;
+                (*bitmap) &= ~make_mask64(i);
+                status = ENOENT;
+                __atomic_store_n(&ccs->client_gone, 1, __ATOMIC_SEQ_CST);
+                unpin_client(ccs);
+                reap_client(scs, i, ccs);
                 continue;  // try the next client
             }
+            unpin_client(ccs);
             assert(ENOENT == status);  // otherwise, this logic is broken
             // We clear the bit
             (*bitmap) &= ~make_mask64(i);
@@ -762,26 +910,36 @@ void fincomm_release_aux_shm(finesse_server_handle_t ServerHandle, unsigned Clie
     scs->aux_shm_table[MessageIndex].AuxInUse = 0;
 }
 
+//
+// The aux buffer belongs to the message slot: it is the server's to fill until it sends the
+// response, and the client's to read (by name) until it frees the response.
+//
+static unsigned GetAuxMessageIndex(server_internal_connection_state_t *scs, unsigned Index, void *Message)
+{
+    uintptr_t region;
+    unsigned  messageIndex;
+
+    assert(NULL != scs);
+    assert(Index < SHM_MESSAGE_COUNT);
+    assert(NULL != scs->client_server_connection_state_table[Index]);
+
+    region       = (uintptr_t)scs->client_server_connection_state_table[Index]->client_shm;
+    messageIndex = (unsigned)((((uintptr_t)Message - region) / SHM_PAGE_SIZE) - 1);
+    assert(messageIndex < SHM_MESSAGE_COUNT);
+
+    return messageIndex;
+}
+
 int FinesseGetMessageAuxBuffer(finesse_server_handle_t FinesseServerHandle, void *Client, void *Message, void **Buffer,
                                size_t *BufferSize)
 {
-    unsigned                            index;
-    server_internal_connection_state_t *scs = (server_internal_connection_state_t *)FinesseServerHandle;
+    server_internal_connection_state_t *scs   = (server_internal_connection_state_t *)FinesseServerHandle;
+    unsigned                            index = (unsigned)(uintptr_t)Client;
     unsigned                            messageIndex;
 
-    for (index = 0; index < SHM_MESSAGE_COUNT; index++) {
-        if (scs->client_server_connection_state_table[index] == Client) {
-            break;
-        }
-    }
-
-    assert(index < SHM_MESSAGE_COUNT);
-
     // TODO: we could use the memory inside the message itself, if there is space
 
-    messageIndex = (unsigned)((((uintptr_t)Message - (uintptr_t)scs->client_server_connection_state_table[index]->client_shm) /
-                               SHM_PAGE_SIZE) -
-                              1);
+    messageIndex = GetAuxMessageIndex(scs, index, Message);
     *Buffer      = fincomm_get_aux_shm(FinesseServerHandle, index, messageIndex, BufferSize);
 
     return 0;
@@ -789,23 +947,68 @@ int FinesseGetMessageAuxBuffer(finesse_server_handle_t FinesseServerHandle, void
 
 const char *FinesseGetMessageAuxBufferName(finesse_server_handle_t FinesseServerHandle, void *Client, void *Message)
 {
-    unsigned                            index;
+    server_internal_connection_state_t *scs   = (server_internal_connection_state_t *)FinesseServerHandle;
+    unsigned                            index = (unsigned)(uintptr_t)Client;
+
+    return fincomm_get_aux_shm_name(FinesseServerHandle, index, GetAuxMessageIndex(scs, index, Message));
+}
+
+void FinesseReleaseMessageAuxBuffer(finesse_server_handle_t FinesseServerHandle, void *Client, void *Message)
+{
+    server_internal_connection_state_t *scs   = (server_internal_connection_state_t *)FinesseServerHandle;
+    unsigned                            index = (unsigned)(uintptr_t)Client;
+
+    fincomm_release_aux_shm(FinesseServerHandle, index, GetAuxMessageIndex(scs, index, Message));
+}
+
+//
+// How much of the request's Data the client may have used (it can span several message blocks).
+//
+size_t FinesseGetRequestDataLength(finesse_server_handle_t FinesseServerHandle, void *Client, fincomm_message Message)
+{
+    return FinesseGetMessageDataLength(FcGetSharedMemoryRegion(FinesseServerHandle, (unsigned)(uintptr_t)Client), Message);
+}
+
+//
+// Tell every connected client that something changed (see FinessePostInvalidation).  Nothing
+// waits for the clients: each just finds the event in its ring the next time it looks.
+//
+void FinesseSendInvalidation(finesse_server_handle_t FinesseServerHandle, const finesse_invalidation_t *Invalidation)
+{
     server_internal_connection_state_t *scs = (server_internal_connection_state_t *)FinesseServerHandle;
-    unsigned                            messageIndex;
+    server_connection_state_t *         client;
 
-    for (index = 0; index < SHM_MESSAGE_COUNT; index++) {
-        if (scs->client_server_connection_state_table[index] == Client) {
-            break;
+    assert(NULL != FinesseServerHandle);
+    assert(NULL != Invalidation);
+
+    // A client can be reaped at any time; holding the monitor lock keeps every connection in the
+    // table mapped while we post (see reap_client).  Posting is just a write into each ring.
+    pthread_mutex_lock(&scs->monitor_mutex);
+    for (unsigned index = 0; index < SHM_MESSAGE_COUNT; index++) {
+        client = scs->client_server_connection_state_table[index];
+        if ((NULL == client) || (NULL == client->client_shm)) {
+            continue;
         }
+        FinessePostInvalidation((fincomm_shared_memory_region *)client->client_shm, Invalidation);
     }
+    pthread_mutex_unlock(&scs->monitor_mutex);
+}
 
-    assert(index < SHM_MESSAGE_COUNT);
+//
+// Handler is called (from whichever thread notices) when a client has disconnected, with the
+// same Client value its requests were handed out with.  This happens before the slot is torn
+// down, so nothing the handler sees can belong to a new client in that slot.  Pass NULL to stop
+// the calls.
+//
+void FinesseSetClientDisconnectHandler(finesse_server_handle_t FinesseServerHandle, FinesseClientDisconnectHandler Handler,
+                                       void *Context)
+{
+    server_internal_connection_state_t *scs = (server_internal_connection_state_t *)FinesseServerHandle;
 
-    messageIndex = (unsigned)((((uintptr_t)Message - (uintptr_t)scs->client_server_connection_state_table[index]->client_shm) /
-                               SHM_PAGE_SIZE) -
-                              1);
+    assert(NULL != FinesseServerHandle);
 
-    return scs->client_server_connection_state_table[index]->aux_shm_table[messageIndex].AuxShmName;
+    scs->disconnect_context = Context;
+    __atomic_store_n(&scs->disconnect_handler, Handler, __ATOMIC_RELEASE);
 }
 
 uint64_t FinesseGetActiveClientCount(finesse_server_handle_t FinesseServerHandle)
@@ -826,6 +1029,30 @@ uint64_t FinesseGetActiveClientCount(finesse_server_handle_t FinesseServerHandle
     return count;
 }
 
+//
+// Returns the most recently observed queue state for the given client slot (ENOENT if
+// there is no client in that slot).  This does not touch the client's shared memory, so
+// it is safe to call from a thread other than the one servicing requests.
+//
+int FinesseGetClientQueueStatistics(finesse_server_handle_t FinesseServerHandle, unsigned Index, uint32_t *QueueDepth,
+                                    uint32_t *InFlight, uint64_t *Requests)
+{
+    server_internal_connection_state_t *scs = (server_internal_connection_state_t *)FinesseServerHandle;
+
+    assert(NULL != FinesseServerHandle);
+    assert(Index < SHM_MESSAGE_COUNT);
+
+    if (NULL == __atomic_load_n(&scs->client_server_connection_state_table[Index], __ATOMIC_RELAXED)) {
+        return ENOENT;
+    }
+
+    *QueueDepth = __atomic_load_n(&scs->client_queue_depth[Index], __ATOMIC_RELAXED);
+    *InFlight   = __atomic_load_n(&scs->client_in_flight[Index], __ATOMIC_RELAXED);
+    *Requests   = __atomic_load_n(&scs->client_requests[Index], __ATOMIC_RELAXED);
+
+    return 0;
+}
+
 // older glibc versions do not include this linux system call
 static pid_t finesse_gettid(void)
 {
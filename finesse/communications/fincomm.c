@@ -15,6 +15,7 @@
 #include <mqueue.h>
 #include <openssl/sha.h>
 #include <pthread.h>
+#include <sched.h>
 #include <signal.h>
 #include <stdarg.h>
 #include <stddef.h>
@@ -114,6 +115,39 @@ static u_int64_t get_request_number(u_int64_t *RequestNumber)
     return request_number;
 }
 
+static fincomm_message InitializeRequestMessage(fincomm_shared_memory_region *RequestRegion, unsigned Index,
+                                                FINESSE_MESSAGE_CLASS MessageClass, int MessageType)
+{
+    fincomm_message message = (fincomm_message)&RequestRegion->Messages[Index];
+    finesse_msg *   fmsg    = (finesse_msg *)message->Data;
+
+    message->MessageType = FINESSE_REQUEST;
+    message->Result      = ENOSYS;
+    fmsg->Version        = FINESSE_MESSAGE_VERSION;
+    fmsg->MessageClass   = MessageClass;
+
+    switch (fmsg->MessageClass) {
+        default:
+            // Invalid
+            assert(0);
+            break;
+        case FINESSE_FUSE_MESSAGE:
+            fmsg->Message.Fuse.Request.Type = (FINESSE_FUSE_REQ_TYPE)MessageType;
+            assert((fmsg->Message.Fuse.Request.Type >= FINESSE_FUSE_REQ_BASE_TYPE) &&
+                   (fmsg->Message.Fuse.Request.Type < FINESSE_FUSE_REQ_MAX));
+            break;
+        case FINESSE_NATIVE_MESSAGE:
+            fmsg->Message.Native.Request.NativeRequestType = (FINESSE_NATIVE_REQ_TYPE)MessageType;
+            assert((fmsg->Message.Native.Request.NativeRequestType >= FINESSE_NATIVE_REQ_BASE_TYPE) &&
+                   (fmsg->Message.Native.Request.NativeRequestType < FINESSE_NATIVE_REQ_MAX));
+            break;
+    }
+
+    FincommCallStatRequestStart(message);
+
+    return message;
+}
+
 fincomm_message FinesseGetRequestBuffer(fincomm_shared_memory_region *RequestRegion, FINESSE_MESSAGE_CLASS MessageClass,
                                         int MessageType)
 {
@@ -163,37 +197,186 @@ fincomm_message FinesseGetRequestBuffer(fincomm_shared_memory_region *RequestReg
     // TODO: should I initialize this region?
     if (index < SHM_MESSAGE_COUNT) {
         // success path
-        fincomm_message message = (fincomm_message)&RequestRegion->Messages[index];
-        finesse_msg *   fmsg    = (finesse_msg *)message->Data;
-
-        message->MessageType = FINESSE_REQUEST;
-        message->Result      = ENOSYS;
-        fmsg->Version        = FINESSE_MESSAGE_VERSION;
-        fmsg->MessageClass   = MessageClass;
-
-        switch (fmsg->MessageClass) {
-            default:
-                // Invalid
-                assert(0);
-                break;
-            case FINESSE_FUSE_MESSAGE:
-                fmsg->Message.Fuse.Request.Type = (FINESSE_FUSE_REQ_TYPE)MessageType;
-                assert((fmsg->Message.Fuse.Request.Type >= FINESSE_FUSE_REQ_BASE_TYPE) &&
-                       (fmsg->Message.Fuse.Request.Type < FINESSE_FUSE_REQ_MAX));
-                break;
-            case FINESSE_NATIVE_MESSAGE:
-                fmsg->Message.Native.Request.NativeRequestType = (FINESSE_NATIVE_REQ_TYPE)MessageType;
-                assert((fmsg->Message.Native.Request.NativeRequestType >= FINESSE_NATIVE_REQ_BASE_TYPE) &&
-                       (fmsg->Message.Native.Request.NativeRequestType < FINESSE_NATIVE_REQ_MAX));
+        return InitializeRequestMessage(RequestRegion, index, MessageClass, MessageType);
+    }
+
+    return NULL;
+}
+
+//
+// Allocate a request with room for at least DataLength bytes of Data.  Anything that fits in one
+// message block is just FinesseGetRequestBuffer; otherwise we need a run of free blocks, and we
+// wait for one (other threads' messages are short lived).  Returns NULL if DataLength is larger
+// than FINESSE_MAX_MESSAGE_DATA_LENGTH.
+//
+fincomm_message FinesseGetRequestBufferForLength(fincomm_shared_memory_region *RequestRegion, FINESSE_MESSAGE_CLASS MessageClass,
+                                                 int MessageType, size_t DataLength)
+{
+    unsigned  slots;
+    unsigned  index = SHM_MESSAGE_COUNT;
+    u_int64_t run;
+    u_int64_t mask;
+    u_int64_t bitmap;
+
+    CHECK_SHM_SIGNATURE(RequestRegion);
+
+    if (DataLength > FINESSE_MAX_MESSAGE_DATA_LENGTH) {
+        return NULL;
+    }
+
+    slots = (unsigned)((offsetof(fincomm_message_block, Data) + DataLength + SHM_PAGE_SIZE - 1) / SHM_PAGE_SIZE);
+    if (slots <= 1) {
+        return FinesseGetRequestBuffer(RequestRegion, MessageClass, MessageType);
+    }
+    assert(slots <= FINESSE_MAX_MESSAGE_SLOTS);
+
+    run = make_mask64(slots) - 1;
+    while (SHM_MESSAGE_COUNT == index) {
+        for (index = 0; index + slots <= SHM_MESSAGE_COUNT; index++) {
+            mask   = run << index;
+            bitmap = RequestRegion->AllocationBitmap;
+            if (0 != (bitmap & mask)) {
+                continue;  // some of this run is in use
+            }
+            if (__sync_bool_compare_and_swap(&RequestRegion->AllocationBitmap, bitmap, bitmap | mask)) {
+                // found our run
                 break;
+            }
+            index--;  // we raced; try this run again
         }
 
-        FincommCallStatRequestStart(message);
+        if (index + slots > SHM_MESSAGE_COUNT) {
+            // No room right now
+            index = SHM_MESSAGE_COUNT;
+            sched_yield();
+        }
+    }
+
+    // Only the first slot of the run is ever signaled, so that's all anyone else needs to know
+    RequestRegion->MessageSlots[index] = (u_int8_t)slots;
+    assert(0 == (RequestRegion->RequestBitmap & make_mask64(index)));
+
+    return InitializeRequestMessage(RequestRegion, index, MessageClass, MessageType);
+}
+
+//
+// The number of bytes available in the message's Data, which may span more than one block.
+//
+size_t FinesseGetMessageDataLength(fincomm_shared_memory_region *RequestRegion, fincomm_message Message)
+{
+    unsigned index = (unsigned)((((uintptr_t)Message - (uintptr_t)RequestRegion) / SHM_PAGE_SIZE) - 1);
+    unsigned slots;
+
+    assert(index < SHM_MESSAGE_COUNT);
+    assert(&RequestRegion->Messages[index] == Message);
 
-        return message;
+    slots = RequestRegion->MessageSlots[index];
+    if ((0 == slots) || (index + slots > SHM_MESSAGE_COUNT)) {
+        // The server uses this too, so don't trust it beyond the end of the region
+        slots = 1;
     }
 
-    return NULL;
+    return (slots * SHM_PAGE_SIZE) - offsetof(fincomm_message_block, Data);
+}
+
+//
+// Post an invalidation to the region's ring.  Any number of server threads may post at once; each
+// event's slot is marked (Sequence = 0) while it is being filled in, so a reader can tell a
+// complete event from one that is being written or overwritten.
+//
+void FinessePostInvalidation(fincomm_shared_memory_region *Region, const finesse_invalidation_t *Invalidation)
+{
+    u_int64_t               sequence;
+    finesse_invalidation_t *slot;
+
+    CHECK_SHM_SIGNATURE(Region);
+    assert(NULL != Invalidation);
+
+    sequence = __atomic_fetch_add(&Region->InvalidationHead, 1, __ATOMIC_ACQ_REL);
+    slot     = &Region->Invalidations[sequence % FINESSE_INVALIDATION_RING_SIZE];
+
+    __atomic_store_n(&slot->Sequence, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    slot->Type       = Invalidation->Type;
+    slot->NameLength = Invalidation->NameLength;
+    slot->Reserved   = 0;
+    slot->Inode      = Invalidation->Inode;
+    slot->Parent     = Invalidation->Parent;
+    memcpy(slot->Key, Invalidation->Key, sizeof(uuid_t));
+    memcpy(slot->ParentKey, Invalidation->ParentKey, sizeof(uuid_t));
+    memcpy(slot->Name, Invalidation->Name, sizeof(slot->Name));
+
+    __atomic_store_n(&slot->Sequence, sequence + 1, __ATOMIC_RELEASE);
+}
+
+//
+// Copy up to MaxCount of the events posted since *Cursor (0 for "from the beginning") and advance
+// *Cursor past them; *Count may be less than MaxCount if an event is still being written, the
+// caller simply asks again later.  Returns EOVERFLOW if some of the events since *Cursor have
+// been overwritten: the caller must drop everything it has cached, and *Cursor is moved to the
+// current end of the ring.
+//
+int FinesseReadInvalidations(fincomm_shared_memory_region *Region, u_int64_t *Cursor, finesse_invalidation_t *Invalidations,
+                             unsigned MaxCount, unsigned *Count)
+{
+    u_int64_t                     head;
+    u_int64_t                     cursor;
+    u_int64_t                     before;
+    u_int64_t                     after;
+    const finesse_invalidation_t *slot;
+
+    CHECK_SHM_SIGNATURE(Region);
+    assert(NULL != Cursor);
+    assert(NULL != Count);
+    assert((0 == MaxCount) || (NULL != Invalidations));
+
+    *Count = 0;
+    cursor = *Cursor;
+    head   = __atomic_load_n(&Region->InvalidationHead, __ATOMIC_ACQUIRE);
+
+    while ((cursor < head) && (*Count < MaxCount)) {
+        if (head - cursor > FINESSE_INVALIDATION_RING_SIZE) {
+            break;  // lost some
+        }
+
+        slot   = &Region->Invalidations[cursor % FINESSE_INVALIDATION_RING_SIZE];
+        before = __atomic_load_n(&slot->Sequence, __ATOMIC_ACQUIRE);
+        if (before != cursor + 1) {
+            if (before > cursor + 1) {
+                break;  // overwritten
+            }
+            // Not finished yet (or it's being overwritten; we'll find out next time)
+            *Cursor = cursor;
+            return 0;
+        }
+
+        memcpy(&Invalidations[*Count], slot, sizeof(finesse_invalidation_t));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        after = __atomic_load_n(&slot->Sequence, __ATOMIC_RELAXED);
+        if (after != before) {
+            break;  // overwritten while we copied it
+        }
+
+        (*Count)++;
+        cursor++;
+        head = __atomic_load_n(&Region->InvalidationHead, __ATOMIC_ACQUIRE);
+    }
+
+    if (head - cursor > FINESSE_INVALIDATION_RING_SIZE) {
+        *Cursor = __atomic_load_n(&Region->InvalidationHead, __ATOMIC_ACQUIRE);
+        return EOVERFLOW;
+    }
+
+    if ((cursor < head) && (*Count < MaxCount)) {
+        // We stopped on an overwritten event
+        *Cursor = __atomic_load_n(&Region->InvalidationHead, __ATOMIC_ACQUIRE);
+        return EOVERFLOW;
+    }
+
+    *Cursor = cursor;
+    return 0;
 }
 
 u_int64_t FinesseRequestReady(fincomm_shared_memory_region *RequestRegion, fincomm_message Message)
@@ -245,6 +428,7 @@ void FinesseResponseReady(fincomm_shared_memory_region *RequestRegion, fincomm_m
     pthread_mutex_lock(&RequestRegion->ResponseMutex);
     assert(0 == (RequestRegion->ResponseBitmap & make_mask64(index)));  // this should NOT be set
     RequestRegion->ResponseBitmap |= make_mask64(index);
+    __atomic_fetch_and(&RequestRegion->ServerBitmap, ~make_mask64(index), __ATOMIC_SEQ_CST);
     pthread_cond_broadcast(&RequestRegion->ResponsePending);
     pthread_mutex_unlock(&RequestRegion->ResponseMutex);
 }
@@ -303,6 +487,44 @@ int FinesseReadyRequestWait(fincomm_shared_memory_region *RequestRegion)
     return status;
 }
 
+// As FinesseReadyRequestWait, but gives up (ETIMEDOUT) after Milliseconds so the caller
+// can check on a client that may have died without shutting down.
+int FinesseReadyRequestTimedWait(fincomm_shared_memory_region *RequestRegion, unsigned Milliseconds)
+{
+    int             status = 0;
+    struct timespec deadline;
+
+    CHECK_SHM_SIGNATURE(RequestRegion);
+
+    // The condition variable uses the default (realtime) clock
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += Milliseconds / 1000;
+    deadline.tv_nsec += (long)(Milliseconds % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&RequestRegion->RequestMutex);
+
+    while ((0 == RequestRegion->RequestBitmap) && (0 == RequestRegion->ShutdownRequested) && (ETIMEDOUT != status)) {
+        RequestRegion->RequestWaiters++;
+        status = pthread_cond_timedwait(&RequestRegion->RequestPending, &RequestRegion->RequestMutex, &deadline);
+        RequestRegion->RequestWaiters--;
+    }
+
+    if (0 != RequestRegion->RequestBitmap) {
+        status = 0;
+    }
+    pthread_mutex_unlock(&RequestRegion->RequestMutex);
+
+    if (RequestRegion->ShutdownRequested) {
+        status = ENOTCONN;
+    }
+
+    return status;
+}
+
 // Returns a ready request; if there isn't one, it returns ENOENT.  ENOTCONN returned for shutdown.
 // DOES NOT BLOCK.
 int FinesseGetReadyRequest(fincomm_shared_memory_region *RequestRegion, fincomm_message *message)
@@ -371,6 +593,7 @@ int FinesseGetReadyRequest(fincomm_shared_memory_region *RequestRegion, fincomm_
     if (index < SHM_MESSAGE_COUNT) {
         // sanity: make sure the bit we're clearing was set
         assert(original_bitmap & make_mask64(index));
+        __atomic_fetch_or(&RequestRegion->ServerBitmap, make_mask64(index), __ATOMIC_SEQ_CST);
     }
     pthread_mutex_unlock(&RequestRegion->RequestMutex);
 
@@ -402,6 +625,9 @@ int FinesseInitializeMemoryRegion(fincomm_shared_memory_region *Fsmr)
     Fsmr->RequestBitmap  = 0;
     Fsmr->ResponseBitmap = 0;
     Fsmr->RequestWaiters = 0;
+    memset(Fsmr->MessageSlots, 0, sizeof(Fsmr->MessageSlots));
+    memset(Fsmr->Invalidations, 0, sizeof(Fsmr->Invalidations));
+    Fsmr->InvalidationHead = 0;
     memset(Fsmr->UnusedRegion, 0, sizeof(Fsmr->UnusedRegion));
     Fsmr->AllocationBitmap    = 0;
     Fsmr->RequestId           = (u_int64_t)(-10);
@@ -0,0 +1,116 @@
+/*
+ * (C) Copyright 2020 Tony Mason
+ * All Rights Reserved
+ */
+
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "fcinternal.h"
+#include "finesse-metrics.h"
+
+//
+// The metrics page is a POSIX shared memory object named after the server
+// connection (which is itself derived from the mount point), so a monitor only
+// needs to know the mount point to find it.
+//
+int FinesseMetricsGenerateName(const char *MountPoint, char *Name, size_t NameLength)
+{
+    char        server_name[MAX_SHM_PATH_NAME];
+    const char *base   = NULL;
+    int         status = 0;
+
+    status = GenerateServerName(MountPoint, server_name, sizeof(server_name));
+    if (0 != status) {
+        return status;
+    }
+
+    base = strrchr(server_name, '/');
+    base = (NULL == base) ? server_name : base + 1;
+
+    status = snprintf(Name, NameLength, "/%s-metrics", base);
+    if ((size_t)status >= NameLength) {
+        return EOVERFLOW;
+    }
+
+    return 0;
+}
+
+finesse_metrics_page_t *FinesseMetricsOpen(const char *MountPoint)
+{
+    char                    name[MAX_SHM_PATH_NAME];
+    finesse_metrics_page_t *page = MAP_FAILED;
+    struct stat             stbuf;
+    int                     fd = -1;
+
+    while (MAP_FAILED == page) {
+        if (0 != FinesseMetricsGenerateName(MountPoint, name, sizeof(name))) {
+            break;
+        }
+
+        fd = shm_open(name, O_RDONLY, 0);
+        if (fd < 0) {
+            break;
+        }
+
+        if ((0 != fstat(fd, &stbuf)) || ((size_t)stbuf.st_size < sizeof(finesse_metrics_page_t))) {
+            break;
+        }
+
+        page = (finesse_metrics_page_t *)mmap(NULL, sizeof(finesse_metrics_page_t), PROT_READ, MAP_SHARED, fd, 0);
+        if (MAP_FAILED == page) {
+            break;
+        }
+
+        if ((FINESSE_METRICS_MAGIC != page->Magic) || (FINESSE_METRICS_VERSION != page->Version) ||
+            (sizeof(finesse_metrics_page_t) != page->Length)) {
+            munmap(page, sizeof(finesse_metrics_page_t));
+            page  = MAP_FAILED;
+            errno = EINVAL;
+        }
+
+        break;
+    }
+
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+
+    return (MAP_FAILED == page) ? NULL : page;
+}
+
+void FinesseMetricsClose(finesse_metrics_page_t *Page)
+{
+    if (NULL != Page) {
+        munmap(Page, sizeof(finesse_metrics_page_t));
+    }
+}
+
+//
+// Copy the page, retrying until we get a copy that wasn't being updated while we read it.
+// Returns EAGAIN if the publisher is continuously busy (or has died mid-update).
+//
+int FinesseMetricsSnapshot(const finesse_metrics_page_t *Page, finesse_metrics_page_t *Snapshot)
+{
+    uint64_t before = 0;
+    uint64_t after  = 0;
+
+    for (unsigned retries = 0; retries < 1000; retries++) {
+        before = __atomic_load_n(&Page->Sequence, __ATOMIC_ACQUIRE);
+        if (before & 1) {
+            sched_yield();
+            continue;
+        }
+
+        memcpy(Snapshot, Page, sizeof(finesse_metrics_page_t));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        after = __atomic_load_n(&Page->Sequence, __ATOMIC_RELAXED);
+        if (before == after) {
+            return 0;
+        }
+    }
+
+    return EAGAIN;
+}
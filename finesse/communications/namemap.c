@@ -15,15 +15,21 @@ int FinesseSendNameMapRequest(finesse_client_handle_t FinesseClientHandle, uuid_
     fincomm_shared_memory_region *fsmr;
     fincomm_message               message = NULL;
     finesse_msg *                 fmsg    = NULL;
-    size_t                        nameLength, bufSize;
+    size_t                        nameLength;
 
     assert(NULL != ccs);
     fsmr = (fincomm_shared_memory_region *)ccs->server_shm;
     assert(NULL != fsmr);
-    message = FinesseGetRequestBuffer(fsmr, FINESSE_NATIVE_MESSAGE, FINESSE_NATIVE_REQ_MAP);
-    assert(NULL != message);
-    fmsg = (finesse_msg *)message->Data;
     assert(NULL != NameToMap);
+    nameLength = strlen(NameToMap);
+
+    // A long name uses more than one message block
+    message = FinesseGetRequestBufferForLength(fsmr, FINESSE_NATIVE_MESSAGE, FINESSE_NATIVE_REQ_MAP,
+                                               offsetof(finesse_msg, Message.Native.Request.Parameters.Map.Name) + nameLength + 1);
+    if (NULL == message) {
+        return ENAMETOOLONG;
+    }
+    fmsg = (finesse_msg *)message->Data;
 
     if (NULL == ParentDir) {
         memset(fmsg->Message.Native.Request.Parameters.Map.Parent, 0, sizeof(uuid_t));
@@ -34,10 +40,6 @@ int FinesseSendNameMapRequest(finesse_client_handle_t FinesseClientHandle, uuid_
 
     fmsg->Message.Native.Request.Parameters.Map.Flags = Flags;
 
-    nameLength = strlen(NameToMap);
-    bufSize    = SHM_PAGE_SIZE - offsetof(finesse_msg, Message.Native.Request.Parameters.Map.Name);
-
-    assert(nameLength < bufSize);
     memcpy(fmsg->Message.Native.Request.Parameters.Map.Name, NameToMap, nameLength + 1);
     assert(strlen(fmsg->Message.Native.Request.Parameters.Map.Name) == nameLength);
     memset(fmsg->Message.Native.Request.Parameters.Map.Parent, 0, sizeof(fmsg->Message.Native.Request.Parameters.Map.Parent));
@@ -0,0 +1,232 @@
+/*
+ * (C) Copyright 2020 Tony Mason
+ * All Rights Reserved
+ */
+
+#include <fcinternal.h>
+
+//
+// The name space operations: mkdir, rmdir, rename, link and symlink.  Each names its object(s)
+// by a Parent key and a name relative to it or, with a NULL (or null) Parent, by an absolute
+// path.  All of them are answered with just a result (FinesseSendNamespaceResponse), which is
+// ENOTSUP when the server can't do it (e.g. the path goes through a symlink) and the client
+// should do it itself.
+//
+
+static void SetParent(uuid_t Target, uuid_t *Parent)
+{
+    if (NULL == Parent) {
+        uuid_clear(Target);
+    }
+    else {
+        memcpy(Target, Parent, sizeof(uuid_t));
+    }
+}
+
+static int NamespaceRequestReady(fincomm_shared_memory_region *Fsmr, fincomm_message Message, fincomm_message *Result)
+{
+    int status;
+
+    status = FinesseRequestReady(Fsmr, Message);
+    assert(0 != status);  // invalid request ID
+    *Result = Message;
+
+    return 0;
+}
+
+int FinesseSendMkdirRequest(finesse_client_handle_t FinesseClientHandle, uuid_t *Parent, const char *Name, mode_t Mode,
+                            fincomm_message *Message)
+{
+    client_connection_state_t *   ccs = FinesseClientHandle;
+    fincomm_shared_memory_region *fsmr;
+    fincomm_message               message;
+    finesse_msg *                 fmsg;
+    size_t                        nameLength;
+
+    assert(NULL != ccs);
+    fsmr = (fincomm_shared_memory_region *)ccs->server_shm;
+    assert(NULL != fsmr);
+    assert(NULL != Name);
+    nameLength = strlen(Name) + 1;
+
+    message = FinesseGetRequestBufferForLength(fsmr, FINESSE_FUSE_MESSAGE, FINESSE_FUSE_REQ_MKDIR,
+                                               offsetof(finesse_msg, Message.Fuse.Request.Parameters.Mkdir.Name) + nameLength);
+    if (NULL == message) {
+        return ENAMETOOLONG;
+    }
+    fmsg = (finesse_msg *)message->Data;
+
+    SetParent(fmsg->Message.Fuse.Request.Parameters.Mkdir.Parent, Parent);
+    fmsg->Message.Fuse.Request.Parameters.Mkdir.mode = Mode;
+    memcpy(fmsg->Message.Fuse.Request.Parameters.Mkdir.Name, Name, nameLength);
+
+    return NamespaceRequestReady(fsmr, message, Message);
+}
+
+int FinesseSendRmdirRequest(finesse_client_handle_t FinesseClientHandle, uuid_t *Parent, const char *Name, fincomm_message *Message)
+{
+    client_connection_state_t *   ccs = FinesseClientHandle;
+    fincomm_shared_memory_region *fsmr;
+    fincomm_message               message;
+    finesse_msg *                 fmsg;
+    size_t                        nameLength;
+
+    assert(NULL != ccs);
+    fsmr = (fincomm_shared_memory_region *)ccs->server_shm;
+    assert(NULL != fsmr);
+    assert(NULL != Name);
+    nameLength = strlen(Name) + 1;
+
+    message = FinesseGetRequestBufferForLength(fsmr, FINESSE_FUSE_MESSAGE, FINESSE_FUSE_REQ_RMDIR,
+                                               offsetof(finesse_msg, Message.Fuse.Request.Parameters.Rmdir.Name) + nameLength);
+    if (NULL == message) {
+        return ENAMETOOLONG;
+    }
+    fmsg = (finesse_msg *)message->Data;
+
+    SetParent(fmsg->Message.Fuse.Request.Parameters.Rmdir.Parent, Parent);
+    memcpy(fmsg->Message.Fuse.Request.Parameters.Rmdir.Name, Name, nameLength);
+
+    return NamespaceRequestReady(fsmr, message, Message);
+}
+
+//
+// Flags are rename2's (RENAME_NOREPLACE, RENAME_EXCHANGE).
+//
+int FinesseSendRenameRequest(finesse_client_handle_t FinesseClientHandle, uuid_t *Parent, const char *OldName, uuid_t *NewParent,
+                             const char *NewName, unsigned Flags, fincomm_message *Message)
+{
+    client_connection_state_t *   ccs = FinesseClientHandle;
+    fincomm_shared_memory_region *fsmr;
+    fincomm_message               message;
+    finesse_msg *                 fmsg;
+    size_t                        oldLength, newLength;
+
+    assert(NULL != ccs);
+    fsmr = (fincomm_shared_memory_region *)ccs->server_shm;
+    assert(NULL != fsmr);
+    assert(NULL != OldName);
+    assert(NULL != NewName);
+    oldLength = strlen(OldName) + 1;
+    newLength = strlen(NewName) + 1;
+
+    message = FinesseGetRequestBufferForLength(fsmr, FINESSE_FUSE_MESSAGE, FINESSE_FUSE_REQ_RENAME,
+                                               offsetof(finesse_msg, Message.Fuse.Request.Parameters.Rename.OldAndNewName) +
+                                                   oldLength + newLength);
+    if (NULL == message) {
+        return ENAMETOOLONG;
+    }
+    fmsg = (finesse_msg *)message->Data;
+
+    SetParent(fmsg->Message.Fuse.Request.Parameters.Rename.Parent, Parent);
+    SetParent(fmsg->Message.Fuse.Request.Parameters.Rename.NewParent, NewParent);
+    fmsg->Message.Fuse.Request.Parameters.Rename.flags = Flags;
+    memcpy(fmsg->Message.Fuse.Request.Parameters.Rename.OldAndNewName, OldName, oldLength);
+    memcpy(fmsg->Message.Fuse.Request.Parameters.Rename.OldAndNewName + oldLength, NewName, newLength);
+
+    return NamespaceRequestReady(fsmr, message, Message);
+}
+
+int FinesseSendLinkRequest(finesse_client_handle_t FinesseClientHandle, uuid_t *Parent, const char *OldName, uuid_t *NewParent,
+                           const char *NewName, fincomm_message *Message)
+{
+    client_connection_state_t *   ccs = FinesseClientHandle;
+    fincomm_shared_memory_region *fsmr;
+    fincomm_message               message;
+    finesse_msg *                 fmsg;
+    size_t                        oldLength, newLength;
+
+    assert(NULL != ccs);
+    fsmr = (fincomm_shared_memory_region *)ccs->server_shm;
+    assert(NULL != fsmr);
+    assert(NULL != OldName);
+    assert(NULL != NewName);
+    oldLength = strlen(OldName) + 1;
+    newLength = strlen(NewName) + 1;
+
+    message = FinesseGetRequestBufferForLength(fsmr, FINESSE_FUSE_MESSAGE, FINESSE_FUSE_REQ_LINK,
+                                               offsetof(finesse_msg, Message.Fuse.Request.Parameters.Link.OldAndNewName) +
+                                                   oldLength + newLength);
+    if (NULL == message) {
+        return ENAMETOOLONG;
+    }
+    fmsg = (finesse_msg *)message->Data;
+
+    SetParent(fmsg->Message.Fuse.Request.Parameters.Link.Parent, Parent);
+    SetParent(fmsg->Message.Fuse.Request.Parameters.Link.NewParent, NewParent);
+    memcpy(fmsg->Message.Fuse.Request.Parameters.Link.OldAndNewName, OldName, oldLength);
+    memcpy(fmsg->Message.Fuse.Request.Parameters.Link.OldAndNewName + oldLength, NewName, newLength);
+
+    return NamespaceRequestReady(fsmr, message, Message);
+}
+
+//
+// Target is what the link points to (it is not interpreted); Name is the link.
+//
+int FinesseSendSymlinkRequest(finesse_client_handle_t FinesseClientHandle, const char *Target, uuid_t *Parent, const char *Name,
+                              fincomm_message *Message)
+{
+    client_connection_state_t *   ccs = FinesseClientHandle;
+    fincomm_shared_memory_region *fsmr;
+    fincomm_message               message;
+    finesse_msg *                 fmsg;
+    size_t                        targetLength, nameLength;
+
+    assert(NULL != ccs);
+    fsmr = (fincomm_shared_memory_region *)ccs->server_shm;
+    assert(NULL != fsmr);
+    assert(NULL != Target);
+    assert(NULL != Name);
+    targetLength = strlen(Target) + 1;
+    nameLength   = strlen(Name) + 1;
+
+    message = FinesseGetRequestBufferForLength(fsmr, FINESSE_FUSE_MESSAGE, FINESSE_FUSE_REQ_SYMLINK,
+                                               offsetof(finesse_msg, Message.Fuse.Request.Parameters.Symlink.LinkAndName) +
+                                                   targetLength + nameLength);
+    if (NULL == message) {
+        return ENAMETOOLONG;
+    }
+    fmsg = (finesse_msg *)message->Data;
+
+    SetParent(fmsg->Message.Fuse.Request.Parameters.Symlink.Parent, Parent);
+    memcpy(fmsg->Message.Fuse.Request.Parameters.Symlink.LinkAndName, Target, targetLength);
+    memcpy(fmsg->Message.Fuse.Request.Parameters.Symlink.LinkAndName + targetLength, Name, nameLength);
+
+    return NamespaceRequestReady(fsmr, message, Message);
+}
+
+int FinesseSendNamespaceResponse(finesse_server_handle_t FinesseServerHandle, void *Client, fincomm_message Message, int Result)
+{
+    fincomm_shared_memory_region *fsmr = NULL;
+    finesse_msg *                 ffm;
+    unsigned                      index = (unsigned)(uintptr_t)Client;
+
+    fsmr = FcGetSharedMemoryRegion(FinesseServerHandle, index);
+    assert(NULL != fsmr);
+    assert(index < SHM_MESSAGE_COUNT);
+    assert(0 != Message);
+    assert(FINESSE_REQUEST == Message->MessageType);
+
+    Message->Result      = Result;
+    Message->MessageType = FINESSE_RESPONSE;
+
+    ffm                             = (finesse_msg *)Message->Data;
+    ffm->Version                    = FINESSE_MESSAGE_VERSION;
+    ffm->MessageClass               = FINESSE_FUSE_MESSAGE;
+    ffm->Result                     = Result;
+    ffm->Message.Fuse.Response.Type = FINESSE_FUSE_RSP_ERR;
+
+    FinesseResponseReady(fsmr, Message, 0);
+
+    return 0;
+}
+
+int FinesseGetNamespaceResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Message, int *Result)
+{
+    return FinesseGetReplyErrResponse(FinesseClientHandle, Message, Result);
+}
+
+void FinesseFreeNamespaceResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Response)
+{
+    FinesseFreeClientResponse(FinesseClientHandle, Response);
+}
@@ -1,4 +1,3 @@
-
 /*
  * (C) Copyright 2020 Tony Mason
  * All Rights Reserved
@@ -6,134 +5,164 @@
 
 #include <fcinternal.h>
 
-int FinesseSendPathSearchRequest(finesse_client_handle_t FinesseClientHandle, char **Files, char **Paths, fincomm_message *Message)
+//
+// Files and Paths are NULL terminated lists.  The caller is responsible for keeping the
+// request small enough to fit: FinesseGetPathSearchRequestSize says how much space a
+// given list needs, and FileCount * PathCount must not exceed FINESSE_PATH_SEARCH_MAX_MATCHES.
+// Neither list may be empty; the server answers EINVAL.
+//
+size_t FinesseGetPathSearchRequestSize(const char **Files, const char **Paths)
 {
-    int status = ENOTSUP;
-    (void) FinesseClientHandle;
-    (void) Files;
-    (void) Paths;
-    *Message = NULL;
-#if 0
-    client_connection_state_t *ccs = FinesseClientHandle;
+    size_t size = offsetof(finesse_msg, Message.Native.Request.Parameters.PathSearch.Data);
+
+    for (unsigned index = 0; NULL != Files[index]; index++) {
+        size += strlen(Files[index]) + 1;
+    }
+
+    for (unsigned index = 0; NULL != Paths[index]; index++) {
+        size += strlen(Paths[index]) + 1;
+    }
+
+    return size;
+}
+
+int FinesseSendPathSearchRequest(finesse_client_handle_t FinesseClientHandle, const char **Files, const char **Paths, int Flags,
+                                 fincomm_message *Message)
+{
+    int                           status = 0;
+    client_connection_state_t *   ccs    = FinesseClientHandle;
     fincomm_shared_memory_region *fsmr;
-    fincomm_message message = NULL;
-    finesse_msg *fmsg = NULL;
-    size_t nameLength, bufSize;
+    fincomm_message               message = NULL;
+    finesse_msg *                 fmsg    = NULL;
+    char *                        data;
+    size_t                        length;
+    unsigned                      fileCount, pathCount;
 
     assert(NULL != ccs);
+    assert(NULL != Files);
+    assert(NULL != Paths);
+    assert(FinesseGetPathSearchRequestSize(Files, Paths) <= FINESSE_MAX_MESSAGE_DATA_LENGTH);
+
     fsmr = (fincomm_shared_memory_region *)ccs->server_shm;
     assert(NULL != fsmr);
-    message = FinesseGetRequestBuffer(fsmr);
+    message = FinesseGetRequestBufferForLength(fsmr, FINESSE_NATIVE_MESSAGE, FINESSE_NATIVE_REQ_PATH_SEARCH,
+                                               FinesseGetPathSearchRequestSize(Files, Paths));
     assert(NULL != message);
-    message->MessageType = FINESSE_REQUEST;
     fmsg = (finesse_msg *)message->Data;
-    fmsg->Version = FINESSE_MESSAGE_VERSION;
-    fmsg->MessageClass = FINESSE_FUSE_MESSAGE;
-    fmsg->Message.Fuse.Request.Type = FINESSE_FUSE_REQ_UNLINK;
-    memcpy(&fmsg->Message.Fuse.Request.Parameters.Unlink.Parent, Parent, sizeof(uuid_t)); // at least for now, we only support 
-    assert(NULL != NameToUnlink);
-    nameLength = strlen(NameToUnlink);
-    bufSize = SHM_PAGE_SIZE - offsetof(finesse_msg, Message.Fuse.Request.Parameters.Unlink.Name);
-    assert(nameLength < bufSize);
-    memcpy(fmsg->Message.Fuse.Request.Parameters.Unlink.Name, NameToUnlink, nameLength+1);
+
+    data = fmsg->Message.Native.Request.Parameters.PathSearch.Data;
+    for (fileCount = 0; NULL != Files[fileCount]; fileCount++) {
+        length = strlen(Files[fileCount]) + 1;
+        memcpy(data, Files[fileCount], length);
+        data += length;
+    }
+
+    for (pathCount = 0; NULL != Paths[pathCount]; pathCount++) {
+        length = strlen(Paths[pathCount]) + 1;
+        memcpy(data, Paths[pathCount], length);
+        data += length;
+    }
+
+    assert(fileCount * pathCount <= FINESSE_PATH_SEARCH_MAX_MATCHES);
+    fmsg->Message.Native.Request.Parameters.PathSearch.Flags     = (uint32_t)Flags;
+    fmsg->Message.Native.Request.Parameters.PathSearch.FileCount = (uint16_t)fileCount;
+    fmsg->Message.Native.Request.Parameters.PathSearch.PathCount = (uint16_t)pathCount;
 
     status = FinesseRequestReady(fsmr, message);
-    assert(0 != status); // invalid request ID
+    assert(0 != status);  // invalid request ID
     *Message = message;
-    status = 0;
-#endif // 0
+    status   = 0;
 
     return status;
 }
 
-int FinesseSendPathSearchResponse(finesse_server_handle_t FinesseServerHandle, void *Client, fincomm_message Message, char *Path, int Result)
+int FinesseSendPathSearchResponse(finesse_server_handle_t FinesseServerHandle, void *Client, fincomm_message Message,
+                                  const finesse_path_search_match_t *Matches, unsigned MatchCount, int Result)
 {
-    int status = ENOTSUP;
-    (void) FinesseServerHandle;
-    (void) Client;
-    (void) Message;
-    (void) Path;
-    (void) Result;
-#if 0
-    fincomm_shared_memory_region *fsmr = NULL;
-    finesse_msg *ffm;
-    unsigned index = (unsigned)(uintptr_t)Client;
+    int                           status = 0;
+    fincomm_shared_memory_region *fsmr   = NULL;
+    finesse_msg *                 ffm;
+    unsigned                      index = (unsigned)(uintptr_t)Client;
 
     fsmr = FcGetSharedMemoryRegion(FinesseServerHandle, index);
     assert(NULL != fsmr);
-    assert (index < SHM_MESSAGE_COUNT);
+    assert(index < SHM_MESSAGE_COUNT);
     assert(0 != Message);
     assert(FINESSE_REQUEST == Message->MessageType);
-    
-    Message->Result = Result;
+    assert(MatchCount <= FINESSE_PATH_SEARCH_MAX_MATCHES);
+    assert((0 == MatchCount) || (NULL != Matches));
+
+    Message->Result      = Result;
     Message->MessageType = FINESSE_RESPONSE;
-    ffm = (finesse_msg *)Message->Data;
-    memset(ffm, 0, sizeof(finesse_msg)); // not necessary for production
-    ffm->Version = FINESSE_MESSAGE_VERSION;
-    ffm->MessageClass = FINESSE_FUSE_MESSAGE;
-    ffm->Message.Fuse.Response.Type = FINESSE_FUSE_RSP_ERR;
-    ffm->Message.Fuse.Response.Parameters.ReplyErr.Err = Result;
+
+    // Note: the matches may not be built in the message buffer (the request data lives there)
+    ffm                                                           = (finesse_msg *)Message->Data;
+    ffm->Version                                                  = FINESSE_MESSAGE_VERSION;
+    ffm->MessageClass                                             = FINESSE_NATIVE_MESSAGE;
+    ffm->Message.Native.Response.NativeResponseType               = FINESSE_NATIVE_RSP_PATH_SEARCH;
+    ffm->Message.Native.Response.Parameters.PathSearch.MatchCount = (uint16_t)MatchCount;
+    if (MatchCount > 0) {
+        memcpy(ffm->Message.Native.Response.Parameters.PathSearch.Matches, Matches,
+               MatchCount * sizeof(finesse_path_search_match_t));
+    }
 
     FinesseResponseReady(fsmr, Message, 0);
-#endif
+
     return status;
 }
 
-int FinesseGetPathSearchResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Message, char **Path)
+//
+// On entry *MatchCount is the number of entries Matches can hold (FINESSE_PATH_SEARCH_MAX_MATCHES
+// always suffices); on return it is the number the server sent.
+//
+int FinesseGetPathSearchResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Message,
+                                 finesse_path_search_match_t *Matches, unsigned *MatchCount, int *Result)
 {
-    int status = ENOTSUP;
-    (void) FinesseClientHandle;
-    (void) Message;
-    (void) Path;
-#if 0
-    client_connection_state_t *ccs = FinesseClientHandle;
-    fincomm_shared_memory_region *fsmr = NULL;
-    finesse_msg *fmsg = NULL;
+    int                           status = 0;
+    client_connection_state_t *   ccs    = FinesseClientHandle;
+    fincomm_shared_memory_region *fsmr   = NULL;
+    finesse_msg *                 fmsg   = NULL;
+    unsigned                      count;
 
     assert(NULL != ccs);
     fsmr = (fincomm_shared_memory_region *)ccs->server_shm;
     assert(NULL != fsmr);
-    assert(0 != Message);
+    assert(NULL != Message);
+    assert(NULL != MatchCount);
+    assert(NULL != Result);
 
     // This is a blocking get
     status = FinesseGetResponse(fsmr, Message, 1);
     assert(0 != status);
-    status = 0; // FinesseGetResponse is a boolean return function
+    status = 0;  // FinesseGetResponse is a boolean return function
 
     assert(FINESSE_RESPONSE == Message->MessageType);
     fmsg = (finesse_msg *)Message->Data;
     assert(FINESSE_MESSAGE_VERSION == fmsg->Version);
-    assert(FINESSE_FUSE_MESSAGE == fmsg->MessageClass);
-    assert(FINESSE_FUSE_RSP_ERR == fmsg->Message.Fuse.Response.Type);
-#endif
-    return status;
+    assert(FINESSE_NATIVE_MESSAGE == fmsg->MessageClass);
+
+    *Result = Message->Result;
+    if (FINESSE_NATIVE_RSP_PATH_SEARCH != fmsg->Message.Native.Response.NativeResponseType) {
+        // e.g. a server that doesn't know this request
+        if (0 == *Result) {
+            *Result = ENOTSUP;
+        }
+        *MatchCount = 0;
+        return status;
+    }
+
+    count = fmsg->Message.Native.Response.Parameters.PathSearch.MatchCount;
+    assert(count <= FINESSE_PATH_SEARCH_MAX_MATCHES);
+    if (count > *MatchCount) {
+        count = *MatchCount;
+    }
+    memcpy(Matches, fmsg->Message.Native.Response.Parameters.PathSearch.Matches, count * sizeof(finesse_path_search_match_t));
+    *MatchCount = count;
 
+    return status;
 }
 
 void FinesseFreePathSearchResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Response)
 {
-    // TODO: this may need to do secondary shm cleanup
     FinesseFreeClientResponse(FinesseClientHandle, Response);
 }
-
-/*
-int FinesseSendPathSearchRequest(finesse_client_handle_t FinesseClientHandle, char **Files, char **Paths, fincomm_message *Message);
-int FinesseSendPathSearchResponse(finesse_server_handle_t FinesseServerHandle, void *Client, fincomm_message Message, char *Path, int Result);
-int FinesseGetPathSearchResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Message, char **Path);
-void FinesseFreePathSearchResponse(finesse_client_handle_t FinesseClientHandle, char *PathToFree);
-*/
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
@@ -0,0 +1,157 @@
+/*
+ * (C) Copyright 2020 Tony Mason
+ * All Rights Reserved
+ */
+
+#include <fcinternal.h>
+
+//
+// The link comes back in the request's own message blocks, so a link longer than they hold
+// (most are far shorter than a block) is answered with ENOTSUP and the client reads it itself.
+//
+int FinesseSendReadlinkRequest(finesse_client_handle_t FinesseClientHandle, uuid_t *Parent, const char *Name,
+                               fincomm_message *Message)
+{
+    int                           status = 0;
+    client_connection_state_t *   ccs    = FinesseClientHandle;
+    fincomm_shared_memory_region *fsmr;
+    fincomm_message               message = NULL;
+    finesse_msg *                 fmsg    = NULL;
+    size_t                        nameLength;
+
+    assert(NULL != ccs);
+    fsmr = (fincomm_shared_memory_region *)ccs->server_shm;
+    assert(NULL != fsmr);
+    assert(NULL != Name);
+    nameLength = strlen(Name);
+
+    // A long name uses more than one message block
+    message = FinesseGetRequestBufferForLength(fsmr, FINESSE_FUSE_MESSAGE, FINESSE_FUSE_REQ_READLINK,
+                                               offsetof(finesse_msg, Message.Fuse.Request.Parameters.ReadLink.Name) +
+                                                   nameLength + 1);
+    if (NULL == message) {
+        return ENAMETOOLONG;
+    }
+    fmsg = (finesse_msg *)message->Data;
+
+    if (NULL == Parent) {
+        uuid_clear(fmsg->Message.Fuse.Request.Parameters.ReadLink.Parent);
+    }
+    else {
+        memcpy(&fmsg->Message.Fuse.Request.Parameters.ReadLink.Parent, Parent, sizeof(uuid_t));
+    }
+    memcpy(fmsg->Message.Fuse.Request.Parameters.ReadLink.Name, Name, nameLength + 1);
+
+    status = FinesseRequestReady(fsmr, message);
+    assert(0 != status);  // invalid request ID
+    *Message = message;
+    status   = 0;
+
+    return status;
+}
+
+//
+// Link is Length bytes (not null terminated); it is ignored unless Result is zero.
+//
+int FinesseSendReadlinkResponse(finesse_server_handle_t FinesseServerHandle, void *Client, fincomm_message Message,
+                                const char *Link, size_t Length, int Result)
+{
+    int                           status = 0;
+    fincomm_shared_memory_region *fsmr   = NULL;
+    finesse_msg *                 ffm;
+    unsigned                      index = (unsigned)(uintptr_t)Client;
+    size_t                        room;
+
+    fsmr = FcGetSharedMemoryRegion(FinesseServerHandle, index);
+    assert(NULL != fsmr);
+    assert(index < SHM_MESSAGE_COUNT);
+    assert(0 != Message);
+    assert(FINESSE_REQUEST == Message->MessageType);
+
+    room = FinesseGetRequestDataLength(FinesseServerHandle, Client, Message) -
+           offsetof(finesse_msg, Message.Fuse.Response.Parameters.ReadLink.Link);
+    if ((0 == Result) && (Length >= room)) {
+        Result = ENOTSUP;
+    }
+
+    Message->Result      = Result;
+    Message->MessageType = FINESSE_RESPONSE;
+
+    ffm                             = (finesse_msg *)Message->Data;
+    ffm->Version                    = FINESSE_MESSAGE_VERSION;
+    ffm->MessageClass               = FINESSE_FUSE_MESSAGE;
+    ffm->Result                     = Result;
+    ffm->Message.Fuse.Response.Type = FINESSE_FUSE_RSP_READLINK;
+
+    if (0 == Result) {
+        assert(NULL != Link);
+        memmove(ffm->Message.Fuse.Response.Parameters.ReadLink.Link, Link, Length);
+        ffm->Message.Fuse.Response.Parameters.ReadLink.Link[Length] = '\0';
+    }
+    else {
+        ffm->Message.Fuse.Response.Parameters.ReadLink.Link[0] = '\0';
+    }
+
+    FinesseResponseReady(fsmr, Message, 0);
+
+    return status;
+}
+
+//
+// As readlink(2): up to BufferSize bytes of the link are copied (without a terminating null)
+// and *Length is how many.
+//
+int FinesseGetReadlinkResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Message, char *Buffer,
+                               size_t BufferSize, ssize_t *Length, int *Result)
+{
+    int                           status = 0;
+    client_connection_state_t *   ccs    = FinesseClientHandle;
+    fincomm_shared_memory_region *fsmr   = NULL;
+    finesse_msg *                 fmsg   = NULL;
+    size_t                        length;
+
+    assert(NULL != ccs);
+    fsmr = (fincomm_shared_memory_region *)ccs->server_shm;
+    assert(NULL != fsmr);
+    assert(0 != Message);
+    assert(NULL != Length);
+    assert(NULL != Result);
+
+    // This is a blocking get
+    status = FinesseGetResponse(fsmr, Message, 1);
+    assert(0 != status);
+    status = 0;  // FinesseGetResponse is a boolean return function
+
+    assert(FINESSE_RESPONSE == Message->MessageType);
+    fmsg = (finesse_msg *)Message->Data;
+    assert(FINESSE_MESSAGE_VERSION == fmsg->Version);
+    assert(FINESSE_FUSE_MESSAGE == fmsg->MessageClass);
+
+    *Length = -1;
+    *Result = fmsg->Result;
+
+    if (FINESSE_FUSE_RSP_READLINK != fmsg->Message.Fuse.Response.Type) {
+        // e.g. a server that doesn't do readlink
+        assert(FINESSE_FUSE_RSP_ERR == fmsg->Message.Fuse.Response.Type);
+        if (0 == *Result) {
+            *Result = ENOTSUP;
+        }
+        return status;
+    }
+
+    if (0 == *Result) {
+        length = strlen(fmsg->Message.Fuse.Response.Parameters.ReadLink.Link);
+        if (length > BufferSize) {
+            length = BufferSize;
+        }
+        memcpy(Buffer, fmsg->Message.Fuse.Response.Parameters.ReadLink.Link, length);
+        *Length = (ssize_t)length;
+    }
+
+    return status;
+}
+
+void FinesseFreeReadlinkResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Response)
+{
+    FinesseFreeClientResponse(FinesseClientHandle, Response);
+}
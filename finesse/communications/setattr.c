@@ -0,0 +1,135 @@
+/*
+ * (C) Copyright 2020 Tony Mason
+ * All Rights Reserved
+ */
+
+#include <fcinternal.h>
+
+//
+// ToSet is the FUSE_SET_ATTR_* mask of the fields of Attr to change (chmod, chown, truncate and
+// utimensat are all this one request).  The response is the object's attributes afterwards.
+//
+int FinesseSendSetattrRequest(finesse_client_handle_t FinesseClientHandle, uuid_t *Parent, const char *Name,
+                              const struct stat *Attr, int ToSet, fincomm_message *Message)
+{
+    int                           status = 0;
+    client_connection_state_t *   ccs    = FinesseClientHandle;
+    fincomm_shared_memory_region *fsmr;
+    fincomm_message               message = NULL;
+    finesse_msg *                 fmsg    = NULL;
+    size_t                        nameLength;
+
+    assert(NULL != ccs);
+    fsmr = (fincomm_shared_memory_region *)ccs->server_shm;
+    assert(NULL != fsmr);
+    assert(NULL != Name);
+    assert(NULL != Attr);
+    nameLength = strlen(Name);
+
+    // A long name uses more than one message block
+    message = FinesseGetRequestBufferForLength(fsmr, FINESSE_FUSE_MESSAGE, FINESSE_FUSE_REQ_SETATTR,
+                                               offsetof(finesse_msg, Message.Fuse.Request.Parameters.SetAttr.Name) +
+                                                   nameLength + 1);
+    if (NULL == message) {
+        return ENAMETOOLONG;
+    }
+    fmsg = (finesse_msg *)message->Data;
+
+    if (NULL == Parent) {
+        uuid_clear(fmsg->Message.Fuse.Request.Parameters.SetAttr.Parent);
+    }
+    else {
+        memcpy(&fmsg->Message.Fuse.Request.Parameters.SetAttr.Parent, Parent, sizeof(uuid_t));
+    }
+    fmsg->Message.Fuse.Request.Parameters.SetAttr.Attr  = *Attr;
+    fmsg->Message.Fuse.Request.Parameters.SetAttr.ToSet = ToSet;
+    memcpy(fmsg->Message.Fuse.Request.Parameters.SetAttr.Name, Name, nameLength + 1);
+
+    status = FinesseRequestReady(fsmr, message);
+    assert(0 != status);  // invalid request ID
+    *Message = message;
+    status   = 0;
+
+    return status;
+}
+
+int FinesseSendSetattrResponse(finesse_server_handle_t FinesseServerHandle, void *Client, fincomm_message Message,
+                               const struct stat *Attr, double Timeout, int Result)
+{
+    int                           status = 0;
+    fincomm_shared_memory_region *fsmr   = NULL;
+    finesse_msg *                 ffm;
+    unsigned                      index = (unsigned)(uintptr_t)Client;
+
+    fsmr = FcGetSharedMemoryRegion(FinesseServerHandle, index);
+    assert(NULL != fsmr);
+    assert(index < SHM_MESSAGE_COUNT);
+    assert(0 != Message);
+    assert(FINESSE_REQUEST == Message->MessageType);
+
+    Message->Result      = Result;
+    Message->MessageType = FINESSE_RESPONSE;
+
+    ffm                             = (finesse_msg *)Message->Data;
+    ffm->Version                    = FINESSE_MESSAGE_VERSION;
+    ffm->MessageClass               = FINESSE_FUSE_MESSAGE;
+    ffm->Result                     = Result;
+    ffm->Message.Fuse.Response.Type = FINESSE_FUSE_RSP_ATTR;
+    if (NULL == Attr) {
+        memset(&ffm->Message.Fuse.Response.Parameters.Attr.Attr, 0, sizeof(struct stat));
+    }
+    else {
+        ffm->Message.Fuse.Response.Parameters.Attr.Attr = *Attr;
+    }
+    ffm->Message.Fuse.Response.Parameters.Attr.AttrTimeout = Timeout;
+
+    FinesseResponseReady(fsmr, Message, 0);
+
+    return status;
+}
+
+int FinesseGetSetattrResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Message, struct stat *Attr, int *Result)
+{
+    int                           status = 0;
+    client_connection_state_t *   ccs    = FinesseClientHandle;
+    fincomm_shared_memory_region *fsmr   = NULL;
+    finesse_msg *                 fmsg   = NULL;
+
+    assert(NULL != ccs);
+    fsmr = (fincomm_shared_memory_region *)ccs->server_shm;
+    assert(NULL != fsmr);
+    assert(0 != Message);
+    assert(NULL != Result);
+
+    // This is a blocking get
+    status = FinesseGetResponse(fsmr, Message, 1);
+    assert(0 != status);
+    status = 0;  // FinesseGetResponse is a boolean return function
+
+    assert(FINESSE_RESPONSE == Message->MessageType);
+    fmsg = (finesse_msg *)Message->Data;
+    assert(FINESSE_MESSAGE_VERSION == fmsg->Version);
+    assert(FINESSE_FUSE_MESSAGE == fmsg->MessageClass);
+
+    *Result = fmsg->Result;
+
+    if (FINESSE_FUSE_RSP_ATTR != fmsg->Message.Fuse.Response.Type) {
+        // e.g. a server that doesn't do setattr
+        assert(FINESSE_FUSE_RSP_ERR == fmsg->Message.Fuse.Response.Type);
+        if (0 == *Result) {
+            *Result = ENOTSUP;
+        }
+        return status;
+    }
+
+    if ((0 == *Result) && (NULL != Attr)) {
+        *Attr = fmsg->Message.Fuse.Response.Parameters.Attr.Attr;
+    }
+
+    return status;
+}
+
+void FinesseFreeSetattrResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Response)
+{
+    FinesseFreeClientResponse(FinesseClientHandle, Response);
+}
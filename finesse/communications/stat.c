@@ -14,13 +14,22 @@ int FinesseSendCommonStatRequest(finesse_client_handle_t FinesseClientHandle, uu
     fincomm_shared_memory_region *fsmr;
     fincomm_message               message = NULL;
     finesse_msg *                 fmsg    = NULL;
-    size_t                        nameLength, bufSize;
+    size_t                        nameLength = 0;
 
     assert(NULL != ccs);
     fsmr = (fincomm_shared_memory_region *)ccs->server_shm;
     assert(NULL != fsmr);
-    message = FinesseGetRequestBuffer(fsmr, FINESSE_FUSE_MESSAGE, FINESSE_FUSE_REQ_STAT);
-    assert(NULL != message);
+    assert((NULL != Path) || (NULL != Inode));  // we either need a path (stat) or an inode (fstat)
+    if (NULL != Path) {
+        nameLength = strlen(Path);
+    }
+
+    // A long name uses more than one message block
+    message = FinesseGetRequestBufferForLength(fsmr, FINESSE_FUSE_MESSAGE, FINESSE_FUSE_REQ_STAT,
+                                               offsetof(finesse_msg, Message.Fuse.Request.Parameters.Stat.Name) + nameLength + 1);
+    if (NULL == message) {
+        return ENAMETOOLONG;
+    }
 
     fmsg = (finesse_msg *)message->Data;
 
@@ -38,13 +47,8 @@ int FinesseSendCommonStatRequest(finesse_client_handle_t FinesseClientHandle, uu
     }
     fmsg->Message.Fuse.Request.Parameters.Stat.Flags = Flags;
 
-    assert((NULL != Path) || (NULL != Inode));  // we either need a path (stat) or an inode (fstat)
-
     fmsg->Message.Fuse.Request.Parameters.Stat.Name[0] = '\0';  // ensure it's null terminated
     if (NULL != Path) {
-        nameLength = strlen(Path);
-        bufSize    = SHM_PAGE_SIZE - offsetof(finesse_msg, Message.Fuse.Request.Parameters.Stat.Name);
-        assert(nameLength < bufSize);
         memcpy(fmsg->Message.Fuse.Request.Parameters.Stat.Name, Path, nameLength + 1);
     }
 
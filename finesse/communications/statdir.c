@@ -0,0 +1,211 @@
+/*
+ * (C) Copyright 2020 Tony Mason
+ * All Rights Reserved
+*/
+
+#include <fcinternal.h>
+
+//
+// Path is the (absolute) directory; Pattern (which may be NULL) limits the entries returned
+// to those whose names match it.  Returns ENAMETOOLONG (and sends nothing) if the two don't
+// fit in the largest request.
+//
+int FinesseSendStatDirRequest(finesse_client_handle_t FinesseClientHandle, const char *Path, const char *Pattern, uint64_t Offset,
+                              fincomm_message *Message)
+{
+    int                           status = 0;
+    client_connection_state_t *   ccs    = FinesseClientHandle;
+    fincomm_shared_memory_region *fsmr;
+    fincomm_message               message = NULL;
+    finesse_msg *                 fmsg    = NULL;
+    size_t                        pathLength, patternLength;
+
+    assert(NULL != ccs);
+    assert(NULL != Path);
+
+    if (NULL == Pattern) {
+        Pattern = "";
+    }
+
+    pathLength    = strlen(Path) + 1;
+    patternLength = strlen(Pattern) + 1;
+
+    fsmr = (fincomm_shared_memory_region *)ccs->server_shm;
+    assert(NULL != fsmr);
+    message = FinesseGetRequestBufferForLength(fsmr, FINESSE_NATIVE_MESSAGE, FINESSE_NATIVE_REQ_STATDIR,
+                                               offsetof(finesse_msg, Message.Native.Request.Parameters.StatDir.Data) + pathLength +
+                                                   patternLength);
+    if (NULL == message) {
+        return ENAMETOOLONG;
+    }
+    fmsg = (finesse_msg *)message->Data;
+
+    fmsg->Message.Native.Request.Parameters.StatDir.Offset = Offset;
+    memcpy(fmsg->Message.Native.Request.Parameters.StatDir.Data, Path, pathLength);
+    memcpy(fmsg->Message.Native.Request.Parameters.StatDir.Data + pathLength, Pattern, patternLength);
+
+    status = FinesseRequestReady(fsmr, message);
+    assert(0 != status);  // invalid request ID
+    *Message = message;
+    status   = 0;
+
+    return status;
+}
+
+//
+// The server builds the entries in the message's aux buffer; FinesseSendStatDirResponse then
+// moves them into the message itself if they fit.
+//
+void *FinesseGetStatDirResponseBuffer(finesse_server_handle_t FinesseServerHandle, void *Client, fincomm_message Message,
+                                      size_t *BufferSize)
+{
+    void *buffer = NULL;
+    int   status;
+
+    status = FinesseGetMessageAuxBuffer(FinesseServerHandle, Client, Message, &buffer, BufferSize);
+    assert(0 == status);
+    assert(NULL != buffer);
+
+    return buffer;
+}
+
+//
+// Entries is the buffer from FinesseGetStatDirResponseBuffer, or NULL if the server never
+// asked for one (in which case there can be no entries).
+//
+int FinesseSendStatDirResponse(finesse_server_handle_t FinesseServerHandle, void *Client, fincomm_message Message,
+                               const void *Entries, uint32_t EntryCount, size_t Length, uint64_t NextOffset, int Complete,
+                               int Result)
+{
+    int                           status = 0;
+    fincomm_shared_memory_region *fsmr   = NULL;
+    finesse_msg *                 ffm;
+    unsigned                      index    = (unsigned)(uintptr_t)Client;
+    const char *                  shm_name = NULL;
+
+    fsmr = FcGetSharedMemoryRegion(FinesseServerHandle, index);
+    assert(NULL != fsmr);
+    assert(index < SHM_MESSAGE_COUNT);
+    assert(0 != Message);
+    assert(FINESSE_REQUEST == Message->MessageType);
+    assert((NULL != Entries) || ((0 == Length) && (0 == EntryCount)));
+
+    Message->Result      = Result;
+    Message->MessageType = FINESSE_RESPONSE;
+
+    ffm                                                        = (finesse_msg *)Message->Data;
+    ffm->Version                                               = FINESSE_MESSAGE_VERSION;
+    ffm->MessageClass                                          = FINESSE_NATIVE_MESSAGE;
+    ffm->Message.Native.Response.NativeResponseType            = FINESSE_NATIVE_RSP_STATDIR;
+    ffm->Message.Native.Response.Parameters.StatDir.NextOffset = NextOffset;
+    ffm->Message.Native.Response.Parameters.StatDir.EntryCount = EntryCount;
+    ffm->Message.Native.Response.Parameters.StatDir.Length     = (uint32_t)Length;
+    ffm->Message.Native.Response.Parameters.StatDir.Complete   = Complete ? 1 : 0;
+    ffm->Message.Native.Response.Parameters.StatDir.Inline     = 1;
+
+    if (Length <= FINESSE_STATDIR_MAX_INLINE) {
+        if (Length > 0) {
+            memcpy(ffm->Message.Native.Response.Parameters.StatDir.Data, Entries, Length);
+        }
+    }
+    else {
+        shm_name = FinesseGetMessageAuxBufferName(FinesseServerHandle, Client, Message);
+        assert(NULL != shm_name);
+        assert(strlen(shm_name) < FINESSE_STATDIR_MAX_INLINE);
+        ffm->Message.Native.Response.Parameters.StatDir.Inline = 0;
+        strcpy(ffm->Message.Native.Response.Parameters.StatDir.Data, shm_name);
+    }
+
+    if (NULL != Entries) {
+        // The contents stay put until this message slot is used again, after the client frees it
+        FinesseReleaseMessageAuxBuffer(FinesseServerHandle, Client, Message);
+    }
+
+    FinesseResponseReady(fsmr, Message, 0);
+
+    return status;
+}
+
+//
+// *Entries points to Length bytes of finesse_statdir_entry_t records, either in the message or
+// in a mapping of the server's buffer; either way it is good until FinesseFreeStatDirResponse.
+//
+int FinesseGetStatDirResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Message, const void **Entries,
+                              size_t *Length, uint32_t *EntryCount, uint64_t *NextOffset, int *Complete, int *Result)
+{
+    int                           status = 0;
+    client_connection_state_t *   ccs    = FinesseClientHandle;
+    fincomm_shared_memory_region *fsmr   = NULL;
+    finesse_msg *                 fmsg   = NULL;
+    void *                        buffer = NULL;
+
+    assert(NULL != ccs);
+    fsmr = (fincomm_shared_memory_region *)ccs->server_shm;
+    assert(NULL != fsmr);
+    assert(NULL != Message);
+    assert(NULL != Entries);
+    assert(NULL != Length);
+    assert(NULL != Result);
+
+    // This is a blocking get
+    status = FinesseGetResponse(fsmr, Message, 1);
+    assert(0 != status);
+    status = 0;  // FinesseGetResponse is a boolean return function
+
+    assert(FINESSE_RESPONSE == Message->MessageType);
+    fmsg = (finesse_msg *)Message->Data;
+    assert(FINESSE_MESSAGE_VERSION == fmsg->Version);
+    assert(FINESSE_NATIVE_MESSAGE == fmsg->MessageClass);
+
+    *Entries    = NULL;
+    *Length     = 0;
+    *EntryCount = 0;
+    *NextOffset = 0;
+    *Complete   = 0;
+    *Result     = Message->Result;
+
+    if (FINESSE_NATIVE_RSP_STATDIR != fmsg->Message.Native.Response.NativeResponseType) {
+        // e.g. a server that doesn't know this request
+        if (0 == *Result) {
+            *Result = ENOTSUP;
+        }
+        return status;
+    }
+
+    if (0 != *Result) {
+        return status;
+    }
+
+    *Length     = fmsg->Message.Native.Response.Parameters.StatDir.Length;
+    *EntryCount = fmsg->Message.Native.Response.Parameters.StatDir.EntryCount;
+    *NextOffset = fmsg->Message.Native.Response.Parameters.StatDir.NextOffset;
+    *Complete   = fmsg->Message.Native.Response.Parameters.StatDir.Complete;
+
+    if (fmsg->Message.Native.Response.Parameters.StatDir.Inline) {
+        *Entries = fmsg->Message.Native.Response.Parameters.StatDir.Data;
+        return status;
+    }
+
+    buffer = FinesseMapMessageAuxBuffer(fmsg->Message.Native.Response.Parameters.StatDir.Data, *Length);
+    if (NULL == buffer) {
+        *Length     = 0;
+        *EntryCount = 0;
+        *Result     = errno;
+        return status;
+    }
+
+    *Entries = buffer;
+    return status;
+}
+
+void FinesseFreeStatDirResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Response, const void *Entries,
+                                size_t Length)
+{
+    finesse_msg *fmsg = (finesse_msg *)Response->Data;
+
+    if ((NULL != Entries) && (Entries != fmsg->Message.Native.Response.Parameters.StatDir.Data)) {
+        FinesseUnmapMessageAuxBuffer((void *)(uintptr_t)Entries, Length);
+    }
+
+    FinesseFreeClientResponse(FinesseClientHandle, Response);
+}
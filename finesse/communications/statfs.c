@@ -13,21 +13,25 @@ int FinesseSendStatfsRequest(finesse_client_handle_t FinesseClientHandle, const
     fincomm_shared_memory_region *fsmr;
     fincomm_message               message = NULL;
     finesse_msg *                 fmsg    = NULL;
-    size_t                        nameLength, bufSize;
+    size_t                        nameLength;
 
     assert(NULL != ccs);
     fsmr = (fincomm_shared_memory_region *)ccs->server_shm;
     assert(NULL != fsmr);
-    message = FinesseGetRequestBuffer(fsmr, FINESSE_FUSE_MESSAGE, FINESSE_FUSE_REQ_STATFS);
-    assert(NULL != message);
+    assert(NULL != path);
+    nameLength = strlen(path);
+
+    // A long name uses more than one message block
+    message = FinesseGetRequestBufferForLength(
+        fsmr, FINESSE_FUSE_MESSAGE, FINESSE_FUSE_REQ_STATFS,
+        offsetof(finesse_msg, Message.Fuse.Request.Parameters.Statfs.Options.Name) + nameLength + 1);
+    if (NULL == message) {
+        return ENAMETOOLONG;
+    }
     fmsg = (finesse_msg *)message->Data;
 
     fmsg->Message.Fuse.Request.Parameters.Statfs.StatFsType = STATFS;
 
-    assert(NULL != path);
-    nameLength = strlen(path);
-    bufSize    = SHM_PAGE_SIZE - offsetof(finesse_msg, Message.Fuse.Request.Parameters.Statfs.Options.Name);
-    assert(nameLength < bufSize);
     memcpy(fmsg->Message.Fuse.Request.Parameters.Statfs.Options.Name, path, nameLength + 1);
 
     status = FinesseRequestReady(fsmr, message);
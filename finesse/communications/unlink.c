@@ -14,21 +14,24 @@ int FinesseSendUnlinkRequest(finesse_client_handle_t FinesseClientHandle, uuid_t
     fincomm_shared_memory_region *fsmr;
     fincomm_message               message = NULL;
     finesse_msg *                 fmsg    = NULL;
-    size_t                        nameLength, bufSize;
+    size_t                        nameLength;
 
     assert(NULL != ccs);
     fsmr = (fincomm_shared_memory_region *)ccs->server_shm;
     assert(NULL != fsmr);
-    message = FinesseGetRequestBuffer(fsmr, FINESSE_FUSE_MESSAGE, FINESSE_FUSE_REQ_UNLINK);
-    assert(NULL != message);
+    assert(NULL != NameToUnlink);
+    nameLength = strlen(NameToUnlink);
+
+    // A long name uses more than one message block
+    message = FinesseGetRequestBufferForLength(fsmr, FINESSE_FUSE_MESSAGE, FINESSE_FUSE_REQ_UNLINK,
+                                               offsetof(finesse_msg, Message.Fuse.Request.Parameters.Unlink.Name) + nameLength + 1);
+    if (NULL == message) {
+        return ENAMETOOLONG;
+    }
 
     fmsg = (finesse_msg *)message->Data;
     memcpy(&fmsg->Message.Fuse.Request.Parameters.Unlink.Parent, Parent, sizeof(uuid_t));  // at least for now, we only support
-    assert(NULL != NameToUnlink);
 
-    nameLength = strlen(NameToUnlink);
-    bufSize    = SHM_PAGE_SIZE - offsetof(finesse_msg, Message.Fuse.Request.Parameters.Unlink.Name);
-    assert(nameLength < bufSize);
     memcpy(fmsg->Message.Fuse.Request.Parameters.Unlink.Name, NameToUnlink, nameLength + 1);
 
     status = FinesseRequestReady(fsmr, message);
@@ -0,0 +1,59 @@
+//
+// (C) Copyright 2020 Tony Mason
+// All Rights Reserved
+//
+
+#if !defined(__FINESSE_CALLSHARD_H__)
+#define __FINESSE_CALLSHARD_H__ (1)
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
+//
+// Sharded call statistics
+//
+// Each thread that records a call gets its own shard of counters, so the hot
+// path never writes a cache line that another thread writes.  Readers walk the
+// list of shards and sum them.  Shards are never freed; when a thread exits
+// its shard is marked orphaned and handed to the next new thread, so the
+// totals are preserved and the number of shards is bounded by the peak number
+// of concurrent threads.
+//
+// Latencies are recorded in a log-linear (HDR style) histogram: values below
+// 2^FINESSE_CALLSHARD_SUB_BUCKET_BITS nanoseconds are exact, larger values
+// land in one of 2^FINESSE_CALLSHARD_SUB_BUCKET_BITS buckets per power of two
+// (so the reported percentile is within 12.5% of the true value).
+//
+#define FINESSE_CALLSHARD_SUB_BUCKET_BITS (3)
+#define FINESSE_CALLSHARD_SUB_BUCKETS (1 << FINESSE_CALLSHARD_SUB_BUCKET_BITS)
+#define FINESSE_CALLSHARD_MAX_EXPONENT (36)  // ~68 seconds; anything larger goes in the last bucket
+#define FINESSE_CALLSHARD_BUCKETS \
+    (FINESSE_CALLSHARD_SUB_BUCKETS * (FINESSE_CALLSHARD_MAX_EXPONENT - FINESSE_CALLSHARD_SUB_BUCKET_BITS + 2))
+
+typedef struct _finesse_callshard finesse_callshard_t;
+
+typedef struct _finesse_callshard_set {
+    unsigned             CallCount;
+    unsigned             TimerCount;  // number of independent latencies recorded per call
+    pthread_once_t       Once;
+    pthread_key_t        Key;
+    finesse_callshard_t *Shards;  // lock free list of all shards ever created
+} finesse_callshard_set_t;
+
+#define FINESSE_CALLSHARD_SET_INITIALIZER(calls, timers) \
+    {                                                    \
+        .CallCount = (calls), .TimerCount = (timers), .Once = PTHREAD_ONCE_INIT, .Shards = NULL, \
+    }
+
+void FinesseCallShardCount(finesse_callshard_set_t *Set, unsigned Call, int Success);
+void FinesseCallShardRecord(finesse_callshard_set_t *Set, unsigned Call, unsigned Timer, const struct timespec *Elapsed);
+
+// Aggregation (safe to call while other threads are recording)
+void     FinesseCallShardSum(finesse_callshard_set_t *Set, unsigned Call, uint64_t *Calls, uint64_t *Success, uint64_t *Failure);
+uint64_t FinesseCallShardElapsed(finesse_callshard_set_t *Set, unsigned Call, unsigned Timer);
+void     FinesseCallShardHistogram(finesse_callshard_set_t *Set, unsigned Call, unsigned Timer,
+                                   uint64_t Histogram[FINESSE_CALLSHARD_BUCKETS]);
+uint64_t FinesseCallShardPercentile(const uint64_t Histogram[FINESSE_CALLSHARD_BUCKETS], double Percentile);
+
+#endif  // __FINESSE_CALLSHARD_H__
@@ -40,6 +40,7 @@
     (128)  // secondary shared memory regions must fit within a buffer of this size (including a null terminator)
 #define SHM_MESSAGE_COUNT (64)  // this is the maximum number of parallel/simultaneous messages per client.
 #define SHM_PAGE_SIZE (4096)    // this should be the page size of the underlying machine.
+#define FINESSE_MAX_MESSAGE_SLOTS (16)  // the most (contiguous) message blocks a single request can use.
 
 //
 // The registration structure is how the client connects to the server
@@ -88,6 +89,46 @@ typedef fincomm_message_block *fincomm_message;
 _Static_assert(0 == sizeof(fincomm_message_block) % OPTIMAL_ALIGNMENT_SIZE, "Alignment wrong");
 _Static_assert(SHM_PAGE_SIZE == sizeof(fincomm_message_block), "Alignment wrong");
 
+//
+// A request that doesn't fit in one message block (e.g., a long path name) uses several adjacent
+// ones; its Data simply continues into the blocks that follow.  Only the first block is signaled,
+// answered and freed.
+//
+#define FINESSE_MAX_MESSAGE_DATA_LENGTH ((FINESSE_MAX_MESSAGE_SLOTS * SHM_PAGE_SIZE) - offsetof(fincomm_message_block, Data))
+_Static_assert(FINESSE_MAX_MESSAGE_SLOTS <= SHM_MESSAGE_COUNT, "Too many message slots");
+
+//
+// Invalidations: the server's only unsolicited traffic.  When the server sees an object change
+// (a setattr, write, unlink, rename, ... completing, or the file system calling one of the
+// fuse_lowlevel_notify_* functions) it posts an event to a small ring in the header of each
+// client's region; a client that caches anything it got from the server reads the ring and drops
+// what the events name.  The ring is lossy: a client that falls more than a ring's worth behind
+// is told so (FinesseReadInvalidations returns EOVERFLOW) and must drop everything it has.
+//
+typedef enum {
+    FINESSE_INVALIDATE_INODE = 1,  // Inode's attributes (and data) changed
+    FINESSE_INVALIDATE_ENTRY,      // the name in Parent changed (it may now exist, or not)
+    FINESSE_INVALIDATE_DELETE,     // the name in Parent (Inode, if known) was removed
+} FINESSE_INVALIDATION_TYPE;
+
+#define FINESSE_INVALIDATION_NAME_LENGTH (32)
+
+typedef struct {
+    u_int64_t Sequence;    // 1 + the event's position in the stream (0 while it is being written)
+    u_int32_t Type;        // FINESSE_INVALIDATION_TYPE
+    u_int16_t NameLength;  // the name's real length; if it exceeds the Name field, treat the event as naming every entry of Parent
+    u_int16_t Reserved;
+    u_int64_t Inode;
+    u_int64_t Parent;
+    uuid_t    Key;        // the server's key for Inode (null if it has none)
+    uuid_t    ParentKey;  // and for Parent
+    char      Name[FINESSE_INVALIDATION_NAME_LENGTH];  // not null terminated if it fills the field
+} finesse_invalidation_t;
+
+_Static_assert(96 == sizeof(finesse_invalidation_t), "finesse_invalidation_t not packed properly");
+
+#define FINESSE_INVALIDATION_RING_SIZE (32)
+
 //
 // The shared memory region has a header, followed by (page aligned)
 // message blocks
@@ -110,8 +151,13 @@ typedef struct {
     u_int64_t       AllocationBitmap;
     u_int64_t       RequestId;
     u_int64_t       ShutdownRequested;
-    u_int8_t        align2[64 - (4 * sizeof(u_int64_t))];
-    u_int8_t        UnusedRegion[4096 - (6 * 64)];
+    u_int64_t       ServerBitmap;  // messages the server has taken but not yet answered
+    u_int8_t        align2[64 - (5 * sizeof(u_int64_t))];
+    u_int8_t        MessageSlots[SHM_MESSAGE_COUNT];  // slots used by the message starting at each slot (0 = 1)
+    u_int64_t       InvalidationHead;                 // events ever posted
+    u_int8_t        align3[64 - sizeof(u_int64_t)];
+    finesse_invalidation_t Invalidations[FINESSE_INVALIDATION_RING_SIZE];
+    u_int8_t        UnusedRegion[4096 - (8 * 64) - (FINESSE_INVALIDATION_RING_SIZE * sizeof(finesse_invalidation_t))];
     fincomm_message_block Messages[SHM_MESSAGE_COUNT];
 } fincomm_shared_memory_region;
 
@@ -123,6 +169,9 @@ extern const char FinesseSharedMemoryRegionSignature[8];
 _Static_assert(0 == sizeof(fincomm_shared_memory_region) % OPTIMAL_ALIGNMENT_SIZE, "Alignment wrong");
 _Static_assert(0 == offsetof(fincomm_shared_memory_region, ResponseBitmap) % OPTIMAL_ALIGNMENT_SIZE, "Alignment wrong");
 _Static_assert(0 == offsetof(fincomm_shared_memory_region, LastBufferAllocated) % OPTIMAL_ALIGNMENT_SIZE, "Alignment wrong");
+_Static_assert(0 == offsetof(fincomm_shared_memory_region, MessageSlots) % OPTIMAL_ALIGNMENT_SIZE, "Alignment wrong");
+_Static_assert(0 == offsetof(fincomm_shared_memory_region, InvalidationHead) % OPTIMAL_ALIGNMENT_SIZE, "Alignment wrong");
+_Static_assert(0 == offsetof(fincomm_shared_memory_region, Invalidations) % OPTIMAL_ALIGNMENT_SIZE, "Alignment wrong");
 _Static_assert(0 == offsetof(fincomm_shared_memory_region, UnusedRegion) % OPTIMAL_ALIGNMENT_SIZE, "Alignment wrong");
 _Static_assert(0 == offsetof(fincomm_shared_memory_region, Messages) % SHM_PAGE_SIZE, "Alignment wrong");
 _Static_assert(0 == sizeof(fincomm_shared_memory_region) % SHM_PAGE_SIZE, "Length Wrong");
@@ -158,6 +207,9 @@ typedef struct server_connection_state {
     void *                    client_shm;
     pthread_t                 monitor_thread;
     uint8_t                   monitor_thread_active;
+    uint8_t                   client_gone;  // set by the monitor thread once the client has shut down or died
+    uint8_t                   reaped;       // set by the thread that tears the connection down
+    uint32_t                  requests_in_progress;  // server threads looking for a request from this client
     struct {
         uuid_t  AuxShmKey;                      // use UUIDs for the shared memory region
         int     AuxShmFd;                       // Open instance
@@ -254,6 +306,9 @@ typedef enum {
     FINESSE_NATIVE_REQ_MAP_RELEASE,
     FINESSE_NATIVE_REQ_DIRMAP,
     FINESSE_NATIVE_REQ_DIRMAPRELEASE,
+    FINESSE_NATIVE_REQ_PATH_SEARCH,
+    FINESSE_NATIVE_REQ_COMPOUND,
+    FINESSE_NATIVE_REQ_STATDIR,
     FINESSE_NATIVE_REQ_MAX,
 } FINESSE_NATIVE_REQ_TYPE;
 
@@ -265,6 +320,9 @@ typedef enum {
     FINESSE_NATIVE_RSP_MAP_RELEASE,
     FINESSE_NATIVE_RSP_DIRMAP,
     FINESSE_NATIVE_RSP_DIRMAPRELEASE,
+    FINESSE_NATIVE_RSP_PATH_SEARCH,
+    FINESSE_NATIVE_RSP_COMPOUND,
+    FINESSE_NATIVE_RSP_STATDIR,
     FINESSE_NATIVE_RSP_MAX
 } FINESSE_NATIVE_RSP_TYPE;
 
@@ -322,13 +380,15 @@ typedef struct {
         } GetAttr;
 
         struct {
-            uuid_t      Inode;
+            uuid_t      Parent;  // null: Name is absolute
             struct stat Attr;
-            int         ToSet;
+            int         ToSet;   // FUSE_SET_ATTR_*
+            char        Name[1];
         } SetAttr;
 
         struct {
-            uuid_t Inode;
+            uuid_t Parent;
+            char   Name[1];
         } ReadLink;
 
         struct {
@@ -355,8 +415,8 @@ typedef struct {
         } Rmdir;
 
         struct {
-            uuid_t Symlink;
-            // Pair of null terminated strings
+            uuid_t Parent;
+            // Pair of null terminated strings: what the link points to, and its name
             char LinkAndName[1];
         } Symlink;
 
@@ -369,9 +429,10 @@ typedef struct {
         } Rename;
 
         struct {
-            uuid_t Inode;
+            uuid_t Parent;
             uuid_t NewParent;
-            char   NewName[1];
+            // Pair of null terminated strings
+            char OldAndNewName[1];
         } Link;
 
         struct {
@@ -475,13 +536,14 @@ typedef struct {
 
         struct {
             uuid_t ParentInode;
-            char   Name[1];
             int    Mask;
+            char   Name[1];
         } Access;
 
         struct {
             uuid_t      Parent;
-            struct stat Attr;
+            struct stat Attr;   // st_mode
+            int         Flags;  // O_EXCL (the file is created, not opened)
             char        Name[1];
         } Create;
 
@@ -658,6 +720,60 @@ typedef struct {
     } Parameters;
 } finesse_fuse_response;
 
+//
+// Compound requests: a short program of operations run by the server in a single dispatch
+// (in the spirit of NFSv4 COMPOUND).  The operations share a "current object" (a map key)
+// and a "current open": MAP sets the former (an op with a non-null Key uses that key
+// instead), OPEN sets the latter, and each later op works on them.  The first operation
+// that fails ends the compound, and anything the compound opened or mapped (and did not
+// hand back) is released - so open+getattr+read+close of a small file costs one message.
+//
+typedef enum {
+    FINESSE_COMPOUND_OP_MAP = 1,      // map the name at NameOffset (absolute, or relative to Key); it becomes current
+    FINESSE_COMPOUND_OP_GETATTR,      // attributes of the current object
+    FINESSE_COMPOUND_OP_OPEN,         // open the current object with Flags
+    FINESSE_COMPOUND_OP_READ,         // read Length bytes (0: as many as fit) at Offset from the current open
+    FINESSE_COMPOUND_OP_CLOSE,        // release the current open
+    FINESSE_COMPOUND_OP_MAP_RELEASE,  // release the current object
+} FINESSE_COMPOUND_OP;
+
+#define FINESSE_COMPOUND_MAX_OPS (8)
+
+typedef struct {
+    uint16_t Op;          // FINESSE_COMPOUND_OP_*
+    uint16_t NameOffset;  // MAP: offset of the (null-terminated) name in the request Data
+    uint32_t Flags;       // MAP, OPEN: open flags
+    uint64_t Offset;      // READ
+    uint32_t Length;      // READ
+    uuid_t   Key;         // null: the current object
+} finesse_compound_op_t;
+
+typedef struct {
+    uint16_t Op;
+    int32_t  Status;      // 0 or an errno value
+    uint32_t DataOffset;  // READ: where the data is in the response Data
+    uint32_t Length;      // READ: how much of it there is
+} finesse_compound_result_t;
+
+//
+// Directory stat ("statdir"): the name and attributes (as lstat would report them) of every
+// entry of a directory, or of those whose names match an fnmatch(3) pattern (a leading '.'
+// must be matched explicitly, as in the shell), in one response.  "." and ".." are never
+// returned.  Entries that don't fit in the message go in the message's aux buffer (the
+// response then carries its name); a directory too big for that too is returned in pieces,
+// each request asking for more from the last response's NextOffset.
+//
+typedef struct {
+    uint16_t    RecordLength;  // from this entry to the next (a multiple of 8)
+    uint16_t    NameLength;    // not counting the terminating null
+    uint32_t    Reserved;
+    struct stat Attr;
+    char        Name[1];
+} finesse_statdir_entry_t;
+
+#define FINESSE_STATDIR_ENTRY_SIZE(NameLength) \
+    ((offsetof(finesse_statdir_entry_t, Name) + (NameLength) + 1 + 7) & ~(size_t)7)
+
 typedef struct {
     FINESSE_NATIVE_REQ_TYPE NativeRequestType;
 
@@ -706,9 +822,48 @@ typedef struct {
             uint16_t Length;
             char     StatData[1];  // blob of data - could be structured...
         } ServerStat;
+
+        struct {
+            uint32_t Flags;      // FINESSE_PATH_SEARCH_*
+            uint16_t FileCount;  // number of candidate names
+            uint16_t PathCount;  // number of directories to search
+            char     Data[1];    // FileCount null-terminated names, then PathCount null-terminated directories
+        } PathSearch;
+
+        struct {
+            uint16_t              OpCount;
+            finesse_compound_op_t Ops[FINESSE_COMPOUND_MAX_OPS];
+            char                  Data[1];  // names used by MAP operations
+        } Compound;
+
+        struct {
+            uint64_t Offset;   // 0 for the start of the directory, otherwise a NextOffset
+            char     Data[1];  // null-terminated (absolute) directory, then null-terminated pattern ("" for all)
+        } StatDir;
     } Parameters;
 } finesse_native_request;
 
+//
+// Path search: each directory is searched in order, and within a directory each
+// candidate name is tried in order (the order a compiler walks its include path
+// or the loader walks LD_LIBRARY_PATH).  A directory is never a match.
+//
+// The server follows symlinks, in the directories and in the names, as long as they
+// stay within the mount.  A match whose mode is a symlink is one whose link leaves the
+// mount; it has not been resolved and must be checked by the client, as must every
+// name in a directory the server could not walk (FileIndex is
+// FINESSE_PATH_SEARCH_UNRESOLVED).  Unless FINESSE_PATH_SEARCH_ALL is set the server
+// stops at the first resolved match.
+//
+#define FINESSE_PATH_SEARCH_ALL (0x1)
+#define FINESSE_PATH_SEARCH_UNRESOLVED (0xFFFF)
+
+typedef struct {
+    uint16_t FileIndex;
+    uint16_t PathIndex;
+    uint32_t Mode;
+} finesse_path_search_match_t;
+
 typedef struct {
     FINESSE_NATIVE_RSP_TYPE NativeResponseType;
     union {
@@ -737,9 +892,47 @@ typedef struct {
             unsigned char Response[64];
         } Test;
 
+        struct {
+            uint16_t                    MatchCount;
+            finesse_path_search_match_t Matches[1];  // in search order
+        } PathSearch;
+
+        struct {
+            uint16_t                  OpCount;  // operations run (the last failed if the message Result is non-zero)
+            uuid_t                    Key;      // the current object, if the compound left one mapped
+            struct stat               Attr;     // from the last GETATTR
+            finesse_compound_result_t Results[FINESSE_COMPOUND_MAX_OPS];
+            uint32_t                  DataLength;
+            char                      Data[1];  // READ data
+        } Compound;
+
+        struct {
+            uint64_t NextOffset;  // where to continue from, unless Complete
+            uint32_t EntryCount;
+            uint32_t Length;      // of the entries
+            uint8_t  Complete;    // no more entries
+            uint8_t  Inline;      // the entries are in Data; otherwise Data is the name of the aux buffer holding them
+            char     Data[1];
+        } StatDir;
     } Parameters;
 } finesse_native_response;
 
+// The most matches a single path search response can carry
+#define FINESSE_PATH_SEARCH_MAX_MATCHES                                                     \
+    ((SHM_PAGE_SIZE - offsetof(fincomm_message_block, Data) -                                \
+      offsetof(finesse_msg, Message.Native.Response.Parameters.PathSearch.Matches)) /        \
+     sizeof(finesse_path_search_match_t))
+
+// The most data (across all READ operations) a single compound response can carry
+#define FINESSE_COMPOUND_MAX_DATA                                                          \
+    (SHM_PAGE_SIZE - offsetof(fincomm_message_block, Data) -                               \
+     offsetof(finesse_msg, Message.Native.Response.Parameters.Compound.Data))
+
+// The most entry data a statdir response carries in the message itself
+#define FINESSE_STATDIR_MAX_INLINE                                                         \
+    (SHM_PAGE_SIZE - offsetof(fincomm_message_block, Data) -                               \
+     offsetof(finesse_msg, Message.Native.Response.Parameters.StatDir.Data))
+
 // Each shared memory block indicates if the block is being used for
 // a request or a response.  Each block then contains a message
 // (the structure following this block).  That indicates what class
@@ -795,7 +988,7 @@ _Static_assert(sizeof(finesse_msg) <= (sizeof(fincomm_message_block) - offsetof(
 
 //
 // This is the shared memory protocol:
-//   (1) client allocates a request region (FinesseGetRequestBuffer)
+//   (1) client allocates a request region (FinesseGetRequestBuffer or FinesseGetRequestBufferForLength)
 //   (2) client sets up the request (message->Data)
 //   (3) client asks for server notification (FinesseRequestReady)
 //   (4) server retrieves message (FinesseGetReadyRequest)
@@ -810,11 +1003,18 @@ _Static_assert(sizeof(finesse_msg) <= (sizeof(fincomm_message_block) - offsetof(
 //
 fincomm_message FinesseGetRequestBuffer(fincomm_shared_memory_region *RequestRegion, FINESSE_MESSAGE_CLASS MessageClass,
                                         int MessageType);
+fincomm_message FinesseGetRequestBufferForLength(fincomm_shared_memory_region *RequestRegion, FINESSE_MESSAGE_CLASS MessageClass,
+                                                 int MessageType, size_t DataLength);
+size_t          FinesseGetMessageDataLength(fincomm_shared_memory_region *RequestRegion, fincomm_message Message);
+void            FinessePostInvalidation(fincomm_shared_memory_region *Region, const finesse_invalidation_t *Invalidation);
+int FinesseReadInvalidations(fincomm_shared_memory_region *Region, u_int64_t *Cursor, finesse_invalidation_t *Invalidations,
+                             unsigned MaxCount, unsigned *Count);
 u_int64_t       FinesseRequestReady(fincomm_shared_memory_region *RequestRegion, fincomm_message Message);
 void            FinesseResponseReady(fincomm_shared_memory_region *RequestRegion, fincomm_message Message, uint32_t Response);
 int             FinesseGetResponse(fincomm_shared_memory_region *RequestRegion, fincomm_message Message, int wait);
 int             FinesseGetReadyRequest(fincomm_shared_memory_region *RequestRegion, fincomm_message *message);
 int             FinesseReadyRequestWait(fincomm_shared_memory_region *RequestRegion);
+int             FinesseReadyRequestTimedWait(fincomm_shared_memory_region *RequestRegion, unsigned Milliseconds);
 int             FinesseInitializeMemoryRegion(fincomm_shared_memory_region *Fsmr);
 int             FinesseDestroyMemoryRegion(fincomm_shared_memory_region *Fsmr);
 
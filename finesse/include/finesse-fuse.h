@@ -11,6 +11,7 @@ typedef struct _finesse_object {
     fuse_ino_t inode;
     uuid_t     uuid;
     int        freed;
+    int        lookup;  // holds a FUSE lookup on inode, given back when the object is freed
     // TODO: we may need additional data here
 } finesse_object_t;
 
@@ -24,6 +25,7 @@ finesse_object_t *      FinesseObjectLookupByUuid(finesse_object_table_t *Table,
 void                    FinesseObjectRelease(finesse_object_table_t *Table, finesse_object_t *Object);
 finesse_object_t *      FinesseObjectCreate(finesse_object_table_t *Table, fuse_ino_t InodeNumber, uuid_t *Uuid);
 uint64_t                FinesseObjectGetTableSize(finesse_object_table_t *Table);
+void                    FinesseObjectGetTableStatistics(finesse_object_table_t *Table, uint64_t *Lookups, uint64_t *CacheHits);
 void                    FinesseInitializeTable(finesse_object_table_t *Table);
 void                    FinesseDestroyTable(finesse_object_table_t *Table);
 finesse_object_table_t *FinesseCreateTable(uint64_t EstimatedSize);
@@ -33,6 +35,8 @@ finesse_object_t *finesse_object_lookup_by_uuid(uuid_t *uuid);
 void              finesse_object_release(finesse_object_t *object);
 finesse_object_t *finesse_object_create(fuse_ino_t inode, uuid_t *uuid);
 uint64_t          finesse_object_get_table_size(void);
+void              finesse_object_get_table_statistics(uint64_t *Lookups, uint64_t *CacheHits);
+void              finesse_object_set_lookup_release(void (*Release)(void *Context, fuse_ino_t Inode), void *Context);
 
 extern int  finesse_send_reply_iov(fuse_req_t req, int error, struct iovec *iov, int count, int free_req);
 extern void finesse_notify_reply_iov(fuse_req_t req, int error, struct iovec *iov, int count);
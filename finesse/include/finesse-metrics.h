@@ -0,0 +1,87 @@
+//
+// (C) Copyright 2020 Tony Mason
+// All Rights Reserved
+//
+
+#if !defined(__FINESSE_METRICS_H__)
+#define __FINESSE_METRICS_H__ (1)
+
+#include <finesse.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+#include "callshard.h"
+
+//
+// Live metrics
+//
+// The Finesse server publishes a read-only shared memory page (one per mount
+// point) that a monitor (finesse-top) can map and poll without sending any
+// messages to the server.  A publisher thread in the server refreshes the page
+// periodically; nothing on the request path writes to it.
+//
+// The page is updated under a sequence lock: Sequence is odd while an update
+// is in progress.  Readers should use FinesseMetricsSnapshot to get a
+// consistent copy.
+//
+#define FINESSE_METRICS_MAGIC (0x8d1f0c3a5e7b2469)
+#define FINESSE_METRICS_VERSION (1)
+#define FINESSE_METRICS_DEFAULT_INTERVAL_MS (250)
+#define FINESSE_METRICS_INTERVAL_ENV "FINESSE_METRICS_INTERVAL"  // in ms, 0 disables publishing
+#define FINESSE_METRICS_MAX_COUNTERS (32)
+#define FINESSE_METRICS_COUNTER_NAME_LENGTH (48)
+
+// Request latencies are indexed by request type: FUSE requests first, then native requests
+#define FINESSE_METRICS_FUSE_REQUESTS (FINESSE_FUSE_REQ_MAX - FINESSE_FUSE_REQ_LOOKUP)
+#define FINESSE_METRICS_NATIVE_REQUESTS (FINESSE_NATIVE_REQ_MAX - FINESSE_NATIVE_REQ_TEST)
+#define FINESSE_METRICS_REQUEST_TYPES (FINESSE_METRICS_FUSE_REQUESTS + FINESSE_METRICS_NATIVE_REQUESTS)
+#define FINESSE_METRICS_FUSE_INDEX(type) ((type)-FINESSE_FUSE_REQ_LOOKUP)
+#define FINESSE_METRICS_NATIVE_INDEX(type) (FINESSE_METRICS_FUSE_REQUESTS + ((type)-FINESSE_NATIVE_REQ_TEST))
+
+typedef struct _finesse_metrics_client {
+    uint32_t Connected;
+    uint32_t QueueDepth;  // requests posted but not yet picked up by the server (last observed)
+    uint32_t InFlight;    // message buffers allocated by the client (last observed)
+    uint32_t Unused;
+    uint64_t Requests;  // requests retrieved from this client slot
+} finesse_metrics_client_t;
+
+typedef struct _finesse_metrics_counter {
+    char     Name[FINESSE_METRICS_COUNTER_NAME_LENGTH];
+    uint64_t Value;
+} finesse_metrics_counter_t;
+
+typedef struct _finesse_metrics_page {
+    uint64_t                  Magic;
+    uint32_t                  Version;
+    uint32_t                  Length;  // of this structure
+    uint64_t                  Sequence;
+    uint64_t                  Updates;
+    struct timespec           UpdateTime;  // CLOCK_MONOTONIC
+    pid_t                     ServerPid;
+    uint32_t                  IntervalMs;
+    char                      MountPoint[256];
+    FinesseServerStat         ServerStat;
+    uint32_t                  ClientCount;
+    uint32_t                  CounterCount;
+    finesse_metrics_client_t  Clients[SHM_MESSAGE_COUNT];
+    finesse_metrics_counter_t Counters[FINESSE_METRICS_MAX_COUNTERS];
+    uint64_t                  RequestLatency[FINESSE_METRICS_REQUEST_TYPES][FINESSE_CALLSHARD_BUCKETS];  // server time (ns)
+} finesse_metrics_page_t;
+
+typedef uint64_t (*finesse_metrics_counter_callback_t)(void *Context);
+
+// Server side (finesse/server/metrics.c)
+int  FinesseMetricsStart(finesse_server_handle_t ServerHandle, const char *MountPoint);
+void FinesseMetricsStop(void);
+void FinesseMetricsRecordRequest(unsigned RequestType, const struct timespec *Elapsed);
+int  FinesseMetricsRegisterCounter(const char *Name, finesse_metrics_counter_callback_t Callback, void *Context);
+void FinesseMetricsUnregisterCounter(finesse_metrics_counter_callback_t Callback, void *Context);
+
+// Reader side (finesse/communications/metricspage.c)
+int                     FinesseMetricsGenerateName(const char *MountPoint, char *Name, size_t NameLength);
+finesse_metrics_page_t *FinesseMetricsOpen(const char *MountPoint);
+void                    FinesseMetricsClose(finesse_metrics_page_t *Page);
+int                     FinesseMetricsSnapshot(const finesse_metrics_page_t *Page, finesse_metrics_page_t *Snapshot);
+
+#endif  // __FINESSE_METRICS_H__
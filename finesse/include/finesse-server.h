@@ -41,6 +41,48 @@ int FinesseServerNativeMapReleaseRequest(finesse_server_handle_t Fsh, void *Clie
 
 int FinesseServerNativeServerStatRequest(finesse_server_handle_t Fsh, void *Client, fincomm_message Message);
 
+int FinesseServerNativePathSearchRequest(struct fuse_session *se, void *Client, fincomm_message Message);
+
+int FinesseServerNativeCompoundRequest(struct fuse_session *se, void *Client, fincomm_message Message);
+
+int FinesseServerNativeStatDirRequest(struct fuse_session *se, void *Client, fincomm_message Message);
+
+// Invalidations pushed to the clients (finesse/server/invalidate.c)
+void FinesseServerInvalidateInode(struct fuse_session *se, fuse_ino_t Inode);
+void FinesseServerInvalidateEntry(struct fuse_session *se, fuse_ino_t Parent, const char *Name, size_t NameLength);
+void FinesseServerNotifyDelete(struct fuse_session *se, fuse_ino_t Parent, fuse_ino_t Child, const char *Name, size_t NameLength);
+
+// Page cache prefill (finesse/server/prefill.c)
+int  FinessePrefillStart(struct fuse_session *se);
+void FinessePrefillStop(void);
+void FinessePrefillNoteOpen(fuse_ino_t Inode, int Flags);
+void FinessePrefillNoteRead(fuse_ino_t Inode, off_t Offset, size_t Size);
+int  FinessePrefillNoteChange(fuse_ino_t Inode);
+
+// Negative lookup cache (finesse/server/negative.c)
+int  FinesseNegativeStart(struct fuse_session *se);
+void FinesseNegativeStop(void);
+
+// Name maps held by clients (finesse/server/clientmaps.c)
+int  FinesseClientMapsStart(struct fuse_session *se);
+void FinesseClientMapsStop(void);
+
+// Directory prefetch (finesse/server/prefetch.c)
+int  FinessePrefetchStart(struct fuse_session *se);
+void FinessePrefetchStop(void);
+
+// Symbolic link cache (finesse/server/symlink.c)
+int  FinesseSymlinkStart(struct fuse_session *se);
+void FinesseSymlinkStop(void);
+
 extern FinesseServerFunctionHandler FinesseServerFuseStat;
 extern FinesseServerFunctionHandler FinesseServerFuseAccess;
 extern FinesseServerFunctionHandler FinesseServerFuseUnlink;
+extern FinesseServerFunctionHandler FinesseServerFuseMkdir;
+extern FinesseServerFunctionHandler FinesseServerFuseRmdir;
+extern FinesseServerFunctionHandler FinesseServerFuseRename;
+extern FinesseServerFunctionHandler FinesseServerFuseLink;
+extern FinesseServerFunctionHandler FinesseServerFuseSymlink;
+extern FinesseServerFunctionHandler FinesseServerFuseCreate;
+extern FinesseServerFunctionHandler FinesseServerFuseReadlink;
+extern FinesseServerFunctionHandler FinesseServerFuseSetattr;
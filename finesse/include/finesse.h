@@ -26,12 +26,27 @@ int         FinesseSendResponse(finesse_server_handle_t FinesseServerHandle, voi
 int         FinesseGetMessageAuxBuffer(finesse_server_handle_t FinesseServerHandle, void *Client, void *Message, void **Buffer,
                                        size_t *BufferSize);
 const char *FinesseGetMessageAuxBufferName(finesse_server_handle_t FinesseServerHandle, void *Client, void *Message);
+void        FinesseReleaseMessageAuxBuffer(finesse_server_handle_t FinesseServerHandle, void *Client, void *Message);
+size_t      FinesseGetRequestDataLength(finesse_server_handle_t FinesseServerHandle, void *Client, fincomm_message Message);
+void *      FinesseMapMessageAuxBuffer(const char *Name, size_t Length);
+void        FinesseUnmapMessageAuxBuffer(void *Buffer, size_t Length);
 void        FinesseDestroyFuseRequest(fuse_req_t req);
 uint64_t    FinesseGetActiveClientCount(finesse_server_handle_t FinesseServerHandle);
+void        FinesseSendInvalidation(finesse_server_handle_t FinesseServerHandle, const finesse_invalidation_t *Invalidation);
+int         FinesseGetClientQueueStatistics(finesse_server_handle_t FinesseServerHandle, unsigned Index, uint32_t *QueueDepth,
+                                            uint32_t *InFlight, uint64_t *Requests);
+
+typedef void (*FinesseClientDisconnectHandler)(void *Client, void *Context);
+void FinesseSetClientDisconnectHandler(finesse_server_handle_t FinesseServerHandle, FinesseClientDisconnectHandler Handler,
+                                       void *Context);
 
 int FinesseStartClientConnection(finesse_client_handle_t *FinesseClientHandle, const char *MountPoint);
 int FinesseStopClientConnection(finesse_client_handle_t FinesseClientHandle);
 
+uint64_t FinesseGetInvalidationCursor(finesse_client_handle_t FinesseClientHandle);
+int      FinesseGetInvalidations(finesse_client_handle_t FinesseClientHandle, uint64_t *Cursor,
+                                 finesse_invalidation_t *Invalidations, unsigned MaxCount, unsigned *Count);
+
 int  FinesseSendTestRequest(finesse_client_handle_t FinesseClientHandle, fincomm_message *Message);
 int  FinesseSendTestResponse(finesse_server_handle_t FinesseServerHandle, void *Client, fincomm_message Message, int Result);
 int  FinesseGetTestResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Message);
@@ -57,11 +72,36 @@ int  FinesseSendNameMapReleaseResponse(finesse_server_handle_t FinesseServerHand
 int  FinesseGetNameMapReleaseResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Message);
 void FinesseFreeNameMapReleaseResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Response);
 
-int FinesseSendPathSearchRequest(finesse_client_handle_t FinesseClientHandle, char **Files, char **Paths, fincomm_message *Message);
-int FinesseSendPathSearchResponse(finesse_server_handle_t FinesseServerHandle, void *Client, fincomm_message Message, char *Path,
-                                  int Result);
-int FinesseGetPathSearchResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Message, char **Path);
-void FinesseFreePathSearchResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Response);
+size_t FinesseGetPathSearchRequestSize(const char **Files, const char **Paths);
+int    FinesseSendPathSearchRequest(finesse_client_handle_t FinesseClientHandle, const char **Files, const char **Paths, int Flags,
+                                    fincomm_message *Message);
+int    FinesseSendPathSearchResponse(finesse_server_handle_t FinesseServerHandle, void *Client, fincomm_message Message,
+                                     const finesse_path_search_match_t *Matches, unsigned MatchCount, int Result);
+int    FinesseGetPathSearchResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Message,
+                                    finesse_path_search_match_t *Matches, unsigned *MatchCount, int *Result);
+void   FinesseFreePathSearchResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Response);
+
+int  FinesseSendCompoundRequest(finesse_client_handle_t FinesseClientHandle, const finesse_compound_op_t *Ops, const char **Names,
+                                unsigned OpCount, fincomm_message *Message);
+int  FinesseSendCompoundResponse(finesse_server_handle_t FinesseServerHandle, void *Client, fincomm_message Message,
+                                 const finesse_compound_result_t *Results, unsigned OpCount, uuid_t *Key, const struct stat *Attr,
+                                 const void *Data, size_t DataLength, int Result);
+int  FinesseGetCompoundResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Message,
+                                finesse_compound_result_t *Results, unsigned *OpCount, uuid_t *Key, struct stat *Attr, void *Data,
+                                size_t *DataLength, int *Result);
+void FinesseFreeCompoundResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Response);
+
+int   FinesseSendStatDirRequest(finesse_client_handle_t FinesseClientHandle, const char *Path, const char *Pattern, uint64_t Offset,
+                                fincomm_message *Message);
+void *FinesseGetStatDirResponseBuffer(finesse_server_handle_t FinesseServerHandle, void *Client, fincomm_message Message,
+                                      size_t *BufferSize);
+int   FinesseSendStatDirResponse(finesse_server_handle_t FinesseServerHandle, void *Client, fincomm_message Message,
+                                 const void *Entries, uint32_t EntryCount, size_t Length, uint64_t NextOffset, int Complete,
+                                 int Result);
+int   FinesseGetStatDirResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Message, const void **Entries,
+                                size_t *Length, uint32_t *EntryCount, uint64_t *NextOffset, int *Complete, int *Result);
+void  FinesseFreeStatDirResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Response, const void *Entries,
+                                 size_t Length);
 
 int FinesseSendDirMapRequest(finesse_client_handle_t FinesseClientHandle, uuid_t *Key, char *Path, fincomm_message *Message);
 int FinesseSendDirMapResponse(finesse_server_handle_t FinesseServerHandle, void *Client, fincomm_message Message, size_t DataLength,
@@ -111,13 +151,47 @@ int  FinesseGetAccessResponse(finesse_client_handle_t FinesseClientHandle, finco
 void FinesseFreeAccessResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Response);
 
 int  FinesseSendCreateRequest(finesse_client_handle_t FinesseClientHandle, uuid_t *Parent, const char *Path, struct stat *Stat,
-                              fincomm_message *Message);
+                              int Flags, fincomm_message *Message);
 int  FinesseSendCreateResponse(finesse_server_handle_t FinesseServerHandle, void *Client, fincomm_message Message, uuid_t *Key,
                                uint64_t Generation, struct stat *Stat, double Timeout, int Result);
 int  FinesseGetCreateResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Message, uuid_t *Key,
                               uint64_t *Generation, struct stat *Stat, double *Timeout, int *Result);
 void FinesseFreeCreateResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Response);
 
+// Name space changes (a null Parent means the name is absolute); all are answered with just a result
+int FinesseSendMkdirRequest(finesse_client_handle_t FinesseClientHandle, uuid_t *Parent, const char *Name, mode_t Mode,
+                            fincomm_message *Message);
+int FinesseSendRmdirRequest(finesse_client_handle_t FinesseClientHandle, uuid_t *Parent, const char *Name,
+                            fincomm_message *Message);
+int FinesseSendRenameRequest(finesse_client_handle_t FinesseClientHandle, uuid_t *Parent, const char *OldName, uuid_t *NewParent,
+                             const char *NewName, unsigned Flags, fincomm_message *Message);
+int FinesseSendLinkRequest(finesse_client_handle_t FinesseClientHandle, uuid_t *Parent, const char *OldName, uuid_t *NewParent,
+                           const char *NewName, fincomm_message *Message);
+int FinesseSendSymlinkRequest(finesse_client_handle_t FinesseClientHandle, const char *Target, uuid_t *Parent, const char *Name,
+                              fincomm_message *Message);
+int  FinesseSendNamespaceResponse(finesse_server_handle_t FinesseServerHandle, void *Client, fincomm_message Message, int Result);
+int  FinesseGetNamespaceResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Message, int *Result);
+void FinesseFreeNamespaceResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Response);
+
+int  FinesseSendReadlinkRequest(finesse_client_handle_t FinesseClientHandle, uuid_t *Parent, const char *Name,
+                                fincomm_message *Message);
+int  FinesseSendReadlinkResponse(finesse_server_handle_t FinesseServerHandle, void *Client, fincomm_message Message,
+                                 const char *Link, size_t Length, int Result);
+int  FinesseGetReadlinkResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Message, char *Buffer,
+                                size_t BufferSize, ssize_t *Length, int *Result);
+void FinesseFreeReadlinkResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Response);
+
+int  FinesseSendSetattrRequest(finesse_client_handle_t FinesseClientHandle, uuid_t *Parent, const char *Name,
+                               const struct stat *Attr, int ToSet, fincomm_message *Message);
+int  FinesseSendSetattrResponse(finesse_server_handle_t FinesseServerHandle, void *Client, fincomm_message Message,
+                                const struct stat *Attr, double Timeout, int Result);
+int  FinesseGetSetattrResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Message, struct stat *Attr,
+                               int *Result);
+void FinesseFreeSetattrResponse(finesse_client_handle_t FinesseClientHandle, fincomm_message Response);
+
+// finesse_statdir calls this for each entry; a non-zero return ends the walk (and is returned)
+typedef int (*finesse_statdir_callback_t)(const char *Name, const struct stat *Attr, void *Context);
+
 extern void (*finesse_init)(void);
 finesse_client_handle_t *finesse_check_prefix(const char *name);
 int                      finesse_open(const char *pathname, int flags, ...);
@@ -138,9 +212,27 @@ int                      finesse_fstatat(int dirfd, const char *pathname, struct
 int                      finesse_statx(int dfd, const char *filename, unsigned atflag, unsigned mask, struct statx *buffer);
 int                      finesse_mkdir(const char *path, mode_t mode);
 int                      finesse_mkdirat(int fd, const char *path, mode_t mode);
+int                      finesse_rmdir(const char *path);
+int                      finesse_rename(const char *oldpath, const char *newpath);
+int                      finesse_renameat(int olddirfd, const char *oldpath, int newdirfd, const char *newpath);
+int                      finesse_link(const char *oldpath, const char *newpath);
+int                      finesse_symlink(const char *target, const char *linkpath);
+ssize_t                  finesse_readlink(const char *pathname, char *buf, size_t bufsiz);
+int                      finesse_chmod(const char *pathname, mode_t mode);
+int                      finesse_chown(const char *pathname, uid_t owner, gid_t group);
+int                      finesse_truncate(const char *path, off_t length);
+int                      finesse_utimensat(int dirfd, const char *pathname, const struct timespec times[2], int flags);
+mode_t                   finesse_umask(mode_t mask);
 int                      finesse_access(const char *pathname, int mode);
 int                      finesse_faccessat(int dirfd, const char *pathname, int mode, int flags);
 FILE *                   finesse_fopen(const char *pathname, const char *mode);
 FILE *                   finesse_fdopen(int fd, const char *mode);
 FILE *                   finesse_freopen(const char *pathname, const char *mode, FILE *stream);
 int                      finesse_is_fd_tracked(int fd);
+int                      finesse_search_path(const char **Files, const char **Paths, unsigned *FileIndex, unsigned *PathIndex);
+int                      finesse_search_path_all(const char **Files, const char **Paths, finesse_path_search_match_t *Matches,
+                                                 unsigned *MatchCount);
+int                      finesse_execvp(const char *file, char *const argv[]);
+int                      finesse_execvpe(const char *file, char *const argv[], char *const envp[]);
+ssize_t                  finesse_read_small_file(const char *pathname, void *buf, size_t count, struct stat *statbuf);
+int                      finesse_statdir(const char *path, const char *pattern, finesse_statdir_callback_t callback, void *context);
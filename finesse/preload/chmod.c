@@ -5,18 +5,13 @@
 #include <finesse.h>
 #include "preload.h"
 #include <sys/stat.h>
-#include <fcntl.h>           /* Definition of AT_* constants */
-#include <sys/stat.h>
-
-
 
-int chmod(const char *pathname, mode_t mode);
-int fchmod(int fd, mode_t mode);
-int fchmodat(int dirfd, const char *pathname, mode_t mode, int flags);
-
-void todo_chmod(void);
-void todo_chmod(void)
+int chmod(const char *pathname, mode_t mode)
 {
-    return;
+    return finesse_chmod(pathname, mode);
 }
 
+mode_t umask(mode_t mask)
+{
+    return finesse_umask(mask);
+}
@@ -4,17 +4,14 @@
 
 #include <finesse.h>
 #include "preload.h"
-#include <fcntl.h>           /* Definition of AT_* constants */
 #include <unistd.h>
 
-int chown(const char *pathname, uid_t owner, gid_t group);
-int fchown(int fd, uid_t owner, gid_t group);
-int lchown(const char *pathname, uid_t owner, gid_t group);
-int fchownat(int dirfd, const char *pathname, uid_t owner, gid_t group, int flags);
-
-void todo_chown(void);
-void todo_chown(void)
+int chown(const char *pathname, uid_t owner, gid_t group)
 {
-    return;
+    return finesse_chown(pathname, owner, group);
 }
 
+int truncate(const char *path, off_t length)
+{
+    return finesse_truncate(path, length);
+}
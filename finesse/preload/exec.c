@@ -0,0 +1,18 @@
+/*
+ * Copyright (c) 2020, Tony Mason. All rights reserved.
+ */
+
+#include <finesse.h>
+#include "preload.h"
+
+// These only search differently when FINESSE_PATH_SEARCH is set in the environment
+
+int execvp(const char *file, char *const argv[])
+{
+    return finesse_execvp(file, argv);
+}
+
+int execvpe(const char *file, char *const argv[], char *const envp[])
+{
+    return finesse_execvpe(file, argv, envp);
+}
@@ -4,19 +4,19 @@
 
 #include <finesse.h>
 #include "preload.h"
-#include <fcntl.h>           /* Definition of AT_* constants */
 #include <unistd.h>
 
-int link(const char *oldpath, const char *newpath);
-
-#include <fcntl.h>           /* Definition of AT_* constants */
-#include <unistd.h>
-
-int linkat(int olddirfd, const char *oldpath,
-            int newdirfd, const char *newpath, int flags);
+int link(const char *oldpath, const char *newpath)
+{
+    return finesse_link(oldpath, newpath);
+}
 
-void todo_link(void);
-void todo_link(void)
+int symlink(const char *target, const char *linkpath)
 {
+    return finesse_symlink(target, linkpath);
+}
 
+ssize_t readlink(const char *pathname, char *buf, size_t bufsiz)
+{
+    return finesse_readlink(pathname, buf, bufsiz);
 }
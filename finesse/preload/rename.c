@@ -1,4 +1,3 @@
-
 /*
  * Copyright (c) 2020, Tony Mason. All rights reserved.
  */
@@ -6,12 +5,14 @@
 #include <finesse.h>
 #include "preload.h"
 #include <fcntl.h>           /* Definition of AT_* constants */
-#include <unistd.h>
-
-int rename(const char *old, const char *new);
+#include <stdio.h>
 
-void todo_rename(void);
-void todo_rename(void)
+int rename(const char *old, const char *new)
 {
+    return finesse_rename(old, new);
+}
 
+int renameat(int olddirfd, const char *oldpath, int newdirfd, const char *newpath)
+{
+    return finesse_renameat(olddirfd, oldpath, newdirfd, newpath);
 }
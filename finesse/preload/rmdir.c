@@ -1,17 +1,12 @@
-
 /*
  * Copyright (c) 2020, Tony Mason. All rights reserved.
  */
 
 #include <finesse.h>
 #include "preload.h"
-#include <fcntl.h>           /* Definition of AT_* constants */
 #include <unistd.h>
 
-int rmdir(const char *path);
-
-void todo_rmdir(void);
-void todo_rmdir(void)
+int rmdir(const char *path)
 {
-
+    return finesse_rmdir(path);
 }
@@ -1,21 +1,47 @@
-
 /*
  * Copyright (c) 2020, Tony Mason. All rights reserved.
  */
 
 #include <finesse.h>
 #include "preload.h"
+#include <fcntl.h>           /* Definition of AT_* constants */
+#include <sys/stat.h>
 #include <sys/time.h>
+#include <utime.h>
 
-int utime(const char *filename, const struct utimbuf *times);
-int utimes(const char *filename, const struct timeval times[2]);
+int utimensat(int dirfd, const char *pathname, const struct timespec times[2], int flags)
+{
+    return finesse_utimensat(dirfd, pathname, times, flags);
+}
 
-void todo_utime(void);
-void todo_utime(void)
+int utimes(const char *filename, const struct timeval times[2])
 {
+    struct timespec ts[2];
+
+    if (NULL == times) {
+        return finesse_utimensat(AT_FDCWD, filename, NULL, 0);
+    }
 
+    ts[0].tv_sec  = times[0].tv_sec;
+    ts[0].tv_nsec = times[0].tv_usec * 1000;
+    ts[1].tv_sec  = times[1].tv_sec;
+    ts[1].tv_nsec = times[1].tv_usec * 1000;
+
+    return finesse_utimensat(AT_FDCWD, filename, ts, 0);
 }
 
+int utime(const char *filename, const struct utimbuf *times)
+{
+    struct timespec ts[2];
 
+    if (NULL == times) {
+        return finesse_utimensat(AT_FDCWD, filename, NULL, 0);
+    }
 
+    ts[0].tv_sec  = times->actime;
+    ts[0].tv_nsec = 0;
+    ts[1].tv_sec  = times->modtime;
+    ts[1].tv_nsec = 0;
 
+    return finesse_utimensat(AT_FDCWD, filename, ts, 0);
+}
@@ -3,81 +3,106 @@
 */
 #include "fs-internal.h"
 
+//
+// access(2): walk to the object (so a missing name is answered from the negative cache, see
+// negative.c) and then ask the file system.  access follows symlinks, and so does the walk; a
+// link out of our mount goes back to the client.  A file system without an access
+// operation leaves it to the kernel's permission checks; we can still say whether the name
+// exists (F_OK), but anything else has to go back too.
+//
+static int AccessCheck(struct fuse_session *se, fuse_ino_t Ino, int Mask)
+{
+    struct fuse_req *fuse_request = NULL;
+    int              status       = 0;
+
+    if (NULL == finesse_original_ops->access) {
+        return F_OK == Mask ? 0 : ENOTSUP;
+    }
+
+    fuse_request = FinesseAllocInternalRequest(se, FUSE_ACCESS);
+    if (NULL == fuse_request) {
+        return ENOMEM;
+    }
+
+    finesse_original_ops->access(fuse_request, Ino, Mask);
+    status = FinesseInternalReplyStatus(fuse_request, 0);
+
+    FinesseFreeFuseRequest(fuse_request);
+
+    if (ENOSYS == status) {
+        status = F_OK == Mask ? 0 : ENOTSUP;
+    }
+
+    return status;
+}
+
 static int Access(struct fuse_session *se, void *Client, fincomm_message Message)
 {
-    finesse_msg *            fmsg   = NULL;
-    int                      status = 0;
-    finesse_object_t *       finobj = NULL;
-    finesse_server_handle_t *fsh;
-    fuse_ino_t               parent          = FUSE_ROOT_ID;
-    struct fuse_req *        fuse_request    = NULL;
-    struct finesse_req *     finesse_request = NULL;
-    struct fuse_out_header * out             = NULL;
+    finesse_msg *           fmsg   = NULL;
+    int                     status = 0;
+    int                     result = 0;
+    finesse_object_t *      finobj = NULL;
+    finesse_server_handle_t fsh;
+    fuse_ino_t              base      = FUSE_ROOT_ID;
+    fuse_ino_t              ino       = 0;
+    uint32_t                mode      = 0;
+    const char *            name      = NULL;
+    size_t                  mp_length = 0;
 
     assert(NULL != se);
     assert(NULL != Message);
 
-    while (1) {
-        // fmsg->Message.Fuse.Request.Parameters.Access.ParentInode;
-        // fmsg->Message.Fuse.Request.Parameters.Access.Mask;
-        // fmsg->Message.Fuse.Request.Parameters.Access.Name;
-        fsh  = (finesse_server_handle_t)se->server_handle;
-        fmsg = (finesse_msg *)Message->Data;
+    fsh  = (finesse_server_handle_t)se->server_handle;
+    fmsg = (finesse_msg *)Message->Data;
+    name = fmsg->Message.Fuse.Request.Parameters.Access.Name;
 
+    while (1) {
         if (uuid_is_null(fmsg->Message.Fuse.Request.Parameters.Access.ParentInode)) {
-            parent = FUSE_ROOT_ID;
+            // absolute; it has to be in our mount
+            mp_length = strlen(se->mountpoint);
+            if ((0 != strncmp(name, se->mountpoint, mp_length)) || (('/' != name[mp_length]) && ('\0' != name[mp_length]))) {
+                result = ENOTSUP;
+                break;
+            }
+            name += mp_length;
         }
         else {
             finobj = finesse_object_lookup_by_uuid(&fmsg->Message.Fuse.Request.Parameters.Access.ParentInode);
             if (NULL == finobj) {
-                //
-                status = FinesseSendAccessResponse(fsh, Client, Message, EBADF);
-                assert(0 == status);
-                FinesseCountFuseResponse(FINESSE_FUSE_RSP_ERR);
-                status = 0;
+                result = EBADF;
                 break;
             }
+            base = finobj->inode;
         }
 
-        // We need to ask the file system, which means we need a request.
-        fuse_request = FinesseAllocFuseRequest(se);
-
-        if (NULL == fuse_request) {
-            fprintf(stderr, "%s @ %d (%s): alloc failure\n", __FILE__, __LINE__, __func__);
-            // TODO: fix this function's prototype
-
-            status = FinesseSendAccessResponse(fsh, Client, Message, ENOMEM);
-
-            if (0 == status) {
-                FinesseCountFuseResponse(FINESSE_FUSE_RSP_ERR);
-            }
+        result = FinesseServerInternalWalk(se, base, name, FINESSE_WALK_FOLLOW, &ino, &mode);
+        if (FINESSE_WALK_UNRESOLVED == result) {
+            result = ENOTSUP;
             break;
         }
 
-        fuse_request->ctr++;  // make sure it doesn't go away until we're done processing it.
-        finesse_request      = (struct finesse_req *)fuse_request;
-        fuse_request->opcode = FUSE_ACCESS;
-        finesse_original_ops->access(fuse_request, parent, fmsg->Message.Fuse.Request.Parameters.Access.Mask);
-
-        FinesseWaitForFuseRequestCompletion(finesse_request);
+        if (0 != result) {
+            break;
+        }
 
-        assert(finesse_request->iov_count > 0);
-        out = finesse_request->iov[0].iov_base;
+        result = AccessCheck(se, ino, fmsg->Message.Fuse.Request.Parameters.Access.Mask);
 
-        status = FinesseSendStatfsResponse(fsh, Client, Message, NULL, out->error);
-        assert(0 == status);
-        FinesseCountFuseResponse(FINESSE_FUSE_RSP_STATFS);
-        FinesseFreeFuseRequest(fuse_request);
-        status = 0;
+        if (ino != base) {
+            FinesseReleaseInode(se, ino);
+        }
         break;
     }
 
+    status = FinesseSendAccessResponse(fsh, Client, Message, result);
+    assert(0 == status);
+    FinesseCountFuseResponse(FINESSE_FUSE_RSP_ERR);
+
     if (NULL != finobj) {
         finesse_object_release(finobj);
         finobj = NULL;
     }
 
-    return status;
+    return 0;
 }
 
 FinesseServerFunctionHandler FinesseServerFuseAccess = Access;
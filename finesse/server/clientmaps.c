@@ -0,0 +1,295 @@
+/*
+  Copyright (C) 2020  Tony Mason <fsgeek@cs.ubc.ca>
+*/
+#include "fs-internal.h"
+#include "finesse-list.h"
+#include "finesse-metrics.h"
+#include <murmurhash3.h>
+
+//
+// Which clients hold which name maps.
+//
+// A map handed to a client (by a native map, or the object a compound leaves mapped) carries a
+// reference on its finesse_object_t that only the client's map release drops.  A client that
+// exits or crashes without releasing its maps would leave them in the object table for good, so
+// every reference a client holds is recorded here: one record per (client, object) counting the
+// maps of that object the client holds, kept on a list per client.  When the connection code
+// tells us a client has gone (see FinesseSetClientDisconnectHandler) its list is walked and each
+// reference dropped, which costs what the client held rather than a walk of the table.  Clients
+// mapping the same inode share the object (the table hands out the existing one), each with its
+// own record and references.
+//
+// A client releasing a key it doesn't hold (another client's, or one it already released) is
+// ignored rather than dropping a reference someone else holds.
+//
+#define FINESSE_CLIENT_MAP_BUCKETS (1024)
+
+typedef struct _finesse_client_map {
+    list_entry_t      ClientListEntry;  // on the owning client's list (or the free list)
+    list_entry_t      BucketListEntry;  // in its (client, key) hash chain
+    finesse_object_t *Object;
+    uint32_t          Client;
+    uint32_t          Count;  // references on Object held by Client
+} finesse_client_map_t;
+
+static struct {
+    pthread_mutex_t      Lock;
+    int                  Running;
+    struct fuse_session *Session;
+    list_entry_t         Clients[SHM_MESSAGE_COUNT];
+    list_entry_t         Buckets[FINESSE_CLIENT_MAP_BUCKETS];
+    list_entry_t         FreeMaps;
+    uint64_t             Held;       // records in use
+    uint64_t             Reclaimed;  // references dropped because their client went away
+} FinesseClientMaps = {.Lock = PTHREAD_MUTEX_INITIALIZER};
+
+static uint64_t FinesseClientMapsHeld(void *Context)
+{
+    (void)Context;
+    return __atomic_load_n(&FinesseClientMaps.Held, __ATOMIC_RELAXED);
+}
+
+static uint64_t FinesseClientMapsReclaimed(void *Context)
+{
+    (void)Context;
+    return __atomic_load_n(&FinesseClientMaps.Reclaimed, __ATOMIC_RELAXED);
+}
+
+static unsigned ClientMapIndex(void *Client)
+{
+    unsigned index = (unsigned)(uintptr_t)Client;
+
+    assert(index < SHM_MESSAGE_COUNT);
+    return index;
+}
+
+static unsigned ClientMapBucket(unsigned Client, uuid_t *Key)
+{
+    uint64_t hash[2];
+
+    MurmurHash3_x64_128(Key, sizeof(uuid_t), Client, hash);
+
+    return (unsigned)((hash[0] ^ hash[1]) % FINESSE_CLIENT_MAP_BUCKETS);
+}
+
+// Called with the lock held
+static finesse_client_map_t *ClientMapFind(unsigned Client, uuid_t *Key, unsigned Bucket)
+{
+    list_entry_t *        le  = NULL;
+    finesse_client_map_t *map = NULL;
+
+    list_for_each(&FinesseClientMaps.Buckets[Bucket], le)
+    {
+        map = container_of(le, finesse_client_map_t, BucketListEntry);
+        if ((Client == map->Client) && (0 == uuid_compare(map->Object->uuid, *Key))) {
+            return map;
+        }
+    }
+
+    return NULL;
+}
+
+// Called with the lock held; the record goes back on the free list
+static void ClientMapRemove(finesse_client_map_t *Map)
+{
+    remove_list_entry(&Map->BucketListEntry);
+    remove_list_entry(&Map->ClientListEntry);
+    Map->Object = NULL;
+    Map->Count  = 0;
+    insert_list_head(&FinesseClientMaps.FreeMaps, &Map->ClientListEntry);
+    __atomic_fetch_sub(&FinesseClientMaps.Held, 1, __ATOMIC_RELAXED);
+}
+
+//
+// The caller's reference on Object now belongs to Client; it is dropped when the client releases
+// the map (FinesseClientMapRelease) or goes away.  If we aren't tracking maps (or can't get a
+// record) the reference is simply left with the client, as it always was.
+//
+void FinesseClientMapAdd(void *Client, finesse_object_t *Object)
+{
+    unsigned              client = ClientMapIndex(Client);
+    unsigned              bucket = 0;
+    finesse_client_map_t *map    = NULL;
+
+    assert(NULL != Object);
+
+    if (0 == __atomic_load_n(&FinesseClientMaps.Running, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    bucket = ClientMapBucket(client, &Object->uuid);
+
+    pthread_mutex_lock(&FinesseClientMaps.Lock);
+    while (FinesseClientMaps.Running) {
+        map = ClientMapFind(client, &Object->uuid, bucket);
+        if (NULL != map) {
+            // Mapped again by the same client: the table gave us the same object
+            assert(map->Object == Object);
+            map->Count++;
+            break;
+        }
+
+        if (!empty_list(&FinesseClientMaps.FreeMaps)) {
+            map = container_of(remove_list_head(&FinesseClientMaps.FreeMaps), finesse_client_map_t, ClientListEntry);
+        }
+        else {
+            map = (finesse_client_map_t *)malloc(sizeof(finesse_client_map_t));
+            if (NULL == map) {
+                break;
+            }
+        }
+
+        map->Object = Object;
+        map->Client = client;
+        map->Count  = 1;
+        insert_list_tail(&FinesseClientMaps.Clients[client], &map->ClientListEntry);
+        insert_list_tail(&FinesseClientMaps.Buckets[bucket], &map->BucketListEntry);
+        __atomic_fetch_add(&FinesseClientMaps.Held, 1, __ATOMIC_RELAXED);
+        break;
+    }
+    pthread_mutex_unlock(&FinesseClientMaps.Lock);
+}
+
+//
+// Drop one of Client's references on the map with this key.  Returns ENOENT if the client
+// doesn't hold it.
+//
+int FinesseClientMapRelease(void *Client, uuid_t *Key)
+{
+    unsigned              client = ClientMapIndex(Client);
+    unsigned              bucket = 0;
+    finesse_client_map_t *map    = NULL;
+    finesse_object_t *    object = NULL;
+
+    assert(NULL != Key);
+
+    if (uuid_is_null(*Key)) {
+        return ENOENT;
+    }
+
+    bucket = ClientMapBucket(client, Key);
+
+    pthread_mutex_lock(&FinesseClientMaps.Lock);
+    if (FinesseClientMaps.Running) {
+        map = ClientMapFind(client, Key, bucket);
+    }
+    if (NULL != map) {
+        object = map->Object;
+        assert(map->Count > 0);
+        map->Count--;
+        if (0 == map->Count) {
+            ClientMapRemove(map);
+        }
+    }
+    pthread_mutex_unlock(&FinesseClientMaps.Lock);
+
+    if (NULL == object) {
+        return ENOENT;
+    }
+
+    finesse_object_release(object);
+
+    return 0;
+}
+
+//
+// Drop everything Client holds.  The references are dropped outside the lock: freeing an object
+// can give its lookup back to the file system.
+//
+static void ClientMapsReleaseAll(unsigned Client)
+{
+    finesse_client_map_t *map    = NULL;
+    finesse_object_t *    object = NULL;
+    uint32_t              count  = 0;
+
+    pthread_mutex_lock(&FinesseClientMaps.Lock);
+    while (!empty_list(&FinesseClientMaps.Clients[Client])) {
+        map    = container_of(list_head(&FinesseClientMaps.Clients[Client]), finesse_client_map_t, ClientListEntry);
+        object = map->Object;
+        count  = map->Count;
+        ClientMapRemove(map);
+        pthread_mutex_unlock(&FinesseClientMaps.Lock);
+
+        while (count > 0) {
+            finesse_object_release(object);
+            count--;
+            __atomic_fetch_add(&FinesseClientMaps.Reclaimed, 1, __ATOMIC_RELAXED);
+        }
+
+        pthread_mutex_lock(&FinesseClientMaps.Lock);
+    }
+    pthread_mutex_unlock(&FinesseClientMaps.Lock);
+}
+
+static void ClientMapsDisconnect(void *Client, void *Context)
+{
+    (void)Context;
+
+    if (0 == __atomic_load_n(&FinesseClientMaps.Running, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    ClientMapsReleaseAll(ClientMapIndex(Client));
+}
+
+int FinesseClientMapsStart(struct fuse_session *se)
+{
+    assert(NULL != se);
+    assert(NULL != se->server_handle);
+    assert(0 == FinesseClientMaps.Running);
+
+    pthread_mutex_lock(&FinesseClientMaps.Lock);
+    for (unsigned index = 0; index < SHM_MESSAGE_COUNT; index++) {
+        initialize_list(&FinesseClientMaps.Clients[index]);
+    }
+    for (unsigned index = 0; index < FINESSE_CLIENT_MAP_BUCKETS; index++) {
+        initialize_list(&FinesseClientMaps.Buckets[index]);
+    }
+    initialize_list(&FinesseClientMaps.FreeMaps);
+    FinesseClientMaps.Held      = 0;
+    FinesseClientMaps.Reclaimed = 0;
+    FinesseClientMaps.Session   = se;
+    __atomic_store_n(&FinesseClientMaps.Running, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&FinesseClientMaps.Lock);
+
+    FinesseSetClientDisconnectHandler(se->server_handle, ClientMapsDisconnect, NULL);
+
+    FinesseMetricsRegisterCounter("finesse client maps", FinesseClientMapsHeld, NULL);
+    FinesseMetricsRegisterCounter("finesse client maps reclaimed", FinesseClientMapsReclaimed, NULL);
+
+    return 0;
+}
+
+//
+// The server is going away: whatever the clients still hold is released along with the
+// records.  This has to happen before the connections are torn down, as the disconnect
+// handler goes away here.
+//
+void FinesseClientMapsStop(void)
+{
+    finesse_client_map_t *map = NULL;
+
+    if (0 == FinesseClientMaps.Running) {
+        return;
+    }
+
+    FinesseMetricsUnregisterCounter(FinesseClientMapsHeld, NULL);
+    FinesseMetricsUnregisterCounter(FinesseClientMapsReclaimed, NULL);
+
+    FinesseSetClientDisconnectHandler(FinesseClientMaps.Session->server_handle, NULL, NULL);
+
+    pthread_mutex_lock(&FinesseClientMaps.Lock);
+    __atomic_store_n(&FinesseClientMaps.Running, 0, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&FinesseClientMaps.Lock);
+
+    for (unsigned index = 0; index < SHM_MESSAGE_COUNT; index++) {
+        ClientMapsReleaseAll(index);
+    }
+
+    pthread_mutex_lock(&FinesseClientMaps.Lock);
+    while (!empty_list(&FinesseClientMaps.FreeMaps)) {
+        map = container_of(remove_list_head(&FinesseClientMaps.FreeMaps), finesse_client_map_t, ClientListEntry);
+        free(map);
+    }
+    pthread_mutex_unlock(&FinesseClientMaps.Lock);
+}
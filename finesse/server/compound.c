@@ -0,0 +1,437 @@
+/*
+  Copyright (C) 2020  Tony Mason <fsgeek@cs.ubc.ca>
+*/
+#include "fs-internal.h"
+
+//
+// Compound requests: run a short program of operations (map, getattr, open, read, close,
+// map release) against the FUSE file system in one dispatch.  Reading a small file the
+// usual way is four or more round trips (open, fstat, read, close); as a compound it is one.
+//
+// The operations pass their results along: MAP makes its object the current one and OPEN
+// makes its file handle the current open.  Nothing opened here outlives the compound (the
+// client has no way to use a FUSE file handle), and if an operation fails the map the
+// compound made is released as well, so a failed compound leaves nothing behind.
+//
+// MAP walks the name with FinesseServerInternalWalk, as path search does; as with a name map,
+// the walk's lookup goes to the object if the map created it and is given back otherwise.  An
+// absolute name outside our mount gets EXDEV.  MAP follows symbolic links, as open does; one
+// that leaves our mount gets ENOTSUP and the client does the work itself.
+//
+
+static void CompoundUnmap(finesse_object_t **Finobj)
+{
+    if (NULL != *Finobj) {
+        finesse_object_release(*Finobj);
+        *Finobj = NULL;
+    }
+}
+
+//
+// Name is absolute (within our mount) unless there is a Parent.  On success the caller has a
+// reference on *Finobj.
+//
+static int CompoundMap(struct fuse_session *se, finesse_object_t *Parent, const char *Name, finesse_object_t **Finobj)
+{
+    size_t     mp_length = strlen(se->mountpoint);
+    fuse_ino_t parent    = FUSE_ROOT_ID;
+    fuse_ino_t ino       = 0;
+    uint32_t   mode      = 0;
+    uuid_t     uuid;
+    int        status;
+
+    *Finobj = NULL;
+
+    if (NULL != Parent) {
+        parent = Parent->inode;
+    }
+    else {
+        if ((0 != strncmp(Name, se->mountpoint, mp_length)) || (('/' != Name[mp_length]) && ('\0' != Name[mp_length]))) {
+            return EXDEV;
+        }
+        Name += mp_length;
+    }
+
+    status = FinesseServerInternalWalk(se, parent, Name, FINESSE_WALK_FOLLOW, &ino, &mode);
+
+    if (FINESSE_WALK_UNRESOLVED == status) {
+        return ENOTSUP;  // the client has to do this one
+    }
+
+    if (0 != status) {
+        return status;
+    }
+
+    uuid_generate_time_safe(uuid);
+    *Finobj = finesse_object_create(ino, &uuid);
+    assert(NULL != *Finobj);
+    if (0 == uuid_compare(uuid, (*Finobj)->uuid)) {
+        // The new object owns the walk's lookup; creation returns with TWO references
+        (*Finobj)->lookup = (ino != parent);
+        finesse_object_release(*Finobj);
+    }
+    else if (ino != parent) {
+        // The object already holds a lookup on this inode; we don't need the walk's
+        FinesseReleaseInode(se, ino);
+    }
+
+    return 0;
+}
+
+static int CompoundGetattr(struct fuse_session *se, fuse_ino_t Ino, struct stat *Attr)
+{
+    struct fuse_req *     fuse_request = NULL;
+    struct fuse_attr_out *arg          = NULL;
+    int                   status;
+
+    if (NULL == finesse_original_ops->getattr) {
+        return ENOSYS;
+    }
+
+    fuse_request = FinesseAllocInternalRequest(se, FUSE_GETATTR);
+    if (NULL == fuse_request) {
+        return ENOMEM;
+    }
+
+    finesse_original_ops->getattr(fuse_request, Ino, NULL);
+    status = FinesseInternalReplyStatus(fuse_request, sizeof(struct fuse_attr_out));
+
+    if (0 == status) {
+        arg = ((struct finesse_req *)fuse_request)->iov[1].iov_base;
+        FinesseFuseAttrToStat(&arg->attr, Attr);
+    }
+
+    FinesseFreeFuseRequest(fuse_request);
+
+    return status;
+}
+
+static int CompoundOpen(struct fuse_session *se, fuse_ino_t Ino, int Flags, uint64_t *Fh)
+{
+    struct fuse_req *     fuse_request = NULL;
+    struct fuse_open_out *arg          = NULL;
+    struct fuse_file_info fi;
+    int                   status;
+
+    *Fh = 0;
+
+    if ((O_ACCMODE & Flags) != O_RDONLY) {
+        // Only reading is supported
+        return EINVAL;
+    }
+
+    if (NULL == finesse_original_ops->open) {
+        // As for the kernel, no open method means there's nothing to do
+        return 0;
+    }
+
+    fuse_request = FinesseAllocInternalRequest(se, FUSE_OPEN);
+    if (NULL == fuse_request) {
+        return ENOMEM;
+    }
+
+    memset(&fi, 0, sizeof(fi));
+    fi.flags = Flags;
+    finesse_original_ops->open(fuse_request, Ino, &fi);
+    status = FinesseInternalReplyStatus(fuse_request, sizeof(struct fuse_open_out));
+
+    if (0 == status) {
+        arg = ((struct finesse_req *)fuse_request)->iov[1].iov_base;
+        *Fh = arg->fh;
+    }
+
+    FinesseFreeFuseRequest(fuse_request);
+
+    return status;
+}
+
+static int CompoundRead(struct fuse_session *se, fuse_ino_t Ino, uint64_t Fh, int Flags, off_t Offset, size_t Size, char *Buffer,
+                        size_t *Length)
+{
+    struct fuse_req *     fuse_request    = NULL;
+    struct finesse_req *  finesse_request = NULL;
+    struct fuse_file_info fi;
+    int                   status;
+
+    *Length = 0;
+
+    if (NULL == finesse_original_ops->read) {
+        return ENOSYS;
+    }
+
+    if (0 == Size) {
+        return 0;
+    }
+
+    fuse_request    = FinesseAllocInternalRequest(se, FUSE_READ);
+    finesse_request = (struct finesse_req *)fuse_request;
+    if (NULL == fuse_request) {
+        return ENOMEM;
+    }
+
+    memset(&fi, 0, sizeof(fi));
+    fi.fh    = Fh;
+    fi.flags = Flags;
+    finesse_original_ops->read(fuse_request, Ino, Size, Offset, &fi);
+    status = FinesseInternalReplyStatus(fuse_request, 0);
+
+    // The data may come back in pieces
+    for (int index = 1; (0 == status) && (index < finesse_request->iov_count); index++) {
+        size_t length = finesse_request->iov[index].iov_len;
+
+        if (length > Size - *Length) {
+            length = Size - *Length;
+        }
+        memcpy(Buffer + *Length, finesse_request->iov[index].iov_base, length);
+        *Length += length;
+    }
+
+    FinesseFreeFuseRequest(fuse_request);
+
+    return status;
+}
+
+static void CompoundRelease(struct fuse_session *se, fuse_ino_t Ino, uint64_t Fh, int Flags)
+{
+    struct fuse_req *     fuse_request = NULL;
+    struct fuse_file_info fi;
+
+    if (NULL == finesse_original_ops->release) {
+        return;
+    }
+
+    fuse_request = FinesseAllocInternalRequest(se, FUSE_RELEASE);
+    if (NULL == fuse_request) {
+        return;
+    }
+
+    memset(&fi, 0, sizeof(fi));
+    fi.fh    = Fh;
+    fi.flags = Flags;
+    finesse_original_ops->release(fuse_request, Ino, &fi);
+    (void)FinesseInternalReplyStatus(fuse_request, 0);
+
+    FinesseFreeFuseRequest(fuse_request);
+}
+
+int FinesseServerNativeCompoundRequest(struct fuse_session *se, void *Client, fincomm_message Message)
+{
+    finesse_server_handle_t   fsh         = NULL;
+    finesse_msg *             fmsg        = (finesse_msg *)Message->Data;
+    int                       status      = 0;
+    int                       result      = 0;
+    unsigned                  op_count    = 0;
+    unsigned                  executed    = 0;
+    finesse_compound_op_t     ops[FINESSE_COMPOUND_MAX_OPS];
+    finesse_compound_result_t results[FINESSE_COMPOUND_MAX_OPS];
+    char *                    names       = NULL;
+    size_t                    names_size  = 0;
+    char *                    data        = NULL;
+    size_t                    data_length = 0;
+    struct stat               attr;
+    int                       have_attr   = 0;
+    finesse_object_t *        finobj      = NULL;  // the current object
+    fuse_ino_t                open_ino    = 0;
+    uint64_t                  open_fh     = 0;
+    int                       open_flags  = 0;
+    int                       is_open     = 0;
+    uuid_t                    key;
+
+    fsh = (finesse_server_handle_t)se->server_handle;
+
+    if (NULL == fsh) {
+        return ENOTCONN;
+    }
+
+    memset(&attr, 0, sizeof(attr));
+    memset(results, 0, sizeof(results));
+
+    while (1) {
+        op_count = fmsg->Message.Native.Request.Parameters.Compound.OpCount;
+        if ((0 == op_count) || (op_count > FINESSE_COMPOUND_MAX_OPS)) {
+            result = EINVAL;
+            break;
+        }
+
+        // Our answers go back in this message, on top of the names the client sent; save those first.
+        names_size = FinesseGetRequestDataLength(fsh, Client, Message) -
+                     offsetof(finesse_msg, Message.Native.Request.Parameters.Compound.Data);
+        names = malloc(names_size + 1);
+        data  = malloc(FINESSE_COMPOUND_MAX_DATA);
+        if ((NULL == names) || (NULL == data)) {
+            result = ENOMEM;
+            break;
+        }
+        memcpy(ops, fmsg->Message.Native.Request.Parameters.Compound.Ops, op_count * sizeof(finesse_compound_op_t));
+        memcpy(names, fmsg->Message.Native.Request.Parameters.Compound.Data, names_size);
+        names[names_size] = '\0';  // so a bad offset still finds a terminated name
+
+        for (executed = 0; (executed < op_count) && (0 == result); executed++) {
+            finesse_compound_op_t *    op     = &ops[executed];
+            finesse_compound_result_t *res    = &results[executed];
+            finesse_object_t *         keyobj = NULL;
+            size_t                     length = 0;
+
+            res->Op = op->Op;
+
+            if (!uuid_is_null(op->Key)) {
+                // An explicit key (from an earlier map) rather than the current object
+                keyobj = finesse_object_lookup_by_uuid(&op->Key);
+                if (NULL == keyobj) {
+                    res->Status = EBADF;
+                    result      = EBADF;
+                    continue;
+                }
+            }
+
+            switch (op->Op) {
+                case FINESSE_COMPOUND_OP_MAP: {
+                    finesse_object_t *newobj = NULL;
+
+                    if (op->NameOffset >= names_size) {
+                        res->Status = EINVAL;
+                        break;
+                    }
+
+                    res->Status = CompoundMap(se, keyobj, &names[op->NameOffset], &newobj);
+                    if (0 != res->Status) {
+                        break;
+                    }
+
+                    // The new object replaces the current one
+                    CompoundUnmap(&finobj);
+                    finobj = newobj;
+                    FinessePrefillNoteOpen(finobj->inode, (int)op->Flags);
+                } break;
+
+                case FINESSE_COMPOUND_OP_GETATTR: {
+                    finesse_object_t *obj = (NULL != keyobj) ? keyobj : finobj;
+
+                    if (NULL == obj) {
+                        res->Status = EBADF;
+                        break;
+                    }
+
+                    res->Status = CompoundGetattr(se, obj->inode, &attr);
+                    have_attr   = (0 == res->Status);
+                } break;
+
+                case FINESSE_COMPOUND_OP_OPEN: {
+                    finesse_object_t *obj = (NULL != keyobj) ? keyobj : finobj;
+
+                    if (NULL == obj) {
+                        res->Status = EBADF;
+                        break;
+                    }
+
+                    if (is_open) {
+                        // one open at a time
+                        res->Status = EBUSY;
+                        break;
+                    }
+
+                    res->Status = CompoundOpen(se, obj->inode, (int)op->Flags, &open_fh);
+                    if (0 == res->Status) {
+                        open_ino   = obj->inode;
+                        open_flags = (int)op->Flags;
+                        is_open    = 1;
+                    }
+                } break;
+
+                case FINESSE_COMPOUND_OP_READ: {
+                    if (!is_open) {
+                        res->Status = EBADF;
+                        break;
+                    }
+
+                    length = FINESSE_COMPOUND_MAX_DATA - data_length;
+                    if ((0 != op->Length) && (op->Length < length)) {
+                        length = op->Length;
+                    }
+
+                    res->DataOffset = (uint32_t)data_length;
+                    res->Status     = CompoundRead(se, open_ino, open_fh, open_flags, (off_t)op->Offset, length,
+                                                   data + data_length, &length);
+                    res->Length     = (uint32_t)length;
+                    data_length += length;
+                } break;
+
+                case FINESSE_COMPOUND_OP_CLOSE: {
+                    if (!is_open) {
+                        res->Status = EBADF;
+                        break;
+                    }
+
+                    CompoundRelease(se, open_ino, open_fh, open_flags);
+                    is_open = 0;
+                } break;
+
+                case FINESSE_COMPOUND_OP_MAP_RELEASE: {
+                    if (NULL != keyobj) {
+                        // Drop the reference the client holds (ours goes below)
+                        (void)FinesseClientMapRelease(Client, &op->Key);
+                        break;
+                    }
+
+                    if (NULL == finobj) {
+                        res->Status = EBADF;
+                        break;
+                    }
+
+                    CompoundUnmap(&finobj);
+                } break;
+
+                default:
+                    res->Status = ENOTSUP;
+                    break;
+            }
+
+            if (NULL != keyobj) {
+                finesse_object_release(keyobj);
+                keyobj = NULL;
+            }
+
+            result = res->Status;
+        }
+
+        break;
+    }
+
+    // Nothing opened here survives the compound
+    if (is_open) {
+        CompoundRelease(se, open_ino, open_fh, open_flags);
+        is_open = 0;
+    }
+
+    if (0 != result) {
+        // Undo our map on failure
+        CompoundUnmap(&finobj);
+    }
+
+    if (NULL != finobj) {
+        // The client gets our reference along with the key
+        uuid_copy(key, finobj->uuid);
+        FinesseClientMapAdd(Client, finobj);
+    }
+
+    status = FinesseSendCompoundResponse(fsh, Client, Message, results, executed, NULL != finobj ? &key : NULL,
+                                         have_attr ? &attr : NULL, data, data_length, result);
+
+    if ((0 != status) && (NULL != finobj)) {
+        (void)FinesseClientMapRelease(Client, &key);
+    }
+
+    if (0 == status) {
+        FinesseCountNativeResponse(FINESSE_NATIVE_RSP_COMPOUND);
+    }
+
+    if (NULL != data) {
+        free(data);
+    }
+
+    if (NULL != names) {
+        free(names);
+    }
+
+    return 0;
+}
@@ -55,6 +55,17 @@ typedef struct finesse_lookup_info {
 
 typedef struct _FinesseServerPathResolutionParameters FinesseServerPathResolutionParameters_t;
 
+#define FINESSE_SERVER_PATH_RESOLUTION_FOLLOW_SYMLINKS (0x1)
+#define FINESSE_SERVER_PATH_RESOLUTION_CHECK_SECURITY (0x2)
+#define FINESSE_SERVER_PATH_RESOLUTION_GET_FINAL_PARENT (0x4)
+#define FINESSE_SERVER_PATH_RESOLUTION_VALID_FLAGS                                                    \
+    (FINESSE_SERVER_PATH_RESOLUTION_FOLLOW_SYMLINKS | FINESSE_SERVER_PATH_RESOLUTION_CHECK_SECURITY | \
+     FINESSE_SERVER_PATH_RESOLUTION_GET_FINAL_PARENT)
+
+// Requests the server makes of the file system on its own behalf (finesse/server/util.c)
+struct fuse_req *FinesseAllocInternalRequest(struct fuse_session *se, int Opcode);
+int              FinesseInternalReplyStatus(struct fuse_req *Request, size_t ArgSize);
+
 int FinesseServerInternalMapRequest(struct fuse_session *se, ino_t ParentInode, uuid_t *ParentUuid, const char *Name, int Flags,
                                     finesse_object_t **Finobj);
 int FinesseServerInternalNameLookup(struct fuse_session *se, fuse_ino_t Parent, const char *Name, struct statx *attr);
@@ -65,6 +76,72 @@ void FinesseFreeServerPathResolutionParameters(FinesseServerPathResolutionParame
 int  FinesseGetResolvedStatx(FinesseServerPathResolutionParameters_t *Parameters, struct statx *StatxData);
 int  FinesseGetResolvedInode(FinesseServerPathResolutionParameters_t *Parameters, ino_t *InodeNumber);
 
+// Returned by FinesseServerInternalWalk when the server cannot decide (a link out of the mount, a ".." above the walk)
+#define FINESSE_WALK_UNRESOLVED (-1)
+#define FINESSE_WALK_FOLLOW (0x1)  // follow a symlink at the end of the path too
+#define FINESSE_WALK_MAX_LINKS (40)  // as the kernel does; more gives ELOOP
+#define FINESSE_WALK_MAX_DEPTH (64)  // directories a walk can descend through
+int FinesseServerInternalWalk(struct fuse_session *se, fuse_ino_t Parent, const char *Path, int Flags, fuse_ino_t *Ino,
+                              uint32_t *Mode);
+
+// Negative lookup cache (finesse/server/negative.c)
+#define FINESSE_NEGATIVE_PATH_DEPTH (16)  // components a remembered path can go through
+
+typedef struct _finesse_negative_token {
+    uint32_t Slot;
+    uint32_t Generation;
+} finesse_negative_token_t;
+
+void FinesseNegativeSnapshot(fuse_ino_t Parent, const char *Name, size_t Length, finesse_negative_token_t *Token);
+int  FinesseNegativeLookup(fuse_ino_t Parent, const char *Name, size_t Length, finesse_negative_token_t *Token);
+void FinesseNegativeAdd(fuse_ino_t Parent, const char *Name, size_t Length, const finesse_negative_token_t *Token,
+                        const struct fuse_entry_out *Entry);
+void FinesseNegativeInvalidate(fuse_ino_t Parent, const char *Name, size_t Length);
+int  FinesseNegativeKeepInode(fuse_ino_t Ino);
+int  FinesseNegativeLookupPath(fuse_ino_t Base, const char *Path);
+void FinesseNegativeAddPath(fuse_ino_t Base, const char *Path, size_t Length, fuse_ino_t Parent,
+                            const finesse_negative_token_t *Tokens, unsigned Depth);
+
+// Name maps held by clients (finesse/server/clientmaps.c)
+void FinesseClientMapAdd(void *Client, finesse_object_t *Object);
+int  FinesseClientMapRelease(void *Client, uuid_t *Key);
+
+// Directory prefetch (finesse/server/prefetch.c)
+void FinessePrefetchSetClient(void *Client);
+int  FinessePrefetchLookup(fuse_ino_t Parent, const char *Name, size_t Length, struct fuse_entry_out *Entry);
+int  FinessePrefetchGetAttr(fuse_ino_t Ino, struct stat *Attr, double *Timeout);
+void FinessePrefetchInvalidate(fuse_ino_t Parent, const char *Name, size_t Length);
+void FinessePrefetchInvalidateInode(fuse_ino_t Ino);
+int  FinessePrefetchKeepInode(fuse_ino_t Ino);
+
+// Symbolic link cache (finesse/server/symlink.c)
+int  FinesseSymlinkRead(struct fuse_session *se, fuse_ino_t Parent, const char *Name, fuse_ino_t Ino, char *Buffer,
+                        size_t BufferSize);
+void FinesseSymlinkInvalidate(fuse_ino_t Ino);
+void FinesseSymlinkInvalidateEntry(fuse_ino_t Parent, const char *Name, size_t NameLength);
+int  FinesseSymlinkKeepInode(fuse_ino_t Ino);
+
+// The attributes a FUSE reply carries, as stat would return them
+VARIABLE_IS_NOT_USED static inline void FinesseFuseAttrToStat(const struct fuse_attr *Attr, struct stat *Stat)
+{
+    memset(Stat, 0, sizeof(struct stat));
+    Stat->st_ino          = Attr->ino;
+    Stat->st_mode         = Attr->mode;
+    Stat->st_nlink        = Attr->nlink;
+    Stat->st_uid          = Attr->uid;
+    Stat->st_gid          = Attr->gid;
+    Stat->st_rdev         = Attr->rdev;
+    Stat->st_size         = Attr->size;
+    Stat->st_blksize      = Attr->blksize;
+    Stat->st_blocks       = Attr->blocks;
+    Stat->st_atim.tv_sec  = Attr->atime;
+    Stat->st_atim.tv_nsec = Attr->atimensec;
+    Stat->st_mtim.tv_sec  = Attr->mtime;
+    Stat->st_mtim.tv_nsec = Attr->mtimensec;
+    Stat->st_ctim.tv_sec  = Attr->ctime;
+    Stat->st_ctim.tv_nsec = Attr->ctimensec;
+}
+
 extern FinesseServerStat *FinesseServerStats;
 
 VARIABLE_IS_NOT_USED static inline void FinesseCountNativeRequest(FINESSE_NATIVE_REQ_TYPE Type)
@@ -163,6 +163,7 @@ int FinesseServerHandleFuseRequest(struct fuse_session *se, void *Client, fincom
              finesse_request_type_to_string(fmsg->Message.Fuse.Request.Type));
 
     FinesseCountFuseRequest(fmsg->Message.Fuse.Request.Type);
+    FinessePrefetchSetClient(Client);  // directory locality is tracked per client
 
     // Now the big long switch statement
     switch (fmsg->Message.Fuse.Request.Type) {
@@ -182,17 +183,42 @@ int FinesseServerHandleFuseRequest(struct fuse_session *se, void *Client, fincom
             FinesseServerFuseUnlink(se, Client, Message);
             break;
 
-        case FINESSE_FUSE_REQ_LOOKUP:
-        case FINESSE_FUSE_REQ_FORGET:
-        case FINESSE_FUSE_REQ_GETATTR:
-        case FINESSE_FUSE_REQ_SETATTR:
-        case FINESSE_FUSE_REQ_READLINK:
-        case FINESSE_FUSE_REQ_MKNOD:
         case FINESSE_FUSE_REQ_MKDIR:
+            FinesseServerFuseMkdir(se, Client, Message);
+            break;
+
         case FINESSE_FUSE_REQ_RMDIR:
-        case FINESSE_FUSE_REQ_SYMLINK:
+            FinesseServerFuseRmdir(se, Client, Message);
+            break;
+
         case FINESSE_FUSE_REQ_RENAME:
+            FinesseServerFuseRename(se, Client, Message);
+            break;
+
         case FINESSE_FUSE_REQ_LINK:
+            FinesseServerFuseLink(se, Client, Message);
+            break;
+
+        case FINESSE_FUSE_REQ_SYMLINK:
+            FinesseServerFuseSymlink(se, Client, Message);
+            break;
+
+        case FINESSE_FUSE_REQ_CREATE:
+            FinesseServerFuseCreate(se, Client, Message);
+            break;
+
+        case FINESSE_FUSE_REQ_READLINK:
+            FinesseServerFuseReadlink(se, Client, Message);
+            break;
+
+        case FINESSE_FUSE_REQ_SETATTR:
+            FinesseServerFuseSetattr(se, Client, Message);
+            break;
+
+        case FINESSE_FUSE_REQ_LOOKUP:
+        case FINESSE_FUSE_REQ_FORGET:
+        case FINESSE_FUSE_REQ_GETATTR:
+        case FINESSE_FUSE_REQ_MKNOD:
         case FINESSE_FUSE_REQ_OPEN:
         case FINESSE_FUSE_REQ_READ:
         case FINESSE_FUSE_REQ_WRITE:
@@ -207,7 +233,6 @@ int FinesseServerHandleFuseRequest(struct fuse_session *se, void *Client, fincom
         case FINESSE_FUSE_REQ_GETXATTR:
         case FINESSE_FUSE_REQ_LISTXATTR:
         case FINESSE_FUSE_REQ_REMOVEXATTR:
-        case FINESSE_FUSE_REQ_CREATE:
         case FINESSE_FUSE_REQ_GETLK:
         case FINESSE_FUSE_REQ_SETLK:
         case FINESSE_FUSE_REQ_BMAP:
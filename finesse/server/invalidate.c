@@ -0,0 +1,89 @@
+/*
+  Copyright (C) 2020  Tony Mason <fsgeek@cs.ubc.ca>
+*/
+#include "fs-internal.h"
+
+//
+// Invalidations: tell the clients (through the ring in each one's shared memory region) that
+// something they might have cached from us has changed.  These are called when an operation
+// that changes something completes (see lib/finesse.c), when we do one ourselves, and when the
+// file system itself calls fuse_lowlevel_notify_inval_inode/_entry or fuse_lowlevel_notify_delete.
+// Our own caches (negative.c, prefetch.c) have to be told too, clients or not.
+//
+
+static void SetKey(fuse_ino_t Inode, uuid_t Key)
+{
+    finesse_object_t *finobj = NULL;
+
+    uuid_clear(Key);
+
+    if (0 == Inode) {
+        return;
+    }
+
+    finobj = finesse_object_lookup_by_ino(Inode);
+    if (NULL != finobj) {
+        uuid_copy(Key, finobj->uuid);
+        finesse_object_release(finobj);
+    }
+}
+
+static void PostInvalidation(struct fuse_session *se, FINESSE_INVALIDATION_TYPE Type, fuse_ino_t Inode, fuse_ino_t Parent,
+                             const char *Name, size_t NameLength)
+{
+    finesse_invalidation_t  invalidation;
+    finesse_server_handle_t fsh;
+
+    if ((NULL == se) || (NULL == se->server_handle)) {
+        return;
+    }
+
+    fsh = (finesse_server_handle_t)se->server_handle;
+    if (0 == FinesseGetActiveClientCount(fsh)) {
+        return;  // nobody to tell
+    }
+
+    memset(&invalidation, 0, sizeof(invalidation));
+    invalidation.Type   = Type;
+    invalidation.Inode  = Inode;
+    invalidation.Parent = Parent;
+    SetKey(Inode, invalidation.Key);
+    SetKey(Parent, invalidation.ParentKey);
+
+    if (NULL != Name) {
+        // A name too long for the event is still reported (by its length), the client just can't tell which one it was
+        invalidation.NameLength = NameLength > UINT16_MAX ? UINT16_MAX : (uint16_t)NameLength;
+        memcpy(invalidation.Name, Name, NameLength < sizeof(invalidation.Name) ? NameLength : sizeof(invalidation.Name));
+    }
+
+    FinesseSendInvalidation(fsh, &invalidation);
+}
+
+void FinesseServerInvalidateInode(struct fuse_session *se, fuse_ino_t Inode)
+{
+    FinessePrefetchInvalidateInode(Inode);
+    PostInvalidation(se, FINESSE_INVALIDATE_INODE, Inode, 0, NULL, 0);
+}
+
+void FinesseServerInvalidateEntry(struct fuse_session *se, fuse_ino_t Parent, const char *Name, size_t NameLength)
+{
+    FinesseNegativeInvalidate(Parent, Name, NameLength);
+    FinessePrefetchInvalidate(Parent, Name, NameLength);
+    FinesseSymlinkInvalidateEntry(Parent, Name, NameLength);  // a rename may have replaced it
+    PostInvalidation(se, FINESSE_INVALIDATE_ENTRY, 0, Parent, Name, NameLength);
+}
+
+// Child is 0 if we don't know what the name referred to
+void FinesseServerNotifyDelete(struct fuse_session *se, fuse_ino_t Parent, fuse_ino_t Child, const char *Name, size_t NameLength)
+{
+    FinesseNegativeInvalidate(Parent, Name, NameLength);
+    FinessePrefetchInvalidate(Parent, Name, NameLength);
+    if (0 != Child) {
+        FinessePrefetchInvalidateInode(Child);  // its link count
+        FinesseSymlinkInvalidate(Child);
+    }
+    else {
+        FinesseSymlinkInvalidateEntry(Parent, Name, NameLength);
+    }
+    PostInvalidation(se, FINESSE_INVALIDATE_DELETE, Child, Parent, Name, NameLength);
+}
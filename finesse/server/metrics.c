@@ -0,0 +1,309 @@
+/*
+  Copyright (C) 2020  Tony Mason <fsgeek@cs.ubc.ca>
+*/
+#include "fs-internal.h"
+#include "finesse-metrics.h"
+
+//
+// Publisher for the live metrics page (see finesse-metrics.h).
+//
+// Everything the page shows is gathered by a single publisher thread every
+// IntervalMs; the request path only records its latency into per-thread
+// shards, so watching the server costs nothing on the data path.
+//
+typedef struct _finesse_metrics_registered_counter {
+    char                               Name[FINESSE_METRICS_COUNTER_NAME_LENGTH];
+    finesse_metrics_counter_callback_t Callback;
+    void *                             Context;
+} finesse_metrics_registered_counter_t;
+
+static struct {
+    pthread_mutex_t                      Lock;
+    pthread_cond_t                       Cond;
+    int                                  Initialized;
+    int                                  Shutdown;
+    int                                  Running;
+    pthread_t                            Thread;
+    finesse_server_handle_t              ServerHandle;
+    finesse_metrics_page_t *             Page;
+    char                                 Name[MAX_SHM_PATH_NAME];
+    unsigned                             IntervalMs;
+    unsigned                             CounterCount;
+    finesse_metrics_registered_counter_t Counters[FINESSE_METRICS_MAX_COUNTERS];
+} FinesseMetrics = {
+    .Lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static finesse_callshard_set_t FinesseMetricsLatency = FINESSE_CALLSHARD_SET_INITIALIZER(FINESSE_METRICS_REQUEST_TYPES, 1);
+
+void FinesseMetricsRecordRequest(unsigned RequestType, const struct timespec *Elapsed)
+{
+    if (RequestType < FINESSE_METRICS_REQUEST_TYPES) {
+        FinesseCallShardRecord(&FinesseMetricsLatency, RequestType, 0, Elapsed);
+    }
+}
+
+int FinesseMetricsRegisterCounter(const char *Name, finesse_metrics_counter_callback_t Callback, void *Context)
+{
+    finesse_metrics_registered_counter_t *counter = NULL;
+    int                                   status  = 0;
+
+    assert(NULL != Name);
+    assert(NULL != Callback);
+
+    pthread_mutex_lock(&FinesseMetrics.Lock);
+    if (FinesseMetrics.CounterCount < FINESSE_METRICS_MAX_COUNTERS) {
+        counter = &FinesseMetrics.Counters[FinesseMetrics.CounterCount];
+        strncpy(counter->Name, Name, sizeof(counter->Name) - 1);
+        counter->Name[sizeof(counter->Name) - 1] = '\0';
+        counter->Callback                        = Callback;
+        counter->Context                         = Context;
+        FinesseMetrics.CounterCount++;
+    }
+    else {
+        status = ENOSPC;
+    }
+    pthread_mutex_unlock(&FinesseMetrics.Lock);
+
+    return status;
+}
+
+//
+// Remove the counter(s) registered with this callback and context.  Callbacks
+// are only invoked with the lock held, so once this returns the callback will
+// not be called again.
+//
+void FinesseMetricsUnregisterCounter(finesse_metrics_counter_callback_t Callback, void *Context)
+{
+    unsigned index = 0;
+
+    pthread_mutex_lock(&FinesseMetrics.Lock);
+    while (index < FinesseMetrics.CounterCount) {
+        if ((Callback == FinesseMetrics.Counters[index].Callback) && (Context == FinesseMetrics.Counters[index].Context)) {
+            FinesseMetrics.CounterCount--;
+            memmove(&FinesseMetrics.Counters[index], &FinesseMetrics.Counters[index + 1],
+                    (FinesseMetrics.CounterCount - index) * sizeof(finesse_metrics_registered_counter_t));
+            continue;
+        }
+        index++;
+    }
+    pthread_mutex_unlock(&FinesseMetrics.Lock);
+}
+
+static uint64_t FinesseMetricsNameMapLookups(void *Context)
+{
+    uint64_t lookups = 0;
+    uint64_t hits    = 0;
+
+    (void)Context;
+    finesse_object_get_table_statistics(&lookups, &hits);
+
+    return lookups;
+}
+
+static uint64_t FinesseMetricsNameMapHits(void *Context)
+{
+    uint64_t lookups = 0;
+    uint64_t hits    = 0;
+
+    (void)Context;
+    finesse_object_get_table_statistics(&lookups, &hits);
+
+    return hits;
+}
+
+static void FinesseMetricsPublish(void)
+{
+    finesse_metrics_page_t *page     = FinesseMetrics.Page;
+    uint64_t                sequence = page->Sequence;
+    unsigned                clients  = 0;
+    unsigned                counters = 0;
+
+    // Begin the update (odd sequence) before touching anything else.
+    __atomic_store_n(&page->Sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    clock_gettime(CLOCK_MONOTONIC, &page->UpdateTime);
+    page->Updates++;
+
+    memcpy(&page->ServerStat, FinesseServerStats, sizeof(FinesseServerStat));
+    page->ServerStat.ClientConnectionCount = FinesseGetActiveClientCount(FinesseMetrics.ServerHandle);
+    page->ServerStat.ActiveNameMaps        = finesse_object_get_table_size();
+
+    for (unsigned index = 0; index < SHM_MESSAGE_COUNT; index++) {
+        finesse_metrics_client_t *client = &page->Clients[index];
+
+        if (0 == FinesseGetClientQueueStatistics(FinesseMetrics.ServerHandle, index, &client->QueueDepth, &client->InFlight,
+                                                 &client->Requests)) {
+            client->Connected = 1;
+            clients++;
+        }
+        else {
+            memset(client, 0, sizeof(finesse_metrics_client_t));
+        }
+    }
+    page->ClientCount = clients;
+
+    pthread_mutex_lock(&FinesseMetrics.Lock);
+    counters = FinesseMetrics.CounterCount;
+    for (unsigned index = 0; index < counters; index++) {
+        memcpy(page->Counters[index].Name, FinesseMetrics.Counters[index].Name, sizeof(page->Counters[index].Name));
+        page->Counters[index].Value = FinesseMetrics.Counters[index].Callback(FinesseMetrics.Counters[index].Context);
+    }
+    pthread_mutex_unlock(&FinesseMetrics.Lock);
+    page->CounterCount = counters;
+
+    for (unsigned index = 0; index < FINESSE_METRICS_REQUEST_TYPES; index++) {
+        FinesseCallShardHistogram(&FinesseMetricsLatency, index, 0, page->RequestLatency[index]);
+    }
+
+    // Done (even sequence)
+    __atomic_store_n(&page->Sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+static void *FinesseMetricsWorker(void *Context)
+{
+    struct timespec deadline;
+
+    (void)Context;
+
+    pthread_mutex_lock(&FinesseMetrics.Lock);
+    while (0 == FinesseMetrics.Shutdown) {
+        pthread_mutex_unlock(&FinesseMetrics.Lock);
+        FinesseMetricsPublish();
+        pthread_mutex_lock(&FinesseMetrics.Lock);
+
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_nsec += (long)FinesseMetrics.IntervalMs * 1000000;
+        while (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+
+        while ((0 == FinesseMetrics.Shutdown) &&
+               (ETIMEDOUT != pthread_cond_timedwait(&FinesseMetrics.Cond, &FinesseMetrics.Lock, &deadline))) {
+            // spurious wakeup (or shutdown)
+        }
+    }
+    pthread_mutex_unlock(&FinesseMetrics.Lock);
+
+    return NULL;
+}
+
+//
+// Create the metrics page for the given mount point and start publishing to
+// it.  The interval can be set (in ms) with FINESSE_METRICS_INTERVAL; 0
+// disables the page entirely.
+//
+int FinesseMetricsStart(finesse_server_handle_t ServerHandle, const char *MountPoint)
+{
+    pthread_condattr_t condattr;
+    const char *       interval = getenv(FINESSE_METRICS_INTERVAL_ENV);
+    void *             map      = MAP_FAILED;
+    int                fd       = -1;
+    int                status   = 0;
+
+    assert(NULL != ServerHandle);
+    assert(NULL != MountPoint);
+    assert(0 == FinesseMetrics.Running);
+
+    FinesseMetrics.IntervalMs = FINESSE_METRICS_DEFAULT_INTERVAL_MS;
+    if (NULL != interval) {
+        FinesseMetrics.IntervalMs = (unsigned)strtoul(interval, NULL, 0);
+    }
+
+    if (0 == FinesseMetrics.IntervalMs) {
+        return 0;  // disabled
+    }
+
+    while (MAP_FAILED == map) {
+        status = FinesseMetricsGenerateName(MountPoint, FinesseMetrics.Name, sizeof(FinesseMetrics.Name));
+        if (0 != status) {
+            break;
+        }
+
+        fd = shm_open(FinesseMetrics.Name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            status = errno;
+            break;
+        }
+
+        if (0 != ftruncate(fd, sizeof(finesse_metrics_page_t))) {
+            status = errno;
+            break;
+        }
+
+        map = mmap(NULL, sizeof(finesse_metrics_page_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (MAP_FAILED == map) {
+            status = errno;
+            break;
+        }
+    }
+
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+
+    if (0 != status) {
+        fuse_log(FUSE_LOG_ERR, "FINESSE %s: unable to create metrics page for %s (%d - %s)\n", __func__, MountPoint, status,
+                 strerror(status));
+        if (MAP_FAILED != map) {
+            munmap(map, sizeof(finesse_metrics_page_t));
+        }
+        shm_unlink(FinesseMetrics.Name);
+        return status;
+    }
+
+    FinesseMetrics.Page         = (finesse_metrics_page_t *)map;
+    FinesseMetrics.ServerHandle = ServerHandle;
+    FinesseMetrics.Shutdown     = 0;
+
+    memset(FinesseMetrics.Page, 0, sizeof(finesse_metrics_page_t));
+    FinesseMetrics.Page->Version    = FINESSE_METRICS_VERSION;
+    FinesseMetrics.Page->Length     = sizeof(finesse_metrics_page_t);
+    FinesseMetrics.Page->ServerPid  = getpid();
+    FinesseMetrics.Page->IntervalMs = FinesseMetrics.IntervalMs;
+    strncpy(FinesseMetrics.Page->MountPoint, MountPoint, sizeof(FinesseMetrics.Page->MountPoint) - 1);
+    // Readers check the magic number, so it goes in last.
+    __atomic_store_n(&FinesseMetrics.Page->Magic, FINESSE_METRICS_MAGIC, __ATOMIC_RELEASE);
+
+    if (0 == FinesseMetrics.Initialized) {
+        pthread_condattr_init(&condattr);
+        pthread_condattr_setclock(&condattr, CLOCK_MONOTONIC);
+        pthread_cond_init(&FinesseMetrics.Cond, &condattr);
+        pthread_condattr_destroy(&condattr);
+        FinesseMetricsRegisterCounter("finesse name map lookups", FinesseMetricsNameMapLookups, NULL);
+        FinesseMetricsRegisterCounter("finesse name map hits", FinesseMetricsNameMapHits, NULL);
+        FinesseMetrics.Initialized = 1;
+    }
+
+    status = pthread_create(&FinesseMetrics.Thread, NULL, FinesseMetricsWorker, NULL);
+    assert(0 == status);
+    FinesseMetrics.Running = 1;
+
+    fuse_log(FUSE_LOG_INFO, "FINESSE %s: publishing metrics for %s in %s every %u ms\n", __func__, MountPoint,
+             FinesseMetrics.Name, FinesseMetrics.IntervalMs);
+
+    return 0;
+}
+
+void FinesseMetricsStop(void)
+{
+    if (0 == FinesseMetrics.Running) {
+        return;
+    }
+
+    pthread_mutex_lock(&FinesseMetrics.Lock);
+    FinesseMetrics.Shutdown = 1;
+    pthread_cond_broadcast(&FinesseMetrics.Cond);
+    pthread_mutex_unlock(&FinesseMetrics.Lock);
+
+    pthread_join(FinesseMetrics.Thread, NULL);
+    FinesseMetrics.Running = 0;
+
+    munmap(FinesseMetrics.Page, sizeof(finesse_metrics_page_t));
+    FinesseMetrics.Page         = NULL;
+    FinesseMetrics.ServerHandle = NULL;
+    shm_unlink(FinesseMetrics.Name);
+}
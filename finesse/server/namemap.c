@@ -3,26 +3,62 @@
 */
 #include "fs-internal.h"
 
+static void NameLookupFillStatx(const struct fuse_entry_out *Entry, struct statx *Attr)
+{
+    Attr->stx_mask       = 0;
+    Attr->stx_blksize    = Entry->attr.blksize;
+    Attr->stx_attributes = 0;
+    Attr->stx_nlink      = Entry->attr.nlink;
+    Attr->stx_uid        = Entry->attr.uid;
+    Attr->stx_gid        = Entry->attr.gid;
+    Attr->stx_mode       = Entry->attr.mode;
+    Attr->stx_ino        = Entry->nodeid;
+    assert(Entry->nodeid == Entry->attr.ino);
+    Attr->stx_size            = Entry->attr.size;
+    Attr->stx_blocks          = Entry->attr.blocks;
+    Attr->stx_attributes_mask = STATX_BASIC_STATS;  // everything except "btime"
+    Attr->stx_atime.tv_sec    = Entry->attr.atime;
+    Attr->stx_atime.tv_nsec   = Entry->attr.atimensec;
+    // TODO: would be great to get the creation time back
+    Attr->stx_ctime.tv_sec  = Entry->attr.ctime;
+    Attr->stx_ctime.tv_nsec = Entry->attr.ctimensec;
+    Attr->stx_mtime.tv_sec  = Entry->attr.mtime;
+    Attr->stx_mtime.tv_nsec = Entry->attr.mtimensec;
+}
+
 //
 // We have to do this name lookup trick in multiple places.  This part of the logic
 // just maps the name to the corresponding fuse_ino_t.  The caller may just use it
 // or could keep it.  Note that the caller must release it at some point!
 //
-// Note: we should not call this with a path name.
+// Note: we should not call this with a path name.  Names known not to exist (see negative.c)
+// come back ENOENT without asking the file system, and names read ahead with the rest of
+// their directory (see prefetch.c) come back without asking it either.
 //
 int FinesseServerInternalNameLookup(struct fuse_session *se, fuse_ino_t Parent, const char *Name, struct statx *attr)
 {
-    struct fuse_req *       fuse_request    = NULL;
-    struct finesse_req *    finesse_request = NULL;
-    int                     status          = 0;
-    struct fuse_out_header *out             = NULL;
-    struct fuse_entry_out * arg             = NULL;
+    struct fuse_req *        fuse_request    = NULL;
+    struct finesse_req *     finesse_request = NULL;
+    int                      status          = 0;
+    struct fuse_out_header * out             = NULL;
+    struct fuse_entry_out *  arg             = NULL;
+    finesse_negative_token_t token;
+    struct fuse_entry_out    entry;
 
     assert(NULL != attr);
     memset(attr, 0, sizeof(struct statx));
     assert(NULL != Name);
     assert(NULL == index(Name, '/'));  // we no longer support path names - use the PathMap version!
 
+    if (FinesseNegativeLookup(Parent, Name, strlen(Name), &token)) {
+        return ENOENT;
+    }
+
+    if (FinessePrefetchLookup(Parent, Name, strlen(Name), &entry)) {
+        NameLookupFillStatx(&entry, attr);
+        return 0;
+    }
+
     // We need to do a lookup here - allocate a request structure
     fuse_request    = FinesseAllocFuseRequest(se);
     finesse_request = (struct finesse_req *)fuse_request;
@@ -51,27 +87,16 @@ int FinesseServerInternalNameLookup(struct fuse_session *se, fuse_ino_t Parent,
             break;
         }
 
-        arg                  = finesse_request->iov[1].iov_base;
-        attr->stx_mask       = 0;
-        attr->stx_blksize    = arg->attr.blksize;
-        attr->stx_attributes = 0;
-        attr->stx_nlink      = arg->attr.nlink;
-        attr->stx_uid        = arg->attr.uid;
-        attr->stx_gid        = arg->attr.gid;
-        attr->stx_mode       = arg->attr.mode;
-        attr->stx_ino        = arg->nodeid;
-        assert(arg->nodeid == arg->attr.ino);
-        attr->stx_size            = arg->attr.size;
-        attr->stx_blocks          = arg->attr.blocks;
-        attr->stx_attributes_mask = STATX_BASIC_STATS;  // everything except "btime"
-        attr->stx_atime.tv_sec    = arg->attr.atime;
-        attr->stx_atime.tv_nsec   = arg->attr.atimensec;
-        // TODO: would be great to get the creation time back
-        attr->stx_ctime.tv_sec  = arg->attr.ctime;
-        attr->stx_ctime.tv_nsec = arg->attr.ctimensec;
-        attr->stx_mtime.tv_sec  = arg->attr.mtime;
-        attr->stx_mtime.tv_nsec = arg->attr.mtimensec;
-        status                  = 0;
+        arg = finesse_request->iov[1].iov_base;
+        if (0 == arg->nodeid) {
+            // negative entry
+            FinesseNegativeAdd(Parent, Name, strlen(Name), &token, arg);
+            status = ENOENT;
+            break;
+        }
+
+        NameLookupFillStatx(arg, attr);
+        status = 0;
         break;
     }
 
@@ -126,8 +151,8 @@ static int FinsesseServerInternalPathMapRequest(struct fuse_session *se, ino_t P
     //
     // O_NOCTTY really does seem to be something we care about on the client, not the server.
     //
-    // O_NOFOLLOw IS something we want to handle, since it affects the way we process symlinks; do we want to do that
-    // server side, or client side?
+    // O_NOFOLLOW affects the way we process symlinks: with it we map a final symlink itself rather than
+    // what it points to (the client's open then fails with ELOOP, as it should).
     //
     // O_TRUNC relates to existing files; we could handle that server side.
     //
@@ -161,7 +186,9 @@ static int FinsesseServerInternalPathMapRequest(struct fuse_session *se, ino_t P
 
         assert(0 != ParentInode);  // sanity - shouldn't be able to get here.
 
-        parameters = FinesseAllocateServerPathResolutionParameters(ParentInode, Name, Flags);
+        // Flags are the open flags; all that matters to the walk is whether to follow a final symlink
+        parameters = FinesseAllocateServerPathResolutionParameters(
+            ParentInode, Name, (Flags & O_NOFOLLOW) ? 0 : FINESSE_SERVER_PATH_RESOLUTION_FOLLOW_SYMLINKS);
         assert(NULL != parameters);
 
         status = FinesseServerResolvePathName(se, parameters);
@@ -187,6 +214,12 @@ static int FinsesseServerInternalPathMapRequest(struct fuse_session *se, ino_t P
         assert(0 != (*Finobj)->inode);
         if (0 == uuid_compare((*Finobj)->uuid, uuid)) {
             created_finobj = 1;
+            // The new object owns the walk's lookup; it is given back when the object is freed
+            (*Finobj)->lookup = (ino != ParentInode);
+        }
+        else if (ino != ParentInode) {
+            // The object already holds a lookup on this inode; we don't need the walk's
+            FinesseReleaseInode(se, ino);
         }
 
         status = 0;
@@ -282,6 +315,8 @@ static int FinesseServerInternalNameMapRequest(struct fuse_session *se, ino_t Pa
         if (0 == uuid_compare(uuid, (*Finobj)->uuid)) {
             created_finobj = 1;
             assert((*Finobj)->inode == ino);
+            // The new object owns the lookup; it is given back when the object is freed
+            (*Finobj)->lookup = 1;
         }
         else {
             struct finesse_req *finesse_request = (struct finesse_req *)fuse_request;
@@ -353,6 +388,7 @@ int FinesseServerNativeMapRequest(struct fuse_session *se, void *Client, fincomm
     finesse_msg *           fmsg   = (finesse_msg *)Message->Data;
     int                     status = 0;
     finesse_object_t *      finobj = NULL;
+    uuid_t                  key;
 
     fsh = (finesse_server_handle_t)se->server_handle;
 
@@ -372,8 +408,18 @@ int FinesseServerNativeMapRequest(struct fuse_session *se, void *Client, fincomm
 
     if (0 == status) {
         assert(NULL != finobj);  // that wouldn't make sense
-        status = FinesseSendNameMapResponse(fsh, Client, Message, &finobj->uuid, 0);
+        FinessePrefillNoteOpen(finobj->inode, fmsg->Message.Native.Request.Parameters.Map.Flags);
+        uuid_copy(key, finobj->uuid);
+
+        // Our reference is now the client's (it goes away with the client if not released)
+        FinesseClientMapAdd(Client, finobj);
         finobj = NULL;
+
+        status = FinesseSendNameMapResponse(fsh, Client, Message, &key, 0);
+        if (0 != status) {
+            // Nobody to hand it to
+            (void)FinesseClientMapRelease(Client, &key);
+        }
     }
     else {
         assert(NULL == finobj);
@@ -390,15 +436,12 @@ int FinesseServerNativeMapRequest(struct fuse_session *se, void *Client, fincomm
 
 int FinesseServerNativeMapReleaseRequest(finesse_server_handle_t Fsh, void *Client, fincomm_message Message)
 {
-    finesse_object_t *object = NULL;
-    finesse_msg *     fmsg   = (finesse_msg *)Message->Data;
-    int               status = 0;
-
-    object = finesse_object_lookup_by_uuid(&fmsg->Message.Native.Request.Parameters.MapRelease.Key);
-    if (NULL != object) {
-        // TODO: need to add a FUSE release for the original lookup
-        finesse_object_release(object);
-    }
+    finesse_msg *fmsg   = (finesse_msg *)Message->Data;
+    int          status = 0;
+
+    // Drops the reference the client was given with the map (if it has one)
+    // TODO: need to add a FUSE release for the original lookup
+    (void)FinesseClientMapRelease(Client, &fmsg->Message.Native.Request.Parameters.MapRelease.Key);
 
     if (NULL != Fsh) {
         status = FinesseSendNameMapReleaseResponse(Fsh, Client, Message, 0);
@@ -0,0 +1,728 @@
+/*
+  Copyright (C) 2020  Tony Mason <fsgeek@cs.ubc.ca>
+*/
+#include "fs-internal.h"
+
+//
+// The metadata operations that change the name space (mkdir, rmdir, rename, link, symlink and
+// create) plus readlink and setattr.  Each names its object by a Parent key and a name relative
+// to it or (with a null Parent) by an absolute path inside our mount.  The names are walked with
+// FinesseServerInternalWalk, so anything it can't decide (a symlink out of our mount, a ".."
+// above the name's base) or a name we don't want to second guess ("." and friends, a trailing "/") is answered with
+// ENOTSUP and the client does the call itself.
+//
+// When a change succeeds we tell the kernel (so its dentry and attribute caches don't keep
+// stale or negative entries for something it never saw change) and, through the same
+// notifications, the other Finesse clients.
+//
+
+typedef struct {
+    finesse_object_t *finobj;  // the Parent the client named, if any
+    fuse_ino_t        base;    // what the name is relative to
+    fuse_ino_t        ino;     // the directory holding name, or the object itself
+    uint32_t          mode;    // of ino
+    char              name[NAME_MAX + 1];
+} namespace_target_t;
+
+//
+// The names are in the client's message.  Copy them out (so they can't change under us) and
+// check that each of the Count names starting at Names is terminated within the request, as
+// path search does.  On success the caller frees *Copy.
+//
+static int NamespaceCopyNames(struct fuse_session *se, void *Client, fincomm_message Message, const char *Names, unsigned Count,
+                              char **Copy)
+{
+    size_t offset = (size_t)(Names - (const char *)Message->Data);
+    size_t size   = FinesseGetRequestDataLength((finesse_server_handle_t)se->server_handle, Client, Message);
+    size_t length = 0;
+
+    *Copy = NULL;
+
+    if (offset >= size) {
+        return EINVAL;
+    }
+    size -= offset;
+
+    *Copy = malloc(size);
+    if (NULL == *Copy) {
+        return ENOMEM;
+    }
+    memcpy(*Copy, Names, size);
+
+    for (unsigned index = 0; index < Count; index++) {
+        length += strnlen(*Copy + length, size - length);
+        if (length >= size) {
+            // not terminated within the message
+            free(*Copy);
+            *Copy = NULL;
+            return EINVAL;
+        }
+        length++;
+    }
+
+    return 0;
+}
+
+//
+// The file system hands back a lookup on anything it makes; we don't keep it.
+//
+static void NamespaceForgetEntry(struct fuse_session *se, struct fuse_req *Request)
+{
+    struct fuse_entry_out *arg = ((struct finesse_req *)Request)->iov[1].iov_base;
+
+    if (0 != arg->nodeid) {
+        FinesseReleaseInode(se, arg->nodeid);
+    }
+}
+
+static void NamespaceRelease(struct fuse_session *se, namespace_target_t *Target)
+{
+    if ((0 != Target->ino) && (Target->ino != Target->base)) {
+        FinesseReleaseInode(se, Target->ino);
+    }
+    Target->ino = 0;
+
+    if (NULL != Target->finobj) {
+        finesse_object_release(Target->finobj);
+        Target->finobj = NULL;
+    }
+}
+
+static int NamespaceBase(struct fuse_session *se, uuid_t Parent, const char **Name, namespace_target_t *Target)
+{
+    size_t mp_length = strlen(se->mountpoint);
+
+    memset(Target, 0, sizeof(namespace_target_t));
+
+    if (uuid_is_null(Parent)) {
+        if ((0 != strncmp(*Name, se->mountpoint, mp_length)) || (('/' != (*Name)[mp_length]) && ('\0' != (*Name)[mp_length]))) {
+            return ENOTSUP;
+        }
+        *Name += mp_length;
+        Target->base = FUSE_ROOT_ID;
+        return 0;
+    }
+
+    Target->finobj = finesse_object_lookup_by_uuid((uuid_t *)Parent);
+    if (NULL == Target->finobj) {
+        return EBADF;
+    }
+    Target->base = Target->finobj->inode;
+
+    return 0;
+}
+
+static int NamespaceWalkStatus(struct fuse_session *se, namespace_target_t *Target, int Status)
+{
+    if (FINESSE_WALK_UNRESOLVED == Status) {
+        // The client can follow the link (or "..") itself
+        Status = ENOTSUP;
+    }
+
+    if (0 != Status) {
+        NamespaceRelease(se, Target);
+    }
+
+    return Status;
+}
+
+//
+// Resolve Name to the directory it is in (Target->ino) and its last component (Target->name).
+//
+static int NamespaceResolveParent(struct fuse_session *se, uuid_t Parent, const char *Name, namespace_target_t *Target)
+{
+    const char *leaf;
+    char *      path;
+    size_t      length;
+    int         status;
+
+    status = NamespaceBase(se, Parent, &Name, Target);
+    if (0 != status) {
+        return NamespaceWalkStatus(se, Target, status);
+    }
+
+    length = strlen(Name);
+    leaf   = rindex(Name, '/');
+    leaf   = (NULL == leaf) ? Name : leaf + 1;
+
+    if (('\0' == *leaf) || (0 == strcmp(leaf, ".")) || (0 == strcmp(leaf, ".."))) {
+        return NamespaceWalkStatus(se, Target, ENOTSUP);
+    }
+
+    if (strlen(leaf) > NAME_MAX) {
+        return NamespaceWalkStatus(se, Target, ENAMETOOLONG);
+    }
+    strcpy(Target->name, leaf);
+
+    path = strndup(Name, length - strlen(leaf));
+    if (NULL == path) {
+        return NamespaceWalkStatus(se, Target, ENOMEM);
+    }
+
+    status = FinesseServerInternalWalk(se, Target->base, path, FINESSE_WALK_FOLLOW, &Target->ino, &Target->mode);
+    free(path);
+
+    if ((0 == status) && !S_ISDIR(Target->mode)) {
+        status = ENOTDIR;
+    }
+
+    return NamespaceWalkStatus(se, Target, status);
+}
+
+//
+// Resolve Name to the object itself (Target->ino), without following a final symlink.
+//
+static int NamespaceResolveObject(struct fuse_session *se, uuid_t Parent, const char *Name, namespace_target_t *Target)
+{
+    int status;
+
+    status = NamespaceBase(se, Parent, &Name, Target);
+    if (0 == status) {
+        status = FinesseServerInternalWalk(se, Target->base, Name, 0, &Target->ino, &Target->mode);
+    }
+
+    return NamespaceWalkStatus(se, Target, status);
+}
+
+//
+// Dir's contents changed: Name was added (or replaced) or, if Deleted, removed.
+//
+static void NamespaceNotify(struct fuse_session *se, fuse_ino_t Dir, const char *Name, int Deleted)
+{
+    fuse_lowlevel_notify_inval_inode(se, Dir, 0, 0);
+
+    if (Deleted) {
+        fuse_lowlevel_notify_delete(se, Dir, 0, Name, strlen(Name));
+    }
+    else {
+        fuse_lowlevel_notify_inval_entry(se, Dir, Name, strlen(Name));
+    }
+}
+
+static void NamespaceSendResult(struct fuse_session *se, void *Client, fincomm_message Message, int Result)
+{
+    int status;
+
+    status = FinesseSendNamespaceResponse((finesse_server_handle_t)se->server_handle, Client, Message, Result);
+    assert(0 == status);
+    FinesseCountFuseResponse(FINESSE_FUSE_RSP_ERR);
+}
+
+static int Mkdir(struct fuse_session *se, void *Client, fincomm_message Message)
+{
+    finesse_msg *      fmsg         = (finesse_msg *)Message->Data;
+    struct fuse_req *  fuse_request = NULL;
+    namespace_target_t target;
+    char *             name = NULL;
+    int                result;
+
+    memset(&target, 0, sizeof(target));
+
+    while (1) {
+        if (NULL == finesse_original_ops->mkdir) {
+            result = ENOTSUP;
+            break;
+        }
+
+        result = NamespaceCopyNames(se, Client, Message, fmsg->Message.Fuse.Request.Parameters.Mkdir.Name, 1, &name);
+        if (0 != result) {
+            break;
+        }
+
+        result = NamespaceResolveParent(se, fmsg->Message.Fuse.Request.Parameters.Mkdir.Parent, name, &target);
+        if (0 != result) {
+            break;
+        }
+
+        fuse_request = FinesseAllocInternalRequest(se, FUSE_MKDIR);
+        if (NULL == fuse_request) {
+            result = ENOMEM;
+            break;
+        }
+
+        finesse_original_ops->mkdir(fuse_request, target.ino, target.name, fmsg->Message.Fuse.Request.Parameters.Mkdir.mode);
+        result = FinesseInternalReplyStatus(fuse_request, sizeof(struct fuse_entry_out));
+
+        if (0 == result) {
+            NamespaceForgetEntry(se, fuse_request);
+            NamespaceNotify(se, target.ino, target.name, 0);
+        }
+        break;
+    }
+
+    if (NULL != fuse_request) {
+        FinesseFreeFuseRequest(fuse_request);
+    }
+    NamespaceRelease(se, &target);
+    free(name);
+
+    NamespaceSendResult(se, Client, Message, result);
+
+    return 0;
+}
+
+static int Rmdir(struct fuse_session *se, void *Client, fincomm_message Message)
+{
+    finesse_msg *      fmsg         = (finesse_msg *)Message->Data;
+    struct fuse_req *  fuse_request = NULL;
+    namespace_target_t target;
+    char *             name = NULL;
+    int                result;
+
+    memset(&target, 0, sizeof(target));
+
+    while (1) {
+        if (NULL == finesse_original_ops->rmdir) {
+            result = ENOTSUP;
+            break;
+        }
+
+        result = NamespaceCopyNames(se, Client, Message, fmsg->Message.Fuse.Request.Parameters.Rmdir.Name, 1, &name);
+        if (0 != result) {
+            break;
+        }
+
+        result = NamespaceResolveParent(se, fmsg->Message.Fuse.Request.Parameters.Rmdir.Parent, name, &target);
+        if (0 != result) {
+            break;
+        }
+
+        fuse_request = FinesseAllocInternalRequest(se, FUSE_RMDIR);
+        if (NULL == fuse_request) {
+            result = ENOMEM;
+            break;
+        }
+
+        finesse_original_ops->rmdir(fuse_request, target.ino, target.name);
+        result = FinesseInternalReplyStatus(fuse_request, 0);
+
+        if (0 == result) {
+            NamespaceNotify(se, target.ino, target.name, 1);
+        }
+        break;
+    }
+
+    if (NULL != fuse_request) {
+        FinesseFreeFuseRequest(fuse_request);
+    }
+    NamespaceRelease(se, &target);
+    free(name);
+
+    NamespaceSendResult(se, Client, Message, result);
+
+    return 0;
+}
+
+static int Rename(struct fuse_session *se, void *Client, fincomm_message Message)
+{
+    finesse_msg *      fmsg         = (finesse_msg *)Message->Data;
+    struct fuse_req *  fuse_request = NULL;
+    namespace_target_t target;
+    namespace_target_t newtarget;
+    char *             oldname = NULL;
+    unsigned           flags;
+    int                result;
+
+    memset(&target, 0, sizeof(target));
+    memset(&newtarget, 0, sizeof(newtarget));
+
+    while (1) {
+        if (NULL == finesse_original_ops->rename) {
+            result = ENOTSUP;
+            break;
+        }
+
+        flags  = fmsg->Message.Fuse.Request.Parameters.Rename.flags;
+        result = NamespaceCopyNames(se, Client, Message, fmsg->Message.Fuse.Request.Parameters.Rename.OldAndNewName, 2, &oldname);
+        if (0 != result) {
+            break;
+        }
+
+        result = NamespaceResolveParent(se, fmsg->Message.Fuse.Request.Parameters.Rename.Parent, oldname, &target);
+        if (0 != result) {
+            break;
+        }
+
+        result = NamespaceResolveParent(se, fmsg->Message.Fuse.Request.Parameters.Rename.NewParent,
+                                        oldname + strlen(oldname) + 1, &newtarget);
+        if (0 != result) {
+            break;
+        }
+
+        fuse_request = FinesseAllocInternalRequest(se, FUSE_RENAME2);
+        if (NULL == fuse_request) {
+            result = ENOMEM;
+            break;
+        }
+
+        finesse_original_ops->rename(fuse_request, target.ino, target.name, newtarget.ino, newtarget.name, flags);
+        result = FinesseInternalReplyStatus(fuse_request, 0);
+
+        if (0 == result) {
+            // With RENAME_EXCHANGE both names are still there
+            NamespaceNotify(se, target.ino, target.name, 0 == (flags & RENAME_EXCHANGE));
+            NamespaceNotify(se, newtarget.ino, newtarget.name, 0);
+        }
+        break;
+    }
+
+    if (NULL != fuse_request) {
+        FinesseFreeFuseRequest(fuse_request);
+    }
+    NamespaceRelease(se, &newtarget);
+    NamespaceRelease(se, &target);
+    free(oldname);
+
+    NamespaceSendResult(se, Client, Message, result);
+
+    return 0;
+}
+
+static int Link(struct fuse_session *se, void *Client, fincomm_message Message)
+{
+    finesse_msg *      fmsg         = (finesse_msg *)Message->Data;
+    struct fuse_req *  fuse_request = NULL;
+    namespace_target_t target;
+    namespace_target_t newtarget;
+    char *             oldname = NULL;
+    int                result;
+
+    memset(&target, 0, sizeof(target));
+    memset(&newtarget, 0, sizeof(newtarget));
+
+    while (1) {
+        if (NULL == finesse_original_ops->link) {
+            result = ENOTSUP;
+            break;
+        }
+
+        result = NamespaceCopyNames(se, Client, Message, fmsg->Message.Fuse.Request.Parameters.Link.OldAndNewName, 2, &oldname);
+        if (0 != result) {
+            break;
+        }
+
+        // As for link(2), a symlink is linked to, not followed
+        result = NamespaceResolveObject(se, fmsg->Message.Fuse.Request.Parameters.Link.Parent, oldname, &target);
+        if (0 != result) {
+            break;
+        }
+
+        result = NamespaceResolveParent(se, fmsg->Message.Fuse.Request.Parameters.Link.NewParent, oldname + strlen(oldname) + 1,
+                                        &newtarget);
+        if (0 != result) {
+            break;
+        }
+
+        fuse_request = FinesseAllocInternalRequest(se, FUSE_LINK);
+        if (NULL == fuse_request) {
+            result = ENOMEM;
+            break;
+        }
+
+        finesse_original_ops->link(fuse_request, target.ino, newtarget.ino, newtarget.name);
+        result = FinesseInternalReplyStatus(fuse_request, sizeof(struct fuse_entry_out));
+
+        if (0 == result) {
+            NamespaceForgetEntry(se, fuse_request);
+            fuse_lowlevel_notify_inval_inode(se, target.ino, -1, 0);  // st_nlink
+            NamespaceNotify(se, newtarget.ino, newtarget.name, 0);
+        }
+        break;
+    }
+
+    if (NULL != fuse_request) {
+        FinesseFreeFuseRequest(fuse_request);
+    }
+    NamespaceRelease(se, &newtarget);
+    NamespaceRelease(se, &target);
+    free(oldname);
+
+    NamespaceSendResult(se, Client, Message, result);
+
+    return 0;
+}
+
+static int Symlink(struct fuse_session *se, void *Client, fincomm_message Message)
+{
+    finesse_msg *      fmsg         = (finesse_msg *)Message->Data;
+    struct fuse_req *  fuse_request = NULL;
+    namespace_target_t target;
+    char *             link = NULL;
+    int                result;
+
+    memset(&target, 0, sizeof(target));
+
+    while (1) {
+        if (NULL == finesse_original_ops->symlink) {
+            result = ENOTSUP;
+            break;
+        }
+
+        result = NamespaceCopyNames(se, Client, Message, fmsg->Message.Fuse.Request.Parameters.Symlink.LinkAndName, 2, &link);
+        if (0 != result) {
+            break;
+        }
+
+        result = NamespaceResolveParent(se, fmsg->Message.Fuse.Request.Parameters.Symlink.Parent, link + strlen(link) + 1,
+                                        &target);
+        if (0 != result) {
+            break;
+        }
+
+        fuse_request = FinesseAllocInternalRequest(se, FUSE_SYMLINK);
+        if (NULL == fuse_request) {
+            result = ENOMEM;
+            break;
+        }
+
+        finesse_original_ops->symlink(fuse_request, link, target.ino, target.name);
+        result = FinesseInternalReplyStatus(fuse_request, sizeof(struct fuse_entry_out));
+
+        if (0 == result) {
+            NamespaceForgetEntry(se, fuse_request);
+            NamespaceNotify(se, target.ino, target.name, 0);
+        }
+        break;
+    }
+
+    if (NULL != fuse_request) {
+        FinesseFreeFuseRequest(fuse_request);
+    }
+    NamespaceRelease(se, &target);
+    free(link);
+
+    NamespaceSendResult(se, Client, Message, result);
+
+    return 0;
+}
+
+//
+// The file is made with mknod; the client opens it afterwards (without O_CREAT), so nothing is
+// left open here.  Without O_EXCL a file that is already there is fine.
+//
+static int Create(struct fuse_session *se, void *Client, fincomm_message Message)
+{
+    finesse_server_handle_t fsh          = (finesse_server_handle_t)se->server_handle;
+    finesse_msg *           fmsg         = (finesse_msg *)Message->Data;
+    struct fuse_req *       fuse_request = NULL;
+    struct fuse_entry_out * arg          = NULL;
+    namespace_target_t      target;
+    char *                  name = NULL;
+    struct stat             attr;
+    double                  timeout = 0.0;
+    mode_t                  mode;
+    int                     flags;
+    int                     result;
+    int                     status;
+
+    memset(&target, 0, sizeof(target));
+    memset(&attr, 0, sizeof(attr));
+
+    while (1) {
+        if (NULL == finesse_original_ops->mknod) {
+            result = ENOTSUP;
+            break;
+        }
+
+        mode  = S_IFREG | (fmsg->Message.Fuse.Request.Parameters.Create.Attr.st_mode & 07777);
+        flags = fmsg->Message.Fuse.Request.Parameters.Create.Flags;
+
+        result = NamespaceCopyNames(se, Client, Message, fmsg->Message.Fuse.Request.Parameters.Create.Name, 1, &name);
+        if (0 != result) {
+            break;
+        }
+
+        result = NamespaceResolveParent(se, fmsg->Message.Fuse.Request.Parameters.Create.Parent, name, &target);
+        if (0 != result) {
+            break;
+        }
+
+        fuse_request = FinesseAllocInternalRequest(se, FUSE_MKNOD);
+        if (NULL == fuse_request) {
+            result = ENOMEM;
+            break;
+        }
+
+        finesse_original_ops->mknod(fuse_request, target.ino, target.name, mode, 0);
+        result = FinesseInternalReplyStatus(fuse_request, sizeof(struct fuse_entry_out));
+
+        if ((EEXIST == result) && (0 == (flags & O_EXCL))) {
+            result = 0;
+            break;
+        }
+
+        if (0 == result) {
+            arg = ((struct finesse_req *)fuse_request)->iov[1].iov_base;
+            FinesseFuseAttrToStat(&arg->attr, &attr);
+            timeout = (double)arg->attr_valid + ((double)arg->attr_valid_nsec / 1000000000.0);
+            NamespaceForgetEntry(se, fuse_request);
+            NamespaceNotify(se, target.ino, target.name, 0);
+        }
+        break;
+    }
+
+    if (NULL != fuse_request) {
+        FinesseFreeFuseRequest(fuse_request);
+    }
+    NamespaceRelease(se, &target);
+    free(name);
+
+    // We don't track the new file, so there is no key for it
+    status = FinesseSendCreateResponse(fsh, Client, Message, NULL, 0, &attr, timeout, result);
+    assert(0 == status);
+    FinesseCountFuseResponse(FINESSE_FUSE_RSP_CREATE);
+
+    return 0;
+}
+
+static int Readlink(struct fuse_session *se, void *Client, fincomm_message Message)
+{
+    finesse_server_handle_t fsh          = (finesse_server_handle_t)se->server_handle;
+    finesse_msg *           fmsg         = (finesse_msg *)Message->Data;
+    struct fuse_req *       fuse_request = NULL;
+    struct finesse_req *    finesse_request;
+    namespace_target_t      target;
+    char *                  name   = NULL;
+    const char *            link   = NULL;
+    size_t                  length = 0;
+    int                     result;
+    int                     status;
+
+    memset(&target, 0, sizeof(target));
+
+    while (1) {
+        if (NULL == finesse_original_ops->readlink) {
+            result = ENOTSUP;
+            break;
+        }
+
+        result = NamespaceCopyNames(se, Client, Message, fmsg->Message.Fuse.Request.Parameters.ReadLink.Name, 1, &name);
+        if (0 != result) {
+            break;
+        }
+
+        result = NamespaceResolveObject(se, fmsg->Message.Fuse.Request.Parameters.ReadLink.Parent, name, &target);
+        if (0 != result) {
+            break;
+        }
+
+        if (!S_ISLNK(target.mode)) {
+            result = EINVAL;
+            break;
+        }
+
+        fuse_request = FinesseAllocInternalRequest(se, FUSE_READLINK);
+        if (NULL == fuse_request) {
+            result = ENOMEM;
+            break;
+        }
+
+        finesse_original_ops->readlink(fuse_request, target.ino);
+        result = FinesseInternalReplyStatus(fuse_request, 0);
+
+        if (0 == result) {
+            finesse_request = (struct finesse_req *)fuse_request;
+            if (finesse_request->iov_count > 1) {
+                link   = finesse_request->iov[1].iov_base;
+                length = finesse_request->iov[1].iov_len;
+            }
+        }
+        break;
+    }
+
+    NamespaceRelease(se, &target);
+    free(name);
+
+    status = FinesseSendReadlinkResponse(fsh, Client, Message, link, length, result);
+    assert(0 == status);
+    FinesseCountFuseResponse(FINESSE_FUSE_RSP_READLINK);
+
+    if (NULL != fuse_request) {
+        FinesseFreeFuseRequest(fuse_request);  // after the link is copied out
+    }
+
+    return 0;
+}
+
+static int Setattr(struct fuse_session *se, void *Client, fincomm_message Message)
+{
+    finesse_server_handle_t fsh          = (finesse_server_handle_t)se->server_handle;
+    finesse_msg *           fmsg         = (finesse_msg *)Message->Data;
+    struct fuse_req *       fuse_request = NULL;
+    struct fuse_attr_out *  arg          = NULL;
+    namespace_target_t      target;
+    char *                  name = NULL;
+    struct stat             attr;
+    double                  timeout = 0.0;
+    int                     to_set;
+    int                     result;
+    int                     status;
+
+    memset(&target, 0, sizeof(target));
+
+    while (1) {
+        if (NULL == finesse_original_ops->setattr) {
+            result = ENOTSUP;
+            break;
+        }
+
+        attr   = fmsg->Message.Fuse.Request.Parameters.SetAttr.Attr;
+        to_set = fmsg->Message.Fuse.Request.Parameters.SetAttr.ToSet;
+
+        result = NamespaceCopyNames(se, Client, Message, fmsg->Message.Fuse.Request.Parameters.SetAttr.Name, 1, &name);
+        if (0 != result) {
+            break;
+        }
+
+        result = NamespaceResolveObject(se, fmsg->Message.Fuse.Request.Parameters.SetAttr.Parent, name, &target);
+        if (0 != result) {
+            break;
+        }
+
+        if (S_ISLNK(target.mode)) {
+            // chmod and friends follow the link; let the client do that
+            result = ENOTSUP;
+            break;
+        }
+
+        fuse_request = FinesseAllocInternalRequest(se, FUSE_SETATTR);
+        if (NULL == fuse_request) {
+            result = ENOMEM;
+            break;
+        }
+
+        finesse_original_ops->setattr(fuse_request, target.ino, &attr, to_set, NULL);
+        result = FinesseInternalReplyStatus(fuse_request, sizeof(struct fuse_attr_out));
+
+        if (0 == result) {
+            arg = ((struct finesse_req *)fuse_request)->iov[1].iov_base;
+            FinesseFuseAttrToStat(&arg->attr, &attr);
+            timeout = (double)arg->attr_valid + ((double)arg->attr_valid_nsec / 1000000000.0);
+
+            // A truncate also throws away cached data past the new end of file
+            fuse_lowlevel_notify_inval_inode(se, target.ino, (to_set & FUSE_SET_ATTR_SIZE) ? attr.st_size : -1, 0);
+        }
+        break;
+    }
+
+    if (NULL != fuse_request) {
+        FinesseFreeFuseRequest(fuse_request);
+    }
+    NamespaceRelease(se, &target);
+    free(name);
+
+    status = FinesseSendSetattrResponse(fsh, Client, Message, 0 == result ? &attr : NULL, timeout, result);
+    assert(0 == status);
+    FinesseCountFuseResponse(FINESSE_FUSE_RSP_ATTR);
+
+    return 0;
+}
+
+FinesseServerFunctionHandler FinesseServerFuseMkdir    = Mkdir;
+FinesseServerFunctionHandler FinesseServerFuseRmdir    = Rmdir;
+FinesseServerFunctionHandler FinesseServerFuseRename   = Rename;
+FinesseServerFunctionHandler FinesseServerFuseLink     = Link;
+FinesseServerFunctionHandler FinesseServerFuseSymlink  = Symlink;
+FinesseServerFunctionHandler FinesseServerFuseCreate   = Create;
+FinesseServerFunctionHandler FinesseServerFuseReadlink = Readlink;
+FinesseServerFunctionHandler FinesseServerFuseSetattr  = Setattr;
@@ -26,6 +26,15 @@ static const char *finesse_request_type_to_string(FINESSE_NATIVE_REQ_TYPE Type)
         case FINESSE_NATIVE_REQ_DIRMAPRELEASE:
             str = "Native Request Dirmap Release";
             break;
+        case FINESSE_NATIVE_REQ_PATH_SEARCH:
+            str = "Native Request Path Search";
+            break;
+        case FINESSE_NATIVE_REQ_COMPOUND:
+            str = "Native Request Compound";
+            break;
+        case FINESSE_NATIVE_REQ_STATDIR:
+            str = "Native Request Statdir";
+            break;
         default:
             break;  // use default string
     }
@@ -53,6 +62,7 @@ int FinesseServerHandleNativeRequest(struct fuse_session *se, void *Client, finc
              finesse_request_type_to_string(fmsg->Message.Native.Request.NativeRequestType));
 
     FinesseCountNativeRequest(fmsg->Message.Native.Request.NativeRequestType);
+    FinessePrefetchSetClient(Client);  // directory locality is tracked per client
 
     // Now the big long switch statement
     switch (fmsg->Message.Native.Request.NativeRequestType) {
@@ -78,6 +88,21 @@ int FinesseServerHandleNativeRequest(struct fuse_session *se, void *Client, finc
             assert(0 == status);
         } break;
 
+        case FINESSE_NATIVE_REQ_PATH_SEARCH: {
+            status = FinesseServerNativePathSearchRequest(se, Client, Message);
+            assert(0 == status);
+        } break;
+
+        case FINESSE_NATIVE_REQ_COMPOUND: {
+            status = FinesseServerNativeCompoundRequest(se, Client, Message);
+            assert(0 == status);
+        } break;
+
+        case FINESSE_NATIVE_REQ_STATDIR: {
+            status = FinesseServerNativeStatDirRequest(se, Client, Message);
+            assert(0 == status);
+        } break;
+
         default:
             fmsg->Message.Native.Response.NativeResponseType = FINESSE_NATIVE_RSP_ERR;
             fmsg->Result                                     = ENOTSUP;
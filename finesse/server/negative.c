@@ -0,0 +1,623 @@
+/*
+  Copyright (C) 2020  Tony Mason <fsgeek@cs.ubc.ca>
+*/
+#include "fs-internal.h"
+#include "finesse-metrics.h"
+#include <murmurhash3.h>
+
+//
+// Negative lookup cache.
+//
+// Most of the names clients probe for don't exist (the compiler looking down its include
+// path, the loader down its library path, the shell down PATH).  Each of those misses costs
+// a lookup in the file system, so we remember them:
+//
+//  - negative dentries: (parent node id, name) pairs the file system said aren't there;
+//  - paths: for a multi-component path that failed, how far the walk got before the missing
+//    component, so the same path (or a longer one through the same missing component) is
+//    answered without looking up the components in front of it again.
+//
+// Both tables are direct mapped.  Each dentry slot has a generation, bumped whenever a name
+// hashing to it is invalidated (see invalidate.c - a create, mkdir, link, symlink or rename
+// into the directory, whether it came through the kernel or through us).  A miss only goes
+// into the cache if its slot's generation didn't change while the lookup was in progress, so
+// a name created in the meantime can't be cached as missing.  A path is only good while the
+// generations of every component it walked through are unchanged and its missing component
+// is still in the dentry table.
+//
+// Node ids are only stable while someone holds a lookup reference (passthrough_ll uses the
+// address of its inode structure), so a dentry is only used if its parent is the root or we
+// hold a reference on the parent.  Those references are donated by the walk code: when it
+// releases a directory it has entries under, FinesseReleaseInode asks us if we want to keep
+// it.  When the last entry under a directory goes away so does the reference, but that is
+// deferred to the next lookup since invalidations can arrive in contexts that can't call
+// into the file system.
+//
+// Only a miss the file system answered with a negative entry (a zero node id) is remembered:
+// that is how it says the miss may be cached, and its entry timeout says for how long.  An
+// ENOENT error, or a zero entry timeout, is not cached at all.  FINESSE_NEGATIVE_TIMEOUT (in
+// milliseconds) caps how long an entry is kept, 0 disables the cache.
+//
+#define FINESSE_NEGATIVE_TIMEOUT_ENV "FINESSE_NEGATIVE_TIMEOUT"  // in ms, 0 disables the cache
+#define FINESSE_NEGATIVE_DEFAULT_TIMEOUT_MS (5000)
+#define FINESSE_NEGATIVE_ENTRIES (4096)
+#define FINESSE_NEGATIVE_PARENT_BUCKETS (1024)
+#define FINESSE_NEGATIVE_PATHS (1024)
+#define FINESSE_NEGATIVE_PATH_LENGTH (256)
+#define FINESSE_NEGATIVE_RELEASES (FINESSE_NEGATIVE_ENTRIES + 2)
+
+typedef struct _finesse_negative_entry {
+    fuse_ino_t Parent;   // 0 = unused
+    uint64_t   Expires;  // CLOCK_MONOTONIC, in ns
+    uint32_t   Hash;
+    uint16_t   Length;
+    char       Name[NAME_MAX + 1];
+} finesse_negative_entry_t;
+
+//
+// One per directory with entries under it (other than the root)
+//
+typedef struct _finesse_negative_parent {
+    fuse_ino_t Parent;
+    unsigned   Entries;
+    unsigned   Pinned;  // we hold a lookup reference on Parent
+    unsigned   Next;    // bucket chain or free list; index + 1, 0 = end
+} finesse_negative_parent_t;
+
+typedef struct _finesse_negative_path {
+    fuse_ino_t Base;    // 0 = unused
+    fuse_ino_t Parent;  // the directory the missing component isn't in
+    uint32_t   Hash;
+    uint16_t   Length;      // of Path, which ends with the missing component
+    uint16_t   NameOffset;  // where the missing component starts
+    unsigned   Depth;
+    uint32_t   Slots[FINESSE_NEGATIVE_PATH_DEPTH];  // the dentry slot of each component looked up
+    uint32_t   Generations[FINESSE_NEGATIVE_PATH_DEPTH];
+    char       Path[FINESSE_NEGATIVE_PATH_LENGTH];
+} finesse_negative_path_t;
+
+static struct {
+    pthread_mutex_t           Lock;
+    int                       Running;
+    struct fuse_session *     Session;
+    uint64_t                  Timeout;  // in ns
+    unsigned                  FreeParents;
+    unsigned                  ReleaseCount;
+    uint64_t                  Hits;
+    uint64_t                  PathHits;
+    uint64_t                  Inserts;
+    uint32_t                  Generations[FINESSE_NEGATIVE_ENTRIES];
+    finesse_negative_entry_t  Entries[FINESSE_NEGATIVE_ENTRIES];
+    unsigned                  ParentBuckets[FINESSE_NEGATIVE_PARENT_BUCKETS];
+    finesse_negative_parent_t Parents[FINESSE_NEGATIVE_ENTRIES + 1];
+    fuse_ino_t                Releases[FINESSE_NEGATIVE_RELEASES];
+    finesse_negative_path_t   Paths[FINESSE_NEGATIVE_PATHS];
+} FinesseNegative = {
+    .Lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static uint64_t FinesseNegativeHits(void *Context)
+{
+    (void)Context;
+    return __atomic_load_n(&FinesseNegative.Hits, __ATOMIC_RELAXED);
+}
+
+static uint64_t FinesseNegativePathHits(void *Context)
+{
+    (void)Context;
+    return __atomic_load_n(&FinesseNegative.PathHits, __ATOMIC_RELAXED);
+}
+
+static uint64_t FinesseNegativeInserts(void *Context)
+{
+    (void)Context;
+    return __atomic_load_n(&FinesseNegative.Inserts, __ATOMIC_RELAXED);
+}
+
+static uint64_t NegativeNow(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+static uint32_t NegativeHash(fuse_ino_t Ino, const char *Name, size_t Length)
+{
+    uint32_t hash;
+
+    MurmurHash3_x86_32(Name, (int)Length, (uint32_t)(Ino ^ (Ino >> 32)), &hash);
+    return hash;
+}
+
+//
+// The parent records; these must be called with the lock held.
+//
+static finesse_negative_parent_t *NegativeFindParent(fuse_ino_t Parent)
+{
+    unsigned next = FinesseNegative.ParentBuckets[Parent % FINESSE_NEGATIVE_PARENT_BUCKETS];
+
+    while (0 != next) {
+        if (Parent == FinesseNegative.Parents[next - 1].Parent) {
+            return &FinesseNegative.Parents[next - 1];
+        }
+        next = FinesseNegative.Parents[next - 1].Next;
+    }
+
+    return NULL;
+}
+
+static void NegativeHoldParent(fuse_ino_t Parent)
+{
+    finesse_negative_parent_t *record = NULL;
+    unsigned *                 bucket = NULL;
+    unsigned                   index;
+
+    if (FUSE_ROOT_ID == Parent) {
+        return;  // never goes away
+    }
+
+    record = NegativeFindParent(Parent);
+
+    if (NULL == record) {
+        // There is always one free: every record in use has at least one entry under it
+        index = FinesseNegative.FreeParents;
+        assert(0 != index);
+        record                     = &FinesseNegative.Parents[index - 1];
+        FinesseNegative.FreeParents = record->Next;
+
+        bucket          = &FinesseNegative.ParentBuckets[Parent % FINESSE_NEGATIVE_PARENT_BUCKETS];
+        record->Parent  = Parent;
+        record->Entries = 0;
+        record->Pinned  = 0;
+        record->Next    = *bucket;
+        *bucket         = index;
+    }
+
+    record->Entries++;
+}
+
+static void NegativeDropParent(fuse_ino_t Parent)
+{
+    finesse_negative_parent_t *record = NULL;
+    unsigned *                 link   = NULL;
+
+    if (FUSE_ROOT_ID == Parent) {
+        return;
+    }
+
+    link = &FinesseNegative.ParentBuckets[Parent % FINESSE_NEGATIVE_PARENT_BUCKETS];
+    while (0 != *link) {
+        record = &FinesseNegative.Parents[*link - 1];
+        if (Parent == record->Parent) {
+            break;
+        }
+        link = &record->Next;
+    }
+    assert(0 != *link);
+
+    assert(record->Entries > 0);
+    if (0 != --record->Entries) {
+        return;
+    }
+
+    if (record->Pinned) {
+        if (FinesseNegative.ReleaseCount < FINESSE_NEGATIVE_RELEASES) {
+            FinesseNegative.Releases[FinesseNegative.ReleaseCount++] = Parent;
+        }
+        else {
+            fuse_log(FUSE_LOG_ERR, "FINESSE %s: release queue full, leaking a reference on %lu\n", __func__,
+                     (unsigned long)Parent);
+        }
+    }
+
+    *link                       = record->Next;
+    record->Parent              = 0;
+    record->Next                = FinesseNegative.FreeParents;
+    FinesseNegative.FreeParents = (unsigned)(record - FinesseNegative.Parents) + 1;
+}
+
+static void NegativeDropEntry(finesse_negative_entry_t *Entry)
+{
+    if (0 != Entry->Parent) {
+        NegativeDropParent(Entry->Parent);
+        Entry->Parent = 0;
+    }
+}
+
+//
+// Is this the entry for (Parent, Name), and can we use it?  Called with the lock held.
+//
+static int NegativeEntryMatches(finesse_negative_entry_t *Entry, fuse_ino_t Parent, uint32_t Hash, const char *Name,
+                                size_t Length)
+{
+    finesse_negative_parent_t *record;
+
+    if ((Parent != Entry->Parent) || (Hash != Entry->Hash) || (Length != Entry->Length) ||
+        (0 != memcmp(Name, Entry->Name, Length))) {
+        return 0;
+    }
+
+    if (NegativeNow() >= Entry->Expires) {
+        NegativeDropEntry(Entry);
+        return 0;
+    }
+
+    if (FUSE_ROOT_ID == Parent) {
+        return 1;
+    }
+
+    // Without a reference the node id might have been reused for some other directory
+    record = NegativeFindParent(Parent);
+    assert(NULL != record);
+    return record->Pinned ? 1 : 0;
+}
+
+//
+// Hand back the references we no longer need.  This calls into the file system, so it is
+// only done from the request path.
+//
+static void NegativeProcessReleases(void)
+{
+    fuse_ino_t ino;
+
+    while (0 != __atomic_load_n(&FinesseNegative.ReleaseCount, __ATOMIC_RELAXED)) {
+        pthread_mutex_lock(&FinesseNegative.Lock);
+        ino = 0;
+        if (FinesseNegative.ReleaseCount > 0) {
+            ino = FinesseNegative.Releases[--FinesseNegative.ReleaseCount];
+        }
+        pthread_mutex_unlock(&FinesseNegative.Lock);
+
+        if (0 != ino) {
+            FinesseReleaseInode(FinesseNegative.Session, ino);
+        }
+    }
+}
+
+//
+// Note where (Parent, Name) lives in the cache without looking it up; see FinesseNegativeAdd.
+//
+void FinesseNegativeSnapshot(fuse_ino_t Parent, const char *Name, size_t Length, finesse_negative_token_t *Token)
+{
+    Token->Slot       = NegativeHash(Parent, Name, Length) % FINESSE_NEGATIVE_ENTRIES;
+    Token->Generation = __atomic_load_n(&FinesseNegative.Generations[Token->Slot], __ATOMIC_ACQUIRE);
+}
+
+//
+// Returns 1 if Name is known not to exist in Parent.  Otherwise Token is filled in for the
+// FinesseNegativeAdd to call if the file system says it doesn't.
+//
+int FinesseNegativeLookup(fuse_ino_t Parent, const char *Name, size_t Length, finesse_negative_token_t *Token)
+{
+    uint32_t hash = NegativeHash(Parent, Name, Length);
+    int      hit  = 0;
+
+    Token->Slot       = hash % FINESSE_NEGATIVE_ENTRIES;
+    Token->Generation = 0;
+
+    if (0 == __atomic_load_n(&FinesseNegative.Running, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+
+    NegativeProcessReleases();
+
+    pthread_mutex_lock(&FinesseNegative.Lock);
+    Token->Generation = FinesseNegative.Generations[Token->Slot];
+    hit               = NegativeEntryMatches(&FinesseNegative.Entries[Token->Slot], Parent, hash, Name, Length);
+    pthread_mutex_unlock(&FinesseNegative.Lock);
+
+    if (hit) {
+        __atomic_add_fetch(&FinesseNegative.Hits, 1, __ATOMIC_RELAXED);
+    }
+
+    return hit;
+}
+
+//
+// The file system answered the lookup of Name in Parent with Entry, a negative entry.  This
+// must be called before the caller lets go of its reference on Parent, so that the reference
+// can be kept for the entry.
+//
+void FinesseNegativeAdd(fuse_ino_t Parent, const char *Name, size_t Length, const finesse_negative_token_t *Token,
+                        const struct fuse_entry_out *Entry)
+{
+    finesse_negative_entry_t *entry;
+    uint32_t                  hash;
+    uint64_t                  valid;
+
+    assert(0 == Entry->nodeid);
+
+    if ((0 == __atomic_load_n(&FinesseNegative.Running, __ATOMIC_RELAXED)) || (Length > NAME_MAX)) {
+        return;
+    }
+
+    // No longer than the file system said the miss is good for
+    valid = FinesseNegative.Timeout;
+    if (Entry->entry_valid < valid / 1000000000ull) {
+        valid = Entry->entry_valid * 1000000000ull + Entry->entry_valid_nsec;
+        if (valid > FinesseNegative.Timeout) {
+            valid = FinesseNegative.Timeout;
+        }
+    }
+
+    if (0 == valid) {
+        return;
+    }
+
+    hash  = NegativeHash(Parent, Name, Length);
+    entry = &FinesseNegative.Entries[Token->Slot];
+    assert(hash % FINESSE_NEGATIVE_ENTRIES == Token->Slot);
+
+    pthread_mutex_lock(&FinesseNegative.Lock);
+    while (1) {
+        if (Token->Generation != FinesseNegative.Generations[Token->Slot]) {
+            // Something with this hash was created (or removed) while we were looking
+            break;
+        }
+
+        // Hold the new parent first, in case the old entry was the last one under it
+        NegativeHoldParent(Parent);
+        NegativeDropEntry(entry);
+
+        entry->Parent  = Parent;
+        entry->Expires = NegativeNow() + valid;
+        entry->Hash    = hash;
+        entry->Length  = (uint16_t)Length;
+        memcpy(entry->Name, Name, Length);
+        entry->Name[Length] = '\0';
+        FinesseNegative.Inserts++;
+        break;
+    }
+    pthread_mutex_unlock(&FinesseNegative.Lock);
+
+    NegativeProcessReleases();
+}
+
+//
+// Name (in Parent) has been created, removed or renamed.  This can be called from any context.
+//
+void FinesseNegativeInvalidate(fuse_ino_t Parent, const char *Name, size_t Length)
+{
+    uint32_t                  hash;
+    finesse_negative_entry_t *entry;
+
+    if (0 == __atomic_load_n(&FinesseNegative.Running, __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    hash  = NegativeHash(Parent, Name, Length);
+    entry = &FinesseNegative.Entries[hash % FINESSE_NEGATIVE_ENTRIES];
+
+    pthread_mutex_lock(&FinesseNegative.Lock);
+    __atomic_add_fetch(&FinesseNegative.Generations[hash % FINESSE_NEGATIVE_ENTRIES], 1, __ATOMIC_RELEASE);
+    if ((Parent == entry->Parent) && (Length == entry->Length) && (0 == memcmp(Name, entry->Name, Length))) {
+        NegativeDropEntry(entry);
+    }
+    pthread_mutex_unlock(&FinesseNegative.Lock);
+}
+
+//
+// Called by FinesseReleaseInode: returns 1 if we keep the caller's reference on Ino (because
+// there are entries under it that can't be used without one).
+//
+int FinesseNegativeKeepInode(fuse_ino_t Ino)
+{
+    finesse_negative_parent_t *record;
+    int                        keep = 0;
+
+    if (0 == __atomic_load_n(&FinesseNegative.Running, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&FinesseNegative.Lock);
+    record = NegativeFindParent(Ino);
+    if ((NULL != record) && !record->Pinned) {
+        record->Pinned = 1;
+        keep           = 1;
+    }
+    pthread_mutex_unlock(&FinesseNegative.Lock);
+
+    return keep;
+}
+
+//
+// Paths: called with the lock held.
+//
+static int NegativePathValid(finesse_negative_path_t *Entry)
+{
+    const char *name   = Entry->Path + Entry->NameOffset;
+    size_t      length = Entry->Length - Entry->NameOffset;
+    uint32_t    hash   = NegativeHash(Entry->Parent, name, length);
+
+    for (unsigned index = 0; index < Entry->Depth; index++) {
+        if (Entry->Generations[index] != FinesseNegative.Generations[Entry->Slots[index]]) {
+            return 0;
+        }
+    }
+
+    return NegativeEntryMatches(&FinesseNegative.Entries[hash % FINESSE_NEGATIVE_ENTRIES], Entry->Parent, hash, name, length);
+}
+
+//
+// Returns 1 if some leading part of Path (relative to Base) is known to be missing, in which
+// case so is Path.
+//
+int FinesseNegativeLookupPath(fuse_ino_t Base, const char *Path)
+{
+    finesse_negative_path_t *entry;
+    const char *             cursor     = Path;
+    unsigned                 components = 0;
+    size_t                   length;
+    uint32_t                 hash;
+    int                      hit = 0;
+
+    if (0 == __atomic_load_n(&FinesseNegative.Running, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+
+    while (!hit) {
+        while ('/' == *cursor) {
+            cursor++;
+        }
+
+        if ('\0' == *cursor) {
+            break;
+        }
+
+        while (('/' != *cursor) && ('\0' != *cursor)) {
+            cursor++;
+        }
+        components++;
+
+        length = (size_t)(cursor - Path);
+        if (length >= FINESSE_NEGATIVE_PATH_LENGTH) {
+            break;
+        }
+
+        if (components < 2) {
+            continue;  // the dentry table has these
+        }
+
+        hash  = NegativeHash(Base, Path, length);
+        entry = &FinesseNegative.Paths[hash % FINESSE_NEGATIVE_PATHS];
+
+        pthread_mutex_lock(&FinesseNegative.Lock);
+        if ((Base == entry->Base) && (hash == entry->Hash) && (length == entry->Length) &&
+            (0 == memcmp(Path, entry->Path, length))) {
+            hit = NegativePathValid(entry);
+            if (!hit) {
+                entry->Base = 0;
+            }
+        }
+        pthread_mutex_unlock(&FinesseNegative.Lock);
+    }
+
+    if (hit) {
+        __atomic_add_fetch(&FinesseNegative.PathHits, 1, __ATOMIC_RELAXED);
+    }
+
+    return hit;
+}
+
+//
+// A walk from Base failed because the last component of the first Length characters of Path
+// isn't in Parent.  Tokens are the snapshots (FinesseNegativeSnapshot or FinesseNegativeLookup)
+// of each component it looked up to get there, taken before the lookups were done.
+//
+void FinesseNegativeAddPath(fuse_ino_t Base, const char *Path, size_t Length, fuse_ino_t Parent,
+                            const finesse_negative_token_t *Tokens, unsigned Depth)
+{
+    finesse_negative_path_t *entry;
+    const char *             name = Path + Length;
+    uint32_t                 hash;
+    int                      stale = 0;
+
+    if ((0 == __atomic_load_n(&FinesseNegative.Running, __ATOMIC_RELAXED)) || (Depth < 2) ||
+        (Depth > FINESSE_NEGATIVE_PATH_DEPTH) || (Length >= FINESSE_NEGATIVE_PATH_LENGTH)) {
+        return;
+    }
+
+    while ((name > Path) && ('/' != name[-1])) {
+        name--;
+    }
+
+    // ".." depends on more than the names in front of it
+    for (const char *cursor = Path; cursor + 1 < Path + Length; cursor++) {
+        if (('.' == cursor[0]) && ('.' == cursor[1]) && ((cursor == Path) || ('/' == cursor[-1])) &&
+            ((cursor + 2 == Path + Length) || ('/' == cursor[2]))) {
+            return;
+        }
+    }
+
+    hash  = NegativeHash(Base, Path, Length);
+    entry = &FinesseNegative.Paths[hash % FINESSE_NEGATIVE_PATHS];
+
+    pthread_mutex_lock(&FinesseNegative.Lock);
+    for (unsigned index = 0; index < Depth; index++) {
+        if (Tokens[index].Generation != FinesseNegative.Generations[Tokens[index].Slot]) {
+            stale = 1;
+            break;
+        }
+    }
+
+    if (!stale) {
+        entry->Base       = Base;
+        entry->Parent     = Parent;
+        entry->Hash       = hash;
+        entry->Length     = (uint16_t)Length;
+        entry->NameOffset = (uint16_t)(name - Path);
+        entry->Depth      = Depth;
+        for (unsigned index = 0; index < Depth; index++) {
+            entry->Slots[index]       = Tokens[index].Slot;
+            entry->Generations[index] = Tokens[index].Generation;
+        }
+        memcpy(entry->Path, Path, Length);
+    }
+    pthread_mutex_unlock(&FinesseNegative.Lock);
+}
+
+//
+// Start the cache.  The timeout (in milliseconds) is set with FINESSE_NEGATIVE_TIMEOUT, 0
+// disables it.
+//
+int FinesseNegativeStart(struct fuse_session *se)
+{
+    const char *timeout = getenv(FINESSE_NEGATIVE_TIMEOUT_ENV);
+
+    assert(NULL != se);
+    assert(0 == FinesseNegative.Running);
+
+    FinesseNegative.Timeout = (uint64_t)FINESSE_NEGATIVE_DEFAULT_TIMEOUT_MS * 1000000;
+    if (NULL != timeout) {
+        FinesseNegative.Timeout = (uint64_t)strtoul(timeout, NULL, 0) * 1000000;
+    }
+
+    if (0 == FinesseNegative.Timeout) {
+        return 0;  // disabled
+    }
+
+    pthread_mutex_lock(&FinesseNegative.Lock);
+    memset(FinesseNegative.Entries, 0, sizeof(FinesseNegative.Entries));
+    memset(FinesseNegative.ParentBuckets, 0, sizeof(FinesseNegative.ParentBuckets));
+    memset(FinesseNegative.Paths, 0, sizeof(FinesseNegative.Paths));
+    for (unsigned index = 0; index < FINESSE_NEGATIVE_ENTRIES + 1; index++) {
+        FinesseNegative.Parents[index].Parent = 0;
+        FinesseNegative.Parents[index].Next   = index + 2;
+    }
+    FinesseNegative.Parents[FINESSE_NEGATIVE_ENTRIES].Next = 0;
+    FinesseNegative.FreeParents                            = 1;
+    FinesseNegative.ReleaseCount                           = 0;
+    FinesseNegative.Session                                = se;
+    __atomic_store_n(&FinesseNegative.Running, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&FinesseNegative.Lock);
+
+    FinesseMetricsRegisterCounter("finesse negative hits", FinesseNegativeHits, NULL);
+    FinesseMetricsRegisterCounter("finesse negative path hits", FinesseNegativePathHits, NULL);
+    FinesseMetricsRegisterCounter("finesse negative inserts", FinesseNegativeInserts, NULL);
+
+    fuse_log(FUSE_LOG_INFO, "FINESSE %s: caching missing names for %llu ms\n", __func__,
+             (unsigned long long)(FinesseNegative.Timeout / 1000000));
+
+    return 0;
+}
+
+//
+// The references we hold are simply dropped: the session is going away.
+//
+void FinesseNegativeStop(void)
+{
+    if (0 == FinesseNegative.Running) {
+        return;
+    }
+
+    FinesseMetricsUnregisterCounter(FinesseNegativeHits, NULL);
+    FinesseMetricsUnregisterCounter(FinesseNegativePathHits, NULL);
+    FinesseMetricsUnregisterCounter(FinesseNegativeInserts, NULL);
+
+    pthread_mutex_lock(&FinesseNegative.Lock);
+    __atomic_store_n(&FinesseNegative.Running, 0, __ATOMIC_RELAXED);
+    FinesseNegative.ReleaseCount = 0;
+    FinesseNegative.Session      = NULL;
+    pthread_mutex_unlock(&FinesseNegative.Lock);
+}
@@ -16,13 +16,6 @@ typedef struct _FinesseServerPathResolutionParameters {
     size_t       PathNameBufferLength;  // Maximum buffer length (internal use)
 } FinesseServerPathResolutionParameters_t;
 
-#define FINESSE_SERVER_PATH_RESOLUTION_FOLLOW_SYMLINKS (0x1)
-#define FINESSE_SERVER_PATH_RESOLUTION_CHECK_SECURITY (0x2)
-#define FINESSE_SERVER_PATH_RESOLUTION_GET_FINAL_PARENT (0x4)
-#define FINESSE_SERVER_PATH_RESOLUTION_VALID_FLAGS                                                    \
-    (FINESSE_SERVER_PATH_RESOLUTION_FOLLOW_SYMLINKS | FINESSE_SERVER_PATH_RESOLUTION_CHECK_SECURITY | \
-     FINESSE_SERVER_PATH_RESOLUTION_GET_FINAL_PARENT)
-
 void FinesseFreeServerPathResolutionParameters(FinesseServerPathResolutionParameters_t *Parameters)
 {
     while (NULL != Parameters) {
@@ -109,39 +102,38 @@ FinesseServerPathResolutionParameters_t *FinesseAllocateServerPathResolutionPara
 //
 // The kernel (and FUSE) will do path name parsing.  While some file systems can handle multi-part path names,
 // we can't assume that all will do so (bitbucket does not, passthrough_ll does).  Thus, we need to have
-// something equivalent to namei style functionality.
+// something equivalent to namei style functionality: that is FinesseServerInternalWalk (pathsearch.c), which
+// this wraps.
 //
 // Given a specific FUSE session, this routine takes a parent inode number and a name (possibly a path name)
 // If the parent inode number is 0, this routine will expect the passed in name to be an absolute name relative
 // to the system root. If the parent inode number is anything else, this routine will expect the passed in name
 // to be a name relative to the parent inode number.
 //
-// If successful, this routine returns 0 and sets TargetInode to contain the name of the final inode.
+// If successful, this routine returns 0 and StatxBuffer holds the inode number (and type) of the final object;
+// unless that is the parent, the caller owns a lookup reference on it.  With GET_FINAL_PARENT the final object
+// is the directory holding the last component (FinalName), whether or not that exists.
 //
-// Note: flags is expected to be used to ask for:
-//   - Symbolic link following behavior
-//   - Security checking behavior
-//   - parent/child behavior ("need the path to the final parent")
+// Symbolic links part way along are always followed; a final one only with FOLLOW_SYMLINKS.
 //
 // Returns:
 //   EINVAL - the combination of parameters specified is not valid
 //   ENOENT - some component of the path does not exist
+//   ENOTDIR - some component of the path is not a directory
 //   ELOOP - too many symlinks
-//   EACCES - permission denied
-//   others to be determined.
+//   ENOTSUP - a symlink leads out of our mount (or a ".." above the parent); the client must do this one
 //
 int FinesseServerResolvePathName(struct fuse_session *se, FinesseServerPathResolutionParameters_t *Parameters)
 {
-    char *   workpath       = NULL;
-    char *   finalsep       = NULL;
-    char *   workcurrent    = NULL;
-    char *   workend        = NULL;
-    size_t   workpathlength = 0;
-    ino_t    ino            = 0;
-    ino_t    parentino      = 0;
-    int      status         = EINVAL;
-    unsigned idx            = 0;
-    size_t   mp_length      = 0;
+    char *      workpath  = NULL;
+    char *      finalsep  = NULL;
+    const char *path      = NULL;
+    fuse_ino_t  parentino = 0;
+    fuse_ino_t  ino       = 0;
+    uint32_t    mode      = 0;
+    int         flags     = 0;
+    int         status    = EINVAL;
+    size_t      mp_length = 0;
 
     assert(NULL != se);
     assert(NULL != Parameters);
@@ -154,133 +146,68 @@ int FinesseServerResolvePathName(struct fuse_session *se, FinesseServerPathResol
             parentino = FUSE_ROOT_ID;
         }
 
-        if (0 == Parameters->PathNameBufferLength) {
-            // "" - interpret this as opening the parent
-            // Note that this is consistent with what FUSE does
-            ino = parentino;
-            break;
+        // Security
+        if (Parameters->CheckSecurity) {
+            assert(0);  // TODO
+            // Basically, this should be a call into the file system to see if the given
+            // caller has access to each directory along the way. Probably need a wrapper,
+            // much like the lookup wrapper.
         }
 
-        // we need a working buffer so we can carve things up
-        workpathlength = Parameters->PathNameBufferLength;
-        workpath       = (char *)malloc(workpathlength);
-        assert(NULL != workpath);
-
         // Strip off the mount point path if it is present
         mp_length = strlen(se->mountpoint);
-        if ((Parameters->PathNameBufferLength < mp_length) || (0 != memcmp(Parameters->PathName, se->mountpoint, mp_length))) {
+        if ((Parameters->PathNameBufferLength <= mp_length) || (0 != memcmp(Parameters->PathName, se->mountpoint, mp_length)) ||
+            (('/' != Parameters->PathName[mp_length]) && ('\0' != Parameters->PathName[mp_length]))) {
             mp_length = 0;  // don't strip it off
         }
+        path = &Parameters->PathName[mp_length];
 
-        strcpy(workpath, &Parameters->PathName[mp_length]);
-
-        finalsep = rindex(workpath, '/');
-        if (NULL == finalsep) {
-            // "foo" - this is not valid (needs a "/" at the beginning)
-            ino = 0;
-            break;
+        if (Parameters->FollowSymlinks) {
+            flags = FINESSE_WALK_FOLLOW;
         }
 
-        if (finalsep == workpath) {
-            // "/foo" - just look it up relative to the parent; skips the leading slash
-            status = FinesseServerInternalNameLookup(se, parentino, workpath + 1, &Parameters->StatxBuffer);
-
-            if (0 != status) {
-                fprintf(stderr, "%s:%d --> FinesseServerInternalNameLookup failed, status = %d\n", __func__, __LINE__, status);
-                assert((ENOENT == status) || (-ENOENT == status));
-                Parameters->Cursor = workpath + 1;
-                Parameters->Parent = ino;  // This is the parent we found.
+        if (Parameters->GetFinalParent) {
+            // we need a working buffer so we can carve off the last component
+            workpath = strdup(path);
+            if (NULL == workpath) {
+                status = ENOMEM;
                 break;
             }
-            ino = Parameters->StatxBuffer.stx_ino;
-            assert(0 != ino);
-            break;
-        }
 
-        workend = rindex(workpath, '/');
-
-        // cases we've already eliminated
-        assert(NULL != workend);
-        assert(workend != workpath);
-        workend++;  // skip over the separator
-
-        ino = parentino;
-        assert('/' == workpath[0]);
-        for (workcurrent = &workpath[1]; workcurrent != workend;) {
-            char *segend = NULL;
-            assert(NULL != workcurrent);
-            assert('/' != *workcurrent);
-            segend = index(workcurrent, '/');
-            assert(NULL != segend);  // otherwise we've met the termination condition already!
-            *segend = '\0';
-
-            // Security
-            if (Parameters->CheckSecurity) {
-                assert(0);  // TODO
-                // Basically, this should be a call into the file system to see if the given
-                // caller has access to this file. Probably need a wrapper, much like
-                // the lookup wrapper.
+            finalsep = rindex(workpath, '/');
+            if (NULL == finalsep) {
+                Parameters->FinalName = path;
+                workpath[0]           = '\0';
             }
-
-            // Look up the entry
-            status = FinesseServerInternalNameLookup(se, ino, workcurrent, &Parameters->StatxBuffer);
-            if (0 != status) {
-                fprintf(stderr, "%s:%d --> FinesseServerInternalNameLookup failed\n", __func__, __LINE__);
-                assert((ENOENT == status) || (-ENOENT == status));  // don't handle other errors at this point
-
-                idx                = (unsigned)((uintptr_t)(workcurrent - workpath));
-                Parameters->Cursor = &Parameters->PathName[idx];  // point to location we processed up to
-                Parameters->Parent = ino;                         // This is the parent we found.
-                break;
+            else {
+                Parameters->FinalName = path + (finalsep - workpath) + 1;
+                finalsep[1]           = '\0';
             }
+            path  = workpath;
+            flags = FINESSE_WALK_FOLLOW;
+        }
 
-            if (S_ISLNK(Parameters->StatxBuffer.stx_mode)) {
-                // DEBUG: there is some odd case where I'm told something is a symlink; the mode bits are strange, so I'm going to
-                // repeat the operation here to see if I can figure out WHY it thinks that it is a symlink.
-                struct statx stxbuf;
-                int          status2 = FinesseServerInternalNameLookup(se, ino, workcurrent, &stxbuf);
-
-                assert(0 == status2);
-                //
-                // This is a symlink.  To handle this properly, we need to read the link contents
-                // and then reconstruct the name.  For Finesse this gets _more_ complicated because
-                // links can traverse out of the file system
-                //
-                assert(0);  // TODO
-            }
-            ino = Parameters->StatxBuffer.stx_ino;
-            assert(0 != ino);
-            // TODO: this is where I'd do a check for a symlink, in which case I have to rebuild the name and try again
-            // TODO: this is where I'd add a security check
-            workcurrent = segend + 1;  // move to the next entry
+        status = FinesseServerInternalWalk(se, parentino, path, flags, &ino, &mode);
+        if (FINESSE_WALK_UNRESOLVED == status) {
+            status = ENOTSUP;
         }
 
         if (0 != status) {
-            // We were not able to finish parsing the full path
-            // TODO: add handling where the caller just wants the parent (someday)
             break;
         }
 
-        // At this point I have a single segment left
-        idx                   = (unsigned)((uintptr_t)(workcurrent - workpath));
-        Parameters->Cursor    = &Parameters->PathName[idx];
-        Parameters->FinalName = Parameters->Cursor + 1;
-        Parameters->Parent    = ino;
-
-        status = FinesseServerInternalNameLookup(se, ino, workend, &Parameters->StatxBuffer);
-        if ((0 != status)) {
-            fprintf(stderr, "%s:%d --> FinesseServerInternalNameLookup failed, status = %d, errno = %d\n", __func__, __LINE__,
-                    status, errno);
-            assert((ENOENT == status) || (-ENOENT == status));
-
-            if (Parameters->GetFinalParent) {
-                // The caller didn't _need_ the last path
-                status = 0;
+        if (Parameters->GetFinalParent && !S_ISDIR(mode)) {
+            if (ino != parentino) {
+                FinesseReleaseInode(se, ino);
             }
+            status = ENOTDIR;
             break;
         }
 
-        // We've found it all. Final inode is in the parameters structure.
+        memset(&Parameters->StatxBuffer, 0, sizeof(Parameters->StatxBuffer));
+        Parameters->StatxBuffer.stx_mask = STATX_INO | STATX_TYPE;
+        Parameters->StatxBuffer.stx_ino  = ino;
+        Parameters->StatxBuffer.stx_mode = (uint16_t)mode;
         break;
     }
 
@@ -0,0 +1,485 @@
+/*
+  Copyright (C) 2020  Tony Mason <fsgeek@cs.ubc.ca>
+*/
+#include "fs-internal.h"
+
+//
+// Path search: given a list of candidate names and a list of directories, find which
+// names exist in which directories.  This is what a compiler does for each #include,
+// the dynamic loader for each library and the shell (execvp) for each command - and
+// nearly every probe fails.  Doing the whole search here turns N x M failed stats into
+// a single message.
+//
+// The walk is done with our own lookups (rather than FinesseServerInternalNameLookup)
+// because we release each lookup as soon as we are done with it and we do not require
+// the node id to match the inode number.  Symbolic links are followed as a lookup
+// would; one we can't follow (it leaves the mount) is reported back and the client
+// resolves it.
+//
+
+//
+// Token is the negative cache snapshot for Name: a negative entry from the file system goes
+// into the cache.
+//
+static int PathSearchLookup(struct fuse_session *se, fuse_ino_t Parent, const char *Name, fuse_ino_t *Ino, uint32_t *Mode,
+                            const finesse_negative_token_t *Token)
+{
+    struct fuse_req *      fuse_request = NULL;
+    int                    status       = 0;
+    struct fuse_entry_out *arg          = NULL;
+    struct fuse_entry_out  entry;
+
+    *Ino  = 0;
+    *Mode = 0;
+
+    if (FinessePrefetchLookup(Parent, Name, strlen(Name), &entry)) {
+        *Ino  = entry.nodeid;
+        *Mode = entry.attr.mode;
+        return 0;
+    }
+
+    fuse_request = FinesseAllocInternalRequest(se, FUSE_LOOKUP);
+    if (NULL == fuse_request) {
+        return ENOMEM;
+    }
+
+    while (1) {
+        finesse_original_ops->lookup(fuse_request, Parent, Name);
+
+        status = FinesseInternalReplyStatus(fuse_request, sizeof(struct fuse_entry_out));
+        if (0 != status) {
+            break;
+        }
+
+        arg = ((struct finesse_req *)fuse_request)->iov[1].iov_base;
+        if (0 == arg->nodeid) {
+            // negative entry
+            FinesseNegativeAdd(Parent, Name, strlen(Name), Token, arg);
+            status = ENOENT;
+            break;
+        }
+
+        *Ino   = arg->nodeid;
+        *Mode  = arg->attr.mode;
+        status = 0;
+        break;
+    }
+
+    FinesseFreeFuseRequest(fuse_request);
+
+    return status;
+}
+
+//
+// The directories a walk has come down through, so that ".." (and a relative link) can go back
+// up without asking the file system, which might take us out of the mount.
+//
+typedef struct {
+    fuse_ino_t Ino;
+    int        Held;  // we hold a lookup reference on Ino
+} walk_level_t;
+
+static void WalkRelease(struct fuse_session *se, fuse_ino_t Ino, int Held)
+{
+    if (Held) {
+        FinesseReleaseInode(se, Ino);
+    }
+}
+
+//
+// Walk Path ('/' separated, relative to Parent).  On success *Ino is the final object and,
+// unless it is Parent itself, the caller owns a lookup reference on it.  A symlink part way
+// along is followed (symlink.c caches what it says), as is one at the end if Flags has
+// FINESSE_WALK_FOLLOW; otherwise the link itself is returned.  A link that points out of our
+// mount, or a ".." above the directories the walk came through, gives FINESSE_WALK_UNRESOLVED
+// and the client hands the call to the kernel.  Following more than FINESSE_WALK_MAX_LINKS
+// links gives ELOOP.  Misses go into the negative cache (negative.c).
+//
+int FinesseServerInternalWalk(struct fuse_session *se, fuse_ino_t Parent, const char *Path, int Flags, fuse_ino_t *Ino,
+                              uint32_t *Mode)
+{
+    fuse_ino_t                ino     = Parent;
+    int                       held    = 0;
+    uint32_t                  mode    = S_IFDIR;
+    fuse_ino_t                child   = 0;
+    int                       status  = 0;
+    const char *              cursor  = Path;
+    const char *              end     = NULL;
+    const char *              link    = NULL;
+    size_t                    length  = 0;
+    size_t                    rest    = 0;
+    size_t                    mp_length;
+    unsigned                  depth   = 0;
+    unsigned                  levels  = 0;
+    unsigned                  links   = 0;
+    int                       literal = 1;  // still walking Path as given, so the negative cache can remember it
+    finesse_negative_token_t *token   = NULL;
+    finesse_negative_token_t  tokens[FINESSE_NEGATIVE_PATH_DEPTH + 1];
+    walk_level_t              stack[FINESSE_WALK_MAX_DEPTH];
+    char                      name[NAME_MAX + 1];
+    char                      target[PATH_MAX];
+    char                      path[PATH_MAX];
+
+    if (FinesseNegativeLookupPath(Parent, Path)) {
+        *Ino  = 0;
+        *Mode = 0;
+        return ENOENT;
+    }
+
+    while (1) {
+        while ('/' == *cursor) {
+            cursor++;
+        }
+
+        if ('\0' == *cursor) {
+            break;
+        }
+
+        if (!S_ISDIR(mode)) {
+            // there's more path to go
+            status = ENOTDIR;
+            break;
+        }
+
+        end = index(cursor, '/');
+        if (NULL == end) {
+            end = cursor + strlen(cursor);
+        }
+        length = (size_t)(end - cursor);
+        cursor = end;
+
+        if ((1 == length) && ('.' == end[-1])) {
+            continue;
+        }
+
+        if ((2 == length) && ('.' == end[-1]) && ('.' == end[-2])) {
+            if (0 == levels) {
+                // might leave the file system; let the client do it
+                status = FINESSE_WALK_UNRESOLVED;
+                break;
+            }
+            WalkRelease(se, ino, held);
+            levels--;
+            ino     = stack[levels].Ino;
+            held    = stack[levels].Held;
+            literal = 0;
+            continue;
+        }
+
+        if (length > NAME_MAX) {
+            status = ENAMETOOLONG;
+            break;
+        }
+        memcpy(name, end - length, length);
+        name[length] = '\0';
+
+        // Past the depth a path can be remembered for, the last token is just scratch
+        token = &tokens[depth < FINESSE_NEGATIVE_PATH_DEPTH ? depth : FINESSE_NEGATIVE_PATH_DEPTH];
+        depth++;
+
+        if (FinesseNegativeLookup(ino, name, length, token)) {
+            child  = 0;
+            mode   = 0;
+            status = ENOENT;
+        }
+        else {
+            status = PathSearchLookup(se, ino, name, &child, &mode, token);
+        }
+
+        if ((ENOENT == status) && literal) {
+            FinesseNegativeAddPath(Parent, Path, (size_t)(end - Path), ino, tokens, depth);
+        }
+
+        if (0 != status) {
+            assert(0 == child);
+            break;
+        }
+
+        if (FINESSE_WALK_MAX_DEPTH == levels) {
+            FinesseReleaseInode(se, child);
+            status = FINESSE_WALK_UNRESOLVED;
+            break;
+        }
+        stack[levels].Ino  = ino;
+        stack[levels].Held = held;
+        levels++;
+        ino  = child;
+        held = 1;
+
+        // A trailing "/" means the link has to be followed too
+        if (!S_ISLNK(mode) || (('\0' == *cursor) && (0 == (Flags & FINESSE_WALK_FOLLOW)))) {
+            continue;
+        }
+
+        if (++links > FINESSE_WALK_MAX_LINKS) {
+            status = ELOOP;
+            break;
+        }
+
+        status = FinesseSymlinkRead(se, stack[levels - 1].Ino, name, ino, target, sizeof(target));
+        if (0 != status) {
+            if (ENOTSUP == status) {
+                status = FINESSE_WALK_UNRESOLVED;
+            }
+            break;
+        }
+
+        if ('\0' == target[0]) {
+            status = ENOENT;
+            break;
+        }
+
+        // Done with the link itself (symlink.c may keep our reference); we're back in its directory
+        WalkRelease(se, ino, held);
+        levels--;
+        ino     = stack[levels].Ino;
+        held    = stack[levels].Held;
+        mode    = S_IFDIR;
+        literal = 0;
+
+        link = target;
+        if ('/' == target[0]) {
+            mp_length = strlen(se->mountpoint);
+            if ((0 != strncmp(target, se->mountpoint, mp_length)) || (('/' != target[mp_length]) && ('\0' != target[mp_length]))) {
+                // Somewhere else entirely: the kernel has to follow this one
+                status = FINESSE_WALK_UNRESOLVED;
+                break;
+            }
+            link = target + mp_length;
+
+            // Start again from our root
+            WalkRelease(se, ino, held);
+            while (levels > 0) {
+                levels--;
+                WalkRelease(se, stack[levels].Ino, stack[levels].Held);
+            }
+            ino  = FUSE_ROOT_ID;
+            held = 0;
+        }
+
+        // What is left to walk is the link followed by the rest of the path (which, if there
+        // is any, starts with a "/"); the rest may already be in our buffer.
+        length = strlen(link);
+        rest   = strlen(cursor);
+        if (length + rest >= sizeof(path)) {
+            status = ENAMETOOLONG;
+            break;
+        }
+        memmove(path + length, cursor, rest + 1);
+        memcpy(path, link, length);
+        cursor = path;
+    }
+
+    while (levels > 0) {
+        levels--;
+        WalkRelease(se, stack[levels].Ino, stack[levels].Held);
+    }
+
+    if ((0 == status) && (ino == Parent)) {
+        // Parent is the caller's; we don't hand back a reference on it
+        WalkRelease(se, ino, held);
+        held = 0;
+    }
+    else if ((0 == status) && !held) {
+        // A link took us to our root, which we have no reference on to hand back
+        status = FINESSE_WALK_UNRESOLVED;
+    }
+
+    if (0 != status) {
+        WalkRelease(se, ino, held);
+        ino = 0;
+    }
+
+    *Ino  = ino;
+    *Mode = mode;
+    return status;
+}
+
+//
+// The directories the client sends are absolute; they must be inside our mount.
+//
+static int PathSearchWalkDirectory(struct fuse_session *se, const char *Path, fuse_ino_t *Ino)
+{
+    size_t   mp_length = strlen(se->mountpoint);
+    uint32_t mode      = 0;
+    int      status;
+
+    *Ino = 0;
+
+    if ((0 != strncmp(Path, se->mountpoint, mp_length)) || (('/' != Path[mp_length]) && ('\0' != Path[mp_length]))) {
+        return FINESSE_WALK_UNRESOLVED;
+    }
+
+    status = FinesseServerInternalWalk(se, FUSE_ROOT_ID, Path + mp_length, FINESSE_WALK_FOLLOW, Ino, &mode);
+
+    if ((0 == status) && !S_ISDIR(mode)) {
+        if (FUSE_ROOT_ID != *Ino) {
+            FinesseReleaseInode(se, *Ino);
+        }
+        *Ino   = 0;
+        status = ENOTDIR;
+    }
+
+    return status;
+}
+
+int FinesseServerNativePathSearchRequest(struct fuse_session *se, void *Client, fincomm_message Message)
+{
+    finesse_server_handle_t      fsh         = NULL;
+    finesse_msg *                fmsg        = (finesse_msg *)Message->Data;
+    int                          status      = 0;
+    int                          result      = 0;
+    uint32_t                     flags       = 0;
+    unsigned                     file_count  = 0;
+    unsigned                     path_count  = 0;
+    unsigned                     match_count = 0;
+    const char **                files       = NULL;
+    const char **                paths       = NULL;
+    char *                       data        = NULL;
+    size_t                       data_size   = 0;
+    size_t                       length      = 0;
+    finesse_path_search_match_t *matches     = NULL;
+    fuse_ino_t                   dir         = 0;
+    fuse_ino_t                   ino         = 0;
+    uint32_t                     mode        = 0;
+    int                          found       = 0;
+
+    fsh = (finesse_server_handle_t)se->server_handle;
+
+    if (NULL == fsh) {
+        return ENOTCONN;
+    }
+
+    while (1) {
+        flags      = fmsg->Message.Native.Request.Parameters.PathSearch.Flags;
+        file_count = fmsg->Message.Native.Request.Parameters.PathSearch.FileCount;
+        path_count = fmsg->Message.Native.Request.Parameters.PathSearch.PathCount;
+
+        if ((0 == file_count) || (0 == path_count)) {
+            // nothing to search for (or in); this also keeps the unresolved entries within matches
+            result = EINVAL;
+            break;
+        }
+
+        if (file_count * path_count > FINESSE_PATH_SEARCH_MAX_MATCHES) {
+            result = E2BIG;
+            break;
+        }
+
+        // The response is built in the same buffer, so take a copy of the strings first.
+        data_size = FinesseGetRequestDataLength(fsh, Client, Message) -
+                    offsetof(finesse_msg, Message.Native.Request.Parameters.PathSearch.Data);
+        data    = malloc(data_size);
+        files   = malloc((file_count + 1) * sizeof(const char *));
+        paths   = malloc((path_count + 1) * sizeof(const char *));
+        matches = malloc((file_count * path_count + 1) * sizeof(finesse_path_search_match_t));
+        if ((NULL == data) || (NULL == files) || (NULL == paths) || (NULL == matches)) {
+            result = ENOMEM;
+            break;
+        }
+        memcpy(data, fmsg->Message.Native.Request.Parameters.PathSearch.Data, data_size);
+
+        length = 0;
+        for (unsigned index = 0; index < file_count + path_count; index++) {
+            const char *str = data + length;
+            size_t      len = strnlen(str, data_size - length);
+
+            if (len == data_size - length) {
+                // not terminated within the message
+                result = EINVAL;
+                break;
+            }
+
+            if (index < file_count) {
+                files[index] = str;
+            }
+            else {
+                paths[index - file_count] = str;
+            }
+            length += len + 1;
+        }
+
+        if (0 != result) {
+            break;
+        }
+
+        for (unsigned path_index = 0; (path_index < path_count) && !found; path_index++) {
+            status = PathSearchWalkDirectory(se, paths[path_index], &dir);
+
+            if (FINESSE_WALK_UNRESOLVED == status) {
+                matches[match_count].FileIndex = FINESSE_PATH_SEARCH_UNRESOLVED;
+                matches[match_count].PathIndex = (uint16_t)path_index;
+                matches[match_count].Mode      = 0;
+                match_count++;
+                continue;
+            }
+
+            if (0 != status) {
+                // Nothing to find here
+                continue;
+            }
+
+            for (unsigned file_index = 0; file_index < file_count; file_index++) {
+                status = FinesseServerInternalWalk(se, dir, files[file_index], FINESSE_WALK_FOLLOW, &ino, &mode);
+
+                if (FINESSE_WALK_UNRESOLVED == status) {
+                    mode = S_IFLNK;  // the client will have to check it
+                }
+                else if (0 != status) {
+                    continue;
+                }
+                else {
+                    if (ino != dir) {
+                        FinesseReleaseInode(se, ino);
+                    }
+
+                    if (S_ISDIR(mode)) {
+                        continue;
+                    }
+                }
+
+                matches[match_count].FileIndex = (uint16_t)file_index;
+                matches[match_count].PathIndex = (uint16_t)path_index;
+                matches[match_count].Mode      = mode;
+                match_count++;
+
+                if (!S_ISLNK(mode) && (0 == (flags & FINESSE_PATH_SEARCH_ALL))) {
+                    found = 1;
+                    break;
+                }
+            }
+
+            if (FUSE_ROOT_ID != dir) {
+                FinesseReleaseInode(se, dir);
+            }
+            dir = 0;
+        }
+
+        assert(match_count <= file_count * path_count);
+        break;
+    }
+
+    status = FinesseSendPathSearchResponse(fsh, Client, Message, matches, 0 == result ? match_count : 0, result);
+
+    if (0 == status) {
+        FinesseCountNativeResponse(FINESSE_NATIVE_RSP_PATH_SEARCH);
+    }
+
+    if (NULL != matches) {
+        free(matches);
+    }
+
+    if (NULL != paths) {
+        free(paths);
+    }
+
+    if (NULL != files) {
+        free(files);
+    }
+
+    if (NULL != data) {
+        free(data);
+    }
+
+    return 0;
+}
@@ -0,0 +1,827 @@
+/*
+  Copyright (C) 2020  Tony Mason <fsgeek@cs.ubc.ca>
+*/
+#include "fs-internal.h"
+#include "finesse-metrics.h"
+#include <murmurhash3.h>
+
+//
+// Directory prefetch.
+//
+// A client that looks up one name in a directory very often goes on to look up its siblings
+// (a compiler scanning a header directory, make checking each object file, ls -l).  We watch
+// for that: once a client has looked up a few different names in the same directory, the
+// prefetch thread reads the directory with readdirplus and keeps what comes back, so the
+// sibling lookups - and the getattr a stat does after its lookup - are answered from memory
+// instead of by the file system.
+//
+// Each cached entry carries the lookup reference readdirplus took for it and a hit hands
+// that reference to the caller, so an entry is used once; looking the same name up again
+// goes to the file system as before.  Node ids are only stable while someone holds a
+// reference, so (as in negative.c) a directory other than the root isn't read until the
+// walk that noticed it donates its reference through FinesseReleaseInode, and we keep that
+// reference until the last entry under the directory is gone.
+//
+// An entry is dropped when its name is invalidated (see invalidate.c) and not used once the
+// attributes of what it names have been invalidated or it has expired; a directory read is
+// thrown away if a name in the directory changed while it was being read.  References are
+// given back by the prefetch thread, since invalidations arrive in contexts that can't call
+// into the file system.
+//
+// Tunables:
+//  FINESSE_PREFETCH_ENTRIES   - the most entries kept from one directory, 0 disables prefetch;
+//  FINESSE_PREFETCH_RATE      - the most entries read per second;
+//  FINESSE_PREFETCH_TIMEOUT   - how long (in milliseconds) an entry is good for, at most; the
+//                               entry timeout readdirplus returned can make it shorter;
+//  FINESSE_PREFETCH_THRESHOLD - how many different names a client looks up in a directory
+//                               before it is read.
+//
+// The metrics count the directories read, the entries cached, the hits and the entries
+// thrown away unused; hits against entries says whether prefetch is paying off.
+//
+#define FINESSE_PREFETCH_ENTRIES_ENV "FINESSE_PREFETCH_ENTRIES"  // per directory, 0 disables prefetch
+#define FINESSE_PREFETCH_RATE_ENV "FINESSE_PREFETCH_RATE"        // entries per second
+#define FINESSE_PREFETCH_TIMEOUT_ENV "FINESSE_PREFETCH_TIMEOUT"  // in ms
+#define FINESSE_PREFETCH_THRESHOLD_ENV "FINESSE_PREFETCH_THRESHOLD"
+#define FINESSE_PREFETCH_DEFAULT_ENTRIES (256)
+#define FINESSE_PREFETCH_DEFAULT_RATE (50000)
+#define FINESSE_PREFETCH_DEFAULT_TIMEOUT_MS (1000)
+#define FINESSE_PREFETCH_DEFAULT_THRESHOLD (2)
+#define FINESSE_PREFETCH_CACHE (4096)
+#define FINESSE_PREFETCH_DIRECTORIES (32)
+#define FINESSE_PREFETCH_QUEUE_LENGTH (8)
+#define FINESSE_PREFETCH_CLIENTS (SHM_MESSAGE_COUNT)
+#define FINESSE_PREFETCH_RECENT (4)  // directories remembered for each client
+#define FINESSE_PREFETCH_GENERATIONS (1024)
+#define FINESSE_PREFETCH_RELEASES (FINESSE_PREFETCH_CACHE + FINESSE_PREFETCH_DIRECTORIES)
+#define FINESSE_PREFETCH_READ_SIZE (64 * 1024)
+
+typedef enum {
+    PREFETCH_DIR_FREE = 0,
+    PREFETCH_DIR_WANTED,  // waiting for a reference on the directory
+    PREFETCH_DIR_QUEUED,
+    PREFETCH_DIR_READING,
+    PREFETCH_DIR_CACHED,
+} finesse_prefetch_dir_state_t;
+
+typedef struct _finesse_prefetch_dir {
+    fuse_ino_t                   Parent;
+    finesse_prefetch_dir_state_t State;
+    unsigned                     Pinned;   // we hold a lookup reference on Parent
+    unsigned                     Entries;  // cached entries under it
+    uint64_t                     Expires;  // CLOCK_MONOTONIC, in ns
+} finesse_prefetch_dir_t;
+
+typedef struct _finesse_prefetch_entry {
+    unsigned              Dir;  // index + 1, 0 = unused
+    uint32_t              Hash;
+    uint32_t              AttrGeneration;
+    uint16_t              Length;
+    uint64_t              Expires;  // CLOCK_MONOTONIC, in ns
+    char                  Name[NAME_MAX + 1];
+    struct fuse_entry_out Entry;
+} finesse_prefetch_entry_t;
+
+typedef struct _finesse_prefetch_recent {
+    fuse_ino_t Parent;    // 0 = unused
+    uint32_t   LastHash;  // of the last name looked up in it
+    unsigned   Names;     // changes of name since it was last read
+    uint64_t   Used;
+} finesse_prefetch_recent_t;
+
+static struct {
+    pthread_mutex_t           Lock;
+    pthread_cond_t            Cond;
+    int                       Running;
+    int                       Shutdown;
+    pthread_t                 Thread;
+    struct fuse_session *     Session;
+    unsigned                  MaxEntries;
+    unsigned                  Rate;  // entries per second
+    unsigned                  Threshold;
+    uint64_t                  Timeout;   // in ns
+    uint64_t                  NextSlot;  // when the rate limit allows the next directory read
+    uint64_t                  Clock;     // orders the recent lists
+    unsigned                  Head;
+    unsigned                  Count;
+    unsigned                  Queue[FINESSE_PREFETCH_QUEUE_LENGTH];
+    unsigned                  ReleaseCount;
+    uint64_t                  Directories;
+    uint64_t                  Entries;
+    uint64_t                  Hits;
+    uint64_t                  Wasted;
+    uint32_t                  DirGenerations[FINESSE_PREFETCH_GENERATIONS];
+    uint32_t                  AttrGenerations[FINESSE_PREFETCH_GENERATIONS];
+    uint32_t                  AttrSnapshot[FINESSE_PREFETCH_GENERATIONS];  // the prefetch thread's
+    finesse_prefetch_dir_t    Dirs[FINESSE_PREFETCH_DIRECTORIES];
+    finesse_prefetch_entry_t  Cache[FINESSE_PREFETCH_CACHE];
+    finesse_prefetch_recent_t Recent[FINESSE_PREFETCH_CLIENTS][FINESSE_PREFETCH_RECENT];
+    fuse_ino_t                Releases[FINESSE_PREFETCH_RELEASES];
+} FinessePrefetch = {
+    .Lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+//
+// The request this thread is working on: who sent it, and the last entry it got from us
+// (so that the getattr following a lookup can be answered too).
+//
+static __thread unsigned              PrefetchClient;
+static __thread struct fuse_entry_out PrefetchLastHit;
+static __thread uint32_t              PrefetchLastHitGeneration;
+
+static uint64_t FinessePrefetchDirectories(void *Context)
+{
+    (void)Context;
+    return __atomic_load_n(&FinessePrefetch.Directories, __ATOMIC_RELAXED);
+}
+
+static uint64_t FinessePrefetchEntries(void *Context)
+{
+    (void)Context;
+    return __atomic_load_n(&FinessePrefetch.Entries, __ATOMIC_RELAXED);
+}
+
+static uint64_t FinessePrefetchHits(void *Context)
+{
+    (void)Context;
+    return __atomic_load_n(&FinessePrefetch.Hits, __ATOMIC_RELAXED);
+}
+
+static uint64_t FinessePrefetchWasted(void *Context)
+{
+    (void)Context;
+    return __atomic_load_n(&FinessePrefetch.Wasted, __ATOMIC_RELAXED);
+}
+
+static uint64_t PrefetchNow(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+static uint32_t PrefetchHash(fuse_ino_t Ino, const char *Name, size_t Length)
+{
+    uint32_t hash;
+
+    MurmurHash3_x86_32(Name, (int)Length, (uint32_t)(Ino ^ (Ino >> 32)), &hash);
+    return hash;
+}
+
+//
+// The directory and entry records; these must be called with the lock held.
+//
+static void PrefetchRelease(fuse_ino_t Ino)
+{
+    if (FinessePrefetch.ReleaseCount < FINESSE_PREFETCH_RELEASES) {
+        FinessePrefetch.Releases[FinessePrefetch.ReleaseCount++] = Ino;
+        pthread_cond_signal(&FinessePrefetch.Cond);
+    }
+    else {
+        fuse_log(FUSE_LOG_ERR, "FINESSE %s: release queue full, leaking a reference on %lu\n", __func__, (unsigned long)Ino);
+    }
+}
+
+static finesse_prefetch_dir_t *PrefetchFindDir(fuse_ino_t Parent)
+{
+    for (unsigned index = 0; index < FINESSE_PREFETCH_DIRECTORIES; index++) {
+        if ((PREFETCH_DIR_FREE != FinessePrefetch.Dirs[index].State) && (Parent == FinessePrefetch.Dirs[index].Parent)) {
+            return &FinessePrefetch.Dirs[index];
+        }
+    }
+
+    return NULL;
+}
+
+static void PrefetchDropDir(finesse_prefetch_dir_t *Dir)
+{
+    assert(0 == Dir->Entries);
+
+    if (Dir->Pinned) {
+        PrefetchRelease(Dir->Parent);
+    }
+
+    Dir->Parent = 0;
+    Dir->State  = PREFETCH_DIR_FREE;
+    Dir->Pinned = 0;
+}
+
+static void PrefetchDropEntry(finesse_prefetch_entry_t *Entry, int Used)
+{
+    finesse_prefetch_dir_t *dir = &FinessePrefetch.Dirs[Entry->Dir - 1];
+
+    Entry->Dir = 0;
+    if (!Used) {
+        // Nobody took the reference
+        PrefetchRelease(Entry->Entry.nodeid);
+        FinessePrefetch.Wasted++;
+    }
+
+    assert(dir->Entries > 0);
+    if (0 == --dir->Entries) {
+        PrefetchDropDir(dir);
+    }
+}
+
+static void PrefetchDropEntries(finesse_prefetch_dir_t *Dir)
+{
+    unsigned dir_index = (unsigned)(Dir - FinessePrefetch.Dirs) + 1;
+
+    for (unsigned index = 0; (index < FINESSE_PREFETCH_CACHE) && (0 < Dir->Entries); index++) {
+        if (dir_index == FinessePrefetch.Cache[index].Dir) {
+            PrefetchDropEntry(&FinessePrefetch.Cache[index], 0);
+        }
+    }
+}
+
+static void PrefetchExpire(uint64_t Now)
+{
+    for (unsigned index = 0; index < FINESSE_PREFETCH_DIRECTORIES; index++) {
+        if ((PREFETCH_DIR_CACHED == FinessePrefetch.Dirs[index].State) && (Now >= FinessePrefetch.Dirs[index].Expires)) {
+            PrefetchDropEntries(&FinessePrefetch.Dirs[index]);
+        }
+    }
+}
+
+//
+// A free directory record: one not in use, or one still waiting for its reference, or
+// failing that the cached directory closest to expiring.
+//
+static finesse_prefetch_dir_t *PrefetchAllocDir(void)
+{
+    finesse_prefetch_dir_t *oldest = NULL;
+    finesse_prefetch_dir_t *dir    = NULL;
+
+    for (unsigned index = 0; index < FINESSE_PREFETCH_DIRECTORIES; index++) {
+        dir = &FinessePrefetch.Dirs[index];
+
+        if ((PREFETCH_DIR_FREE == dir->State) || (PREFETCH_DIR_WANTED == dir->State)) {
+            return dir;
+        }
+
+        if ((PREFETCH_DIR_CACHED == dir->State) && ((NULL == oldest) || (dir->Expires < oldest->Expires))) {
+            oldest = dir;
+        }
+    }
+
+    if (NULL != oldest) {
+        PrefetchDropEntries(oldest);
+        assert(PREFETCH_DIR_FREE == oldest->State);
+    }
+
+    return oldest;
+}
+
+static void PrefetchQueue(finesse_prefetch_dir_t *Dir)
+{
+    if (FINESSE_PREFETCH_QUEUE_LENGTH == FinessePrefetch.Count) {
+        // The prefetch thread is behind; forget it
+        PrefetchDropDir(Dir);
+        return;
+    }
+
+    Dir->State = PREFETCH_DIR_QUEUED;
+    FinessePrefetch.Queue[(FinessePrefetch.Head + FinessePrefetch.Count) % FINESSE_PREFETCH_QUEUE_LENGTH] =
+        (unsigned)(Dir - FinessePrefetch.Dirs);
+    FinessePrefetch.Count++;
+    pthread_cond_signal(&FinessePrefetch.Cond);
+}
+
+static void PrefetchWant(fuse_ino_t Parent)
+{
+    finesse_prefetch_dir_t *dir = PrefetchFindDir(Parent);
+
+    if (NULL != dir) {
+        return;  // already on its way, or cached
+    }
+
+    dir = PrefetchAllocDir();
+    if (NULL == dir) {
+        return;
+    }
+
+    dir->Parent  = Parent;
+    dir->State   = PREFETCH_DIR_WANTED;
+    dir->Pinned  = 0;
+    dir->Entries = 0;
+
+    if (FUSE_ROOT_ID == Parent) {
+        // never goes away, so there's no need to wait for a reference
+        PrefetchQueue(dir);
+    }
+}
+
+//
+// Note the client whose request this thread is about to work on.
+//
+void FinessePrefetchSetClient(void *Client)
+{
+    PrefetchClient         = (unsigned)(uintptr_t)Client;
+    PrefetchLastHit.nodeid = 0;
+}
+
+//
+// Returns 1 (and the entry, whose lookup reference now belongs to the caller) if we have
+// Name in Parent.  Otherwise the lookup counts toward reading Parent.
+//
+int FinessePrefetchLookup(fuse_ino_t Parent, const char *Name, size_t Length, struct fuse_entry_out *Entry)
+{
+    finesse_prefetch_entry_t * entry;
+    finesse_prefetch_recent_t *recent;
+    finesse_prefetch_recent_t *slot = NULL;
+    uint32_t                   hash;
+    int                        hit = 0;
+
+    if (0 == __atomic_load_n(&FinessePrefetch.Running, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+
+    hash   = PrefetchHash(Parent, Name, Length);
+    entry  = &FinessePrefetch.Cache[hash % FINESSE_PREFETCH_CACHE];
+    recent = FinessePrefetch.Recent[PrefetchClient % FINESSE_PREFETCH_CLIENTS];
+
+    pthread_mutex_lock(&FinessePrefetch.Lock);
+    while (1) {
+        if ((0 != entry->Dir) && (Parent == FinessePrefetch.Dirs[entry->Dir - 1].Parent) && (hash == entry->Hash) &&
+            (Length == entry->Length) && (0 == memcmp(Name, entry->Name, Length))) {
+            if ((PrefetchNow() < entry->Expires) &&
+                (entry->AttrGeneration ==
+                 FinessePrefetch.AttrGenerations[entry->Entry.nodeid % FINESSE_PREFETCH_GENERATIONS])) {
+                *Entry                    = entry->Entry;
+                PrefetchLastHit           = entry->Entry;
+                PrefetchLastHitGeneration = entry->AttrGeneration;
+                PrefetchDropEntry(entry, 1);
+                FinessePrefetch.Hits++;
+                hit = 1;
+                break;
+            }
+            PrefetchDropEntry(entry, 0);
+        }
+
+        // A miss: has this client been looking around this directory?
+        for (unsigned index = 0; index < FINESSE_PREFETCH_RECENT; index++) {
+            if (Parent == recent[index].Parent) {
+                slot = &recent[index];
+                break;
+            }
+
+            if ((NULL == slot) || (recent[index].Used < slot->Used)) {
+                slot = &recent[index];
+            }
+        }
+
+        if (Parent != slot->Parent) {
+            slot->Parent   = Parent;
+            slot->LastHash = hash;
+            slot->Names    = 0;
+        }
+        else if (hash != slot->LastHash) {
+            // Looking up the same name over and over (a directory on the way somewhere else) doesn't count
+            slot->LastHash = hash;
+            slot->Names++;
+        }
+        slot->Used = ++FinessePrefetch.Clock;
+
+        if (slot->Names + 1 >= FinessePrefetch.Threshold) {
+            slot->Names = 0;
+            PrefetchWant(Parent);
+        }
+        break;
+    }
+    pthread_mutex_unlock(&FinessePrefetch.Lock);
+
+    return hit;
+}
+
+//
+// Returns 1 (and the attributes) if the last entry this thread got from FinessePrefetchLookup
+// is for Ino and its attributes haven't changed since the directory was read.
+//
+int FinessePrefetchGetAttr(fuse_ino_t Ino, struct stat *Attr, double *Timeout)
+{
+    int found = 0;
+
+    if ((0 != PrefetchLastHit.nodeid) && (Ino == PrefetchLastHit.nodeid) &&
+        (PrefetchLastHitGeneration ==
+         __atomic_load_n(&FinessePrefetch.AttrGenerations[Ino % FINESSE_PREFETCH_GENERATIONS], __ATOMIC_ACQUIRE))) {
+        FinesseFuseAttrToStat(&PrefetchLastHit.attr, Attr);
+        *Timeout = (double)PrefetchLastHit.attr_valid + ((double)PrefetchLastHit.attr_valid_nsec / 1.0e9);
+        found    = 1;
+    }
+
+    PrefetchLastHit.nodeid = 0;
+
+    return found;
+}
+
+//
+// Name (in Parent) has been created, removed or renamed.  This can be called from any context.
+//
+void FinessePrefetchInvalidate(fuse_ino_t Parent, const char *Name, size_t Length)
+{
+    finesse_prefetch_entry_t *entry;
+    uint32_t                  hash;
+
+    if (0 == __atomic_load_n(&FinessePrefetch.Running, __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    hash  = PrefetchHash(Parent, Name, Length);
+    entry = &FinessePrefetch.Cache[hash % FINESSE_PREFETCH_CACHE];
+
+    // A read of the directory that's in progress won't be kept
+    __atomic_add_fetch(&FinessePrefetch.DirGenerations[Parent % FINESSE_PREFETCH_GENERATIONS], 1, __ATOMIC_RELEASE);
+
+    pthread_mutex_lock(&FinessePrefetch.Lock);
+    if ((0 != entry->Dir) && (Parent == FinessePrefetch.Dirs[entry->Dir - 1].Parent) && (Length == entry->Length) &&
+        (0 == memcmp(Name, entry->Name, Length))) {
+        PrefetchDropEntry(entry, 0);
+    }
+    pthread_mutex_unlock(&FinessePrefetch.Lock);
+}
+
+//
+// The attributes of Ino have changed.  This can be called from any context.
+//
+void FinessePrefetchInvalidateInode(fuse_ino_t Ino)
+{
+    __atomic_add_fetch(&FinessePrefetch.AttrGenerations[Ino % FINESSE_PREFETCH_GENERATIONS], 1, __ATOMIC_RELEASE);
+}
+
+//
+// Called by FinesseReleaseInode: returns 1 if we keep the caller's reference on Ino (because
+// it is a directory we want to read).
+//
+int FinessePrefetchKeepInode(fuse_ino_t Ino)
+{
+    finesse_prefetch_dir_t *dir;
+    int                     keep = 0;
+
+    if (0 == __atomic_load_n(&FinessePrefetch.Running, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&FinessePrefetch.Lock);
+    dir = PrefetchFindDir(Ino);
+    if ((NULL != dir) && (PREFETCH_DIR_WANTED == dir->State)) {
+        dir->Pinned = 1;
+        keep        = 1;
+        PrefetchQueue(dir);
+    }
+    pthread_mutex_unlock(&FinessePrefetch.Lock);
+
+    return keep;
+}
+
+static int PrefetchOpen(struct fuse_session *se, fuse_ino_t Ino, struct fuse_file_info *Fi)
+{
+    struct fuse_req *   fuse_request = NULL;
+    struct finesse_req *finesse_request;
+    int                 status;
+
+    memset(Fi, 0, sizeof(struct fuse_file_info));
+    Fi->flags = O_RDONLY | O_DIRECTORY;
+
+    if (NULL == finesse_original_ops->opendir) {
+        return 0;
+    }
+
+    fuse_request = FinesseAllocInternalRequest(se, FUSE_OPENDIR);
+    if (NULL == fuse_request) {
+        return ENOMEM;
+    }
+    finesse_request = (struct finesse_req *)fuse_request;
+
+    finesse_original_ops->opendir(fuse_request, Ino, Fi);
+    status = FinesseInternalReplyStatus(fuse_request, sizeof(struct fuse_open_out));
+    if (0 == status) {
+        Fi->fh = ((struct fuse_open_out *)finesse_request->iov[1].iov_base)->fh;
+    }
+
+    FinesseFreeFuseRequest(fuse_request);
+
+    return status;
+}
+
+static void PrefetchClose(struct fuse_session *se, fuse_ino_t Ino, struct fuse_file_info *Fi)
+{
+    struct fuse_req *fuse_request = NULL;
+
+    if (NULL == finesse_original_ops->releasedir) {
+        return;
+    }
+
+    fuse_request = FinesseAllocInternalRequest(se, FUSE_RELEASEDIR);
+    if (NULL != fuse_request) {
+        finesse_original_ops->releasedir(fuse_request, Ino, Fi);
+        (void)FinesseInternalReplyStatus(fuse_request, 0);
+        FinesseFreeFuseRequest(fuse_request);
+    }
+}
+
+//
+// Read (up to MaxEntries of) the directory into Pending.  Returns the number of entries read;
+// each holds a lookup reference.
+//
+static unsigned PrefetchReadDir(struct fuse_session *se, fuse_ino_t Parent, finesse_prefetch_entry_t *Pending)
+{
+    struct fuse_req *     fuse_request    = NULL;
+    struct finesse_req *  finesse_request = NULL;
+    struct fuse_file_info fi;
+    unsigned              count  = 0;
+    off_t                 offset = 0;
+    const char *          data;
+    size_t                data_length;
+    size_t                position;
+
+    if (0 != PrefetchOpen(se, Parent, &fi)) {
+        return 0;
+    }
+
+    while (count < FinessePrefetch.MaxEntries) {
+        fuse_request = FinesseAllocInternalRequest(se, FUSE_READDIRPLUS);
+        if (NULL == fuse_request) {
+            break;
+        }
+        finesse_request = (struct finesse_req *)fuse_request;
+
+        finesse_original_ops->readdirplus(fuse_request, Parent, FINESSE_PREFETCH_READ_SIZE, offset, &fi);
+        if ((0 != FinesseInternalReplyStatus(fuse_request, 0)) || (finesse_request->iov_count < 2) || (0 == finesse_request->iov[1].iov_len)) {
+            // error or end of directory
+            FinesseFreeFuseRequest(fuse_request);
+            break;
+        }
+
+        data        = finesse_request->iov[1].iov_base;
+        data_length = finesse_request->iov[1].iov_len;
+        position    = 0;
+
+        while (position < data_length) {
+            const struct fuse_direntplus *direntplus = (const struct fuse_direntplus *)(data + position);
+            const struct fuse_dirent *    dirent     = &direntplus->dirent;
+
+            assert(position + FUSE_NAME_OFFSET_DIRENTPLUS <= data_length);
+            position += FUSE_DIRENTPLUS_SIZE(direntplus);
+            offset = (off_t)dirent->off;
+
+            if (0 == direntplus->entry_out.nodeid) {
+                // "." and ".." (which aren't looked up), or an entry the file system didn't look up
+                continue;
+            }
+
+            if ((count < FinessePrefetch.MaxEntries) && (dirent->namelen <= NAME_MAX)) {
+                Pending[count].Entry  = direntplus->entry_out;
+                Pending[count].Length = (uint16_t)dirent->namelen;
+                memcpy(Pending[count].Name, dirent->name, dirent->namelen);
+                Pending[count].Name[dirent->namelen] = '\0';
+                count++;
+            }
+            else {
+                FinesseReleaseInode(se, direntplus->entry_out.nodeid);
+            }
+        }
+
+        FinesseFreeFuseRequest(fuse_request);
+    }
+
+    PrefetchClose(se, Parent, &fi);
+
+    return count;
+}
+
+//
+// Read the directory and cache what we found, unless something in it changed while we were
+// reading.  Called by the prefetch thread (without the lock).
+//
+static void PrefetchDirectory(struct fuse_session *se, unsigned Index, finesse_prefetch_entry_t *Pending)
+{
+    finesse_prefetch_dir_t *  dir = &FinessePrefetch.Dirs[Index];
+    finesse_prefetch_entry_t *entry;
+    fuse_ino_t                parent;
+    uint32_t                  generation;
+    uint64_t                  now;
+    uint64_t                  valid;
+    unsigned                  count;
+    unsigned                  cached = 0;
+
+    pthread_mutex_lock(&FinessePrefetch.Lock);
+    parent     = dir->Parent;
+    generation = FinessePrefetch.DirGenerations[parent % FINESSE_PREFETCH_GENERATIONS];
+    memcpy(FinessePrefetch.AttrSnapshot, FinessePrefetch.AttrGenerations, sizeof(FinessePrefetch.AttrSnapshot));
+    pthread_mutex_unlock(&FinessePrefetch.Lock);
+
+    // Timeouts count from before the read, as the file system's do
+    now   = PrefetchNow();
+    count = PrefetchReadDir(se, parent, Pending);
+
+    pthread_mutex_lock(&FinessePrefetch.Lock);
+    assert(PREFETCH_DIR_READING == dir->State);
+    dir->State   = PREFETCH_DIR_CACHED;
+    dir->Expires = now + FinessePrefetch.Timeout;
+    dir->Entries = 1;  // so it doesn't go away while we're filling it in
+
+    for (unsigned index = 0; index < count; index++) {
+        fuse_ino_t nodeid = Pending[index].Entry.nodeid;
+        uint32_t   attr   = FinessePrefetch.AttrSnapshot[nodeid % FINESSE_PREFETCH_GENERATIONS];
+
+        if ((generation != FinessePrefetch.DirGenerations[parent % FINESSE_PREFETCH_GENERATIONS]) ||
+            (attr != FinessePrefetch.AttrGenerations[nodeid % FINESSE_PREFETCH_GENERATIONS]) || FinessePrefetch.Shutdown) {
+            continue;  // stale; released below
+        }
+
+        // No longer than the file system said the entry is good for
+        valid = FinessePrefetch.Timeout;
+        if (Pending[index].Entry.entry_valid < valid / 1000000000ull) {
+            valid = Pending[index].Entry.entry_valid * 1000000000ull + Pending[index].Entry.entry_valid_nsec;
+            if (valid > FinessePrefetch.Timeout) {
+                valid = FinessePrefetch.Timeout;
+            }
+        }
+
+        if (0 == valid) {
+            continue;  // not to be cached at all; released below
+        }
+        Pending[index].Expires = now + valid;
+
+        Pending[index].Hash = PrefetchHash(parent, Pending[index].Name, Pending[index].Length);
+        entry               = &FinessePrefetch.Cache[Pending[index].Hash % FINESSE_PREFETCH_CACHE];
+        if (0 != entry->Dir) {
+            PrefetchDropEntry(entry, 0);
+        }
+
+        *entry                = Pending[index];
+        entry->Dir            = Index + 1;
+        entry->AttrGeneration = attr;
+        dir->Entries++;
+        cached++;
+        Pending[index].Entry.nodeid = 0;
+    }
+
+    if (0 == --dir->Entries) {
+        PrefetchDropDir(dir);
+    }
+    FinessePrefetch.NextSlot = PrefetchNow() + (uint64_t)count * 1000000000ull / FinessePrefetch.Rate;
+    FinessePrefetch.Directories++;
+    FinessePrefetch.Entries += cached;
+    FinessePrefetch.Wasted += count - cached;
+    pthread_mutex_unlock(&FinessePrefetch.Lock);
+
+    for (unsigned index = 0; index < count; index++) {
+        if (0 != Pending[index].Entry.nodeid) {
+            FinesseReleaseInode(se, Pending[index].Entry.nodeid);
+        }
+    }
+}
+
+static void PrefetchDeadline(uint64_t When, struct timespec *Deadline)
+{
+    Deadline->tv_sec  = (time_t)(When / 1000000000ull);
+    Deadline->tv_nsec = (long)(When % 1000000000ull);
+}
+
+static void *FinessePrefetchWorker(void *Context)
+{
+    finesse_prefetch_entry_t *pending = (finesse_prefetch_entry_t *)Context;
+    struct timespec           deadline;
+    uint64_t                  now;
+    fuse_ino_t                ino;
+    unsigned                  index;
+
+    pthread_mutex_lock(&FinessePrefetch.Lock);
+    while (0 == FinessePrefetch.Shutdown) {
+        now = PrefetchNow();
+        PrefetchExpire(now);
+
+        if (FinessePrefetch.ReleaseCount > 0) {
+            ino = FinessePrefetch.Releases[--FinessePrefetch.ReleaseCount];
+            pthread_mutex_unlock(&FinessePrefetch.Lock);
+            FinesseReleaseInode(FinessePrefetch.Session, ino);
+            pthread_mutex_lock(&FinessePrefetch.Lock);
+            continue;
+        }
+
+        if ((0 == FinessePrefetch.Count) || (now < FinessePrefetch.NextSlot)) {
+            // Wake up to expire entries even if nothing else happens
+            PrefetchDeadline(0 == FinessePrefetch.Count ? now + FinessePrefetch.Timeout : FinessePrefetch.NextSlot, &deadline);
+            pthread_cond_timedwait(&FinessePrefetch.Cond, &FinessePrefetch.Lock, &deadline);
+            continue;
+        }
+
+        index                = FinessePrefetch.Queue[FinessePrefetch.Head];
+        FinessePrefetch.Head = (FinessePrefetch.Head + 1) % FINESSE_PREFETCH_QUEUE_LENGTH;
+        FinessePrefetch.Count--;
+        FinessePrefetch.Dirs[index].State = PREFETCH_DIR_READING;
+
+        pthread_mutex_unlock(&FinessePrefetch.Lock);
+        PrefetchDirectory(FinessePrefetch.Session, index, pending);
+        pthread_mutex_lock(&FinessePrefetch.Lock);
+    }
+    pthread_mutex_unlock(&FinessePrefetch.Lock);
+
+    free(pending);
+
+    return NULL;
+}
+
+static unsigned PrefetchGetTunable(const char *Name, unsigned Default)
+{
+    const char *value = getenv(Name);
+
+    return NULL == value ? Default : (unsigned)strtoul(value, NULL, 0);
+}
+
+//
+// Start the prefetch thread; see the top of this file for the tunables.
+//
+int FinessePrefetchStart(struct fuse_session *se)
+{
+    pthread_condattr_t        condattr;
+    finesse_prefetch_entry_t *pending = NULL;
+    int                       status;
+
+    assert(NULL != se);
+    assert(0 == FinessePrefetch.Running);
+
+    FinessePrefetch.MaxEntries = PrefetchGetTunable(FINESSE_PREFETCH_ENTRIES_ENV, FINESSE_PREFETCH_DEFAULT_ENTRIES);
+    FinessePrefetch.Rate       = PrefetchGetTunable(FINESSE_PREFETCH_RATE_ENV, FINESSE_PREFETCH_DEFAULT_RATE);
+    FinessePrefetch.Threshold  = PrefetchGetTunable(FINESSE_PREFETCH_THRESHOLD_ENV, FINESSE_PREFETCH_DEFAULT_THRESHOLD);
+    FinessePrefetch.Timeout =
+        (uint64_t)PrefetchGetTunable(FINESSE_PREFETCH_TIMEOUT_ENV, FINESSE_PREFETCH_DEFAULT_TIMEOUT_MS) * 1000000;
+
+    if ((0 == FinessePrefetch.MaxEntries) || (0 == FinessePrefetch.Rate) || (0 == FinessePrefetch.Timeout) ||
+        (NULL == finesse_original_ops->readdirplus) || (NULL == finesse_original_ops->lookup)) {
+        return 0;  // disabled (or the file system can't do it)
+    }
+
+    if (FinessePrefetch.MaxEntries > FINESSE_PREFETCH_CACHE) {
+        FinessePrefetch.MaxEntries = FINESSE_PREFETCH_CACHE;
+    }
+
+    pending = malloc(FinessePrefetch.MaxEntries * sizeof(finesse_prefetch_entry_t));
+    if (NULL == pending) {
+        return ENOMEM;
+    }
+
+    pthread_condattr_init(&condattr);
+    pthread_condattr_setclock(&condattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&FinessePrefetch.Cond, &condattr);
+    pthread_condattr_destroy(&condattr);
+
+    pthread_mutex_lock(&FinessePrefetch.Lock);
+    memset(FinessePrefetch.Dirs, 0, sizeof(FinessePrefetch.Dirs));
+    memset(FinessePrefetch.Cache, 0, sizeof(FinessePrefetch.Cache));
+    memset(FinessePrefetch.Recent, 0, sizeof(FinessePrefetch.Recent));
+    FinessePrefetch.Session      = se;
+    FinessePrefetch.Head         = 0;
+    FinessePrefetch.Count        = 0;
+    FinessePrefetch.ReleaseCount = 0;
+    FinessePrefetch.NextSlot     = 0;
+    FinessePrefetch.Shutdown     = 0;
+    pthread_mutex_unlock(&FinessePrefetch.Lock);
+
+    status = pthread_create(&FinessePrefetch.Thread, NULL, FinessePrefetchWorker, pending);
+    if (0 != status) {
+        pthread_cond_destroy(&FinessePrefetch.Cond);
+        free(pending);
+        return status;
+    }
+    __atomic_store_n(&FinessePrefetch.Running, 1, __ATOMIC_RELEASE);
+
+    FinesseMetricsRegisterCounter("finesse prefetch directories", FinessePrefetchDirectories, NULL);
+    FinesseMetricsRegisterCounter("finesse prefetch entries", FinessePrefetchEntries, NULL);
+    FinesseMetricsRegisterCounter("finesse prefetch hits", FinessePrefetchHits, NULL);
+    FinesseMetricsRegisterCounter("finesse prefetch wasted", FinessePrefetchWasted, NULL);
+
+    fuse_log(FUSE_LOG_INFO, "FINESSE %s: prefetching up to %u entries a directory, %u entries/s, after %u names\n", __func__,
+             FinessePrefetch.MaxEntries, FinessePrefetch.Rate, FinessePrefetch.Threshold);
+
+    return 0;
+}
+
+//
+// As with the negative cache, the references we hold are simply dropped: the session is
+// going away.
+//
+void FinessePrefetchStop(void)
+{
+    if (0 == FinessePrefetch.Running) {
+        return;
+    }
+
+    FinesseMetricsUnregisterCounter(FinessePrefetchDirectories, NULL);
+    FinesseMetricsUnregisterCounter(FinessePrefetchEntries, NULL);
+    FinesseMetricsUnregisterCounter(FinessePrefetchHits, NULL);
+    FinesseMetricsUnregisterCounter(FinessePrefetchWasted, NULL);
+
+    pthread_mutex_lock(&FinessePrefetch.Lock);
+    __atomic_store_n(&FinessePrefetch.Running, 0, __ATOMIC_RELAXED);
+    FinessePrefetch.Shutdown = 1;
+    pthread_cond_broadcast(&FinessePrefetch.Cond);
+    pthread_mutex_unlock(&FinessePrefetch.Lock);
+
+    pthread_join(FinessePrefetch.Thread, NULL);
+    pthread_cond_destroy(&FinessePrefetch.Cond);
+    FinessePrefetch.ReleaseCount = 0;
+    FinessePrefetch.Session      = NULL;
+}
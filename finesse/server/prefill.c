@@ -0,0 +1,480 @@
+/*
+  Copyright (C) 2020  Tony Mason <fsgeek@cs.ubc.ca>
+*/
+#include "fs-internal.h"
+#include "finesse-metrics.h"
+
+//
+// Page cache prefill.
+//
+// When a client looks like it is about to read a file sequentially, push the
+// upcoming part of the file into the kernel page cache with
+// fuse_lowlevel_notify_store, so that later reads through the kernel - from
+// any process, whether or not it uses the Finesse library - hit the cache.
+//
+// Two things start a prefill:
+//  - a client maps a file for reading (an open through the Finesse library):
+//    the first window of the file is pushed;
+//  - the kernel sends sequential READs for a file: the window beyond the last
+//    read is pushed once the reader is halfway through what was pushed before.
+//
+// All of the work is done by a single prefill thread.  The queue in front of
+// it is bounded and the thread is held to a configurable byte rate, so when
+// it cannot keep up prefill requests are dropped rather than allowed to eat
+// memory.
+//
+// Anything that changes a file's contents or size (write, truncate, fallocate
+// and so on) calls FinessePrefillNoteChange, which throws away what we knew
+// about the file.  Data read before the change must not reach the page cache
+// after it, so the prefill thread checks for a change before each chunk and
+// again after storing it; in the second case it invalidates what it stored.
+//
+#define FINESSE_PREFILL_WINDOW_ENV "FINESSE_PREFILL_WINDOW"  // in KiB, 0 disables prefill
+#define FINESSE_PREFILL_RATE_ENV "FINESSE_PREFILL_RATE"      // in MiB/s
+#define FINESSE_PREFILL_DEFAULT_WINDOW_KB (1024)
+#define FINESSE_PREFILL_DEFAULT_RATE_MB (64)
+#define FINESSE_PREFILL_CHUNK (128 * 1024)
+#define FINESSE_PREFILL_QUEUE_LENGTH (64)
+#define FINESSE_PREFILL_STREAMS (256)
+#define FINESSE_PREFILL_SEQUENTIAL_READS (2)  // before a stream counts as sequential
+
+typedef struct _finesse_prefill_stream {
+    fuse_ino_t Inode;
+    off_t      NextOffset;  // where the next sequential read would start
+    off_t      FilledTo;    // end of what has been queued for prefill
+    unsigned   Sequential;  // consecutive sequential reads seen
+} finesse_prefill_stream_t;
+
+typedef struct _finesse_prefill_work {
+    fuse_ino_t Inode;
+    off_t      Offset;
+    size_t     Length;
+} finesse_prefill_work_t;
+
+static struct {
+    pthread_mutex_t          Lock;
+    pthread_cond_t           Cond;
+    int                      Running;
+    int                      Shutdown;
+    pthread_t                Thread;
+    struct fuse_session *    Session;
+    size_t                   Window;
+    uint64_t                 Rate;       // bytes per second
+    struct timespec          NextSlot;   // when the rate limit allows the next chunk
+    unsigned                 Head;
+    unsigned                 Count;
+    finesse_prefill_work_t   Queue[FINESSE_PREFILL_QUEUE_LENGTH];
+    finesse_prefill_stream_t Streams[FINESSE_PREFILL_STREAMS];
+    fuse_ino_t               Active;         // inode the prefill thread is working on
+    int                      ActiveChanged;  // and whether it changed since the thread started
+    uint64_t                 BytesStored;
+    uint64_t                 Dropped;
+} FinessePrefill = {
+    .Lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static uint64_t FinessePrefillBytesStored(void *Context)
+{
+    (void)Context;
+    return __atomic_load_n(&FinessePrefill.BytesStored, __ATOMIC_RELAXED);
+}
+
+static uint64_t FinessePrefillDropped(void *Context)
+{
+    (void)Context;
+    return __atomic_load_n(&FinessePrefill.Dropped, __ATOMIC_RELAXED);
+}
+
+//
+// Queue a range for the prefill thread.  Must be called with the lock held.
+//
+static void FinessePrefillQueue(fuse_ino_t Inode, off_t Offset, size_t Length)
+{
+    finesse_prefill_work_t *work;
+
+    if (FINESSE_PREFILL_QUEUE_LENGTH == FinessePrefill.Count) {
+        FinessePrefill.Dropped++;
+        return;
+    }
+
+    work         = &FinessePrefill.Queue[(FinessePrefill.Head + FinessePrefill.Count) % FINESSE_PREFILL_QUEUE_LENGTH];
+    work->Inode  = Inode;
+    work->Offset = Offset;
+    work->Length = Length;
+    FinessePrefill.Count++;
+    pthread_cond_signal(&FinessePrefill.Cond);
+}
+
+void FinessePrefillNoteOpen(fuse_ino_t Inode, int Flags)
+{
+    finesse_prefill_stream_t *stream;
+
+    if ((0 == __atomic_load_n(&FinessePrefill.Running, __ATOMIC_RELAXED)) || (O_RDONLY != (Flags & O_ACCMODE)) ||
+        (0 != (Flags & (O_TRUNC | O_DIRECTORY)))) {
+        return;
+    }
+
+    pthread_mutex_lock(&FinessePrefill.Lock);
+    stream = &FinessePrefill.Streams[Inode % FINESSE_PREFILL_STREAMS];
+    if ((stream->Inode != Inode) || (stream->FilledTo < (off_t)FinessePrefill.Window)) {
+        stream->Inode      = Inode;
+        stream->NextOffset = 0;
+        stream->FilledTo   = FinessePrefill.Window;
+        stream->Sequential = FINESSE_PREFILL_SEQUENTIAL_READS;
+        FinessePrefillQueue(Inode, 0, FinessePrefill.Window);
+    }
+    pthread_mutex_unlock(&FinessePrefill.Lock);
+}
+
+void FinessePrefillNoteRead(fuse_ino_t Inode, off_t Offset, size_t Size)
+{
+    finesse_prefill_stream_t *stream;
+    off_t                     start;
+
+    if (0 == __atomic_load_n(&FinessePrefill.Running, __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    pthread_mutex_lock(&FinessePrefill.Lock);
+    stream = &FinessePrefill.Streams[Inode % FINESSE_PREFILL_STREAMS];
+
+    while (1) {
+        // Reads the prefill satisfied never reach us, so a reader that moved into
+        // the prefilled range is still sequential.
+        if ((stream->Inode != Inode) || (Offset < stream->NextOffset) ||
+            ((Offset > stream->NextOffset) && (Offset > stream->FilledTo))) {
+            // A new stream, or a random read: start over
+            stream->Inode      = Inode;
+            stream->NextOffset = Offset + Size;
+            stream->FilledTo   = 0;
+            stream->Sequential = 0;
+            break;
+        }
+
+        stream->NextOffset = Offset + Size;
+        if (stream->Sequential < FINESSE_PREFILL_SEQUENTIAL_READS) {
+            stream->Sequential++;
+            break;
+        }
+
+        if (stream->FilledTo - stream->NextOffset > (off_t)FinessePrefill.Window / 2) {
+            break;  // still well ahead of the reader
+        }
+
+        start = stream->FilledTo > stream->NextOffset ? stream->FilledTo : stream->NextOffset;
+        stream->FilledTo = start + FinessePrefill.Window;
+        FinessePrefillQueue(Inode, start, FinessePrefill.Window);
+        break;
+    }
+
+    pthread_mutex_unlock(&FinessePrefill.Lock);
+}
+
+//
+// Something is about to change (or has just changed) the contents or size of
+// Inode.  Forget its stream, drop any queued work for it and tell the prefill
+// thread if it is working on it.  Returns non-zero if prefill had any interest
+// in Inode, in which case the caller should call again once the change has
+// been made: a read the prefill thread issued while the change was in
+// progress may have seen the old data.
+//
+int FinessePrefillNoteChange(fuse_ino_t Inode)
+{
+    finesse_prefill_stream_t *stream;
+    finesse_prefill_work_t *  work;
+    unsigned                  index;
+    unsigned                  kept       = 0;
+    int                       interested = 0;
+
+    if (0 == __atomic_load_n(&FinessePrefill.Running, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&FinessePrefill.Lock);
+
+    stream = &FinessePrefill.Streams[Inode % FINESSE_PREFILL_STREAMS];
+    if (stream->Inode == Inode) {
+        memset(stream, 0, sizeof(finesse_prefill_stream_t));
+        interested = 1;
+    }
+
+    for (index = 0; index < FinessePrefill.Count; index++) {
+        work = &FinessePrefill.Queue[(FinessePrefill.Head + index) % FINESSE_PREFILL_QUEUE_LENGTH];
+        if (work->Inode == Inode) {
+            interested = 1;
+            continue;
+        }
+        FinessePrefill.Queue[(FinessePrefill.Head + kept) % FINESSE_PREFILL_QUEUE_LENGTH] = *work;
+        kept++;
+    }
+    FinessePrefill.Count = kept;
+
+    if (FinessePrefill.Active == Inode) {
+        FinessePrefill.ActiveChanged = 1;
+        interested                   = 1;
+    }
+
+    pthread_mutex_unlock(&FinessePrefill.Lock);
+
+    return interested;
+}
+
+static int FinessePrefillActiveChanged(void)
+{
+    int changed;
+
+    pthread_mutex_lock(&FinessePrefill.Lock);
+    changed = FinessePrefill.ActiveChanged;
+    pthread_mutex_unlock(&FinessePrefill.Lock);
+
+    return changed;
+}
+
+//
+// Wait until the rate limit allows another Length bytes to be pushed.  Must be
+// called with the lock held; returns non-zero if we are shutting down.
+//
+static int FinessePrefillThrottle(size_t Length)
+{
+    struct timespec now;
+    uint64_t        ns;
+
+    while (0 == FinessePrefill.Shutdown) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if ((now.tv_sec > FinessePrefill.NextSlot.tv_sec) ||
+            ((now.tv_sec == FinessePrefill.NextSlot.tv_sec) && (now.tv_nsec >= FinessePrefill.NextSlot.tv_nsec))) {
+            break;
+        }
+        pthread_cond_timedwait(&FinessePrefill.Cond, &FinessePrefill.Lock, &FinessePrefill.NextSlot);
+    }
+
+    if (0 != FinessePrefill.Shutdown) {
+        return 1;
+    }
+
+    ns                               = (uint64_t)Length * 1000000000ULL / FinessePrefill.Rate;
+    FinessePrefill.NextSlot.tv_sec   = now.tv_sec + ns / 1000000000ULL;
+    FinessePrefill.NextSlot.tv_nsec  = now.tv_nsec + ns % 1000000000ULL;
+    if (FinessePrefill.NextSlot.tv_nsec >= 1000000000) {
+        FinessePrefill.NextSlot.tv_sec++;
+        FinessePrefill.NextSlot.tv_nsec -= 1000000000;
+    }
+
+    return 0;
+}
+
+static void FinessePrefillRange(struct fuse_session *se, finesse_prefill_work_t *Work)
+{
+    struct finesse_req *  request = NULL;
+    struct fuse_attr_out *attr;
+    struct fuse_open_out *open_out;
+    struct fuse_file_info fi;
+    off_t                 offset = Work->Offset;
+    off_t                 end    = Work->Offset + Work->Length;
+    int                   status;
+
+    // The file size bounds the prefill; storing beyond it would extend the file in the kernel.
+    request = (struct finesse_req *)FinesseAllocInternalRequest(se, FUSE_GETATTR);
+    if (NULL == request) {
+        return;
+    }
+    finesse_original_ops->getattr(&request->fuse_request, Work->Inode, NULL);
+    status = FinesseInternalReplyStatus(&request->fuse_request, sizeof(struct fuse_attr_out));
+    if (0 != status) {
+        FinesseFreeFuseRequest(&request->fuse_request);
+        return;
+    }
+    attr = request->iov[1].iov_base;
+    if (!S_ISREG(attr->attr.mode)) {
+        end = offset;
+    }
+    else if ((off_t)attr->attr.size < end) {
+        end = attr->attr.size;
+    }
+    FinesseFreeFuseRequest(&request->fuse_request);
+
+    if ((offset >= end) || (NULL == finesse_original_ops->open) || (NULL == finesse_original_ops->read)) {
+        return;
+    }
+
+    memset(&fi, 0, sizeof(fi));
+    fi.flags = O_RDONLY;
+    request  = (struct finesse_req *)FinesseAllocInternalRequest(se, FUSE_OPEN);
+    if (NULL == request) {
+        return;
+    }
+    finesse_original_ops->open(&request->fuse_request, Work->Inode, &fi);
+    status = FinesseInternalReplyStatus(&request->fuse_request, sizeof(struct fuse_open_out));
+    if (0 != status) {
+        FinesseFreeFuseRequest(&request->fuse_request);
+        return;
+    }
+    open_out = request->iov[1].iov_base;
+    fi.fh    = open_out->fh;
+    FinesseFreeFuseRequest(&request->fuse_request);
+
+    while (offset < end) {
+        size_t             length = end - offset < FINESSE_PREFILL_CHUNK ? end - offset : FINESSE_PREFILL_CHUNK;
+        struct fuse_bufvec bufv   = FUSE_BUFVEC_INIT(0);
+
+        pthread_mutex_lock(&FinessePrefill.Lock);
+        status = FinessePrefillThrottle(length);
+        if (0 != FinessePrefill.ActiveChanged) {
+            status = ESTALE;
+        }
+        pthread_mutex_unlock(&FinessePrefill.Lock);
+        if (0 != status) {
+            break;
+        }
+
+        request = (struct finesse_req *)FinesseAllocInternalRequest(se, FUSE_READ);
+        if (NULL == request) {
+            break;
+        }
+        finesse_original_ops->read(&request->fuse_request, Work->Inode, length, offset, &fi);
+        status = FinesseInternalReplyStatus(&request->fuse_request, 0);
+        if ((0 != status) || (request->iov_count != 2) || (0 == request->iov[1].iov_len)) {
+            // error, EOF, or a scattered reply we don't bother with
+            FinesseFreeFuseRequest(&request->fuse_request);
+            break;
+        }
+
+        bufv.buf[0].mem  = request->iov[1].iov_base;
+        bufv.buf[0].size = request->iov[1].iov_len;
+        status           = fuse_lowlevel_notify_store(se, Work->Inode, offset, &bufv, 0);
+        FinesseFreeFuseRequest(&request->fuse_request);
+        if (0 != status) {
+            // ENOENT: the kernel doesn't know this inode
+            break;
+        }
+
+        if (FinessePrefillActiveChanged()) {
+            // The file changed while we were reading it; what we stored may be older than the change
+            (void)fuse_lowlevel_notify_inval_inode(se, Work->Inode, offset, bufv.buf[0].size);
+            break;
+        }
+
+        __atomic_add_fetch(&FinessePrefill.BytesStored, bufv.buf[0].size, __ATOMIC_RELAXED);
+        if (bufv.buf[0].size < length) {
+            break;  // short read - the file shrank
+        }
+        offset += bufv.buf[0].size;
+    }
+
+    if (NULL != finesse_original_ops->release) {
+        request = (struct finesse_req *)FinesseAllocInternalRequest(se, FUSE_RELEASE);
+        if (NULL != request) {
+            finesse_original_ops->release(&request->fuse_request, Work->Inode, &fi);
+            (void)FinesseInternalReplyStatus(&request->fuse_request, 0);
+            FinesseFreeFuseRequest(&request->fuse_request);
+        }
+    }
+}
+
+static void *FinessePrefillWorker(void *Context)
+{
+    finesse_prefill_work_t work;
+
+    (void)Context;
+
+    pthread_mutex_lock(&FinessePrefill.Lock);
+    while (0 == FinessePrefill.Shutdown) {
+        if (0 == FinessePrefill.Count) {
+            pthread_cond_wait(&FinessePrefill.Cond, &FinessePrefill.Lock);
+            continue;
+        }
+
+        work                         = FinessePrefill.Queue[FinessePrefill.Head];
+        FinessePrefill.Head          = (FinessePrefill.Head + 1) % FINESSE_PREFILL_QUEUE_LENGTH;
+        FinessePrefill.Count--;
+        FinessePrefill.Active        = work.Inode;
+        FinessePrefill.ActiveChanged = 0;
+
+        pthread_mutex_unlock(&FinessePrefill.Lock);
+        FinessePrefillRange(FinessePrefill.Session, &work);
+        pthread_mutex_lock(&FinessePrefill.Lock);
+        FinessePrefill.Active = 0;
+    }
+    pthread_mutex_unlock(&FinessePrefill.Lock);
+
+    return NULL;
+}
+
+//
+// Start the prefill thread.  The window (in KiB) is set with
+// FINESSE_PREFILL_WINDOW, 0 disables prefill; the rate limit (in MiB/s) with
+// FINESSE_PREFILL_RATE.
+//
+int FinessePrefillStart(struct fuse_session *se)
+{
+    pthread_condattr_t condattr;
+    const char *       window = getenv(FINESSE_PREFILL_WINDOW_ENV);
+    const char *       rate   = getenv(FINESSE_PREFILL_RATE_ENV);
+    int                status;
+
+    assert(NULL != se);
+    assert(0 == FinessePrefill.Running);
+
+    FinessePrefill.Window = (size_t)FINESSE_PREFILL_DEFAULT_WINDOW_KB * 1024;
+    if (NULL != window) {
+        FinessePrefill.Window = (size_t)strtoul(window, NULL, 0) * 1024;
+    }
+
+    FinessePrefill.Rate = (uint64_t)FINESSE_PREFILL_DEFAULT_RATE_MB * 1024 * 1024;
+    if (NULL != rate) {
+        FinessePrefill.Rate = (uint64_t)strtoul(rate, NULL, 0) * 1024 * 1024;
+    }
+
+    if ((0 == FinessePrefill.Window) || (0 == FinessePrefill.Rate)) {
+        return 0;  // disabled
+    }
+
+    pthread_condattr_init(&condattr);
+    pthread_condattr_setclock(&condattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&FinessePrefill.Cond, &condattr);
+    pthread_condattr_destroy(&condattr);
+
+    memset(FinessePrefill.Streams, 0, sizeof(FinessePrefill.Streams));
+    memset(&FinessePrefill.NextSlot, 0, sizeof(FinessePrefill.NextSlot));
+    FinessePrefill.Session  = se;
+    FinessePrefill.Head          = 0;
+    FinessePrefill.Count         = 0;
+    FinessePrefill.Active        = 0;
+    FinessePrefill.ActiveChanged = 0;
+    FinessePrefill.Shutdown      = 0;
+
+    status = pthread_create(&FinessePrefill.Thread, NULL, FinessePrefillWorker, NULL);
+    if (0 != status) {
+        pthread_cond_destroy(&FinessePrefill.Cond);
+        return status;
+    }
+    __atomic_store_n(&FinessePrefill.Running, 1, __ATOMIC_RELEASE);
+
+    FinesseMetricsRegisterCounter("finesse prefill bytes", FinessePrefillBytesStored, NULL);
+    FinesseMetricsRegisterCounter("finesse prefill dropped", FinessePrefillDropped, NULL);
+
+    fuse_log(FUSE_LOG_INFO, "FINESSE %s: prefilling %zu KiB windows at up to %llu MiB/s\n", __func__,
+             FinessePrefill.Window / 1024, (unsigned long long)(FinessePrefill.Rate / (1024 * 1024)));
+
+    return 0;
+}
+
+void FinessePrefillStop(void)
+{
+    if (0 == FinessePrefill.Running) {
+        return;
+    }
+
+    FinesseMetricsUnregisterCounter(FinessePrefillBytesStored, NULL);
+    FinesseMetricsUnregisterCounter(FinessePrefillDropped, NULL);
+
+    pthread_mutex_lock(&FinessePrefill.Lock);
+    __atomic_store_n(&FinessePrefill.Running, 0, __ATOMIC_RELAXED);
+    FinessePrefill.Shutdown = 1;
+    pthread_cond_broadcast(&FinessePrefill.Cond);
+    pthread_mutex_unlock(&FinessePrefill.Lock);
+
+    pthread_join(FinessePrefill.Thread, NULL);
+    pthread_cond_destroy(&FinessePrefill.Cond);
+    FinessePrefill.Session = NULL;
+}
@@ -0,0 +1,405 @@
+/*
+  Copyright (C) 2020  Tony Mason <fsgeek@cs.ubc.ca>
+*/
+#include "fs-internal.h"
+#include <fnmatch.h>
+
+//
+// Directory stat ("statdir"): everything "ls -l" or "du" wants from a directory in one
+// message, rather than a readdir followed by a stat per entry.  Where the file system has
+// readdirplus we use it - the attributes come back with the names - and otherwise we look
+// each (matching) name up ourselves.  Either way we don't keep the lookups: the client gets
+// attributes, not keys, so every lookup is forgotten once its entry is copied out.
+//
+// The entries are built in the message's aux buffer.  When that is full we stop and the
+// client asks again from the offset of the last entry we returned; we open the directory
+// afresh for each request, so nothing is left open between them.
+//
+
+#define STATDIR_READ_MIN (4 * 1024)  // always room for at least one entry
+#define STATDIR_READ_MAX (64 * 1024)
+
+static int StatDirOpen(struct fuse_session *se, fuse_ino_t Ino, struct fuse_file_info *Fi)
+{
+    struct fuse_req *     fuse_request = NULL;
+    struct fuse_open_out *arg          = NULL;
+    int                   status;
+
+    memset(Fi, 0, sizeof(struct fuse_file_info));
+    Fi->flags = O_RDONLY | O_DIRECTORY;
+
+    if (NULL == finesse_original_ops->opendir) {
+        // As for the kernel, no opendir method means there's nothing to do
+        return 0;
+    }
+
+    fuse_request = FinesseAllocInternalRequest(se, FUSE_OPENDIR);
+    if (NULL == fuse_request) {
+        return ENOMEM;
+    }
+
+    finesse_original_ops->opendir(fuse_request, Ino, Fi);
+    status = FinesseInternalReplyStatus(fuse_request, sizeof(struct fuse_open_out));
+
+    if (0 == status) {
+        arg    = ((struct finesse_req *)fuse_request)->iov[1].iov_base;
+        Fi->fh = arg->fh;
+    }
+
+    FinesseFreeFuseRequest(fuse_request);
+
+    return status;
+}
+
+static void StatDirRelease(struct fuse_session *se, fuse_ino_t Ino, struct fuse_file_info *Fi)
+{
+    struct fuse_req *fuse_request = NULL;
+
+    if (NULL == finesse_original_ops->releasedir) {
+        return;
+    }
+
+    fuse_request = FinesseAllocInternalRequest(se, FUSE_RELEASEDIR);
+    if (NULL == fuse_request) {
+        return;
+    }
+
+    finesse_original_ops->releasedir(fuse_request, Ino, Fi);
+    (void)FinesseInternalReplyStatus(fuse_request, 0);
+    FinesseFreeFuseRequest(fuse_request);
+}
+
+static int StatDirLookup(struct fuse_session *se, fuse_ino_t Parent, const char *Name, struct stat *Attr)
+{
+    struct fuse_req *      fuse_request = NULL;
+    struct fuse_entry_out *arg          = NULL;
+    int                    status;
+
+    fuse_request = FinesseAllocInternalRequest(se, FUSE_LOOKUP);
+    if (NULL == fuse_request) {
+        return ENOMEM;
+    }
+
+    finesse_original_ops->lookup(fuse_request, Parent, Name);
+    status = FinesseInternalReplyStatus(fuse_request, sizeof(struct fuse_entry_out));
+
+    if (0 == status) {
+        arg = ((struct finesse_req *)fuse_request)->iov[1].iov_base;
+        if (0 == arg->nodeid) {
+            // negative entry (the name went away since we read it)
+            status = ENOENT;
+        }
+        else {
+            FinesseFuseAttrToStat(&arg->attr, Attr);
+            FinesseReleaseInode(se, arg->nodeid);
+        }
+    }
+
+    FinesseFreeFuseRequest(fuse_request);
+
+    return status;
+}
+
+typedef struct {
+    char *   buffer;
+    size_t   buffer_size;
+    size_t   length;
+    uint32_t entry_count;
+    uint64_t next_offset;
+    int      full;
+} statdir_state_t;
+
+// Returns 0 if the entry was added, ENOSPC if there's no room for it
+static int StatDirAdd(statdir_state_t *State, const char *Name, size_t NameLength, const struct stat *Attr)
+{
+    finesse_statdir_entry_t *entry;
+    size_t                   size = FINESSE_STATDIR_ENTRY_SIZE(NameLength);
+
+    if (State->length + size > State->buffer_size) {
+        return ENOSPC;
+    }
+
+    entry               = (finesse_statdir_entry_t *)(State->buffer + State->length);
+    entry->RecordLength = (uint16_t)size;
+    entry->NameLength   = (uint16_t)NameLength;
+    entry->Reserved     = 0;
+    entry->Attr         = *Attr;
+    memcpy(entry->Name, Name, NameLength);
+    entry->Name[NameLength] = '\0';
+
+    State->length += size;
+    State->entry_count++;
+
+    return 0;
+}
+
+static int StatDirIsDotOrDotDot(const char *Name, size_t NameLength)
+{
+    return ((1 == NameLength) && ('.' == Name[0])) || ((2 == NameLength) && ('.' == Name[0]) && ('.' == Name[1]));
+}
+
+//
+// Read one buffer of entries (from State->next_offset) and add the ones that match.  Returns
+// the number of directory entries read (0 at the end of the directory) or a negative errno.
+//
+static int StatDirRead(struct fuse_session *se, fuse_ino_t Ino, struct fuse_file_info *Fi, const char *Pattern,
+                       statdir_state_t *State)
+{
+    struct fuse_req *   fuse_request    = NULL;
+    struct finesse_req *finesse_request = NULL;
+    int                 plus            = NULL != finesse_original_ops->readdirplus;
+    const char *        data            = NULL;
+    size_t              data_length     = 0;
+    size_t              position        = 0;
+    size_t              size            = 0;
+    int                 count           = 0;
+    int                 status;
+    struct stat         attr;
+    char                name[NAME_MAX + 1];
+
+    fuse_request = FinesseAllocInternalRequest(se, plus ? FUSE_READDIRPLUS : FUSE_READDIR);
+    if (NULL == fuse_request) {
+        return -ENOMEM;
+    }
+    finesse_request = (struct finesse_req *)fuse_request;
+
+    // There's no sense asking for (and looking up) much more than we could return
+    size = State->buffer_size - State->length;
+    if (size > STATDIR_READ_MAX) {
+        size = STATDIR_READ_MAX;
+    }
+    if (size < STATDIR_READ_MIN) {
+        size = STATDIR_READ_MIN;
+    }
+
+    if (plus) {
+        finesse_original_ops->readdirplus(fuse_request, Ino, size, (off_t)State->next_offset, Fi);
+    }
+    else {
+        finesse_original_ops->readdir(fuse_request, Ino, size, (off_t)State->next_offset, Fi);
+    }
+
+    status = FinesseInternalReplyStatus(fuse_request, 0);
+    if (0 != status) {
+        FinesseFreeFuseRequest(fuse_request);
+        return -status;
+    }
+
+    if (finesse_request->iov_count > 1) {
+        data        = finesse_request->iov[1].iov_base;
+        data_length = finesse_request->iov[1].iov_len;
+    }
+
+    while (position < data_length) {
+        const struct fuse_dirent *dirent = NULL;
+        fuse_ino_t                nodeid = 0;
+
+        if (plus) {
+            const struct fuse_direntplus *direntplus = (const struct fuse_direntplus *)(data + position);
+
+            assert(position + FUSE_NAME_OFFSET_DIRENTPLUS <= data_length);
+            dirent = &direntplus->dirent;
+            nodeid = direntplus->entry_out.nodeid;
+            position += FUSE_DIRENTPLUS_SIZE(direntplus);
+            if (0 != nodeid) {
+                FinesseFuseAttrToStat(&direntplus->entry_out.attr, &attr);
+            }
+        }
+        else {
+            dirent = (const struct fuse_dirent *)(data + position);
+            assert(position + FUSE_NAME_OFFSET <= data_length);
+            position += FUSE_DIRENT_SIZE(dirent);
+        }
+        count++;
+
+        if (StatDirIsDotOrDotDot(dirent->name, dirent->namelen)) {
+            // not looked up (as the kernel does, we don't forget them either)
+            if (!State->full) {
+                State->next_offset = dirent->off;
+            }
+            continue;
+        }
+
+        // Once we're full, we're just dropping the lookups readdirplus did
+        while (!State->full) {
+            assert(dirent->namelen <= NAME_MAX);
+            memcpy(name, dirent->name, dirent->namelen);
+            name[dirent->namelen] = '\0';
+
+            if (('\0' != Pattern[0]) && (0 != fnmatch(Pattern, name, FNM_PERIOD))) {
+                State->next_offset = dirent->off;
+                break;
+            }
+
+            if (0 == nodeid) {
+                // plain readdir (or readdirplus that didn't do the lookup)
+                status = StatDirLookup(se, Ino, name, &attr);
+                if (0 != status) {
+                    // gone since we read it; skip it
+                    State->next_offset = dirent->off;
+                    break;
+                }
+            }
+
+            if (0 != StatDirAdd(State, name, dirent->namelen, &attr)) {
+                State->full = 1;
+                break;
+            }
+
+            State->next_offset = dirent->off;
+            break;
+        }
+
+        if (0 != nodeid) {
+            FinesseReleaseInode(se, nodeid);
+        }
+    }
+
+    FinesseFreeFuseRequest(fuse_request);
+
+    return count;
+}
+
+//
+// The directory is absolute; it must be inside our mount.
+//
+static int StatDirWalk(struct fuse_session *se, const char *Path, fuse_ino_t *Ino)
+{
+    size_t   mp_length = strlen(se->mountpoint);
+    uint32_t mode      = 0;
+    int      status;
+
+    *Ino = 0;
+
+    if ((0 != strncmp(Path, se->mountpoint, mp_length)) || (('/' != Path[mp_length]) && ('\0' != Path[mp_length]))) {
+        return ENOTSUP;
+    }
+
+    status = FinesseServerInternalWalk(se, FUSE_ROOT_ID, Path + mp_length, FINESSE_WALK_FOLLOW, Ino, &mode);
+
+    if ((0 == status) && !S_ISDIR(mode)) {
+        if (FUSE_ROOT_ID != *Ino) {
+            FinesseReleaseInode(se, *Ino);
+        }
+        *Ino   = 0;
+        status = ENOTDIR;
+    }
+
+    if (FINESSE_WALK_UNRESOLVED == status) {
+        // The client can follow the link (or "..") itself
+        status = ENOTSUP;
+    }
+
+    return status;
+}
+
+int FinesseServerNativeStatDirRequest(struct fuse_session *se, void *Client, fincomm_message Message)
+{
+    finesse_server_handle_t fsh       = NULL;
+    finesse_msg *           fmsg      = (finesse_msg *)Message->Data;
+    int                     status    = 0;
+    int                     result    = 0;
+    int                     complete  = 0;
+    int                     opened    = 0;
+    char *                  data      = NULL;
+    size_t                  data_size = 0;
+    size_t                  length    = 0;
+    const char *            path      = NULL;
+    const char *            pattern   = NULL;
+    fuse_ino_t              dir       = 0;
+    struct fuse_file_info   fi;
+    statdir_state_t         state;
+
+    fsh = (finesse_server_handle_t)se->server_handle;
+
+    if (NULL == fsh) {
+        return ENOTCONN;
+    }
+
+    memset(&state, 0, sizeof(state));
+
+    while (1) {
+        if ((NULL == finesse_original_ops->lookup) ||
+            ((NULL == finesse_original_ops->readdirplus) && (NULL == finesse_original_ops->readdir))) {
+            result = ENOTSUP;
+            break;
+        }
+
+        // The entries will overwrite the offset, path and pattern, so pull them out now.
+        state.next_offset = fmsg->Message.Native.Request.Parameters.StatDir.Offset;
+        data_size         = FinesseGetRequestDataLength(fsh, Client, Message) -
+                    offsetof(finesse_msg, Message.Native.Request.Parameters.StatDir.Data);
+        data = malloc(data_size);
+        if (NULL == data) {
+            result = ENOMEM;
+            break;
+        }
+        memcpy(data, fmsg->Message.Native.Request.Parameters.StatDir.Data, data_size);
+
+        path   = data;
+        length = strnlen(path, data_size);
+        if (length + 1 >= data_size) {
+            result = EINVAL;
+            break;
+        }
+        pattern = path + length + 1;
+        if (strnlen(pattern, data_size - (length + 1)) == data_size - (length + 1)) {
+            // not terminated within the message
+            result = EINVAL;
+            break;
+        }
+
+        result = StatDirWalk(se, path, &dir);
+        if (0 != result) {
+            break;
+        }
+
+        result = StatDirOpen(se, dir, &fi);
+        if (0 != result) {
+            break;
+        }
+        opened = 1;
+
+        state.buffer = FinesseGetStatDirResponseBuffer(fsh, Client, Message, &state.buffer_size);
+
+        while (!state.full) {
+            status = StatDirRead(se, dir, &fi, pattern, &state);
+
+            if (status < 0) {
+                // Report what we have; the client will get the error when it asks for more
+                if (0 == state.entry_count) {
+                    result = -status;
+                }
+                break;
+            }
+
+            if (0 == status) {
+                complete = 1;
+                break;
+            }
+        }
+
+        break;
+    }
+
+    if (opened) {
+        StatDirRelease(se, dir, &fi);
+    }
+
+    if ((0 != dir) && (FUSE_ROOT_ID != dir)) {
+        FinesseReleaseInode(se, dir);
+    }
+
+    status = FinesseSendStatDirResponse(fsh, Client, Message, state.buffer, 0 == result ? state.entry_count : 0,
+                                        0 == result ? state.length : 0, state.next_offset, complete, result);
+
+    if (0 == status) {
+        FinesseCountNativeResponse(FINESSE_NATIVE_RSP_STATDIR);
+    }
+
+    if (NULL != data) {
+        free(data);
+    }
+
+    return 0;
+}
@@ -0,0 +1,343 @@
+/*
+  Copyright (C) 2020  Tony Mason <fsgeek@cs.ubc.ca>
+*/
+#include "fs-internal.h"
+#include "finesse-metrics.h"
+#include <murmurhash3.h>
+
+//
+// Symbolic link cache.
+//
+// Trees built out of links (toolchains, node_modules, alternatives) send every walk through
+// the same few links, so the path walk (see FinesseServerInternalWalk) reads them here rather
+// than asking the file system each time.  A link's contents never change; what can change is
+// what its node id refers to, since node ids are only stable while someone holds a lookup
+// reference (passthrough_ll uses the address of its inode structure).  So, as the negative
+// cache does for its directories, an entry is only used once we hold a reference on its link:
+// the walk donates the one it looked the link up with when it lets go of it (FinesseReleaseInode
+// asks us if we want to keep it).
+//
+// The table is direct mapped.  An entry is dropped when another link lands in its slot or when
+// its link is removed (see invalidate.c); the reference goes back with it.  Most removals only
+// tell us the directory and name, so each entry also remembers the name the walk found the link
+// under (a hash of it: dropping an entry we didn't have to costs one read).  Removals can arrive
+// in contexts that can't call into the file system, so those references are handed back on the
+// next read.
+//
+#define FINESSE_SYMLINK_ENTRIES (1024)
+#define FINESSE_SYMLINK_RELEASES (FINESSE_SYMLINK_ENTRIES)
+
+typedef struct _finesse_symlink_entry {
+    fuse_ino_t Ino;     // 0 = unused
+    unsigned   Pinned;  // we hold a lookup reference on Ino
+    fuse_ino_t Parent;  // where the walk found it
+    uint32_t   NameHash;
+    size_t     Length;
+    char *     Target;
+} finesse_symlink_entry_t;
+
+static struct {
+    pthread_mutex_t         Lock;
+    int                     Running;
+    struct fuse_session *   Session;
+    unsigned                ReleaseCount;
+    unsigned                Count;  // entries in use
+    uint64_t                Hits;
+    uint64_t                Reads;
+    finesse_symlink_entry_t Entries[FINESSE_SYMLINK_ENTRIES];
+    fuse_ino_t              Releases[FINESSE_SYMLINK_RELEASES];
+} FinesseSymlinks = {
+    .Lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static uint64_t FinesseSymlinkHits(void *Context)
+{
+    (void)Context;
+    return __atomic_load_n(&FinesseSymlinks.Hits, __ATOMIC_RELAXED);
+}
+
+static uint64_t FinesseSymlinkReads(void *Context)
+{
+    (void)Context;
+    return __atomic_load_n(&FinesseSymlinks.Reads, __ATOMIC_RELAXED);
+}
+
+static finesse_symlink_entry_t *SymlinkSlot(fuse_ino_t Ino)
+{
+    return &FinesseSymlinks.Entries[(Ino ^ (Ino >> 12)) % FINESSE_SYMLINK_ENTRIES];
+}
+
+static uint32_t SymlinkNameHash(fuse_ino_t Parent, const char *Name, size_t Length)
+{
+    uint32_t hash;
+
+    MurmurHash3_x86_32(Name, (int)Length, (uint32_t)(Parent ^ (Parent >> 32)), &hash);
+    return hash;
+}
+
+//
+// Called with the lock held.  Returns the reference the entry held (0 if none), which the
+// caller has to hand back.
+//
+static fuse_ino_t SymlinkDropEntry(finesse_symlink_entry_t *Entry)
+{
+    fuse_ino_t ino = Entry->Pinned ? Entry->Ino : 0;
+
+    if (0 != Entry->Ino) {
+        FinesseSymlinks.Count--;
+    }
+    free(Entry->Target);
+    Entry->Target   = NULL;
+    Entry->Length   = 0;
+    Entry->Pinned   = 0;
+    Entry->Parent   = 0;
+    Entry->NameHash = 0;
+    Entry->Ino      = 0;
+
+    return ino;
+}
+
+// Hand back the references we no longer need; this calls into the file system.
+static void SymlinkProcessReleases(void)
+{
+    fuse_ino_t ino;
+
+    while (0 != __atomic_load_n(&FinesseSymlinks.ReleaseCount, __ATOMIC_RELAXED)) {
+        pthread_mutex_lock(&FinesseSymlinks.Lock);
+        ino = 0;
+        if (FinesseSymlinks.ReleaseCount > 0) {
+            ino = FinesseSymlinks.Releases[--FinesseSymlinks.ReleaseCount];
+        }
+        pthread_mutex_unlock(&FinesseSymlinks.Lock);
+
+        if (0 != ino) {
+            FinesseReleaseInode(FinesseSymlinks.Session, ino);
+        }
+    }
+}
+
+static int SymlinkReadFromFileSystem(struct fuse_session *se, fuse_ino_t Ino, char *Buffer, size_t BufferSize)
+{
+    struct fuse_req *   fuse_request    = NULL;
+    struct finesse_req *finesse_request = NULL;
+    size_t              length          = 0;
+    int                 status          = 0;
+
+    if (NULL == finesse_original_ops->readlink) {
+        return ENOTSUP;
+    }
+
+    fuse_request = FinesseAllocInternalRequest(se, FUSE_READLINK);
+    if (NULL == fuse_request) {
+        return ENOMEM;
+    }
+    finesse_request = (struct finesse_req *)fuse_request;
+
+    while (1) {
+        finesse_original_ops->readlink(fuse_request, Ino);
+
+        status = FinesseInternalReplyStatus(fuse_request, 0);
+        if (0 != status) {
+            break;
+        }
+
+        if (finesse_request->iov_count > 1) {
+            length = finesse_request->iov[1].iov_len;  // not null terminated
+        }
+
+        if (length >= BufferSize) {
+            status = ENAMETOOLONG;
+            break;
+        }
+
+        if (length > 0) {
+            memcpy(Buffer, finesse_request->iov[1].iov_base, length);
+        }
+        Buffer[length] = '\0';
+        break;
+    }
+
+    FinesseFreeFuseRequest(fuse_request);
+
+    return status;
+}
+
+//
+// Read the link Ino, found as Name in Parent, into Buffer (null terminated).  The caller must
+// hold a lookup reference on Ino.
+//
+int FinesseSymlinkRead(struct fuse_session *se, fuse_ino_t Parent, const char *Name, fuse_ino_t Ino, char *Buffer,
+                       size_t BufferSize)
+{
+    finesse_symlink_entry_t *entry   = SymlinkSlot(Ino);
+    fuse_ino_t               evicted = 0;
+    int                      found   = 0;
+    int                      status  = 0;
+
+    if (0 == __atomic_load_n(&FinesseSymlinks.Running, __ATOMIC_RELAXED)) {
+        return SymlinkReadFromFileSystem(se, Ino, Buffer, BufferSize);
+    }
+
+    SymlinkProcessReleases();
+
+    pthread_mutex_lock(&FinesseSymlinks.Lock);
+    if ((Ino == entry->Ino) && entry->Pinned && (entry->Length < BufferSize)) {
+        memcpy(Buffer, entry->Target, entry->Length + 1);
+        found = 1;
+    }
+    pthread_mutex_unlock(&FinesseSymlinks.Lock);
+
+    if (found) {
+        __atomic_add_fetch(&FinesseSymlinks.Hits, 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    status = SymlinkReadFromFileSystem(se, Ino, Buffer, BufferSize);
+    __atomic_add_fetch(&FinesseSymlinks.Reads, 1, __ATOMIC_RELAXED);
+
+    if (0 != status) {
+        return status;
+    }
+
+    // It isn't usable until the caller's reference comes to us (FinesseSymlinkKeepInode)
+    pthread_mutex_lock(&FinesseSymlinks.Lock);
+    if ((Ino != entry->Ino) || !entry->Pinned) {
+        evicted       = SymlinkDropEntry(entry);
+        entry->Target = strdup(Buffer);
+        if (NULL != entry->Target) {
+            entry->Ino      = Ino;
+            entry->Length   = strlen(Buffer);
+            entry->Parent   = Parent;
+            entry->NameHash = SymlinkNameHash(Parent, Name, strlen(Name));
+            FinesseSymlinks.Count++;
+        }
+    }
+    pthread_mutex_unlock(&FinesseSymlinks.Lock);
+
+    if (0 != evicted) {
+        FinesseReleaseInode(se, evicted);
+    }
+
+    return 0;
+}
+
+//
+// The link Ino has been removed.  This can be called from any context.
+//
+void FinesseSymlinkInvalidate(fuse_ino_t Ino)
+{
+    finesse_symlink_entry_t *entry = SymlinkSlot(Ino);
+    fuse_ino_t               ino   = 0;
+
+    if (0 == __atomic_load_n(&FinesseSymlinks.Running, __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    // If we can't queue the reference the entry stays; its contents are still right for Ino
+    pthread_mutex_lock(&FinesseSymlinks.Lock);
+    if ((Ino == entry->Ino) && (!entry->Pinned || (FinesseSymlinks.ReleaseCount < FINESSE_SYMLINK_RELEASES))) {
+        ino = SymlinkDropEntry(entry);
+        if (0 != ino) {
+            FinesseSymlinks.Releases[FinesseSymlinks.ReleaseCount++] = ino;
+        }
+    }
+    pthread_mutex_unlock(&FinesseSymlinks.Lock);
+}
+
+//
+// Name in Parent has been removed (or replaced), and we don't know what it referred to.  This
+// can be called from any context.
+//
+void FinesseSymlinkInvalidateEntry(fuse_ino_t Parent, const char *Name, size_t NameLength)
+{
+    finesse_symlink_entry_t *entry = NULL;
+    uint32_t                 hash  = 0;
+    fuse_ino_t               ino   = 0;
+
+    if ((0 == __atomic_load_n(&FinesseSymlinks.Running, __ATOMIC_RELAXED)) ||
+        (0 == __atomic_load_n(&FinesseSymlinks.Count, __ATOMIC_RELAXED))) {
+        return;
+    }
+
+    hash = SymlinkNameHash(Parent, Name, NameLength);
+
+    pthread_mutex_lock(&FinesseSymlinks.Lock);
+    for (unsigned index = 0; (index < FINESSE_SYMLINK_ENTRIES) && (FinesseSymlinks.Count > 0); index++) {
+        entry = &FinesseSymlinks.Entries[index];
+        if ((0 == entry->Ino) || (Parent != entry->Parent) || (hash != entry->NameHash)) {
+            continue;
+        }
+        if (entry->Pinned && (FinesseSymlinks.ReleaseCount >= FINESSE_SYMLINK_RELEASES)) {
+            continue;
+        }
+        ino = SymlinkDropEntry(entry);
+        if (0 != ino) {
+            FinesseSymlinks.Releases[FinesseSymlinks.ReleaseCount++] = ino;
+        }
+    }
+    pthread_mutex_unlock(&FinesseSymlinks.Lock);
+}
+
+//
+// Called by FinesseReleaseInode: returns 1 if we keep the caller's reference on Ino (because
+// we have its contents and nothing to keep them valid).
+//
+int FinesseSymlinkKeepInode(fuse_ino_t Ino)
+{
+    finesse_symlink_entry_t *entry = SymlinkSlot(Ino);
+    int                      keep  = 0;
+
+    if (0 == __atomic_load_n(&FinesseSymlinks.Running, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&FinesseSymlinks.Lock);
+    if ((Ino == entry->Ino) && !entry->Pinned) {
+        entry->Pinned = 1;
+        keep          = 1;
+    }
+    pthread_mutex_unlock(&FinesseSymlinks.Lock);
+
+    return keep;
+}
+
+int FinesseSymlinkStart(struct fuse_session *se)
+{
+    assert(NULL != se);
+    assert(0 == FinesseSymlinks.Running);
+
+    pthread_mutex_lock(&FinesseSymlinks.Lock);
+    memset(FinesseSymlinks.Entries, 0, sizeof(FinesseSymlinks.Entries));
+    FinesseSymlinks.ReleaseCount = 0;
+    FinesseSymlinks.Count        = 0;
+    FinesseSymlinks.Session      = se;
+    __atomic_store_n(&FinesseSymlinks.Running, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&FinesseSymlinks.Lock);
+
+    FinesseMetricsRegisterCounter("finesse symlink hits", FinesseSymlinkHits, NULL);
+    FinesseMetricsRegisterCounter("finesse symlink reads", FinesseSymlinkReads, NULL);
+
+    return 0;
+}
+
+//
+// The references we hold are simply dropped: the session is going away.
+//
+void FinesseSymlinkStop(void)
+{
+    if (0 == FinesseSymlinks.Running) {
+        return;
+    }
+
+    FinesseMetricsUnregisterCounter(FinesseSymlinkHits, NULL);
+    FinesseMetricsUnregisterCounter(FinesseSymlinkReads, NULL);
+
+    pthread_mutex_lock(&FinesseSymlinks.Lock);
+    __atomic_store_n(&FinesseSymlinks.Running, 0, __ATOMIC_RELAXED);
+    for (unsigned index = 0; index < FINESSE_SYMLINK_ENTRIES; index++) {
+        (void)SymlinkDropEntry(&FinesseSymlinks.Entries[index]);
+    }
+    FinesseSymlinks.ReleaseCount = 0;
+    FinesseSymlinks.Session      = NULL;
+    pthread_mutex_unlock(&FinesseSymlinks.Lock);
+}
@@ -13,7 +13,7 @@ static int Unlink(struct fuse_session *se, void *Client, fincomm_message Message
     struct finesse_req *     finesse_request = NULL;
     struct fuse_out_header * out             = NULL;
     fuse_ino_t               parent_ino      = FUSE_ROOT_ID;
-    int                      flags           = 0;
+    int                      flags           = O_NOFOLLOW;  // it's the link we remove, not what it names
 
     assert(NULL != se);
     assert(NULL != Message);
@@ -53,6 +53,12 @@ static int Unlink(struct fuse_session *se, void *Client, fincomm_message Message
         assert(finesse_request->iov_count > 0);
         out = finesse_request->iov[0].iov_base;
 
+        if (0 == out->error) {
+            // finobj is what we just removed (we mapped the name itself, see flags above)
+            FinesseServerNotifyDelete(se, finobj->inode, finobj->inode, fmsg->Message.Fuse.Request.Parameters.Unlink.Name,
+                                      strlen(fmsg->Message.Fuse.Request.Parameters.Unlink.Name));
+        }
+
         status = FinesseSendUnlinkResponse(fsh, Client, Message, out->error);
         assert(0 == status);
 
@@ -31,10 +31,63 @@ void FinesseSignalFuseRequestCompletion(struct finesse_req *req)
     pthread_cond_broadcast(&req->condition);
 }
 
-void FinesseReleaseInode(struct fuse_session *se, fuse_ino_t ino)
+//
+// A request the server sends to the file system itself (a lookup on a client's behalf, a
+// directory read for the prefetch, ...).  It holds an extra reference so that the reply is
+// still there when the caller looks at it; the caller frees it with FinesseFreeFuseRequest.
+//
+struct fuse_req *FinesseAllocInternalRequest(struct fuse_session *se, int Opcode)
 {
     struct fuse_req *fuse_request = FinesseAllocFuseRequest(se);
 
+    if (NULL != fuse_request) {
+        fuse_request->ctr++;
+        fuse_request->opcode = Opcode;
+    }
+
+    return fuse_request;
+}
+
+//
+// Wait for the reply to an internal request.  Returns the error from the reply (as a positive
+// errno), EIO if the reply carries fewer than ArgSize bytes of argument, and 0 otherwise.
+//
+int FinesseInternalReplyStatus(struct fuse_req *Request, size_t ArgSize)
+{
+    struct finesse_req *    finesse_request = (struct finesse_req *)Request;
+    struct fuse_out_header *out             = NULL;
+
+    FinesseWaitForFuseRequestCompletion(finesse_request);
+
+    assert(finesse_request->iov_count > 0);
+    out = finesse_request->iov[0].iov_base;
+    if (0 != out->error) {
+        return -out->error;
+    }
+
+    if ((ArgSize > 0) && ((finesse_request->iov_count < 2) || (finesse_request->iov[1].iov_len < ArgSize))) {
+        return EIO;
+    }
+
+    return 0;
+}
+
+//
+// Every lookup reference the server gives up comes through here, so this is where the
+// directory prefetch (prefetch.c) and the negative cache (negative.c) get the references
+// they need on the directories they want to read or have entries for, and the symlink cache
+// (symlink.c) the ones on the links it has read.
+//
+void FinesseReleaseInode(struct fuse_session *se, fuse_ino_t ino)
+{
+    struct fuse_req *fuse_request = NULL;
+
+    if (FinessePrefetchKeepInode(ino) || FinesseNegativeKeepInode(ino) || FinesseSymlinkKeepInode(ino)) {
+        return;
+    }
+
+    fuse_request = FinesseAllocFuseRequest(se);
+
     fuse_request->opcode = FUSE_FORGET;
     finesse_original_ops->forget(fuse_request, ino, 1);
 }
@@ -399,6 +399,167 @@ static MunitResult test_buffer(const MunitParameter params[] __notused, void *pr
     return MUNIT_OK;
 }
 
+static MunitResult test_multi_slot(const MunitParameter params[] __notused, void *prv __notused)
+{
+    fincomm_shared_memory_region *fsmr;
+    fincomm_message               fm_small;
+    fincomm_message               fm_large;
+    fincomm_message               fm_server;
+    finesse_msg *                 fin_cmsg;
+    const size_t                  large_length = 10000;  // three message blocks
+    size_t                        data_length;
+    u_int64_t                     request_id;
+    int                           status;
+
+    fsmr = CreateInMemoryRegion();
+    munit_assert_not_null(fsmr);
+
+    // Anything that fits in a block is an ordinary single block request
+    fm_small = FinesseGetRequestBufferForLength(fsmr, FINESSE_NATIVE_MESSAGE, FINESSE_NATIVE_REQ_TEST, 100);
+    munit_assert_not_null(fm_small);
+    munit_assert(&fsmr->Messages[0] == fm_small);
+    munit_assert(1 == fsmr->AllocationBitmap);
+    data_length = FinesseGetMessageDataLength(fsmr, fm_small);
+    munit_assert(sizeof(fm_small->Data) == data_length);
+
+    // A bigger one takes the next run of free blocks
+    fm_large = FinesseGetRequestBufferForLength(fsmr, FINESSE_NATIVE_MESSAGE, FINESSE_NATIVE_REQ_TEST, large_length);
+    munit_assert_not_null(fm_large);
+    munit_assert(&fsmr->Messages[1] == fm_large);
+    munit_assert(0xF == fsmr->AllocationBitmap);
+    data_length = FinesseGetMessageDataLength(fsmr, fm_large);
+    munit_assert(data_length >= large_length);
+    munit_assert((3 * SHM_PAGE_SIZE) - offsetof(fincomm_message_block, Data) == data_length);
+
+    fin_cmsg = (finesse_msg *)fm_large->Data;
+    munit_assert(FINESSE_NATIVE_MESSAGE == fin_cmsg->MessageClass);
+    munit_assert(FINESSE_NATIVE_REQ_TEST == fin_cmsg->Message.Native.Request.NativeRequestType);
+    for (size_t index = sizeof(finesse_msg); index < data_length; index++) {
+        fm_large->Data[index] = (u_int8_t)index;
+    }
+
+    // Only the first block is signaled
+    request_id = FinesseRequestReady(fsmr, fm_large);
+    munit_assert(0 != request_id);
+    munit_assert(2 == fsmr->RequestBitmap);
+
+    status = FinesseGetReadyRequest(fsmr, &fm_server);
+    munit_assert(0 == status);
+    munit_assert(fm_large == fm_server);
+    munit_assert(data_length == FinesseGetMessageDataLength(fsmr, fm_server));
+    for (size_t index = sizeof(finesse_msg); index < data_length; index++) {
+        munit_assert((u_int8_t)index == fm_server->Data[index]);
+    }
+
+    FinesseResponseReady(fsmr, fm_server, 0);
+    status = FinesseGetResponse(fsmr, fm_large, 1);
+    munit_assert(0 != status);
+
+    // Freeing it frees the whole run
+    FinesseReleaseRequestBuffer(fsmr, fm_large);
+    munit_assert(1 == fsmr->AllocationBitmap);
+    FinesseReleaseRequestBuffer(fsmr, fm_small);
+    munit_assert(0 == fsmr->AllocationBitmap);
+
+    // Too big for any message
+    fm_large = FinesseGetRequestBufferForLength(fsmr, FINESSE_NATIVE_MESSAGE, FINESSE_NATIVE_REQ_TEST,
+                                                FINESSE_MAX_MESSAGE_DATA_LENGTH + 1);
+    munit_assert(NULL == fm_large);
+    munit_assert(0 == fsmr->AllocationBitmap);
+
+    // The largest does fit
+    fm_large = FinesseGetRequestBufferForLength(fsmr, FINESSE_NATIVE_MESSAGE, FINESSE_NATIVE_REQ_TEST,
+                                                FINESSE_MAX_MESSAGE_DATA_LENGTH);
+    munit_assert_not_null(fm_large);
+    munit_assert(FINESSE_MAX_MESSAGE_DATA_LENGTH == FinesseGetMessageDataLength(fsmr, fm_large));
+    FinesseReleaseRequestBuffer(fsmr, fm_large);
+    munit_assert(0 == fsmr->AllocationBitmap);
+
+    // cleanup
+    DestroyInMemoryRegion(fsmr);
+    fsmr = NULL;
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_invalidations(const MunitParameter params[] __notused, void *prv __notused)
+{
+    fincomm_shared_memory_region *fsmr;
+    finesse_invalidation_t        posted;
+    finesse_invalidation_t        read[FINESSE_INVALIDATION_RING_SIZE];
+    u_int64_t                     cursor = 0;
+    unsigned                      count;
+    int                           status;
+
+    fsmr = CreateInMemoryRegion();
+    munit_assert_not_null(fsmr);
+
+    // Nothing posted yet
+    status = FinesseReadInvalidations(fsmr, &cursor, read, FINESSE_INVALIDATION_RING_SIZE, &count);
+    munit_assert(0 == status);
+    munit_assert(0 == count);
+    munit_assert(0 == cursor);
+
+    memset(&posted, 0, sizeof(posted));
+    for (unsigned index = 0; index < 3; index++) {
+        posted.Type       = FINESSE_INVALIDATE_ENTRY;
+        posted.Parent     = 100 + index;
+        posted.NameLength = 4;
+        memcpy(posted.Name, "file", 4);
+        FinessePostInvalidation(fsmr, &posted);
+    }
+
+    // Read them a piece at a time
+    status = FinesseReadInvalidations(fsmr, &cursor, read, 2, &count);
+    munit_assert(0 == status);
+    munit_assert(2 == count);
+    munit_assert(2 == cursor);
+    munit_assert(1 == read[0].Sequence);
+    munit_assert(100 == read[0].Parent);
+    munit_assert(101 == read[1].Parent);
+    munit_assert(FINESSE_INVALIDATE_ENTRY == read[1].Type);
+    munit_assert(0 == memcmp(read[1].Name, "file", 4));
+
+    status = FinesseReadInvalidations(fsmr, &cursor, read, FINESSE_INVALIDATION_RING_SIZE, &count);
+    munit_assert(0 == status);
+    munit_assert(1 == count);
+    munit_assert(3 == cursor);
+    munit_assert(102 == read[0].Parent);
+
+    // Fall more than a ring behind and we're told to start over
+    posted.Type = FINESSE_INVALIDATE_INODE;
+    for (unsigned index = 0; index <= FINESSE_INVALIDATION_RING_SIZE; index++) {
+        posted.Inode = index + 1;
+        FinessePostInvalidation(fsmr, &posted);
+    }
+    status = FinesseReadInvalidations(fsmr, &cursor, read, FINESSE_INVALIDATION_RING_SIZE, &count);
+    munit_assert(EOVERFLOW == status);
+    munit_assert(fsmr->InvalidationHead == cursor);
+
+    // and then carry on from there
+    posted.Inode = 1000;
+    FinessePostInvalidation(fsmr, &posted);
+    status = FinesseReadInvalidations(fsmr, &cursor, read, FINESSE_INVALIDATION_RING_SIZE, &count);
+    munit_assert(0 == status);
+    munit_assert(1 == count);
+    munit_assert(1000 == read[0].Inode);
+    munit_assert(fsmr->InvalidationHead == cursor);
+
+    // An event that is still being written isn't returned (yet)
+    fsmr->Invalidations[cursor % FINESSE_INVALIDATION_RING_SIZE].Sequence = 0;
+    fsmr->InvalidationHead++;
+    status = FinesseReadInvalidations(fsmr, &cursor, read, FINESSE_INVALIDATION_RING_SIZE, &count);
+    munit_assert(0 == status);
+    munit_assert(0 == count);
+    munit_assert(fsmr->InvalidationHead == cursor + 1);
+
+    // cleanup
+    DestroyInMemoryRegion(fsmr);
+    fsmr = NULL;
+
+    return MUNIT_OK;
+}
+
 static MunitResult test_namemap(const MunitParameter params[] __notused, void *prv __notused)
 {
     return MUNIT_OK;
@@ -407,6 +568,8 @@ static MunitResult test_namemap(const MunitParameter params[] __notused, void *p
 static MunitTest fincomm_tests[] = {
     TEST((char *)(uintptr_t) "/null", test_null, NULL),
     TEST((char *)(uintptr_t) "/simple", test_message, NULL),
+    TEST((char *)(uintptr_t) "/multi-slot", test_multi_slot, NULL),
+    TEST((char *)(uintptr_t) "/invalidations", test_invalidations, NULL),
     TEST((char *)(uintptr_t) "/client-server", test_client_server, NULL),
     TEST((char *)(uintptr_t) "/invalid-message", test_invalid_message_request, NULL),
     TEST((char *)(uintptr_t) "/multi-client", test_multi_client, NULL),
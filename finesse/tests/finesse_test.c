@@ -212,6 +212,12 @@ static MunitResult test_msg_namemap(const MunitParameter params[] __notused, voi
     munit_assert((0 == strcmp(name1, test_message2->Message.Native.Request.Parameters.Map.Name)) ||
                  (0 == strcmp(name2, test_message2->Message.Native.Request.Parameters.Map.Name)));
 
+    if (0 == strcmp(name2, test_message1->Message.Native.Request.Parameters.Map.Name)) {
+        // The server can pick up the requests in either order
+        fm_server1 = (fincomm_message)request2;
+        fm_server2 = (fincomm_message)request1;
+    }
+
     // server responds
     uuid_generate(key2);
     status = FinesseSendNameMapResponse(fsh, client2, fm_server2, &key2, 0);
@@ -404,6 +410,61 @@ static MunitResult test_msg_statfs(const MunitParameter params[] __notused, void
 
 static MunitResult test_msg_access(const MunitParameter params[] __notused, void *prv __notused)
 {
+    int                     status;
+    finesse_server_handle_t fsh;
+    finesse_client_handle_t fch;
+    fincomm_message         message;
+    finesse_msg *           test_message = NULL;
+    fincomm_message         fm_server    = NULL;
+    void *                  client;
+    fincomm_message         request;
+    int                     result = 0;
+
+    munit_assert(0 == setenv("FINESSE_COMM_STAT_LOG", __func__, 1));  // this sets the log file name
+
+    status = FinesseStartServerConnection(test_name, &fsh);
+    munit_assert(0 == status);
+    munit_assert(NULL != fsh);
+
+    status = FinesseStartClientConnection(&fch, test_name);
+    munit_assert(0 == status);
+    munit_assert(NULL != fch);
+
+    // client sends request (no parent: an absolute name)
+    status = FinesseSendAccessRequest(fch, NULL, "/foo/bar", R_OK | X_OK, &message);
+    munit_assert(0 == status);
+
+    // server gets a request
+    status = FinesseGetRequest(fsh, &client, &request);
+    munit_assert(0 == status);
+    munit_assert(NULL != request);
+    fm_server = (fincomm_message)request;
+    munit_assert(FINESSE_REQUEST == fm_server->MessageType);
+    test_message = (finesse_msg *)fm_server->Data;
+
+    munit_assert(FINESSE_FUSE_MESSAGE == test_message->MessageClass);
+    munit_assert(FINESSE_FUSE_REQ_ACCESS == test_message->Message.Fuse.Request.Type);
+    munit_assert(uuid_is_null(test_message->Message.Fuse.Request.Parameters.Access.ParentInode));
+    munit_assert((R_OK | X_OK) == test_message->Message.Fuse.Request.Parameters.Access.Mask);
+    munit_assert(0 == strcmp("/foo/bar", test_message->Message.Fuse.Request.Parameters.Access.Name));
+
+    // server responds
+    status = FinesseSendAccessResponse(fsh, client, fm_server, ENOENT);
+    munit_assert(0 == status);
+
+    // client gets the response
+    status = FinesseGetAccessResponse(fch, message, &result);
+    munit_assert(0 == status);
+    munit_assert(ENOENT == result);
+    FinesseFreeAccessResponse(fch, message);
+
+    // cleanup
+    status = FinesseStopClientConnection(fch);
+    munit_assert(0 == status);
+
+    status = FinesseStopServerConnection(fsh);
+    munit_assert(0 == status);
+
     return MUNIT_OK;
 }
 
@@ -664,6 +725,80 @@ static MunitResult test_msg_stat(const MunitParameter params[] __notused, void *
     return MUNIT_OK;
 }
 
+static MunitResult test_msg_long_stat(const MunitParameter params[] __notused, void *prv __notused)
+{
+    int                     status;
+    finesse_server_handle_t fsh;
+    finesse_client_handle_t fch;
+    fincomm_message         message;
+    finesse_msg *           test_message = NULL;
+    fincomm_message         fm_server    = NULL;
+    void *                  client;
+    fincomm_message         request;
+    struct stat             statbuf1, statbuf2;
+    double                  timeout;
+    int                     result;
+    char *                  long_path;
+    size_t                  long_path_length = 3 * SHM_PAGE_SIZE;  // longer than one message block can hold
+
+    munit_assert(0 == setenv("FINESSE_COMM_STAT_LOG", __func__, 1));  // this sets the log file name
+
+    long_path = malloc(long_path_length + 1);
+    munit_assert_not_null(long_path);
+    for (size_t index = 0; index < long_path_length; index++) {
+        long_path[index] = (0 == index % 8) ? '/' : 'a' + (index % 26);
+    }
+    long_path[long_path_length] = '\0';
+
+    status = FinesseStartServerConnection(test_name, &fsh);
+    munit_assert(0 == status);
+    munit_assert(NULL != fsh);
+
+    status = FinesseStartClientConnection(&fch, test_name);
+    munit_assert(0 == status);
+    munit_assert(NULL != fch);
+
+    // client sends request
+    status = FinesseSendStatRequest(fch, long_path, &message);
+    munit_assert(0 == status);
+
+    // server gets the request, all of it
+    status = FinesseGetRequest(fsh, &client, &request);
+    assert(0 == status);
+    assert(NULL != request);
+    fm_server = (fincomm_message)request;
+    munit_assert(FINESSE_REQUEST == fm_server->MessageType);
+    test_message = (finesse_msg *)fm_server->Data;
+    munit_assert(FINESSE_FUSE_REQ_STAT == test_message->Message.Fuse.Request.Type);
+    munit_assert(FinesseGetRequestDataLength(fsh, client, fm_server) >
+                 offsetof(finesse_msg, Message.Fuse.Request.Parameters.Stat.Name) + long_path_length);
+    munit_assert_string_equal(long_path, test_message->Message.Fuse.Request.Parameters.Stat.Name);
+
+    // server responds
+    status = stat(".", &statbuf1);
+    munit_assert(0 == status);
+    status = FinesseSendStatResponse(fsh, client, fm_server, &statbuf1, 1.0, 0);
+    munit_assert(0 == status);
+
+    // client gets the response
+    status = FinesseGetStatResponse(fch, message, &statbuf2, &timeout, &result);
+    munit_assert(0 == status);
+    munit_assert(0 == result);
+    munit_assert(0 == memcmp(&statbuf1, &statbuf2, sizeof(statbuf1)));
+    FinesseFreeStatResponse(fch, message);
+
+    // cleanup
+    free(long_path);
+
+    status = FinesseStopClientConnection(fch);
+    munit_assert(0 == status);
+
+    status = FinesseStopServerConnection(fsh);
+    munit_assert(0 == status);
+
+    return MUNIT_OK;
+}
+
 static MunitResult test_msg_create(const MunitParameter params[] __notused, void *prv __notused)
 {
     int                     status = 0;
@@ -697,7 +832,7 @@ static MunitResult test_msg_create(const MunitParameter params[] __notused, void
     // client sends request
     uuid_generate(key);
     memset(&parent, 0, sizeof(parent));
-    status = FinesseSendCreateRequest(fch, &parent, fname, &statbuf, &message);
+    status = FinesseSendCreateRequest(fch, &parent, fname, &statbuf, O_EXCL, &message);
     munit_assert(0 == status);
 
     // server gets a request
@@ -713,6 +848,7 @@ static MunitResult test_msg_create(const MunitParameter params[] __notused, void
     munit_assert(uuid_is_null(test_message->Message.Fuse.Request.Parameters.Create.Parent));
     munit_assert(0 == strcmp(fname, test_message->Message.Fuse.Request.Parameters.Create.Name));
     munit_assert(0 == memcmp(&test_message->Message.Fuse.Request.Parameters.Create.Attr, &statbuf, sizeof(statbuf)));
+    munit_assert(O_EXCL == test_message->Message.Fuse.Request.Parameters.Create.Flags);
     munit_assert(0 == status);
 
     // server responds
@@ -808,6 +944,480 @@ static MunitResult test_msg_server_stat(const MunitParameter params[] __notused,
     return MUNIT_OK;
 }
 
+static MunitResult test_msg_path_search(const MunitParameter params[] __notused, void *prv __notused)
+{
+    int                         status;
+    finesse_server_handle_t     fsh;
+    finesse_client_handle_t     fch;
+    fincomm_message             message;
+    finesse_msg *               test_message = NULL;
+    fincomm_message             fm_server    = NULL;
+    void *                      client;
+    fincomm_message             request;
+    const char *                files[]   = {"stdio.h", "sys/types.h", NULL};
+    const char *                paths[]   = {"/mnt/pt/include", "/mnt/pt/usr/include", "/mnt/pt/usr/local/include", NULL};
+    finesse_path_search_match_t matches[] = {
+        {.FileIndex = FINESSE_PATH_SEARCH_UNRESOLVED, .PathIndex = 0, .Mode = 0},
+        {.FileIndex = 1, .PathIndex = 1, .Mode = S_IFREG | 0644},
+        {.FileIndex = 0, .PathIndex = 2, .Mode = S_IFLNK | 0777},
+    };
+    finesse_path_search_match_t out_matches[FINESSE_PATH_SEARCH_MAX_MATCHES];
+    unsigned                    match_count;
+    const char *                data;
+    int                         result;
+
+    munit_assert(0 == setenv("FINESSE_COMM_STAT_LOG", __func__, 1));  // this sets the log file name
+
+    status = FinesseStartServerConnection(test_name, &fsh);
+    munit_assert(0 == status);
+    munit_assert(NULL != fsh);
+
+    status = FinesseStartClientConnection(&fch, test_name);
+    munit_assert(0 == status);
+    munit_assert(NULL != fch);
+
+    // client sends request
+    status = FinesseSendPathSearchRequest(fch, files, paths, FINESSE_PATH_SEARCH_ALL, &message);
+    munit_assert(0 == status);
+
+    // server gets the request: the names, then the directories
+    status = FinesseGetRequest(fsh, &client, &request);
+    assert(0 == status);
+    assert(NULL != request);
+    fm_server = (fincomm_message)request;
+    munit_assert(FINESSE_REQUEST == fm_server->MessageType);
+    test_message = (finesse_msg *)fm_server->Data;
+    munit_assert(FINESSE_MESSAGE_VERSION == test_message->Version);
+    munit_assert(FINESSE_NATIVE_MESSAGE == test_message->MessageClass);
+    munit_assert(FINESSE_NATIVE_REQ_PATH_SEARCH == test_message->Message.Native.Request.NativeRequestType);
+    munit_assert(FINESSE_PATH_SEARCH_ALL == test_message->Message.Native.Request.Parameters.PathSearch.Flags);
+    munit_assert(2 == test_message->Message.Native.Request.Parameters.PathSearch.FileCount);
+    munit_assert(3 == test_message->Message.Native.Request.Parameters.PathSearch.PathCount);
+    data = test_message->Message.Native.Request.Parameters.PathSearch.Data;
+    for (unsigned index = 0; NULL != files[index]; index++) {
+        munit_assert_string_equal(files[index], data);
+        data += strlen(data) + 1;
+    }
+    for (unsigned index = 0; NULL != paths[index]; index++) {
+        munit_assert_string_equal(paths[index], data);
+        data += strlen(data) + 1;
+    }
+
+    // server responds
+    status = FinesseSendPathSearchResponse(fsh, client, fm_server, matches, sizeof(matches) / sizeof(matches[0]), 0);
+    munit_assert(0 == status);
+
+    // client gets the response
+    match_count = FINESSE_PATH_SEARCH_MAX_MATCHES;
+    status      = FinesseGetPathSearchResponse(fch, message, out_matches, &match_count, &result);
+    munit_assert(0 == status);
+    munit_assert(0 == result);
+    munit_assert(sizeof(matches) / sizeof(matches[0]) == match_count);
+    munit_assert(0 == memcmp(matches, out_matches, sizeof(matches)));
+    FinesseFreePathSearchResponse(fch, message);
+
+    // cleanup
+    status = FinesseStopClientConnection(fch);
+    munit_assert(0 == status);
+
+    status = FinesseStopServerConnection(fsh);
+    munit_assert(0 == status);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_msg_compound(const MunitParameter params[] __notused, void *prv __notused)
+{
+    int                       status;
+    finesse_server_handle_t   fsh;
+    finesse_client_handle_t   fch;
+    fincomm_message           message;
+    finesse_msg *             test_message = NULL;
+    fincomm_message           fm_server    = NULL;
+    void *                    client;
+    fincomm_message           request;
+    finesse_compound_op_t     ops[4];
+    const char *              names[4] = {"/mnt/pt/etc/hosts", NULL, NULL, NULL};
+    finesse_compound_result_t results[4];
+    finesse_compound_result_t out_results[FINESSE_COMPOUND_MAX_OPS];
+    unsigned                  op_count;
+    struct stat               attr, out_attr;
+    uuid_t                    key, out_key;
+    const char                contents[] = "127.0.0.1 localhost\n";
+    char                      buffer[64];
+    size_t                    length;
+    int                       result;
+
+    munit_assert(0 == setenv("FINESSE_COMM_STAT_LOG", __func__, 1));  // this sets the log file name
+
+    status = FinesseStartServerConnection(test_name, &fsh);
+    munit_assert(0 == status);
+    munit_assert(NULL != fsh);
+
+    status = FinesseStartClientConnection(&fch, test_name);
+    munit_assert(0 == status);
+    munit_assert(NULL != fch);
+
+    memset(ops, 0, sizeof(ops));
+    ops[0].Op     = FINESSE_COMPOUND_OP_MAP;
+    ops[0].Flags  = O_RDONLY;
+    ops[1].Op     = FINESSE_COMPOUND_OP_GETATTR;
+    ops[2].Op     = FINESSE_COMPOUND_OP_OPEN;
+    ops[3].Op     = FINESSE_COMPOUND_OP_READ;
+    ops[3].Offset = 0;
+    ops[3].Length = sizeof(buffer);
+
+    // client sends request
+    status = FinesseSendCompoundRequest(fch, ops, names, 4, &message);
+    munit_assert(0 == status);
+
+    // server gets the request
+    status = FinesseGetRequest(fsh, &client, &request);
+    assert(0 == status);
+    assert(NULL != request);
+    fm_server = (fincomm_message)request;
+    munit_assert(FINESSE_REQUEST == fm_server->MessageType);
+    test_message = (finesse_msg *)fm_server->Data;
+    munit_assert(FINESSE_MESSAGE_VERSION == test_message->Version);
+    munit_assert(FINESSE_NATIVE_MESSAGE == test_message->MessageClass);
+    munit_assert(FINESSE_NATIVE_REQ_COMPOUND == test_message->Message.Native.Request.NativeRequestType);
+    munit_assert(4 == test_message->Message.Native.Request.Parameters.Compound.OpCount);
+    for (unsigned index = 0; index < 4; index++) {
+        munit_assert(ops[index].Op == test_message->Message.Native.Request.Parameters.Compound.Ops[index].Op);
+        munit_assert(ops[index].Flags == test_message->Message.Native.Request.Parameters.Compound.Ops[index].Flags);
+    }
+    munit_assert(0 == test_message->Message.Native.Request.Parameters.Compound.Ops[0].NameOffset);
+    munit_assert_string_equal(names[0], test_message->Message.Native.Request.Parameters.Compound.Data);
+
+    // server responds: everything worked and the map is still held
+    memset(results, 0, sizeof(results));
+    for (unsigned index = 0; index < 4; index++) {
+        results[index].Op = ops[index].Op;
+    }
+    results[3].DataOffset = 0;
+    results[3].Length     = sizeof(contents) - 1;
+    memset(&attr, 0, sizeof(attr));
+    attr.st_mode = S_IFREG | 0644;
+    attr.st_size = sizeof(contents) - 1;
+    uuid_generate(key);
+    status = FinesseSendCompoundResponse(fsh, client, fm_server, results, 4, &key, &attr, contents, sizeof(contents) - 1, 0);
+    munit_assert(0 == status);
+
+    // client gets the response
+    length = sizeof(buffer);
+    status = FinesseGetCompoundResponse(fch, message, out_results, &op_count, &out_key, &out_attr, buffer, &length, &result);
+    munit_assert(0 == status);
+    munit_assert(0 == result);
+    munit_assert(4 == op_count);
+    munit_assert(0 == memcmp(results, out_results, sizeof(results)));
+    munit_assert(0 == uuid_compare(key, out_key));
+    munit_assert(attr.st_mode == out_attr.st_mode);
+    munit_assert(attr.st_size == out_attr.st_size);
+    munit_assert(sizeof(contents) - 1 == length);
+    munit_assert(0 == memcmp(contents, buffer, length));
+    FinesseFreeCompoundResponse(fch, message);
+
+    // cleanup
+    status = FinesseStopClientConnection(fch);
+    munit_assert(0 == status);
+
+    status = FinesseStopServerConnection(fsh);
+    munit_assert(0 == status);
+
+    return MUNIT_OK;
+}
+
+static size_t build_statdir_entries(void *Buffer, size_t BufferSize, unsigned Count)
+{
+    finesse_statdir_entry_t *entry;
+    char                     name[32];
+    size_t                   length = 0;
+    size_t                   name_length;
+
+    for (unsigned index = 0; index < Count; index++) {
+        name_length = (size_t)snprintf(name, sizeof(name), "file%05u", index);
+        munit_assert(length + FINESSE_STATDIR_ENTRY_SIZE(name_length) <= BufferSize);
+        entry = (finesse_statdir_entry_t *)((char *)Buffer + length);
+        memset(entry, 0, FINESSE_STATDIR_ENTRY_SIZE(name_length));
+        entry->RecordLength = (uint16_t)FINESSE_STATDIR_ENTRY_SIZE(name_length);
+        entry->NameLength   = (uint16_t)name_length;
+        entry->Attr.st_ino  = 1000 + index;
+        entry->Attr.st_mode = S_IFREG | 0644;
+        entry->Attr.st_size = index;
+        memcpy(entry->Name, name, name_length + 1);
+        length += entry->RecordLength;
+    }
+
+    return length;
+}
+
+static void check_statdir_entries(const void *Entries, size_t Length, unsigned Count)
+{
+    const finesse_statdir_entry_t *entry;
+    char                           name[32];
+    size_t                         position = 0;
+
+    for (unsigned index = 0; index < Count; index++) {
+        munit_assert(position < Length);
+        entry = (const finesse_statdir_entry_t *)((const char *)Entries + position);
+        snprintf(name, sizeof(name), "file%05u", index);
+        munit_assert_string_equal(name, entry->Name);
+        munit_assert(strlen(name) == entry->NameLength);
+        munit_assert(1000 + index == entry->Attr.st_ino);
+        munit_assert((off_t)index == entry->Attr.st_size);
+        position += entry->RecordLength;
+    }
+    munit_assert(position == Length);
+}
+
+static MunitResult test_msg_statdir(const MunitParameter params[] __notused, void *prv __notused)
+{
+    int                     status;
+    finesse_server_handle_t fsh;
+    finesse_client_handle_t fch;
+    fincomm_message         message;
+    finesse_msg *           test_message = NULL;
+    fincomm_message         fm_server    = NULL;
+    void *                  client;
+    fincomm_message         request;
+    void *                  buffer;
+    size_t                  buffer_size;
+    size_t                  length;
+    const void *            entries;
+    size_t                  entries_length;
+    uint32_t                entry_count;
+    uint64_t                next_offset;
+    int                     complete;
+    int                     result;
+    // a directory that fits in the message, then one that needs the aux buffer
+    const unsigned          counts[] = {8, 2000};
+
+    munit_assert(0 == setenv("FINESSE_COMM_STAT_LOG", __func__, 1));  // this sets the log file name
+
+    status = FinesseStartServerConnection(test_name, &fsh);
+    munit_assert(0 == status);
+    munit_assert(NULL != fsh);
+
+    status = FinesseStartClientConnection(&fch, test_name);
+    munit_assert(0 == status);
+    munit_assert(NULL != fch);
+
+    for (unsigned round = 0; round < sizeof(counts) / sizeof(counts[0]); round++) {
+        // client sends request
+        status = FinesseSendStatDirRequest(fch, "/mnt/pt/dir", "file*", 42 * round, &message);
+        munit_assert(0 == status);
+
+        // server gets the request
+        status = FinesseGetRequest(fsh, &client, &request);
+        assert(0 == status);
+        assert(NULL != request);
+        fm_server = (fincomm_message)request;
+        munit_assert(FINESSE_REQUEST == fm_server->MessageType);
+        test_message = (finesse_msg *)fm_server->Data;
+        munit_assert(FINESSE_MESSAGE_VERSION == test_message->Version);
+        munit_assert(FINESSE_NATIVE_MESSAGE == test_message->MessageClass);
+        munit_assert(FINESSE_NATIVE_REQ_STATDIR == test_message->Message.Native.Request.NativeRequestType);
+        munit_assert(42 * round == test_message->Message.Native.Request.Parameters.StatDir.Offset);
+        munit_assert_string_equal("/mnt/pt/dir", test_message->Message.Native.Request.Parameters.StatDir.Data);
+        munit_assert_string_equal("file*",
+                                  test_message->Message.Native.Request.Parameters.StatDir.Data + strlen("/mnt/pt/dir") + 1);
+
+        // server responds
+        buffer_size = 0;
+        buffer      = FinesseGetStatDirResponseBuffer(fsh, client, fm_server, &buffer_size);
+        munit_assert(NULL != buffer);
+        length = build_statdir_entries(buffer, buffer_size, counts[round]);
+        munit_assert((0 == round) == (length <= FINESSE_STATDIR_MAX_INLINE));
+        status = FinesseSendStatDirResponse(fsh, client, fm_server, buffer, counts[round], length, 4242, round, 0);
+        munit_assert(0 == status);
+
+        // client gets the response
+        status = FinesseGetStatDirResponse(fch, message, &entries, &entries_length, &entry_count, &next_offset, &complete, &result);
+        munit_assert(0 == status);
+        munit_assert(0 == result);
+        munit_assert(counts[round] == entry_count);
+        munit_assert(length == entries_length);
+        munit_assert(4242 == next_offset);
+        munit_assert((int)round == complete);
+        check_statdir_entries(entries, entries_length, counts[round]);
+        FinesseFreeStatDirResponse(fch, message, entries, entries_length);
+    }
+
+    // cleanup
+    status = FinesseStopClientConnection(fch);
+    munit_assert(0 == status);
+
+    status = FinesseStopServerConnection(fsh);
+    munit_assert(0 == status);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_msg_namespace(const MunitParameter params[] __notused, void *prv __notused)
+{
+    int                     status;
+    finesse_server_handle_t fsh;
+    finesse_client_handle_t fch;
+    fincomm_message         message;
+    fincomm_message         request;
+    finesse_msg *           test_message;
+    void *                  client;
+    const char *            oldname = "/mnt/old";
+    const char *            newname = "/mnt/new";
+    const char *            target  = "../somewhere/else";
+    char                    linkbuf[64];
+    ssize_t                 length;
+    struct stat             attr;
+    struct stat             attr_out;
+    int                     result;
+
+    munit_assert(0 == setenv("FINESSE_COMM_STAT_LOG", __func__, 1));  // this sets the log file name
+
+    status = FinesseStartServerConnection(test_name, &fsh);
+    munit_assert(0 == status);
+    munit_assert(NULL != fsh);
+
+    status = FinesseStartClientConnection(&fch, test_name);
+    munit_assert(0 == status);
+    munit_assert(NULL != fch);
+
+    // rename: both names travel in one request
+    status = FinesseSendRenameRequest(fch, NULL, oldname, NULL, newname, 0, &message);
+    munit_assert(0 == status);
+
+    status = FinesseGetRequest(fsh, &client, &request);
+    munit_assert(0 == status);
+    test_message = (finesse_msg *)request->Data;
+    munit_assert(FINESSE_FUSE_REQ_RENAME == test_message->Message.Fuse.Request.Type);
+    munit_assert(uuid_is_null(test_message->Message.Fuse.Request.Parameters.Rename.Parent));
+    munit_assert(0 == strcmp(oldname, test_message->Message.Fuse.Request.Parameters.Rename.OldAndNewName));
+    munit_assert(0 == strcmp(newname, test_message->Message.Fuse.Request.Parameters.Rename.OldAndNewName + strlen(oldname) + 1));
+
+    status = FinesseSendNamespaceResponse(fsh, client, request, EXDEV);
+    munit_assert(0 == status);
+
+    result = 0;
+    status = FinesseGetNamespaceResponse(fch, message, &result);
+    munit_assert(0 == status);
+    munit_assert(EXDEV == result);
+    FinesseFreeNamespaceResponse(fch, message);
+
+    // readlink: the link contents come back in the reply
+    status = FinesseSendReadlinkRequest(fch, NULL, newname, &message);
+    munit_assert(0 == status);
+
+    status = FinesseGetRequest(fsh, &client, &request);
+    munit_assert(0 == status);
+    test_message = (finesse_msg *)request->Data;
+    munit_assert(FINESSE_FUSE_REQ_READLINK == test_message->Message.Fuse.Request.Type);
+    munit_assert(0 == strcmp(newname, test_message->Message.Fuse.Request.Parameters.ReadLink.Name));
+
+    status = FinesseSendReadlinkResponse(fsh, client, request, target, strlen(target), 0);
+    munit_assert(0 == status);
+
+    result = 1;
+    length = 0;
+    status = FinesseGetReadlinkResponse(fch, message, linkbuf, sizeof(linkbuf), &length, &result);
+    munit_assert(0 == status);
+    munit_assert(0 == result);
+    munit_assert((ssize_t)strlen(target) == length);
+    munit_assert(0 == memcmp(target, linkbuf, length));
+    FinesseFreeReadlinkResponse(fch, message);
+
+    // setattr: the new attributes come back
+    memset(&attr, 0, sizeof(attr));
+    attr.st_mode = 0640;
+    status       = FinesseSendSetattrRequest(fch, NULL, oldname, &attr, FUSE_SET_ATTR_MODE, &message);
+    munit_assert(0 == status);
+
+    status = FinesseGetRequest(fsh, &client, &request);
+    munit_assert(0 == status);
+    test_message = (finesse_msg *)request->Data;
+    munit_assert(FINESSE_FUSE_REQ_SETATTR == test_message->Message.Fuse.Request.Type);
+    munit_assert(FUSE_SET_ATTR_MODE == test_message->Message.Fuse.Request.Parameters.SetAttr.ToSet);
+    munit_assert(0640 == test_message->Message.Fuse.Request.Parameters.SetAttr.Attr.st_mode);
+    munit_assert(0 == strcmp(oldname, test_message->Message.Fuse.Request.Parameters.SetAttr.Name));
+
+    attr.st_mode |= S_IFREG;
+    status = FinesseSendSetattrResponse(fsh, client, request, &attr, 1.0, 0);
+    munit_assert(0 == status);
+
+    result = 1;
+    memset(&attr_out, 0, sizeof(attr_out));
+    status = FinesseGetSetattrResponse(fch, message, &attr_out, &result);
+    munit_assert(0 == status);
+    munit_assert(0 == result);
+    munit_assert((S_IFREG | 0640) == attr_out.st_mode);
+    FinesseFreeSetattrResponse(fch, message);
+
+    // cleanup
+    status = FinesseStopClientConnection(fch);
+    munit_assert(0 == status);
+
+    status = FinesseStopServerConnection(fsh);
+    munit_assert(0 == status);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_msg_invalidation(const MunitParameter params[] __notused, void *prv __notused)
+{
+    int                     status;
+    finesse_server_handle_t fsh;
+    finesse_client_handle_t fch;
+    finesse_invalidation_t  invalidation;
+    finesse_invalidation_t  received[4];
+    uint64_t                cursor;
+    unsigned                count;
+
+    munit_assert(0 == setenv("FINESSE_COMM_STAT_LOG", __func__, 1));  // this sets the log file name
+
+    status = FinesseStartServerConnection(test_name, &fsh);
+    munit_assert(0 == status);
+    munit_assert(NULL != fsh);
+
+    status = FinesseStartClientConnection(&fch, test_name);
+    munit_assert(0 == status);
+    munit_assert(NULL != fch);
+
+    cursor = FinesseGetInvalidationCursor(fch);
+
+    // server tells the client a name went away
+    memset(&invalidation, 0, sizeof(invalidation));
+    invalidation.Type       = FINESSE_INVALIDATE_DELETE;
+    invalidation.Parent     = 1;
+    invalidation.Inode      = 42;
+    invalidation.NameLength = 7;
+    memcpy(invalidation.Name, "oldfile", 7);
+    uuid_generate(invalidation.Key);
+    FinesseSendInvalidation(fsh, &invalidation);
+
+    // client picks it up without asking the server
+    status = FinesseGetInvalidations(fch, &cursor, received, 4, &count);
+    munit_assert(0 == status);
+    munit_assert(1 == count);
+    munit_assert(FINESSE_INVALIDATE_DELETE == received[0].Type);
+    munit_assert(42 == received[0].Inode);
+    munit_assert(1 == received[0].Parent);
+    munit_assert(7 == received[0].NameLength);
+    munit_assert(0 == memcmp("oldfile", received[0].Name, 7));
+    munit_assert(0 == uuid_compare(invalidation.Key, received[0].Key));
+
+    // and only once
+    status = FinesseGetInvalidations(fch, &cursor, received, 4, &count);
+    munit_assert(0 == status);
+    munit_assert(0 == count);
+
+    // cleanup
+    status = FinesseStopClientConnection(fch);
+    munit_assert(0 == status);
+
+    status = FinesseStopServerConnection(fsh);
+    munit_assert(0 == status);
+
+    return MUNIT_OK;
+}
+
 static const MunitTest finesse_tests[] = {
     TEST("/null", test_null, NULL),
     TEST("/server/connect", test_server_connect, NULL),
@@ -819,9 +1429,15 @@ static const MunitTest finesse_tests[] = {
     TEST("/client/statfs", test_msg_statfs, NULL),
     TEST("/client/unlink", test_msg_unlink, NULL),
     TEST("/client/stat", test_msg_stat, NULL),
+    TEST("/client/long_stat", test_msg_long_stat, NULL),
     TEST("/client/create", test_msg_create, NULL),
     TEST("/client/access", test_msg_access, NULL),
     TEST("/client/server stat", test_msg_server_stat, NULL),
+    TEST("/client/path search", test_msg_path_search, NULL),
+    TEST("/client/compound", test_msg_compound, NULL),
+    TEST("/client/statdir", test_msg_statdir, NULL),
+    TEST("/client/invalidation", test_msg_invalidation, NULL),
+    TEST("/client/namespace", test_msg_namespace, NULL),
     TEST(NULL, NULL, NULL),
 };
 
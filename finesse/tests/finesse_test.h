@@ -9,12 +9,14 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <finesse.h>
+#include <limits.h>
 #include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 #include <uuid/uuid.h>
 #include "munit.h"
@@ -38,3 +40,16 @@ extern const MunitSuite fuse_suite;
 
 extern MunitResult test_null(const MunitParameter params[], void *prv);
 extern MunitSuite *SetupMunitSuites(void);
+
+//
+// For the tests that run against a mounted Finesse file system (testpathsearch, teststatdir,
+// testmetadata).  Each takes a scratch directory from the environment and skips without one;
+// the workloads that time Finesse against the C library also want FINESSE_BENCHMARK set.
+//
+#define TEST_DIR_MAX (PATH_MAX - NAME_MAX - 2)  // a scratch directory, with room for a name in it
+
+extern unsigned    test_env_unsigned(const char *Name, unsigned Default);
+extern int         test_benchmark_enabled(void);
+extern const char *test_find_mountpoint(const char *Path);
+extern double      test_elapsed_us(const struct timespec *Start, const struct timespec *Stop);
+extern MunitSuite *test_single_suite(const MunitSuite *Suite);
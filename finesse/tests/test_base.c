@@ -3,11 +3,8 @@
  */
 
 #include "finesse_test.h"
-
-
-#if !defined(__notused)
-#define __notused __attribute__((unused))
-#endif // 
+#include <mntent.h>
+#include <stdio.h>
 
 MunitResult
 test_null(
@@ -35,6 +32,77 @@ main(
     return munit_suite_main(&suite, NULL, argc, argv);
 }
 
+unsigned
+test_env_unsigned(
+    const char *Name,
+    unsigned Default)
+{
+    const char *value = getenv(Name);
+
+    if ((NULL == value) || (0 == atoi(value))) {
+        return Default;
+    }
+    return (unsigned)atoi(value);
+}
+
+int
+test_benchmark_enabled(void)
+{
+    return NULL != getenv("FINESSE_BENCHMARK");
+}
+
+//
+// The mount point of the file system Path is on (the longest mount point that is a prefix of
+// it), or NULL if there isn't one.
+//
+const char *
+test_find_mountpoint(
+    const char *Path)
+{
+    FILE *         mfile;
+    struct mntent *entry = NULL;
+    static char    mountpoint[PATH_MAX];
+    size_t         best = 0;
+
+    mfile = setmntent("/etc/mtab", "r");
+    munit_assert(NULL != mfile);
+
+    for (entry = getmntent(mfile); NULL != entry; entry = getmntent(mfile)) {
+        size_t length = strlen(entry->mnt_dir);
+
+        if ((length > best) && (length < sizeof(mountpoint)) && (0 == strncmp(Path, entry->mnt_dir, length)) &&
+            (('/' == Path[length]) || ('\0' == Path[length]))) {
+            best = length;
+            memcpy(mountpoint, entry->mnt_dir, length + 1);
+        }
+    }
+    endmntent(mfile);
+
+    return best > 0 ? mountpoint : NULL;
+}
+
+double
+test_elapsed_us(
+    const struct timespec *Start,
+    const struct timespec *Stop)
+{
+    return (double)(Stop->tv_sec - Start->tv_sec) * 1.0e6 + (double)(Stop->tv_nsec - Start->tv_nsec) / 1.0e3;
+}
+
+//
+// SetupMunitSuites for a test program with just one suite.
+//
+MunitSuite *
+test_single_suite(
+    const MunitSuite *Suite)
+{
+    static MunitSuite suites[2];
+
+    memset(suites, 0, sizeof(suites));
+    suites[0] = *Suite;
+    return suites;
+}
+
 /*
  * Local variables:
  * mode: C
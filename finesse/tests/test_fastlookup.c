@@ -567,10 +567,61 @@ static MunitResult test_refcount(const MunitParameter params[] __notused, void *
     return MUNIT_OK;
 }
 
+//
+// Entries come from an arena that belongs to the table; released entries are marked freed and
+// handed out again rather than going back to the allocator.
+//
+static MunitResult test_arena(const MunitParameter params[] __notused, void *prv __notused)
+{
+    finesse_object_table_t *table   = NULL;
+    finesse_object_t **     objects = NULL;
+    finesse_object_t *      first   = NULL;
+    const unsigned          count   = 3000;  // several chunks worth
+    unsigned                reused  = 0;
+    uuid_t                  uuid;
+
+    table = FinesseCreateTable(0);
+    munit_assert(NULL != table);
+
+    objects = (finesse_object_t **)malloc(sizeof(finesse_object_t *) * count);
+    munit_assert(NULL != objects);
+
+    for (unsigned pass = 0; pass < 2; pass++) {
+        for (unsigned index = 0; index < count; index++) {
+            uuid_generate(uuid);
+            objects[index] = FinesseObjectCreate(table, (fuse_ino_t)(index + 1), &uuid);
+            munit_assert(NULL != objects[index]);
+            munit_assert(0 == uuid_compare(uuid, objects[index]->uuid));
+            munit_assert(0 == objects[index]->freed);
+            FinesseObjectRelease(table, objects[index]);  // creation returns two references
+            if (objects[index] == first) {
+                reused++;
+            }
+        }
+        munit_assert(count == FinesseObjectGetTableSize(table));
+
+        if (0 == pass) {
+            first = objects[0];
+        }
+
+        for (unsigned index = 0; index < count; index++) {
+            FinesseObjectRelease(table, objects[index]);
+            munit_assert(0 != objects[index]->freed);
+        }
+        munit_assert(0 == FinesseObjectGetTableSize(table));
+    }
+    munit_assert(1 == reused);
+
+    free(objects);
+    FinesseDestroyTable(table);
+
+    return MUNIT_OK;
+}
+
 static MunitTest tests[] = {
     TEST("/null", test_null, NULL),           TEST("/hash", test_hash, NULL), TEST("/basics", test_table_basics, NULL),
     TEST("/insert", test_table_insert, NULL), TEST("/mt", test_mt, NULL),     TEST("/collision", test_collision, NULL),
-    TEST("/refcount", test_refcount, NULL),   TEST(NULL, NULL, NULL),
+    TEST("/refcount", test_refcount, NULL),   TEST("/arena", test_arena, NULL),         TEST(NULL, NULL, NULL),
 };
 
 const MunitSuite fastlookup_suite = {
@@ -0,0 +1,459 @@
+/*
+ * Copyright (c) 2020, Tony Mason. All rights reserved.
+ *
+ * Name space operations against a Finesse file system: check that mkdir, create, rename,
+ * link, symlink, readlink and the setattr calls done through the server match what the
+ * kernel sees, that stat, lstat and fstatat through the server follow symbolic links as the
+ * kernel does, and compare an untar-style create-heavy workload run through the C library
+ * with the same workload run through Finesse.
+ *
+ * FINESSE_METADATA_DIR names a (scratch) directory on a mounted Finesse file system; the
+ * tests are skipped without it, and the untar comparison is a benchmark that also wants
+ * FINESSE_BENCHMARK.  FINESSE_METADATA_FILES and FINESSE_METADATA_FANOUT size the workload
+ * (10,000 files, 100 to a directory, by default).  The message encoding itself is checked
+ * by test_msg_namespace in finesse_test.c.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <finesse.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#include "fincomm.h"
+#include "finesse_test.h"
+#include "munit.h"
+
+typedef struct {
+    const char *root;
+    const char *mountpoint;
+    unsigned    file_count;
+    unsigned    fanout;
+} metadata_config_t;
+
+static metadata_config_t config;
+
+//
+// The workload is written once against this table, so the C library and Finesse runs do
+// exactly the same thing.
+//
+typedef struct {
+    const char *name;
+    int (*open)(const char *pathname, int flags, ...);
+    int (*close)(int fd);
+    int (*mkdir)(const char *path, mode_t mode);
+    int (*rmdir)(const char *path);
+    int (*unlink)(const char *pathname);
+    int (*rename)(const char *oldpath, const char *newpath);
+    int (*symlink)(const char *target, const char *linkpath);
+    int (*chmod)(const char *pathname, mode_t mode);
+    int (*utimensat)(int dirfd, const char *pathname, const struct timespec times[2], int flags);
+} metadata_ops_t;
+
+static const metadata_ops_t native_ops = {
+    .name      = "C library",
+    .open      = open,
+    .close     = close,
+    .mkdir     = mkdir,
+    .rmdir     = rmdir,
+    .unlink    = unlink,
+    .rename    = rename,
+    .symlink   = symlink,
+    .chmod     = chmod,
+    .utimensat = utimensat,
+};
+
+static const metadata_ops_t finesse_ops = {
+    .name      = "Finesse",
+    .open      = finesse_open,
+    .close     = finesse_close,
+    .mkdir     = finesse_mkdir,
+    .rmdir     = finesse_rmdir,
+    .unlink    = finesse_unlink,
+    .rename    = finesse_rename,
+    .symlink   = finesse_symlink,
+    .chmod     = finesse_chmod,
+    .utimensat = finesse_utimensat,
+};
+
+static int setup(void)
+{
+    if (NULL != config.mountpoint) {
+        return 0;
+    }
+
+    config.root = getenv("FINESSE_METADATA_DIR");
+    if (NULL == config.root) {
+        return ENOENT;
+    }
+
+    config.mountpoint = test_find_mountpoint(config.root);
+    munit_assert(NULL != config.mountpoint);
+
+    config.file_count = test_env_unsigned("FINESSE_METADATA_FILES", 10000);
+    config.fanout     = test_env_unsigned("FINESSE_METADATA_FANOUT", 100);
+
+    (void)mkdir(config.root, 0755);
+
+    return 0;
+}
+
+static const FINESSE_FUSE_REQ_TYPE metadata_requests[] = {
+    FINESSE_FUSE_REQ_SETATTR, FINESSE_FUSE_REQ_MKDIR,  FINESSE_FUSE_REQ_UNLINK, FINESSE_FUSE_REQ_RMDIR,
+    FINESSE_FUSE_REQ_SYMLINK, FINESSE_FUSE_REQ_RENAME, FINESSE_FUSE_REQ_CREATE,
+};
+
+static uint64_t metadata_messages(finesse_client_handle_t Client)
+{
+    fincomm_message    message;
+    FinesseServerStat *server_stat;
+    uint64_t           count = 0;
+    int                status;
+
+    status = FinesseSendServerStatRequest(Client, &message);
+    munit_assert(0 == status);
+    status = FinesseGetServerStatResponse(Client, message, &server_stat);
+    munit_assert(0 == status);
+    for (unsigned index = 0; index < sizeof(metadata_requests) / sizeof(metadata_requests[0]); index++) {
+        count += server_stat->FuseRequests[metadata_requests[index] - FINESSE_FUSE_REQ_LOOKUP];
+    }
+    FinesseFreeServerStatResponse(Client, message);
+
+    return count;
+}
+
+//
+// What tar x (or a checkout) does for each file: create it under a temporary name, write it,
+// set its mode and times and rename it into place.  Every 16th entry is a symlink as well.
+//
+static void untar(const metadata_ops_t *Ops, const char *Root)
+{
+    char            scratch[PATH_MAX];
+    char            final[PATH_MAX];
+    char            data[512];
+    struct timespec times[2] = {{.tv_sec = 1000000000, .tv_nsec = 0}, {.tv_sec = 1000000000, .tv_nsec = 0}};
+    int             fd;
+
+    memset(data, 'x', sizeof(data));
+    munit_assert(0 == Ops->mkdir(Root, 0755));
+
+    for (unsigned file = 0; file < config.file_count; file++) {
+        if (0 == file % config.fanout) {
+            snprintf(scratch, sizeof(scratch), "%s/d%05u", Root, file / config.fanout);
+            munit_assert(0 == Ops->mkdir(scratch, 0755));
+        }
+
+        snprintf(scratch, sizeof(scratch), "%s/d%05u/.f%05u.tmp", Root, file / config.fanout, file);
+        snprintf(final, sizeof(final), "%s/d%05u/f%05u", Root, file / config.fanout, file);
+
+        fd = Ops->open(scratch, O_CREAT | O_EXCL | O_WRONLY, 0600);
+        munit_assert(fd >= 0);
+        munit_assert((ssize_t)sizeof(data) == write(fd, data, sizeof(data)));
+        munit_assert(0 == Ops->close(fd));
+        munit_assert(0 == Ops->chmod(scratch, 0644));
+        munit_assert(0 == Ops->utimensat(AT_FDCWD, scratch, times, 0));
+        munit_assert(0 == Ops->rename(scratch, final));
+
+        if (0 == file % 16) {
+            snprintf(scratch, sizeof(scratch), "%s/d%05u/l%05u", Root, file / config.fanout, file);
+            munit_assert(0 == Ops->symlink("../README", scratch));
+        }
+    }
+}
+
+static void remove_tree(const metadata_ops_t *Ops, const char *Root)
+{
+    char scratch[PATH_MAX];
+
+    for (unsigned file = 0; file < config.file_count; file++) {
+        snprintf(scratch, sizeof(scratch), "%s/d%05u/f%05u", Root, file / config.fanout, file);
+        munit_assert(0 == Ops->unlink(scratch));
+        if (0 == file % 16) {
+            snprintf(scratch, sizeof(scratch), "%s/d%05u/l%05u", Root, file / config.fanout, file);
+            munit_assert(0 == Ops->unlink(scratch));
+        }
+        if ((config.fanout - 1 == file % config.fanout) || (config.file_count - 1 == file)) {
+            snprintf(scratch, sizeof(scratch), "%s/d%05u", Root, file / config.fanout);
+            munit_assert(0 == Ops->rmdir(scratch));
+        }
+    }
+    munit_assert(0 == Ops->rmdir(Root));
+}
+
+static MunitResult test_namespace(const MunitParameter params[] __notused, void *prv __notused)
+{
+    char        dir[TEST_DIR_MAX];
+    char        file[PATH_MAX];
+    char        other[PATH_MAX];
+    char        linkbuf[PATH_MAX];
+    struct stat statbuf;
+    struct stat linkstat;
+    int         fd;
+
+    if (0 != setup()) {
+        return MUNIT_SKIP;
+    }
+
+    finesse_init();
+
+    snprintf(dir, sizeof(dir), "%s/ns-%d", config.root, (int)getpid());
+    snprintf(file, sizeof(file), "%s/file", dir);
+    snprintf(other, sizeof(other), "%s/other", dir);
+
+    // mkdir applies the umask, like the kernel would
+    finesse_umask(022);
+    munit_assert(0 == finesse_mkdir(dir, 0777));
+    munit_assert(0 == lstat(dir, &statbuf));
+    munit_assert(S_ISDIR(statbuf.st_mode));
+    munit_assert(0755 == (statbuf.st_mode & 07777));
+    munit_assert(-1 == finesse_mkdir(dir, 0777));
+    munit_assert(EEXIST == errno);
+
+    // create, and create exclusively
+    fd = finesse_open(file, O_CREAT | O_EXCL | O_WRONLY, 0666);
+    munit_assert(fd >= 0);
+    munit_assert(5 == write(fd, "hello", 5));
+    munit_assert(0 == finesse_close(fd));
+    munit_assert(0 == lstat(file, &statbuf));
+    munit_assert(S_ISREG(statbuf.st_mode));
+    munit_assert(0644 == (statbuf.st_mode & 07777));
+    munit_assert(-1 == finesse_open(file, O_CREAT | O_EXCL | O_WRONLY, 0666));
+    munit_assert(EEXIST == errno);
+    fd = finesse_open(file, O_CREAT | O_RDONLY, 0666);
+    munit_assert(fd >= 0);
+    munit_assert(0 == finesse_close(fd));
+
+    // setattr
+    munit_assert(0 == finesse_chmod(file, 0600));
+    munit_assert(0 == finesse_truncate(file, 2));
+    munit_assert(0 == lstat(file, &statbuf));
+    munit_assert(0600 == (statbuf.st_mode & 07777));
+    munit_assert(2 == statbuf.st_size);
+
+    // rename, and rename over an existing name
+    munit_assert(0 == finesse_rename(file, other));
+    munit_assert(-1 == lstat(file, &statbuf));
+    munit_assert(0 == lstat(other, &statbuf));
+    fd = finesse_open(file, O_CREAT | O_EXCL | O_WRONLY, 0666);
+    munit_assert(fd >= 0);
+    munit_assert(0 == finesse_close(fd));
+    munit_assert(0 == finesse_rename(other, file));
+    munit_assert(0 == lstat(file, &statbuf));
+    munit_assert(2 == statbuf.st_size);
+
+    // hard link
+    munit_assert(0 == finesse_link(file, other));
+    munit_assert(0 == lstat(other, &linkstat));
+    munit_assert(statbuf.st_ino == linkstat.st_ino);
+    munit_assert(2 == linkstat.st_nlink);
+    munit_assert(0 == finesse_unlink(other));
+
+    // symlink and readlink
+    munit_assert(0 == finesse_symlink("file", other));
+    munit_assert(0 == lstat(other, &linkstat));
+    munit_assert(S_ISLNK(linkstat.st_mode));
+    munit_assert(4 == finesse_readlink(other, linkbuf, sizeof(linkbuf)));
+    munit_assert(0 == memcmp("file", linkbuf, 4));
+    munit_assert(-1 == finesse_readlink(file, linkbuf, sizeof(linkbuf)));
+    munit_assert(EINVAL == errno);
+    munit_assert(0 == finesse_unlink(other));
+
+    // rmdir
+    munit_assert(-1 == finesse_rmdir(dir));
+    munit_assert(ENOTEMPTY == errno);
+    munit_assert(0 == finesse_unlink(file));
+    munit_assert(0 == finesse_rmdir(dir));
+    munit_assert(-1 == lstat(dir, &statbuf));
+    munit_assert(ENOENT == errno);
+
+    return MUNIT_OK;
+}
+
+// Finesse's answer for Path must be the kernel's, with and without following a final link
+static void check_stat(const char *Path)
+{
+    struct stat statbuf;
+    struct stat finstat;
+    int         status;
+    int         error;
+
+    status = stat(Path, &statbuf);
+    error  = errno;
+    munit_assert(status == finesse_stat(Path, &finstat));
+    if (0 == status) {
+        munit_assert(statbuf.st_ino == finstat.st_ino);
+        munit_assert(statbuf.st_mode == finstat.st_mode);
+        munit_assert(statbuf.st_size == finstat.st_size);
+    }
+    else {
+        munit_assert(error == errno);
+    }
+
+    status = lstat(Path, &statbuf);
+    error  = errno;
+    munit_assert(status == finesse_lstat(Path, &finstat));
+    if (0 == status) {
+        munit_assert(statbuf.st_ino == finstat.st_ino);
+        munit_assert(statbuf.st_mode == finstat.st_mode);
+    }
+    else {
+        munit_assert(error == errno);
+    }
+    munit_assert(status == finesse_fstatat(AT_FDCWD, Path, &finstat, AT_SYMLINK_NOFOLLOW));
+}
+
+static MunitResult test_symlinks(const MunitParameter params[] __notused, void *prv __notused)
+{
+    static const char *links[][2] = {
+        {"rel", "file"},        // relative
+        {"dirlink", "sub"},     // to a directory, walked through below
+        {"up", "sub/../file"},  // back up through the directory it names
+        {"chain", "rel"},       // to another link
+        {"out", "/"},           // out of the mount: the kernel has to follow it
+        {"loop1", "loop2"},     // ELOOP
+        {"loop2", "loop1"},
+        {"dangling", "missing"},
+    };
+    static const char *paths[] = {
+        "rel", "dirlink", "dirlink/", "dirlink/subfile", "up", "chain", "out", "out/tmp", "loop1", "loop1/x", "dangling",
+        "abs", "abs/subfile", "rel/x",
+    };
+    char dir[TEST_DIR_MAX];
+    char path[PATH_MAX];
+    char target[PATH_MAX];
+    int  fd;
+
+    if (0 != setup()) {
+        return MUNIT_SKIP;
+    }
+
+    finesse_init();
+
+    snprintf(dir, sizeof(dir), "%s/sl-%d", config.root, (int)getpid());
+    munit_assert(0 == mkdir(dir, 0755));
+    snprintf(path, sizeof(path), "%s/sub", dir);
+    munit_assert(0 == mkdir(path, 0755));
+    snprintf(path, sizeof(path), "%s/sub/subfile", dir);
+    fd = open(path, O_CREAT | O_WRONLY, 0644);
+    munit_assert(fd >= 0);
+    munit_assert(0 == close(fd));
+    snprintf(path, sizeof(path), "%s/file", dir);
+    fd = open(path, O_CREAT | O_WRONLY, 0644);
+    munit_assert(fd >= 0);
+    munit_assert(3 == write(fd, "abc", 3));
+    munit_assert(0 == close(fd));
+
+    for (unsigned index = 0; index < sizeof(links) / sizeof(links[0]); index++) {
+        snprintf(path, sizeof(path), "%s/%s", dir, links[index][0]);
+        munit_assert(0 == symlink(links[index][1], path));
+    }
+
+    // absolute, but inside the mount
+    snprintf(target, sizeof(target), "%s/sub", dir);
+    snprintf(path, sizeof(path), "%s/abs", dir);
+    munit_assert(0 == symlink(target, path));
+
+    // Twice: the second time the links come from the server's cache
+    for (unsigned pass = 0; pass < 2; pass++) {
+        for (unsigned index = 0; index < sizeof(paths) / sizeof(paths[0]); index++) {
+            snprintf(path, sizeof(path), "%s/%s", dir, paths[index]);
+            check_stat(path);
+        }
+    }
+
+    // A link that changes is seen to change
+    snprintf(path, sizeof(path), "%s/rel", dir);
+    munit_assert(0 == unlink(path));
+    munit_assert(0 == symlink("sub", path));
+    check_stat(path);
+    munit_assert(0 == unlink(path));
+
+    for (unsigned index = 1; index < sizeof(links) / sizeof(links[0]); index++) {
+        snprintf(path, sizeof(path), "%s/%s", dir, links[index][0]);
+        munit_assert(0 == unlink(path));
+    }
+    snprintf(path, sizeof(path), "%s/abs", dir);
+    munit_assert(0 == unlink(path));
+    snprintf(path, sizeof(path), "%s/file", dir);
+    munit_assert(0 == unlink(path));
+    snprintf(path, sizeof(path), "%s/sub/subfile", dir);
+    munit_assert(0 == unlink(path));
+    snprintf(path, sizeof(path), "%s/sub", dir);
+    munit_assert(0 == rmdir(path));
+    munit_assert(0 == rmdir(dir));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_untar(const MunitParameter params[] __notused, void *prv __notused)
+{
+    const metadata_ops_t *  ops[] = {&native_ops, &finesse_ops};
+    finesse_client_handle_t fch;
+    uint64_t                messages;
+    struct timespec         start, stop;
+    double                  create_us, remove_us;
+    char                    root[TEST_DIR_MAX];
+
+    if (!test_benchmark_enabled() || (0 != setup())) {
+        return MUNIT_SKIP;
+    }
+
+    finesse_init();
+    munit_assert(0 == FinesseStartClientConnection(&fch, config.mountpoint));
+
+    fprintf(stderr, "\nuntar of %u files, %u to a directory\n", config.file_count, config.fanout);
+
+    for (unsigned index = 0; index < sizeof(ops) / sizeof(ops[0]); index++) {
+        snprintf(root, sizeof(root), "%s/untar-%d-%u", config.root, (int)getpid(), index);
+
+        messages = metadata_messages(fch);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        untar(ops[index], root);
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+        create_us = test_elapsed_us(&start, &stop);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        remove_tree(ops[index], root);
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+        remove_us = test_elapsed_us(&start, &stop);
+        messages  = metadata_messages(fch) - messages;
+
+        fprintf(stderr, "  %-10s %9lu messages  create %8.2f s %10.0f files/s  remove %8.2f s %10.0f files/s\n", ops[index]->name,
+                (unsigned long)messages, create_us / 1.0e6, config.file_count / (create_us / 1.0e6), remove_us / 1.0e6,
+                config.file_count / (remove_us / 1.0e6));
+    }
+
+    munit_assert(0 == FinesseStopClientConnection(fch));
+
+    return MUNIT_OK;
+}
+
+static MunitTest metadata_tests[] = {
+    TEST((char *)(uintptr_t) "/null", test_null, NULL),
+    TEST((char *)(uintptr_t) "/namespace", test_namespace, NULL),
+    TEST((char *)(uintptr_t) "/symlinks", test_symlinks, NULL),
+    TEST((char *)(uintptr_t) "/untar", test_untar, NULL),
+    TEST(NULL, NULL, NULL),
+};
+
+const MunitSuite metadata_suite = {
+    .prefix     = (char *)(uintptr_t) "/metadata",
+    .tests      = metadata_tests,
+    .suites     = NULL,
+    .iterations = 1,
+    .options    = MUNIT_SUITE_OPTION_NONE,
+};
+
+MunitSuite *SetupMunitSuites()
+{
+    return test_single_suite(&metadata_suite);
+}
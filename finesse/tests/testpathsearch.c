@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2020, Tony Mason. All rights reserved.
+ *
+ * Path search against a Finesse file system: check that the server's answer matches
+ * what stat finds, and compare the cost of an include path search done with stat
+ * calls against the same search done with path search messages.
+ *
+ * FINESSE_PATH_SEARCH_DIR names a (scratch) directory on a mounted Finesse file system;
+ * the tests are skipped without it, and the timed search storm is a benchmark that also
+ * wants FINESSE_BENCHMARK.  FINESSE_PATH_SEARCH_DIRS and FINESSE_PATH_SEARCH_HEADERS size
+ * the include tree (64 directories, 256 headers by default).  The message encoding itself
+ * is checked by test_msg_path_search in finesse_test.c.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <finesse.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#include "fincomm.h"
+#include "finesse_test.h"
+#include "munit.h"
+
+typedef struct {
+    const char *root;
+    const char *mountpoint;
+    unsigned    dir_count;
+    unsigned    header_count;
+    char **     dirs;     // NULL terminated (the -I list)
+    char **     headers;  // the #include names
+    unsigned *  home;     // the directory each header lives in
+} pathsearch_tree_t;
+
+static pathsearch_tree_t tree;
+
+static char *make_path(const char *Dir, const char *Name)
+{
+    char *path = NULL;
+
+    munit_assert(0 < asprintf(&path, "%s/%s", Dir, Name));
+    return path;
+}
+
+static void touch(const char *Path)
+{
+    int fd = open(Path, O_CREAT | O_WRONLY, 0644);
+
+    munit_assert(fd >= 0);
+    close(fd);
+}
+
+//
+// The tree looks like a large project's include path: many directories, each header in
+// exactly one of them, a few headers in subdirectories ("sys/..."), a symlinked header
+// and a symlinked include directory (neither of which the server resolves).
+//
+static int build_tree(void)
+{
+    char name[64];
+    char scratch[PATH_MAX];
+
+    if (NULL != tree.dirs) {
+        return 0;
+    }
+
+    tree.root = getenv("FINESSE_PATH_SEARCH_DIR");
+    if (NULL == tree.root) {
+        return ENOENT;
+    }
+
+    tree.mountpoint = test_find_mountpoint(tree.root);
+    munit_assert(NULL != tree.mountpoint);
+
+    tree.dir_count    = test_env_unsigned("FINESSE_PATH_SEARCH_DIRS", 64);
+    tree.header_count = test_env_unsigned("FINESSE_PATH_SEARCH_HEADERS", 256);
+    tree.dirs         = calloc(tree.dir_count + 2, sizeof(char *));
+    tree.headers      = calloc(tree.header_count + 1, sizeof(char *));
+    tree.home         = calloc(tree.header_count, sizeof(unsigned));
+    munit_assert((NULL != tree.dirs) && (NULL != tree.headers) && (NULL != tree.home));
+
+    (void)mkdir(tree.root, 0755);
+
+    for (unsigned index = 0; index < tree.dir_count; index++) {
+        snprintf(name, sizeof(name), "inc%03u", index);
+        tree.dirs[index] = make_path(tree.root, name);
+        (void)mkdir(tree.dirs[index], 0755);
+        snprintf(scratch, sizeof(scratch), "%s/sys", tree.dirs[index]);
+        (void)mkdir(scratch, 0755);
+        snprintf(scratch, sizeof(scratch), "%s/unrelated.h", tree.dirs[index]);
+        touch(scratch);
+    }
+
+    // The last directory on the path is a symlink to the first
+    snprintf(name, sizeof(name), "inc%03u", tree.dir_count);
+    tree.dirs[tree.dir_count] = make_path(tree.root, name);
+    (void)unlink(tree.dirs[tree.dir_count]);
+    munit_assert(0 == symlink("inc000", tree.dirs[tree.dir_count]));
+
+    for (unsigned index = 0; index < tree.header_count; index++) {
+        if (0 == index % 8) {
+            snprintf(name, sizeof(name), "sys/h%04u.h", index);
+        }
+        else {
+            snprintf(name, sizeof(name), "h%04u.h", index);
+        }
+        tree.headers[index] = strdup(name);
+        tree.home[index]    = (index * 37) % tree.dir_count;
+        snprintf(scratch, sizeof(scratch), "%s/%s", tree.dirs[tree.home[index]], name);
+        touch(scratch);
+    }
+
+    // A header that is a symlink (to a header elsewhere on the path)
+    snprintf(scratch, sizeof(scratch), "%s/linked.h", tree.dirs[tree.dir_count / 2]);
+    (void)unlink(scratch);
+    snprintf(name, sizeof(name), "../inc%03u/%s", tree.home[1], tree.headers[1]);
+    munit_assert(0 == symlink(name, scratch));
+
+    return 0;
+}
+
+// What a compiler does today: stat each directory in turn
+static int native_search(const char *Header, unsigned *PathIndex, unsigned *StatCalls)
+{
+    char        scratch[PATH_MAX];
+    struct stat statbuf;
+
+    for (unsigned index = 0; NULL != tree.dirs[index]; index++) {
+        snprintf(scratch, sizeof(scratch), "%s/%s", tree.dirs[index], Header);
+        (*StatCalls)++;
+        if ((0 == stat(scratch, &statbuf)) && !S_ISDIR(statbuf.st_mode)) {
+            *PathIndex = index;
+            return 0;
+        }
+    }
+    return ENOENT;
+}
+
+static uint64_t path_search_messages(void)
+{
+    finesse_client_handle_t fch;
+    fincomm_message         message;
+    FinesseServerStat *     server_stat;
+    uint64_t                count;
+    int                     status;
+
+    status = FinesseStartClientConnection(&fch, tree.mountpoint);
+    munit_assert(0 == status);
+    status = FinesseSendServerStatRequest(fch, &message);
+    munit_assert(0 == status);
+    status = FinesseGetServerStatResponse(fch, message, &server_stat);
+    munit_assert(0 == status);
+    count = server_stat->NativeRequests[FINESSE_NATIVE_REQ_PATH_SEARCH - FINESSE_NATIVE_REQ_TEST];
+    FinesseFreeServerStatResponse(fch, message);
+    status = FinesseStopClientConnection(fch);
+    munit_assert(0 == status);
+
+    return count;
+}
+
+static MunitResult test_search(const MunitParameter params[] __notused, void *prv __notused)
+{
+    const char *                files[3];
+    finesse_path_search_match_t matches[16];
+    unsigned                    match_count;
+    unsigned                    file_index, path_index, native_index, stat_calls = 0;
+    int                         status;
+
+    if (0 != build_tree()) {
+        return MUNIT_SKIP;
+    }
+
+    finesse_init();
+
+    for (unsigned index = 0; index < tree.header_count; index++) {
+        files[0] = tree.headers[index];
+        files[1] = NULL;
+
+        status = finesse_search_path(files, (const char **)tree.dirs, &file_index, &path_index);
+        munit_assert(0 == status);
+        munit_assert(0 == native_search(tree.headers[index], &native_index, &stat_calls));
+        munit_assert(0 == file_index);
+        munit_assert(native_index == path_index);
+    }
+
+    // A name that isn't anywhere
+    files[0] = "missing.h";
+    files[1] = NULL;
+    munit_assert(-1 == finesse_search_path(files, (const char **)tree.dirs, &file_index, &path_index));
+    munit_assert(ENOENT == errno);
+
+    // The symlinked header is found (by the client), and so is everything in the symlinked directory
+    files[0] = "linked.h";
+    files[1] = tree.headers[0];
+    files[2] = NULL;
+    match_count = sizeof(matches) / sizeof(matches[0]);
+    status      = finesse_search_path_all(files, (const char **)tree.dirs, matches, &match_count);
+    munit_assert(0 == status);
+    munit_assert(3 == match_count);
+    for (unsigned index = 0; index < match_count; index++) {
+        munit_assert(S_ISREG(matches[index].Mode));
+    }
+    // the header in its home directory, linked.h, then the header again through the symlinked directory
+    munit_assert((1 == matches[0].FileIndex) && (0 == matches[0].PathIndex));
+    munit_assert((0 == matches[1].FileIndex) && (tree.dir_count / 2 == matches[1].PathIndex));
+    munit_assert((1 == matches[2].FileIndex) && (tree.dir_count == matches[2].PathIndex));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_storm(const MunitParameter params[] __notused, void *prv __notused)
+{
+    const char *    files[2] = {NULL, NULL};
+    unsigned        file_index, path_index, stat_calls = 0, searches = 0;
+    uint64_t        messages;
+    struct timespec start, stop;
+    double          native_us, finesse_us;
+    unsigned        rounds = test_env_unsigned("FINESSE_PATH_SEARCH_ROUNDS", 4);
+
+    if (!test_benchmark_enabled() || (0 != build_tree())) {
+        return MUNIT_SKIP;
+    }
+
+    finesse_init();
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (unsigned round = 0; round < rounds; round++) {
+        for (unsigned index = 0; index < tree.header_count; index++) {
+            munit_assert(0 == native_search(tree.headers[index], &path_index, &stat_calls));
+            searches++;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    native_us = test_elapsed_us(&start, &stop);
+
+    messages = path_search_messages();
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (unsigned round = 0; round < rounds; round++) {
+        for (unsigned index = 0; index < tree.header_count; index++) {
+            files[0] = tree.headers[index];
+            munit_assert(0 == finesse_search_path(files, (const char **)tree.dirs, &file_index, &path_index));
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    finesse_us = test_elapsed_us(&start, &stop);
+    messages   = path_search_messages() - messages;
+
+    fprintf(stderr, "\n%u #include searches over %u directories\n", searches, tree.dir_count + 1);
+    fprintf(stderr, "  stat:        %8u stat calls (%u failed) %10.1f us/search\n", stat_calls, stat_calls - searches,
+            native_us / searches);
+    fprintf(stderr, "  path search: %8lu messages                %10.1f us/search\n", (unsigned long)messages,
+            finesse_us / searches);
+
+    return MUNIT_OK;
+}
+
+static MunitTest pathsearch_tests[] = {
+    TEST((char *)(uintptr_t) "/null", test_null, NULL),
+    TEST((char *)(uintptr_t) "/search", test_search, NULL),
+    TEST((char *)(uintptr_t) "/storm", test_storm, NULL),
+    TEST(NULL, NULL, NULL),
+};
+
+const MunitSuite pathsearch_suite = {
+    .prefix     = (char *)(uintptr_t) "/pathsearch",
+    .tests      = pathsearch_tests,
+    .suites     = NULL,
+    .iterations = 1,
+    .options    = MUNIT_SUITE_OPTION_NONE,
+};
+
+MunitSuite *SetupMunitSuites()
+{
+    return test_single_suite(&pathsearch_suite);
+}
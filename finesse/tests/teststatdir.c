@@ -0,0 +1,367 @@
+/*
+ * Copyright (c) 2020, Tony Mason. All rights reserved.
+ *
+ * Directory stat against a Finesse file system: check that statdir returns what readdir
+ * and lstat find, and compare a du-style walk of a large tree done with a stat per entry
+ * against the same walk done with one statdir per directory.
+ *
+ * FINESSE_STATDIR_DIR names a (scratch) directory on a mounted Finesse file system; the
+ * tests are skipped without it, and the du comparison is a benchmark that also wants
+ * FINESSE_BENCHMARK.  FINESSE_STATDIR_FILES and FINESSE_STATDIR_FANOUT size the tree
+ * (10,000 files, 1,000 to a directory, by default; a million makes a better benchmark).
+ * The tree is only built once, so it can be reused across runs.  The message encoding
+ * itself is checked by test_msg_statdir in finesse_test.c.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <finesse.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#include "fincomm.h"
+#include "finesse_test.h"
+#include "munit.h"
+
+typedef struct {
+    const char *root;
+    const char *mountpoint;
+    unsigned    file_count;
+    unsigned    fanout;
+    unsigned    dir_count;
+} statdir_tree_t;
+
+static statdir_tree_t tree;
+
+//
+// The tree is what a build or a mail spool looks like to du: a directory of directories,
+// each holding FINESSE_STATDIR_FANOUT files (every 64th of which has data in it), one
+// subdirectory and a symlink (which must not be followed).
+//
+static int build_tree(void)
+{
+    char scratch[PATH_MAX];
+    int  fd;
+
+    if (NULL != tree.mountpoint) {
+        return 0;
+    }
+
+    tree.root = getenv("FINESSE_STATDIR_DIR");
+    if (NULL == tree.root) {
+        return ENOENT;
+    }
+
+    tree.mountpoint = test_find_mountpoint(tree.root);
+    munit_assert(NULL != tree.mountpoint);
+
+    tree.file_count = test_env_unsigned("FINESSE_STATDIR_FILES", 10000);
+    tree.fanout     = test_env_unsigned("FINESSE_STATDIR_FANOUT", 1000);
+    tree.dir_count  = (tree.file_count + tree.fanout - 1) / tree.fanout;
+
+    (void)mkdir(tree.root, 0755);
+
+    snprintf(scratch, sizeof(scratch), "%s/.complete-%u-%u", tree.root, tree.file_count, tree.fanout);
+    if (0 == access(scratch, F_OK)) {
+        return 0;
+    }
+
+    fprintf(stderr, "\nbuilding %u files in %u directories under %s\n", tree.file_count, tree.dir_count, tree.root);
+
+    for (unsigned dir = 0; dir < tree.dir_count; dir++) {
+        snprintf(scratch, sizeof(scratch), "%s/d%05u", tree.root, dir);
+        (void)mkdir(scratch, 0755);
+        snprintf(scratch, sizeof(scratch), "%s/d%05u/sub", tree.root, dir);
+        (void)mkdir(scratch, 0755);
+        snprintf(scratch, sizeof(scratch), "%s/d%05u/link", tree.root, dir);
+        (void)unlink(scratch);
+        munit_assert(0 == symlink("sub", scratch));
+
+        for (unsigned file = 0; (file < tree.fanout) && (dir * tree.fanout + file < tree.file_count); file++) {
+            snprintf(scratch, sizeof(scratch), "%s/d%05u/f%05u", tree.root, dir, file);
+            fd = open(scratch, O_CREAT | O_WRONLY, 0644);
+            munit_assert(fd >= 0);
+            if (0 == file % 64) {
+                munit_assert((ssize_t)sizeof(scratch) == write(fd, scratch, sizeof(scratch)));
+            }
+            close(fd);
+        }
+    }
+
+    snprintf(scratch, sizeof(scratch), "%s/.complete-%u-%u", tree.root, tree.file_count, tree.fanout);
+    fd = open(scratch, O_CREAT | O_WRONLY, 0644);
+    munit_assert(fd >= 0);
+    close(fd);
+
+    return 0;
+}
+
+static uint64_t statdir_messages(finesse_client_handle_t Client)
+{
+    fincomm_message    message;
+    FinesseServerStat *server_stat;
+    uint64_t           count;
+    int                status;
+
+    status = FinesseSendServerStatRequest(Client, &message);
+    munit_assert(0 == status);
+    status = FinesseGetServerStatResponse(Client, message, &server_stat);
+    munit_assert(0 == status);
+    count = server_stat->NativeRequests[FINESSE_NATIVE_REQ_STATDIR - FINESSE_NATIVE_REQ_TEST];
+    FinesseFreeServerStatResponse(Client, message);
+
+    return count;
+}
+
+typedef struct {
+    uint64_t entries;
+    uint64_t blocks;
+    uint64_t stat_calls;
+    unsigned subdir_count;
+    char **  subdirs;  // of the directory being listed
+} du_state_t;
+
+static void du_add(du_state_t *State, const char *Name, const struct stat *Attr)
+{
+    State->entries++;
+    State->blocks += Attr->st_blocks;
+
+    if (S_ISDIR(Attr->st_mode)) {
+        State->subdirs = realloc(State->subdirs, (State->subdir_count + 1) * sizeof(char *));
+        munit_assert(NULL != State->subdirs);
+        State->subdirs[State->subdir_count++] = strdup(Name);
+    }
+}
+
+// What du does today: readdir, and an lstat (fstatat) of each name
+static void du_native(du_state_t *State, const char *Path)
+{
+    DIR *          dir;
+    struct dirent *entry;
+    struct stat    statbuf;
+    char **        subdirs;
+    unsigned       subdir_count;
+    char           scratch[PATH_MAX];
+
+    dir = opendir(Path);
+    munit_assert(NULL != dir);
+
+    State->subdirs      = NULL;
+    State->subdir_count = 0;
+    for (entry = readdir(dir); NULL != entry; entry = readdir(dir)) {
+        if ((0 == strcmp(entry->d_name, ".")) || (0 == strcmp(entry->d_name, ".."))) {
+            continue;
+        }
+        State->stat_calls++;
+        munit_assert(0 == fstatat(dirfd(dir), entry->d_name, &statbuf, AT_SYMLINK_NOFOLLOW));
+        du_add(State, entry->d_name, &statbuf);
+    }
+    closedir(dir);
+
+    subdirs      = State->subdirs;
+    subdir_count = State->subdir_count;
+    for (unsigned index = 0; index < subdir_count; index++) {
+        snprintf(scratch, sizeof(scratch), "%s/%s", Path, subdirs[index]);
+        du_native(State, scratch);
+        free(subdirs[index]);
+    }
+    free(subdirs);
+}
+
+static int du_callback(const char *Name, const struct stat *Attr, void *Context)
+{
+    du_add((du_state_t *)Context, Name, Attr);
+    return 0;
+}
+
+static void du_finesse(du_state_t *State, const char *Path)
+{
+    char **  subdirs;
+    unsigned subdir_count;
+    char     scratch[PATH_MAX];
+
+    State->subdirs      = NULL;
+    State->subdir_count = 0;
+    munit_assert(0 == finesse_statdir(Path, NULL, du_callback, State));
+
+    subdirs      = State->subdirs;
+    subdir_count = State->subdir_count;
+    for (unsigned index = 0; index < subdir_count; index++) {
+        snprintf(scratch, sizeof(scratch), "%s/%s", Path, subdirs[index]);
+        du_finesse(State, scratch);
+        free(subdirs[index]);
+    }
+    free(subdirs);
+}
+
+typedef struct {
+    unsigned     count;
+    char *       names[8];
+    struct stat *attrs;
+} listing_t;
+
+static int list_callback(const char *Name, const struct stat *Attr, void *Context)
+{
+    listing_t *listing = (listing_t *)Context;
+
+    if (listing->count < sizeof(listing->names) / sizeof(listing->names[0])) {
+        listing->names[listing->count] = strdup(Name);
+    }
+    listing->attrs = realloc(listing->attrs, (listing->count + 1) * sizeof(struct stat));
+    munit_assert(NULL != listing->attrs);
+    listing->attrs[listing->count++] = *Attr;
+
+    return 0;
+}
+
+static int stop_callback(const char *Name __notused, const struct stat *Attr __notused, void *Context)
+{
+    unsigned *count = (unsigned *)Context;
+
+    return 3 == ++(*count) ? 42 : 0;
+}
+
+static void check_listing(const char *Dir, listing_t *Listing)
+{
+    struct stat statbuf;
+    char        scratch[PATH_MAX];
+
+    for (unsigned index = 0; (index < Listing->count) && (index < sizeof(Listing->names) / sizeof(Listing->names[0])); index++) {
+        snprintf(scratch, sizeof(scratch), "%s/%s", Dir, Listing->names[index]);
+        munit_assert(0 == lstat(scratch, &statbuf));
+        munit_assert(statbuf.st_ino == Listing->attrs[index].st_ino);
+        munit_assert(statbuf.st_mode == Listing->attrs[index].st_mode);
+        munit_assert(statbuf.st_size == Listing->attrs[index].st_size);
+        munit_assert(statbuf.st_blocks == Listing->attrs[index].st_blocks);
+        free(Listing->names[index]);
+    }
+    free(Listing->attrs);
+    memset(Listing, 0, sizeof(listing_t));
+}
+
+static MunitResult test_statdir(const MunitParameter params[] __notused, void *prv __notused)
+{
+    listing_t  listing;
+    du_state_t native, finesse;
+    unsigned   count = 0;
+    char       dir[TEST_DIR_MAX];
+    char       scratch[PATH_MAX];
+
+    if (0 != build_tree()) {
+        return MUNIT_SKIP;
+    }
+
+    finesse_init();
+    memset(&listing, 0, sizeof(listing));
+
+    // The first directory: every file, the subdirectory and the symlink (not followed)
+    snprintf(dir, sizeof(dir), "%s/d%05u", tree.root, 0);
+    munit_assert(0 == finesse_statdir(dir, NULL, list_callback, &listing));
+    munit_assert((tree.fanout < tree.file_count ? tree.fanout : tree.file_count) + 2 == listing.count);
+    check_listing(dir, &listing);
+
+    // du agrees on a single directory
+    memset(&native, 0, sizeof(native));
+    memset(&finesse, 0, sizeof(finesse));
+    du_native(&native, dir);
+    du_finesse(&finesse, dir);
+    munit_assert(native.entries == finesse.entries);
+    munit_assert(native.blocks == finesse.blocks);
+
+    // A pattern
+    munit_assert(0 == finesse_statdir(dir, "f0000?", list_callback, &listing));
+    munit_assert((tree.fanout < 10 ? tree.fanout : 10) == listing.count);
+    check_listing(dir, &listing);
+
+    // The callback can stop the walk
+    munit_assert(42 == finesse_statdir(dir, NULL, stop_callback, &count));
+    munit_assert(3 == count);
+
+    // Through the symlink (the client resolves it) and into an empty directory
+    snprintf(scratch, sizeof(scratch), "%s/link", dir);
+    munit_assert(0 == finesse_statdir(scratch, NULL, list_callback, &listing));
+    munit_assert(0 == listing.count);
+
+    // Things that aren't directories
+    snprintf(scratch, sizeof(scratch), "%s/missing", dir);
+    munit_assert(-1 == finesse_statdir(scratch, NULL, list_callback, &listing));
+    munit_assert(ENOENT == errno);
+    snprintf(scratch, sizeof(scratch), "%s/f%05u", dir, 0);
+    munit_assert(-1 == finesse_statdir(scratch, NULL, list_callback, &listing));
+    munit_assert(ENOTDIR == errno);
+    munit_assert(0 == listing.count);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_du(const MunitParameter params[] __notused, void *prv __notused)
+{
+    du_state_t              native, finesse;
+    finesse_client_handle_t fch;
+    uint64_t                messages;
+    struct timespec         start, stop;
+    double                  native_us, finesse_us;
+
+    if (!test_benchmark_enabled() || (0 != build_tree())) {
+        return MUNIT_SKIP;
+    }
+
+    finesse_init();
+    munit_assert(0 == FinesseStartClientConnection(&fch, tree.mountpoint));
+
+    memset(&native, 0, sizeof(native));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    du_native(&native, tree.root);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    native_us = test_elapsed_us(&start, &stop);
+
+    memset(&finesse, 0, sizeof(finesse));
+    messages = statdir_messages(fch);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    du_finesse(&finesse, tree.root);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    finesse_us = test_elapsed_us(&start, &stop);
+    messages   = statdir_messages(fch) - messages;
+    munit_assert(0 == FinesseStopClientConnection(fch));
+
+    munit_assert(native.entries == finesse.entries);
+    munit_assert(native.blocks == finesse.blocks);
+
+    fprintf(stderr, "\ndu of %lu entries (%lu blocks)\n", (unsigned long)native.entries, (unsigned long)native.blocks);
+    fprintf(stderr, "  readdir + stat: %9lu stat calls %10.1f s %10.0f entries/s\n", (unsigned long)native.stat_calls,
+            native_us / 1.0e6, native.entries / (native_us / 1.0e6));
+    fprintf(stderr, "  statdir:        %9lu messages   %10.1f s %10.0f entries/s\n", (unsigned long)messages,
+            finesse_us / 1.0e6, finesse.entries / (finesse_us / 1.0e6));
+
+    return MUNIT_OK;
+}
+
+static MunitTest statdir_tests[] = {
+    TEST((char *)(uintptr_t) "/null", test_null, NULL),
+    TEST((char *)(uintptr_t) "/statdir", test_statdir, NULL),
+    TEST((char *)(uintptr_t) "/du", test_du, NULL),
+    TEST(NULL, NULL, NULL),
+};
+
+const MunitSuite statdir_suite = {
+    .prefix     = (char *)(uintptr_t) "/statdir",
+    .tests      = statdir_tests,
+    .suites     = NULL,
+    .iterations = 1,
+    .options    = MUNIT_SUITE_OPTION_NONE,
+};
+
+MunitSuite *SetupMunitSuites()
+{
+    return test_single_suite(&statdir_suite);
+}
@@ -0,0 +1,229 @@
+/*
+ * (C) Copyright 2020 Tony Mason
+ * All Rights Reserved
+ */
+
+//
+// finesse-top: watch a running Finesse server.
+//
+// This maps the server's live metrics page (see finesse-metrics.h) read-only
+// and prints the request rate and latency for each request type, the state of
+// each connected client and the server's registered counters.  Rates and
+// percentiles are computed from the difference between successive snapshots,
+// so they describe the most recent interval rather than the life of the server.
+//
+
+#include <errno.h>
+#include <finesse-metrics.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char *fuse_request_names[FINESSE_METRICS_FUSE_REQUESTS] = {
+    "lookup", "forget", "stat", "getattr", "setattr", "readlink", "mknod", "mkdir", "unlink", "rmdir", "symlink",
+    "rename", "link", "open", "read", "write", "flush", "release", "fsync", "opendir", "readdir", "releasedir",
+    "fsyncdir", "statfs", "setxattr", "getxattr", "listxattr", "removexattr", "access", "create", "getlk", "setlk",
+    "bmap", "ioctl", "poll", "write_buf", "retrieve_reply", "forget_multi", "flock", "fallocate", "readdirplus",
+    "copy_file_range", "lseek",
+};
+
+static const char *native_request_names[FINESSE_METRICS_NATIVE_REQUESTS] = {
+    "test", "server_stat", "map", "map_release", "dirmap", "dirmaprelease", "path_search", "compound", "statdir",
+};
+
+static const char *request_name(unsigned Index)
+{
+    if (Index < FINESSE_METRICS_FUSE_REQUESTS) {
+        return fuse_request_names[Index];
+    }
+    return native_request_names[Index - FINESSE_METRICS_FUSE_REQUESTS];
+}
+
+static uint64_t request_count(const finesse_metrics_page_t *Page, unsigned Index)
+{
+    if (Index < FINESSE_METRICS_FUSE_REQUESTS) {
+        return Page->ServerStat.FuseRequests[Index];
+    }
+    return Page->ServerStat.NativeRequests[Index - FINESSE_METRICS_FUSE_REQUESTS];
+}
+
+static const finesse_metrics_counter_t *find_counter(const finesse_metrics_page_t *Page, const char *Name)
+{
+    for (unsigned index = 0; index < Page->CounterCount && index < FINESSE_METRICS_MAX_COUNTERS; index++) {
+        if (0 == strncmp(Page->Counters[index].Name, Name, sizeof(Page->Counters[index].Name))) {
+            return &Page->Counters[index];
+        }
+    }
+    return NULL;
+}
+
+static double elapsed_seconds(const struct timespec *Start, const struct timespec *End)
+{
+    return (double)(End->tv_sec - Start->tv_sec) + (double)(End->tv_nsec - Start->tv_nsec) / 1000000000.0;
+}
+
+static void print_hit_rate(const char *Label, const finesse_metrics_page_t *Current, const finesse_metrics_page_t *Previous,
+                           const char *LookupName, const char *HitName)
+{
+    const finesse_metrics_counter_t *lookups      = find_counter(Current, LookupName);
+    const finesse_metrics_counter_t *hits         = find_counter(Current, HitName);
+    const finesse_metrics_counter_t *prev_lookups = find_counter(Previous, LookupName);
+    const finesse_metrics_counter_t *prev_hits    = find_counter(Previous, HitName);
+    uint64_t                         lookup_delta = 0;
+    uint64_t                         hit_delta    = 0;
+
+    if ((NULL == lookups) || (NULL == hits)) {
+        return;
+    }
+
+    lookup_delta = lookups->Value - ((NULL == prev_lookups) ? 0 : prev_lookups->Value);
+    hit_delta    = hits->Value - ((NULL == prev_hits) ? 0 : prev_hits->Value);
+
+    printf("%-24s %12lu lookups %6.2f%% hit (total %6.2f%%)\n", Label, (unsigned long)lookup_delta,
+           lookup_delta ? 100.0 * (double)hit_delta / (double)lookup_delta : 0.0,
+           lookups->Value ? 100.0 * (double)hits->Value / (double)lookups->Value : 0.0);
+}
+
+static void display(const finesse_metrics_page_t *Current, const finesse_metrics_page_t *Previous)
+{
+    uint64_t histogram[FINESSE_CALLSHARD_BUCKETS];
+    double   seconds = elapsed_seconds(&Previous->UpdateTime, &Current->UpdateTime);
+
+    if (seconds <= 0.0) {
+        seconds = Current->IntervalMs / 1000.0;
+    }
+
+    printf("\nfinesse-top: %s (pid %d) clients %u name maps %u errors %u interval %.3fs\n", Current->MountPoint,
+           (int)Current->ServerPid, (unsigned)Current->ServerStat.ClientConnectionCount,
+           (unsigned)Current->ServerStat.ActiveNameMaps, (unsigned)Current->ServerStat.ErrorCount, seconds);
+
+    printf("%-16s %10s %12s %10s %10s %10s\n", "request", "ops/s", "total", "p50 us", "p99 us", "p999 us");
+    for (unsigned index = 0; index < FINESSE_METRICS_REQUEST_TYPES; index++) {
+        uint64_t delta = request_count(Current, index) - request_count(Previous, index);
+
+        if ((0 == delta) && (0 == request_count(Current, index))) {
+            continue;
+        }
+
+        for (unsigned bucket = 0; bucket < FINESSE_CALLSHARD_BUCKETS; bucket++) {
+            histogram[bucket] = Current->RequestLatency[index][bucket] - Previous->RequestLatency[index][bucket];
+        }
+
+        printf("%-16s %10.1f %12lu %10.2f %10.2f %10.2f\n", request_name(index), (double)delta / seconds,
+               (unsigned long)request_count(Current, index), FinesseCallShardPercentile(histogram, 50.0) / 1000.0,
+               FinesseCallShardPercentile(histogram, 99.0) / 1000.0, FinesseCallShardPercentile(histogram, 99.9) / 1000.0);
+    }
+
+    printf("%-8s %12s %10s %10s\n", "client", "requests/s", "queued", "in flight");
+    for (unsigned index = 0; index < SHM_MESSAGE_COUNT; index++) {
+        const finesse_metrics_client_t *client = &Current->Clients[index];
+        uint64_t                        prior  = Previous->Clients[index].Connected ? Previous->Clients[index].Requests : 0;
+
+        if (0 == client->Connected) {
+            continue;
+        }
+
+        printf("%-8u %12.1f %10u %10u\n", index, (double)(client->Requests - prior) / seconds, client->QueueDepth,
+               client->InFlight);
+    }
+
+    print_hit_rate("dentry (name map)", Current, Previous, "finesse name map lookups", "finesse name map hits");
+    print_hit_rate("inode (bitbucket)", Current, Previous, "bitbucket inode lookups", "bitbucket inode cache hits");
+
+    for (unsigned index = 0; index < Current->CounterCount && index < FINESSE_METRICS_MAX_COUNTERS; index++) {
+        printf("%-40s %16lu\n", Current->Counters[index].Name, (unsigned long)Current->Counters[index].Value);
+    }
+
+    fflush(stdout);
+}
+
+static void usage(const char *Program)
+{
+    fprintf(stderr, "usage: %s [-i interval_ms] [-n count] <mountpoint>\n", Program);
+}
+
+int main(int argc, char **argv)
+{
+    finesse_metrics_page_t *page     = NULL;
+    finesse_metrics_page_t *current  = NULL;
+    finesse_metrics_page_t *previous = NULL;
+    finesse_metrics_page_t *swap     = NULL;
+    unsigned long           interval = 500;
+    long                    count    = -1;
+    struct timespec         delay;
+    int                     opt;
+    int                     status = 0;
+
+    while (-1 != (opt = getopt(argc, argv, "i:n:h"))) {
+        switch (opt) {
+            case 'i':
+                interval = strtoul(optarg, NULL, 0);
+                break;
+            case 'n':
+                count = strtol(optarg, NULL, 0);
+                break;
+            default:
+                usage(argv[0]);
+                return 'h' == opt ? 0 : 1;
+        }
+    }
+
+    if ((optind >= argc) || (0 == interval)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    page = FinesseMetricsOpen(argv[optind]);
+    if (NULL == page) {
+        fprintf(stderr, "%s: no metrics page for %s (%s); is the Finesse server running?\n", argv[0], argv[optind],
+                strerror(errno));
+        return 1;
+    }
+
+    current  = (finesse_metrics_page_t *)calloc(1, sizeof(finesse_metrics_page_t));
+    previous = (finesse_metrics_page_t *)calloc(1, sizeof(finesse_metrics_page_t));
+    if ((NULL == current) || (NULL == previous)) {
+        fprintf(stderr, "%s: out of memory\n", argv[0]);
+        status = 1;
+    }
+
+    delay.tv_sec  = interval / 1000;
+    delay.tv_nsec = (long)(interval % 1000) * 1000000;
+
+    while ((0 == status) && (0 != FinesseMetricsSnapshot(page, previous))) {
+        nanosleep(&delay, NULL);
+    }
+
+    while ((0 == status) && (0 != count)) {
+        nanosleep(&delay, NULL);
+
+        if (0 != FinesseMetricsSnapshot(page, current)) {
+            continue;  // publisher busy; try again next interval
+        }
+
+        if (current->ServerPid != previous->ServerPid) {
+            fprintf(stderr, "%s: server for %s has restarted\n", argv[0], argv[optind]);
+            status = 1;
+            break;
+        }
+
+        display(current, previous);
+
+        swap     = previous;
+        previous = current;
+        current  = swap;
+
+        if (count > 0) {
+            count--;
+        }
+    }
+
+    free(current);
+    free(previous);
+    FinesseMetricsClose(page);
+
+    return status;
+}
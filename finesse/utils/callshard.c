@@ -0,0 +1,247 @@
+//
+// (C) Copyright 2020 Tony Mason
+// All Rights Reserved
+//
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "callshard.h"
+
+//
+// A shard is a header followed by the counters for every call:
+//
+//   Calls | Success | Failure | (Elapsed | Histogram[FINESSE_CALLSHARD_BUCKETS]) * TimerCount
+//
+// Only the owning thread writes a shard, so updates are a relaxed load and
+// store (no locked instructions); readers use relaxed loads and may see a
+// count that is a few calls stale, which is fine for statistics.
+//
+#define CALLSHARD_CALLS (0)
+#define CALLSHARD_SUCCESS (1)
+#define CALLSHARD_FAILURE (2)
+#define CALLSHARD_TIMERS (3)
+#define CALLSHARD_TIMER_SIZE (1 + FINESSE_CALLSHARD_BUCKETS)
+
+struct _finesse_callshard {
+    finesse_callshard_t *    Next;
+    finesse_callshard_set_t *Set;
+    int                      Orphaned;
+    uint64_t                 Counters[] __attribute__((aligned(64)));
+};
+
+static inline size_t CallShardStride(finesse_callshard_set_t *Set)
+{
+    return CALLSHARD_TIMERS + Set->TimerCount * CALLSHARD_TIMER_SIZE;
+}
+
+static inline uint64_t *CallShardCounters(finesse_callshard_t *Shard, unsigned Call)
+{
+    return &Shard->Counters[Call * CallShardStride(Shard->Set)];
+}
+
+static inline void CallShardIncrement(uint64_t *Counter, uint64_t Value)
+{
+    __atomic_store_n(Counter, __atomic_load_n(Counter, __ATOMIC_RELAXED) + Value, __ATOMIC_RELAXED);
+}
+
+static void CallShardThreadExit(void *Shard)
+{
+    finesse_callshard_t *shard = (finesse_callshard_t *)Shard;
+
+    // Hand the shard (and its counts) to the next thread that needs one.
+    __atomic_store_n(&shard->Orphaned, 1, __ATOMIC_RELEASE);
+}
+
+//
+// pthread_once doesn't take an argument, so the set being initialized is
+// passed through a thread local.
+//
+static __thread finesse_callshard_set_t *CallShardInitializing;
+
+static void CallShardSetInitialize(void)
+{
+    int status = pthread_key_create(&CallShardInitializing->Key, CallShardThreadExit);
+
+    assert(0 == status);
+    (void)status;
+}
+
+static finesse_callshard_t *CallShardGet(finesse_callshard_set_t *Set)
+{
+    finesse_callshard_t *shard = NULL;
+    size_t               size  = 0;
+
+    CallShardInitializing = Set;
+    pthread_once(&Set->Once, CallShardSetInitialize);
+    CallShardInitializing = NULL;
+
+    shard = (finesse_callshard_t *)pthread_getspecific(Set->Key);
+
+    if (NULL != shard) {
+        return shard;
+    }
+
+    // Adopt an orphaned shard if there is one
+    for (shard = __atomic_load_n(&Set->Shards, __ATOMIC_ACQUIRE); NULL != shard; shard = shard->Next) {
+        int orphaned = 1;
+
+        if (__atomic_compare_exchange_n(&shard->Orphaned, &orphaned, 0, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+
+    if (NULL == shard) {
+        size  = sizeof(finesse_callshard_t) + Set->CallCount * CallShardStride(Set) * sizeof(uint64_t);
+        size  = (size + 63) & ~63;
+        shard = (finesse_callshard_t *)aligned_alloc(64, size);
+        assert(NULL != shard);
+        memset(shard, 0, size);
+        shard->Set  = Set;
+        shard->Next = __atomic_load_n(&Set->Shards, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&Set->Shards, &shard->Next, shard, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            // retry: shard->Next has been updated to the current head
+        }
+    }
+
+    pthread_setspecific(Set->Key, shard);
+
+    return shard;
+}
+
+static inline unsigned CallShardBucket(uint64_t Value)
+{
+    unsigned msb = 0;
+
+    if (Value < FINESSE_CALLSHARD_SUB_BUCKETS) {
+        return (unsigned)Value;
+    }
+
+    msb = 63 - __builtin_clzll(Value);
+
+    if (msb > FINESSE_CALLSHARD_MAX_EXPONENT) {
+        return FINESSE_CALLSHARD_BUCKETS - 1;
+    }
+
+    return (msb - FINESSE_CALLSHARD_SUB_BUCKET_BITS + 1) * FINESSE_CALLSHARD_SUB_BUCKETS +
+           ((Value >> (msb - FINESSE_CALLSHARD_SUB_BUCKET_BITS)) & (FINESSE_CALLSHARD_SUB_BUCKETS - 1));
+}
+
+// Returns the midpoint of the range of values that land in the given bucket
+static inline uint64_t CallShardBucketValue(unsigned Bucket)
+{
+    unsigned exponent = Bucket / FINESSE_CALLSHARD_SUB_BUCKETS;
+    unsigned sub      = Bucket % FINESSE_CALLSHARD_SUB_BUCKETS;
+    uint64_t low      = 0;
+    uint64_t width    = 0;
+
+    if (0 == exponent) {
+        return Bucket;
+    }
+
+    width = (uint64_t)1 << (exponent - 1);
+    low   = (uint64_t)(FINESSE_CALLSHARD_SUB_BUCKETS | sub) << (exponent - 1);
+
+    return low + width / 2;
+}
+
+void FinesseCallShardCount(finesse_callshard_set_t *Set, unsigned Call, int Success)
+{
+    uint64_t *counters = NULL;
+
+    assert(Call < Set->CallCount);
+    counters = CallShardCounters(CallShardGet(Set), Call);
+    CallShardIncrement(&counters[CALLSHARD_CALLS], 1);
+    CallShardIncrement(&counters[Success ? CALLSHARD_SUCCESS : CALLSHARD_FAILURE], 1);
+}
+
+void FinesseCallShardRecord(finesse_callshard_set_t *Set, unsigned Call, unsigned Timer, const struct timespec *Elapsed)
+{
+    uint64_t *timer = NULL;
+    uint64_t  nsec  = (uint64_t)Elapsed->tv_sec * (uint64_t)1000000000 + (uint64_t)Elapsed->tv_nsec;
+
+    assert(Call < Set->CallCount);
+    assert(Timer < Set->TimerCount);
+    timer = &CallShardCounters(CallShardGet(Set), Call)[CALLSHARD_TIMERS + Timer * CALLSHARD_TIMER_SIZE];
+    CallShardIncrement(&timer[0], nsec);
+    CallShardIncrement(&timer[1 + CallShardBucket(nsec)], 1);
+}
+
+void FinesseCallShardSum(finesse_callshard_set_t *Set, unsigned Call, uint64_t *Calls, uint64_t *Success, uint64_t *Failure)
+{
+    uint64_t calls   = 0;
+    uint64_t success = 0;
+    uint64_t failure = 0;
+
+    assert(Call < Set->CallCount);
+    for (finesse_callshard_t *shard = __atomic_load_n(&Set->Shards, __ATOMIC_ACQUIRE); NULL != shard; shard = shard->Next) {
+        uint64_t *counters = CallShardCounters(shard, Call);
+
+        calls += __atomic_load_n(&counters[CALLSHARD_CALLS], __ATOMIC_RELAXED);
+        success += __atomic_load_n(&counters[CALLSHARD_SUCCESS], __ATOMIC_RELAXED);
+        failure += __atomic_load_n(&counters[CALLSHARD_FAILURE], __ATOMIC_RELAXED);
+    }
+
+    *Calls   = calls;
+    *Success = success;
+    *Failure = failure;
+}
+
+uint64_t FinesseCallShardElapsed(finesse_callshard_set_t *Set, unsigned Call, unsigned Timer)
+{
+    uint64_t elapsed = 0;
+
+    assert(Call < Set->CallCount);
+    assert(Timer < Set->TimerCount);
+    for (finesse_callshard_t *shard = __atomic_load_n(&Set->Shards, __ATOMIC_ACQUIRE); NULL != shard; shard = shard->Next) {
+        uint64_t *timer = &CallShardCounters(shard, Call)[CALLSHARD_TIMERS + Timer * CALLSHARD_TIMER_SIZE];
+
+        elapsed += __atomic_load_n(&timer[0], __ATOMIC_RELAXED);
+    }
+
+    return elapsed;
+}
+
+void FinesseCallShardHistogram(finesse_callshard_set_t *Set, unsigned Call, unsigned Timer, uint64_t Histogram[FINESSE_CALLSHARD_BUCKETS])
+{
+    assert(Call < Set->CallCount);
+    assert(Timer < Set->TimerCount);
+    memset(Histogram, 0, FINESSE_CALLSHARD_BUCKETS * sizeof(uint64_t));
+    for (finesse_callshard_t *shard = __atomic_load_n(&Set->Shards, __ATOMIC_ACQUIRE); NULL != shard; shard = shard->Next) {
+        uint64_t *timer = &CallShardCounters(shard, Call)[CALLSHARD_TIMERS + Timer * CALLSHARD_TIMER_SIZE];
+
+        for (unsigned index = 0; index < FINESSE_CALLSHARD_BUCKETS; index++) {
+            Histogram[index] += __atomic_load_n(&timer[1 + index], __ATOMIC_RELAXED);
+        }
+    }
+}
+
+// Percentile is in the range [0, 100]; returns 0 for an empty histogram.
+uint64_t FinesseCallShardPercentile(const uint64_t Histogram[FINESSE_CALLSHARD_BUCKETS], double Percentile)
+{
+    uint64_t total     = 0;
+    uint64_t threshold = 0;
+    uint64_t seen      = 0;
+
+    for (unsigned index = 0; index < FINESSE_CALLSHARD_BUCKETS; index++) {
+        total += Histogram[index];
+    }
+
+    if (0 == total) {
+        return 0;
+    }
+
+    threshold = (uint64_t)((Percentile / 100.0) * (double)total + 0.5);
+    if (threshold < 1) {
+        threshold = 1;
+    }
+
+    for (unsigned index = 0; index < FINESSE_CALLSHARD_BUCKETS; index++) {
+        seen += Histogram[index];
+        if (seen >= threshold) {
+            return CallShardBucketValue(index);
+        }
+    }
+
+    return CallShardBucketValue(FINESSE_CALLSHARD_BUCKETS - 1);
+}
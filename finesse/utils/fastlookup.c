@@ -34,16 +34,32 @@ static inline void verify_magic(const char *StructureName, const char *File, con
 }
 
 typedef struct _lookup_entry {
-    uint64_t         Magic;
-    uint64_t         ReferenceCount;
-    list_entry_t     InodeListEntry;
+    uint32_t         Magic;
+    uint32_t         ReferenceCount;
+    list_entry_t     InodeListEntry;  // also links the entry on its table's free list
     list_entry_t     UuidListEntry;
     finesse_object_t Object;
 } lookup_entry_t;
 
-#define FAST_LOOKUP_ENTRY_MAGIC (0x4a0a84a016989cdf)
+#define FAST_LOOKUP_ENTRY_MAGIC (0x16989cdf)
 #define CHECK_FAST_LOOKUP_ENTRY_MAGIC(fle) \
-    verify_magic("lookup_entry_t", __FILE__, __func__, __LINE__, FAST_LOOKUP_TABLE_MAGIC, (fle)->Magic)
+    verify_magic("lookup_entry_t", __FILE__, __func__, __LINE__, FAST_LOOKUP_ENTRY_MAGIC, (fle)->Magic)
+
+//
+// Entries are carved out of chunks that belong to the table rather than being allocated one
+// at a time: there is no allocator header per object and a table's entries are packed
+// together.  A released entry goes back on the table's free list with freed set and is reused
+// oldest first, so a stale pointer to it still trips the freed asserts for a while (which is
+// what the old, never emptied, freed lists were for).  The chunks go away with the table.
+//
+#define FAST_LOOKUP_CHUNK_ENTRIES (1024)
+
+typedef struct _lookup_entry_chunk lookup_entry_chunk_t;
+
+struct _lookup_entry_chunk {
+    lookup_entry_chunk_t *Next;
+    lookup_entry_t        Entries[FAST_LOOKUP_CHUNK_ENTRIES];
+};
 
 typedef struct _lookup_entry_table_bucket lookup_entry_table_bucket_t;
 typedef struct _lookup_entry_table        lookup_entry_table_t;
@@ -69,7 +85,9 @@ struct _lookup_entry_table_bucket {
     uint64_t (*HashFunction)(lookup_entry_table_bucket_t *Bucket);
     uint64_t         LastHashValue;
     pthread_rwlock_t Lock;
-    char             UnusedSpace[56];  // pad to 64 bytes
+    uint64_t         Lookups;          // statistics (for the metrics page)
+    uint64_t         CacheHits;        // lookups satisfied by LastEntry
+    char             UnusedSpace[40];  // pad to 64 bytes
 };
 
 #define FAST_LOOKUP_TABLE_BUCKET_MAGIC (0x7800c6664e1c877c)
@@ -86,6 +104,9 @@ typedef struct _lookup_entry_table {
     pthread_rwlock_t ActiveEntryListLock;
     lookup_entry_table_bucket_t *Buckets;
     uint32_t                     HashSeed;
+    pthread_mutex_t              ArenaLock;    // protects FreeEntries and Chunks
+    list_entry_t                 FreeEntries;  // oldest first
+    lookup_entry_chunk_t *       Chunks;
     char Pad[30];  // fill out structure to ensure cache line alignment, assuming the cache line is 64 bytes.
 } lookup_entry_table_t;
 
@@ -99,21 +120,6 @@ _Static_assert(0 == sizeof(lookup_entry_table_t) % 64, "lookup_entry_table_t len
 
 // uint64_t (*HashFunction)(void *Data, size_t DataLength);
 
-static list_entry_t    FreedInodeList = {&FreedInodeList, &FreedInodeList};
-static list_entry_t    FreedUuidList  = {&FreedUuidList, &FreedUuidList};
-static int             UseFreedLists  = 1;  // DEBUG AID
-static pthread_mutex_t FreedListLock  = PTHREAD_MUTEX_INITIALIZER;
-
-static void LockFreedList(void)
-{
-    pthread_mutex_lock(&FreedListLock);
-}
-
-static void UnlockFreedList(void)
-{
-    pthread_mutex_unlock(&FreedListLock);
-}
-
 static uint64_t truncate_hash(uint64_t UntruncatedHash, uint8_t Shift)
 {
     uint64_t mask = (1 << Shift) - 1;  // 2^N - 1
@@ -199,6 +205,9 @@ static void *CreateLookupTable(uint16_t BucketCount, uint32_t HashSeed)
             table->BucketCountShift = 15;
     }
     pthread_rwlock_init(&table->ActiveEntryListLock, NULL);
+    pthread_mutex_init(&table->ArenaLock, NULL);
+    initialize_list(&table->FreeEntries);
+    table->Chunks = NULL;
     if (0 == HashSeed) {
         table->HashSeed = 0x7800c666;
     }
@@ -230,26 +239,18 @@ static void *CreateLookupTable(uint16_t BucketCount, uint32_t HashSeed)
 //
 static void DestroyLookupTable(lookup_entry_table_t *Table)
 {
-    uint64_t                     bucketCount = 0;
-    lookup_entry_table_bucket_t *bucket      = NULL;
-    list_entry_t *               le          = NULL;
-    lookup_entry_t *             entry       = NULL;
+    lookup_entry_chunk_t *chunk = NULL;
 
     assert(NULL != Table);
     CHECK_FAST_LOOKUP_TABLE_MAGIC(Table);
 
-    // To cleanup all the entries, it suffices for us to free
-    // the inode entries and ignore the uuid lists, as each
-    // entry is inserted into each one.
-    bucketCount = (1 << Table->BucketCountShift);
-    for (unsigned index = 0; index < bucketCount; index++) {
-        bucket = &Table->Buckets[index];
-        while (!empty_list(&bucket->LookupEntryInstance.LinkedLists.InodeTableEntry)) {
-            le    = remove_list_head(&bucket->LookupEntryInstance.LinkedLists.InodeTableEntry);
-            entry = container_of(le, lookup_entry_t, InodeListEntry);
-            free(entry);
-        }
+    // All the entries (in use or not) live in the table's chunks
+    while (NULL != Table->Chunks) {
+        chunk         = Table->Chunks;
+        Table->Chunks = chunk->Next;
+        free(chunk);
     }
+    pthread_mutex_destroy(&Table->ArenaLock);
 
     // Now free the table - recall the buckets were part of its
     // allocation, so those are gone as well.
@@ -372,6 +373,51 @@ static inline uint16_t GetBucketIndexForUuid(lookup_entry_table_t *Table, uuid_t
     return GetBucketIndex(Table, Uuid, sizeof(uuid_t));
 }
 
+//
+// Allocate an entry from the table's arena, adding a chunk if there are no free entries.
+// The entry is returned off all lists, with no reference.
+//
+static lookup_entry_t *alloc_entry(lookup_entry_table_t *Table)
+{
+    lookup_entry_chunk_t *chunk = NULL;
+    lookup_entry_t *      entry = NULL;
+
+    pthread_mutex_lock(&Table->ArenaLock);
+    if (empty_list(&Table->FreeEntries)) {
+        chunk = malloc(sizeof(lookup_entry_chunk_t));
+        if (NULL != chunk) {
+            chunk->Next   = Table->Chunks;
+            Table->Chunks = chunk;
+            for (unsigned index = 0; index < FAST_LOOKUP_CHUNK_ENTRIES; index++) {
+                memset(&chunk->Entries[index], 0, sizeof(lookup_entry_t));
+                chunk->Entries[index].Object.freed = 1;
+                initialize_list_entry(&chunk->Entries[index].UuidListEntry);
+                insert_list_tail(&Table->FreeEntries, &chunk->Entries[index].InodeListEntry);
+            }
+        }
+    }
+
+    if (!empty_list(&Table->FreeEntries)) {
+        entry = container_of(remove_list_head(&Table->FreeEntries), lookup_entry_t, InodeListEntry);
+        assert(0 != entry->Object.freed);
+    }
+    pthread_mutex_unlock(&Table->ArenaLock);
+
+    return entry;
+}
+
+// The entry must already be off the table's lists
+static void free_entry(lookup_entry_table_t *Table, lookup_entry_t *Entry)
+{
+    Entry->Magic          = 0;
+    Entry->ReferenceCount = 0;
+    Entry->Object.freed   = 1;
+
+    pthread_mutex_lock(&Table->ArenaLock);
+    insert_list_tail(&Table->FreeEntries, &Entry->InodeListEntry);
+    pthread_mutex_unlock(&Table->ArenaLock);
+}
+
 //
 // A common routine for looking up an entry in a bucket.
 // Only one of Inode or Uuid can be valid.
@@ -416,8 +462,11 @@ static lookup_entry_t *lookup_entry(lookup_entry_table_bucket_t *Bucket, fuse_in
         }
     }
 
+    __atomic_fetch_add(&Bucket->Lookups, 1, __ATOMIC_RELAXED);
+
     if (NULL != entry) {
         // Hit in the one entry cache.
+        __atomic_fetch_add(&Bucket->CacheHits, 1, __ATOMIC_RELAXED);
         return entry;
     }
 
@@ -519,10 +568,18 @@ finesse_object_t *FinesseObjectLookupByUuid(finesse_object_table_t *Table, uuid_
     return NULL;
 }
 
+//
+// An object that owns a FUSE lookup (see finesse_object_t) hands it back through this when it is
+// freed; without one the lookup is simply dropped, as in the table tests.
+//
+static void (*ObjectLookupRelease)(void *Context, fuse_ino_t Inode);
+static void *ObjectLookupReleaseContext;
+
 static void release_entry(lookup_entry_table_t *Table, lookup_entry_t *Entry)
 {
-    uint16_t index, first, second;
-    uint64_t refCount = 0;
+    uint16_t   index, first, second;
+    uint64_t   refCount = 0;
+    fuse_ino_t lookup   = 0;
 
     first  = GetBucketIndexForInode(Table, Entry->Object.inode);
     second = GetBucketIndexForUuid(Table, &Entry->Object.uuid);
@@ -549,36 +606,34 @@ static void release_entry(lookup_entry_table_t *Table, lookup_entry_t *Entry)
         remove_list_entry(&Entry->UuidListEntry);
         __atomic_fetch_sub(&Table->Buckets[first].EntryCount, 1, __ATOMIC_RELAXED);
         __atomic_fetch_sub(&Table->Buckets[second].EntryCount, 1, __ATOMIC_RELAXED);
-        if (UseFreedLists) {
-            LockFreedList();
-            insert_list_tail(&FreedInodeList, &Entry->InodeListEntry);
-            insert_list_head(&FreedUuidList, &Entry->UuidListEntry);
-            Entry->Object.freed = 1;
-            UnlockFreedList();
-        }
-        else {
-            memset(Entry, 0, sizeof(lookup_entry_t));  // this is really a debug aid...
-            free(Entry);
-        }
-
-        // clear the one-entry cache if it contains this entry; I use the stronger release because I don't want
-        // some other thread accessing this pointer from a cached value of it (unlikely...)
-        __atomic_compare_exchange_n(&Table->Buckets[first].LastEntry, &Entry, NULL, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
-        __atomic_compare_exchange_n(&Table->Buckets[first].LastEntry, &Entry, NULL, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+        __atomic_fetch_sub(&Table->EntryCount, 1, __ATOMIC_RELAXED);
 
+        // clear the one-entry cache if it contains this entry (we hold both buckets exclusive, so
+        // no lookup can be looking at it) before the entry can be reused.
         if (Table->Buckets[first].LastEntry == Entry) {
-            Table->Buckets[first].LastEntry = NULL;  // invalidate one-entry cache
+            __atomic_store_n(&Table->Buckets[first].LastEntry, NULL, __ATOMIC_RELEASE);
         }
 
         if (Table->Buckets[second].LastEntry == Entry) {
-            Table->Buckets[second].LastEntry = NULL;  // invalidate one-entry cache
+            __atomic_store_n(&Table->Buckets[second].LastEntry, NULL, __ATOMIC_RELEASE);
         }
+
+        if (Entry->Object.lookup) {
+            lookup = Entry->Object.inode;
+        }
+
+        free_entry(Table, Entry);
     }
 
     if (first != second) {
         UnlockBucket(&Table->Buckets[second]);
     }
     UnlockBucket(&Table->Buckets[first]);
+
+    // Not under the bucket locks: this calls into the file system
+    if ((0 != lookup) && (NULL != ObjectLookupRelease)) {
+        ObjectLookupRelease(ObjectLookupReleaseContext, lookup);
+    }
 }
 
 void FinesseObjectRelease(finesse_object_table_t *Table, finesse_object_t *Object)
@@ -603,8 +658,9 @@ void FinesseObjectRelease(finesse_object_table_t *Table, finesse_object_t *Objec
     refCount = __atomic_fetch_sub(&entry->ReferenceCount, 1, __ATOMIC_RELAXED);
     assert(0 != refCount);  // This is an underflow - logic error
     if (1 == refCount) {
-        // this is the removal but we don't hold the exclusive lock
-        refCount = __atomic_fetch_add(&entry->ReferenceCount, 1, __ATOMIC_RELAXED);
+        // this is the removal but we don't hold the exclusive lock; put the reference back and
+        // let release_entry drop it (unless someone else picked up a reference in between)
+        (void)__atomic_fetch_add(&entry->ReferenceCount, 1, __ATOMIC_RELAXED);
     }
     else {
         char uuid_str[40];
@@ -650,16 +706,6 @@ static lookup_entry_t *insert_entry(lookup_entry_table_t *Table, fuse_ino_t Inod
         second = index;
     }
 
-    entry = malloc(sizeof(lookup_entry_t));
-    assert(NULL != entry);
-    entry->Magic          = FAST_LOOKUP_ENTRY_MAGIC;
-    entry->ReferenceCount = 2;
-    initialize_list_entry(&entry->InodeListEntry);
-    initialize_list_entry(&entry->UuidListEntry);
-    entry->Object.inode = InodeNumber;
-    uuid_copy(entry->Object.uuid, *Uuid);
-    entry->Object.freed = 0;
-
     LockBucket(&Table->Buckets[first], 1);
     if (first != second) {
         LockBucket(&Table->Buckets[second], 1);
@@ -672,10 +718,9 @@ static lookup_entry_t *insert_entry(lookup_entry_table_t *Table, fuse_ino_t Inod
 
         old_entry = lookup_entry(inode_bucket, InodeNumber, &null_uuid);
         if (NULL != old_entry) {
-            // we use the existing entry
-            free(entry);
+            // we use the existing entry (the common case, so nothing is allocated until we know we need it)
             entry = old_entry;
-            assert((0 == UseFreedLists) || (0 == entry->Object.freed));
+            assert(0 == entry->Object.freed);
             refCount = __atomic_fetch_add(&entry->ReferenceCount, 1, __ATOMIC_RELAXED);  // bump reference
             {
                 char uuid_str[40];
@@ -689,12 +734,24 @@ static lookup_entry_t *insert_entry(lookup_entry_table_t *Table, fuse_ino_t Inod
         old_entry = lookup_entry(inode_bucket, 0, Uuid);
         assert(NULL == old_entry);  // This is really not expected!
 
+        entry = alloc_entry(Table);
+        assert(NULL != entry);
+        entry->Magic          = FAST_LOOKUP_ENTRY_MAGIC;
+        entry->ReferenceCount = 2;
+        initialize_list_entry(&entry->InodeListEntry);
+        initialize_list_entry(&entry->UuidListEntry);
+        entry->Object.inode = InodeNumber;
+        uuid_copy(entry->Object.uuid, *Uuid);
+        entry->Object.freed  = 0;
+        entry->Object.lookup = 0;
+
         // Insert the new entry into the table
         insert_list_tail(&inode_bucket->LookupEntryInstance.LinkedLists.InodeTableEntry, &entry->InodeListEntry);
         insert_list_tail(&uuid_bucket->LookupEntryInstance.LinkedLists.UuidTableEntry, &entry->UuidListEntry);
 
         __atomic_fetch_add(&inode_bucket->EntryCount, 1, __ATOMIC_RELAXED);
         __atomic_fetch_add(&uuid_bucket->EntryCount, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&Table->EntryCount, 1, __ATOMIC_RELAXED);
         break;
     }
 
@@ -727,6 +784,25 @@ uint64_t FinesseObjectGetTableSize(finesse_object_table_t *Table)
     return __atomic_load_n(&table->EntryCount, __ATOMIC_RELAXED);
 }
 
+// Lookup statistics (summed across buckets; the values are approximate while lookups are in progress)
+void FinesseObjectGetTableStatistics(finesse_object_table_t *Table, uint64_t *Lookups, uint64_t *CacheHits)
+{
+    lookup_entry_table_t *table     = (lookup_entry_table_t *)Table;
+    uint64_t              lookups   = 0;
+    uint64_t              cacheHits = 0;
+
+    assert(NULL != table);
+    CHECK_FAST_LOOKUP_TABLE_MAGIC(table);
+
+    for (unsigned index = 0; index < (1 << table->BucketCountShift); index++) {
+        lookups += __atomic_load_n(&table->Buckets[index].Lookups, __ATOMIC_RELAXED);
+        cacheHits += __atomic_load_n(&table->Buckets[index].CacheHits, __ATOMIC_RELAXED);
+    }
+
+    *Lookups   = lookups;
+    *CacheHits = cacheHits;
+}
+
 void FinesseDestroyTable(finesse_object_table_t *Table)
 {
     DestroyLookupTable((lookup_entry_table_t *)Table);
@@ -807,12 +883,22 @@ void finesse_object_release(finesse_object_t *object)
         create_lookup_table();
     }
 
-    assert((0 == UseFreedLists) || (0 == object->freed));
+    assert(0 == object->freed);
     FinesseObjectRelease(ObjectTable, object);
 
     return;
 }
 
+//
+// Set (or, with NULL, clear) how an object's FUSE lookup is given back.  This is done while the
+// server isn't handing out objects, so it isn't synchronized with release.
+//
+void finesse_object_set_lookup_release(void (*Release)(void *Context, fuse_ino_t Inode), void *Context)
+{
+    ObjectLookupReleaseContext = Context;
+    ObjectLookupRelease        = Release;
+}
+
 finesse_object_t *finesse_object_create(fuse_ino_t inode, uuid_t *uuid)
 {
     finesse_object_t *fobj = NULL;
@@ -827,5 +913,18 @@ finesse_object_t *finesse_object_create(fuse_ino_t inode, uuid_t *uuid)
 
 uint64_t finesse_object_get_table_size(void)
 {
+    if (NULL == ObjectTable) {
+        return 0;
+    }
     return ((lookup_entry_table_t *)ObjectTable)->EntryCount;
 }
+
+void finesse_object_get_table_statistics(uint64_t *Lookups, uint64_t *CacheHits)
+{
+    if (NULL == ObjectTable) {
+        *Lookups   = 0;
+        *CacheHits = 0;
+        return;
+    }
+    FinesseObjectGetTableStatistics(ObjectTable, Lookups, CacheHits);
+}
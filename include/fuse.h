@@ -271,6 +271,15 @@ struct fuse_config {
 	int show_help;
 	char *modules;
 	int debug;
+
+	/**
+	 * Keep the full path of each node between requests instead of
+	 * rebuilding it from the node tree every time.  Paths are
+	 * invalidated lazily when a directory is renamed or removed.
+	 * This uses more memory but makes requests on deep trees
+	 * cheaper.
+	 */
+	int path_cache;
 };
 
 
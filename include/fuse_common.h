@@ -103,6 +103,11 @@ struct fuse_file_info {
 /**
  * Configuration parameters passed to fuse_session_loop_mt() and
  * fuse_loop_mt().
+ *
+ * The fields after max_idle_threads were added in FUSE 3.10;
+ * binaries built against an older header are bound to the FUSE_3.2
+ * versions of those functions, which only read the first two.
+ * Zero the whole structure before setting the fields you use.
  */
 struct fuse_loop_config {
 	/**
@@ -122,6 +127,38 @@ struct fuse_loop_config {
 	 * thread will be created to service every operation.
 	 */
 	unsigned int max_idle_threads;
+
+	/**
+	 * Use io_uring to receive requests and send replies, if the
+	 * kernel supports it (otherwise the worker thread pool is
+	 * used).  max_idle_threads (at least one) fixed worker threads
+	 * each post a read on the fuse device while they are idle and
+	 * send each reply with their next receive.
+	 */
+	int io_uring;
+
+	/**
+	 * No longer used: an io_uring worker only has a read posted
+	 * while it is idle.  Kept so that the structure doesn't change.
+	 */
+	unsigned int io_uring_depth;
+
+	/**
+	 * Instead of growing and shrinking a pool of worker threads,
+	 * run exactly one worker pinned to each CPU the process may
+	 * run on, each with its own cloned device fd (clone_fd is
+	 * ignored).  The request path takes no shared lock.
+	 */
+	int per_cpu_workers;
+
+	/**
+	 * With per_cpu_workers, wake (or start) an unpinned standby
+	 * worker when every worker is busy and requests are waiting,
+	 * so slow handlers can't stall the whole file system.  Standby
+	 * workers park again once another worker is idle; there are at
+	 * most max_idle_threads of them.
+	 */
+	int work_stealing;
 };
 
 /**************************************************************************
@@ -677,7 +714,21 @@ enum fuse_buf_copy_flags {
 	 * is full or empty).  See SPLICE_F_NONBLOCK in the splice(2)
 	 * man page.
 	 */
-	FUSE_BUF_SPLICE_NONBLOCK= (1 << 4)
+	FUSE_BUF_SPLICE_NONBLOCK= (1 << 4),
+
+	/**
+	 * Give memory buffers to the kernel
+	 *
+	 * When replying with memory buffers that are page aligned in
+	 * both address and length, hand the pages to the kernel with
+	 * SPLICE_F_GIFT so that they may be moved rather than copied.
+	 * Once the reply has been sent the pages may still be in use
+	 * by the kernel: the file system must not modify or reuse the
+	 * buffers, and must not free them into an allocator that could
+	 * hand them out again; unmapping them is the only safe release.
+	 * See SPLICE_F_GIFT in the vmsplice(2) man page.
+	 */
+	FUSE_BUF_SPLICE_GIFT	= (1 << 5)
 };
 
 /**
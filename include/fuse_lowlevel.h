@@ -1417,7 +1417,15 @@ int fuse_reply_buf(fuse_req_t req, const char *buf, size_t size);
  * 3. *flags* does not contain FUSE_BUF_NO_SPLICE
  * 4. The amount of data that is provided in file-descriptor backed
  *    buffers (i.e., buffers for which bufv[n].flags == FUSE_BUF_FD)
- *    is at least twice the page size.
+ *    is at least twice the page size, or all buffers are memory
+ *    buffers and together hold at least the session's splice
+ *    threshold (see the splice_threshold option; by default it is
+ *    measured when the file system is mounted).
+ *
+ * Memory buffers are mapped into the pipe with vmsplice(2) rather
+ * than copied.  If *flags* contains FUSE_BUF_SPLICE_GIFT and the
+ * buffers are page aligned, their pages are gifted to the kernel
+ * and must not be modified or reused afterwards.
  *
  * In order for SPLICE_F_MOVE to be used, the following additional
  * conditions have to be fulfilled:
@@ -1429,8 +1437,9 @@ int fuse_reply_buf(fuse_req_t req, const char *buf, size_t size);
  *
  * Note that, if splice is used, the data is actually spliced twice:
  * once into a temporary pipe (to prepend header data), and then again
- * into the kernel. If some of the provided buffers are memory-backed,
- * the data in them is copied in step one and spliced in step two.
+ * into the kernel. If some of the provided buffers are memory-backed
+ * and others are not, the data in the memory buffers is copied in
+ * step one and spliced in step two.
  *
  * The FUSE_BUF_SPLICE_FORCE_SPLICE and FUSE_BUF_SPLICE_NONBLOCK flags
  * are silently ignored.
@@ -1905,6 +1914,13 @@ void fuse_cmdline_help(void);
  * Filesystem setup & teardown                                 *
  * ----------------------------------------------------------- */
 
+/**
+ * Options filled in by fuse_parse_cmdline().
+ *
+ * The fields after max_idle_threads were added in FUSE 3.10;
+ * binaries built against an older header are bound to the FUSE_3.0
+ * version of fuse_parse_cmdline(), which only fills the ones before.
+ */
 struct fuse_cmdline_opts
 {
 	int singlethread;
@@ -1916,6 +1932,16 @@ struct fuse_cmdline_opts
 	int show_help;
 	int clone_fd;
 	unsigned int max_idle_threads;
+	int io_uring;
+	unsigned int io_uring_depth;
+
+	/**
+	 * -o per_cpu_workers and -o work_stealing, for the matching
+	 * fields of struct fuse_loop_config.  Like the io_uring options
+	 * these are only filled by fuse_parse_cmdline@FUSE_3.10.
+	 */
+	int per_cpu_workers;
+	int work_stealing;
 };
 
 /**
@@ -1936,8 +1962,14 @@ struct fuse_cmdline_opts
  * @param opts output argument for parsed options
  * @return 0 on success, -1 on failure
  */
+#if (!defined(__UCLIBC__) && !defined(__APPLE__))
 int fuse_parse_cmdline(struct fuse_args *args,
 					   struct fuse_cmdline_opts *opts);
+#else
+int fuse_parse_cmdline_310(struct fuse_args *args,
+						   struct fuse_cmdline_opts *opts);
+#define fuse_parse_cmdline(args, opts) fuse_parse_cmdline_310(args, opts)
+#endif
 
 /**
  * Create a low level session.
@@ -2023,8 +2055,8 @@ int fuse_session_loop_mt_31(struct fuse_session *se, int clone_fd);
 #if (!defined(__UCLIBC__) && !defined(__APPLE__))
 int fuse_session_loop_mt(struct fuse_session *se, struct fuse_loop_config *config);
 #else
-int fuse_session_loop_mt_32(struct fuse_session *se, struct fuse_loop_config *config);
-#define fuse_session_loop_mt(se, config) fuse_session_loop_mt_32(se, config)
+int fuse_session_loop_mt_310(struct fuse_session *se, struct fuse_loop_config *config);
+#define fuse_session_loop_mt(se, config) fuse_session_loop_mt_310(se, config)
 #endif
 #endif
 
@@ -2144,9 +2176,12 @@ struct fuse_session *finesse_session_new(struct fuse_args *args,
 int finesse_session_loop_mt_31(struct fuse_session *se, int clone_fd);
 #if FUSE_USE_VERSION < 32
 #define fuse_session_loop_mt(se, clone_fd) finesse_session_loop_mt_31(se, clone_fd)
-#else
+#elif (!defined(__UCLIBC__) && !defined(__APPLE__))
 int finesse_session_loop_mt(struct fuse_session *se, struct fuse_loop_config *config);
 #define fuse_session_loop_mt(se, config) finesse_session_loop_mt(se, config)
+#else
+int finesse_session_loop_mt_310(struct fuse_session *se, struct fuse_loop_config *config);
+#define fuse_session_loop_mt(se, config) finesse_session_loop_mt_310(se, config)
 #endif
 
 void finesse_session_destroy(struct fuse_session *se);
@@ -2161,6 +2196,20 @@ int finesse_session_loop(struct fuse_session *se);
 void finesse_set_provider(fuse_req_t req, int finesse);
 int finesse_get_provider(fuse_req_t req);
 
+/**
+ * Add a file system counter to the live metrics page.  The callback is
+ * invoked from the metrics publisher thread each time the page is refreshed.
+ *
+ * @return 0 on success, ENOSPC if there are too many counters
+ */
+int finesse_register_metric(const char *name, uint64_t (*read)(void *context), void *context);
+
+/**
+ * Remove the counters registered with this callback and context.  Once this
+ * returns the callback will not be invoked again.
+ */
+void finesse_unregister_metric(uint64_t (*read)(void *context), void *context);
+
 /* END FINESSE CODE */
 
 #ifdef __cplusplus
@@ -355,9 +355,10 @@ int cuse_lowlevel_main(int argc, char *argv[], const struct cuse_info *ci,
 
 	if (multithreaded) {
 		struct fuse_loop_config config;
+		memset(&config, 0, sizeof(config));
 		config.clone_fd = 0;
 		config.max_idle_threads = 10;
-		res = fuse_session_loop_mt_32(se, &config);
+		res = fuse_session_loop_mt_310(se, &config);
 	}
 	else
 		res = fuse_session_loop(se);
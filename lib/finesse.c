@@ -17,6 +17,7 @@
 #include "fuse_kernel.h"
 #include "fuse_opt.h"
 #pragma GCC diagnostic pop
+#include <finesse-metrics.h>
 #include <finesse-server.h>
 #include <fuse_lowlevel.h>
 #include "fuse_log.h"
@@ -35,6 +36,10 @@
 #include <unistd.h>
 #include <uuid/uuid.h>
 
+#if !defined(RENAME_EXCHANGE)
+#define RENAME_EXCHANGE (1 << 1)
+#endif  // RENAME_EXCHANGE
+
 #if !defined(offset_of)
 #define offset_of(type, field) (unsigned long)&(((type *)0)->field)
 #endif  // offset_of
@@ -45,9 +50,62 @@
 
 /* TODO: add remove! */
 const struct fuse_lowlevel_ops *finesse_original_ops;
+static struct fuse_lowlevel_ops finesse_saved_ops;
 
 static int finesse_mt = 1;
 
+//
+// Ask to see the reply to a request that changes something (see finesse_notify_reply_iov), so
+// that if it succeeds the clients can be told what changed.  With no clients there is no one to
+// tell about attribute changes, but new and removed names still have to reach our own negative
+// cache.  The page cache prefill has to hear about a change to a file's data both when the
+// request arrives and when it is answered, whether or not there are clients.
+//
+static void finesse_note_change(fuse_req_t req, fuse_ino_t ino, fuse_ino_t parent, const char *name, int delete)
+{
+    if ((0 != ino) && FinessePrefillNoteChange(ino)) {
+        req->finesse.notify    = 1;
+        req->finesse.inval_ino = ino;
+    }
+
+    if ((NULL == req->se->server_handle) || ((NULL == name) && (0 == FinesseGetActiveClientCount(req->se->server_handle)))) {
+        return;
+    }
+
+    req->finesse.notify    = 1;
+    req->finesse.inval_ino = ino;
+
+    if (NULL != name) {
+        req->finesse.inval_parent = parent;
+        req->finesse.inval_name   = strdup(name);
+        req->finesse.inval_delete = delete ? 1 : 0;
+    }
+}
+
+static void finesse_post_invalidations(fuse_req_t req)
+{
+    const char *name = req->finesse.inval_name;
+
+    if (0 != req->finesse.inval_ino) {
+        (void)FinessePrefillNoteChange(req->finesse.inval_ino);
+        FinesseServerInvalidateInode(req->se, req->finesse.inval_ino);
+    }
+
+    if (NULL != name) {
+        if (req->finesse.inval_delete) {
+            FinesseServerNotifyDelete(req->se, req->finesse.inval_parent, 0, name, strlen(name));
+        }
+        else {
+            FinesseServerInvalidateEntry(req->se, req->finesse.inval_parent, name, strlen(name));
+        }
+    }
+
+    name = req->finesse.inval_newname;
+    if (NULL != name) {
+        FinesseServerInvalidateEntry(req->se, req->finesse.inval_newparent, name, strlen(name));
+    }
+}
+
 static void finesse_fuse_init(void *userdata, struct fuse_conn_info *conn)
 {
     assert(NULL != finesse_original_ops->init);
@@ -58,6 +116,7 @@ static void finesse_fuse_init(void *userdata, struct fuse_conn_info *conn)
     do {                                                 \
         if (NULL == finesse_original_ops->original_op) { \
             fuse_reply_err(req, ENOSYS);                 \
+            return;                                      \
         }                                                \
     } while (0)
 
@@ -100,10 +159,11 @@ static void finesse_setattr(fuse_req_t req, fuse_ino_t nodeid, struct stat *attr
     FINESSE_CHECK_ORIGINAL_OP(req, setattr);
 
     finesse_set_provider(req, 0);
+    finesse_note_change(req, nodeid, 0, NULL, 0);
     finesse_original_ops->setattr(req, nodeid, attr, to_set, fi);
 }
 
-static void finesse_readlink(fuse_req_t req, fuse_ino_t ino)
+static void finesse_fuse_readlink(fuse_req_t req, fuse_ino_t ino)
 {
     FINESSE_CHECK_ORIGINAL_OP(req, readlink);
 
@@ -116,6 +176,7 @@ static void finesse_mknod(fuse_req_t req, fuse_ino_t parent, const char *name, m
     FINESSE_CHECK_ORIGINAL_OP(req, mknod);
 
     finesse_set_provider(req, 0);
+    finesse_note_change(req, 0, parent, name, 0);
     finesse_original_ops->mknod(req, parent, name, mode, rdev);
 }
 
@@ -125,6 +186,7 @@ static void finesse_makedir(fuse_req_t req, fuse_ino_t nodeid, const char *name,
     FINESSE_CHECK_ORIGINAL_OP(req, mkdir);
 
     finesse_set_provider(req, 0);
+    finesse_note_change(req, 0, nodeid, name, 0);
     finesse_original_ops->mkdir(req, nodeid, name, mode);
 }
 
@@ -134,39 +196,48 @@ static void finesse_fuse_unlink(fuse_req_t req, fuse_ino_t parent, const char *n
     FINESSE_CHECK_ORIGINAL_OP(req, unlink);
 
     finesse_set_provider(req, 0);
+    finesse_note_change(req, 0, parent, name, 1);
     finesse_original_ops->unlink(req, parent, name);
 }
 
-static void finesse_rmdir(fuse_req_t req, fuse_ino_t parent, const char *name)
+static void finesse_fuse_rmdir(fuse_req_t req, fuse_ino_t parent, const char *name)
 {
     FINESSE_CHECK_ORIGINAL_OP(req, rmdir);
 
     finesse_set_provider(req, 0);
+    finesse_note_change(req, 0, parent, name, 1);
     finesse_original_ops->rmdir(req, parent, name);
 }
 
-static void finesse_symlink(fuse_req_t req, const char *link, fuse_ino_t parent, const char *name)
+static void finesse_fuse_symlink(fuse_req_t req, const char *link, fuse_ino_t parent, const char *name)
 {
     FINESSE_CHECK_ORIGINAL_OP(req, symlink);
 
     finesse_set_provider(req, 0);
+    finesse_note_change(req, 0, parent, name, 0);
     finesse_original_ops->symlink(req, link, parent, name);
 }
 
-static void finesse_rename(fuse_req_t req, fuse_ino_t parent, const char *name, fuse_ino_t newparent, const char *newname,
-                           unsigned int flags)
+static void finesse_fuse_rename(fuse_req_t req, fuse_ino_t parent, const char *name, fuse_ino_t newparent, const char *newname,
+                                unsigned int flags)
 {
     FINESSE_CHECK_ORIGINAL_OP(req, rename);
 
     finesse_set_provider(req, 0);
+    finesse_note_change(req, 0, parent, name, 0 == (flags & RENAME_EXCHANGE));
+    if (req->finesse.notify) {
+        req->finesse.inval_newparent = newparent;
+        req->finesse.inval_newname   = strdup(newname);
+    }
     finesse_original_ops->rename(req, parent, name, newparent, newname, flags);
 }
 
-static void finesse_link(fuse_req_t req, fuse_ino_t ino, fuse_ino_t newparent, const char *newname)
+static void finesse_fuse_link(fuse_req_t req, fuse_ino_t ino, fuse_ino_t newparent, const char *newname)
 {
     FINESSE_CHECK_ORIGINAL_OP(req, link);
 
     finesse_set_provider(req, 0);
+    finesse_note_change(req, ino, newparent, newname, 0);
     finesse_original_ops->link(req, ino, newparent, newname);
 }
 
@@ -175,6 +246,9 @@ static void finesse_fuse_open(fuse_req_t req, fuse_ino_t ino, struct fuse_file_i
     FINESSE_CHECK_ORIGINAL_OP(req, open);
 
     finesse_set_provider(req, 0);
+    if (0 != (fi->flags & O_TRUNC)) {
+        finesse_note_change(req, ino, 0, NULL, 0);
+    }
     finesse_original_ops->open(req, ino, fi);
 }
 
@@ -182,6 +256,7 @@ static void finesse_read(fuse_req_t req, fuse_ino_t ino, size_t size, off_t offs
 {
     FINESSE_CHECK_ORIGINAL_OP(req, read);
 
+    FinessePrefillNoteRead(ino, offset, size);
     finesse_set_provider(req, 0);
     finesse_original_ops->read(req, ino, size, offset, fi);
 }
@@ -192,6 +267,7 @@ static void finesse_write(fuse_req_t req, fuse_ino_t nodeid, const char *buf, si
 
     finesse_set_provider(req, 0);
     req->finesse.notify = 1;
+    finesse_note_change(req, nodeid, 0, NULL, 0);
     finesse_original_ops->write(req, nodeid, buf, size, off, fi);
 }
 
@@ -277,6 +353,7 @@ static void finesse_setxattr(fuse_req_t req, fuse_ino_t ino, const char *name, c
 
     finesse_set_provider(req, 0);
     req->finesse.notify = 0;
+    finesse_note_change(req, ino, 0, NULL, 0);
     finesse_original_ops->setxattr(req, ino, name, value, size, flags);
 }
 
@@ -301,6 +378,7 @@ static void finesse_removexattr(fuse_req_t req, fuse_ino_t ino, const char *name
     FINESSE_CHECK_ORIGINAL_OP(req, removexattr);
 
     finesse_set_provider(req, 0);
+    finesse_note_change(req, ino, 0, NULL, 0);
     finesse_original_ops->removexattr(req, ino, name);
 }
 
@@ -318,6 +396,7 @@ static void finesse_create(fuse_req_t req, fuse_ino_t parent, const char *name,
     FINESSE_CHECK_ORIGINAL_OP(req, create);
 
     finesse_set_provider(req, 0);
+    finesse_note_change(req, 0, parent, name, 0);
     finesse_original_ops->create(req, parent, name, mode, fi);
 }
 
@@ -363,6 +442,7 @@ static void finesse_write_buf(fuse_req_t req, fuse_ino_t ino, struct fuse_bufvec
     FINESSE_CHECK_ORIGINAL_OP(req, write_buf);
 
     finesse_set_provider(req, 0);
+    finesse_note_change(req, ino, 0, NULL, 0);
     finesse_original_ops->write_buf(req, ino, in_buf, off, fi);
 }
 
@@ -392,6 +472,7 @@ static void finesse_fallocate(fuse_req_t req, fuse_ino_t ino, int mode, off_t of
 {
     FINESSE_CHECK_ORIGINAL_OP(req, fallocate);
     finesse_set_provider(req, 0);
+    finesse_note_change(req, ino, 0, NULL, 0);
     finesse_original_ops->fallocate(req, ino, mode, offset, length, fi);
 }
 
@@ -408,6 +489,7 @@ static void finesse_copy_file_range(fuse_req_t req, fuse_ino_t ino_in, off_t off
 {
     FINESSE_CHECK_ORIGINAL_OP(req, copy_file_range);
     finesse_set_provider(req, 0);
+    finesse_note_change(req, ino_out, 0, NULL, 0);
     finesse_original_ops->copy_file_range(req, ino_in, off_in, fi_in, ino_out, off_out, fi_out, len, flags);
 }
 
@@ -425,14 +507,14 @@ static struct fuse_lowlevel_ops finesse_ops = {
     .forget          = finesse_forget,
     .getattr         = finesse_getattr,
     .setattr         = finesse_setattr,
-    .readlink        = finesse_readlink,
+    .readlink        = finesse_fuse_readlink,
     .mknod           = finesse_mknod,
     .mkdir           = finesse_makedir,
     .unlink          = finesse_fuse_unlink,
-    .rmdir           = finesse_rmdir,
-    .symlink         = finesse_symlink,
-    .rename          = finesse_rename,
-    .link            = finesse_link,
+    .rmdir           = finesse_fuse_rmdir,
+    .symlink         = finesse_fuse_symlink,
+    .rename          = finesse_fuse_rename,
+    .link            = finesse_fuse_link,
     .open            = finesse_fuse_open,
     .read            = finesse_read,
     .write           = finesse_write,
@@ -493,9 +575,11 @@ struct fuse_session *finesse_session_new(struct fuse_args *args, const struct fu
     struct fuse_session *se;
 
     //
-    // Save the original ops
+    // Save the original ops.  This must be a copy: the high level library passes ops that live on its stack.
     //
-    finesse_original_ops = op;
+    memset(&finesse_saved_ops, 0, sizeof(finesse_saved_ops));
+    memcpy(&finesse_saved_ops, op, op_size < sizeof(finesse_saved_ops) ? op_size : sizeof(finesse_saved_ops));
+    finesse_original_ops = &finesse_saved_ops;
 
     se = fuse_session_new(args, &finesse_ops, op_size, userdata);
 
@@ -568,7 +652,9 @@ static void *finesse_process_request_worker(void *arg)
         int             status;
         void *          client;
         fincomm_message request;
-        finesse_msg *   fmsg = NULL;
+        finesse_msg *   fmsg         = NULL;
+        unsigned        request_type = FINESSE_METRICS_REQUEST_TYPES;
+        struct timespec start, stop;
 
         status = FinesseGetRequest(fsh, &client, &request);
         assert(0 == status);
@@ -583,6 +669,15 @@ static void *finesse_process_request_worker(void *arg)
                  finesse_get_string_for_message_type(request->MessageType),
                  finesse_get_string_for_message_class(fmsg->MessageClass));
 
+        // The request is overwritten by the response, so capture the type for the metrics first
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (FINESSE_FUSE_MESSAGE == fmsg->MessageClass) {
+            request_type = FINESSE_METRICS_FUSE_INDEX(fmsg->Message.Fuse.Request.Type);
+        }
+        else if (FINESSE_NATIVE_MESSAGE == fmsg->MessageClass) {
+            request_type = FINESSE_METRICS_NATIVE_INDEX(fmsg->Message.Native.Request.NativeRequestType);
+        }
+
         status = EINVAL;
         switch (fmsg->MessageClass) {
             default: {
@@ -602,6 +697,15 @@ static void *finesse_process_request_worker(void *arg)
             } break;
         }
         assert(0 == status);  // shouldn't be failing
+
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+        if (stop.tv_nsec < start.tv_nsec) {
+            stop.tv_sec--;
+            stop.tv_nsec += 1000000000;
+        }
+        stop.tv_sec -= start.tv_sec;
+        stop.tv_nsec -= start.tv_nsec;
+        FinesseMetricsRecordRequest(request_type, &stop);
     }
 
     if (NULL != fsh) {
@@ -612,6 +716,16 @@ static void *finesse_process_request_worker(void *arg)
     return NULL;
 }
 
+int finesse_register_metric(const char *name, uint64_t (*read)(void *context), void *context)
+{
+    return FinesseMetricsRegisterCounter(name, read, context);
+}
+
+void finesse_unregister_metric(uint64_t (*read)(void *context), void *context)
+{
+    FinesseMetricsUnregisterCounter(read, context);
+}
+
 void finesse_notify_reply_iov(fuse_req_t req, int error, struct iovec *iov, int count)
 {
     (void)iov;
@@ -621,6 +735,8 @@ void finesse_notify_reply_iov(fuse_req_t req, int error, struct iovec *iov, int
         return;
     }
 
+    finesse_post_invalidations(req);
+
     if (count < 2) {
         // not sure what this means
         return;
@@ -641,12 +757,16 @@ void finesse_notify_reply_iov(fuse_req_t req, int error, struct iovec *iov, int
             uuid_generate_time_safe(uuid);
 
             assert(iov[1].iov_len >= sizeof(struct fuse_entry_out));
-            ino    = arg->nodeid;
+            ino = arg->nodeid;
+            if (0 == ino) {
+                // negative entry: there is no object to track
+                break;
+            }
+            // A new object keeps one reference for the table; an existing one gets none from us
+            // (holding it would keep the object, and any lookup it owns, forever)
             nicobj = finesse_object_create(ino, &uuid);
             assert(NULL != nicobj);
-            if (0 == uuid_compare(nicobj->uuid, uuid)) {
-                finesse_object_release(nicobj);
-            }
+            finesse_object_release(nicobj);
         }
     }
 }
@@ -695,7 +815,14 @@ static pthread_attr_t finesse_mq_thread_attr;
 pthread_t finesse_threads[FINESSE_MAX_THREADS];
 #undef fuse_session_loop_mt
 
-int finesse_session_loop_mt(struct fuse_session *se, struct fuse_loop_config *config)
+// An object that owned a lookup (see namemap.c) is being freed
+static void finesse_release_object_lookup(void *Context, fuse_ino_t Inode)
+{
+    FinesseReleaseInode((struct fuse_session *)Context, Inode);
+}
+
+FUSE_SYMVER(".symver finesse_session_loop_mt_310,finesse_session_loop_mt@@FUSE_3.10");
+int finesse_session_loop_mt_310(struct fuse_session *se, struct fuse_loop_config *config)
 {
     int status;
 
@@ -711,6 +838,17 @@ int finesse_session_loop_mt(struct fuse_session *se, struct fuse_loop_config *co
 
     fuse_log(FUSE_LOG_INFO, "FINESSE: started Finesse Server connection\n");
 
+    if (NULL != se->server_handle) {
+        // Failing to publish metrics, prefill or cache lookups isn't fatal
+        (void)FinesseMetricsStart(se->server_handle, se->mountpoint);
+        (void)FinessePrefillStart(se);
+        (void)FinesseNegativeStart(se);
+        (void)FinessePrefetchStart(se);
+        finesse_object_set_lookup_release(finesse_release_object_lookup, se);
+        (void)FinesseClientMapsStart(se);
+        (void)FinesseSymlinkStart(se);
+    }
+
     while (NULL != se->server_handle) {
         memset(&finesse_mq_thread_attr, 0, sizeof(finesse_mq_thread_attr));
         status = pthread_attr_init(&finesse_mq_thread_attr);
@@ -744,15 +882,28 @@ int finesse_session_loop_mt(struct fuse_session *se, struct fuse_loop_config *co
         pthread_attr_destroy(&finesse_mq_thread_attr);
         return status;
     }
-    return fuse_session_loop_mt(se, config);
+    return fuse_session_loop_mt_310(se, config);
+}
+
+// Binaries built before the loop configuration grew pass the short one
+int finesse_session_loop_mt_30(struct fuse_session *se, struct fuse_loop_config_v1 *config);
+FUSE_SYMVER(".symver finesse_session_loop_mt_30,finesse_session_loop_mt@FUSE_3.0");
+int finesse_session_loop_mt_30(struct fuse_session *se, struct fuse_loop_config_v1 *config)
+{
+    struct fuse_loop_config config310;
+    memset(&config310, 0, sizeof(config310));
+    config310.clone_fd         = config->clone_fd;
+    config310.max_idle_threads = config->max_idle_threads;
+    return finesse_session_loop_mt_310(se, &config310);
 }
 
 int finesse_session_loop_mt_31(struct fuse_session *se, int clone_fd)
 {
     struct fuse_loop_config config;
+    memset(&config, 0, sizeof(config));
     config.clone_fd         = clone_fd;
     config.max_idle_threads = 10;
-    return finesse_session_loop_mt(se, &config);
+    return finesse_session_loop_mt_310(se, &config);
 }
 
 int finesse_session_loop(struct fuse_session *se)
@@ -767,6 +918,13 @@ void finesse_session_destroy(struct fuse_session *se)
     /* TODO: need to add the finesse specific logic here */
 
     if (NULL != se->server_handle) {
+        FinesseSymlinkStop();
+        FinesseClientMapsStop();
+        finesse_object_set_lookup_release(NULL, NULL);
+        FinessePrefetchStop();
+        FinesseNegativeStop();
+        FinessePrefillStop();
+        FinesseMetricsStop();
         FinesseStopServerConnection(se->server_handle);
         se->server_handle = NULL;
     }
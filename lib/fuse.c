@@ -128,6 +128,9 @@ struct fuse {
 	unsigned int generation;
 	unsigned int hidectr;
 	pthread_mutex_t lock;
+	pthread_rwlock_t tree_lock;
+	unsigned int path_generation;
+	struct node_path *retired_paths;
 	struct fuse_config conf;
 	int intr_installed;
 	struct fuse_fs *fs;
@@ -147,6 +150,24 @@ struct lock {
 	struct lock *next;
 };
 
+/*
+ * Paths handed out by get_path() and friends.  With the path_cache option
+ * each node keeps the path built for it, and later get_path() calls on the
+ * node just take another reference.  A cached path is valid while
+ * 'generation' matches f->path_generation, which is bumped whenever a node
+ * that may have children is renamed or unhashed; renaming a leaf only drops
+ * that node's own cached path.
+ */
+struct node_path {
+	int refctr;
+	unsigned int generation;
+	size_t len;
+	struct node_path *next;	/* on f->retired_paths */
+	char path[];
+};
+
+#define NODE_PATH_HEADER offsetof(struct node_path, path)
+
 struct node {
 	struct node *name_next;
 	struct node *id_next;
@@ -164,6 +185,7 @@ struct node {
 	unsigned int is_hidden : 1;
 	unsigned int cache_valid : 1;
 	int treelock;
+	struct node_path *cached_path;
 	char inline_name[32];
 };
 
@@ -403,6 +425,61 @@ static inline int lru_enabled(struct fuse *f)
 	return f->conf.remember > 0;
 }
 
+/*
+ * The node tables and the tree are protected by f->tree_lock.  Holding it
+ * exclusively (together with f->lock, which also protects the lock queue)
+ * allows any change.  Holding it shared only allows looking nodes up,
+ * building paths and taking or dropping read tree locks and lookup counts,
+ * which are updated atomically.  That is enough for lookups, getattr and
+ * the other path based operations on existing nodes, so those can run
+ * concurrently.
+ *
+ * Lock order is f->lock, then f->tree_lock; f->lock must never be taken
+ * while f->tree_lock is held shared.
+ */
+static void put_path(char *path);
+
+/*
+ * Cached paths replaced while the tree lock is held shared may still be
+ * about to be referenced by another shared holder, so they are only
+ * released once the tree lock is held exclusively.
+ */
+static void release_retired_paths(struct fuse *f)
+{
+	struct node_path *np;
+	struct node_path *next;
+
+	np = __atomic_exchange_n(&f->retired_paths, NULL, __ATOMIC_ACQUIRE);
+	for (; np != NULL; np = next) {
+		next = np->next;
+		put_path(np->path);
+	}
+}
+
+static void lock_tree(struct fuse *f)
+{
+	pthread_mutex_lock(&f->lock);
+	pthread_rwlock_wrlock(&f->tree_lock);
+	if (__atomic_load_n(&f->retired_paths, __ATOMIC_RELAXED) != NULL)
+		release_retired_paths(f);
+}
+
+static void unlock_tree(struct fuse *f)
+{
+	pthread_rwlock_unlock(&f->tree_lock);
+	pthread_mutex_unlock(&f->lock);
+}
+
+static void lock_tree_shared(struct fuse *f)
+{
+	pthread_rwlock_rdlock(&f->tree_lock);
+}
+
+static void unlock_tree_shared(struct fuse *f)
+{
+	pthread_rwlock_unlock(&f->tree_lock);
+}
+
 static struct node_lru *node_lru(struct node *node)
 {
 	return (struct node_lru *) node;
@@ -576,8 +653,29 @@ static void set_forget_time(struct fuse *f, struct node *node)
 	curr_time(&lnode->forget_time);
 }
 
+static void put_path(char *path)
+{
+	struct node_path *np;
+
+	if (path == NULL)
+		return;
+
+	np = (struct node_path *) (path - NODE_PATH_HEADER);
+	if (__atomic_sub_fetch(&np->refctr, 1, __ATOMIC_ACQ_REL) == 0)
+		free(np);
+}
+
+static void drop_cached_path(struct node *node)
+{
+	if (node->cached_path) {
+		put_path(node->cached_path->path);
+		node->cached_path = NULL;
+	}
+}
+
 static void free_node(struct fuse *f, struct node *node)
 {
+	drop_cached_path(node);
 	if (node->name != node->inline_name)
 		free(node->name);
 	free_node_mem(f, node);
@@ -748,6 +846,15 @@ static void unhash_name(struct fuse *f, struct node *node)
 		size_t hash = name_hash(f, node->parent->nodeid, node->name);
 		struct node **nodep = &f->name_table.array[hash];
 
+		/*
+		 * The paths of any children are about to change too,
+		 * so invalidate every cached path unless this node
+		 * can't have children.
+		 */
+		drop_cached_path(node);
+		if (node->refctr > (node->nlookup ? 1 : 0))
+			f->path_generation++;
+
 		for (; *nodep != NULL; nodep = &(*nodep)->name_next)
 			if (*nodep == node) {
 				*nodep = node->name_next;
@@ -874,9 +981,9 @@ static struct node *lookup_node(struct fuse *f, fuse_ino_t parent,
 
 static void inc_nlookup(struct node *node)
 {
-	if (!node->nlookup)
-		node->refctr++;
-	node->nlookup++;
+	/* may be called with the tree lock held shared */
+	if (!__atomic_fetch_add(&node->nlookup, 1, __ATOMIC_RELAXED))
+		__atomic_fetch_add(&node->refctr, 1, __ATOMIC_RELAXED);
 }
 
 static struct node *find_node(struct fuse *f, fuse_ino_t parent,
@@ -884,7 +991,20 @@ static struct node *find_node(struct fuse *f, fuse_ino_t parent,
 {
 	struct node *node;
 
-	pthread_mutex_lock(&f->lock);
+	if (!lru_enabled(f)) {
+		lock_tree_shared(f);
+		if (!name)
+			node = get_node(f, parent);
+		else
+			node = lookup_node(f, parent, name);
+		if (node != NULL)
+			inc_nlookup(node);
+		unlock_tree_shared(f);
+		if (node != NULL)
+			return node;
+	}
+
+	lock_tree(f);
 	if (!name)
 		node = get_node(f, parent);
 	else
@@ -914,7 +1034,7 @@ static struct node *find_node(struct fuse *f, fuse_ino_t parent,
 	}
 	inc_nlookup(node);
 out_err:
-	pthread_mutex_unlock(&f->lock);
+	unlock_tree(f);
 	return node;
 }
 
@@ -925,7 +1045,7 @@ static int lookup_path_in_cache(struct fuse *f,
 	if (!tmp)
 		return -ENOMEM;
 
-	pthread_mutex_lock(&f->lock);
+	lock_tree_shared(f);
 	fuse_ino_t ino = FUSE_ROOT_ID;
 
 	int err = 0;
@@ -940,7 +1060,7 @@ static int lookup_path_in_cache(struct fuse *f,
 		ino = node->nodeid;
 		path_element = strtok_r(NULL, "/", &save_ptr);
 	}
-	pthread_mutex_unlock(&f->lock);
+	unlock_tree_shared(f);
 	free(tmp);
 
 	if (!err)
@@ -948,16 +1068,17 @@ static int lookup_path_in_cache(struct fuse *f,
 	return err;
 }
 
+/* The path is built backwards from the end of buf, leaving room for the header */
 static char *add_name(char **buf, unsigned *bufsize, char *s, const char *name)
 {
 	size_t len = strlen(name);
 
-	if (s - len <= *buf) {
+	if (s - len <= *buf + NODE_PATH_HEADER) {
 		unsigned pathlen = *bufsize - (s - *buf);
 		unsigned newbufsize = *bufsize;
 		char *newbuf;
 
-		while (newbufsize < pathlen + len + 1) {
+		while (newbufsize < NODE_PATH_HEADER + pathlen + len + 1) {
 			if (newbufsize >= 0x80000000)
 				newbufsize = 0xffffffff;
 			else
@@ -988,45 +1109,207 @@ static void unlock_path(struct fuse *f, fuse_ino_t nodeid, struct node *wnode,
 
 	if (wnode) {
 		assert(wnode->treelock == TREELOCK_WRITE);
-		wnode->treelock = 0;
+		__atomic_store_n(&wnode->treelock, 0, __ATOMIC_RELEASE);
 	}
 
 	for (node = get_node(f, nodeid);
 	     node != end && node->nodeid != FUSE_ROOT_ID; node = node->parent) {
-		assert(node->treelock != 0);
-		assert(node->treelock != TREELOCK_WAIT_OFFSET);
-		assert(node->treelock != TREELOCK_WRITE);
-		node->treelock--;
-		if (node->treelock == TREELOCK_WAIT_OFFSET)
-			node->treelock = 0;
+		int treelock = __atomic_fetch_sub(&node->treelock, 1,
+						  __ATOMIC_RELEASE);
+		int waiting = TREELOCK_WAIT_OFFSET;
+
+		assert(treelock != 0);
+		assert(treelock != TREELOCK_WAIT_OFFSET);
+		assert(treelock != TREELOCK_WRITE);
+		if (treelock - 1 == TREELOCK_WAIT_OFFSET)
+			__atomic_compare_exchange_n(&node->treelock, &waiting,
+						    0, false, __ATOMIC_RELAXED,
+						    __ATOMIC_RELAXED);
 	}
 }
 
-static int try_get_path(struct fuse *f, fuse_ino_t nodeid, const char *name,
-			char **path, struct node **wnodep, bool need_lock)
+/* Take a read tree lock on the node unless it is (or is about to be) write locked */
+static bool read_lock_node(struct node *node)
+{
+	int treelock = __atomic_load_n(&node->treelock, __ATOMIC_RELAXED);
+
+	do {
+		if (treelock < 0)
+			return false;
+	} while (!__atomic_compare_exchange_n(&node->treelock, &treelock,
+					      treelock + 1, true,
+					      __ATOMIC_ACQUIRE,
+					      __ATOMIC_RELAXED));
+
+	return true;
+}
+
+static struct node_path *get_cached_path(struct fuse *f, struct node *node)
+{
+	struct node_path *np;
+
+	np = __atomic_load_n(&node->cached_path, __ATOMIC_ACQUIRE);
+	if (np == NULL || np->generation != f->path_generation)
+		return NULL;
+
+	__atomic_add_fetch(&np->refctr, 1, __ATOMIC_RELAXED);
+	return np;
+}
+
+static void set_cached_path(struct fuse *f, struct node *node,
+			    struct node_path *np)
+{
+	struct node_path *old;
+
+	old = __atomic_load_n(&node->cached_path, __ATOMIC_RELAXED);
+	if (old != NULL && old->generation == f->path_generation)
+		return;
+
+	__atomic_add_fetch(&np->refctr, 1, __ATOMIC_RELAXED);
+	if (!__atomic_compare_exchange_n(&node->cached_path, &old, np, false,
+					 __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+		/* somebody else got there first */
+		__atomic_sub_fetch(&np->refctr, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	if (old != NULL) {
+		old->next = __atomic_load_n(&f->retired_paths,
+					    __ATOMIC_RELAXED);
+		while (!__atomic_compare_exchange_n(&f->retired_paths,
+						    &old->next, old, true,
+						    __ATOMIC_RELEASE,
+						    __ATOMIC_RELAXED));
+	}
+}
+
+/* Turn a path built by add_name() into a node_path */
+static struct node_path *finish_path(struct fuse *f, char *buf,
+				     unsigned bufsize, char *s)
+{
+	struct node_path *np = (struct node_path *) buf;
+
+	if (s[0])
+		memmove(np->path, s, bufsize - (s - buf));
+	else
+		strcpy(np->path, "/");
+	np->refctr = 1;
+	np->generation = f->path_generation;
+	np->len = strlen(np->path);
+
+	return np;
+}
+
+/* Build the path of a node without taking any tree locks */
+static int build_path(struct fuse *f, struct node *node,
+		      struct node_path **npp)
 {
 	unsigned bufsize = 256;
 	char *buf;
 	char *s;
-	struct node *node;
-	struct node *wnode = NULL;
-	int err;
 
-	*path = NULL;
-
-	err = -ENOMEM;
 	buf = malloc(bufsize);
 	if (buf == NULL)
-		goto out_err;
+		return -ENOMEM;
 
 	s = buf + bufsize - 1;
 	*s = '\0';
 
-	if (name != NULL) {
-		s = add_name(&buf, &bufsize, s, name);
+	for (; node->nodeid != FUSE_ROOT_ID; node = node->parent) {
+		if (node->name == NULL || node->parent == NULL) {
+			free(buf);
+			return -ENOENT;
+		}
+
+		s = add_name(&buf, &bufsize, s, node->name);
+		if (s == NULL) {
+			free(buf);
+			return -ENOMEM;
+		}
+	}
+
+	*npp = finish_path(f, buf, bufsize, s);
+	return 0;
+}
+
+/*
+ * Get the path of nodeid (plus name, if given) from the path cache,
+ * building and caching the path of nodeid if necessary.
+ */
+static int get_path_from_cache(struct fuse *f, fuse_ino_t nodeid,
+			       const char *name, struct node_path **npp)
+{
+	struct node *node = get_node(f, nodeid);
+	struct node_path *pp = get_cached_path(f, node);
+	struct node_path *np;
+	size_t plen;
+	size_t nlen;
+	int err;
+
+	if (pp == NULL) {
+		err = build_path(f, node, &pp);
+		if (err)
+			return err;
+		set_cached_path(f, node, pp);
+	}
+
+	if (name == NULL) {
+		*npp = pp;
+		return 0;
+	}
+
+	plen = pp->len == 1 ? 0 : pp->len;
+	nlen = strlen(name);
+	np = malloc(NODE_PATH_HEADER + plen + nlen + 2);
+	if (np == NULL) {
+		put_path(pp->path);
+		return -ENOMEM;
+	}
+
+	memcpy(np->path, pp->path, plen);
+	np->path[plen] = '/';
+	memcpy(np->path + plen + 1, name, nlen + 1);
+	np->refctr = 1;
+	np->generation = pp->generation;
+	np->len = plen + nlen + 1;
+	put_path(pp->path);
+
+	*npp = np;
+	return 0;
+}
+
+static int try_get_path(struct fuse *f, fuse_ino_t nodeid, const char *name,
+			char **path, struct node **wnodep, bool need_lock)
+{
+	unsigned bufsize = 256;
+	char *buf = NULL;
+	char *s = NULL;
+	struct node *node;
+	struct node *wnode = NULL;
+	struct node_path *np = NULL;
+	int err;
+
+	*path = NULL;
+
+	if (f->conf.path_cache) {
+		err = get_path_from_cache(f, nodeid, name, &np);
+		if (err)
+			goto out_err;
+	} else {
 		err = -ENOMEM;
-		if (s == NULL)
-			goto out_free;
+		buf = malloc(bufsize);
+		if (buf == NULL)
+			goto out_err;
+
+		s = buf + bufsize - 1;
+		*s = '\0';
+
+		if (name != NULL) {
+			s = add_name(&buf, &bufsize, s, name);
+			err = -ENOMEM;
+			if (s == NULL)
+				goto out_free;
+		}
 	}
 
 	if (wnodep) {
@@ -1049,26 +1332,24 @@ static int try_get_path(struct fuse *f, fuse_ino_t nodeid, const char *name,
 		if (node->name == NULL || node->parent == NULL)
 			goto out_unlock;
 
-		err = -ENOMEM;
-		s = add_name(&buf, &bufsize, s, node->name);
-		if (s == NULL)
-			goto out_unlock;
+		if (np == NULL) {
+			err = -ENOMEM;
+			s = add_name(&buf, &bufsize, s, node->name);
+			if (s == NULL)
+				goto out_unlock;
+		}
 
 		if (need_lock) {
 			err = -EAGAIN;
-			if (node->treelock < 0)
+			if (!read_lock_node(node))
 				goto out_unlock;
-
-			node->treelock++;
 		}
 	}
 
-	if (s[0])
-		memmove(buf, s, bufsize - (s - buf));
-	else
-		strcpy(buf, "/");
+	if (np == NULL)
+		np = finish_path(f, buf, bufsize, s);
 
-	*path = buf;
+	*path = np->path;
 	if (wnodep)
 		*wnodep = wnode;
 
@@ -1078,6 +1359,8 @@ static int try_get_path(struct fuse *f, fuse_ino_t nodeid, const char *name,
 	if (need_lock)
 		unlock_path(f, nodeid, wnode, node);
  out_free:
+	if (np != NULL)
+		put_path(np->path);
 	free(buf);
 
  out_err:
@@ -1210,7 +1493,9 @@ static int wait_path(struct fuse *f, struct lock_queue_element *qe)
 	queue_path(f, qe);
 
 	do {
+		pthread_rwlock_unlock(&f->tree_lock);
 		pthread_cond_wait(&qe->cond, &f->lock);
+		pthread_rwlock_wrlock(&f->tree_lock);
 	} while (!qe->done);
 
 	dequeue_path(f, qe);
@@ -1223,7 +1508,19 @@ static int get_path_common(struct fuse *f, fuse_ino_t nodeid, const char *name,
 {
 	int err;
 
-	pthread_mutex_lock(&f->lock);
+	if (!wnode) {
+		lock_tree_shared(f);
+		err = try_get_path(f, nodeid, name, path, NULL, true);
+		unlock_tree_shared(f);
+		if (err != -EAGAIN)
+			return err;
+	}
+
+	/*
+	 * Retry (or write lock) with the tree lock held exclusively so that
+	 * nothing can be unlocked between failing and joining the queue.
+	 */
+	lock_tree(f);
 	err = try_get_path(f, nodeid, name, path, wnode, true);
 	if (err == -EAGAIN) {
 		struct lock_queue_element qe = {
@@ -1236,7 +1533,7 @@ static int get_path_common(struct fuse *f, fuse_ino_t nodeid, const char *name,
 		err = wait_path(f, &qe);
 		debug_path(f, "DEQUEUE PATH", nodeid, name, !!wnode);
 	}
-	pthread_mutex_unlock(&f->lock);
+	unlock_tree(f);
 
 	return err;
 }
@@ -1331,7 +1628,7 @@ static int try_get_path2(struct fuse *f, fuse_ino_t nodeid1, const char *name1,
 			struct node *wn1 = wnode1 ? *wnode1 : NULL;
 
 			unlock_path(f, nodeid1, wn1, NULL);
-			free(*path1);
+			put_path(*path1);
 		}
 	}
 	return err;
@@ -1344,7 +1641,7 @@ static int get_path2(struct fuse *f, fuse_ino_t nodeid1, const char *name1,
 {
 	int err;
 
-	pthread_mutex_lock(&f->lock);
+	lock_tree(f);
 
 #if defined(CHECK_DIR_LOOP)
 	if (name1)
@@ -1380,7 +1677,7 @@ static int get_path2(struct fuse *f, fuse_ino_t nodeid1, const char *name1,
 #if defined(CHECK_DIR_LOOP)
 out_unlock:
 #endif
-	pthread_mutex_unlock(&f->lock);
+	unlock_tree(f);
 
 	return err;
 }
@@ -1388,12 +1685,18 @@ out_unlock:
 static void free_path_wrlock(struct fuse *f, fuse_ino_t nodeid,
 			     struct node *wnode, char *path)
 {
-	pthread_mutex_lock(&f->lock);
+	bool queued;
+
+	lock_tree_shared(f);
 	unlock_path(f, nodeid, wnode, NULL);
-	if (f->lockq)
+	queued = __atomic_load_n(&f->lockq, __ATOMIC_RELAXED) != NULL;
+	unlock_tree_shared(f);
+	if (queued) {
+		lock_tree(f);
 		wake_up_queued(f);
-	pthread_mutex_unlock(&f->lock);
-	free(path);
+		unlock_tree(f);
+	}
+	put_path(path);
 }
 
 static void free_path(struct fuse *f, fuse_ino_t nodeid, char *path)
@@ -1406,13 +1709,13 @@ static void free_path2(struct fuse *f, fuse_ino_t nodeid1, fuse_ino_t nodeid2,
 		       struct node *wnode1, struct node *wnode2,
 		       char *path1, char *path2)
 {
-	pthread_mutex_lock(&f->lock);
+	lock_tree(f);
 	unlock_path(f, nodeid1, wnode1, NULL);
 	unlock_path(f, nodeid2, wnode2, NULL);
 	wake_up_queued(f);
-	pthread_mutex_unlock(&f->lock);
-	free(path1);
-	free(path2);
+	unlock_tree(f);
+	put_path(path1);
+	put_path(path2);
 }
 
 static void forget_node(struct fuse *f, fuse_ino_t nodeid, uint64_t nlookup)
@@ -1420,7 +1723,7 @@ static void forget_node(struct fuse *f, fuse_ino_t nodeid, uint64_t nlookup)
 	struct node *node;
 	if (nodeid == FUSE_ROOT_ID)
 		return;
-	pthread_mutex_lock(&f->lock);
+	lock_tree(f);
 	node = get_node(f, nodeid);
 
 	/*
@@ -1436,7 +1739,9 @@ static void forget_node(struct fuse *f, fuse_ino_t nodeid, uint64_t nlookup)
 		queue_path(f, &qe);
 
 		do {
+			pthread_rwlock_unlock(&f->tree_lock);
 			pthread_cond_wait(&qe.cond, &f->lock);
+			pthread_rwlock_wrlock(&f->tree_lock);
 		} while (node->nlookup == nlookup && node->treelock);
 
 		dequeue_path(f, &qe);
@@ -1450,7 +1755,7 @@ static void forget_node(struct fuse *f, fuse_ino_t nodeid, uint64_t nlookup)
 	} else if (lru_enabled(f) && node->nlookup == 1) {
 		set_forget_time(f, node);
 	}
-	pthread_mutex_unlock(&f->lock);
+	unlock_tree(f);
 }
 
 static void unlink_node(struct fuse *f, struct node *node)
@@ -1466,11 +1771,11 @@ static void remove_node(struct fuse *f, fuse_ino_t dir, const char *name)
 {
 	struct node *node;
 
-	pthread_mutex_lock(&f->lock);
+	lock_tree(f);
 	node = lookup_node(f, dir, name);
 	if (node != NULL)
 		unlink_node(f, node);
-	pthread_mutex_unlock(&f->lock);
+	unlock_tree(f);
 }
 
 static int rename_node(struct fuse *f, fuse_ino_t olddir, const char *oldname,
@@ -1480,7 +1785,7 @@ static int rename_node(struct fuse *f, fuse_ino_t olddir, const char *oldname,
 	struct node *newnode;
 	int err = 0;
 
-	pthread_mutex_lock(&f->lock);
+	lock_tree(f);
 	node  = lookup_node(f, olddir, oldname);
 	newnode	 = lookup_node(f, newdir, newname);
 	if (node == NULL)
@@ -1505,7 +1810,7 @@ static int rename_node(struct fuse *f, fuse_ino_t olddir, const char *oldname,
 		node->is_hidden = 1;
 
 out:
-	pthread_mutex_unlock(&f->lock);
+	unlock_tree(f);
 	return err;
 }
 
@@ -1516,7 +1821,7 @@ static int exchange_node(struct fuse *f, fuse_ino_t olddir, const char *oldname,
 	struct node *newnode;
 	int err;
 
-	pthread_mutex_lock(&f->lock);
+	lock_tree(f);
 	oldnode  = lookup_node(f, olddir, oldname);
 	newnode	 = lookup_node(f, newdir, newname);
 
@@ -1536,7 +1841,7 @@ static int exchange_node(struct fuse *f, fuse_ino_t olddir, const char *oldname,
 	}
 	err = 0;
 out:
-	pthread_mutex_unlock(&f->lock);
+	unlock_tree(f);
 	return err;
 }
 
@@ -2413,11 +2718,11 @@ static int is_open(struct fuse *f, fuse_ino_t dir, const char *name)
 {
 	struct node *node;
 	int isopen = 0;
-	pthread_mutex_lock(&f->lock);
+	lock_tree_shared(f);
 	node = lookup_node(f, dir, name);
 	if (node && node->open_count > 0)
 		isopen = 1;
-	pthread_mutex_unlock(&f->lock);
+	unlock_tree_shared(f);
 	return isopen;
 }
 
@@ -2432,10 +2737,10 @@ static char *hidden_name(struct fuse *f, fuse_ino_t dir, const char *oldname,
 	int failctr = 10;
 
 	do {
-		pthread_mutex_lock(&f->lock);
+		lock_tree(f);
 		node = lookup_node(f, dir, oldname);
 		if (node == NULL) {
-			pthread_mutex_unlock(&f->lock);
+			unlock_tree(f);
 			return NULL;
 		}
 		do {
@@ -2446,7 +2751,7 @@ static char *hidden_name(struct fuse *f, fuse_ino_t dir, const char *oldname,
 		} while(newnode);
 
 		res = try_get_path(f, dir, newname, &newpath, NULL, false);
-		pthread_mutex_unlock(&f->lock);
+		unlock_tree(f);
 		if (res)
 			break;
 
@@ -2454,7 +2759,7 @@ static char *hidden_name(struct fuse *f, fuse_ino_t dir, const char *oldname,
 		res = fuse_fs_getattr(f->fs, newpath, &buf, NULL);
 		if (res == -ENOENT)
 			break;
-		free(newpath);
+		put_path(newpath);
 		newpath = NULL;
 	} while(res == 0 && --failctr);
 
@@ -2473,7 +2778,7 @@ static int hide_node(struct fuse *f, const char *oldpath,
 		err = fuse_fs_rename(f->fs, oldpath, newpath, 0);
 		if (!err)
 			err = rename_node(f, dir, oldname, dir, newname, 1);
-		free(newpath);
+		put_path(newpath);
 	}
 	return err;
 }
@@ -2527,9 +2832,9 @@ static int do_lookup(struct fuse *f, fuse_ino_t nodeid, const char *name,
 	e->entry_timeout = f->conf.entry_timeout;
 	e->attr_timeout = f->conf.attr_timeout;
 	if (f->conf.auto_cache) {
-		pthread_mutex_lock(&f->lock);
+		lock_tree(f);
 		update_stat(node, &e->attr);
-		pthread_mutex_unlock(&f->lock);
+		unlock_tree(f);
 	}
 	set_stat(f, e->ino, &e->attr);
 	return 0;
@@ -2703,13 +3008,13 @@ static void fuse_lib_lookup(fuse_req_t req, fuse_ino_t parent,
 		int len = strlen(name);
 
 		if (len == 1 || (name[1] == '.' && len == 2)) {
-			pthread_mutex_lock(&f->lock);
+			lock_tree(f);
 			if (len == 1) {
 				if (f->conf.debug)
 					fuse_log(FUSE_LOG_DEBUG, "LOOKUP-DOT\n");
 				dot = get_node_nocheck(f, parent);
 				if (dot == NULL) {
-					pthread_mutex_unlock(&f->lock);
+					unlock_tree(f);
 					reply_entry(req, &e, -ESTALE);
 					return;
 				}
@@ -2719,7 +3024,7 @@ static void fuse_lib_lookup(fuse_req_t req, fuse_ino_t parent,
 					fuse_log(FUSE_LOG_DEBUG, "LOOKUP-DOTDOT\n");
 				parent = get_node(f, parent)->parent->nodeid;
 			}
-			pthread_mutex_unlock(&f->lock);
+			unlock_tree(f);
 			name = NULL;
 		}
 	}
@@ -2740,9 +3045,9 @@ static void fuse_lib_lookup(fuse_req_t req, fuse_ino_t parent,
 		free_path(f, parent, path);
 	}
 	if (dot) {
-		pthread_mutex_lock(&f->lock);
+		lock_tree(f);
 		unref_node(f, dot);
-		pthread_mutex_unlock(&f->lock);
+		unlock_tree(f);
 	}
 	reply_entry(req, &e, err);
 }
@@ -2798,13 +3103,20 @@ static void fuse_lib_getattr(fuse_req_t req, fuse_ino_t ino,
 	if (!err) {
 		struct node *node;
 
-		pthread_mutex_lock(&f->lock);
-		node = get_node(f, ino);
+		if (f->conf.auto_cache) {
+			lock_tree(f);
+			node = get_node(f, ino);
+			update_stat(node, &buf);
+		} else {
+			lock_tree_shared(f);
+			node = get_node(f, ino);
+		}
 		if (node->is_hidden && buf.st_nlink > 0)
 			buf.st_nlink--;
 		if (f->conf.auto_cache)
-			update_stat(node, &buf);
-		pthread_mutex_unlock(&f->lock);
+			unlock_tree(f);
+		else
+			unlock_tree_shared(f);
 		set_stat(f, ino, &buf);
 		fuse_reply_attr(req, &buf, f->conf.attr_timeout);
 	} else
@@ -2899,9 +3211,9 @@ static void fuse_lib_setattr(fuse_req_t req, fuse_ino_t ino, struct stat *attr,
 	}
 	if (!err) {
 		if (f->conf.auto_cache) {
-			pthread_mutex_lock(&f->lock);
+			lock_tree(f);
 			update_stat(get_node(f, ino), &buf);
-			pthread_mutex_unlock(&f->lock);
+			unlock_tree(f);
 		}
 		set_stat(f, ino, &buf);
 		fuse_reply_attr(req, &buf, f->conf.attr_timeout);
@@ -3149,7 +3461,7 @@ static void fuse_do_release(struct fuse *f, fuse_ino_t ino, const char *path,
 
 	fuse_fs_release(f->fs, path, fi);
 
-	pthread_mutex_lock(&f->lock);
+	lock_tree(f);
 	node = get_node(f, ino);
 	assert(node->open_count > 0);
 	--node->open_count;
@@ -3157,7 +3469,7 @@ static void fuse_do_release(struct fuse *f, fuse_ino_t ino, const char *path,
 		unlink_hidden = 1;
 		node->is_hidden = 0;
 	}
-	pthread_mutex_unlock(&f->lock);
+	unlock_tree(f);
 
 	if(unlink_hidden) {
 		if (path) {
@@ -3206,9 +3518,9 @@ static void fuse_lib_create(fuse_req_t req, fuse_ino_t parent,
 		fuse_finish_interrupt(f, req, &d);
 	}
 	if (!err) {
-		pthread_mutex_lock(&f->lock);
+		lock_tree(f);
 		get_node(f, e.ino)->open_count++;
-		pthread_mutex_unlock(&f->lock);
+		unlock_tree(f);
 		if (fuse_reply_create(req, &e, fi) == -ENOENT) {
 			/* The open syscall was interrupted, so it
 			   must be cancelled */
@@ -3234,7 +3546,7 @@ static void open_auto_cache(struct fuse *f, fuse_ino_t ino, const char *path,
 {
 	struct node *node;
 
-	pthread_mutex_lock(&f->lock);
+	lock_tree(f);
 	node = get_node(f, ino);
 	if (node->cache_valid) {
 		struct timespec now;
@@ -3244,9 +3556,9 @@ static void open_auto_cache(struct fuse *f, fuse_ino_t ino, const char *path,
 		    f->conf.ac_attr_timeout) {
 			struct stat stbuf;
 			int err;
-			pthread_mutex_unlock(&f->lock);
+			unlock_tree(f);
 			err = fuse_fs_getattr(f->fs, path, &stbuf, fi);
-			pthread_mutex_lock(&f->lock);
+			lock_tree(f);
 			if (!err)
 				update_stat(node, &stbuf);
 			else
@@ -3257,7 +3569,7 @@ static void open_auto_cache(struct fuse *f, fuse_ino_t ino, const char *path,
 		fi->keep_cache = 1;
 
 	node->cache_valid = 1;
-	pthread_mutex_unlock(&f->lock);
+	unlock_tree(f);
 }
 
 static void fuse_lib_open(fuse_req_t req, fuse_ino_t ino,
@@ -3284,9 +3596,9 @@ static void fuse_lib_open(fuse_req_t req, fuse_ino_t ino,
 		fuse_finish_interrupt(f, req, &d);
 	}
 	if (!err) {
-		pthread_mutex_lock(&f->lock);
+		lock_tree(f);
 		get_node(f, ino)->open_count++;
-		pthread_mutex_unlock(&f->lock);
+		unlock_tree(f);
 		if (fuse_reply_open(req, fi) == -ENOENT) {
 			/* The open syscall was interrupted, so it
 			   must be cancelled */
@@ -3484,11 +3796,11 @@ static fuse_ino_t lookup_nodeid(struct fuse *f, fuse_ino_t parent,
 	struct node *node;
 	fuse_ino_t res = FUSE_UNKNOWN_INO;
 
-	pthread_mutex_lock(&f->lock);
+	lock_tree_shared(f);
 	node = lookup_node(f, parent, name);
 	if (node)
 		res = node->nodeid;
-	pthread_mutex_unlock(&f->lock);
+	unlock_tree_shared(f);
 
 	return res;
 }
@@ -4098,9 +4410,9 @@ static int fuse_flush_common(struct fuse *f, fuse_req_t req, fuse_ino_t ino,
 	if (errlock != -ENOSYS) {
 		flock_to_lock(&lock, &l);
 		l.owner = fi->lock_owner;
-		pthread_mutex_lock(&f->lock);
+		lock_tree(f);
 		locks_insert(get_node(f, ino), &l);
-		pthread_mutex_unlock(&f->lock);
+		unlock_tree(f);
 
 		/* if op.lock() is defined FLUSH is needed regardless
 		   of op.flush() */
@@ -4176,11 +4488,11 @@ static void fuse_lib_getlk(fuse_req_t req, fuse_ino_t ino,
 
 	flock_to_lock(lock, &l);
 	l.owner = fi->lock_owner;
-	pthread_mutex_lock(&f->lock);
+	lock_tree(f);
 	conflict = locks_conflict(get_node(f, ino), &l);
 	if (conflict)
 		lock_to_flock(conflict, lock);
-	pthread_mutex_unlock(&f->lock);
+	unlock_tree(f);
 	if (!conflict)
 		err = fuse_lock_common(req, ino, fi, lock, F_GETLK);
 	else
@@ -4203,9 +4515,9 @@ static void fuse_lib_setlk(fuse_req_t req, fuse_ino_t ino,
 		struct lock l;
 		flock_to_lock(lock, &l);
 		l.owner = fi->lock_owner;
-		pthread_mutex_lock(&f->lock);
+		lock_tree(f);
 		locks_insert(get_node(f, ino), &l);
-		pthread_mutex_unlock(&f->lock);
+		unlock_tree(f);
 	}
 	reply_err(req, err);
 }
@@ -4429,7 +4741,7 @@ int fuse_clean_cache(struct fuse *f)
 	struct node *node;
 	struct timespec now;
 
-	pthread_mutex_lock(&f->lock);
+	lock_tree(f);
 
 	curr_time(&now);
 
@@ -4457,7 +4769,7 @@ int fuse_clean_cache(struct fuse *f)
 		unhash_name(f, node);
 		unref_node(f, node);
 	}
-	pthread_mutex_unlock(&f->lock);
+	unlock_tree(f);
 
 	return clean_delay(f);
 }
@@ -4580,8 +4892,8 @@ int fuse_loop(struct fuse *f)
 	return fuse_session_loop(f->se);
 }
 
-FUSE_SYMVER(".symver fuse_loop_mt_32,fuse_loop_mt@@FUSE_3.2");
-int fuse_loop_mt_32(struct fuse *f, struct fuse_loop_config *config)
+FUSE_SYMVER(".symver fuse_loop_mt_310,fuse_loop_mt@@FUSE_3.10");
+int fuse_loop_mt_310(struct fuse *f, struct fuse_loop_config *config)
 {
 	if (f == NULL)
 		return -1;
@@ -4590,19 +4902,30 @@ int fuse_loop_mt_32(struct fuse *f, struct fuse_loop_config *config)
 	if (res)
 		return -1;
 
-	res = fuse_session_loop_mt_32(fuse_get_session(f), config);
+	res = fuse_session_loop_mt_310(fuse_get_session(f), config);
 	fuse_stop_cleanup_thread(f);
 	return res;
 }
 
+FUSE_SYMVER(".symver fuse_loop_mt_32,fuse_loop_mt@FUSE_3.2");
+int fuse_loop_mt_32(struct fuse *f, struct fuse_loop_config_v1 *config)
+{
+	struct fuse_loop_config config310;
+	memset(&config310, 0, sizeof(config310));
+	config310.clone_fd = config->clone_fd;
+	config310.max_idle_threads = config->max_idle_threads;
+	return fuse_loop_mt_310(f, &config310);
+}
+
 int fuse_loop_mt_31(struct fuse *f, int clone_fd);
 FUSE_SYMVER(".symver fuse_loop_mt_31,fuse_loop_mt@FUSE_3.0");
 int fuse_loop_mt_31(struct fuse *f, int clone_fd)
 {
 	struct fuse_loop_config config;
+	memset(&config, 0, sizeof(config));
 	config.clone_fd = clone_fd;
 	config.max_idle_threads = 10;
-	return fuse_loop_mt_32(f, &config);
+	return fuse_loop_mt_310(f, &config);
 }
 
 void fuse_exit(struct fuse *f)
@@ -4673,6 +4996,7 @@ static const struct fuse_opt fuse_lib_opts[] = {
 	FUSE_LIB_OPT("noforget",              remember, -1),
 	FUSE_LIB_OPT("remember=%u",           remember, 0),
 	FUSE_LIB_OPT("modules=%s",	      modules, 0),
+	FUSE_LIB_OPT("path_cache",	      path_cache, 1),
 	FUSE_OPT_END
 };
 
@@ -4720,6 +5044,7 @@ void fuse_lib_help(struct fuse_args *args)
 "    -o ac_attr_timeout=T   auto cache timeout for attributes (attr_timeout)\n"
 "    -o noforget            never forget cached inodes\n"
 "    -o remember=T          remember cached inodes for T seconds (0s)\n"
+"    -o path_cache          keep the full path of each node between requests\n"
 "    -o modules=M1[:M2...]  names of modules to push onto filesystem stack\n");
 
 
@@ -4873,9 +5198,9 @@ int fuse_start_cleanup_thread(struct fuse *f)
 void fuse_stop_cleanup_thread(struct fuse *f)
 {
 	if (lru_enabled(f)) {
-		pthread_mutex_lock(&f->lock);
+		lock_tree(f);
 		pthread_cancel(f->prune_thread);
-		pthread_mutex_unlock(&f->lock);
+		unlock_tree(f);
 		pthread_join(f->prune_thread, NULL);
 	}
 }
@@ -4890,6 +5215,7 @@ struct fuse *fuse_new_31(struct fuse_args *args,
 	struct node *root;
 	struct fuse_fs *fs;
 	struct fuse_lowlevel_ops llop = fuse_path_ops;
+	pthread_rwlockattr_t attr;
 
 	f = (struct fuse *) calloc(1, sizeof(struct fuse));
 	if (f == NULL) {
@@ -4972,6 +5298,7 @@ struct fuse *fuse_new_31(struct fuse_args *args,
 
 	if (f->conf.debug) {
 		fuse_log(FUSE_LOG_DEBUG, "nullpath_ok: %i\n", f->conf.nullpath_ok);
+		fuse_log(FUSE_LOG_DEBUG, "path_cache: %i\n", f->conf.path_cache);
 	}
 
 	/* Trace topmost layer by default */
@@ -4985,6 +5312,14 @@ struct fuse *fuse_new_31(struct fuse_args *args,
 		goto out_free_name_table;
 
 	fuse_mutex_init(&f->lock);
+	pthread_rwlockattr_init(&attr);
+#ifdef __GLIBC__
+	/* Don't let a steady stream of lookups starve renames and forgets */
+	pthread_rwlockattr_setkind_np(&attr,
+			PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+	pthread_rwlock_init(&f->tree_lock, &attr);
+	pthread_rwlockattr_destroy(&attr);
 
 	root = alloc_node(f);
 	if (root == NULL) {
@@ -5080,12 +5415,13 @@ void fuse_destroy(struct fuse *f)
 					char *path;
 					if (try_get_path(f, node->nodeid, NULL, &path, NULL, false) == 0) {
 						fuse_fs_unlink(f->fs, path);
-						free(path);
+						put_path(path);
 					}
 				}
 			}
 		}
 	}
+	release_retired_paths(f);
 	for (i = 0; i < f->id_table.size; i++) {
 		struct node *node;
 		struct node *next;
@@ -5104,6 +5440,7 @@ void fuse_destroy(struct fuse *f)
 	}
 	free(f->id_table.array);
 	free(f->name_table.array);
+	pthread_rwlock_destroy(&f->tree_lock);
 	pthread_mutex_destroy(&f->lock);
 	fuse_session_destroy(f->se);
 	free(f->conf.modules);
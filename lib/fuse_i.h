@@ -28,7 +28,13 @@ struct fuse_req
 	struct {
 		unsigned int allocated : 1; 		     // set if this is a finesse allocated fuse_req
 		unsigned int notify : 1; 			     // set if this should trigger a finesse notification
+		unsigned int inval_delete : 1;		     // inval_name is being removed from inval_parent
 		struct fuse_req *original_fuse_req;	     // For chained requests, this indicates the original request
+		fuse_ino_t inval_ino;			     // if the request succeeds, tell clients this inode changed,
+		fuse_ino_t inval_parent;		     // and/or that this entry did
+		fuse_ino_t inval_newparent;		     // (and, for a rename, this one)
+		char *inval_name;			     // malloc'd, freed with the request
+		char *inval_newname;
 	} finesse;
 	/* END FINESSE CHANGE */
 	union {
@@ -83,7 +89,13 @@ struct fuse_session
 	pthread_mutex_t lock;
 	int got_destroy;
 	pthread_key_t pipe_key;
+	pthread_key_t req_cache_key;
 	int broken_splice_nonblock;
+	size_t pipe_size;		/* per-thread pipes are created this big */
+	size_t splice_threshold;	/* smallest memory reply to vmsplice */
+	int recv_splice;		/* splice requests instead of read()ing them */
+	unsigned int recv_count;	/* requests seen since mount */
+	unsigned int recv_large;	/* large WRITEs seen in this window */
 	uint64_t notify_ctr;
 	struct fuse_notify_req notify_list;
 	size_t bufsize;
@@ -149,6 +161,23 @@ void fuse_free_req(fuse_req_t req);
 void cuse_lowlevel_init(fuse_req_t req, fuse_ino_t nodeide, const void *inarg);
 
 int fuse_start_thread(pthread_t *thread_id, void *(*func)(void *), void *arg);
+struct fuse_chan *fuse_clone_chan(struct fuse_session *se);
+
+/**
+ * Run the session loop on io_uring workers (see fuse_uring.c).
+ *
+ * @return -ENOSYS if io_uring can't be used, in which case nothing
+ * has been done and the caller should use another loop.
+ */
+int fuse_session_loop_uring(struct fuse_session *se, struct fuse_loop_config *config);
+
+/**
+ * Queue a reply on the calling io_uring worker's ring.
+ *
+ * @return 0 if queued, 1 if the caller must write the reply itself
+ */
+int fuse_uring_send_msg(struct fuse_session *se, struct fuse_chan *ch,
+			struct iovec *iov, int count);
 
 int fuse_session_receive_buf_int(struct fuse_session *se, struct fuse_buf *buf,
 								 struct fuse_chan *ch);
@@ -157,8 +186,41 @@ void fuse_session_process_buf_int(struct fuse_session *se,
 
 struct fuse *fuse_new_31(struct fuse_args *args, const struct fuse_operations *op,
 						 size_t op_size, void *private_data);
-int fuse_loop_mt_32(struct fuse *f, struct fuse_loop_config *config);
-int fuse_session_loop_mt_32(struct fuse_session *se, struct fuse_loop_config *config);
+
+/*
+ * struct fuse_loop_config as it was before the io_uring and per-CPU
+ * worker fields were added; this is what binaries built against the
+ * older header pass to the FUSE_3.2 entry points.
+ */
+struct fuse_loop_config_v1 {
+	int clone_fd;
+	unsigned int max_idle_threads;
+};
+
+int fuse_loop_mt_32(struct fuse *f, struct fuse_loop_config_v1 *config);
+int fuse_loop_mt_310(struct fuse *f, struct fuse_loop_config *config);
+int fuse_session_loop_mt_32(struct fuse_session *se, struct fuse_loop_config_v1 *config);
+int fuse_session_loop_mt_310(struct fuse_session *se, struct fuse_loop_config *config);
+int finesse_session_loop_mt_310(struct fuse_session *se, struct fuse_loop_config *config);
+
+/*
+ * struct fuse_cmdline_opts as it was before the io_uring and per-CPU
+ * worker options were added; what fuse_parse_cmdline@FUSE_3.0 fills.
+ */
+struct fuse_cmdline_opts_v1 {
+	int singlethread;
+	int foreground;
+	int debug;
+	int nodefault_subtype;
+	char *mountpoint;
+	int show_version;
+	int show_help;
+	int clone_fd;
+	unsigned int max_idle_threads;
+};
+
+int fuse_parse_cmdline_30(struct fuse_args *args, struct fuse_cmdline_opts_v1 *opts);
+int fuse_parse_cmdline_310(struct fuse_args *args, struct fuse_cmdline_opts *opts);
 
 #define FUSE_MAX_MAX_PAGES 256
 #define FUSE_DEFAULT_MAX_PAGES_PER_REQ 32
@@ -24,8 +24,10 @@
 #include <signal.h>
 #include <semaphore.h>
 #include <errno.h>
+#include <poll.h>
 #include <sys/time.h>
 #include <sys/ioctl.h>
+#include <sched.h>
 #include <assert.h>
 
 /* Environment var controlling the thread stack size */
@@ -42,6 +44,7 @@ struct fuse_worker {
 	struct fuse_buf fbuf;
 	struct fuse_chan *ch;
 	struct fuse_mt *mt;
+	int standby;
 };
 
 struct fuse_mt {
@@ -55,6 +58,13 @@ struct fuse_mt {
 	int error;
 	int clone_fd;
 	int max_idle;
+	int work_stealing;
+	int numfixed;	/* pinned per-CPU workers */
+	int numactive;	/* per-CPU workers not parked */
+	int numbusy;	/* per-CPU workers processing a request */
+	int numparked;	/* standby workers waiting on standby */
+	sem_t standby;
+	cpu_set_t cpuset;	/* CPUs the session may run on */
 };
 
 static struct fuse_chan *fuse_chan_new(int fd)
@@ -192,6 +202,107 @@ static void *fuse_do_work(void *data)
 	return NULL;
 }
 
+static int fuse_loop_start_percpu_thread(struct fuse_mt *mt, int cpu);
+
+/*
+ * The kernel has one input queue per connection, shared by all cloned
+ * channels, so an idle worker always picks up the next request and
+ * there is never a backlog behind one particular worker.  What can
+ * back up is the connection as a whole, when every worker is stuck in
+ * a slow handler.  With work stealing enabled, the worker that makes
+ * the last reader busy checks whether requests are already waiting
+ * and, if so, wakes (or starts) an unpinned standby worker to take
+ * them.  Standby workers park again once another worker is idle.
+ */
+static int fuse_percpu_backed_up(struct fuse_mt *mt, struct fuse_worker *w)
+{
+	struct pollfd pfd;
+
+	pfd.fd = w->ch ? w->ch->fd : mt->se->fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	return poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLIN);
+}
+
+static void fuse_percpu_add_reader(struct fuse_mt *mt)
+{
+	int parked = __atomic_load_n(&mt->numparked, __ATOMIC_ACQUIRE);
+
+	while (parked > 0) {
+		if (__atomic_compare_exchange_n(&mt->numparked, &parked,
+						parked - 1, 0, __ATOMIC_ACQ_REL,
+						__ATOMIC_ACQUIRE)) {
+			__atomic_add_fetch(&mt->numactive, 1, __ATOMIC_RELEASE);
+			sem_post(&mt->standby);
+			return;
+		}
+	}
+
+	/* max_idle_threads bounds the number of standby workers */
+	pthread_mutex_lock(&mt->lock);
+	if (!mt->exit && mt->numworker - mt->numfixed < mt->max_idle)
+		fuse_loop_start_percpu_thread(mt, -1);
+	pthread_mutex_unlock(&mt->lock);
+}
+
+/*
+ * Worker of the fixed per-CPU pool.  Unlike fuse_do_work() nothing
+ * on the request path takes mt->lock; work stealing only adds two
+ * atomic counter updates per request.
+ */
+static void *fuse_do_percpu_work(void *data)
+{
+	struct fuse_worker *w = (struct fuse_worker *) data;
+	struct fuse_mt *mt = w->mt;
+
+	while (!fuse_session_exited(mt->se)) {
+		int busy;
+		int res;
+
+		pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+		res = fuse_session_receive_buf_int(mt->se, &w->fbuf, w->ch);
+		pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+		if (res == -EINTR)
+			continue;
+		if (res <= 0) {
+			if (res < 0) {
+				fuse_session_exit(mt->se);
+				mt->error = res;
+			}
+			break;
+		}
+
+		if (mt->work_stealing) {
+			busy = __atomic_add_fetch(&mt->numbusy, 1, __ATOMIC_ACQ_REL);
+			if (busy == __atomic_load_n(&mt->numactive, __ATOMIC_ACQUIRE) &&
+			    fuse_percpu_backed_up(mt, w))
+				fuse_percpu_add_reader(mt);
+		}
+
+		fuse_session_process_buf_int(mt->se, &w->fbuf, w->ch);
+
+		if (!mt->work_stealing)
+			continue;
+
+		busy = __atomic_sub_fetch(&mt->numbusy, 1, __ATOMIC_ACQ_REL);
+		if (w->standby &&
+		    busy + 1 < __atomic_load_n(&mt->numactive, __ATOMIC_ACQUIRE)) {
+			/* Another worker is free: park until needed again */
+			__atomic_sub_fetch(&mt->numactive, 1, __ATOMIC_RELEASE);
+			__atomic_add_fetch(&mt->numparked, 1, __ATOMIC_RELEASE);
+			pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+			while (sem_wait(&mt->standby) == -1 && errno == EINTR)
+				;
+			pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+		}
+	}
+
+	sem_post(&mt->finish);
+
+	return NULL;
+}
+
 int fuse_start_thread(pthread_t *thread_id, void *(*func)(void *), void *arg)
 {
 	sigset_t oldset;
@@ -225,7 +336,7 @@ int fuse_start_thread(pthread_t *thread_id, void *(*func)(void *), void *arg)
 	return 0;
 }
 
-static struct fuse_chan *fuse_clone_chan(struct fuse_mt *mt)
+struct fuse_chan *fuse_clone_chan(struct fuse_session *se)
 {
 	int res;
 	int clonefd;
@@ -244,7 +355,7 @@ static struct fuse_chan *fuse_clone_chan(struct fuse_mt *mt)
 	}
 	fcntl(clonefd, F_SETFD, FD_CLOEXEC);
 
-	masterfd = mt->se->fd;
+	masterfd = se->fd;
 	res = ioctl(clonefd, FUSE_DEV_IOC_CLONE, &masterfd);
 	if (res == -1) {
 		fuse_log(FUSE_LOG_ERR, "fuse: failed to clone device fd: %s\n",
@@ -274,7 +385,7 @@ static int fuse_loop_start_thread(struct fuse_mt *mt)
 
 	w->ch = NULL;
 	if (mt->clone_fd) {
-		w->ch = fuse_clone_chan(mt);
+		w->ch = fuse_clone_chan(mt->se);
 		if(!w->ch) {
 			/* Don't attempt this again */
 			fuse_log(FUSE_LOG_ERR, "fuse: trying to continue "
@@ -296,6 +407,83 @@ static int fuse_loop_start_thread(struct fuse_mt *mt)
 	return 0;
 }
 
+/* Start a worker pinned to cpu, or an unpinned standby worker if cpu is -1 */
+static int fuse_loop_start_percpu_thread(struct fuse_mt *mt, int cpu)
+{
+	cpu_set_t cpuset;
+	int res;
+
+	struct fuse_worker *w = malloc(sizeof(struct fuse_worker));
+	if (!w) {
+		fuse_log(FUSE_LOG_ERR, "fuse: failed to allocate worker structure\n");
+		return -1;
+	}
+	memset(w, 0, sizeof(struct fuse_worker));
+	w->fbuf.mem = NULL;
+	w->mt = mt;
+	w->standby = cpu < 0;
+
+	w->ch = NULL;
+	if (mt->clone_fd) {
+		w->ch = fuse_clone_chan(mt->se);
+		if(!w->ch) {
+			/* Don't attempt this again */
+			fuse_log(FUSE_LOG_ERR, "fuse: trying to continue "
+				"without -o clone_fd.\n");
+			mt->clone_fd = 0;
+		}
+	}
+
+	res = fuse_start_thread(&w->thread_id, fuse_do_percpu_work, w);
+	if (res == -1) {
+		fuse_chan_put(w->ch);
+		free(w);
+		return -1;
+	}
+
+	/* A standby worker must not inherit the pinning of its creator */
+	if (cpu >= 0) {
+		CPU_ZERO(&cpuset);
+		CPU_SET(cpu, &cpuset);
+	} else
+		cpuset = mt->cpuset;
+	res = pthread_setaffinity_np(w->thread_id, sizeof(cpuset), &cpuset);
+	if (res != 0)
+		fuse_log(FUSE_LOG_ERR, "fuse: failed to set worker affinity: %s\n",
+			strerror(res));
+
+	list_add_worker(w, &mt->main);
+	mt->numworker++;
+	__atomic_add_fetch(&mt->numactive, 1, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+/* Start one worker for each CPU this process is allowed to run on */
+static int fuse_loop_start_percpu_threads(struct fuse_mt *mt)
+{
+	int cpu;
+	int started = 0;
+
+	if (sched_getaffinity(0, sizeof(mt->cpuset), &mt->cpuset) == -1) {
+		fuse_log(FUSE_LOG_ERR, "fuse: failed to get cpu affinity: %s\n",
+			strerror(errno));
+		CPU_ZERO(&mt->cpuset);
+		for (cpu = 0; cpu < sysconf(_SC_NPROCESSORS_ONLN) && cpu < CPU_SETSIZE; cpu++)
+			CPU_SET(cpu, &mt->cpuset);
+	}
+
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (!CPU_ISSET(cpu, &mt->cpuset))
+			continue;
+		if (fuse_loop_start_percpu_thread(mt, cpu) == 0)
+			started++;
+	}
+	mt->numfixed = started;
+
+	return started ? 0 : -1;
+}
+
 static void fuse_join_worker(struct fuse_mt *mt, struct fuse_worker *w)
 {
 	pthread_join(w->thread_id, NULL);
@@ -307,13 +495,21 @@ static void fuse_join_worker(struct fuse_mt *mt, struct fuse_worker *w)
 	free(w);
 }
 
-FUSE_SYMVER(".symver fuse_session_loop_mt_32,fuse_session_loop_mt@@FUSE_3.2");
-int fuse_session_loop_mt_32(struct fuse_session *se, struct fuse_loop_config *config)
+FUSE_SYMVER(".symver fuse_session_loop_mt_310,fuse_session_loop_mt@@FUSE_3.10");
+int fuse_session_loop_mt_310(struct fuse_session *se, struct fuse_loop_config *config)
 {
 	int err;
 	struct fuse_mt mt;
 	struct fuse_worker *w;
 
+	if (config->io_uring) {
+		err = fuse_session_loop_uring(se, config);
+		if (err != -ENOSYS)
+			return err;
+		fuse_log(FUSE_LOG_INFO, "fuse: io_uring is not available, "
+			 "using worker threads\n");
+	}
+
 	memset(&mt, 0, sizeof(struct fuse_mt));
 	mt.se = se;
 	mt.clone_fd = config->clone_fd;
@@ -321,13 +517,19 @@ int fuse_session_loop_mt_32(struct fuse_session *se, struct fuse_loop_config *co
 	mt.numworker = 0;
 	mt.numavail = 0;
 	mt.max_idle = config->max_idle_threads;
+	mt.work_stealing = config->work_stealing;
 	mt.main.thread_id = pthread_self();
 	mt.main.prev = mt.main.next = &mt.main;
 	sem_init(&mt.finish, 0, 0);
+	sem_init(&mt.standby, 0, 0);
 	fuse_mutex_init(&mt.lock);
 
 	pthread_mutex_lock(&mt.lock);
-	err = fuse_loop_start_thread(&mt);
+	if (config->per_cpu_workers) {
+		mt.clone_fd = 1;
+		err = fuse_loop_start_percpu_threads(&mt);
+	} else
+		err = fuse_loop_start_thread(&mt);
 	pthread_mutex_unlock(&mt.lock);
 	if (!err) {
 		/* sem_wait() is interruptible */
@@ -348,18 +550,30 @@ int fuse_session_loop_mt_32(struct fuse_session *se, struct fuse_loop_config *co
 
 	pthread_mutex_destroy(&mt.lock);
 	sem_destroy(&mt.finish);
+	sem_destroy(&mt.standby);
 	if(se->error != 0)
 		err = se->error;
 	fuse_session_reset(se);
 	return err;
 }
 
+FUSE_SYMVER(".symver fuse_session_loop_mt_32,fuse_session_loop_mt@FUSE_3.2");
+int fuse_session_loop_mt_32(struct fuse_session *se, struct fuse_loop_config_v1 *config)
+{
+	struct fuse_loop_config config310;
+	memset(&config310, 0, sizeof(config310));
+	config310.clone_fd = config->clone_fd;
+	config310.max_idle_threads = config->max_idle_threads;
+	return fuse_session_loop_mt_310(se, &config310);
+}
+
 int fuse_session_loop_mt_31(struct fuse_session *se, int clone_fd);
 FUSE_SYMVER(".symver fuse_session_loop_mt_31,fuse_session_loop_mt@FUSE_3.0");
 int fuse_session_loop_mt_31(struct fuse_session *se, int clone_fd)
 {
 	struct fuse_loop_config config;
+	memset(&config, 0, sizeof(config));
 	config.clone_fd = clone_fd;
 	config.max_idle_threads = 10;
-	return fuse_session_loop_mt_32(se, &config);
+	return fuse_session_loop_mt_310(se, &config);
 }
@@ -169,14 +169,62 @@ static void list_add_req(struct fuse_req *req, struct fuse_req *next)
     next->prev            = req;
 }
 
+/*
+ * Requests are recycled through a small per-thread cache so that the usual
+ * receive/reply cycle does not go to the allocator.  A request goes back to
+ * the cache of the thread that frees it, which is normally the worker that
+ * received it.
+ */
+#define FUSE_REQ_CACHE_MAX 32
+
+struct fuse_req_cache {
+    unsigned int     count;
+    struct fuse_req *head;
+};
+
+static void fuse_req_cache_destructor(void *data)
+{
+    struct fuse_req_cache *cache = data;
+    struct fuse_req *      req;
+
+    while ((req = cache->head) != NULL) {
+        cache->head = req->next;
+        free(req);
+    }
+    free(cache);
+}
+
+static void fuse_ll_put_req(struct fuse_session *se, struct fuse_req *req)
+{
+    struct fuse_req_cache *cache = pthread_getspecific(se->req_cache_key);
+
+    if (cache == NULL) {
+        cache = calloc(1, sizeof(struct fuse_req_cache));
+        if (cache != NULL && pthread_setspecific(se->req_cache_key, cache) != 0) {
+            free(cache);
+            cache = NULL;
+        }
+    }
+
+    if (cache != NULL && cache->count < FUSE_REQ_CACHE_MAX) {
+        req->next   = cache->head;
+        cache->head = req;
+        cache->count++;
+        return;
+    }
+
+    free(req);
+}
+
 extern void FinesseDestroyFuseRequest(fuse_req_t req);
 
 static void FinesseDestroyFuseReq(fuse_req_t req)
 {
     if (0 == req->finesse.allocated) {
+        free(req->finesse.inval_name);
+        free(req->finesse.inval_newname);
         pthread_mutex_destroy(&req->lock);
-        memset(req, 0, sizeof(struct fuse_req));
-        free(req);
+        fuse_ll_put_req(req->se, req);
     }
     else {
         FinesseDestroyFuseRequest(req);
@@ -202,9 +250,19 @@ void fuse_free_req(fuse_req_t req)
 
 static struct fuse_req *fuse_ll_alloc_req(struct fuse_session *se)
 {
-    struct fuse_req *req;
+    struct fuse_req_cache *cache = pthread_getspecific(se->req_cache_key);
+    struct fuse_req *      req;
+
+    if (cache != NULL && cache->head != NULL) {
+        req         = cache->head;
+        cache->head = req->next;
+        cache->count--;
+        memset(req, 0, sizeof(struct fuse_req));
+    }
+    else {
+        req = (struct fuse_req *)calloc(1, sizeof(struct fuse_req));
+    }
 
-    req = (struct fuse_req *)calloc(1, sizeof(struct fuse_req));
     if (req == NULL) {
         fuse_log(FUSE_LOG_ERR, "fuse: failed to allocate request\n");
     }
@@ -241,6 +299,9 @@ static int fuse_send_msg(struct fuse_session *se, struct fuse_chan *ch, struct i
 		}
 	}
 
+	if (fuse_uring_send_msg(se, ch, iov, count) == 0)
+		return 0;
+
     ssize_t res = writev(ch ? ch->fd : se->fd, iov, count);
     int     err = errno;
 
@@ -258,6 +319,9 @@ static int fuse_send_msg(struct fuse_session *se, struct fuse_chan *ch, struct i
 int  finesse_send_reply_iov(fuse_req_t req, int error, struct iovec *iov, int count, int free_req);
 void finesse_notify_reply_iov(fuse_req_t req, int error, struct iovec *iov, int count);
 void finesse_session_mount(struct fuse_session *se);
+void FinesseServerInvalidateInode(struct fuse_session *se, fuse_ino_t Inode);
+void FinesseServerInvalidateEntry(struct fuse_session *se, fuse_ino_t Parent, const char *Name, size_t NameLength);
+void FinesseServerNotifyDelete(struct fuse_session *se, fuse_ino_t Parent, fuse_ino_t Child, const char *Name, size_t NameLength);
 // END FINESSE
 
 int fuse_send_reply_iov_nofree(fuse_req_t req, int error, struct iovec *iov, int count)
@@ -313,20 +377,27 @@ static int send_reply(fuse_req_t req, int error, const void *arg, size_t argsize
     return send_reply_iov(req, error, iov, count);
 }
 
+/* Replies with up to this many iovecs (header included) are built on the stack */
+#define FUSE_REPLY_INLINE_IOV 16
+
 int fuse_reply_iov(fuse_req_t req, const struct iovec *iov, int count)
 {
     int           res;
-    struct iovec *padded_iov;
+    struct iovec  inline_iov[FUSE_REPLY_INLINE_IOV];
+    struct iovec *padded_iov = inline_iov;
 
-    padded_iov = malloc((count + 1) * sizeof(struct iovec));
-    if (padded_iov == NULL)
-        return fuse_reply_err(req, ENOMEM);
+    if (count + 1 > FUSE_REPLY_INLINE_IOV) {
+        padded_iov = malloc((count + 1) * sizeof(struct iovec));
+        if (padded_iov == NULL)
+            return fuse_reply_err(req, ENOMEM);
+    }
 
     memcpy(padded_iov + 1, iov, count * sizeof(struct iovec));
     count++;
 
     res = send_reply_iov(req, 0, padded_iov, count);
-    free(padded_iov);
+    if (padded_iov != inline_iov)
+        free(padded_iov);
 
     return res;
 }
@@ -640,6 +711,35 @@ static int fuse_pipe(int fds[2])
 }
 #endif
 
+static int grow_pipe_to_max(int pipefd)
+{
+	int max;
+	int res;
+	int maxfd;
+	char buf[32];
+
+	maxfd = open("/proc/sys/fs/pipe-max-size", O_RDONLY);
+	if (maxfd < 0)
+		return -errno;
+
+	res = read(maxfd, buf, sizeof(buf) - 1);
+	if (res < 0) {
+		int saved_errno;
+
+		saved_errno = errno;
+		close(maxfd);
+		return -saved_errno;
+	}
+	close(maxfd);
+	buf[res] = '\0';
+
+	max = atoi(buf);
+	res = fcntl(pipefd, F_SETPIPE_SZ, max);
+	if (res < 0)
+		return -errno;
+	return max;
+}
+
 static struct fuse_ll_pipe *fuse_ll_get_pipe(struct fuse_session *se)
 {
     struct fuse_ll_pipe *llp = pthread_getspecific(se->pipe_key);
@@ -662,6 +762,20 @@ static struct fuse_ll_pipe *fuse_ll_get_pipe(struct fuse_session *se)
         llp->size     = pagesize * 16;
         llp->can_grow = 1;
 
+        /*
+         * Size the pipe for the largest request or reply up front so
+         * that the request path doesn't have to grow it later
+         */
+        if (se->pipe_size > llp->size) {
+            res = fcntl(llp->pipe[0], F_SETPIPE_SZ, se->pipe_size);
+            if (res == -1) {
+                res           = grow_pipe_to_max(llp->pipe[0]);
+                llp->can_grow = 0;
+            }
+            if (res > 0)
+                llp->size = res;
+        }
+
         pthread_setspecific(se->pipe_key, llp);
     }
 
@@ -695,33 +809,157 @@ static int read_back(int fd, char *buf, size_t len)
     return 0;
 }
 
-static int grow_pipe_to_max(int pipefd)
+static int buf_is_mem_only(const struct fuse_bufvec *buf)
 {
-	int max;
+	size_t idx;
+
+	for (idx = buf->idx; idx < buf->count; idx++)
+		if (buf->buf[idx].flags & FUSE_BUF_IS_FD)
+			return 0;
+	return 1;
+}
+
+/*
+ * Map the header and the memory buffers of a reply into the pipe.  The
+ * header usually lives on the stack, so only the data pages are ever
+ * gifted to the kernel.
+ */
+static int vmsplice_reply(struct fuse_ll_pipe *llp, struct iovec *iov,
+			  int iov_count, struct fuse_bufvec *buf,
+			  unsigned int flags)
+{
+	struct fuse_out_header *out = iov[0].iov_base;
+	struct iovec data[FUSE_REPLY_INLINE_IOV];
+	unsigned int gift = 0;
+	size_t headerlen = iov_length(iov, iov_count);
+	size_t datalen = 0;
+	size_t idx;
+	int count = 0;
+	ssize_t res;
+
+	if (flags & FUSE_BUF_SPLICE_GIFT)
+		gift = SPLICE_F_GIFT;
+
+	for (idx = buf->idx; idx < buf->count; idx++) {
+		size_t off = idx == buf->idx ? buf->off : 0;
+
+		if (count == FUSE_REPLY_INLINE_IOV)
+			return -E2BIG;
+
+		data[count].iov_base = (char *) buf->buf[idx].mem + off;
+		data[count].iov_len = buf->buf[idx].size - off;
+		if (((uintptr_t) data[count].iov_base |
+		     data[count].iov_len) & (pagesize - 1))
+			gift = 0;
+		datalen += data[count].iov_len;
+		count++;
+	}
+
+	out->len = headerlen + datalen;
+
+	res = vmsplice(llp->pipe[1], iov, iov_count, SPLICE_F_NONBLOCK);
+	if (res != headerlen)
+		return -EIO;
+
+	res = vmsplice(llp->pipe[1], data, count, SPLICE_F_NONBLOCK | gift);
+	if (res != datalen)
+		return -EIO;
+
+	return 0;
+}
+
+static uint64_t elapsed_ns(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000000000ULL +
+		now.tv_nsec - start->tv_nsec;
+}
+
+/*
+ * Find the smallest reply for which sending memory buffers through the
+ * pipe is cheaper than copying them with writev().  Both paths end with
+ * the kernel copying the data once (from our buffer, or from the pipe),
+ * so the writev() side is timed as a write() into a pipe and the splice
+ * side as vmsplice() plus a read() back out of the pipe.
+ *
+ * Returns SIZE_MAX if splicing never wins.
+ */
+static size_t measure_splice_threshold(struct fuse_session *se)
+{
+	const int rounds = 16;
+	size_t threshold = SIZE_MAX;
+	size_t max = se->bufsize - FUSE_BUFFER_HEADER_SIZE;
+	size_t size;
+	void *mem = NULL;
+	char *sink = NULL;
+	int fds[2];
 	int res;
-	int maxfd;
-	char buf[32];
+	int i;
 
-	maxfd = open("/proc/sys/fs/pipe-max-size", O_RDONLY);
-	if (maxfd < 0)
-		return -errno;
+	if (fuse_pipe(fds) == -1)
+		return SIZE_MAX;
 
-	res = read(maxfd, buf, sizeof(buf) - 1);
-	if (res < 0) {
-		int saved_errno;
+	res = fcntl(fds[0], F_SETPIPE_SZ, se->pipe_size);
+	if (res == -1)
+		res = grow_pipe_to_max(fds[0]);
+	if (res <= 0)
+		goto out;
+	if (max > (size_t) res - pagesize)
+		max = res - pagesize;
+
+	if (posix_memalign(&mem, pagesize, max) != 0) {
+		mem = NULL;
+		goto out;
+	}
+	sink = malloc(max);
+	if (sink == NULL)
+		goto out;
+	memset(mem, 0, max);
+	memset(sink, 0, max);
+
+	for (size = pagesize; size <= max; size *= 2) {
+		struct iovec iov = { .iov_base = mem, .iov_len = size };
+		struct timespec start;
+		uint64_t copy_ns;
+		uint64_t splice_ns = 0;
+
+		copy_ns = 0;
+		for (i = 0; i < rounds; i++) {
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			if (write(fds[1], mem, size) != size)
+				goto out;
+			copy_ns += elapsed_ns(&start);
+			if (read(fds[0], sink, size) != size)
+				goto out;
+
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			if (vmsplice(fds[1], &iov, 1, SPLICE_F_NONBLOCK) != size)
+				goto out;
+			if (read(fds[0], sink, size) != size)
+				goto out;
+			splice_ns += elapsed_ns(&start);
+		}
 
-		saved_errno = errno;
-		close(maxfd);
-		return -saved_errno;
+		if (se->debug)
+			fuse_log(FUSE_LOG_DEBUG,
+				 "   splice probe: %zu bytes, copy %llu ns, splice %llu ns\n",
+				 size, (unsigned long long) copy_ns / rounds,
+				 (unsigned long long) splice_ns / rounds);
+
+		if (splice_ns < copy_ns) {
+			threshold = size;
+			break;
+		}
 	}
-	close(maxfd);
-	buf[res] = '\0';
 
-	max = atoi(buf);
-	res = fcntl(pipefd, F_SETPIPE_SZ, max);
-	if (res < 0)
-		return -errno;
-	return max;
+out:
+	free(sink);
+	free(mem);
+	close(fds[0]);
+	close(fds[1]);
+	return threshold;
 }
 
 static int fuse_send_data_iov(struct fuse_session *se, struct fuse_chan *ch,
@@ -737,11 +975,9 @@ static int fuse_send_data_iov(struct fuse_session *se, struct fuse_chan *ch,
 	size_t total_buf_size;
 	size_t idx;
 	size_t headerlen;
+	int mem_only;
 	struct fuse_bufvec pipe_buf = FUSE_BUFVEC_INIT(len);
 
-	if (se->broken_splice_nonblock)
-		goto fallback;
-
 	if (flags & FUSE_BUF_NO_SPLICE)
 		goto fallback;
 
@@ -751,8 +987,21 @@ static int fuse_send_data_iov(struct fuse_session *se, struct fuse_chan *ch,
 		if (idx == buf->idx)
 			total_buf_size -= buf->off;
 	}
-	if (total_buf_size < 2 * pagesize)
-		goto fallback;
+
+	/*
+	 * Memory buffers are vmsplice()d, which doesn't depend on
+	 * working SPLICE_F_NONBLOCK support
+	 */
+	mem_only = buf_is_mem_only(buf);
+	if (mem_only) {
+		if (total_buf_size < se->splice_threshold)
+			goto fallback;
+	} else {
+		if (se->broken_splice_nonblock)
+			goto fallback;
+		if (total_buf_size < 2 * pagesize)
+			goto fallback;
+	}
 
 	if (se->conn.proto_minor < 14 ||
 	    !(se->conn.want & FUSE_CAP_SPLICE_WRITE))
@@ -789,6 +1038,15 @@ static int fuse_send_data_iov(struct fuse_session *se, struct fuse_chan *ch,
 			goto fallback;
 	}
 
+	if (mem_only) {
+		res = vmsplice_reply(llp, iov, iov_count, buf, flags);
+		if (res != 0) {
+			/* Nothing has reached the device yet */
+			fuse_ll_clear_pipe(se);
+			goto fallback;
+		}
+		goto send_pipe;
+	}
 
 	res = vmsplice(llp->pipe[1], iov, iov_count, SPLICE_F_NONBLOCK);
 	if (res == -1)
@@ -888,6 +1146,7 @@ static int fuse_send_data_iov(struct fuse_session *se, struct fuse_chan *ch,
 	len = res;
 	out->len = headerlen + len;
 
+send_pipe:
 	if (se->debug) {
 		fuse_log(FUSE_LOG_DEBUG,
 			"   unique: %llu, success, outsize: %i (splice)\n",
@@ -932,6 +1191,32 @@ static int fuse_send_data_iov(struct fuse_session *se, struct fuse_chan *ch, str
 }
 #endif
 
+// BEGIN FINESSE
+static int finesse_reply_data(fuse_req_t req, struct fuse_bufvec *bufv)
+{
+    size_t             len     = fuse_buf_size(bufv);
+    struct fuse_bufvec mem_buf = FUSE_BUFVEC_INIT(len);
+    void *             mbuf;
+    ssize_t            res;
+
+    mbuf = malloc(len ? len : 1);
+    if (mbuf == NULL)
+        return fuse_reply_err(req, ENOMEM);
+
+    mem_buf.buf[0].mem = mbuf;
+    res                = fuse_buf_copy(&mem_buf, bufv, 0);
+    if (res < 0) {
+        free(mbuf);
+        return fuse_reply_err(req, -res);
+    }
+
+    res = send_reply_ok(req, mbuf, res);
+    free(mbuf);
+
+    return res;
+}
+// END FINESSE
+
 int fuse_reply_data(fuse_req_t req, struct fuse_bufvec *bufv, enum fuse_buf_copy_flags flags)
 {
     struct iovec           iov[2];
@@ -943,6 +1228,13 @@ int fuse_reply_data(fuse_req_t req, struct fuse_bufvec *bufv, enum fuse_buf_copy
     //	populate_time(&(req->ts1), &(req->ts2), req);    /*Add the diff to session*/
     // End StackFS instrumentation
 
+    // BEGIN FINESSE
+    if (req->finesse.allocated) {
+        // Finesse captures replies in memory, so the data can't be spliced
+        return finesse_reply_data(req, bufv);
+    }
+    // END FINESSE
+
     iov[0].iov_base = &out;
     iov[0].iov_len  = sizeof(struct fuse_out_header);
 
@@ -1117,13 +1409,16 @@ int fuse_reply_ioctl(fuse_req_t req, int result, const void *buf, size_t size)
 
 int fuse_reply_ioctl_iov(fuse_req_t req, int result, const struct iovec *iov, int count)
 {
-    struct iovec *        padded_iov;
+    struct iovec          inline_iov[FUSE_REPLY_INLINE_IOV];
+    struct iovec *        padded_iov = inline_iov;
     struct fuse_ioctl_out arg;
     int                   res;
 
-    padded_iov = malloc((count + 2) * sizeof(struct iovec));
-    if (padded_iov == NULL)
-        return fuse_reply_err(req, ENOMEM);
+    if (count + 2 > FUSE_REPLY_INLINE_IOV) {
+        padded_iov = malloc((count + 2) * sizeof(struct iovec));
+        if (padded_iov == NULL)
+            return fuse_reply_err(req, ENOMEM);
+    }
 
     memset(&arg, 0, sizeof(arg));
     arg.result             = result;
@@ -1133,7 +1428,8 @@ int fuse_reply_ioctl_iov(fuse_req_t req, int result, const struct iovec *iov, in
     memcpy(&padded_iov[2], iov, count * sizeof(struct iovec));
 
     res = send_reply_iov(req, 0, padded_iov, count + 2);
-    free(padded_iov);
+    if (padded_iov != inline_iov)
+        free(padded_iov);
 
     return res;
 }
@@ -2112,6 +2408,19 @@ static void do_init(fuse_req_t req, fuse_ino_t nodeid, const void *inarg)
     if (se->conn.max_write < bufsize - FUSE_BUFFER_HEADER_SIZE) {
         se->bufsize = se->conn.max_write + FUSE_BUFFER_HEADER_SIZE;
     }
+
+    if (se->conn.want & (FUSE_CAP_SPLICE_READ | FUSE_CAP_SPLICE_WRITE)) {
+        /* Requests need the whole buffer, replies are bounded by max_read */
+        se->pipe_size = se->bufsize;
+        if (!(se->conn.want & FUSE_CAP_SPLICE_READ) && se->conn.max_read &&
+            se->conn.max_read + FUSE_BUFFER_HEADER_SIZE < se->pipe_size)
+            se->pipe_size = se->conn.max_read + FUSE_BUFFER_HEADER_SIZE;
+        se->pipe_size += getpagesize();
+    }
+#if defined(HAVE_SPLICE) && defined(HAVE_VMSPLICE)
+    if ((se->conn.want & FUSE_CAP_SPLICE_WRITE) && !se->splice_threshold)
+        se->splice_threshold = measure_splice_threshold(se);
+#endif
     if (arg->flags & FUSE_MAX_PAGES) {
         outarg.flags |= FUSE_MAX_PAGES;
         outarg.max_pages = (se->conn.max_write - 1) / getpagesize() + 1;
@@ -2172,6 +2481,12 @@ static void do_init(fuse_req_t req, fuse_ino_t nodeid, const void *inarg)
         fuse_log(FUSE_LOG_DEBUG, "   max_background=%i\n", outarg.max_background);
         fuse_log(FUSE_LOG_DEBUG, "   congestion_threshold=%i\n", outarg.congestion_threshold);
         fuse_log(FUSE_LOG_DEBUG, "   time_gran=%u\n", outarg.time_gran);
+        if (se->conn.want & FUSE_CAP_SPLICE_WRITE) {
+            if (se->splice_threshold == SIZE_MAX)
+                fuse_log(FUSE_LOG_DEBUG, "   splice_threshold=none\n");
+            else
+                fuse_log(FUSE_LOG_DEBUG, "   splice_threshold=%zu\n", se->splice_threshold);
+        }
     }
     if (arg->minor < 5)
         outargsize = FUSE_COMPAT_INIT_OUT_SIZE;
@@ -2279,6 +2594,11 @@ int fuse_lowlevel_notify_inval_inode(struct fuse_session *se, fuse_ino_t ino, of
     if (!se)
         return -EINVAL;
 
+    // BEGIN FINESSE
+    // Finesse clients need to know too (whether or not the kernel does)
+    FinesseServerInvalidateInode(se, ino);
+    // END FINESSE
+
     if (se->conn.proto_minor < 12)
         return -ENOSYS;
 
@@ -2300,6 +2620,10 @@ int fuse_lowlevel_notify_inval_entry(struct fuse_session *se, fuse_ino_t parent,
     if (!se)
         return -EINVAL;
 
+    // BEGIN FINESSE
+    FinesseServerInvalidateEntry(se, parent, name, namelen);
+    // END FINESSE
+
     if (se->conn.proto_minor < 12)
         return -ENOSYS;
 
@@ -2323,6 +2647,10 @@ int fuse_lowlevel_notify_delete(struct fuse_session *se, fuse_ino_t parent, fuse
     if (!se)
         return -EINVAL;
 
+    // BEGIN FINESSE
+    FinesseServerNotifyDelete(se, parent, child, name, namelen);
+    // END FINESSE
+
     if (se->conn.proto_minor < 18)
         return -ENOSYS;
 
@@ -2578,6 +2906,45 @@ void fuse_session_process_buf(struct fuse_session *se, const struct fuse_buf *bu
     fuse_session_process_buf_int(se, buf, NULL);
 }
 
+/*
+ * Splicing requests into a pipe only pays off for WRITEs big enough to be
+ * passed on to write_buf() in the pipe; any other request has to be copied
+ * back out of the pipe, which costs more than a plain read().  Count those
+ * WRITEs over windows of FUSE_RECV_WINDOW requests and only splice while
+ * they make up a good share of the traffic.
+ */
+#define FUSE_RECV_WINDOW 64
+#define FUSE_SPLICE_MIN_REQUEST (sizeof(struct fuse_in_header) + sizeof(struct fuse_write_in) + pagesize)
+
+static void fuse_ll_account_request(struct fuse_session *se, const struct fuse_in_header *in, size_t size)
+{
+    unsigned int large;
+
+    /* Without write_buf() every WRITE is copied out of the pipe, too */
+    if (!(se->conn.want & FUSE_CAP_SPLICE_READ) || !se->op.write_buf)
+        return;
+
+    if (in->opcode == FUSE_WRITE && size >= FUSE_SPLICE_MIN_REQUEST)
+        __atomic_add_fetch(&se->recv_large, 1, __ATOMIC_RELAXED);
+
+    if (__atomic_add_fetch(&se->recv_count, 1, __ATOMIC_RELAXED) % FUSE_RECV_WINDOW)
+        return;
+
+    /* Switch on at a quarter, off below an eighth, so we don't flap */
+    large = __atomic_exchange_n(&se->recv_large, 0, __ATOMIC_RELAXED);
+    if (se->recv_splice) {
+        if (large * 8 < FUSE_RECV_WINDOW)
+            __atomic_store_n(&se->recv_splice, 0, __ATOMIC_RELAXED);
+    }
+    else if (large * 4 >= FUSE_RECV_WINDOW) {
+        __atomic_store_n(&se->recv_splice, 1, __ATOMIC_RELAXED);
+    }
+
+    if (se->debug)
+        fuse_log(FUSE_LOG_DEBUG, "receive: %u large writes in %u requests, %s\n", large, FUSE_RECV_WINDOW,
+                 se->recv_splice ? "splice" : "read");
+}
+
 void fuse_session_process_buf_int(struct fuse_session *se, const struct fuse_buf *buf, struct fuse_chan *ch)
 {
     const size_t           write_header_size = sizeof(struct fuse_in_header) + sizeof(struct fuse_write_in);
@@ -2589,27 +2956,30 @@ void fuse_session_process_buf_int(struct fuse_session *se, const struct fuse_buf
     void *                 mbuf = NULL;
     int                    err;
     int                    res;
+    struct {
+        struct fuse_in_header in;
+        struct fuse_write_in  write;
+    } header;
+
     if (buf->flags & FUSE_BUF_IS_FD) {
         if (buf->size < tmpbuf.buf[0].size)
             tmpbuf.buf[0].size = buf->size;
 
-        mbuf = malloc(tmpbuf.buf[0].size);
-        if (mbuf == NULL) {
-            fuse_log(FUSE_LOG_ERR, "fuse: failed to allocate header\n");
-            goto clear_pipe;
-        }
-        tmpbuf.buf[0].mem = mbuf;
+        /* The header is read onto the stack; only the rest of a request needs a buffer */
+        tmpbuf.buf[0].mem = &header;
 
         res = fuse_ll_copy_from_pipe(&tmpbuf, &bufv);
         if (res < 0)
             goto clear_pipe;
 
-        in = mbuf;
+        in = &header.in;
     }
     else {
         in = buf->mem;
     }
 
+    fuse_ll_account_request(se, in, buf->size);
+
     if (se->debug) {
         fuse_log(FUSE_LOG_DEBUG, "unique: %llu, opcode: %s (%i), nodeid: %llu, insize: %zu, pid: %u\n",
                  (unsigned long long)in->unique, opname((enum fuse_opcode)in->opcode), in->opcode, (unsigned long long)in->nodeid,
@@ -2677,13 +3047,11 @@ void fuse_session_process_buf_int(struct fuse_session *se, const struct fuse_buf
 
     if ((buf->flags & FUSE_BUF_IS_FD) && write_header_size < buf->size && (in->opcode != FUSE_WRITE || !se->op.write_buf) &&
         in->opcode != FUSE_NOTIFY_REPLY) {
-        void *newmbuf;
-
-        err     = ENOMEM;
-        newmbuf = realloc(mbuf, buf->size);
-        if (newmbuf == NULL)
+        err  = ENOMEM;
+        mbuf = malloc(buf->size);
+        if (mbuf == NULL)
             goto reply_err;
-        mbuf = newmbuf;
+        memcpy(mbuf, &header, write_header_size);
 
         tmpbuf            = FUSE_BUFVEC_INIT(buf->size - write_header_size);
         tmpbuf.buf[0].mem = (char *)mbuf + write_header_size;
@@ -2723,7 +3091,7 @@ clear_pipe:
 
 static const struct fuse_opt fuse_ll_opts[] = {LL_OPTION("debug", debug, 1), LL_OPTION("-d", debug, 1),
                                                LL_OPTION("--debug", debug, 1), LL_OPTION("allow_root", deny_others, 1),
-                                               FUSE_OPT_END};
+                                               LL_OPTION("splice_threshold=%zu", splice_threshold, 0), FUSE_OPT_END};
 
 void fuse_lowlevel_version(void)
 {
@@ -2738,12 +3106,15 @@ void fuse_lowlevel_help(void)
     printf(
         "    -o allow_other         allow access by all users\n"
         "    -o allow_root          allow access by root\n"
-        "    -o auto_unmount        auto unmount on process termination\n");
+        "    -o auto_unmount        auto unmount on process termination\n"
+        "    -o splice_threshold=N  smallest reply to send from memory with vmsplice\n"
+        "                           (default: measured at mount time)\n");
 }
 
 void fuse_session_destroy(struct fuse_session *se)
 {
-    struct fuse_ll_pipe *llp;
+    struct fuse_ll_pipe *  llp;
+    struct fuse_req_cache *cache;
 
     if (se->got_init && !se->got_destroy) {
         if (se->op.destroy)
@@ -2753,6 +3124,10 @@ void fuse_session_destroy(struct fuse_session *se)
     if (llp != NULL)
         fuse_ll_pipe_free(llp);
     pthread_key_delete(se->pipe_key);
+    cache = pthread_getspecific(se->req_cache_key);
+    if (cache != NULL)
+        fuse_req_cache_destructor(cache);
+    pthread_key_delete(se->req_cache_key);
     pthread_mutex_destroy(&se->lock);
     free(se->cuse_data);
     if (se->fd != -1)
@@ -2788,6 +3163,9 @@ int fuse_session_receive_buf_int(struct fuse_session *se, struct fuse_buf *buf,
     if (se->conn.proto_minor < 14 || !(se->conn.want & FUSE_CAP_SPLICE_READ))
         goto fallback;
 
+    if (!__atomic_load_n(&se->recv_splice, __ATOMIC_RELAXED))
+        goto fallback;
+
     llp = fuse_ll_get_pipe(se);
     if (llp == NULL)
         goto fallback;
@@ -2842,7 +3220,7 @@ int fuse_session_receive_buf_int(struct fuse_session *se, struct fuse_buf *buf,
      * fuse_loop_mt() needs to check for FORGET so this more than
      * just an optimization.
      */
-    if (res < sizeof(struct fuse_in_header) + sizeof(struct fuse_write_in) + pagesize) {
+    if (res < FUSE_SPLICE_MIN_REQUEST) {
         struct fuse_bufvec src = {.buf[0] = tmpbuf, .count = 1};
         struct fuse_bufvec dst = {.count = 1};
 
@@ -3004,6 +3382,13 @@ struct fuse_session *fuse_session_new(struct fuse_args *args, const struct fuse_
         goto out5;
     }
 
+    err = pthread_key_create(&se->req_cache_key, fuse_req_cache_destructor);
+    if (err) {
+        fuse_log(FUSE_LOG_ERR, "fuse: failed to create thread specific key: %s\n", strerror(err));
+        pthread_key_delete(se->pipe_key);
+        goto out5;
+    }
+
     memcpy(&se->op, op, op_size);
     se->owner    = getuid();
     se->userdata = userdata;
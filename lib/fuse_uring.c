@@ -0,0 +1,691 @@
+/*
+  FUSE: Filesystem in Userspace
+  Copyright (C) 2001-2007  Miklos Szeredi <miklos@szeredi.hu>
+
+  Implementation of the io_uring driven FUSE session loop.
+
+  Each worker thread owns an io_uring and has a read posted on the
+  fuse device only while it is idle, so a request is never claimed by
+  a worker that is busy with another one (where it would wait behind
+  a handler that blocks); an idle worker takes it instead.  When the
+  read completes the request is processed in place, the reply (if it
+  is sent from the worker while processing) is copied into the slot
+  and queued as a write linked to the worker's next read, and both go
+  to the kernel with the io_uring_enter() that waits for the next
+  request.  A busy worker therefore needs one system call per request
+  instead of a read and a writev.
+
+  This program can be distributed under the terms of the GNU LGPLv2.
+  See the file COPYING.LIB.
+*/
+
+#include "config.h"
+#include "fuse_lowlevel.h"
+#include "fuse_misc.h"
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#include "fuse_kernel.h"
+#pragma GCC diagnostic pop
+#include "fuse_i.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <assert.h>
+
+#ifdef HAVE_LINUX_IO_URING_H
+
+#include <linux/io_uring.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <semaphore.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+/* user_data says what completed */
+#define FUSE_URING_READ 0
+#define FUSE_URING_WRITE 1
+#define FUSE_URING_EXIT 2
+#define FUSE_URING_CANCEL 3
+
+/* a read and a reply, the exit poll and a cancel */
+#define FUSE_URING_ENTRIES 4
+
+struct fuse_uring_slot {
+	struct fuse_buf fbuf;
+	uint64_t unique;	/* request being processed, 0 if none */
+	void *reply;
+	size_t reply_size;	/* allocated size of reply */
+	size_t reply_len;	/* length of the queued reply, 0 if none */
+	int reading;		/* read is posted */
+};
+
+struct fuse_uring_loop;
+
+struct fuse_uring {
+	struct fuse_uring_loop *loop;
+	pthread_t thread_id;
+	int started;
+	int ring_fd;
+	int fd;
+	struct fuse_chan *ch;
+
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned sq_mask;
+	unsigned *sq_array;
+	unsigned sqe_tail;	/* next sqe to hand out */
+	struct io_uring_sqe *sqes;
+	unsigned sq_entries;
+
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned cq_mask;
+	struct io_uring_cqe *cqes;
+
+	void *sq_map;
+	size_t sq_map_size;
+	void *cq_map;
+	size_t cq_map_size;
+	size_t sqes_size;
+
+	unsigned inflight;
+	uint64_t requests;
+	uint64_t enters;
+
+	struct fuse_uring_slot *current;
+	struct fuse_uring_slot slot;
+};
+
+struct fuse_uring_loop {
+	struct fuse_session *se;
+	int exit_fd;
+	sem_t finish;
+	int error;
+	unsigned nrings;
+	struct fuse_uring **rings;
+};
+
+/* The ring owned by the calling thread, if it is an io_uring worker */
+static __thread struct fuse_uring *fuse_uring_self;
+
+static int fuse_uring_sys_setup(unsigned entries, struct io_uring_params *p)
+{
+	return (int) syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int fuse_uring_sys_enter(int ring_fd, unsigned to_submit,
+				unsigned min_complete, unsigned flags)
+{
+	return (int) syscall(__NR_io_uring_enter, ring_fd, to_submit,
+			     min_complete, flags, NULL, 0);
+}
+
+static int fuse_uring_sys_register(int ring_fd, unsigned opcode, void *arg,
+				   unsigned nr_args)
+{
+	return (int) syscall(__NR_io_uring_register, ring_fd, opcode, arg,
+			     nr_args);
+}
+
+/*
+ * IORING_OP_READ and IORING_OP_WRITE were added in 5.6; older
+ * kernels will happily create a ring and then fail every read.
+ */
+static int fuse_uring_probe(int ring_fd)
+{
+	const unsigned nops = 256;
+	struct io_uring_probe *probe;
+	int supported = 0;
+
+	probe = calloc(1, sizeof(*probe) + nops * sizeof(struct io_uring_probe_op));
+	if (probe == NULL)
+		return 0;
+
+	if (fuse_uring_sys_register(ring_fd, IORING_REGISTER_PROBE, probe, nops) == 0 &&
+	    probe->last_op >= IORING_OP_WRITE &&
+	    (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) &&
+	    (probe->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED) &&
+	    (probe->ops[IORING_OP_POLL_ADD].flags & IO_URING_OP_SUPPORTED) &&
+	    (probe->ops[IORING_OP_ASYNC_CANCEL].flags & IO_URING_OP_SUPPORTED))
+		supported = 1;
+
+	free(probe);
+	return supported;
+}
+
+static void fuse_uring_free(struct fuse_uring *ring)
+{
+	if (ring == NULL)
+		return;
+
+	if (ring->sqes != NULL && ring->sqes != MAP_FAILED)
+		munmap(ring->sqes, ring->sqes_size);
+	if (ring->cq_map != NULL && ring->cq_map != MAP_FAILED &&
+	    ring->cq_map != ring->sq_map)
+		munmap(ring->cq_map, ring->cq_map_size);
+	if (ring->sq_map != NULL && ring->sq_map != MAP_FAILED)
+		munmap(ring->sq_map, ring->sq_map_size);
+	if (ring->ring_fd >= 0)
+		close(ring->ring_fd);
+
+	free(ring->slot.fbuf.mem);
+	free(ring->slot.reply);
+	fuse_chan_put(ring->ch);
+	free(ring);
+}
+
+static struct fuse_uring *fuse_uring_new(struct fuse_uring_loop *loop,
+					 struct fuse_chan *ch, int *err)
+{
+	struct fuse_session *se = loop->se;
+	struct io_uring_params p;
+	struct fuse_uring *ring;
+
+	ring = calloc(1, sizeof(struct fuse_uring));
+	if (ring == NULL) {
+		fuse_chan_put(ch);
+		*err = -ENOMEM;
+		return NULL;
+	}
+	ring->loop = loop;
+	ring->ch = ch;
+	ring->fd = ch ? ch->fd : se->fd;
+
+	memset(&p, 0, sizeof(p));
+	ring->ring_fd = fuse_uring_sys_setup(FUSE_URING_ENTRIES, &p);
+	if (ring->ring_fd < 0) {
+		*err = -errno;
+		goto out_free;
+	}
+
+	if (!fuse_uring_probe(ring->ring_fd)) {
+		*err = -ENOSYS;
+		goto out_free;
+	}
+
+	ring->sq_map_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ring->cq_map_size = p.cq_off.cqes +
+		p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_map_size > ring->sq_map_size)
+			ring->sq_map_size = ring->cq_map_size;
+		ring->cq_map_size = ring->sq_map_size;
+	}
+
+	ring->sq_map = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE,
+			    MAP_SHARED | MAP_POPULATE, ring->ring_fd,
+			    IORING_OFF_SQ_RING);
+	if (ring->sq_map == MAP_FAILED) {
+		*err = -errno;
+		goto out_free;
+	}
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		ring->cq_map = ring->sq_map;
+	else {
+		ring->cq_map = mmap(NULL, ring->cq_map_size,
+				    PROT_READ | PROT_WRITE,
+				    MAP_SHARED | MAP_POPULATE, ring->ring_fd,
+				    IORING_OFF_CQ_RING);
+		if (ring->cq_map == MAP_FAILED) {
+			*err = -errno;
+			goto out_free;
+		}
+	}
+
+	ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+			  MAP_SHARED | MAP_POPULATE, ring->ring_fd,
+			  IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED) {
+		*err = -errno;
+		goto out_free;
+	}
+
+	ring->sq_head = (unsigned *) ((char *) ring->sq_map + p.sq_off.head);
+	ring->sq_tail = (unsigned *) ((char *) ring->sq_map + p.sq_off.tail);
+	ring->sq_mask = *(unsigned *) ((char *) ring->sq_map + p.sq_off.ring_mask);
+	ring->sq_array = (unsigned *) ((char *) ring->sq_map + p.sq_off.array);
+	ring->sq_entries = p.sq_entries;
+	ring->sqe_tail = *ring->sq_tail;
+
+	ring->cq_head = (unsigned *) ((char *) ring->cq_map + p.cq_off.head);
+	ring->cq_tail = (unsigned *) ((char *) ring->cq_map + p.cq_off.tail);
+	ring->cq_mask = *(unsigned *) ((char *) ring->cq_map + p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *) ((char *) ring->cq_map + p.cq_off.cqes);
+
+	ring->slot.fbuf.mem = malloc(se->bufsize);
+	if (ring->slot.fbuf.mem == NULL) {
+		fuse_log(FUSE_LOG_ERR, "fuse: failed to allocate read buffer\n");
+		*err = -ENOMEM;
+		goto out_free;
+	}
+
+	return ring;
+
+out_free:
+	fuse_uring_free(ring);
+	return NULL;
+}
+
+/* Make the prepared entries visible to the kernel; returns how many there are */
+static unsigned fuse_uring_flush(struct fuse_uring *ring)
+{
+	unsigned to_submit = ring->sqe_tail - *ring->sq_tail;
+
+	__atomic_store_n(ring->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE);
+	return to_submit;
+}
+
+static struct io_uring_sqe *fuse_uring_get_sqe(struct fuse_uring *ring)
+{
+	struct io_uring_sqe *sqe;
+	unsigned index;
+
+	/* The ring is sized so that this only happens if the kernel is behind */
+	while (ring->sqe_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >=
+	       ring->sq_entries)
+		fuse_uring_sys_enter(ring->ring_fd, fuse_uring_flush(ring), 0, 0);
+
+	index = ring->sqe_tail & ring->sq_mask;
+	sqe = &ring->sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	ring->sq_array[index] = index;
+	ring->sqe_tail++;
+	ring->inflight++;
+
+	return sqe;
+}
+
+/* Only called when the worker is about to wait: see the top of the file */
+static void fuse_uring_post_read(struct fuse_uring *ring)
+{
+	struct io_uring_sqe *sqe = fuse_uring_get_sqe(ring);
+
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = ring->fd;
+	sqe->addr = (uintptr_t) ring->slot.fbuf.mem;
+	sqe->len = ring->loop->se->bufsize;
+	sqe->user_data = FUSE_URING_READ;
+	ring->slot.reading = 1;
+}
+
+static void fuse_uring_post_reply(struct fuse_uring *ring)
+{
+	struct fuse_uring_slot *s = &ring->slot;
+	struct io_uring_sqe *sqe = fuse_uring_get_sqe(ring);
+
+	/*
+	 * If the write fails (e.g. the request was interrupted) the
+	 * linked read completes with -ECANCELED and is posted again.
+	 */
+	sqe->opcode = IORING_OP_WRITE;
+	sqe->flags = IOSQE_IO_LINK;
+	sqe->fd = ring->fd;
+	sqe->addr = (uintptr_t) s->reply;
+	sqe->len = s->reply_len;
+	sqe->user_data = FUSE_URING_WRITE;
+	s->reply_len = 0;
+}
+
+static void fuse_uring_post_exit(struct fuse_uring *ring)
+{
+	struct io_uring_sqe *sqe = fuse_uring_get_sqe(ring);
+
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = ring->loop->exit_fd;
+	sqe->poll_events = POLLIN;
+	sqe->user_data = FUSE_URING_EXIT;
+}
+
+int fuse_uring_send_msg(struct fuse_session *se, struct fuse_chan *ch,
+			struct iovec *iov, int count)
+{
+	struct fuse_uring *ring = fuse_uring_self;
+	struct fuse_out_header *out = iov[0].iov_base;
+	struct fuse_uring_slot *s;
+	size_t off = 0;
+	int i;
+
+	/*
+	 * Only the reply to the request this worker is processing is
+	 * queued; notifications and replies sent from other threads
+	 * (or later) are written directly.
+	 */
+	if (ring == NULL || ring->current == NULL)
+		return 1;
+	s = ring->current;
+	if ((ch ? ch->fd : se->fd) != ring->fd || out->unique == 0 ||
+	    out->unique != s->unique || s->reply_len != 0)
+		return 1;
+
+	if (s->reply_size < out->len) {
+		void *reply = realloc(s->reply, out->len);
+
+		if (reply == NULL)
+			return 1;
+		s->reply = reply;
+		s->reply_size = out->len;
+	}
+
+	for (i = 0; i < count; i++) {
+		memcpy((char *) s->reply + off, iov[i].iov_base, iov[i].iov_len);
+		off += iov[i].iov_len;
+	}
+	s->reply_len = off;
+
+	return 0;
+}
+
+static void fuse_uring_exit(struct fuse_uring *ring, int error)
+{
+	struct fuse_uring_loop *loop = ring->loop;
+
+	if (error && !loop->error)
+		loop->error = error;
+	fuse_session_exit(loop->se);
+	sem_post(&loop->finish);
+}
+
+static void fuse_uring_complete_read(struct fuse_uring *ring, int res)
+{
+	struct fuse_session *se = ring->loop->se;
+	struct fuse_uring_slot *s = &ring->slot;
+	struct fuse_in_header *in;
+
+	s->reading = 0;
+
+	if (fuse_session_exited(se))
+		return;
+
+	if (res < 0) {
+		switch (-res) {
+		case ENOENT:	/* operation was interrupted */
+		case EINTR:
+		case EAGAIN:
+		case ECANCELED:	/* linked reply failed */
+			fuse_uring_post_read(ring);
+			break;
+		case ENODEV:	/* unmounted or aborted */
+			fuse_uring_exit(ring, 0);
+			break;
+		default:
+			fuse_log(FUSE_LOG_ERR, "fuse: reading device: %s\n",
+				 strerror(-res));
+			fuse_uring_exit(ring, res);
+			break;
+		}
+		return;
+	}
+
+	if (res == 0) {
+		fuse_uring_exit(ring, 0);
+		return;
+	}
+
+	if ((size_t) res < sizeof(struct fuse_in_header)) {
+		fuse_log(FUSE_LOG_ERR, "short read on fuse device\n");
+		fuse_uring_exit(ring, -EIO);
+		return;
+	}
+
+	in = s->fbuf.mem;
+	s->fbuf.size = res;
+	s->unique = in->unique;
+
+	ring->current = s;
+	fuse_session_process_buf_int(se, &s->fbuf, ring->ch);
+	ring->current = NULL;
+	s->unique = 0;
+	ring->requests++;
+
+	/* Done, so idle again */
+	if (s->reply_len)
+		fuse_uring_post_reply(ring);
+	fuse_uring_post_read(ring);
+}
+
+static void fuse_uring_complete(struct fuse_uring *ring,
+				const struct io_uring_cqe *cqe)
+{
+	struct fuse_session *se = ring->loop->se;
+
+	ring->inflight--;
+
+	switch (cqe->user_data) {
+	case FUSE_URING_READ:
+		fuse_uring_complete_read(ring, cqe->res);
+		break;
+
+	case FUSE_URING_WRITE:
+		/* ENOENT means the operation was interrupted */
+		if (cqe->res < 0 && cqe->res != -ENOENT &&
+		    !fuse_session_exited(se))
+			fuse_log(FUSE_LOG_ERR, "fuse: writing device: %s\n",
+				 strerror(-cqe->res));
+		break;
+
+	case FUSE_URING_EXIT:
+	case FUSE_URING_CANCEL:
+		break;
+	}
+}
+
+static void fuse_uring_reap(struct fuse_uring *ring)
+{
+	unsigned head = *ring->cq_head;
+	unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+	while (head != tail) {
+		struct io_uring_cqe cqe = ring->cqes[head & ring->cq_mask];
+
+		/* release the entry before processing, which may take a while */
+		head++;
+		__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+		fuse_uring_complete(ring, &cqe);
+	}
+}
+
+/* Cancel the read if it is still posted and wait until the kernel is done with the buffers */
+static void fuse_uring_drain(struct fuse_uring *ring)
+{
+	if (ring->slot.reading) {
+		struct io_uring_sqe *sqe = fuse_uring_get_sqe(ring);
+
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->addr = FUSE_URING_READ;
+		sqe->user_data = FUSE_URING_CANCEL;
+	}
+
+	while (ring->inflight) {
+		int res = fuse_uring_sys_enter(ring->ring_fd,
+					       fuse_uring_flush(ring), 1,
+					       IORING_ENTER_GETEVENTS);
+
+		if (res < 0 && errno != EINTR)
+			break;
+		fuse_uring_reap(ring);
+	}
+}
+
+static void *fuse_uring_worker(void *data)
+{
+	struct fuse_uring *ring = (struct fuse_uring *) data;
+	struct fuse_session *se = ring->loop->se;
+
+	fuse_uring_self = ring;
+
+	fuse_uring_post_exit(ring);
+	fuse_uring_post_read(ring);
+
+	while (!fuse_session_exited(se)) {
+		int res = fuse_uring_sys_enter(ring->ring_fd,
+					       fuse_uring_flush(ring), 1,
+					       IORING_ENTER_GETEVENTS);
+
+		ring->enters++;
+		if (res < 0) {
+			if (errno == EINTR)
+				continue;
+			fuse_log(FUSE_LOG_ERR, "fuse: io_uring_enter: %s\n",
+				 strerror(errno));
+			fuse_uring_exit(ring, -errno);
+			break;
+		}
+		fuse_uring_reap(ring);
+	}
+
+	fuse_uring_drain(ring);
+	fuse_uring_self = NULL;
+	sem_post(&ring->loop->finish);
+
+	return NULL;
+}
+
+int fuse_session_loop_uring(struct fuse_session *se,
+			    struct fuse_loop_config *config)
+{
+	struct fuse_uring_loop loop;
+	int clone_fd = config->clone_fd;
+	unsigned i;
+	int flags;
+	int err = 0;
+
+	memset(&loop, 0, sizeof(loop));
+	loop.se = se;
+	/*
+	 * Each worker has one request in progress at a time, so this is
+	 * how many handlers can be running (or blocked) at once.
+	 */
+	loop.nrings = config->max_idle_threads;
+	if (loop.nrings == 0)
+		loop.nrings = 1;
+	loop.rings = calloc(loop.nrings, sizeof(struct fuse_uring *));
+	if (loop.rings == NULL)
+		return -ENOMEM;
+
+	loop.exit_fd = eventfd(0, EFD_CLOEXEC);
+	if (loop.exit_fd == -1) {
+		free(loop.rings);
+		return -ENOSYS;
+	}
+	sem_init(&loop.finish, 0, 0);
+
+	for (i = 0; i < loop.nrings; i++) {
+		struct fuse_chan *ch = NULL;
+
+		if (clone_fd) {
+			ch = fuse_clone_chan(se);
+			if (ch == NULL) {
+				/* Don't attempt this again */
+				fuse_log(FUSE_LOG_ERR, "fuse: trying to continue "
+					 "without -o clone_fd.\n");
+				clone_fd = 0;
+			}
+		}
+
+		loop.rings[i] = fuse_uring_new(&loop, ch, &err);
+		if (loop.rings[i] == NULL)
+			break;
+	}
+
+	if (err) {
+		/* Not fatal: the caller falls back to the thread pool */
+		if (se->debug)
+			fuse_log(FUSE_LOG_DEBUG, "fuse: io_uring unavailable: %s\n",
+				 strerror(-err));
+		err = -ENOSYS;
+		goto out;
+	}
+
+	/*
+	 * The device doesn't support IOCB_NOWAIT, so a blocking read
+	 * would either tie up an io-wq thread or stall the worker when
+	 * several reads race for one request.  With O_NONBLOCK a read
+	 * that finds nothing to do returns -EAGAIN and io_uring waits
+	 * for the device to become readable instead.
+	 */
+	flags = fcntl(se->fd, F_GETFL);
+	if (flags != -1 && !(flags & O_NONBLOCK))
+		fcntl(se->fd, F_SETFL, flags | O_NONBLOCK);
+	for (i = 0; i < loop.nrings; i++) {
+		if (loop.rings[i]->ch)
+			fcntl(loop.rings[i]->fd, F_SETFL,
+			      fcntl(loop.rings[i]->fd, F_GETFL) | O_NONBLOCK);
+	}
+
+	for (i = 0; i < loop.nrings; i++) {
+		if (fuse_start_thread(&loop.rings[i]->thread_id,
+				      fuse_uring_worker, loop.rings[i]) == -1) {
+			fuse_session_exit(se);
+			err = -EIO;
+			break;
+		}
+		loop.rings[i]->started = 1;
+	}
+
+	/* sem_wait() is interruptible */
+	while (!fuse_session_exited(se))
+		sem_wait(&loop.finish);
+
+	if (eventfd_write(loop.exit_fd, 1) == -1)
+		fuse_log(FUSE_LOG_ERR, "fuse: failed to signal io_uring workers: %s\n",
+			 strerror(errno));
+
+	for (i = 0; i < loop.nrings; i++) {
+		if (!loop.rings[i]->started)
+			continue;
+		pthread_join(loop.rings[i]->thread_id, NULL);
+		if (se->debug)
+			fuse_log(FUSE_LOG_DEBUG,
+				 "fuse: io_uring worker %u: %llu requests, %llu io_uring_enter calls\n",
+				 i, (unsigned long long) loop.rings[i]->requests,
+				 (unsigned long long) loop.rings[i]->enters);
+	}
+
+	if (flags != -1 && !(flags & O_NONBLOCK))
+		fcntl(se->fd, F_SETFL, flags);
+
+	if (!err)
+		err = loop.error;
+	if (se->error != 0)
+		err = se->error;
+	fuse_session_reset(se);
+
+out:
+	for (i = 0; i < loop.nrings; i++)
+		fuse_uring_free(loop.rings[i]);
+	free(loop.rings);
+	close(loop.exit_fd);
+	sem_destroy(&loop.finish);
+
+	return err;
+}
+
+#else /* HAVE_LINUX_IO_URING_H */
+
+int fuse_uring_send_msg(struct fuse_session *se, struct fuse_chan *ch,
+			struct iovec *iov, int count)
+{
+	(void) se;
+	(void) ch;
+	(void) iov;
+	(void) count;
+
+	return 1;
+}
+
+int fuse_session_loop_uring(struct fuse_session *se,
+			    struct fuse_loop_config *config)
+{
+	(void) se;
+	(void) config;
+
+	return -ENOSYS;
+}
+
+#endif /* HAVE_LINUX_IO_URING_H */
@@ -50,6 +50,10 @@ static const struct fuse_opt fuse_helper_opts[] = {
 #endif
 	FUSE_HELPER_OPT("clone_fd",	clone_fd),
 	FUSE_HELPER_OPT("max_idle_threads=%u", max_idle_threads),
+	FUSE_HELPER_OPT("io_uring",	io_uring),
+	FUSE_HELPER_OPT("io_uring_depth=%u", io_uring_depth),
+	FUSE_HELPER_OPT("per_cpu_workers", per_cpu_workers),
+	FUSE_HELPER_OPT("work_stealing", work_stealing),
 	FUSE_OPT_END
 };
 
@@ -136,7 +140,14 @@ void fuse_cmdline_help(void)
 	       "    -o clone_fd            use separate fuse device fd for each thread\n"
 	       "                           (may improve performance)\n"
 	       "    -o max_idle_threads    the maximum number of idle worker threads\n"
-	       "                           allowed (default: 10)\n");
+	       "                           allowed (default: 10)\n"
+	       "    -o io_uring            receive and reply through io_uring, with up\n"
+	       "                           to max_idle_threads fixed workers (falls\n"
+	       "                           back to worker threads if unavailable)\n"
+	       "    -o per_cpu_workers     one worker pinned to each cpu, each with its\n"
+	       "                           own cloned fuse device fd\n"
+	       "    -o work_stealing       with per_cpu_workers, add a standby worker\n"
+	       "                           while every worker is busy\n");
 }
 
 static int fuse_helper_opt_proc(void *data, const char *arg, int key,
@@ -199,8 +210,9 @@ static int add_default_subtype(const char *progname, struct fuse_args *args)
 	return res;
 }
 
-int fuse_parse_cmdline(struct fuse_args *args,
-		       struct fuse_cmdline_opts *opts)
+FUSE_SYMVER(".symver fuse_parse_cmdline_310,fuse_parse_cmdline@@FUSE_3.10");
+int fuse_parse_cmdline_310(struct fuse_args *args,
+			   struct fuse_cmdline_opts *opts)
 {
 	memset(opts, 0, sizeof(struct fuse_cmdline_opts));
 
@@ -221,6 +233,18 @@ int fuse_parse_cmdline(struct fuse_args *args,
 	return 0;
 }
 
+FUSE_SYMVER(".symver fuse_parse_cmdline_30,fuse_parse_cmdline@FUSE_3.0");
+int fuse_parse_cmdline_30(struct fuse_args *args,
+			  struct fuse_cmdline_opts_v1 *opts)
+{
+	struct fuse_cmdline_opts opts310;
+	int res;
+
+	res = fuse_parse_cmdline_310(args, &opts310);
+	memcpy(opts, &opts310, sizeof(*opts));
+	return res;
+}
+
 
 int fuse_daemonize(int foreground)
 {
@@ -339,9 +363,14 @@ int fuse_main_real(int argc, char *argv[], const struct fuse_operations *op,
 		res = fuse_loop(fuse);
 	else {
 		struct fuse_loop_config loop_config;
+		memset(&loop_config, 0, sizeof(loop_config));
 		loop_config.clone_fd = opts.clone_fd;
 		loop_config.max_idle_threads = opts.max_idle_threads;
-		res = fuse_loop_mt_32(fuse, &loop_config);
+		loop_config.io_uring = opts.io_uring;
+		loop_config.io_uring_depth = opts.io_uring_depth;
+		loop_config.per_cpu_workers = opts.per_cpu_workers;
+		loop_config.work_stealing = opts.work_stealing;
+		res = fuse_loop_mt_310(fuse, &loop_config);
 	}
 	if (res)
 		res = 7;
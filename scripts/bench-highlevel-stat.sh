@@ -0,0 +1,105 @@
+#!/bin/bash
+#
+# Measure stat throughput through the high-level API (lib/fuse.c).
+#
+# Mounts the passthrough example (which disables kernel attribute and entry
+# caching, so every stat reaches the file system) and runs a multi-threaded
+# stat workload against a file at the top of the tree and against one at the
+# bottom of a deep directory tree, with an increasing number of threads.
+# Any further arguments are passed to passthrough (e.g. -o path_cache).
+#
+
+#Check the user of the script
+if [[ $EUID -ne 0 ]]; then
+   echo "This script must be run as root"
+   exit 1
+fi
+
+#Usage Function
+Usage () {
+	echo "Usage: sudo bash bench-highlevel-stat.sh <build dir> [\"thread counts\"] [seconds] [depth] [fs options]"
+	exit 0
+}
+
+#Arguments Check
+if [ $# -lt 1 ]
+then
+	Usage
+fi
+
+BUILD_DIR=$1
+THREAD_COUNTS=${2:-"1 2 4 8 16"}
+SECONDS_PER_RUN=${3:-10}
+DEPTH=${4:-16}
+shift $(( $# < 4 ? $# : 4 ))
+WORK_DIR=$(mktemp -d /tmp/bench-highlevel-stat.XXXXXX)
+MNT_DIR="$WORK_DIR/mnt"
+SRC_DIR="$WORK_DIR/src"
+mkdir -p "$MNT_DIR" "$SRC_DIR"
+
+DEEP_DIR="$SRC_DIR"
+for i in $(seq $DEPTH)
+do
+	DEEP_DIR="$DEEP_DIR/d$i"
+done
+mkdir -p "$DEEP_DIR"
+touch "$SRC_DIR/file" "$DEEP_DIR/file"
+
+# passthrough exposes the whole root file system under the mount point
+SHALLOW_PATH="$MNT_DIR$SRC_DIR/file"
+DEEP_PATH="$MNT_DIR$DEEP_DIR/file"
+
+"$BUILD_DIR/example/passthrough" -f "$@" "$MNT_DIR" > "$WORK_DIR/fs.log" 2>&1 &
+FS_PID=$!
+for i in $(seq 50)
+do
+	mountpoint -q "$MNT_DIR" && break
+	sleep 0.1
+done
+if ! mountpoint -q "$MNT_DIR"
+then
+	echo "passthrough did not mount"
+	kill $FS_PID
+	exit 1
+fi
+
+workload () {
+	python3 - "$1" "$2" "$SECONDS_PER_RUN" <<'EOF'
+import os, sys, threading, time
+
+path, threads, secs = sys.argv[1], int(sys.argv[2]), float(sys.argv[3])
+counts = [0] * threads
+
+def worker(index):
+    end = time.time() + secs
+    while time.time() < end:
+        os.stat(path)
+        counts[index] += 1
+
+workers = [threading.Thread(target=worker, args=(i,)) for i in range(threads)]
+for w in workers:
+    w.start()
+for w in workers:
+    w.join()
+print(sum(counts))
+EOF
+}
+
+run () {
+	local label=$1
+	local target=$2
+
+	for THREADS in $THREAD_COUNTS
+	do
+		OPS=$(workload "$target" $THREADS)
+		awk -v label="$label" -v threads="$THREADS" -v ops="$OPS" -v secs="$SECONDS_PER_RUN" \
+			'BEGIN { printf "%-20s %4d threads %12.0f stat/s\n", label, threads, ops / secs }'
+	done
+}
+
+run "shallow" "$SHALLOW_PATH"
+run "deep ($DEPTH levels)" "$DEEP_PATH"
+
+umount "$MNT_DIR"
+wait $FS_PID
+rm -rf "$WORK_DIR"
@@ -0,0 +1,106 @@
+#!/bin/bash
+#
+# Measure the metadata throughput of passthrough_hp's inode map.
+#
+# Mounts passthrough_hp with --nocache (so every path walk reaches the file
+# system as a lookup) and runs a workload that looks up files spread over
+# many directories and creates and removes files (which ends in forgets),
+# with an increasing number of client processes. Each client works in its
+# own directory, so any loss of scaling comes from the file system itself.
+# Any further arguments are passed to passthrough_hp.
+#
+
+#Check the user of the script
+if [[ $EUID -ne 0 ]]; then
+   echo "This script must be run as root"
+   exit 1
+fi
+
+#Usage Function
+Usage () {
+	echo "Usage: sudo bash bench-inode-map.sh <build dir> [\"process counts\"] [seconds] [fs options]"
+	exit 0
+}
+
+#Arguments Check
+if [ $# -lt 1 ]
+then
+	Usage
+fi
+
+BUILD_DIR=$1
+PROCESS_COUNTS=${2:-"1 2 4 8 16 32"}
+SECONDS_PER_RUN=${3:-10}
+shift $(( $# < 3 ? $# : 3 ))
+FILES_PER_DIR=64
+WORK_DIR=$(mktemp -d /tmp/bench-inode-map.XXXXXX)
+MNT_DIR="$WORK_DIR/mnt"
+SRC_DIR="$WORK_DIR/src"
+mkdir -p "$MNT_DIR" "$SRC_DIR"
+
+MAX_PROCESSES=$(echo $PROCESS_COUNTS | tr ' ' '\n' | sort -n | tail -1)
+for p in $(seq 0 $(( MAX_PROCESSES - 1 )))
+do
+	mkdir -p "$SRC_DIR/d$p"
+	for f in $(seq $FILES_PER_DIR)
+	do
+		touch "$SRC_DIR/d$p/f$f"
+	done
+done
+
+"$BUILD_DIR/example/passthrough_hp" --nocache "$@" "$SRC_DIR" "$MNT_DIR" > "$WORK_DIR/fs.log" 2>&1 &
+FS_PID=$!
+for i in $(seq 50)
+do
+	mountpoint -q "$MNT_DIR" && break
+	sleep 0.1
+done
+if ! mountpoint -q "$MNT_DIR"
+then
+	echo "passthrough_hp did not mount"
+	kill $FS_PID
+	exit 1
+fi
+
+workload () {
+	python3 - "$MNT_DIR" "$1" "$SECONDS_PER_RUN" "$FILES_PER_DIR" <<'EOF'
+import multiprocessing, os, sys, time
+
+mnt, procs, secs, files = sys.argv[1], int(sys.argv[2]), float(sys.argv[3]), int(sys.argv[4])
+
+def worker(index, result):
+    d = os.path.join(mnt, 'd%d' % index)
+    names = [os.path.join(d, 'f%d' % (i + 1)) for i in range(files)]
+    new = os.path.join(d, 'new')
+    ops = 0
+    end = time.time() + secs
+    while time.time() < end:
+        for name in names:
+            os.stat(name)
+        with open(new, 'w'):
+            pass
+        os.unlink(new)
+        ops += files + 2
+    result.put(ops)
+
+result = multiprocessing.Queue()
+workers = [multiprocessing.Process(target=worker, args=(i, result)) for i in range(procs)]
+for w in workers:
+    w.start()
+total = sum(result.get() for _ in workers)
+for w in workers:
+    w.join()
+print(total)
+EOF
+}
+
+for PROCESSES in $PROCESS_COUNTS
+do
+	OPS=$(workload $PROCESSES)
+	awk -v procs="$PROCESSES" -v ops="$OPS" -v secs="$SECONDS_PER_RUN" \
+		'BEGIN { printf "%4d procs %12.0f ops/s\n", procs, ops / secs }'
+done
+
+umount "$MNT_DIR"
+wait $FS_PID
+rm -rf "$WORK_DIR"
@@ -0,0 +1,117 @@
+#!/bin/bash
+#
+# Compare passthrough_hp's synchronous backing file I/O with the io_uring
+# data backend (--io-uring-data).
+#
+# Mounts passthrough_hp once per mode and runs random reads and writes of a
+# fixed block size against a file in the mount, keeping an increasing number
+# of requests outstanding (one client thread per request). Reads use O_DIRECT
+# and writes are write-through (--nocache disables the writeback cache), so
+# every operation reaches the file system.
+# Reports the throughput and the number of threads the file system ended up
+# with. Any further arguments are passed to passthrough_hp.
+#
+
+#Check the user of the script
+if [[ $EUID -ne 0 ]]; then
+   echo "This script must be run as root"
+   exit 1
+fi
+
+#Usage Function
+Usage () {
+	echo "Usage: sudo bash bench-passthrough-uring.sh <build dir> <source dir> [\"outstanding counts\"] [seconds] [block size] [fs options]"
+	exit 0
+}
+
+#Arguments Check
+if [ $# -lt 2 ]
+then
+	Usage
+fi
+
+BUILD_DIR=$1
+SRC_DIR=$(realpath "$2")
+OUTSTANDING_COUNTS=${3:-"1 2 4 8 16 32 64 128"}
+SECONDS_PER_RUN=${4:-10}
+BLOCK_SIZE=${5:-4096}
+shift $(( $# < 5 ? $# : 5 ))
+FILE_SIZE_MB=${FILE_SIZE_MB:-1024}
+WORK_DIR=$(mktemp -d /tmp/bench-passthrough-uring.XXXXXX)
+MNT_DIR="$WORK_DIR/mnt"
+DATA_FILE="bench-passthrough-uring.data"
+mkdir -p "$MNT_DIR"
+
+# Put the data file on the device to be measured (e.g. an NVMe file system)
+dd if=/dev/urandom of="$SRC_DIR/$DATA_FILE" bs=1M count=$FILE_SIZE_MB status=none
+
+workload () {
+	python3 - "$MNT_DIR/$DATA_FILE" "$1" "$2" "$SECONDS_PER_RUN" "$BLOCK_SIZE" <<'EOF'
+import mmap, os, random, sys, threading, time
+
+path, mode, threads, secs, bs = sys.argv[1], sys.argv[2], int(sys.argv[3]), float(sys.argv[4]), int(sys.argv[5])
+size = os.stat(path).st_size
+counts = [0] * threads
+
+def worker(index):
+    fd = os.open(path, os.O_WRONLY if mode == 'write' else os.O_RDONLY | os.O_DIRECT)
+    buf = mmap.mmap(-1, bs)
+    blocks = size // bs
+    rnd = random.Random(index)
+    end = time.time() + secs
+    while time.time() < end:
+        off = rnd.randrange(blocks) * bs
+        if mode == 'write':
+            os.pwritev(fd, [buf], off)
+        else:
+            os.preadv(fd, [buf], off)
+        counts[index] += 1
+    os.close(fd)
+
+workers = [threading.Thread(target=worker, args=(i,)) for i in range(threads)]
+for w in workers:
+    w.start()
+for w in workers:
+    w.join()
+print(sum(counts))
+EOF
+}
+
+run () {
+	local label=$1
+	shift
+
+	"$BUILD_DIR/example/passthrough_hp" --nocache "$@" "$SRC_DIR" "$MNT_DIR" > "$WORK_DIR/fs.log" 2>&1 &
+	FS_PID=$!
+	for i in $(seq 50)
+	do
+		mountpoint -q "$MNT_DIR" && break
+		sleep 0.1
+	done
+	if ! mountpoint -q "$MNT_DIR"
+	then
+		echo "passthrough_hp did not mount"
+		kill $FS_PID
+		exit 1
+	fi
+
+	for MODE in read write
+	do
+		for OUTSTANDING in $OUTSTANDING_COUNTS
+		do
+			OPS=$(workload $MODE $OUTSTANDING)
+			THREADS=$(ls /proc/$FS_PID/task | wc -l)
+			awk -v label="$label" -v mode="$MODE" -v n="$OUTSTANDING" -v ops="$OPS" -v secs="$SECONDS_PER_RUN" -v bs="$BLOCK_SIZE" -v threads="$THREADS" \
+				'BEGIN { printf "%-10s %-5s %4d outstanding %10.0f ops/s %9.1f MiB/s %4d fs threads\n", label, mode, n, ops / secs, ops * bs / secs / 1048576, threads }'
+		done
+	done
+
+	umount "$MNT_DIR"
+	wait $FS_PID
+}
+
+run "sync" "$@"
+run "io_uring" --io-uring-data "$@"
+
+rm -f "$SRC_DIR/$DATA_FILE"
+rm -rf "$WORK_DIR"
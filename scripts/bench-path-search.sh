@@ -0,0 +1,65 @@
+#!/bin/bash
+#
+# Compare an #include-style path search done with stat calls against the same
+# search done with Finesse path search messages.
+#
+# Mounts the passthrough_ll example (a Finesse server) with caching disabled,
+# builds an include tree with the given number of directories and headers in
+# it, and resolves every header against the whole include path, first with one
+# stat per directory tried (what a compiler does) and then with
+# finesse_search_path (one message per search). Reports the stat calls and
+# messages issued and the time per search. Any further arguments are passed to
+# passthrough_ll.
+#
+
+#Check the user of the script
+if [[ $EUID -ne 0 ]]; then
+   echo "This script must be run as root"
+   exit 1
+fi
+
+#Usage Function
+Usage () {
+	echo "Usage: sudo bash bench-path-search.sh <build dir> [directories] [headers] [rounds] [fs options]"
+	exit 0
+}
+
+#Arguments Check
+if [ $# -lt 1 ]
+then
+	Usage
+fi
+
+BUILD_DIR=$1
+DIRECTORIES=${2:-64}
+HEADERS=${3:-256}
+ROUNDS=${4:-4}
+shift $(( $# < 4 ? $# : 4 ))
+WORK_DIR=$(mktemp -d /tmp/bench-path-search.XXXXXX)
+MNT_DIR="$WORK_DIR/mnt"
+SRC_DIR="$WORK_DIR/src"
+mkdir -p "$MNT_DIR" "$SRC_DIR"
+
+"$BUILD_DIR/example/passthrough_ll" -f -o source="$SRC_DIR" -o cache=never "$@" "$MNT_DIR" > "$WORK_DIR/fs.log" 2>&1 &
+FS_PID=$!
+for i in $(seq 50)
+do
+	mountpoint -q "$MNT_DIR" && break
+	sleep 0.1
+done
+if ! mountpoint -q "$MNT_DIR"
+then
+	echo "passthrough_ll did not mount"
+	kill $FS_PID
+	exit 1
+fi
+
+FINESSE_PATH_SEARCH_DIR="$MNT_DIR/include" \
+FINESSE_PATH_SEARCH_DIRS=$DIRECTORIES \
+FINESSE_PATH_SEARCH_HEADERS=$HEADERS \
+FINESSE_PATH_SEARCH_ROUNDS=$ROUNDS \
+	"$BUILD_DIR/finesse/tests/testpathsearch" /finesse/pathsearch/storm
+
+umount "$MNT_DIR"
+wait $FS_PID
+rm -rf "$WORK_DIR"
@@ -0,0 +1,164 @@
+#!/bin/bash
+#
+# Compare the session loops: the dynamic worker thread pool, the fixed per-CPU
+# worker pool (with and without work stealing) and the io_uring loop.
+#
+# Mounts passthrough_hp or bitbucket once per loop, runs a metadata heavy
+# workload (stat, create and unlink) with an increasing number of client
+# processes and reports the operations per second seen by the workload and
+# the system calls per operation made by the file system process (counted
+# with perf if it is installed, otherwise strace).
+#
+
+#Check the user of the script
+if [[ $EUID -ne 0 ]]; then
+   echo "This script must be run as root"
+   exit 1
+fi
+
+#Usage Function
+Usage () {
+	echo "Usage: sudo bash bench-session-loop.sh <passthrough_hp|bitbucket> <build dir> [\"process counts\"] [seconds]"
+	exit 0
+}
+
+#Arguments Check
+if [ $# -lt 2 ]
+then
+	Usage
+fi
+
+FS=$1
+BUILD_DIR=$2
+PROCESS_COUNTS=${3:-"1 2 4 8 16"}
+SECONDS_PER_RUN=${4:-10}
+WORK_DIR=$(mktemp -d /tmp/bench-session-loop.XXXXXX)
+MNT_DIR="$WORK_DIR/mnt"
+SRC_DIR="$WORK_DIR/src"
+mkdir -p "$MNT_DIR" "$SRC_DIR"
+
+if command -v perf > /dev/null
+then
+	COUNTER="perf"
+elif command -v strace > /dev/null
+then
+	COUNTER="strace"
+else
+	echo "Neither perf nor strace found; only ops/s will be reported."
+	COUNTER=""
+fi
+
+mount_fs () {
+	case $FS in
+	passthrough_hp)
+		"$BUILD_DIR/example/passthrough_hp" --nocache "$@" "$SRC_DIR" "$MNT_DIR" > "$WORK_DIR/fs.log" 2>&1 &
+		;;
+	bitbucket)
+		"$BUILD_DIR/finesse/bitbucket/bitbucket" -f "$@" "$MNT_DIR" > "$WORK_DIR/fs.log" 2>&1 &
+		;;
+	*)
+		Usage
+		;;
+	esac
+	FS_PID=$!
+	for i in $(seq 50)
+	do
+		mountpoint -q "$MNT_DIR" && return 0
+		sleep 0.1
+	done
+	echo "$FS did not mount"
+	kill $FS_PID
+	exit 1
+}
+
+workload () {
+	python3 - "$MNT_DIR" "$1" "$SECONDS_PER_RUN" <<'EOF'
+import multiprocessing, os, sys, time
+
+mnt, procs, secs = sys.argv[1], int(sys.argv[2]), float(sys.argv[3])
+
+def worker(index, result):
+    name = os.path.join(mnt, 'f%d' % index)
+    ops = 0
+    end = time.time() + secs
+    while time.time() < end:
+        with open(name, 'w'):
+            pass
+        for _ in range(8):
+            os.stat(name)
+        os.unlink(name)
+        ops += 10
+    result.put(ops)
+
+result = multiprocessing.Queue()
+workers = [multiprocessing.Process(target=worker, args=(i, result)) for i in range(procs)]
+for w in workers:
+    w.start()
+total = sum(result.get() for _ in workers)
+for w in workers:
+    w.join()
+print(total)
+EOF
+}
+
+run () {
+	local label=$1
+	shift
+
+	mount_fs "$@"
+
+	for PROCESSES in $PROCESS_COUNTS
+	do
+		case $COUNTER in
+		perf)
+			perf stat -e raw_syscalls:sys_enter -p $FS_PID -x, -o "$WORK_DIR/count" &
+			;;
+		strace)
+			strace -c -f -p $FS_PID -o "$WORK_DIR/count" &
+			;;
+		esac
+		COUNTER_PID=$!
+		sleep 0.5
+
+		OPS=$(workload $PROCESSES)
+
+		if [ -n "$COUNTER" ]
+		then
+			kill -INT $COUNTER_PID
+			wait $COUNTER_PID 2> /dev/null
+		fi
+
+		case $COUNTER in
+		perf)
+			SYSCALLS=$(grep raw_syscalls "$WORK_DIR/count" | cut -d, -f1)
+			;;
+		strace)
+			SYSCALLS=$(awk '/total/ { print $(NF-2) }' "$WORK_DIR/count")
+			;;
+		*)
+			SYSCALLS=0
+			;;
+		esac
+
+		awk -v label="$label" -v procs="$PROCESSES" -v ops="$OPS" -v secs="$SECONDS_PER_RUN" -v sys="$SYSCALLS" \
+			'BEGIN { printf "%-28s %4d procs %12.0f ops/s %8.2f syscalls/op\n", label, procs, ops / secs, (ops ? sys / ops : 0) }'
+	done
+
+	umount "$MNT_DIR"
+	wait $FS_PID
+}
+
+if [ "$FS" = "passthrough_hp" ]
+then
+	run "worker threads"
+	run "io_uring" --io-uring
+else
+	run "worker threads"
+	run "worker threads + clone_fd" -o clone_fd
+	run "per-cpu workers" -o per_cpu_workers
+	run "per-cpu workers + stealing" -o per_cpu_workers -o work_stealing
+	run "io_uring" -o io_uring
+	run "io_uring + clone_fd" -o io_uring -o clone_fd
+fi
+
+rm -rf "$WORK_DIR"
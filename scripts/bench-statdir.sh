@@ -0,0 +1,63 @@
+#!/bin/bash
+#
+# Compare a du-style walk of a large tree done with a stat per entry against
+# the same walk done with Finesse statdir messages (one per directory).
+#
+# Mounts the passthrough_ll example (a Finesse server) with caching disabled,
+# builds a tree with the given number of files in it (1,000,000 by default,
+# spread over directories of the given size) and walks it, first with readdir
+# and an lstat of each entry (what du does) and then with finesse_statdir.
+# Reports the stat calls and messages issued and the entries walked per second.
+# The tree is kept in the given source directory, so later runs (with the same
+# sizes) skip building it. Any further arguments are passed to passthrough_ll.
+#
+
+#Check the user of the script
+if [[ $EUID -ne 0 ]]; then
+   echo "This script must be run as root"
+   exit 1
+fi
+
+#Usage Function
+Usage () {
+	echo "Usage: sudo bash bench-statdir.sh <build dir> <source dir> [files] [files per directory] [fs options]"
+	exit 0
+}
+
+#Arguments Check
+if [ $# -lt 2 ]
+then
+	Usage
+fi
+
+BUILD_DIR=$1
+SRC_DIR=$(realpath "$2")
+FILES=${3:-1000000}
+FANOUT=${4:-1000}
+shift $(( $# < 4 ? $# : 4 ))
+WORK_DIR=$(mktemp -d /tmp/bench-statdir.XXXXXX)
+MNT_DIR="$WORK_DIR/mnt"
+mkdir -p "$MNT_DIR"
+
+"$BUILD_DIR/example/passthrough_ll" -f -o source="$SRC_DIR" -o cache=never "$@" "$MNT_DIR" > "$WORK_DIR/fs.log" 2>&1 &
+FS_PID=$!
+for i in $(seq 50)
+do
+	mountpoint -q "$MNT_DIR" && break
+	sleep 0.1
+done
+if ! mountpoint -q "$MNT_DIR"
+then
+	echo "passthrough_ll did not mount"
+	kill $FS_PID
+	exit 1
+fi
+
+FINESSE_STATDIR_DIR="$MNT_DIR/statdir-tree" \
+FINESSE_STATDIR_FILES=$FILES \
+FINESSE_STATDIR_FANOUT=$FANOUT \
+	"$BUILD_DIR/finesse/tests/teststatdir" /finesse/statdir/du
+
+umount "$MNT_DIR"
+wait $FS_PID
+rm -rf "$WORK_DIR"
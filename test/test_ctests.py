@@ -36,6 +36,12 @@ def test_write_cache(tmpdir, writeback, output_checker):
     subprocess.check_call(cmdline, stdout=output_checker.fd, stderr=output_checker.fd)
 
 
+def test_req_alloc(tmpdir, output_checker):
+    mnt_dir = str(tmpdir)
+    cmdline = [ pjoin(basename, 'test', 'test_req_alloc'),
+                mnt_dir ]
+    subprocess.check_call(cmdline, stdout=output_checker.fd, stderr=output_checker.fd)
+
 names = [ 'notify_inval_inode', 'invalidate_path' ]
 if fuse_proto >= (7,15):
     names.append('notify_store_retrieve')
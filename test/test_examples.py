@@ -38,6 +38,7 @@ def name_generator(__ctr=[0]):
 options = []
 if sys.platform == 'linux':
     options.append('clone_fd')
+    options.append('io_uring')
 
 def invoke_directly(mnt_dir, name, options):
     cmdline = base_cmdline + [ pjoin(basename, 'example', name),
@@ -171,8 +172,9 @@ def test_passthrough(short_tmpdir, name, debug, output_checker, writeback):
     else:
         umount(mount_process, mnt_dir)
 
+@pytest.mark.parametrize("io_uring", (False, True))
 @pytest.mark.parametrize("cache", (False, True))
-def test_passthrough_hp(short_tmpdir, cache, output_checker):
+def test_passthrough_hp(short_tmpdir, cache, io_uring, output_checker):
     mnt_dir = str(short_tmpdir.mkdir('mnt'))
     src_dir = str(short_tmpdir.mkdir('src'))
 
@@ -182,6 +184,8 @@ def test_passthrough_hp(short_tmpdir, cache, output_checker):
 
     if not cache:
         cmdline.append('--nocache')
+    if io_uring:
+        cmdline.append('--io-uring')
         
     mount_process = subprocess.Popen(cmdline, stdout=output_checker.fd,
                                      stderr=output_checker.fd)
@@ -0,0 +1,276 @@
+/*
+  FUSE: Filesystem in Userspace
+
+  This program can be distributed under the terms of the GNU GPLv2.
+  See the file COPYING.
+*/
+
+/*
+ * Counts the heap allocations made while the file system serves a stream of
+ * lookup, getattr and read requests.  Once the per-thread request cache is
+ * warm, the request/reply path should not touch the allocator at all.
+ */
+
+#define FUSE_USE_VERSION 30
+
+#include <config.h>
+#include <fuse_lowlevel.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <assert.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#ifndef __linux__
+#include <limits.h>
+#else
+#include <linux/limits.h>
+#endif
+
+#define FILE_INO 2
+#define FILE_NAME "read_me"
+#define FILE_SIZE 4096
+
+/* Command line parsing */
+struct options {
+    int iterations;
+} options = {
+    .iterations = 2000,
+};
+
+#define OPTION(t, p)                           \
+    { t, offsetof(struct options, p), 1 }
+static const struct fuse_opt option_spec[] = {
+    OPTION("--iterations=%d", iterations),
+    FUSE_OPT_END
+};
+
+/*
+ * Allocation counter.  The wrappers forward to the glibc allocator and count
+ * calls while 'counting' is set.
+ */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static int counting;
+static unsigned long allocations;
+static unsigned long requests;
+
+static void count_allocation(void) {
+    if (__atomic_load_n(&counting, __ATOMIC_RELAXED))
+        __atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+}
+
+void *malloc(size_t size) {
+    count_allocation();
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+    count_allocation();
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    count_allocation();
+    return __libc_realloc(ptr, size);
+}
+
+static void count_request(void) {
+    __atomic_fetch_add(&requests, 1, __ATOMIC_RELAXED);
+}
+
+static void tfs_init(void *userdata, struct fuse_conn_info *conn) {
+    (void) userdata;
+    (void) conn;
+}
+
+static int tfs_stat(fuse_ino_t ino, struct stat *stbuf) {
+    stbuf->st_ino = ino;
+    if (ino == FUSE_ROOT_ID) {
+        stbuf->st_mode = S_IFDIR | 0755;
+        stbuf->st_nlink = 1;
+    }
+
+    else if (ino == FILE_INO) {
+        stbuf->st_mode = S_IFREG | 0444;
+        stbuf->st_nlink = 1;
+        stbuf->st_size = FILE_SIZE;
+    }
+
+    else
+        return -1;
+
+    return 0;
+}
+
+static void tfs_lookup(fuse_req_t req, fuse_ino_t parent,
+                       const char *name) {
+    struct fuse_entry_param e;
+    memset(&e, 0, sizeof(e));
+
+    count_request();
+    if (parent != FUSE_ROOT_ID)
+        goto err_out;
+    else if (strcmp(name, FILE_NAME) == 0)
+        e.ino = FILE_INO;
+    else
+        goto err_out;
+
+    if (tfs_stat(e.ino, &e.attr) != 0)
+        goto err_out;
+    fuse_reply_entry(req, &e);
+    return;
+
+err_out:
+    fuse_reply_err(req, ENOENT);
+}
+
+static void tfs_getattr(fuse_req_t req, fuse_ino_t ino,
+                        struct fuse_file_info *fi) {
+    struct stat stbuf;
+
+    (void) fi;
+
+    count_request();
+    memset(&stbuf, 0, sizeof(stbuf));
+    if (tfs_stat(ino, &stbuf) != 0)
+        fuse_reply_err(req, ENOENT);
+    else
+        fuse_reply_attr(req, &stbuf, 0);
+}
+
+static void tfs_open(fuse_req_t req, fuse_ino_t ino,
+                     struct fuse_file_info *fi) {
+    if (ino == FUSE_ROOT_ID)
+        fuse_reply_err(req, EISDIR);
+    else {
+        assert(ino == FILE_INO);
+        fi->direct_io = 1;
+        fuse_reply_open(req, fi);
+    }
+}
+
+static void tfs_read(fuse_req_t req, fuse_ino_t ino, size_t size,
+                     off_t off, struct fuse_file_info *fi) {
+    static char data[FILE_SIZE];
+
+    (void) fi;
+
+    assert(ino == FILE_INO);
+    count_request();
+    if (off >= FILE_SIZE)
+        size = 0;
+    else if (off + size > FILE_SIZE)
+        size = FILE_SIZE - off;
+    fuse_reply_buf(req, data + off, size);
+}
+
+static struct fuse_lowlevel_ops tfs_oper = {
+    .init	= tfs_init,
+    .lookup	= tfs_lookup,
+    .getattr	= tfs_getattr,
+    .open	= tfs_open,
+    .read	= tfs_read,
+};
+
+static void* run_fs(void *data) {
+    struct fuse_session *se = (struct fuse_session*) data;
+    assert(fuse_session_loop(se) == 0);
+    return NULL;
+}
+
+static void run_ops(const char *fname, int fd, int count) {
+    struct stat stbuf;
+    char buf[512];
+    int i;
+
+    for (i = 0; i < count; i++) {
+        assert(stat(fname, &stbuf) == 0);
+        assert(pread(fd, buf, sizeof(buf), 0) == sizeof(buf));
+    }
+}
+
+static void test_fs(char *mountpoint) {
+    char fname[PATH_MAX];
+    unsigned long allocs, reqs;
+    int fd;
+
+    assert(snprintf(fname, PATH_MAX, "%s/" FILE_NAME,
+                     mountpoint) > 0);
+    fd = open(fname, O_RDONLY);
+    if (fd == -1) {
+        perror(fname);
+        assert(0);
+    }
+
+    /* Warm up the request cache */
+    run_ops(fname, fd, 100);
+
+    __atomic_store_n(&requests, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&counting, 1, __ATOMIC_RELAXED);
+    run_ops(fname, fd, options.iterations);
+    __atomic_store_n(&counting, 0, __ATOMIC_RELAXED);
+    allocs = __atomic_load_n(&allocations, __ATOMIC_RELAXED);
+    reqs = __atomic_load_n(&requests, __ATOMIC_RELAXED);
+    close(fd);
+
+    printf("%lu allocations for %lu requests\n", allocs, reqs);
+    assert(reqs >= (unsigned long) options.iterations);
+    /* Allow for the odd unrelated allocation, but not one per request */
+    if (allocs * 100 > reqs) {
+        fprintf(stderr, "ERROR: request path is allocating memory\n");
+        assert(0);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+    struct fuse_session *se;
+    struct fuse_cmdline_opts fuse_opts;
+    pthread_t fs_thread;
+
+    assert(fuse_opt_parse(&args, &options, option_spec, NULL) == 0);
+    assert(fuse_parse_cmdline(&args, &fuse_opts) == 0);
+#ifndef __FreeBSD__
+    assert(fuse_opt_add_arg(&args, "-oauto_unmount") == 0);
+#endif
+    se = fuse_session_new(&args, &tfs_oper,
+                          sizeof(tfs_oper), NULL);
+    fuse_opt_free_args(&args);
+    assert (se != NULL);
+    assert(fuse_set_signal_handlers(se) == 0);
+    assert(fuse_session_mount(se, fuse_opts.mountpoint) == 0);
+
+    /* Start file-system thread */
+    assert(pthread_create(&fs_thread, NULL, run_fs, (void *)se) == 0);
+
+    test_fs(fuse_opts.mountpoint);
+    free(fuse_opts.mountpoint);
+
+    /* Stop file system */
+    fuse_session_exit(se);
+    fuse_session_unmount(se);
+    assert(pthread_join(fs_thread, NULL) == 0);
+
+    fuse_remove_signal_handlers(se);
+    fuse_session_destroy(se);
+
+    printf("Test completed successfully.\n");
+    return 0;
+}
+
+
+/**
+ * Local Variables:
+ * mode: c
+ * indent-tabs-mode: nil
+ * c-basic-offset: 4
+ * End:
+ */